@@ -33,6 +33,7 @@
 #include "hci_tl.h"
 #include "fs.h"
 #include "osal_snv.h"
+#include "ad_struct.h"
 
 #include "ble_misc_services.h"
 #include "bsp.h"
@@ -68,13 +69,26 @@
 #define BEACON_STORE_FS_FLAG_ID     (0x89)
 #define BEACON_STORE_FS_FLAG_DATA   (0x66)
 
-// Index start from 0
-#define BEACON_ADV_UUID_INDEX       (9)
-#define BEACON_ADV_MAJOR_INDEX      (25)
-#define BEACON_ADV_MINOR_INDEX      (27)
-#define BEACON_ADV_RSSI_INDEX       (29)
+#define BEACON_ADV_COMPANY_ID       (0x004C)
+#define BEACON_ADV_TYPE             (0x02)
+#define BEACON_ADV_LEN              (0x15)  // Length of the iBeacon data after this byte
 
 /* Private enumerate/structure ---------------------------------------- */
+// iBeacon data after the company ID of the manufacturer specific data
+typedef struct
+{
+  uint8 type;
+  uint8 len;
+  uint8 uuid[IBEACON_UUID_LEN];
+  uint8 major[IBEACON_VERSION_LEN];
+  uint8 minor[IBEACON_VERSION_LEN];
+  uint8 power;                      // The 2's complement of the calibrated Tx Power
+} beacon_adv_t;
+
+AD_CHECK(beacon_data, sizeof(beacon_adv_t), 2 + BEACON_ADV_LEN);
+AD_CHECK(advert_data, AD_SIZE(1) + AD_SIZE_ID16(sizeof(beacon_adv_t)), AD_DATA_MAX);
+AD_CHECK(scan_rsp_data, AD_SIZE(IBEACON_DEV_NAME_MAX_LEN), AD_DATA_MAX);
+
 /* Private macros ----------------------------------------------------- */
 /* Public variables --------------------------------------------------- */
 volatile uint8_t g_current_adv_type = LL_ADV_CONNECTABLE_UNDIRECTED_EVT;
@@ -86,35 +100,15 @@ static uint8 m_dispenser_task_id;   // Task ID for internal task/event processin
 static gaprole_States_t m_gap_profile_state	=	GAPROLE_INIT;
 static uint16 m_gap_conn_handle;
 
-// GAP - SCAN RSP data (max size = 31 bytes)
-static uint8 m_scan_rsp_data[] =
-{
-          // Complete name
-  0x09,   // Length of this data
-  GAP_ADTYPE_LOCAL_NAME_COMPLETE,
-  'D', 'I', 'S', 'P', 'E', 'N', ' ', ' ',
-};
+// GAP - SCAN RSP data, complete name
+static uint8 m_scan_rsp_data[AD_DATA_MAX];
+static uint8 m_scan_rsp_len;
+static uint8 *m_scan_rsp_name;
 
-// Advert data for iBeacon
-static uint8 m_advert_data[] =
-{
-  0x02,                             // Length of this data
-  GAP_ADTYPE_FLAGS,
-  DEFAULT_DISCOVERABLE_MODE |
-  GAP_ADTYPE_FLAGS_BREDR_NOT_SUPPORTED,
-  0x1A,                             // Length of this data including the data type byte
-  GAP_ADTYPE_MANUFACTURER_SPECIFIC, // Manufacturer specific adv data type
-  0x4c,                             // Company ID - Fixed
-  0x00,                             // Company ID - Fixed
-  0x02,                             // Data Type - Fixed
-  0x15,                             // Data Length - Fixed
-  0x7d, 0xb8, 0x60, 0xed, 0xb6, 0x4d, 0x4b, 0xb1,  // uuid
-  0x98, 0x75, 0x8f, 0x16, 0x35, 0x5a, 0x97, 0xd2,  // uuid
-
-  0x00,0x07,                        // Major
-  0x02,0x55,                        // Minor
-  0xc5                              // Power - The 2's complement of the calibrated Tx Power
-};
+// Advert data for iBeacon, flags and manufacturer specific data
+static uint8 m_advert_data[AD_DATA_MAX];
+static uint8 m_advert_len;
+static beacon_adv_t *m_advert_beacon;
 
 ibeacon_store_data_t m_beacon_default_data = {
   {'D', 'I', 'S', 'P', 'E', 'N', ' ', ' '},        // Device name
@@ -136,6 +130,7 @@ static void m_ble_process_osal_msg(osal_event_hdr_t *m_msg);
 static void m_ble_dispenser_state_notification_cb(gaprole_States_t new_state);
 
 static void m_ble_notify_humi(void);
+static void m_ble_build_adv_data(void);
 
 // GAP Role Callbacks
 static gapRolesCBs_t m_ble_dispenser_cbs =
@@ -176,11 +171,7 @@ void ble_dispenser_init(uint8 task_id)
     }
     osal_snv_read(BEACON_STOREDATA_FS_ID, sizeof(ibeacon_store_data_t) / sizeof(uint8), &Ibeacon_store_data);
     osal_memcpy(m_att_device_name, Ibeacon_store_data.beacon_dev_name, IBEACON_DEV_NAME_MAX_LEN);
-    osal_memcpy(&m_scan_rsp_data[2], Ibeacon_store_data.beacon_dev_name, IBEACON_DEV_NAME_MAX_LEN);
-    osal_memcpy(&m_advert_data[BEACON_ADV_UUID_INDEX], Ibeacon_store_data.uuid, IBEACON_UUID_LEN);
-    osal_memcpy(&m_advert_data[BEACON_ADV_MAJOR_INDEX], Ibeacon_store_data.major, IBEACON_VERSION_LEN);
-    osal_memcpy(&m_advert_data[BEACON_ADV_MINOR_INDEX], Ibeacon_store_data.minor, IBEACON_VERSION_LEN);
-    osal_memcpy(&m_advert_data[BEACON_ADV_RSSI_INDEX], &Ibeacon_store_data.RSSI, 1);
+    m_ble_build_adv_data();
     LOG("Ibeacon_store_data.adv_intvl=%d\n", Ibeacon_store_data.advIntvl);
     adv_intvl = Ibeacon_store_data.advIntvl * 1000 / 625;
     LOG("intvl=%d\n", adv_intvl);
@@ -226,8 +217,8 @@ void ble_dispenser_init(uint8 task_id)
     GAPRole_SetParameter(GAPROLE_ADVERT_ENABLED, sizeof(uint8), &initial_advertising_enable);
     GAPRole_SetParameter(GAPROLE_ADVERT_OFF_TIME, sizeof(uint16), &gap_role_advert_offtime);
 
-    GAPRole_SetParameter(GAPROLE_SCAN_RSP_DATA, sizeof(m_scan_rsp_data), m_scan_rsp_data);
-    GAPRole_SetParameter(GAPROLE_ADVERT_DATA, sizeof(m_advert_data), m_advert_data);
+    GAPRole_SetParameter(GAPROLE_SCAN_RSP_DATA, m_scan_rsp_len, m_scan_rsp_data);
+    GAPRole_SetParameter(GAPROLE_ADVERT_DATA, m_advert_len, m_advert_data);
 
     GAPRole_SetParameter(GAPROLE_PARAM_UPDATE_ENABLE, sizeof(uint8), &enable_update_request);
     GAPRole_SetParameter(GAPROLE_MIN_CONN_INTERVAL, sizeof(uint16), &desired_min_interval);
@@ -249,6 +240,12 @@ void ble_dispenser_init(uint8 task_id)
     GAP_SetParamValue(TGAP_GEN_DISC_ADV_INT_MAX, adv_int);
   }
 
+  // Let the controller resolve the private addresses of bonded devices
+  {
+    uint8 sync_resolving_list = TRUE;
+    GAPBondMgr_SetParameter(GAPBOND_AUTO_SYNC_RL, sizeof(uint8), &sync_resolving_list);
+  }
+
   // Initialize GATT attributes
   GGS_AddService(GATT_ALL_SERVICES);           // GAP
   GATTServApp_AddService(GATT_ALL_SERVICES);   // GATT attributes
@@ -381,7 +378,6 @@ static void m_ble_dispenser_state_notification_cb(gaprole_States_t new_state)
     break;
 
   case GAPROLE_CONNECTED:
-    HCI_PPLUS_ConnEventDoneNoticeCmd(m_dispenser_task_id, NULL);
     GAPRole_GetParameter(GAPROLE_CONNHANDLE, &m_gap_conn_handle);
     osal_set_event(m_dispenser_task_id, SBP_CONNECTED_EVT);
     break;
@@ -431,44 +427,78 @@ static void m_ble_notify_humi(void)
   mcs_notify(MCS_ID_CHAR_CLICK_AVAILBLE, m_gap_conn_handle, &humi_meas);
 }
 
+/**
+ * @brief       Pack the advert and scan response data from the stored beacon data
+ *
+ * @param[in]   None
+ *
+ * @attention   The layouts are checked against AD_DATA_MAX at compile time
+ *
+ * @return      None
+ */
+static void m_ble_build_adv_data(void)
+{
+  ad_builder_t builder;
+  beacon_adv_t beacon;
+
+  beacon.type = BEACON_ADV_TYPE;
+  beacon.len  = BEACON_ADV_LEN;
+  osal_memcpy(beacon.uuid, Ibeacon_store_data.uuid, IBEACON_UUID_LEN);
+  osal_memcpy(beacon.major, Ibeacon_store_data.major, IBEACON_VERSION_LEN);
+  osal_memcpy(beacon.minor, Ibeacon_store_data.minor, IBEACON_VERSION_LEN);
+  beacon.power = Ibeacon_store_data.RSSI;
+
+  ad_build_init(&builder, m_advert_data, sizeof(m_advert_data));
+  ad_build_flags(&builder, DEFAULT_DISCOVERABLE_MODE | GAP_ADTYPE_FLAGS_BREDR_NOT_SUPPORTED);
+  m_advert_beacon = (beacon_adv_t *)ad_build_manuf(&builder, BEACON_ADV_COMPANY_ID, &beacon, sizeof(beacon));
+  m_advert_len    = ad_build_len(&builder);
+
+  ad_build_init(&builder, m_scan_rsp_data, sizeof(m_scan_rsp_data));
+  m_scan_rsp_name = ad_build_name(&builder, (const char *)Ibeacon_store_data.beacon_dev_name, IBEACON_DEV_NAME_MAX_LEN);
+  m_scan_rsp_len  = ad_build_len(&builder);
+}
+
 /* Publish Function definitions --------------------------------------- */
 void SimpleBLEPeripheral_SetDevName(uint8*data,uint8 len)
 {
   uint8 dev_name[IBEACON_DEV_NAME_MAX_LEN] = {0};
-  osal_memcpy(dev_name, data, len);
+  osal_memcpy(dev_name, data, MIN(len, IBEACON_DEV_NAME_MAX_LEN));
   osal_memcpy(Ibeacon_store_data.beacon_dev_name, dev_name, IBEACON_DEV_NAME_MAX_LEN);
-  osal_memcpy(&m_scan_rsp_data[2], dev_name, IBEACON_DEV_NAME_MAX_LEN);
+  osal_memcpy(m_scan_rsp_name, dev_name, IBEACON_DEV_NAME_MAX_LEN);
   osal_snv_write(BEACON_STOREDATA_FS_ID, sizeof(ibeacon_store_data_t) / sizeof(uint8), &Ibeacon_store_data);
 }
 
 void SimpleBLEPeripheral_SetBeaconUUID(uint8 *data, uint8 len)
 {
+  len = MIN(len, IBEACON_UUID_LEN);
   osal_memcpy(Ibeacon_store_data.uuid, data, len);
-  osal_memcpy(&m_advert_data[BEACON_ADV_UUID_INDEX], data, len);
-  GAPRole_SetParameter(GAPROLE_ADVERT_DATA, sizeof(m_advert_data), m_advert_data);
+  osal_memcpy(m_advert_beacon->uuid, data, len);
+  GAPRole_SetParameter(GAPROLE_ADVERT_DATA, m_advert_len, m_advert_data);
   osal_snv_write(BEACON_STOREDATA_FS_ID, sizeof(ibeacon_store_data_t) / sizeof(uint8), &Ibeacon_store_data);
 }
 
 void SimpleBLEPeripheral_SetMajor(uint8 *data, uint8 len)
 {
+  len = MIN(len, IBEACON_VERSION_LEN);
   osal_memcpy(&Ibeacon_store_data.major, data, len);
-  osal_memcpy(&m_advert_data[BEACON_ADV_MAJOR_INDEX], data, len);
-  GAPRole_SetParameter(GAPROLE_ADVERT_DATA, sizeof(m_advert_data), m_advert_data);
+  osal_memcpy(m_advert_beacon->major, data, len);
+  GAPRole_SetParameter(GAPROLE_ADVERT_DATA, m_advert_len, m_advert_data);
   osal_snv_write(BEACON_STOREDATA_FS_ID, sizeof(ibeacon_store_data_t) / sizeof(uint8), &Ibeacon_store_data);
 }
 void SimpleBLEPeripheral_SetMinor(uint8 *data, uint8 len)
 {
+  len = MIN(len, IBEACON_VERSION_LEN);
   osal_memcpy(&Ibeacon_store_data.minor, data, len);
-  osal_memcpy(&m_advert_data[BEACON_ADV_MINOR_INDEX], data, len);
-  GAPRole_SetParameter(GAPROLE_ADVERT_DATA, sizeof(m_advert_data), m_advert_data);
+  osal_memcpy(m_advert_beacon->minor, data, len);
+  GAPRole_SetParameter(GAPROLE_ADVERT_DATA, m_advert_len, m_advert_data);
   osal_snv_write(BEACON_STOREDATA_FS_ID, sizeof(ibeacon_store_data_t) / sizeof(uint8), &Ibeacon_store_data);
 }
 
 void SimpleBLEPeripheral_SetRSSI(uint8 data)
 {
   Ibeacon_store_data.RSSI = data;
-  m_advert_data[BEACON_ADV_RSSI_INDEX] = data;
-  GAPRole_SetParameter(GAPROLE_ADVERT_DATA, sizeof(m_advert_data), m_advert_data);
+  m_advert_beacon->power = data;
+  GAPRole_SetParameter(GAPROLE_ADVERT_DATA, m_advert_len, m_advert_data);
   osal_snv_write(BEACON_STOREDATA_FS_ID, sizeof(ibeacon_store_data_t) / sizeof(uint8), &Ibeacon_store_data);
 }
 
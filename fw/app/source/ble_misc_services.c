@@ -31,11 +31,6 @@
 #define MCS_UUID_CHAR_CLICK_AVAILABLE      (0xFFF3)
 #define MCS_UUID_CHAR_BOTTLE_REPLACEMENT   (0xFFF4)
 
-#define CHAR_IDENTIFICATION_VALUE_POS      (2)
-#define CHAR_MODE_SELECTION_VALUE_POS      (4)
-#define CHAR_CLICK_AVAILABLE_VALUE_POS     (6)
-#define CHAR_BOTTLE_REPLACEMENT_VALUE_POS  (8)
-
 /* Private Macros ----------------------------------------------------------- */
 /* Private Defines ---------------------------------------------------------- */
 // GATT Profile Miscellaneous Service UUID
@@ -44,40 +39,6 @@ static CONST uint8 MCS_UUID[ATT_BT_UUID_SIZE] =
   LO_UINT16(MCS_UUID_SERV), HI_UINT16(MCS_UUID_SERV)
 };
 
-// Characteristic Identification UUID
-static CONST uint8 MCS_CHAR_IDENTIFICATION_UUID[ATT_BT_UUID_SIZE] =
-{ 
-  LO_UINT16(MCS_UUID_CHAR_IDENTIFICATION), HI_UINT16(MCS_UUID_CHAR_IDENTIFICATION)
-};
-
-// Characteristic Mode Selection UUID
-static CONST uint8 MCS_CHAR_MODE_SELECTION_UUID[ATT_BT_UUID_SIZE] =
-{ 
-  LO_UINT16(MCS_UUID_CHAR_MODE_SELECTION), HI_UINT16(MCS_UUID_CHAR_MODE_SELECTION)
-};
-
-// Characteristic Click Available UUID
-static CONST uint8 MCS_CHAR_CLICK_AVAILABLE_UUID[ATT_BT_UUID_SIZE] =
-{ 
-  LO_UINT16(MCS_UUID_CHAR_CLICK_AVAILABLE), HI_UINT16(MCS_UUID_CHAR_CLICK_AVAILABLE)
-};
-
-// Characteristic Bottle Replacement UUID
-static CONST uint8 MCS_CHAR_BOTTLE_REPLACEMENT_UUID[ATT_BT_UUID_SIZE] =
-{ 
-  LO_UINT16(MCS_UUID_CHAR_BOTTLE_REPLACEMENT), HI_UINT16(MCS_UUID_CHAR_BOTTLE_REPLACEMENT)
-};
-
-// Characterictic property
-uint8_t MCS_CHAR_PROPS[] =
-{
-  0,
-  GATT_PROP_READ | GATT_PROP_WRITE |GATT_PROP_NOTIFY,
-  GATT_PROP_READ | GATT_PROP_WRITE |GATT_PROP_NOTIFY,
-  GATT_PROP_READ | GATT_PROP_WRITE |GATT_PROP_NOTIFY,
-  GATT_PROP_READ | GATT_PROP_WRITE |GATT_PROP_NOTIFY,
-};
-
 // Profile Service attribute
 static CONST gattAttrType_t mcs_service = { ATT_BT_UUID_SIZE, MCS_UUID };
 
@@ -99,89 +60,46 @@ static struct
 }
 m_mcs;
 
+// Profile attributes
+#define MCS_ATTRS(CHAR, CFG, DESC)                                                    \
+  CHAR(MCS_IDENTIFICATION, MCS_UUID_CHAR_IDENTIFICATION,                              \
+       GATT_PROP_READ | GATT_PROP_WRITE | GATT_PROP_NOTIFY,                           \
+       GATT_PERMIT_READ | GATT_PERMIT_WRITE, m_mcs.chars.value.identification)        \
+  CHAR(MCS_MODE_SELECTION, MCS_UUID_CHAR_MODE_SELECTION,                              \
+       GATT_PROP_READ | GATT_PROP_WRITE | GATT_PROP_NOTIFY,                           \
+       GATT_PERMIT_READ | GATT_PERMIT_WRITE, m_mcs.chars.value.mode_selection)        \
+  CHAR(MCS_CLICK_AVAILABLE, MCS_UUID_CHAR_CLICK_AVAILABLE,                            \
+       GATT_PROP_READ | GATT_PROP_WRITE | GATT_PROP_NOTIFY,                           \
+       GATT_PERMIT_READ | GATT_PERMIT_WRITE, m_mcs.chars.value.click_available)       \
+  CHAR(MCS_BOTTLE_REPLACEMENT, MCS_UUID_CHAR_BOTTLE_REPLACEMENT,                      \
+       GATT_PROP_READ | GATT_PROP_WRITE | GATT_PROP_NOTIFY,                           \
+       GATT_PERMIT_READ | GATT_PERMIT_WRITE, m_mcs.chars.value.bottle_replacement)
+
+// Characteristic UUIDs and properties
+GATT_SERVICE_DEFS(MCS_ATTRS)
+
+// Position of each attribute in the attribute table
+enum
+{
+  MCS_SERVICE_IDX,
+  GATT_SERVICE_IDXS(MCS_ATTRS)
+  MCS_NUM_ATTRS
+};
+
 // Profile atrribute
-static gattAttribute_t mcs_atrr_tbl[] =
+static gattAttribute_t mcs_atrr_tbl[MCS_NUM_ATTRS] =
 {
   // Profile Service
-  {
-    {ATT_BT_UUID_SIZE, primaryServiceUUID}, /* type */
-    GATT_PERMIT_READ,                       /* permissions */
-    0,                                      /* handle */
-    (uint8 *)&mcs_service                   /* p_value */
-  },
-
-  // Characteristic Identification Declaration
-  {
-    {ATT_BT_UUID_SIZE, characterUUID},
-    GATT_PERMIT_READ,
-    0,
-    &MCS_CHAR_PROPS[MCS_ID_CHAR_IDENTIFICATON]
-  },
-
-  // Characteristic Identification Value
-  {
-    {ATT_BT_UUID_SIZE, MCS_CHAR_IDENTIFICATION_UUID},
-    GATT_PERMIT_READ | GATT_PERMIT_WRITE,
-    0,
-    m_mcs.chars.value.identification
-  },
-
-  // Characteristic Mode Selection Declaration
-  {
-    {ATT_BT_UUID_SIZE, characterUUID},
-    GATT_PERMIT_READ,
-    0,
-    &MCS_CHAR_PROPS[MCS_ID_CHAR_MODE_SELECTION]
-  },
-
-  // Characteristic Mode Selection Value
-  {
-    {ATT_BT_UUID_SIZE, MCS_CHAR_MODE_SELECTION_UUID},
-    GATT_PERMIT_READ | GATT_PERMIT_WRITE,
-    0,
-    m_mcs.chars.value.mode_selection
-  },
+  GATT_PRIMARY_SERVICE(&mcs_service)
 
-  // Characteristic Click Availble Declaration
-  {
-    {ATT_BT_UUID_SIZE, characterUUID},
-    GATT_PERMIT_READ,
-    0,
-    &MCS_CHAR_PROPS[MCS_ID_CHAR_CLICK_AVAILBLE]
-  },
-
-  // Characteristic Click Availble Value
-  {
-    {ATT_BT_UUID_SIZE, MCS_CHAR_CLICK_AVAILABLE_UUID},
-    GATT_PERMIT_READ | GATT_PERMIT_WRITE,
-    0,
-    m_mcs.chars.value.identification
-  },
-
-  // Characteristic Bottle Replacement Declaration
-  {
-    {ATT_BT_UUID_SIZE, characterUUID},
-    GATT_PERMIT_READ,
-    0,
-    &MCS_CHAR_PROPS[MCS_ID_CHAR_BOTTLE_REPLACEMENT]
-  },
-
-  // Characteristic Bottle Replacement Value
-  {
-    {ATT_BT_UUID_SIZE, MCS_CHAR_BOTTLE_REPLACEMENT_UUID},
-    GATT_PERMIT_READ | GATT_PERMIT_WRITE,
-    0,
-    m_mcs.chars.value.mode_selection
-  },
+  GATT_SERVICE_ATTRS(MCS_ATTRS)
 };
 
 /* Private function prototypes ---------------------------------------- */
-static bStatus_t mcs_read_attr_cb(uint16           conn_handle,
-                                  gattAttribute_t *p_attr,
-                                  uint8           *p_value, 
-                                  uint8           *p_len, 
-                                  uint16           offset, 
-                                  uint8            max_len);
+static bStatus_t mcs_get_attr_value_cb(uint16           conn_handle,
+                                       gattAttribute_t *p_attr,
+                                       uint8          **pp_value,
+                                       uint16          *p_len);
 
 static bStatus_t mcs_write_attr_cb(uint16          conn_handle, 
                                   gattAttribute_t *p_attr,
@@ -194,9 +112,11 @@ static bStatus_t mcs_write_attr_cb(uint16          conn_handle,
  */
 static CONST gattServiceCBs_t mcs_callbacks =
 {
-  mcs_read_attr_cb,
+  NULL,
   mcs_write_attr_cb,
-  NULL
+  NULL,
+  NULL,
+  mcs_get_attr_value_cb
 };
 static void simpleProfile_HandleConnStatusCB( uint16 connHandle, uint8 changeType )
 { 
@@ -298,27 +218,27 @@ bStatus_t mcs_notify(mcs_id_t char_id, uint16 conn_handle, attHandleValueNoti_t
   switch (char_id)
   {
   case MCS_ID_CHAR_CLICK_AVAILBLE:
-    p_noti->handle = mcs_atrr_tbl[CHAR_CLICK_AVAILABLE_VALUE_POS].handle;
+    p_noti->handle = mcs_atrr_tbl[MCS_CLICK_AVAILABLE_IDX].handle;
     break;
 
   case MCS_ID_CHAR_IDENTIFICATON:
-    p_noti->handle = mcs_atrr_tbl[CHAR_IDENTIFICATION_VALUE_POS].handle;
+    p_noti->handle = mcs_atrr_tbl[MCS_IDENTIFICATION_IDX].handle;
     break;
 
   case MCS_ID_CHAR_MODE_SELECTION:
-    p_noti->handle = mcs_atrr_tbl[CHAR_MODE_SELECTION_VALUE_POS].handle;
+    p_noti->handle = mcs_atrr_tbl[MCS_MODE_SELECTION_IDX].handle;
     break;
  
   case MCS_ID_CHAR_BOTTLE_REPLACEMENT:
-    p_noti->handle = mcs_atrr_tbl[CHAR_BOTTLE_REPLACEMENT_VALUE_POS].handle;
+    p_noti->handle = mcs_atrr_tbl[MCS_BOTTLE_REPLACEMENT_IDX].handle;
     break;
 
   default:
     break;
   }
 
-  // Send the notification
-  ret = GATT_Notification(conn_handle, p_noti, FALSE);
+  // Queue the notification, a newer state replaces one not sent yet
+  ret = GATTServApp_QueueNotification(conn_handle, p_noti, GATT_NOTI_FLAG_COALESCE);
 
   if (SUCCESS == ret)
   {
@@ -401,26 +321,53 @@ static bStatus_t mcs_write_attr_cb(uint16          conn_handle,
 }
 
 /**
- * @brief       Read an attribute.
+ * @brief       Get where an attribute value is stored, the GATT Server
+ *              Application copies it from there.
  *
  * @param[in]   conn_handle     Connection message was received on
  *              p_attr          Pointer to attribute
- *              p_value         Pointer to data to be read
- *              p_len           Length of data to be read
- *              offset          Offset of the first octet to be read
- *              max_len         Maximum length of data to be read
+ *              pp_value        Pointer to the stored value (to be returned)
+ *              p_len           Length of the stored value (to be returned)
  *
  * @return      Success or Failure
  */
-static uint8 mcs_read_attr_cb(uint16 conn_handle,
-                              gattAttribute_t *p_attr,
-                              uint8 *p_value,
-                              uint8 *p_len,
-                              uint16 offset,
-                              uint8 max_len)
+static bStatus_t mcs_get_attr_value_cb(uint16           conn_handle,
+                                       gattAttribute_t *p_attr,
+                                       uint8          **pp_value,
+                                       uint16          *p_len)
 {
   bStatus_t status = SUCCESS;
-  LOG("Miscellaneous read callback\n");
+
+  if (p_attr->type.len != ATT_BT_UUID_SIZE)
+    return (ATT_ERR_ATTR_NOT_FOUND);
+
+  switch (BUILD_UINT16(p_attr->type.uuid[0], p_attr->type.uuid[1]))
+  {
+  case MCS_UUID_CHAR_IDENTIFICATION:
+    *pp_value = m_mcs.chars.value.identification;
+    *p_len    = sizeof(m_mcs.chars.value.identification);
+    break;
+
+  case MCS_UUID_CHAR_MODE_SELECTION:
+    *pp_value = m_mcs.chars.value.mode_selection;
+    *p_len    = sizeof(m_mcs.chars.value.mode_selection);
+    break;
+
+  case MCS_UUID_CHAR_CLICK_AVAILABLE:
+    *pp_value = m_mcs.chars.value.click_available;
+    *p_len    = sizeof(m_mcs.chars.value.click_available);
+    break;
+
+  case MCS_UUID_CHAR_BOTTLE_REPLACEMENT:
+    *pp_value = m_mcs.chars.value.bottle_replacement;
+    *p_len    = sizeof(m_mcs.chars.value.bottle_replacement);
+    break;
+
+  default:
+    status = ATT_ERR_ATTR_NOT_FOUND;
+    break;
+  }
+
   return (status);
 }
 
@@ -74,7 +74,8 @@ bStatus_t mcs_set_parameter(mcs_id_t char_id, uint8 len, void *value);
 bStatus_t mcs_get_parameter(mcs_id_t char_id, void *value);
 
 /**
- * @brief       Send a notification containing a humidity measurement.
+ * @brief       Queue a notification of a characteristic, a newer value
+ *              replaces one not sent yet.
  *
  * @param[in]  char_id        Characteristic ID
  *             conn_handle    Connection handle
@@ -47,6 +47,10 @@
 
 #include "ble_timer.h"
 
+#if (DEBUG_INFO == 4)
+#include "log_bin.h"
+#endif
+
 /*********************************************************************
  * GLOBAL VARIABLES
  */
@@ -67,7 +71,10 @@ const pTaskEventHandlerFn tasksArr[] =
         GAPBondMgr_ProcessEvent,     // task , add 2017-11-15
         GATTServApp_ProcessEvent,    // task 7
         ble_dispenser_process_event, // task 8
-        ble_timer_process_event      // task 9
+        ble_timer_process_event,     // task 9
+#if (DEBUG_INFO == 4)
+        log_bin_process_event        // task 10, lowest priority: drains the binary log
+#endif
 };
 
 const uint8 tasksCnt = sizeof(tasksArr) / sizeof(tasksArr[0]);
@@ -126,7 +133,11 @@ void osalInitTasks(void)
   /* Application */
   ble_dispenser_init(taskID++);
 
-  ble_timer_1s_init(taskID);
+  ble_timer_1s_init(taskID++);
+
+#if (DEBUG_INFO == 4)
+  log_bin_task_init(taskID);
+#endif
 }
 #endif
 /*********************************************************************
@@ -117,7 +117,8 @@ static uint8 simpleProfileChar2Props			=	GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 simpleProfileChar2				=	0;
 // Simple Profile Characteristic 2 User Description
 static uint8 simpleProfileChar2UserDesp[]		=	"notify\0";
-static gattCharCfg_t simpleProfileChar2Config;//[GATT_MAX_NUM_CONN];
+// Characteristic 2 Configuration, in the CCCD store
+#define SIMPLEPROFILE_CHAR2_CCCD			GATT_CCCD_APP
 
 /*********************************************************************
  * Profile Attributes - Table
@@ -165,7 +166,7 @@ static gattAttribute_t simpleProfileAttrTbl[]/*[SERVAPP_NUM_ATTR_SUPPORTED]*/ =
 	// Characteristic 2 User Description
 //	{{ ATT_BT_UUID_SIZE, charUserDescUUID },			GATT_PERMIT_READ,		0,				simpleProfileChar2UserDesp},           
 	// Characteristic 2 configuration
-	{{ ATT_BT_UUID_SIZE, clientCharCfgUUID },			GATT_PERMIT_READ | GATT_PERMIT_WRITE,	0,	(uint8 *)&simpleProfileChar2Config}, 
+	{{ ATT_BT_UUID_SIZE, clientCharCfgUUID },			GATT_PERMIT_READ | GATT_PERMIT_WRITE,	0,	GATT_CCCD( SIMPLEPROFILE_CHAR2_CCCD )}, 
 
 };
 
@@ -211,9 +212,6 @@ bStatus_t SimpleProfile_AddService( uint32 services )
 {
   uint8 status = SUCCESS;
 
-  // Initialize Client Characteristic Configuration attributes
-  //GATTServApp_InitCharCfg( INVALID_CONNHANDLE, &simpleProfileChar2Config );
-
   // Register with Link DB to receive link status change callback
   VOID linkDB_Register( simpleProfile_HandleConnStatusCB );  
   
@@ -610,7 +608,7 @@ bStatus_t simpleProfile_Notify( uint16 connHandle,uint8*data,uint8 len)
 	uint16 notfEnable;
 	attHandleValueNoti_t notify_data={0};
 
-	uint16 ccd_value = simpleProfileChar2Config.value;
+	uint16 ccd_value = GATTServApp_ReadCCCD( connHandle, SIMPLEPROFILE_CHAR2_CCCD );
 
 	// If notifications enabled
 	if ( ccd_value & GATT_CLIENT_CFG_NOTIFY )
@@ -39,6 +39,7 @@ extern "C"
  */
 
 #define GATT_CLIENT_CHAR_CFG_UPDATED_EVENT  0x00 //!< Sent when a Client Characteristic Configuration is updated.  This event is sent as an OSAL message defined as gattCharCfgUpdatedEvent_t.
+#define GATT_CLIENT_INFO_UPDATED_EVENT      0x01 //!< Sent when a client writes its Client Supported Features or becomes change-aware.  This event is sent as an OSAL message defined as gattClientInfoUpdatedEvent_t.
 
 /** @} End GATT_SERV_MSG_EVENT_DEFINES */
 
@@ -86,6 +87,67 @@ extern "C"
 
 #define GATT_CFG_NO_OPERATION            0x0000 // No operation
 
+/** @defgroup GATT_CLIENT_FEAT_BITMAPS_DEFINES GATT Client Supported Features Bit Fields
+ * @{
+ */
+
+#define GATT_CLIENT_FEAT_ROBUST_CACHING  0x01 //!< The client supports Robust Caching
+#define GATT_CLIENT_FEAT_MULTI_NOTI      0x04 //!< The client supports Multiple Handle Value Notifications
+#define GATT_CLIENT_FEAT_SUPPORTED       ( GATT_CLIENT_FEAT_ROBUST_CACHING | GATT_CLIENT_FEAT_MULTI_NOTI ) //!< Features the server tracks
+
+/** @} End GATT_CLIENT_FEAT_BITMAPS_DEFINES */
+
+#define GATT_DB_HASH_SIZE                16 //!< Size of the Database Hash
+#define GATT_CLIENT_HASH_LEN             4  //!< Octets of the Database Hash saved for a bonded client
+#define GATT_CLIENT_INFO_SIZE            ( 1 + GATT_CLIENT_HASH_LEN ) //!< Size of a client's saved features and change-aware state
+
+/** @defgroup GATT_LONG_WRITE_OPS_DEFINES GATT Long Write Operations
+ * @{
+ */
+
+#define GATT_LONG_WRITE_PREPARE          0x01 //!< Write a prepared value into the staged value at its offset
+#define GATT_LONG_WRITE_EXECUTE          0x02 //!< Make the staged value the attribute value
+#define GATT_LONG_WRITE_CANCEL           0x03 //!< Drop the staged value
+
+/** @} End GATT_LONG_WRITE_OPS_DEFINES */
+
+#define GATT_LONG_WRITE_QUEUE            0x7F //!< Returned for GATT_LONG_WRITE_PREPARE to have the value queued until Execute Write instead
+
+/** @defgroup GATT_NOTI_FLAGS_DEFINES GATT Queued Notification Flags
+ * @{
+ */
+
+#define GATT_NOTI_FLAG_URGENT            0x01 //!< Send before the client's other queued notifications
+#define GATT_NOTI_FLAG_COALESCE          0x02 //!< Replace a queued value of the same handle, only the latest value of a state is sent
+
+/** @} End GATT_NOTI_FLAGS_DEFINES */
+
+#if !defined( GATT_MAX_NUM_QUEUED_NOTIS )
+  #define GATT_MAX_NUM_QUEUED_NOTIS      8 //!< Maximum number of notifications queued per client
+#endif
+
+/** @defgroup GATT_CCCD_IDX_DEFINES GATT CCCD Store Indexes
+ * Index of each Client Characteristic Configuration kept in the CCCD store,
+ * fixed at compile time so a client's configurations can be saved and
+ * restored as a whole. Application services number theirs from GATT_CCCD_APP.
+ * @{
+ */
+
+#define GATT_CCCD_SERVICE_CHANGED        0 //!< Service Changed, GATT Service
+#define GATT_CCCD_BATT_LEVEL             1 //!< Battery Level, Battery Service
+#define GATT_CCCD_OTA_RSP                2 //!< OTA Response, OTA Application Service
+#define GATT_CCCD_SCAN_REFRESH           3 //!< Scan Refresh, Scan Parameters Service
+#define GATT_CCCD_APP                    4 //!< First index of the application services, up to 7 for the HID Service
+
+/** @} End GATT_CCCD_IDX_DEFINES */
+
+#if !defined( GATT_MAX_NUM_CCCD )
+  #define GATT_MAX_NUM_CCCD              12 //!< Maximum number of CCCDs in the CCCD store
+#endif
+
+#define GATT_CCCD_IDX_INVALID            0xFF //!< Not a CCCD of the CCCD store
+#define GATT_CCCD_STORE_SIZE             ( ( GATT_MAX_NUM_CCCD + 3 ) / 4 ) //!< Size of a client's configurations, 2 bits per CCCD
+
 /** @defgroup GATT_FORMAT_TYPES_DEFINES GATT Characteristic Format Types
  * @{
  */
@@ -159,6 +221,9 @@ extern "C"
  * VARIABLES
  */
 
+// Attribute values of the CCCDs in the CCCD store, only their addresses matter
+extern CONST uint8 gattServApp_CCCDTag[GATT_MAX_NUM_CCCD];
+
 /*********************************************************************
  * MACROS
  */
@@ -172,6 +237,66 @@ extern "C"
 // The handle of the first included service (i = 1) is the value of the second attribute
 #define GATT_INCLUDED_HANDLE( attrs, i ) ( *((uint16 *)((attrs)[(i)].pValue)) )
 
+/** @defgroup GATT_SERV_TABLE_MACROS GATT Service Table Macros
+ * A service is described once, as a list of entries, and the list is
+ * expanded into the UUIDs and properties of its characteristics (const),
+ * the index of each attribute and the attribute table:
+ *
+ *   #define MY_ATTRS( CHAR, CFG, DESC ) \
+ *     CHAR( MY_DATA, MY_DATA_UUID, GATT_PROP_READ | GATT_PROP_NOTIFY, GATT_PERMIT_READ, myData ) \
+ *     CFG( MY_DATA, myDataCharCfg ) \
+ *     DESC( MY_DATA_DESC, charUserDescUUID, GATT_PERMIT_READ, myDataDesc )
+ *
+ *   GATT_SERVICE_DEFS( MY_ATTRS )
+ *
+ *   enum { MY_SERVICE_IDX, GATT_SERVICE_IDXS( MY_ATTRS ) MY_NUM_ATTRS };
+ *
+ *   static gattAttribute_t myAttrTbl[MY_NUM_ATTRS] =
+ *   {
+ *     GATT_PRIMARY_SERVICE( &myService )
+ *     GATT_SERVICE_ATTRS( MY_ATTRS )
+ *   };
+ *
+ * The handle of an attribute is then myAttrTbl[MY_DATA_IDX].handle, GATT
+ * assigns consecutive handles starting with the service. The table itself
+ * stays in RAM as GATT writes these handles into it.
+ * @{
+ */
+
+// Characteristic, with a 16-bit UUID: MY_DATA_DECL_IDX, MY_DATA_IDX
+#define GATT_CHAR_DEF( id, uuid, props, perms, pValue ) \
+  static CONST uint8 id##_CHAR_UUID[ATT_BT_UUID_SIZE] = { LO_UINT16( uuid ), HI_UINT16( uuid ) }; \
+  static CONST uint8 id##_CHAR_PROPS = ( props );
+#define GATT_CHAR_IDX( id, uuid, props, perms, pValue )   id##_DECL_IDX, id##_IDX,
+#define GATT_CHAR_ATTRS( id, uuid, props, perms, pValue ) \
+  { { ATT_BT_UUID_SIZE, characterUUID }, GATT_PERMIT_READ, 0, (uint8 *)&id##_CHAR_PROPS }, \
+  { { ATT_BT_UUID_SIZE, id##_CHAR_UUID }, ( perms ), 0, (uint8 *)( pValue ) },
+
+// Client Characteristic Configuration of a characteristic: MY_DATA_CFG_IDX
+#define GATT_CFG_DEF( id, charCfgTbl )
+#define GATT_CFG_IDX( id, charCfgTbl )                    id##_CFG_IDX,
+#define GATT_CFG_ATTRS( id, charCfgTbl ) \
+  { { ATT_BT_UUID_SIZE, clientCharCfgUUID }, GATT_PERMIT_READ | GATT_PERMIT_WRITE, 0, (uint8 *)( charCfgTbl ) },
+
+// Value of a Client Characteristic Configuration kept in the CCCD store,
+// in place of a gattCharCfg_t table: CFG( MY_DATA, GATT_CCCD( MY_DATA_CCCD ) )
+#define GATT_CCCD( idx )                 ( (uint8 *)&(gattServApp_CCCDTag[(idx)]) )
+
+// Any other descriptor, with a 16-bit UUID array: MY_DATA_DESC_IDX
+#define GATT_DESC_DEF( id, uuid, perms, pValue )
+#define GATT_DESC_IDX( id, uuid, perms, pValue )          id##_IDX,
+#define GATT_DESC_ATTRS( id, uuid, perms, pValue ) \
+  { { ATT_BT_UUID_SIZE, ( uuid ) }, ( perms ), 0, (uint8 *)( pValue ) },
+
+#define GATT_PRIMARY_SERVICE( pService ) \
+  { { ATT_BT_UUID_SIZE, primaryServiceUUID }, GATT_PERMIT_READ, 0, (uint8 *)( pService ) },
+
+#define GATT_SERVICE_DEFS( attrs )   attrs( GATT_CHAR_DEF, GATT_CFG_DEF, GATT_DESC_DEF )
+#define GATT_SERVICE_IDXS( attrs )   attrs( GATT_CHAR_IDX, GATT_CFG_IDX, GATT_DESC_IDX )
+#define GATT_SERVICE_ATTRS( attrs )  attrs( GATT_CHAR_ATTRS, GATT_CFG_ATTRS, GATT_DESC_ATTRS )
+
+/** @} End GATT_SERV_TABLE_MACROS */
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -225,6 +350,43 @@ typedef bStatus_t (*pfnGATTWriteAttrCB_t)( uint16 connHandle, gattAttribute_t *p
  */
 typedef bStatus_t (*pfnGATTAuthorizeAttrCB_t)( uint16 connHandle, gattAttribute_t *pAttr,
                                                uint8 opcode );
+/**
+ * @brief   Callback function prototype to write a long attribute value in
+ *          place. Prepared values are passed as they arrive, the service
+ *          keeps them in a staged value until Execute Write.
+ *
+ * @param   connHandle - connection request was received on
+ * @param   pAttr - pointer to attribute
+ * @param   pValue - pointer to data to be written (GATT_LONG_WRITE_PREPARE only)
+ * @param   len - length of data (GATT_LONG_WRITE_PREPARE only)
+ * @param   offset - offset of the first octet to be written (GATT_LONG_WRITE_PREPARE only)
+ * @param   op - ref GATT_LONG_WRITE_OPS_DEFINES
+ *
+ * @return  SUCCESS: Operation was successfully.<BR>
+ *          GATT_LONG_WRITE_QUEUE: Attribute not written in place (GATT_LONG_WRITE_PREPARE only).<BR>
+ *          Error, otherwise: ref ATT_ERR_CODE_DEFINES. Errors of the
+ *          prepared values should be returned for GATT_LONG_WRITE_EXECUTE.<BR>
+ */
+typedef bStatus_t (*pfnGATTLongWriteAttrCB_t)( uint16 connHandle, gattAttribute_t *pAttr,
+                                               uint8 *pValue, uint8 len, uint16 offset,
+                                               uint8 op );
+/**
+ * @brief   Callback function prototype to get where an attribute value is
+ *          stored, for values kept as they are sent. GATT Server App copies
+ *          the value from there straight into the response and handles the
+ *          offset of Read Blob.
+ *
+ * @param   connHandle - connection request was received on
+ * @param   pAttr - pointer to attribute
+ * @param   ppValue - pointer to the stored value (to be returned)
+ * @param   pLen - length of the stored value (to be returned)
+ *
+ * @return  SUCCESS: Value returned.<BR>
+ *          FAILURE: Value not stored as it is sent, the Read callback is used.<BR>
+ *          Error, otherwise: ref ATT_ERR_CODE_DEFINES.<BR>
+ */
+typedef bStatus_t (*pfnGATTGetAttrValueCB_t)( uint16 connHandle, gattAttribute_t *pAttr,
+                                              uint8 **ppValue, uint16 *pLen );
 /**
  * @}
  */
@@ -259,6 +421,8 @@ typedef struct
   pfnGATTReadAttrCB_t pfnReadAttrCB;           //!< Read callback function pointer
   pfnGATTWriteAttrCB_t pfnWriteAttrCB;         //!< Write callback function pointer
   pfnGATTAuthorizeAttrCB_t pfnAuthorizeAttrCB; //!< Authorization callback function pointer
+  pfnGATTLongWriteAttrCB_t pfnLongWriteAttrCB; //!< Long write callback function pointer (optional)
+  pfnGATTGetAttrValueCB_t pfnGetAttrValueCB;   //!< Get value callback function pointer (optional)
 } gattServiceCBs_t;
 
 /**
@@ -284,6 +448,18 @@ typedef struct
   uint16 value;         //!< attribute new value
 } gattClientCharCfgUpdatedEvent_t;
 
+/**
+ * GATT_CLIENT_INFO_UPDATED_EVENT message format.  This message is sent to
+ * the app when a client's Client Supported Features or change-aware state
+ * is to be saved.
+ */
+typedef struct
+{
+  osal_event_hdr_t hdr; //!< GATT_SERV_MSG_EVENT and status
+  uint16 connHandle;    //!< Connection of the client
+  uint8 method;         //!< GATT_CLIENT_INFO_UPDATED_EVENT
+} gattClientInfoUpdatedEvent_t;
+
 
 
 typedef void (*gattServMsgCB_t)( gattMsgEvent_t*pMsg);
@@ -490,6 +666,97 @@ extern bStatus_t GATTServApp_ProcessCCCWriteReq( uint16 connHandle, gattAttribut
                                           uint8 *pValue, uint8 len, uint16 offset,
                                           uint16 validCfg );
 
+/**
+ * @brief   Read the configuration of a CCCD in the CCCD store for a
+ *          given client.
+ *
+ * @param   connHandle - connection handle.
+ * @param   cccdIdx - CCCD store index, ref GATT_CCCD_IDX_DEFINES.
+ *
+ * @return  attribute value
+ */
+extern uint16 GATTServApp_ReadCCCD( uint16 connHandle, uint8 cccdIdx );
+
+/**
+ * @brief   Write the configuration of a CCCD in the CCCD store for a
+ *          given client.
+ *
+ * @param   connHandle - connection handle.
+ * @param   cccdIdx - CCCD store index, ref GATT_CCCD_IDX_DEFINES.
+ * @param   value - attribute new value.
+ *
+ * @return  SUCCESS or INVALIDPARAMETER
+ */
+extern bStatus_t GATTServApp_WriteCCCD( uint16 connHandle, uint8 cccdIdx, uint16 value );
+
+/**
+ * @brief   Clear the configurations of the CCCD store for a given client.
+ *          GATT Server App does it when the connection drops.
+ *
+ * @param   connHandle - connection handle (0xFFFF for all connections).
+ *
+ * @return  none
+ */
+extern void GATTServApp_InitCCCD( uint16 connHandle );
+
+/**
+ * @brief   Get the CCCD store index of an attribute.
+ *
+ * @param   attrHandle - attribute handle.
+ *
+ * @return  CCCD store index. GATT_CCCD_IDX_INVALID if the attribute isn't
+ *          a CCCD kept in the CCCD store.
+ */
+extern uint8 GATTServApp_GetCCCDIdx( uint16 attrHandle );
+
+/**
+ * @brief   Copy all the configurations of the CCCD store for a given
+ *          client, for the Bond Manager to save them.
+ *
+ * @param   connHandle - connection handle.
+ * @param   pBuf - GATT_CCCD_STORE_SIZE bytes to copy the configurations to.
+ *
+ * @return  SUCCESS or INVALIDPARAMETER
+ */
+extern bStatus_t GATTServApp_SaveCCCD( uint16 connHandle, uint8 *pBuf );
+
+/**
+ * @brief   Set all the configurations of the CCCD store for a given client
+ *          from the ones the Bond Manager saved.
+ *
+ * @param   connHandle - connection handle.
+ * @param   pBuf - GATT_CCCD_STORE_SIZE bytes of saved configurations.
+ *
+ * @return  SUCCESS or INVALIDPARAMETER
+ */
+extern bStatus_t GATTServApp_RestoreCCCD( uint16 connHandle, uint8 *pBuf );
+
+/**
+ * @brief   Copy the Client Supported Features of a given client and the
+ *          part of the Database Hash it is change-aware of, for the Bond
+ *          Manager to save them. The hash part is zero while the client
+ *          is change-unaware.
+ *
+ * @param   connHandle - connection handle.
+ * @param   pBuf - GATT_CLIENT_INFO_SIZE bytes to copy them to.
+ *
+ * @return  SUCCESS or INVALIDPARAMETER
+ */
+extern bStatus_t GATTServApp_SaveClientInfo( uint16 connHandle, uint8 *pBuf );
+
+/**
+ * @brief   Set the Client Supported Features of a given bonded client from
+ *          the ones the Bond Manager saved. A Robust Caching client is
+ *          change-unaware if the database changed since it was last
+ *          change-aware.
+ *
+ * @param   connHandle - connection handle.
+ * @param   pBuf - GATT_CLIENT_INFO_SIZE bytes of saved information.
+ *
+ * @return  SUCCESS or INVALIDPARAMETER
+ */
+extern bStatus_t GATTServApp_RestoreClientInfo( uint16 connHandle, uint8 *pBuf );
+
 /**
  * @brief   Process Client Charateristic Configuration change.
  *
@@ -506,6 +773,44 @@ extern bStatus_t GATTServApp_ProcessCharCfg( gattCharCfg_t *charCfgTbl, uint8 *p
                                         uint8 authenticated, gattAttribute_t *attrTbl,
                                         uint16 numAttrs, uint8 taskId );
 
+/**
+ * @brief   Queue a notification for a client. What the controller takes is
+ *          sent right away, the rest at the end of the following connection
+ *          events. Several queued values are sent in one Multiple Handle
+ *          Value Notification if the client supports it.
+ *
+ *          NOTE: The GATT Server Application takes the
+ *          HCI_PPLUS_ConnEventDoneNoticeCmd() notice while notifications are
+ *          queued. Applications get theirs with
+ *          GATTServApp_ConnEventDoneNoticeCmd().
+ *
+ * @param   connHandle - connection to use
+ * @param   pNoti - pointer to notification to be sent
+ * @param   flags - ref GATT_NOTI_FLAGS_DEFINES
+ *
+ * @return  SUCCESS: Notification sent or queued.<BR>
+ *          INVALIDPARAMETER: Invalid connection handle or length.<BR>
+ *          bleNotConnected: Connection is down.<BR>
+ *          bleNoResources: Client's queue is full.<BR>
+ *          bleMemAllocError: Memory allocation error occurred.<BR>
+ */
+extern bStatus_t GATTServApp_QueueNotification( uint16 connHandle, attHandleValueNoti_t *pNoti,
+                                                uint8 flags );
+
+/**
+ * @brief   Enable or disable the connection event done notice of the
+ *          application. The controller has one notice for all tasks, so
+ *          applications use this instead of HCI_PPLUS_ConnEventDoneNoticeCmd()
+ *          and the GATT Server Application passes the notice on.
+ *
+ * @param   taskID - application's task ID
+ * @param   taskEvent - event to set at the end of each connection event,
+ *                      0 to disable
+ *
+ * @return  SUCCESS
+ */
+extern bStatus_t GATTServApp_ConnEventDoneNoticeCmd( uint8 taskID, uint16 taskEvent );
+
 /**
  * @brief   Build and send the GATT_CLIENT_CHAR_CFG_UPDATED_EVENT to
  *          the application.
@@ -75,6 +75,9 @@ extern "C"
 #define ATT_HANDLE_VALUE_NOTI            0x1b //!< ATT Handle Value Notification
 #define ATT_HANDLE_VALUE_IND             0x1d //!< ATT Handle Value Indication
 #define ATT_HANDLE_VALUE_CFM             0x1e //!< ATT Handle Value Confirmation
+#define ATT_READ_MULTI_VAR_REQ           0x20 //!< ATT Read Multiple Variable Length Request
+#define ATT_READ_MULTI_VAR_RSP           0x21 //!< ATT Read Multiple Variable Length Response
+#define ATT_MULTI_HANDLE_VALUE_NOTI      0x23 //!< ATT Multiple Handle Value Notification
 
 #define ATT_WRITE_CMD                    0x52 //!< ATT Write Command
 #define ATT_SIGNED_WRITE_CMD             0xD2 //!< ATT Signed Write Command
@@ -130,8 +133,10 @@ extern "C"
 #define ATT_ERR_INSUFFICIENT_ENCRYPT     0x0f //!< The attribute requires encryption before it can be read or written
 #define ATT_ERR_UNSUPPORTED_GRP_TYPE     0x10 //!< The attribute type is not a supported grouping attribute as defined by a higher layer specification
 #define ATT_ERR_INSUFFICIENT_RESOURCES   0x11 //!< Insufficient Resources to complete the request
+#define ATT_ERR_DATABASE_OUT_OF_SYNC     0x12 //!< The server requests the client to rediscover the database
+#define ATT_ERR_VALUE_NOT_ALLOWED        0x13 //!< The attribute parameter value was not allowed
 
-/*** Reserved for future use: 0x12 - 0x7F ***/
+/*** Reserved for future use: 0x14 - 0x7F ***/
 
 /*** Application error code defined by a higher layer specification: 0x80-0x9F ***/
 
@@ -167,13 +167,16 @@ extern "C"
 #define BLE_NVID_CSRK                   0x03  //!< The Device's CSRK
 #define BLE_NVID_SIGNCOUNTER            0x04  //!< The Device's Sign Counter
 
-// Bonding NV Items -   Range  0x20 - 0x5F    - This allows for 10 bondings
-#define BLE_NVID_GAP_BOND_START         0x20  //!< Start of the GAP Bond Manager's NV IDs
-#define BLE_NVID_GAP_BOND_END           0x5f  //!< End of the GAP Bond Manager's NV IDs Range
+// Bonding NV Items -   Range  0x90 - 0xBF    - One record per bonding, this allows for 48 bondings
+#define BLE_NVID_GAP_BOND_START         0x90  //!< Start of the GAP Bond Manager's NV IDs
+#define BLE_NVID_GAP_BOND_END           0xbf  //!< End of the GAP Bond Manager's NV IDs Range
 
-// GATT Configuration NV Items - Range  0x70 - 0x79 - This must match the number of Bonding entries
-#define BLE_NVID_GATT_CFG_START         0x70  //!< Start of the GATT Configuration NV IDs
-#define BLE_NVID_GATT_CFG_END           0x79  //!< End of the GATT Configuration NV IDs
+// Bond Configuration NV Items - Range  0xC0 - 0xEF - One record per bonding, GATT configurations and sign counter
+#define BLE_NVID_GAP_BOND_CFG_START     0xc0  //!< Start of the Bond Configuration NV IDs
+#define BLE_NVID_GAP_BOND_CFG_END       0xef  //!< End of the Bond Configuration NV IDs
+
+// Bond Table NV Item - The used bondings and when they were last used
+#define BLE_NVID_GAP_BOND_TABLE         0xf0  //!< Bond Table NV ID
 /** @} End BLE_NV_IDS */
 
 /*********************************************************************
@@ -57,7 +57,10 @@ extern "C"
  */
 #define PREPARE_QUEUE_STATIC
 #if !defined( GATT_MAX_NUM_PREPARE_WRITES )
-  #define GATT_MAX_NUM_PREPARE_WRITES      1//20 //!< GATT Maximum number of attributes that Attribute Server can prepare for writing per Attribute Client
+  #define GATT_MAX_NUM_PREPARE_WRITES      1//20 //!< GATT Maximum number of prepared values that Attribute Server can queue, shared by all Attribute Clients
+#endif
+#if !defined( GATT_MAX_NUM_LONG_WRITES )
+  #define GATT_MAX_NUM_LONG_WRITES         MAX_NUM_LL_CONN //!< GATT Maximum number of attributes that Attribute Server can write in place at the same time, shared by all Attribute Clients
 #endif
 
 /** @} End GATT_NUM_PREPARE_WRITES_DEFINES */
@@ -72,6 +72,8 @@ extern "C"
 #define RECONNECT_ADDR_UUID                        0x2A03 // Reconnection Address
 #define PERI_CONN_PARAM_UUID                       0x2A04 // Peripheral Preferred Connection Parameters
 #define SERVICE_CHANGED_UUID                       0x2A05 // Service Changed
+#define CLIENT_SUPPORTED_FEATURES_UUID             0x2B29 // Client Supported Features
+#define DATABASE_HASH_UUID                         0x2B2A // Database Hash
 
 /*********************************************************************
  * MACROS
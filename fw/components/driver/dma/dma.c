@@ -97,6 +97,27 @@ int hal_dma_init_channel(HAL_DMA_t cfg)
 }
 
 
+int hal_dma_deinit_channel(DMA_CH_t ch)
+{
+    DMA_CH_Ctx_t* pctx;
+
+    if(!s_dma_ctx.init_flg)
+        return PPlus_ERR_NOT_REGISTED;
+
+    if(ch >= DMA_CH_NUM)
+        return PPlus_ERR_INVALID_PARAM;
+
+    pctx = &s_dma_ctx.dma_ch_ctx[ch];
+
+    if(pctx->xmit_busy)
+        hal_dma_stop_channel(ch);
+
+    memset(pctx, 0, sizeof(DMA_CH_Ctx_t));
+
+    return PPlus_SUCCESS;
+}
+
+
 int hal_dma_config_channel(DMA_CH_t ch, DMA_CH_CFG_t* cfg)
 {  
     DMA_CH_Ctx_t* pctx;
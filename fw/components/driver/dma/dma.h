@@ -335,6 +335,7 @@ typedef struct {
 } DMA_CH_Ctx_t;
 
 int hal_dma_init_channel(HAL_DMA_t cfg);
+int hal_dma_deinit_channel(DMA_CH_t ch);
 int hal_dma_config_channel(DMA_CH_t ch, DMA_CH_CFG_t* cfg);
 int hal_dma_start_channel(DMA_CH_t ch);
 int hal_dma_stop_channel(DMA_CH_t ch);
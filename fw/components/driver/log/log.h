@@ -47,6 +47,13 @@ extern "C" {
         #define AT_LOG(...)  dbg_printf(__VA_ARGS__)
         #define LOG_DEBUG(...)  dbg_printf(__VA_ARGS__)
         #define LOG_INIT() dbg_printf_init()
+    #elif(DEBUG_INFO == 4)
+        //deferred binary log, decode on host with tools/log_decode.py
+        #include "log_bin.h"
+        #define LOG(...)  LOG_BIN(__VA_ARGS__)
+        #define AT_LOG(...)  LOG_BIN(__VA_ARGS__)
+        #define LOG_DEBUG(...)  LOG_BIN(__VA_ARGS__)
+        #define LOG_INIT() log_bin_init()
     #else
         #define AT_LOG(...)
         #define LOG_DEBUG(...)
@@ -0,0 +1,250 @@
+/**************************************************************************************************
+*******
+**************************************************************************************************/
+
+
+/*******************************************************************************
+* @file		log_bin.c
+* @brief	Deferred binary (tokenized) log backend
+* @version	0.0
+* @date		19. Oct. 2026
+* @author
+*
+*******************************************************************************/
+#include "rom_sym_def.h"
+#include "types.h"
+#include <stdarg.h>
+#include <string.h>
+#include "OSAL.h"
+#include "mcu.h"
+#include "clock.h"
+#include "pwrmgr.h"
+#include "uart.h"
+#include "error.h"
+#include "log_bin.h"
+
+#define LOG_BIN_RING_MASK       (LOG_BIN_RING_WORDS - 1)
+#define LOG_BIN_DRAIN_CHUNK     32      //words handed to the UART tx buffer at a time
+
+#if (LOG_BIN_RING_WORDS & LOG_BIN_RING_MASK)
+#error "LOG_BIN_RING_WORDS must be a power of 2"
+#endif
+
+//base of the format string section, see ER_LOG_FMT in scatter_load.sct
+extern const char Image$$ER_LOG_FMT$$Base[];
+
+static uint32_t s_log_ring[LOG_BIN_RING_WORDS];
+static volatile uint32_t s_log_head = 0;    //producer index, updated with irq masked
+static volatile uint32_t s_log_tail = 0;    //consumer index, only written by drain
+static uint32_t s_log_dropped = 0;
+static uint8_t s_log_task_id = 0xff;
+static uint8_t s_log_tx_buf[LOG_BIN_DRAIN_CHUNK << 2];
+
+#define LOG_BIN_HDR(id, argc)   (((uint32_t)(id) << 16) | ((uint32_t)(argc) << 8) | LOG_BIN_SYNC)
+
+/*
+hand the next chunk to the interrupt driven UART tx buffer, the driver copies
+it and holds the MOD_UART0 lock until it is out. Nothing is sent while the
+previous chunk is in flight, its TX_COMPLETED event sets the drain event again.
+*/
+static void log_bin_drain(void)
+{
+    uint32_t tail = s_log_tail;
+    uint32_t len = s_log_head - tail;
+
+    if(len == 0 || hal_uart_get_tx_ready(UART0) != PPlus_SUCCESS)
+        return;
+
+    //the contiguous part up to the ring end, records may wrap
+    if(len > LOG_BIN_RING_WORDS - (tail & LOG_BIN_RING_MASK))
+        len = LOG_BIN_RING_WORDS - (tail & LOG_BIN_RING_MASK);
+    if(len > LOG_BIN_DRAIN_CHUNK)
+        len = LOG_BIN_DRAIN_CHUNK;
+
+    if(hal_uart_send_buff(UART0, (uint8_t*)&s_log_ring[tail & LOG_BIN_RING_MASK], (uint16_t)(len << 2)) == PPlus_SUCCESS)
+        s_log_tail = tail + len;
+}
+
+static void log_bin_uart_evt(uart_Evt_t* pev)
+{
+    if(pev->type == UART_EVT_TYPE_TX_COMPLETED && s_log_head != s_log_tail && s_log_task_id != 0xff)
+        osal_set_event(s_log_task_id, LOG_BIN_DRAIN_EVT);
+}
+
+//bit n is set when argument n is a %s, same conversions as tools/log_decode.py
+static uint32_t log_bin_str_args(const char* fmt, uint8_t argc)
+{
+    uint32_t mask = 0;
+    uint8_t n = 0;
+
+    while(*fmt && n < argc){
+        if(*fmt++ != '%')
+            continue;
+        while(*fmt && strchr("-+ #0123456789.hlL", *fmt))
+            fmt++;
+        if(*fmt == '%'){
+            fmt++;
+            continue;
+        }
+        if(*fmt == 's')
+            mask |= 1u << n;
+        if(*fmt)
+            fmt++;
+        n++;
+    }
+    return mask;
+}
+
+void log_bin_write(const char* fmt, uint8_t argc, ...)
+{
+    va_list args;
+    uint32_t arg[LOG_BIN_ARGS_MAX];
+    uint8_t slen[LOG_BIN_ARGS_MAX];
+    uint32_t str_mask, head, free_words, i, j, w;
+    uint8_t words;
+    bool was_empty;
+
+    if(argc > LOG_BIN_ARGS_MAX)
+        argc = LOG_BIN_ARGS_MAX;
+
+    //strings are copied into the record, size them before taking the ring
+    str_mask = argc ? log_bin_str_args(fmt, argc) : 0;
+    words = argc;
+    va_start(args, argc);
+    for(i = 0; i < argc; i++){
+        arg[i] = va_arg(args, uint32_t);
+        if(str_mask & (1u << i)){
+            const char* s = (const char*)arg[i];
+            for(j = 0; s && j < LOG_BIN_STR_MAX && s[j]; j++)
+                ;
+            slen[i] = (uint8_t)j;
+            words += (j + 3) >> 2;
+        }
+    }
+    va_end(args);
+
+    HAL_ENTER_CRITICAL_SECTION();
+    head = s_log_head;
+    was_empty = (head == s_log_tail);
+    free_words = LOG_BIN_RING_WORDS - (head - s_log_tail);
+
+    //report a previous overflow before the next record that fits
+    if(s_log_dropped && free_words >= (uint32_t)(3 + 2 + words)){
+        s_log_ring[head++ & LOG_BIN_RING_MASK] = LOG_BIN_HDR(LOG_BIN_ID_DROPPED, 1);
+        s_log_ring[head++ & LOG_BIN_RING_MASK] = rtc_get_counter();
+        s_log_ring[head++ & LOG_BIN_RING_MASK] = s_log_dropped;
+        s_log_dropped = 0;
+        free_words -= 3;
+    }
+
+    if(s_log_dropped || free_words < (uint32_t)(2 + words)){
+        s_log_dropped++;
+        s_log_head = head;
+        HAL_EXIT_CRITICAL_SECTION();
+        return;
+    }
+
+    s_log_ring[head++ & LOG_BIN_RING_MASK] = LOG_BIN_HDR(fmt - Image$$ER_LOG_FMT$$Base, words);
+    s_log_ring[head++ & LOG_BIN_RING_MASK] = rtc_get_counter();
+    for(i = 0; i < argc; i++){
+        if(!(str_mask & (1u << i))){
+            s_log_ring[head++ & LOG_BIN_RING_MASK] = arg[i];
+            continue;
+        }
+        //length word, then the bytes little endian, zero padded
+        s_log_ring[head++ & LOG_BIN_RING_MASK] = slen[i];
+        for(j = 0; j < slen[i]; j += 4){
+            w = 0;
+            memcpy(&w, (const char*)arg[i] + j, (slen[i] - j) < 4 ? (slen[i] - j) : 4);
+            s_log_ring[head++ & LOG_BIN_RING_MASK] = w;
+        }
+    }
+    s_log_head = head;
+    HAL_EXIT_CRITICAL_SECTION();
+
+    if(was_empty && s_log_task_id != 0xff)
+        osal_set_event(s_log_task_id, LOG_BIN_DRAIN_EVT);
+}
+
+/*********************************************************************
+ * @fn      log_bin_flush
+ *
+ * @brief   Send everything left in the ring, polling the UART registers.
+ *          For the fault path, where neither interrupts nor OSAL run.
+ *          A chunk that was in flight in the tx buffer is cut short, the
+ *          decoder resyncs on the next record.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void log_bin_flush(void)
+{
+    uint32_t tail = s_log_tail;
+    uint32_t head = s_log_head;
+    uint8_t* p;
+    int i;
+
+    while(tail != head){
+        p = (uint8_t*)&s_log_ring[tail++ & LOG_BIN_RING_MASK];
+        for(i = 0; i < 4; i++){
+            HAL_WAIT_CONDITION_TIMEOUT_WO_RETURN((AP_UART0->LSR & LSR_THRE), 100000);
+            AP_UART0->THR = p[i];
+        }
+    }
+    s_log_tail = tail;
+    HAL_WAIT_CONDITION_TIMEOUT_WO_RETURN((AP_UART0->LSR & LSR_TEMT), 100000);
+}
+
+void log_bin_init(void)
+{
+    uart_Cfg_t cfg = {
+    .tx_pin = P9,
+    .rx_pin = P10,
+    .rts_pin = GPIO_DUMMY,
+    .cts_pin = GPIO_DUMMY,
+    .baudrate = 115200,
+    .use_fifo = TRUE,
+    .hw_fwctrl = FALSE,
+    .use_tx_buf = TRUE,
+    .parity     = FALSE,
+    .evt_handler = log_bin_uart_evt,
+    };
+    hal_uart_init(cfg, UART0);
+    hal_uart_set_tx_buf(UART0, s_log_tx_buf, sizeof(s_log_tx_buf));
+
+    s_log_head = 0;
+    s_log_tail = 0;
+    s_log_dropped = 0;
+}
+
+/*********************************************************************
+ * @fn      log_bin_task_init
+ *
+ * @brief   Register the drain task. It should be the last entry of
+ *          tasksArr so the ring is only drained when the stack is idle.
+ *          A pending drain event keeps the system out of sleep, so the
+ *          ring is empty by the time it sleeps.
+ *
+ * @param   task_id - the OSAL assigned task ID
+ *
+ * @return  none
+ */
+void log_bin_task_init(uint8_t task_id)
+{
+    s_log_task_id = task_id;
+    if(s_log_head != s_log_tail)
+        osal_set_event(s_log_task_id, LOG_BIN_DRAIN_EVT);
+}
+
+uint16_t log_bin_process_event(uint8_t task_id, uint16_t events)
+{
+    VOID task_id;
+
+    if(events & LOG_BIN_DRAIN_EVT){
+        //the next chunk goes out from the TX_COMPLETED event
+        log_bin_drain();
+        return (events ^ LOG_BIN_DRAIN_EVT);
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+/**************************************************************************************************
+*******
+**************************************************************************************************/
+
+
+/*******************************************************************************
+* @file		log_bin.h
+* @brief	Deferred binary (tokenized) log backend
+* @version	0.0
+* @date		19. Oct. 2026
+* @author
+*
+* LOG() records are not formatted on target. The format string is placed in
+* the "log_fmt" section, which is never read at run time; its offset in that
+* section is the record ID. A record (sync/size/ID word, RTC timestamp and raw
+* 32-bit arguments) is appended to a RAM ring and sent out on UART0 later, in
+* chunks through the interrupt driven UART tx buffer, started from the lowest
+* priority OSAL task. log_bin_flush() sends the rest polled, for the hard fault
+* handler. tools/log_decode.py rebuilds
+* the text from the log_fmt section of the .axf image.
+*
+* Wire/ring record, little endian 32-bit words:
+*   word 0 : [31:16] ID, [15:8] number of argument words, [7:0] LOG_BIN_SYNC
+*   word 1 : RTC counter (32768Hz)
+*   word 2..: one raw word per argument, except %s
+*
+* A %s string may live in RAM, which the decoder cannot see, so it is copied
+* into the record: a length word then the bytes, padded to a word, cut at
+* LOG_BIN_STR_MAX. Every argument must fit in 32 bits, a wider one (long long,
+* double) fails to compile. %f is not supported.
+*
+*******************************************************************************/
+#ifndef __LOG_BIN_H__
+#define __LOG_BIN_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+
+#define LOG_BIN_SYNC            0xA5
+#define LOG_BIN_ID_DROPPED      0xFFFF  //argument 0: number of records lost
+#define LOG_BIN_ARGS_MAX        8
+#define LOG_BIN_STR_MAX         32      //bytes of a %s argument kept in the record
+
+#ifndef LOG_BIN_RING_WORDS
+#define LOG_BIN_RING_WORDS      256     //must be a power of 2, 1KB
+#endif
+
+#define LOG_BIN_DRAIN_EVT       0x0001
+
+//count the arguments following the format string, 0..LOG_BIN_ARGS_MAX
+#define LOG_BIN_ARGN(_f,_1,_2,_3,_4,_5,_6,_7,_8,N,...)  N
+#define LOG_BIN_NARGS(...)      LOG_BIN_ARGN(__VA_ARGS__,8,7,6,5,4,3,2,1,0,0)
+
+//arguments are read as one 32-bit word each, refuse wider ones at compile time
+#define LOG_BIN_WIDE(x)         (sizeof(0 ? (x) : (x)) > sizeof(uint32_t))
+#define LOG_BIN_CHECK(_f,_1,_2,_3,_4,_5,_6,_7,_8,...)   (void)sizeof(char[1 - 2 * (\
+        LOG_BIN_WIDE(_1) | LOG_BIN_WIDE(_2) | LOG_BIN_WIDE(_3) | LOG_BIN_WIDE(_4) |\
+        LOG_BIN_WIDE(_5) | LOG_BIN_WIDE(_6) | LOG_BIN_WIDE(_7) | LOG_BIN_WIDE(_8))])
+
+//a trailing 0 is appended by LOG_BIN() so that the variadic part is never empty
+#define LOG_BIN_EMIT(argc, fmt, ...)   do{\
+        static const char s_log_fmt[] __attribute__((section("log_fmt"), used)) = fmt;\
+        log_bin_write(s_log_fmt, argc, __VA_ARGS__);\
+    }while(0)
+
+#define LOG_BIN(...)            do{\
+        LOG_BIN_CHECK(__VA_ARGS__, 0, 0, 0, 0, 0, 0, 0, 0);\
+        LOG_BIN_EMIT(LOG_BIN_NARGS(__VA_ARGS__), __VA_ARGS__, 0);\
+    }while(0)
+
+void log_bin_write(const char* fmt, uint8_t argc, ...);
+void log_bin_flush(void);
+void log_bin_init(void);
+void log_bin_task_init(uint8_t task_id);
+uint16_t log_bin_process_event(uint8_t task_id, uint16_t events);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
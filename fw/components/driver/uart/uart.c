@@ -25,12 +25,34 @@
 
 #define UART_TX_BUFFER_SIZE   256
 
+#if DMAC_USE
+#define UART_DMA_MSIZE        DMA_BSIZE_8     //matches UART_FIFO_RX_TRIGGER (1/2 of 16 bytes)
+#define DMA_CH_SUSP           BIT(8)
+#define DMA_CH_FIFO_EMPTY     BIT(9)
+
+typedef struct _uart_Dma_Ctx_t{
+    bool            enable;
+    bool            rx_stall;       //ring full, rx channel not armed
+    uart_Dma_Cfg_t  cfg;
+    uint16_t        rx_wr;          //ring index the armed block starts at
+    uint16_t        rx_rd;
+    volatile uint16_t rx_cnt;       //bytes readable in the ring
+    uint16_t        rx_blk_len;     //length of the armed block
+    uart_Dma_Tx_Desc_t* tx_head;
+    uart_Dma_Tx_Desc_t* tx_tail;
+    uint16_t        tx_chunk;       //length of the chunk in flight
+}uart_Dma_Ctx_t;
+#endif
+
 typedef struct _uart_Context{
     bool          enable;
     
     uint8_t       tx_state;
     uart_Tx_Buf_t tx_buf;
     uart_Cfg_t    cfg;
+#if DMAC_USE
+    uart_Dma_Ctx_t dma;
+#endif
 }uart_Ctx_t;
 
 static uart_Ctx_t m_uartCtx[2] = {
@@ -183,6 +205,181 @@ static void irq_tx_empty_handler(UART_INDEX_e uart_index)
     }
 }
 
+#if DMAC_USE
+static void uart_dma_evt(UART_INDEX_e uart_index, uint8_t type, uart_Dma_Tx_Desc_t* desc)
+{
+    uart_Dma_Ctx_t* pdma = &(m_uartCtx[uart_index].dma);
+    uart_Dma_Evt_t evt;
+
+    if(pdma->cfg.evt_handler == NULL)
+        return;
+    evt.type = type;
+    evt.rx_len = pdma->rx_cnt;
+    evt.tx_desc = desc;
+    pdma->cfg.evt_handler(uart_index, &evt);
+}
+
+static void uart_dma_rx_arm(UART_INDEX_e uart_index)
+{
+    uart_Dma_Ctx_t* pdma = &(m_uartCtx[uart_index].dma);
+    AP_UART_TypeDef* cur_uart = (uart_index == UART1) ? AP_UART1 : AP_UART0;
+    DMA_CH_CFG_t cfgc;
+    uint16_t len;
+
+    //a block never wraps and never overwrites unread data
+    len = pdma->cfg.rx_buf_size - pdma->rx_wr;
+    if(len > pdma->cfg.rx_buf_size - pdma->rx_cnt)
+        len = pdma->cfg.rx_buf_size - pdma->rx_cnt;
+    if(len > DMA_GET_MAX_TRANSPORT_SIZE(pdma->cfg.rx_ch))
+        len = DMA_GET_MAX_TRANSPORT_SIZE(pdma->cfg.rx_ch);
+
+    if(len == 0){
+        pdma->rx_stall = TRUE;
+        pdma->rx_blk_len = 0;
+        return;
+    }
+    pdma->rx_stall = FALSE;
+    pdma->rx_blk_len = len;
+
+    cfgc.transf_size = len;
+    cfgc.sinc = DMA_INC_NCHG;
+    cfgc.src_tr_width = DMA_WIDTH_BYTE;
+    cfgc.src_msize = UART_DMA_MSIZE;
+    cfgc.src_addr = (uint32_t)&(cur_uart->RBR);
+    cfgc.dinc = DMA_INC_INC;
+    cfgc.dst_tr_width = DMA_WIDTH_BYTE;
+    cfgc.dst_msize = UART_DMA_MSIZE;
+    cfgc.dst_addr = (uint32_t)(pdma->cfg.rx_buf + pdma->rx_wr);
+    cfgc.enable_int = true;
+
+    hal_dma_config_channel(pdma->cfg.rx_ch, &cfgc);
+    hal_dma_start_channel(pdma->cfg.rx_ch);
+}
+
+//commit len bytes written at rx_wr
+static void uart_dma_rx_commit(UART_INDEX_e uart_index, uint16_t len)
+{
+    uart_Dma_Ctx_t* pdma = &(m_uartCtx[uart_index].dma);
+
+    pdma->rx_wr += len;
+    if(pdma->rx_wr >= pdma->cfg.rx_buf_size)
+        pdma->rx_wr = 0;
+    pdma->rx_cnt += len;
+}
+
+static void uart_dma_tx_kick(UART_INDEX_e uart_index)
+{
+    uart_Dma_Ctx_t* pdma = &(m_uartCtx[uart_index].dma);
+    AP_UART_TypeDef* cur_uart = (uart_index == UART1) ? AP_UART1 : AP_UART0;
+    uart_Dma_Tx_Desc_t* desc = pdma->tx_head;
+    DMA_CH_CFG_t cfgc;
+    uint16_t len;
+
+    len = desc->len - desc->offset;
+    if(len > DMA_GET_MAX_TRANSPORT_SIZE(pdma->cfg.tx_ch))
+        len = DMA_GET_MAX_TRANSPORT_SIZE(pdma->cfg.tx_ch);
+    pdma->tx_chunk = len;
+
+    cfgc.transf_size = len;
+    cfgc.sinc = DMA_INC_INC;
+    cfgc.src_tr_width = DMA_WIDTH_BYTE;
+    cfgc.src_msize = UART_DMA_MSIZE;
+    cfgc.src_addr = (uint32_t)(desc->data + desc->offset);
+    cfgc.dinc = DMA_INC_NCHG;
+    cfgc.dst_tr_width = DMA_WIDTH_BYTE;
+    cfgc.dst_msize = UART_DMA_MSIZE;
+    cfgc.dst_addr = (uint32_t)&(cur_uart->THR);
+    cfgc.enable_int = true;
+
+    hal_dma_config_channel(pdma->cfg.tx_ch, &cfgc);
+    hal_dma_start_channel(pdma->cfg.tx_ch);
+}
+
+static void uart_dma_ch_handler(DMA_CH_t ch)
+{
+    UART_INDEX_e uart_index;
+    uart_Dma_Ctx_t* pdma;
+    uart_Dma_Tx_Desc_t* desc;
+
+    for(uart_index = UART0; uart_index <= UART1; uart_index++){
+        pdma = &(m_uartCtx[uart_index].dma);
+        if(pdma->enable == FALSE)
+            continue;
+
+        if(ch == pdma->cfg.rx_ch){
+            uart_dma_rx_commit(uart_index, pdma->rx_blk_len);
+            uart_dma_rx_arm(uart_index);
+            uart_dma_evt(uart_index, pdma->rx_stall ? UART_DMA_EVT_RX_OVERFLOW : UART_DMA_EVT_RX_DATA, NULL);
+            return;
+        }
+
+        if(ch == pdma->cfg.tx_ch){
+            desc = pdma->tx_head;
+            desc->offset += pdma->tx_chunk;
+            if(desc->offset < desc->len){
+                uart_dma_tx_kick(uart_index);
+                return;
+            }
+            pdma->tx_head = desc->next;
+            if(pdma->tx_head == NULL)
+                pdma->tx_tail = NULL;
+            else
+                uart_dma_tx_kick(uart_index);
+            uart_dma_evt(uart_index, UART_DMA_EVT_TX_DONE, desc);
+            return;
+        }
+    }
+}
+
+/*
+ * Bytes below the DMA burst size stay in the rx FIFO and raise the character
+ * timeout. Collect what the armed block already moved, copy the FIFO tail into
+ * the ring by CPU, rearm and report an idle line.
+ */
+static bool uart_dma_irq(UART_INDEX_e uart_index, uint8_t irq_id)
+{
+    uart_Dma_Ctx_t* pdma = &(m_uartCtx[uart_index].dma);
+    AP_UART_TypeDef* cur_uart = (uart_index == UART1) ? AP_UART1 : AP_UART0;
+    uint16_t len;
+    uint8_t dropped = 0;
+    uint8_t data;
+
+    if(pdma->enable == FALSE)
+        return FALSE;
+
+    if(irq_id == RDA_IRQ && !pdma->rx_stall)
+        return TRUE;    //the DMA request drains the FIFO
+
+    if(irq_id != TIMEOUT_IRQ && irq_id != RDA_IRQ)
+        return FALSE;
+
+    if(!pdma->rx_stall){
+        AP_DMA_CH_CFG(pdma->cfg.rx_ch)->CFG |= DMA_CH_SUSP;
+        HAL_WAIT_CONDITION_TIMEOUT_WO_RETURN((AP_DMA_CH_CFG(pdma->cfg.rx_ch)->CFG & DMA_CH_FIFO_EMPTY), 1000);
+        len = AP_DMA_CH_CFG(pdma->cfg.rx_ch)->DAR - (uint32_t)(pdma->cfg.rx_buf + pdma->rx_wr);
+        hal_dma_stop_channel(pdma->cfg.rx_ch);
+        AP_DMA_CH_CFG(pdma->cfg.rx_ch)->CFG &= ~DMA_CH_SUSP;
+        uart_dma_rx_commit(uart_index, len);
+    }
+
+    len = cur_uart->RFL;
+    while(len--){
+        data = (uint8_t)(cur_uart->RBR & 0xff);
+        if(pdma->rx_cnt < pdma->cfg.rx_buf_size){
+            pdma->cfg.rx_buf[pdma->rx_wr] = data;
+            uart_dma_rx_commit(uart_index, 1);
+        }
+        else{
+            dropped = 1;
+        }
+    }
+
+    uart_dma_rx_arm(uart_index);
+    uart_dma_evt(uart_index, dropped ? UART_DMA_EVT_RX_OVERFLOW : UART_DMA_EVT_RX_IDLE, NULL);
+    return TRUE;
+}
+#endif
+
 static int uart_hw_init(UART_INDEX_e uart_index)
 {
     uart_Cfg_t* pcfg;
@@ -246,6 +443,12 @@ static int uart_hw_init(UART_INDEX_e uart_index)
 	
     if(pcfg->use_tx_buf)    
         cur_uart->IER |= IER_ETBEI;    
+
+#if DMAC_USE
+    //DMA mode 1: rx/tx requests follow the FIFO trigger levels
+    if(m_uartCtx[uart_index].dma.enable)
+        cur_uart->SDMAM = 1;
+#endif
     
 	if(uart_index== UART0){
 		JUMP_FUNCTION(V11_IRQ_HANDLER)   =   (uint32_t)&hal_UART0_IRQHandler;
@@ -314,6 +517,11 @@ static int uart_hw_deinit(UART_INDEX_e uart_index)
 void __attribute__((used)) hal_UART0_IRQHandler(void)
 {
     uint8_t IRQ_ID= (AP_UART0->IIR & 0x0f);
+
+#if DMAC_USE
+    if(uart_dma_irq(UART0, IRQ_ID))
+        return;
+#endif
     
     //if(m_uartCtx[UART0].enable == FALSE)
     //    return;
@@ -343,6 +551,11 @@ void __attribute__((used)) hal_UART1_IRQHandler(void)
 {
     uint8_t IRQ_ID= (AP_UART1->IIR & 0x0f);
 
+#if DMAC_USE
+    if(uart_dma_irq(UART1, IRQ_ID))
+        return;
+#endif
+
     //if(m_uartCtx[UART1].enable == FALSE)
     //   return;
         
@@ -469,3 +682,191 @@ int hal_uart_send_byte(UART_INDEX_e uart_index,unsigned char data)
     
     return PPlus_SUCCESS;
 }	
+
+#if DMAC_USE
+/**************************************************************************************
+ * @fn          hal_uart_dma_init
+ *
+ * @brief       Switch an initialized uart (use_fifo = TRUE, use_tx_buf = FALSE) to the
+ *              DMA transport. hal_dma_init() must have been called. The rx channel
+ *              stays armed and the uart holds its own pwrmgr lock, so the system does
+ *              not sleep until hal_uart_dma_deinit(). The MOD_DMA lock can't be relied
+ *              on, hal_dma_stop_channel() drops it when the tx channel finishes.
+ *              Only DMA_CH_0 moves more than 31 bytes per block.
+ *
+ * input parameters
+ *
+ * @param       uart_index: UART0 or UART1
+ *              cfg: channels, rx ring and event handler
+ *
+ * output parameters
+ *
+ * @param       None.
+ *
+ * @return      refer error.h.
+ **************************************************************************************/
+int hal_uart_dma_init(UART_INDEX_e uart_index, uart_Dma_Cfg_t* cfg)
+{
+    uart_Dma_Ctx_t* pdma = &(m_uartCtx[uart_index].dma);
+    AP_UART_TypeDef* cur_uart = (uart_index == UART1) ? AP_UART1 : AP_UART0;
+    HAL_DMA_t ch_cfg;
+    int ret;
+
+    if(m_uartCtx[uart_index].enable == FALSE || pdma->enable)
+        return PPlus_ERR_INVALID_STATE;
+
+    if(m_uartCtx[uart_index].cfg.use_fifo == FALSE || m_uartCtx[uart_index].cfg.use_tx_buf)
+        return PPlus_ERR_NOT_SUPPORTED;
+
+    if(cfg->rx_buf == NULL || cfg->rx_buf_size == 0 || cfg->rx_ch == cfg->tx_ch)
+        return PPlus_ERR_INVALID_PARAM;
+
+    ch_cfg.evt_handler = uart_dma_ch_handler;
+    ch_cfg.dma_channel = cfg->rx_ch;
+    ret = hal_dma_init_channel(ch_cfg);
+    if(ret != PPlus_SUCCESS)
+        return ret;
+    ch_cfg.dma_channel = cfg->tx_ch;
+    ret = hal_dma_init_channel(ch_cfg);
+    if(ret != PPlus_SUCCESS){
+        hal_dma_deinit_channel(cfg->rx_ch);
+        return ret;
+    }
+
+    HAL_ENTER_CRITICAL_SECTION();
+    memset(pdma, 0, sizeof(uart_Dma_Ctx_t));
+    memcpy(&(pdma->cfg), cfg, sizeof(uart_Dma_Cfg_t));
+    pdma->enable = TRUE;
+    cur_uart->SDMAM = 1;
+    uart_dma_rx_arm(uart_index);
+    HAL_EXIT_CRITICAL_SECTION();
+
+    //use_tx_buf is off, so nothing else takes or drops this lock meanwhile
+    hal_pwrmgr_lock((uart_index == UART0) ? MOD_UART0 : MOD_UART1);
+
+    return PPlus_SUCCESS;
+}
+
+int hal_uart_dma_deinit(UART_INDEX_e uart_index)
+{
+    uart_Dma_Ctx_t* pdma = &(m_uartCtx[uart_index].dma);
+    AP_UART_TypeDef* cur_uart = (uart_index == UART1) ? AP_UART1 : AP_UART0;
+
+    if(pdma->enable == FALSE)
+        return PPlus_ERR_INVALID_STATE;
+
+    HAL_ENTER_CRITICAL_SECTION();
+    if(!pdma->rx_stall)
+        hal_dma_stop_channel(pdma->cfg.rx_ch);
+    if(pdma->tx_head)
+        hal_dma_stop_channel(pdma->cfg.tx_ch);
+    cur_uart->SDMAM = 0;
+    pdma->enable = FALSE;
+    HAL_EXIT_CRITICAL_SECTION();
+
+    hal_dma_deinit_channel(pdma->cfg.rx_ch);
+    hal_dma_deinit_channel(pdma->cfg.tx_ch);
+    hal_pwrmgr_unlock((uart_index == UART0) ? MOD_UART0 : MOD_UART1);
+    return PPlus_SUCCESS;
+}
+
+/**************************************************************************************
+ * @fn          hal_uart_dma_send
+ *
+ * @brief       Queue a descriptor. desc->data is sent in place, descriptors complete
+ *              in order with UART_DMA_EVT_TX_DONE.
+ *
+ * input parameters
+ *
+ * @param       uart_index: UART0 or UART1
+ *              desc: descriptor with data and len set, owned by the driver until done
+ *
+ * output parameters
+ *
+ * @param       None.
+ *
+ * @return      refer error.h.
+ **************************************************************************************/
+int hal_uart_dma_send(UART_INDEX_e uart_index, uart_Dma_Tx_Desc_t* desc)
+{
+    uart_Dma_Ctx_t* pdma = &(m_uartCtx[uart_index].dma);
+
+    if(pdma->enable == FALSE)
+        return PPlus_ERR_INVALID_STATE;
+
+    if(desc == NULL || desc->data == NULL || desc->len == 0)
+        return PPlus_ERR_INVALID_PARAM;
+
+    desc->next = NULL;
+    desc->offset = 0;
+
+    HAL_ENTER_CRITICAL_SECTION();
+    if(pdma->tx_tail){
+        pdma->tx_tail->next = desc;
+        pdma->tx_tail = desc;
+    }
+    else{
+        pdma->tx_head = desc;
+        pdma->tx_tail = desc;
+        uart_dma_tx_kick(uart_index);
+    }
+    HAL_EXIT_CRITICAL_SECTION();
+
+    return PPlus_SUCCESS;
+}
+
+/**************************************************************************************
+ * @fn          hal_uart_dma_rx_peek
+ *
+ * @brief       Get the contiguous readable part of the rx ring without copying.
+ *              Call hal_uart_dma_rx_consume() once the data has been used.
+ *
+ * input parameters
+ *
+ * @param       uart_index: UART0 or UART1
+ *
+ * output parameters
+ *
+ * @param       pdata: start of the readable data
+ *
+ * @return      number of contiguous bytes at *pdata.
+ **************************************************************************************/
+uint16_t hal_uart_dma_rx_peek(UART_INDEX_e uart_index, uint8_t** pdata)
+{
+    uart_Dma_Ctx_t* pdma = &(m_uartCtx[uart_index].dma);
+    uint16_t len;
+
+    if(pdma->enable == FALSE)
+        return 0;
+
+    HAL_ENTER_CRITICAL_SECTION();
+    len = pdma->rx_cnt;
+    HAL_EXIT_CRITICAL_SECTION();
+
+    if(len > pdma->cfg.rx_buf_size - pdma->rx_rd)
+        len = pdma->cfg.rx_buf_size - pdma->rx_rd;
+    *pdata = pdma->cfg.rx_buf + pdma->rx_rd;
+    return len;
+}
+
+int hal_uart_dma_rx_consume(UART_INDEX_e uart_index, uint16_t len)
+{
+    uart_Dma_Ctx_t* pdma = &(m_uartCtx[uart_index].dma);
+
+    if(pdma->enable == FALSE)
+        return PPlus_ERR_INVALID_STATE;
+
+    HAL_ENTER_CRITICAL_SECTION();
+    if(len > pdma->rx_cnt)
+        len = pdma->rx_cnt;
+    pdma->rx_cnt -= len;
+    pdma->rx_rd += len;
+    if(pdma->rx_rd >= pdma->cfg.rx_buf_size)
+        pdma->rx_rd -= pdma->cfg.rx_buf_size;
+    if(pdma->rx_stall)
+        uart_dma_rx_arm(uart_index);
+    HAL_EXIT_CRITICAL_SECTION();
+
+    return PPlus_SUCCESS;
+}
+#endif
@@ -22,6 +22,9 @@ extern "C" {
 	
 #include "types.h"
 #include "gpio.h"
+#if DMAC_USE
+#include "dma.h"
+#endif
 
 #define UART_TX_FIFO_SIZE    16
 #define UART_RX_FIFO_SIZE    16
@@ -134,12 +137,56 @@ typedef struct _uart_Tx_Buf_t{
 	uint8_t*  tx_buf;
 }uart_Tx_Buf_t;
 
+#if DMAC_USE
+/*
+ * DMA transport. RX lands in a caller supplied circular buffer, TX descriptors
+ * point at caller buffers (no copy) and complete in queue order. The buffer of
+ * a queued descriptor must stay valid until UART_DMA_EVT_TX_DONE.
+ */
+typedef struct _uart_Dma_Tx_Desc_t{
+	struct _uart_Dma_Tx_Desc_t* next;
+	const uint8_t*  data;
+	uint16_t        len;
+	uint16_t        offset;     //driver use
+}uart_Dma_Tx_Desc_t;
+
+typedef enum{
+  UART_DMA_EVT_RX_DATA = 1,     //a DMA block landed in the rx ring
+  UART_DMA_EVT_RX_IDLE,         //rx line idle, ring holds everything received
+  UART_DMA_EVT_RX_OVERFLOW,     //rx ring full, incoming data was dropped
+  UART_DMA_EVT_TX_DONE,         //tx_desc handed to the uart FIFO
+} uart_Dma_Evt_Type_t;
+
+typedef struct _uart_Dma_Evt_t{
+  uint8_t               type;
+  uint16_t              rx_len;     //bytes readable in the rx ring
+  uart_Dma_Tx_Desc_t*   tx_desc;
+}uart_Dma_Evt_t;
+
+typedef void (*uart_Dma_Hdl_t)(UART_INDEX_e uart_index, uart_Dma_Evt_t* pev);
+
+typedef struct _uart_Dma_Cfg_t{
+	DMA_CH_t        rx_ch;
+	DMA_CH_t        tx_ch;
+	uint8_t*        rx_buf;
+	uint16_t        rx_buf_size;
+	uart_Dma_Hdl_t  evt_handler;
+}uart_Dma_Cfg_t;
+#endif
+
 int hal_uart_init(uart_Cfg_t cfg,UART_INDEX_e uart_index);
 int hal_uart_deinit(UART_INDEX_e uart_index);
 int hal_uart_set_tx_buf(UART_INDEX_e uart_index,uint8_t* buf, uint16_t size);
 int hal_uart_get_tx_ready(UART_INDEX_e uart_index);
 int hal_uart_send_buff(UART_INDEX_e uart_index,uint8_t *buff,uint16_t len);
 int hal_uart_send_byte(UART_INDEX_e uart_index,unsigned char data);
+#if DMAC_USE
+int hal_uart_dma_init(UART_INDEX_e uart_index, uart_Dma_Cfg_t* cfg);
+int hal_uart_dma_deinit(UART_INDEX_e uart_index);
+int hal_uart_dma_send(UART_INDEX_e uart_index, uart_Dma_Tx_Desc_t* desc);
+uint16_t hal_uart_dma_rx_peek(UART_INDEX_e uart_index, uint8_t** pdata);
+int hal_uart_dma_rx_consume(UART_INDEX_e uart_index, uint16_t len);
+#endif
 void __attribute__((weak)) hal_UART0_IRQHandler(void);
 void __attribute__((weak)) hal_UART1_IRQHandler(void);
 
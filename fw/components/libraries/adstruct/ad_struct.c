@@ -0,0 +1,416 @@
+/**************************************************************************************************
+*******
+**************************************************************************************************/
+
+
+/*
+AD structure parser and builder, see ad_struct.h.
+*/
+
+#include <string.h>
+#include "ad_struct.h"
+
+#define AD_U16(b)       ((uint16_t)(b)[0] | ((uint16_t)(b)[1] << 8))
+
+/*********************************************************************
+ * @fn      ad_iter_init
+ *
+ * @brief   Start walking the AD structures of a buffer.
+ *
+ * @param   it   - iterator
+ *          data - advertising or scan response data
+ *          len  - length of data
+ *
+ * @return  none
+ */
+void ad_iter_init(ad_iter_t* it, const uint8_t* data, uint8_t len)
+{
+  it->p = data;
+  it->end = data + len;
+}
+
+/*********************************************************************
+ * @fn      ad_iter_next
+ *
+ * @brief   Get the next AD structure. field->data points into the buffer.
+ *
+ * @param   it    - iterator
+ *          field - a place to put the field
+ *
+ * @return  1 if there is a field, 0 at the end of the data or at a field
+ *          that runs past it
+ */
+int ad_iter_next(ad_iter_t* it, ad_field_t* field)
+{
+  const uint8_t* p = it->p;
+  uint8_t n;
+
+  if(p >= it->end)
+    return 0;
+
+  //n counts the type and the data, so it must fit after the length byte
+  n = p[0];
+  if(n == 0 || n > it->end - p - 1){
+    it->p = it->end;
+    return 0;
+  }
+
+  field->type = p[1];
+  field->len = n - 1;
+  field->data = p + AD_HDR_SIZE;
+  it->p = p + 1 + n;
+  return 1;
+}
+
+/*********************************************************************
+ * @fn      ad_find
+ *
+ * @brief   Find the first AD structure of a type.
+ *
+ * @param   data  - advertising or scan response data
+ *          len   - length of data
+ *          type  - AD type
+ *          field - a place to put the field
+ *
+ * @return  1 if found
+ */
+int ad_find(const uint8_t* data, uint8_t len, uint8_t type, ad_field_t* field)
+{
+  ad_iter_t it;
+
+  ad_iter_init(&it, data, len);
+  while(ad_iter_next(&it, field)){
+    if(field->type == type)
+      return 1;
+  }
+  return 0;
+}
+
+/*********************************************************************
+ * @fn      ad_find_flags
+ *
+ * @brief   Get the flags.
+ *
+ * @param   data  - advertising data
+ *          len   - length of data
+ *          flags - a place to put them
+ *
+ * @return  1 if found
+ */
+int ad_find_flags(const uint8_t* data, uint8_t len, uint8_t* flags)
+{
+  ad_field_t field;
+
+  if(ad_find(data, len, AD_TYPE_FLAGS, &field) && field.len >= 1){
+    *flags = field.data[0];
+    return 1;
+  }
+  return 0;
+}
+
+/*********************************************************************
+ * @fn      ad_find_manuf
+ *
+ * @brief   Find manufacturer specific data of a company.
+ *
+ * @param   data    - advertising or scan response data
+ *          len     - length of data
+ *          company - company identifier
+ *          field   - a place to put the field, data and len are what
+ *                    follows the company identifier
+ *
+ * @return  1 if found
+ */
+int ad_find_manuf(const uint8_t* data, uint8_t len, uint16_t company, ad_field_t* field)
+{
+  ad_iter_t it;
+
+  ad_iter_init(&it, data, len);
+  while(ad_iter_next(&it, field)){
+    if(field->type == AD_TYPE_MANUFACTURER && field->len >= 2 && AD_U16(field->data) == company){
+      field->data += 2;
+      field->len -= 2;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*********************************************************************
+ * @fn      ad_find_svc_data16
+ *
+ * @brief   Find service data of a 16-bit service UUID.
+ *
+ * @param   data  - advertising or scan response data
+ *          len   - length of data
+ *          uuid  - service UUID
+ *          field - a place to put the field, data and len are what
+ *                  follows the UUID
+ *
+ * @return  1 if found
+ */
+int ad_find_svc_data16(const uint8_t* data, uint8_t len, uint16_t uuid, ad_field_t* field)
+{
+  ad_iter_t it;
+
+  ad_iter_init(&it, data, len);
+  while(ad_iter_next(&it, field)){
+    if(field->type == AD_TYPE_SVC_DATA16 && field->len >= 2 && AD_U16(field->data) == uuid){
+      field->data += 2;
+      field->len -= 2;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*********************************************************************
+ * @fn      ad_find_svc_data128
+ *
+ * @brief   Find service data of a 128-bit service UUID.
+ *
+ * @param   data  - advertising or scan response data
+ *          len   - length of data
+ *          uuid  - service UUID, in air (little endian) byte order
+ *          field - a place to put the field, data and len are what
+ *                  follows the UUID
+ *
+ * @return  1 if found
+ */
+int ad_find_svc_data128(const uint8_t* data, uint8_t len, const uint8_t* uuid, ad_field_t* field)
+{
+  ad_iter_t it;
+
+  ad_iter_init(&it, data, len);
+  while(ad_iter_next(&it, field)){
+    if(field->type == AD_TYPE_SVC_DATA128 && field->len >= AD_UUID128_SIZE &&
+       memcmp(field->data, uuid, AD_UUID128_SIZE) == 0){
+      field->data += AD_UUID128_SIZE;
+      field->len -= AD_UUID128_SIZE;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*********************************************************************
+ * @fn      ad_find_name
+ *
+ * @brief   Find the complete local name, or else the shortened one.
+ *          The name isn't terminated.
+ *
+ * @param   data  - advertising or scan response data
+ *          len   - length of data
+ *          field - a place to put the field
+ *
+ * @return  1 if found
+ */
+int ad_find_name(const uint8_t* data, uint8_t len, ad_field_t* field)
+{
+  ad_iter_t it;
+  ad_field_t f;
+  int found = 0;
+
+  ad_iter_init(&it, data, len);
+  while(ad_iter_next(&it, &f)){
+    if(f.type == AD_TYPE_NAME_COMPLETE){
+      *field = f;
+      return 1;
+    }
+    if(f.type == AD_TYPE_NAME_SHORT && !found){
+      *field = f;
+      found = 1;
+    }
+  }
+  return found;
+}
+
+/*********************************************************************
+ * @fn      ad_has_uuid16
+ *
+ * @brief   Check the 16-bit service UUID lists for a UUID.
+ *
+ * @param   data - advertising or scan response data
+ *          len  - length of data
+ *          uuid - service UUID
+ *
+ * @return  1 if listed
+ */
+int ad_has_uuid16(const uint8_t* data, uint8_t len, uint16_t uuid)
+{
+  ad_iter_t it;
+  ad_field_t f;
+  uint8_t i;
+
+  ad_iter_init(&it, data, len);
+  while(ad_iter_next(&it, &f)){
+    if(f.type != AD_TYPE_UUID16_MORE && f.type != AD_TYPE_UUID16_ALL)
+      continue;
+    for(i = 0; i + 1 < f.len; i += 2){
+      if(AD_U16(f.data + i) == uuid)
+        return 1;
+    }
+  }
+  return 0;
+}
+
+/*********************************************************************
+ * @fn      ad_build_init
+ *
+ * @brief   Start packing AD structures into a buffer.
+ *
+ * @param   b    - builder
+ *          buf  - buffer
+ *          size - size of buf, AD_DATA_MAX for legacy advertising
+ *
+ * @return  none
+ */
+void ad_build_init(ad_builder_t* b, uint8_t* buf, uint8_t size)
+{
+  b->buf = buf;
+  b->size = size;
+  b->len = 0;
+  b->err = 0;
+}
+
+/*********************************************************************
+ * @fn      ad_build_field
+ *
+ * @brief   Add an AD structure.
+ *
+ * @param   b    - builder
+ *          type - AD type
+ *          data - data of the field, NULL to zero it
+ *          len  - length of data
+ *
+ * @return  the data of the field in the buffer, NULL if it doesn't fit
+ */
+uint8_t* ad_build_field(ad_builder_t* b, uint8_t type, const void* data, uint8_t len)
+{
+  uint8_t* p;
+
+  if(b->err || AD_SIZE(len) > b->size - b->len){
+    b->err = 1;
+    return NULL;
+  }
+
+  p = b->buf + b->len;
+  p[0] = len + 1;
+  p[1] = type;
+  if(data)
+    memcpy(p + AD_HDR_SIZE, data, len);
+  else
+    memset(p + AD_HDR_SIZE, 0, len);
+
+  b->len += AD_SIZE(len);
+  return p + AD_HDR_SIZE;
+}
+
+/*********************************************************************
+ * @fn      ad_build_flags
+ *
+ * @brief   Add the flags.
+ *
+ * @param   b     - builder
+ *          flags - GAP_ADTYPE_FLAGS_xxx
+ *
+ * @return  the flags in the buffer, NULL if they don't fit
+ */
+uint8_t* ad_build_flags(ad_builder_t* b, uint8_t flags)
+{
+  return ad_build_field(b, AD_TYPE_FLAGS, &flags, 1);
+}
+
+/*
+add a field that starts with a 16-bit id, returns what follows the id
+*/
+static uint8_t* ad_build_id16(ad_builder_t* b, uint8_t type, uint16_t id, const void* data, uint8_t len)
+{
+  uint8_t* p;
+
+  if(len > 0xFF - 2){
+    b->err = 1;
+    return NULL;
+  }
+
+  p = ad_build_field(b, type, NULL, len + 2);
+  if(p == NULL)
+    return NULL;
+
+  p[0] = (uint8_t)id;
+  p[1] = (uint8_t)(id >> 8);
+  if(data)
+    memcpy(p + 2, data, len);
+  return p + 2;
+}
+
+/*********************************************************************
+ * @fn      ad_build_manuf
+ *
+ * @brief   Add manufacturer specific data.
+ *
+ * @param   b       - builder
+ *          company - company identifier
+ *          data    - data after the company identifier, NULL to zero it
+ *          len     - length of data
+ *
+ * @return  the data after the company identifier in the buffer, NULL if
+ *          it doesn't fit
+ */
+uint8_t* ad_build_manuf(ad_builder_t* b, uint16_t company, const void* data, uint8_t len)
+{
+  return ad_build_id16(b, AD_TYPE_MANUFACTURER, company, data, len);
+}
+
+/*********************************************************************
+ * @fn      ad_build_svc_data16
+ *
+ * @brief   Add service data of a 16-bit service UUID.
+ *
+ * @param   b    - builder
+ *          uuid - service UUID
+ *          data - data after the UUID, NULL to zero it
+ *          len  - length of data
+ *
+ * @return  the data after the UUID in the buffer, NULL if it doesn't fit
+ */
+uint8_t* ad_build_svc_data16(ad_builder_t* b, uint16_t uuid, const void* data, uint8_t len)
+{
+  return ad_build_id16(b, AD_TYPE_SVC_DATA16, uuid, data, len);
+}
+
+/*********************************************************************
+ * @fn      ad_build_name
+ *
+ * @brief   Add the local name, shortened to the room that is left if the
+ *          complete name doesn't fit.
+ *
+ * @param   b    - builder
+ *          name - name, not terminated
+ *          len  - length of name
+ *
+ * @return  the name in the buffer, NULL if not even one character fits
+ */
+uint8_t* ad_build_name(ad_builder_t* b, const char* name, uint8_t len)
+{
+  int room = b->size - b->len - AD_HDR_SIZE;
+
+  if(!b->err && len > room && room > 0)
+    return ad_build_field(b, AD_TYPE_NAME_SHORT, name, (uint8_t)room);
+
+  return ad_build_field(b, AD_TYPE_NAME_COMPLETE, name, len);
+}
+
+/*********************************************************************
+ * @fn      ad_build_len
+ *
+ * @brief   Length of the fields added so far.
+ *
+ * @param   b - builder
+ *
+ * @return  length, check b->err for fields that were left out
+ */
+uint8_t ad_build_len(const ad_builder_t* b)
+{
+  return b->len;
+}
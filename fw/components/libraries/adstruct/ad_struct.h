@@ -0,0 +1,89 @@
+/**************************************************************************************************
+*******
+**************************************************************************************************/
+
+
+#ifndef _AD_STRUCT_H__
+#define _AD_STRUCT_H__
+
+#include <stdint.h>
+
+/*
+AD structures of advertising and scan response data: length, type, data,
+where length counts the type and the data.
+
+The parser walks the original buffer, fields point into it and nothing is
+copied. Every field is checked against the end of the buffer; a length of 0
+ends the data, a field running past the end ends it as malformed.
+
+The builder packs fields into a caller buffer and hands back a pointer to
+the data of each field, so a value can be changed in place later. A field
+that doesn't fit is not added and the builder stays in error.
+*/
+
+//AD types, same values as GAP_ADTYPE_xxx in gap.h
+#define AD_TYPE_FLAGS               0x01
+#define AD_TYPE_UUID16_MORE         0x02
+#define AD_TYPE_UUID16_ALL          0x03
+#define AD_TYPE_UUID128_MORE        0x06
+#define AD_TYPE_UUID128_ALL         0x07
+#define AD_TYPE_NAME_SHORT          0x08
+#define AD_TYPE_NAME_COMPLETE       0x09
+#define AD_TYPE_TX_POWER            0x0A
+#define AD_TYPE_SVC_DATA16          0x16
+#define AD_TYPE_SVC_DATA128         0x21
+#define AD_TYPE_MANUFACTURER        0xFF
+
+#define AD_DATA_MAX                 31      //legacy advertising or scan response data
+#define AD_HDR_SIZE                 2       //length and type
+#define AD_UUID128_SIZE             16
+
+//size of a field with len bytes of data, and of the data after a 16-bit id
+#define AD_SIZE(len)                (AD_HDR_SIZE + (len))
+#define AD_SIZE_ID16(len)           (AD_HDR_SIZE + 2 + (len))
+#define AD_SIZE_UUID128(len)        (AD_HDR_SIZE + AD_UUID128_SIZE + (len))
+
+/*
+Compile time check of a layout, fails the build if size exceeds max:
+  AD_CHECK(adv, AD_SIZE(1) + AD_SIZE_ID16(23), AD_DATA_MAX);
+*/
+#define AD_CHECK(name, size, max)   typedef char ad_check_##name[((size) <= (max)) ? 1 : -1]
+
+typedef struct{
+  const uint8_t*  p;
+  const uint8_t*  end;
+}ad_iter_t;
+
+typedef struct{
+  uint8_t         type;
+  uint8_t         len;        //bytes at data
+  const uint8_t*  data;
+}ad_field_t;
+
+typedef struct{
+  uint8_t*        buf;
+  uint8_t         size;
+  uint8_t         len;
+  uint8_t         err;
+}ad_builder_t;
+
+void ad_iter_init(ad_iter_t* it, const uint8_t* data, uint8_t len);
+int ad_iter_next(ad_iter_t* it, ad_field_t* field);
+
+int ad_find(const uint8_t* data, uint8_t len, uint8_t type, ad_field_t* field);
+int ad_find_flags(const uint8_t* data, uint8_t len, uint8_t* flags);
+int ad_find_manuf(const uint8_t* data, uint8_t len, uint16_t company, ad_field_t* field);
+int ad_find_svc_data16(const uint8_t* data, uint8_t len, uint16_t uuid, ad_field_t* field);
+int ad_find_svc_data128(const uint8_t* data, uint8_t len, const uint8_t* uuid, ad_field_t* field);
+int ad_find_name(const uint8_t* data, uint8_t len, ad_field_t* field);
+int ad_has_uuid16(const uint8_t* data, uint8_t len, uint16_t uuid);
+
+void ad_build_init(ad_builder_t* b, uint8_t* buf, uint8_t size);
+uint8_t* ad_build_field(ad_builder_t* b, uint8_t type, const void* data, uint8_t len);
+uint8_t* ad_build_flags(ad_builder_t* b, uint8_t flags);
+uint8_t* ad_build_manuf(ad_builder_t* b, uint16_t company, const void* data, uint8_t len);
+uint8_t* ad_build_svc_data16(ad_builder_t* b, uint16_t uuid, const void* data, uint8_t len);
+uint8_t* ad_build_name(ad_builder_t* b, const char* name, uint8_t len);
+uint8_t ad_build_len(const ad_builder_t* b);
+
+#endif // _AD_STRUCT_H__
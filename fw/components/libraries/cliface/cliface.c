@@ -11,11 +11,42 @@
 
 /* --------------------------------------------- Header File Inclusion */
 #include "cliface.h"
+#include <stddef.h>
 
 //#ifdef HAVE_CLI
 
 /* --------------------------------------------- Global Definitions */
 
+/* --------------------------------------------- Static Functions */
+/* Compare a length bounded name with a '\0' terminated table name, strcmp() order */
+static int32_t cli_name_compare
+               (
+                   /* IN */ const uint8_t * name,
+                   /* IN */ uint16_t        name_len,
+                   /* IN */ const uint8_t * entry
+               )
+{
+    uint16_t i;
+
+    for (i = 0; i < name_len; i++)
+    {
+        if ('\0' == entry[i])
+        {
+            return 1;
+        }
+
+        if (name[i] != entry[i])
+        {
+            return (int32_t)name[i] - (int32_t)entry[i];
+        }
+    }
+
+    return ('\0' == entry[i]) ? 0 : -1;
+}
+
+#define CLI_ENTRY_NAME(list, index, entry_size, name_offset) \
+        (*(const uint8_t * const *)((const uint8_t *)(list) + ((index) * (entry_size)) + (name_offset)))
+
 /* --------------------------------------------- Function */
 /**
  *  \fn CLI_init
@@ -44,7 +75,7 @@ uint16_t CLI_init
  *
  *  \param [in] buffer        Buffer containing a command
  *  \param [in] buffer_len    Length of command in buffer
- *  \param [in] cmd_list      Command List
+ *  \param [in] cmd_list      Command List, sorted by name (CLI_check_list)
  *  \param [in] cmd_count     Number of command in the list
  *
  *  \return EM_SUCCESS or an error code indicating reason for failure
@@ -61,7 +92,8 @@ uint16_t CLI_process_line
     uint8_t  * argv[CLI_MAX_ARGS];
 
     uint8_t  * cmd;
-    uint32_t   index;
+    uint16_t   cmd_len;
+    const CLI_COMMAND * match;
 
     /* TBD: Parameter Validation */
     CLI_NULL_CHECK(buffer);
@@ -78,6 +110,10 @@ uint16_t CLI_process_line
         return 0xffff;
     }
 
+    /* Length of the command name, tokenization below does not change it */
+    for (cmd_len = 0; (cmd_len < buffer_len) && ('\0' != buffer[cmd_len]) &&
+         !CLI_IS_CMD_SEPARATOR(buffer[cmd_len]); cmd_len++);
+
     /**
      * Got the initial command.
      * Parse the remaining command line to get the arguments.
@@ -97,6 +133,14 @@ uint16_t CLI_process_line
         /* Check if this is start of a new argument */
         else if ('\0' == (*(cmd - 1)))
         {
+            if (CLI_MAX_ARGS == argc)
+            {
+                CLI_ERR(
+                "[CLI] Too many arguments\n");
+
+                return 0xffff;
+            }
+
             argv[argc++] = cmd;
         }
         else
@@ -118,22 +162,210 @@ uint16_t CLI_process_line
         }
     }
 
-    /* Identified command name */
-    cmd = buffer;
+    /* Search command in the sorted list and call associated callback */
+    match = (const CLI_COMMAND *)CLI_find
+            (
+                buffer,
+                cmd_len,
+                cmd_list,
+                cmd_count,
+                sizeof(CLI_COMMAND),
+                offsetof(CLI_COMMAND, cmd)
+            );
+
+    if (NULL == match)
+    {
+        CLI_ERR(
+        "[CLI] Unknown command\n");
+
+        return 0xffff;
+    }
+
+    match->cmd_hdlr(argc, argv);
+
+    return 0;
+}
 
-    /* Search command and call associated callback */
-    for (index = 0; index < cmd_count; index++)
+/**
+ *  \brief Find a command by name
+ *
+ *  \Description
+ *  This routine does a binary search of a command table. Any table whose
+ *  entries hold a '\0' terminated name pointer can be searched, CLI_COMMAND
+ *  or a front-end specific one. The table has to be sorted by name in
+ *  strcmp() order when it is written, see CLI_check_list().
+ *
+ *  \param [in] name          Command name, need not be '\0' terminated
+ *  \param [in] name_len      Length of the name
+ *  \param [in] list          Command table
+ *  \param [in] count         Number of entries in the table
+ *  \param [in] entry_size    sizeof() one entry
+ *  \param [in] name_offset   offsetof() the name pointer in an entry
+ *
+ *  \return Matching entry or NULL
+ */
+const void * CLI_find
+             (
+                 /* IN */ const uint8_t * name,
+                 /* IN */ uint16_t        name_len,
+                 /* IN */ const void    * list,
+                 /* IN */ uint32_t        count,
+                 /* IN */ uint32_t        entry_size,
+                 /* IN */ uint32_t        name_offset
+             )
+{
+    uint32_t lo, hi, mid;
+    int32_t  cmp;
+
+    lo = 0;
+    hi = count;
+
+    while (lo < hi)
     {
-        if (0 == CLI_STR_COMPARE(buffer, cmd_list[index].cmd))
+        mid = (lo + hi) >> 1;
+        cmp = cli_name_compare(name, name_len, CLI_ENTRY_NAME(list, mid, entry_size, name_offset));
+
+        if (0 == cmp)
         {
-            cmd_list[index].cmd_hdlr(argc, argv);
-            break;
+            return (const uint8_t *)list + (mid * entry_size);
+        }
+        else if (cmp < 0)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ *  \brief Check a command table can be searched
+ *
+ *  \Description
+ *  Front-ends call this once at init, names must be unique and in
+ *  ascending strcmp() order for CLI_find().
+ *
+ *  \return 0 or 0xffff for the first entry out of order
+ */
+uint16_t CLI_check_list
+           (
+               /* IN */ const void    * list,
+               /* IN */ uint32_t        count,
+               /* IN */ uint32_t        entry_size,
+               /* IN */ uint32_t        name_offset
+           )
+{
+    uint32_t index;
+
+    for (index = 1; index < count; index++)
+    {
+        if (0 <= CLI_STR_COMPARE(CLI_ENTRY_NAME(list, index - 1, entry_size, name_offset),
+                                 CLI_ENTRY_NAME(list, index, entry_size, name_offset)))
+        {
+            CLI_ERR(
+            "[CLI] Command list not sorted at %d\n", index);
+
+            return 0xffff;
         }
     }
 
     return 0;
 }
 
+/**
+ *  \brief Attach a line assembler to a buffer
+ *
+ *  \param [in] line    Line assembler
+ *  \param [in] buf     Line buffer
+ *  \param [in] size    Size of buf
+ */
+void CLI_line_init
+     (
+         /* IN */ CLI_LINE  * line,
+         /* IN */ uint8_t   * buf,
+         /* IN */ uint16_t    size
+     )
+{
+    line->buf = buf;
+    line->size = size;
+    CLI_line_reset(line);
+}
+
+/**
+ *  \brief Add received bytes to a command line
+ *
+ *  \Description
+ *  Safe to call from the UART receive handler. Stops after an end of line,
+ *  the caller checks CLI_line_done(), handles buf/len and calls
+ *  CLI_line_reset() before feeding the rest. Bytes fed to a done line are
+ *  not consumed. Empty lines (CR LF pairs) are skipped.
+ *
+ *  \param [in] line        Line assembler
+ *  \param [in] data        Received bytes
+ *  \param [in] data_len    Number of bytes
+ *
+ *  \return Number of bytes consumed
+ */
+uint16_t CLI_line_feed
+           (
+               /* IN */ CLI_LINE      * line,
+               /* IN */ const uint8_t * data,
+               /* IN */ uint16_t        data_len
+           )
+{
+    uint16_t index;
+    uint8_t  ch;
+
+    if (CLI_LINE_ST_DONE == line->state)
+    {
+        return 0;
+    }
+
+    for (index = 0; index < data_len; index++)
+    {
+        ch = data[index];
+
+        if (CLI_IS_EOL(ch))
+        {
+            if (CLI_LINE_ST_OVERFLOW == line->state)
+            {
+                CLI_line_reset(line);
+            }
+            else if (0 != line->len)
+            {
+                line->buf[line->len] = '\0';
+                line->state = CLI_LINE_ST_DONE;
+
+                return index + 1;
+            }
+
+            continue;
+        }
+
+        if (CLI_LINE_ST_OVERFLOW == line->state)
+        {
+            continue;
+        }
+
+        if ((line->len + 1) >= line->size)
+        {
+            CLI_ERR(
+            "[CLI] Line too long\n");
+
+            line->state = CLI_LINE_ST_OVERFLOW;
+            continue;
+        }
+
+        line->buf[line->len++] = ch;
+    }
+
+    return data_len;
+}
+
 /* TODO: Create a separe utility module or move to a common utility module */
 /* Supporting Macros */
 #define IS_SPACE(c) ((' ' == (c)) || ('\t' == (c)))
@@ -46,6 +46,16 @@
 
 #define CLI_strlen(s)   strlen((const char*)s)
 
+/** Line assembler states, see CLI_LINE */
+#define CLI_LINE_ST_RX          0x00
+#define CLI_LINE_ST_DONE        0x01
+#define CLI_LINE_ST_OVERFLOW    0x02
+
+#define CLI_IS_EOL(ch)           (('\r' == (ch)) || ('\n' == (ch)))
+
+#define CLI_line_done(line)      (CLI_LINE_ST_DONE == (line)->state)
+#define CLI_line_reset(line)     do { (line)->len = 0; (line)->state = CLI_LINE_ST_RX; } while (0)
+
 /* --------------------------------------------- Data Types/ Structures */
 /**
  * CLI command handler.
@@ -75,6 +85,30 @@ typedef struct _cli_command
 
 } CLI_COMMAND;
 
+/**
+ * Incremental command line assembly.
+ *
+ * Bytes are fed straight from the UART receive path. Once an end of line
+ * is seen the line is '\0' terminated in place and held (state DONE) until
+ * CLI_line_reset(), so the parser works on the receive buffer without a
+ * copy. A line longer than the buffer is dropped up to the next end of line.
+ */
+typedef struct _cli_line
+{
+    /** Line buffer, one byte is kept for the terminator */
+    uint8_t     * buf;
+
+    /** Size of buf */
+    uint16_t      size;
+
+    /** Bytes in buf */
+    uint16_t      len;
+
+    /** CLI_LINE_ST_* */
+    uint8_t       state;
+
+} CLI_LINE;
+
 
 /* --------------------------------------------- Functions */
 uint16_t CLI_init
@@ -90,6 +124,38 @@ uint16_t CLI_process_line
                /* IN */ uint32_t        cmd_count
            );
 
+const void * CLI_find
+             (
+                 /* IN */ const uint8_t * name,
+                 /* IN */ uint16_t        name_len,
+                 /* IN */ const void    * list,
+                 /* IN */ uint32_t        count,
+                 /* IN */ uint32_t        entry_size,
+                 /* IN */ uint32_t        name_offset
+             );
+
+uint16_t CLI_check_list
+           (
+               /* IN */ const void    * list,
+               /* IN */ uint32_t        count,
+               /* IN */ uint32_t        entry_size,
+               /* IN */ uint32_t        name_offset
+           );
+
+void CLI_line_init
+     (
+         /* IN */ CLI_LINE  * line,
+         /* IN */ uint8_t   * buf,
+         /* IN */ uint16_t    size
+     );
+
+uint16_t CLI_line_feed
+           (
+               /* IN */ CLI_LINE      * line,
+               /* IN */ const uint8_t * data,
+               /* IN */ uint16_t        data_len
+           );
+
 int32_t CLI_strtoi
       (
           /* IN */ uint8_t *data,
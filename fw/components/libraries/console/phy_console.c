@@ -10,6 +10,8 @@
 #include "string.h"
 #include "pwrmgr.h"
 #include "log.h"
+#include "cliface.h"
+#include <stddef.h>
 
 
 typedef enum{
@@ -20,108 +22,78 @@ typedef enum{
 
 typedef struct{
   cons_state_t  state;
-  uint16_t      rx_cnt;
+  CLI_LINE      line;
   uint8_t       rx_buf[CONS_CMD_RXBUF_MAX];
   const cons_cmd_t*   cmd_list;
+  uint16_t      cmd_num;
   cons_callback_t callback;
 }cons_ctx_t;
 
 cons_ctx_t s_cons_ctx;
 
 
+//tokenized in place in the line buffer, nothing is copied
 void console_parse_cmd(void)
 {
-  uint16_t i,j;
-  uint16_t cmd_id = 0;
+  uint16_t i, cmd_len;
   char* param_table[CONS_PARAM_NUM_MAX];
   cons_ctx_t* pctx = &s_cons_ctx;
-  const cons_cmd_t*   cmd_list = pctx->cmd_list;
-  uint8_t* prx = s_cons_ctx.rx_buf;
+  const cons_cmd_t* pcmd_entry;
+  uint8_t* prx = pctx->line.buf;
+  uint16_t rx_cnt = pctx->line.len;
   char* pcmd = NULL;
-  char* pparam = NULL;
   uint8_t param_num = 0;
 
-  //LOG("\n");
-  //for(i = 0; i< pctx->rx_cnt; i++)
-  //  LOG("%x ",prx[i]);
-  //  LOG("\n");
-
   //parse "at"
-  for(i = 1; i< pctx->rx_cnt; i++){
+  for(i = 1; i< rx_cnt; i++){
     if(prx[i-1] == 'a' && prx[i] == 't'){
       i++;
       break;
     }
   }
-  if(i == pctx->rx_cnt){
+  if(i >= rx_cnt){
     LOG("Parse filed, did not found \"at\"\n");
     return;
   }
 
   //parse cmd
-  {
-    pcmd = (char*)prx+i;
-    for(; i< pctx->rx_cnt; i++){
-        if(prx[i] == ' ' || prx[i] == '\0' ){
-          prx[i] = '\0';
-          break;
-        }
-        if(prx[i] < 0x20 || prx[i] > 0x7d){
-          LOG("Parse failed, cmd has illegal character\n");
-          return;
-        }
-    }
-    if(osal_strlen(pcmd) == 0){
-      LOG("Parse failed, cmd is empty\n");
-      return;
-    }
-    for(j = 0; j<CONS_CMD_NUM_MAX; j++){
-      if(cmd_list[j].cmd_id == 0 || cmd_list[j].cmd_name == NULL ){
-        LOG("Parse failed, cmd is not match cmdlist\n");
-        return;
-      }
-      if(strcmp(pcmd, cmd_list[j].cmd_name) == 0){
-        //match
-        cmd_id = cmd_list[j].cmd_id;
-        break;
-      }
-    }
-    if(cmd_id == 0){
-      LOG("Parse failed, cmd is not match cmdlist_1\n");
+  pcmd = (char*)prx+i;
+  for(; i< rx_cnt && prx[i] != ' '; i++){
+    if(prx[i] < 0x20 || prx[i] > 0x7d){
+      LOG("Parse failed, cmd has illegal character\n");
       return;
     }
   }
-  i++;
-  //parse parameter
-  pparam = (char*)prx+i;
-  for(; i< pctx->rx_cnt; i++){
+  cmd_len = (uint16_t)((char*)prx + i - pcmd);
+  if(cmd_len == 0){
+    LOG("Parse failed, cmd is empty\n");
+    return;
+  }
+  pcmd_entry = (const cons_cmd_t*)CLI_find((uint8_t*)pcmd, cmd_len, pctx->cmd_list, pctx->cmd_num,
+                                           sizeof(cons_cmd_t), offsetof(cons_cmd_t, cmd_name));
+  if(pcmd_entry == NULL){
+    LOG("Parse failed, cmd is not match cmdlist\n");
+    return;
+  }
+
+  //parse parameter, split on ' '
+  for(; i< rx_cnt; i++){
     if(prx[i] == ' '){
       prx[i] = '\0';
-      if(osal_strlen(pparam) == 0){
-        break;
-      }
-      param_table[param_num] = pparam;
-      param_num++;
-      if(param_num >= CONS_PARAM_NUM_MAX)
-        break;
-      pparam = (char*)prx+i+1;
-			continue;
+      continue;
     }
-		if(prx[i] == '\0'){
-      if(osal_strlen(pparam) == 0){
-        break;
-      }
-      param_table[param_num] = pparam;
-      param_num++;
-			break;
-		}
     if(prx[i] < 0x20 || prx[i] > 0x7d){
       LOG("Parse failed, parameter has illegal character\n");
       return;
     }
+    if(prx[i-1] == '\0'){
+      if(param_num >= CONS_PARAM_NUM_MAX)
+        break;
+      param_table[param_num++] = (char*)prx+i;
+    }
   }
 
-  pctx->callback(cmd_id, param_num, param_table);
+  pctx->callback(pcmd_entry->cmd_id, param_num, param_table);
   
 }
 
@@ -154,35 +126,32 @@ void console_wakeup_handler(void)
 void console_rx_handler(uart_Evt_t* pev)
 {
   cons_ctx_t* pctx = &s_cons_ctx;
-  uint8_t* prx = s_cons_ctx.rx_buf;
   
   switch(pev->type){
   case UART_EVT_TYPE_RX_DATA:
   case UART_EVT_TYPE_RX_DATA_TO:
   {
-    uint8_t i;
+    uint16_t len = pev->len;
     uint8_t* prx_msg = pev->data;
-    //for(i = 0; i< pev->len; i++)
-    //  LOG("%x ",pev->data[i]);
-    //LOG("\n");
+    uint16_t used;
+
     if(pctx->state == CONS_ST_IDLE){
       hal_pwrmgr_lock(MOD_CONSOLE);
       pctx->state = CONS_ST_RX;
     }
     if(pctx->state == CONS_ST_RX){
-      for(i = 0; i< pev->len; i++){
-        if(prx_msg[i] == '\r' ||prx_msg[i] == '\n'){
-          prx[pctx->rx_cnt] = 0;
-					pctx->rx_cnt++;
+      while(len){
+        used = CLI_line_feed(&pctx->line, prx_msg, len);
+        prx_msg += used;
+        len -= used;
+        if(CLI_line_done(&pctx->line)){
           pctx->state = CONS_ST_CMD;
           console_parse_cmd();
-					pctx->state = CONS_ST_IDLE;
-					pctx->rx_cnt = 0;
+          CLI_line_reset(&pctx->line);
+          pctx->state = CONS_ST_IDLE;
           hal_pwrmgr_unlock(MOD_CONSOLE);
           break;
         }
-        prx[pctx->rx_cnt] = prx_msg[i];
-        pctx->rx_cnt++;
       }
     }
     else
@@ -211,7 +180,14 @@ int console_init(const cons_cmd_t* cmdlist, cons_callback_t callback)
   .evt_handler = console_rx_handler,
   };
 
-  if(callback == NULL)
+  if(callback == NULL || cmdlist == NULL)
+    return PPlus_ERR_INVALID_PARAM;
+
+  for(s_cons_ctx.cmd_num = 0; s_cons_ctx.cmd_num < CONS_CMD_NUM_MAX; s_cons_ctx.cmd_num++){
+    if(cmdlist[s_cons_ctx.cmd_num].cmd_id == 0 || cmdlist[s_cons_ctx.cmd_num].cmd_name == NULL)
+      break;
+  }
+  if(CLI_check_list(cmdlist, s_cons_ctx.cmd_num, sizeof(cons_cmd_t), offsetof(cons_cmd_t, cmd_name)))
     return PPlus_ERR_INVALID_PARAM;
     
   hal_pwrmgr_register(MOD_CONSOLE, console_sleep_handler, console_wakeup_handler);
@@ -221,7 +197,7 @@ int console_init(const cons_cmd_t* cmdlist, cons_callback_t callback)
   
   s_cons_ctx.cmd_list = cmdlist;
   s_cons_ctx.state = CONS_ST_IDLE;
-  s_cons_ctx.rx_cnt = 0;
+  CLI_line_init(&s_cons_ctx.line, s_cons_ctx.rx_buf, CONS_CMD_RXBUF_MAX);
   s_cons_ctx.callback = callback;
 
   return PPlus_SUCCESS;
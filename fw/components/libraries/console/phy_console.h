@@ -9,7 +9,9 @@
 #include "bus_dev.h"
 
 #define CONS_CMD_NUM_MAX  32
-#define CONS_CMD_RXBUF_MAX  1024
+#ifndef CONS_CMD_RXBUF_MAX
+#define CONS_CMD_RXBUF_MAX  128   //one command line
+#endif
 #define CONS_PARAM_NUM_MAX  8
 
 #define MOD_CONSOLE MOD_USR2
@@ -17,6 +19,7 @@
 typedef void (*cons_callback_t)(uint16_t cmd_id, uint8_t argc, char** argv);
 
 
+//cmdlist is searched by name: sort it by cmd_name (strcmp order) and end it with {0, NULL}
 typedef struct{
  uint16_t cmd_id;
  char*    cmd_name;
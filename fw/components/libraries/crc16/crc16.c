@@ -8,37 +8,72 @@ crc16
 */
 
 #include "crc16.h"
+#include "crc_table.h"
 
 
+#if (CRC16_VARIANT == CRC_NIBBLE)
+
+static const uint16_t crc16_table[16] = CRC16_NIBBLE_TABLE;
 
 static uint16_t crc16_byte(uint16_t crc, uint8_t byte)
 {
-    static const uint16_t crc16_table[16] =
-    {
-        0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
-        0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
-    };
-
-    uint16_t temp;
-
     // Compute checksum of lower four bits of a byte.
-    temp         = crc16_table[crc & 0xF];
-    crc  = (crc >> 4u) & 0x0FFFu;
-    crc  = crc ^ temp ^ crc16_table[byte & 0xF];
+    crc  = (crc >> 4u) ^ crc16_table[(crc ^ byte) & 0xF];
 
     // Now compute checksum of upper four bits of a byte.
-    temp         = crc16_table[crc & 0xF];
-    crc  = (crc >> 4u) & 0x0FFFu;
-    crc  = crc ^ temp ^ crc16_table[(byte >> 4u) & 0xF];
+    crc  = (crc >> 4u) ^ crc16_table[(crc ^ (byte >> 4u)) & 0xF];
 
     return crc;
 }
 
+#elif (CRC16_VARIANT == CRC_TABLE) || (CRC16_VARIANT == CRC_SLICE4)
+
+#if (CRC16_VARIANT == CRC_SLICE4)
+static const uint16_t crc16_table[4][256] =
+{
+    CRC16_SLICE_T0, CRC16_SLICE_T1, CRC16_SLICE_T2, CRC16_SLICE_T3
+};
+#define CRC16_T0    crc16_table[0]
+#else
+static const uint16_t crc16_table[256] = CRC16_SLICE_T0;
+#define CRC16_T0    crc16_table
+#endif
+
+static uint16_t crc16_byte(uint16_t crc, uint8_t byte)
+{
+    return (crc >> 8u) ^ CRC16_T0[(crc ^ byte) & 0xFF];
+}
+
+#else
+#error "unknown CRC16_VARIANT"
+#endif
+
 
 uint16_t crc16(uint16_t seed, const volatile void * p_data, uint32_t size)
 {
     uint8_t * p_block = (uint8_t *)p_data;
 
+#if (CRC16_VARIANT == CRC_SLICE4)
+    uint32_t crc;
+
+    // Bytes up to the first word boundary, then whole words.
+    while ((size != 0) && ((uintptr_t)p_block & 3u))
+    {
+        seed = crc16_byte(seed, *p_block);
+        p_block++;
+        size--;
+    }
+
+    while (size >= 4)
+    {
+        crc  = seed ^ *(const volatile uint32_t *)p_block;
+        seed = crc16_table[3][crc & 0xFF] ^ crc16_table[2][(crc >> 8u) & 0xFF] ^
+               crc16_table[1][(crc >> 16u) & 0xFF] ^ crc16_table[0][crc >> 24u];
+        p_block += 4;
+        size -= 4;
+    }
+#endif
+
     while (size != 0)
     {
         seed = crc16_byte(seed, *p_block);
@@ -8,7 +8,26 @@
 
 #include <stdint.h>
 
+/*
+CRC implementation, selected at compile time for crc16() and crc32():
+CRC_NIBBLE: 16-entry table, two lookups per byte, smallest
+CRC_TABLE:  256-entry table, one lookup per byte
+CRC_SLICE4: four 256-entry tables, one 32-bit load and four lookups per
+            aligned word, fastest on aligned flash/RAM blocks
+All variants give the same result.
+*/
+#define CRC_NIBBLE      0
+#define CRC_TABLE       1
+#define CRC_SLICE4      2
+
+#ifndef CRC16_VARIANT
+#define CRC16_VARIANT   CRC_TABLE       //512 bytes of table
+#endif
+
+/*
+Reflected CRC-16/ARC (polynomial 0xA001), no final xor. The seed is the crc
+of the previous block, 0 to start.
+*/
 uint16_t crc16(uint16_t seed, const volatile void * p_data, uint32_t size);
 
 #endif // _CRC16_H__
-
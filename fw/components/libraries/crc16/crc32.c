@@ -0,0 +1,82 @@
+/**************************************************************************************************
+*******
+**************************************************************************************************/
+
+
+/*
+crc32
+*/
+
+#include "crc32.h"
+#include "crc_table.h"
+
+
+#if (CRC32_VARIANT == CRC_NIBBLE)
+
+static const uint32_t crc32_table[16] = CRC32_NIBBLE_TABLE;
+
+static uint32_t crc32_byte(uint32_t crc, uint8_t byte)
+{
+    crc  = (crc >> 4u) ^ crc32_table[(crc ^ byte) & 0xF];
+    crc  = (crc >> 4u) ^ crc32_table[(crc ^ (byte >> 4u)) & 0xF];
+
+    return crc;
+}
+
+#elif (CRC32_VARIANT == CRC_TABLE) || (CRC32_VARIANT == CRC_SLICE4)
+
+#if (CRC32_VARIANT == CRC_SLICE4)
+static const uint32_t crc32_table[4][256] =
+{
+    CRC32_SLICE_T0, CRC32_SLICE_T1, CRC32_SLICE_T2, CRC32_SLICE_T3
+};
+#define CRC32_T0    crc32_table[0]
+#else
+static const uint32_t crc32_table[256] = CRC32_SLICE_T0;
+#define CRC32_T0    crc32_table
+#endif
+
+static uint32_t crc32_byte(uint32_t crc, uint8_t byte)
+{
+    return (crc >> 8u) ^ CRC32_T0[(crc ^ byte) & 0xFF];
+}
+
+#else
+#error "unknown CRC32_VARIANT"
+#endif
+
+
+uint32_t crc32(uint32_t crc, const volatile void * p_data, uint32_t size)
+{
+    uint8_t * p_block = (uint8_t *)p_data;
+
+    crc = ~crc;
+
+#if (CRC32_VARIANT == CRC_SLICE4)
+    // Bytes up to the first word boundary, then whole words.
+    while ((size != 0) && ((uintptr_t)p_block & 3u))
+    {
+        crc = crc32_byte(crc, *p_block);
+        p_block++;
+        size--;
+    }
+
+    while (size >= 4)
+    {
+        crc ^= *(const volatile uint32_t *)p_block;
+        crc  = crc32_table[3][crc & 0xFF] ^ crc32_table[2][(crc >> 8u) & 0xFF] ^
+               crc32_table[1][(crc >> 16u) & 0xFF] ^ crc32_table[0][crc >> 24u];
+        p_block += 4;
+        size -= 4;
+    }
+#endif
+
+    while (size != 0)
+    {
+        crc = crc32_byte(crc, *p_block);
+        p_block++;
+        size--;
+    }
+
+    return ~crc;
+}
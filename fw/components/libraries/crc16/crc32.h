@@ -0,0 +1,23 @@
+/**************************************************************************************************
+*******
+**************************************************************************************************/
+
+
+#ifndef _CRC32_H__
+#define _CRC32_H__
+
+#include <stdint.h>
+#include "crc16.h"
+
+#ifndef CRC32_VARIANT
+#define CRC32_VARIANT   CRC_TABLE       //1KB of table
+#endif
+
+/*
+CRC-32/IEEE 802.3 (reflected polynomial 0xEDB88320), the zlib/PNG crc.
+Pre and post inversion are done inside: pass 0 to start, and the result of
+the previous block to continue.
+*/
+uint32_t crc32(uint32_t crc, const volatile void * p_data, uint32_t size);
+
+#endif // _CRC32_H__
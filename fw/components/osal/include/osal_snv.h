@@ -28,6 +28,10 @@ extern "C"
  * CONSTANTS
  */
 
+// Bonds kept without the FS (USE_FS 0), where every NV item takes a flash
+// sector: the Bond Table, then the records and configurations of 6 bonds
+#define OSAL_SNV_SECTOR_BONDS   6
+
 /*********************************************************************
  * MACROS
  */
@@ -87,6 +91,18 @@ extern uint8 osal_snv_read( osalSnvId_t id, osalSnvLen_t len, void *pBuf);
  */
 extern uint8 osal_snv_write( osalSnvId_t id, osalSnvLen_t len, void *pBuf);
 
+/*********************************************************************
+ * @fn      osal_snv_delete
+ *
+ * @brief   Delete a data item from NV.
+ *
+ * @param   id  - Valid NV item Id.
+ *
+ * @return  SUCCESS if the item is gone or never existed,
+ *          NV_OPER_FAILED if failed.
+ */
+extern uint8 osal_snv_delete( osalSnvId_t id );
+
 /*********************************************************************
  * @fn      osal_snv_compact
  *
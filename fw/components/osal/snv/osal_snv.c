@@ -8,6 +8,7 @@
 #include "flash.h"
 #include "error.h"
 #include "osal_snv.h"
+#include "bcomdef.h"
 #include "log.h"
 
 #ifndef USE_FS
@@ -55,12 +56,16 @@ static int snvwr(uint32_t addr, const uint8_t *buf, uint32_t size)
   return PPlus_SUCCESS;
 }
 
+// One item per sector, in the 14 sectors the old bond layout used. A
+// sector holds the ID of its item first, old items don't match
 static uint32_t snv_calc_addr(osalSnvId_t id)
 {
-  if(id == 0x70 || id == 0x71)
-    return NVM_BASE_ADDR + 0x1000*12 + (id-0x70)*0x1000;
-  else if(id >= 0x20 && id < 0x2c)
-    return NVM_BASE_ADDR + 0x1000*(id-0x20);
+  if(id == BLE_NVID_GAP_BOND_TABLE)
+    return NVM_BASE_ADDR;
+  else if(id >= BLE_NVID_GAP_BOND_START && id < BLE_NVID_GAP_BOND_START + OSAL_SNV_SECTOR_BONDS)
+    return NVM_BASE_ADDR + 0x1000*(1 + id-BLE_NVID_GAP_BOND_START);
+  else if(id >= BLE_NVID_GAP_BOND_CFG_START && id < BLE_NVID_GAP_BOND_CFG_START + OSAL_SNV_SECTOR_BONDS)
+    return NVM_BASE_ADDR + 0x1000*(1 + OSAL_SNV_SECTOR_BONDS + id-BLE_NVID_GAP_BOND_CFG_START);
   else
     return 0;
 }
@@ -79,7 +84,7 @@ uint8 osal_snv_read( osalSnvId_t id, osalSnvLen_t len, void *pBuf)
   if(pNv == NULL)
     return NV_OPER_FAILED;
 
-  if(pNv[0] == 0xffffffff)
+  if(pNv[0] != (uint32_t)id)
     return NV_OPER_FAILED;
   osal_memcpy(pBuf, (void*)(pNv+1), (uint32_t)len);
   print_hex(pBuf, len);
@@ -133,6 +138,20 @@ uint8 osal_snv_write( osalSnvId_t id, osalSnvLen_t len, void *pBuf)
   return SUCCESS;
 }
 
+uint8 osal_snv_delete( osalSnvId_t id )
+{
+  uint32_t* pNv = (uint32_t*)snv_calc_addr(id);
+
+  LOG("osal_snv_delete:%x\n",id);
+
+  // Only erase a sector that holds the item
+  if(pNv == NULL || pNv[0] != (uint32_t)id)
+    return SUCCESS;
+
+  hal_flash_erase_sector((uint32_t)pNv);
+  return SUCCESS;
+}
+
 uint8 osal_snv_compact( uint8 threshold )
 {
   return SUCCESS;
@@ -189,6 +208,19 @@ uint8 osal_snv_write( osalSnvId_t id, osalSnvLen_t len, void *pBuf)
   return SUCCESS;
 }
 
+uint8 osal_snv_delete( osalSnvId_t id )
+{
+  int ret;
+  LOG("osal_snv_delete:%x\n",id);
+
+  ret = hal_fs_item_del((uint16_t)id);
+  if(ret != PPlus_SUCCESS && ret != PPlus_ERR_FS_NOT_FIND_ID){
+		LOG("del_ret:%d\n",ret);
+		return NV_OPER_FAILED;
+	}
+  return SUCCESS;
+}
+
 uint8 osal_snv_compact( uint8 threshold ){
 	return 0;
 }
@@ -32,9 +32,6 @@
 #define BATT_ADC_LEVEL_3V           409
 #define BATT_ADC_LEVEL_2V           273
 
-#define BATT_LEVEL_VALUE_IDX        2 // Position of battery level in attribute array
-#define BATT_LEVEL_VALUE_CCCD_IDX   3 // Position of battery level CCCD in attribute array
-
 /*********************************************************************
  * TYPEDEFS
  */
@@ -48,12 +45,6 @@ CONST uint8 battServUUID[ATT_BT_UUID_SIZE] =
   LO_UINT16(BATT_SERV_UUID), HI_UINT16(BATT_SERV_UUID)
 };
 
-// Battery level characteristic
-CONST uint8 battLevelUUID[ATT_BT_UUID_SIZE] =
-{
-  LO_UINT16(BATT_LEVEL_UUID), HI_UINT16(BATT_LEVEL_UUID)
-};
-
 /*********************************************************************
  * EXTERNAL VARIABLES
  */
@@ -88,7 +79,6 @@ static uint8 battCriticalLevel;
 static CONST gattAttrType_t battService = { ATT_BT_UUID_SIZE, battServUUID };
 
 // Battery level characteristic
-static uint8 battLevelProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 battLevel = 100;
 
 #ifdef HID_VOICE_SPEC
@@ -103,8 +93,6 @@ static gattCharFormat_t battLevelPresentation = {
 };
 #endif
 
-static gattCharCfg_t battLevelClientCharCfg[GATT_MAX_NUM_CONN];
-
 // HID Report Reference characteristic descriptor, battery level
 static uint8 hidReportRefBattLevel[HID_REPORT_REF_LEN] =
              { HID_RPT_ID_BATT_LEVEL_IN, HID_REPORT_TYPE_INPUT };
@@ -113,57 +101,38 @@ static uint8 hidReportRefBattLevel[HID_REPORT_REF_LEN] =
  * Profile Attributes - Table
  */
 
-static gattAttribute_t battAttrTbl[] =
-{
-  // Battery Service
-  {
-    { ATT_BT_UUID_SIZE, primaryServiceUUID }, /* type */
-    GATT_PERMIT_READ,                         /* permissions */
-    0,                                        /* handle */
-    (uint8 *)&battService                     /* pValue */
-  },
+#ifdef HID_VOICE_SPEC
+// Characteristic Presentation format
+#define BATT_LEVEL_FORMAT( DESC ) \
+  DESC( BATT_LEVEL_PRESENTATION, charFormatUUID, GATT_PERMIT_READ, &battLevelPresentation )
+#else
+#define BATT_LEVEL_FORMAT( DESC )
+#endif
 
-    // Battery Level Declaration
-    {
-      { ATT_BT_UUID_SIZE, characterUUID },
-      GATT_PERMIT_READ,
-      0,
-      &battLevelProps
-    },
+#define BATT_ATTRS( CHAR, CFG, DESC ) \
+  /* Battery Level */ \
+  CHAR( BATT_LEVEL, BATT_LEVEL_UUID, GATT_PROP_READ | GATT_PROP_NOTIFY, GATT_PERMIT_READ, &battLevel ) \
+  CFG( BATT_LEVEL, GATT_CCCD( GATT_CCCD_BATT_LEVEL ) ) \
+  /* HID Report Reference characteristic descriptor, battery level input */ \
+  DESC( BATT_LEVEL_REPORT_REF, reportRefUUID, GATT_PERMIT_READ, hidReportRefBattLevel ) \
+  BATT_LEVEL_FORMAT( DESC )
 
-      // Battery Level Value
-      {
-        { ATT_BT_UUID_SIZE, battLevelUUID },
-        GATT_PERMIT_READ,
-        0,
-        &battLevel
-      },
+GATT_SERVICE_DEFS( BATT_ATTRS )
 
-      // Battery Level Client Characteristic Configuration
-      {
-        { ATT_BT_UUID_SIZE, clientCharCfgUUID },
-        GATT_PERMIT_READ | GATT_PERMIT_WRITE,
-        0,
-        (uint8 *) &battLevelClientCharCfg
-      },
+// Position of each attribute in the attribute array
+enum
+{
+  BATT_SERVICE_IDX,
+  GATT_SERVICE_IDXS( BATT_ATTRS )
+  BATT_NUM_ATTRS
+};
 
-      // HID Report Reference characteristic descriptor, batter level input
-      {
-        { ATT_BT_UUID_SIZE, reportRefUUID },
-        GATT_PERMIT_READ,
-        0,
-        hidReportRefBattLevel
-      },
-#ifdef HID_VOICE_SPEC
-      
-	        // Characteristic Presentation format
-      {
-        { ATT_BT_UUID_SIZE, charFormatUUID },
-        GATT_PERMIT_READ,
-        0,
-        (uint8_t *)&battLevelPresentation
-      },
-#endif
+static gattAttribute_t battAttrTbl[BATT_NUM_ATTRS] =
+{
+  // Battery Service
+  GATT_PRIMARY_SERVICE( &battService )
+
+  GATT_SERVICE_ATTRS( BATT_ATTRS )
 };
 
 
@@ -205,9 +174,6 @@ bStatus_t Batt_AddService( void )
 {
   uint8 status = SUCCESS;
 
-  // Initialize Client Characteristic Configuration attributes
-  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, battLevelClientCharCfg );
-
   // Register GATT attribute list and CBs with GATT Server App
   status = GATTServApp_RegisterService( battAttrTbl,
                                         GATT_NUM_ATTRS( battAttrTbl ),
@@ -304,8 +270,8 @@ bStatus_t Batt_GetParameter( uint8 param, void *value )
 
         pRpt->id = hidReportRefBattLevel[0];
         pRpt->type = hidReportRefBattLevel[1];
-        pRpt->handle = battAttrTbl[BATT_LEVEL_VALUE_IDX].handle;
-        pRpt->cccdHandle = battAttrTbl[BATT_LEVEL_VALUE_CCCD_IDX].handle;
+        pRpt->handle = battAttrTbl[BATT_LEVEL_IDX].handle;
+        pRpt->cccdHandle = battAttrTbl[BATT_LEVEL_CFG_IDX].handle;
         pRpt->mode = HID_PROTOCOL_MODE_REPORT;
       }
       break;
@@ -466,17 +432,19 @@ static void battNotifyCB( linkDBItem_t *pLinkItem )
 {
   if ( pLinkItem->stateFlags & LINK_CONNECTED )
   {
-    uint16 value = GATTServApp_ReadCharCfg( pLinkItem->connectionHandle,
-                                            battLevelClientCharCfg );
+    uint16 value = GATTServApp_ReadCCCD( pLinkItem->connectionHandle,
+                                         GATT_CCCD_BATT_LEVEL );
     if ( value & GATT_CLIENT_CFG_NOTIFY )
     {
       attHandleValueNoti_t noti;
 
-      noti.handle = battAttrTbl[BATT_LEVEL_VALUE_IDX].handle;
+      noti.handle = battAttrTbl[BATT_LEVEL_IDX].handle;
       noti.len = 1;
       noti.value[0] = battLevel;
 
-      GATT_Notification( pLinkItem->connectionHandle, &noti, FALSE );
+      // Only the latest level is of interest
+      VOID GATTServApp_QueueNotification( pLinkItem->connectionHandle, &noti,
+                                          GATT_NOTI_FLAG_COALESCE );
     }
   }
 }
@@ -533,7 +501,7 @@ void Batt_HandleConnStatusCB( uint16 connHandle, uint8 changeType )
          ( ( changeType == LINKDB_STATUS_UPDATE_STATEFLAGS ) &&
            ( !linkDB_Up( connHandle ) ) ) )
     {
-      GATTServApp_InitCharCfg( connHandle, battLevelClientCharCfg );
+      VOID GATTServApp_WriteCCCD( connHandle, GATT_CCCD_BATT_LEVEL, GATT_CFG_NO_OPERATION );
     }
   }
 }
@@ -60,60 +60,6 @@ CONST uint8 devInfoServUUID[ATT_BT_UUID_SIZE] =
   LO_UINT16(DEVINFO_SERV_UUID), HI_UINT16(DEVINFO_SERV_UUID)
 };
 
-// System ID
-CONST uint8 devInfoSystemIdUUID[ATT_BT_UUID_SIZE] =
-{
-  LO_UINT16(SYSTEM_ID_UUID), HI_UINT16(SYSTEM_ID_UUID)
-};
-
-// Model Number String
-CONST uint8 devInfoModelNumberUUID[ATT_BT_UUID_SIZE] =
-{
-  LO_UINT16(MODEL_NUMBER_UUID), HI_UINT16(MODEL_NUMBER_UUID)
-};
-
-// Serial Number String
-CONST uint8 devInfoSerialNumberUUID[ATT_BT_UUID_SIZE] =
-{
-  LO_UINT16(SERIAL_NUMBER_UUID), HI_UINT16(SERIAL_NUMBER_UUID)
-};
-
-// Firmware Revision String
-CONST uint8 devInfoFirmwareRevUUID[ATT_BT_UUID_SIZE] =
-{
-  LO_UINT16(FIRMWARE_REV_UUID), HI_UINT16(FIRMWARE_REV_UUID)
-};
-
-// Hardware Revision String
-CONST uint8 devInfoHardwareRevUUID[ATT_BT_UUID_SIZE] =
-{
-  LO_UINT16(HARDWARE_REV_UUID), HI_UINT16(HARDWARE_REV_UUID)
-};
-
-// Software Revision String
-CONST uint8 devInfoSoftwareRevUUID[ATT_BT_UUID_SIZE] =
-{
-  LO_UINT16(SOFTWARE_REV_UUID), HI_UINT16(SOFTWARE_REV_UUID)
-};
-
-// Manufacturer Name String
-CONST uint8 devInfoMfrNameUUID[ATT_BT_UUID_SIZE] =
-{
-  LO_UINT16(MANUFACTURER_NAME_UUID), HI_UINT16(MANUFACTURER_NAME_UUID)
-};
-
-// IEEE 11073-20601 Regulatory Certification Data List
-CONST uint8 devInfo11073CertUUID[ATT_BT_UUID_SIZE] =
-{
-  LO_UINT16(IEEE_11073_CERT_DATA_UUID), HI_UINT16(IEEE_11073_CERT_DATA_UUID)
-};
-
-// PnP ID
-CONST uint8 devInfoPnpIdUUID[ATT_BT_UUID_SIZE] =
-{
-  LO_UINT16(PNP_ID_UUID), HI_UINT16(PNP_ID_UUID)
-};
-
 
 /*********************************************************************
  * EXTERNAL VARIABLES
@@ -136,49 +82,41 @@ static CONST gattAttrType_t devInfoService = { ATT_BT_UUID_SIZE, devInfoServUUID
 
 #if SYSTEM_ID_ENABLE
 // System ID characteristic
-static uint8 devInfoSystemIdProps 			= 	GATT_PROP_READ;
 static uint8 devInfoSystemId[DEVINFO_SYSTEM_ID_LEN] 	= 	{0, 0, 0, 0, 0, 0, 0, 0};
 #endif
 
 #if	MODEL_NUMBER_STR_ENABLE
 // Model Number String characteristic
-static uint8 devInfoModelNumberProps 		= 	GATT_PROP_READ;
 static const uint8 devInfoModelNumber[] 	= 	"Model Number";
 #endif
 
 #if	SERIAL_NUMBER_STR_ENABLE
 // Serial Number String characteristic
-static uint8 devInfoSerialNumberProps 	= 	GATT_PROP_READ;
 static const uint8 devInfoSerialNumber[] 	= 	"Serial Number";
 #endif
 
 #if FIRMWARE_REVISION_ENABLE
 // Firmware Revision String characteristic
-static uint8 devInfoFirmwareRevProps 		= 	GATT_PROP_READ;
 static const uint8 devInfoFirmwareRev[] 	= 	"Firmware Revision";
 #endif
 
 #if	HARDWARE_REVISION_ENABLE
 // Hardware Revision String characteristic
-static uint8 devInfoHardwareRevProps 		= 	GATT_PROP_READ;
 static const uint8 devInfoHardwareRev[] 	= 	"Hardware Revision";
 #endif
 
 #if	SOFTWARE_REVISION_ENABLE
 // Software Revision String characteristic
-static uint8 devInfoSoftwareRevProps 		= 	GATT_PROP_READ;
 static const uint8 devInfoSoftwareRev[] 	= 	"Software Revision";
 #endif
 
 #if	MANUFACTURE_NAME_STR_ENABLE
 // Manufacturer Name String characteristic
-static uint8 devInfoMfrNameProps 			= 	GATT_PROP_READ;
 static const uint8 devInfoMfrName[] 		= 	"Manufacturer Name";
 #endif
 
 #if	IEEE_DATA_ENABLE
 // IEEE 11073-20601 Regulatory Certification Data List characteristic
-static uint8 devInfo11073CertProps 		= 	GATT_PROP_READ;
 static const uint8 devInfo11073Cert[] =
 {
 	DEVINFO_11073_BODY_EXP,      // authoritative body type
@@ -190,7 +128,6 @@ static const uint8 devInfo11073Cert[] =
 
 #if	PNP_ID_ENABLE
 // System ID characteristic
-static uint8 devInfoPnpIdProps 			= 	GATT_PROP_READ;
 static uint8 devInfoPnpId[DEVINFO_PNP_ID_LEN] =
 {
 	1,                                      // Vendor ID source (1=Bluetooth SIG)
@@ -204,82 +141,114 @@ static uint8 devInfoPnpId[DEVINFO_PNP_ID_LEN] =
  * Profile Attributes - Table
  */
 
-static gattAttribute_t devInfoAttrTbl[] =
-{
-	/* type */								/* permissions */			/* handle */	/* pValue */
-	// Device Information Service
-	{{ ATT_BT_UUID_SIZE, primaryServiceUUID },			GATT_PERMIT_READ,	0,	(uint8 *)&devInfoService		},
-
+// Enabled characteristics, all read only
 #if SYSTEM_ID_ENABLE
-	// System ID Declaration
-	{{ ATT_BT_UUID_SIZE, characterUUID },				GATT_PERMIT_READ,	0,	&devInfoSystemIdProps			},
-	// System ID Value
-	{{ ATT_BT_UUID_SIZE, devInfoSystemIdUUID },		GATT_PERMIT_READ,	0,	(uint8 *) devInfoSystemId		},
+// System ID
+#define DEVINFO_SYSTEM_ID_ATTRS( CHAR ) \
+  CHAR( SYSTEM_ID, SYSTEM_ID_UUID, GATT_PROP_READ, GATT_PERMIT_READ, devInfoSystemId )
+#else
+#define DEVINFO_SYSTEM_ID_ATTRS( CHAR )
 #endif
 
-#if	MODEL_NUMBER_STR_ENABLE
-	// Model Number String Declaration
-	{{ ATT_BT_UUID_SIZE, characterUUID },				GATT_PERMIT_READ,	0,	&devInfoModelNumberProps		},
-	// Model Number Value
-	{{ ATT_BT_UUID_SIZE, devInfoModelNumberUUID },	GATT_PERMIT_READ,	0,	(uint8 *) devInfoModelNumber	},
+#if MODEL_NUMBER_STR_ENABLE
+// Model Number String
+#define DEVINFO_MODEL_NUMBER_ATTRS( CHAR ) \
+  CHAR( MODEL_NUMBER, MODEL_NUMBER_UUID, GATT_PROP_READ, GATT_PERMIT_READ, devInfoModelNumber )
+#else
+#define DEVINFO_MODEL_NUMBER_ATTRS( CHAR )
 #endif
 
-#if	SERIAL_NUMBER_STR_ENABLE
-	// Serial Number String Declaration
-	{{ ATT_BT_UUID_SIZE, characterUUID },				GATT_PERMIT_READ,	0,	&devInfoSerialNumberProps		},
-	// Serial Number Value
-	{{ ATT_BT_UUID_SIZE, devInfoSerialNumberUUID },	GATT_PERMIT_READ,	0,	(uint8 *) devInfoSerialNumber	},
+#if SERIAL_NUMBER_STR_ENABLE
+// Serial Number String
+#define DEVINFO_SERIAL_NUMBER_ATTRS( CHAR ) \
+  CHAR( SERIAL_NUMBER, SERIAL_NUMBER_UUID, GATT_PROP_READ, GATT_PERMIT_READ, devInfoSerialNumber )
+#else
+#define DEVINFO_SERIAL_NUMBER_ATTRS( CHAR )
 #endif
 
-#if	FIRMWARE_REVISION_ENABLE
-	// Firmware Revision String Declaration
-	{{ ATT_BT_UUID_SIZE, characterUUID },				GATT_PERMIT_READ,	0,	&devInfoFirmwareRevProps		},
-	// Firmware Revision Value
-	{{ ATT_BT_UUID_SIZE, devInfoFirmwareRevUUID },	GATT_PERMIT_READ,	0,	(uint8 *) devInfoFirmwareRev	},
+#if FIRMWARE_REVISION_ENABLE
+// Firmware Revision String
+#define DEVINFO_FIRMWARE_REV_ATTRS( CHAR ) \
+  CHAR( FIRMWARE_REV, FIRMWARE_REV_UUID, GATT_PROP_READ, GATT_PERMIT_READ, devInfoFirmwareRev )
+#else
+#define DEVINFO_FIRMWARE_REV_ATTRS( CHAR )
 #endif
 
-#if	HARDWARE_REVISION_ENABLE
-	// Hardware Revision String Declaration
-	{{ ATT_BT_UUID_SIZE, characterUUID },				GATT_PERMIT_READ,	0,	&devInfoHardwareRevProps		},
-	// Hardware Revision Value
-	{{ ATT_BT_UUID_SIZE, devInfoHardwareRevUUID },	GATT_PERMIT_READ,	0,	(uint8 *) devInfoHardwareRev	},
+#if HARDWARE_REVISION_ENABLE
+// Hardware Revision String
+#define DEVINFO_HARDWARE_REV_ATTRS( CHAR ) \
+  CHAR( HARDWARE_REV, HARDWARE_REV_UUID, GATT_PROP_READ, GATT_PERMIT_READ, devInfoHardwareRev )
+#else
+#define DEVINFO_HARDWARE_REV_ATTRS( CHAR )
 #endif
 
-#if	SOFTWARE_REVISION_ENABLE
-	// Software Revision String Declaration
-	{{ ATT_BT_UUID_SIZE, characterUUID },				GATT_PERMIT_READ,	0,	&devInfoSoftwareRevProps		},
-	// Software Revision Value
-	{{ ATT_BT_UUID_SIZE, devInfoSoftwareRevUUID },	GATT_PERMIT_READ,	0,	(uint8 *) devInfoSoftwareRev	},
+#if SOFTWARE_REVISION_ENABLE
+// Software Revision String
+#define DEVINFO_SOFTWARE_REV_ATTRS( CHAR ) \
+  CHAR( SOFTWARE_REV, SOFTWARE_REV_UUID, GATT_PROP_READ, GATT_PERMIT_READ, devInfoSoftwareRev )
+#else
+#define DEVINFO_SOFTWARE_REV_ATTRS( CHAR )
 #endif
 
-#if	MANUFACTURE_NAME_STR_ENABLE
-	// Manufacturer Name String Declaration
-	{{ ATT_BT_UUID_SIZE, characterUUID },				GATT_PERMIT_READ,	0,	&devInfoMfrNameProps			},
-	// Manufacturer Name Value
-	{{ ATT_BT_UUID_SIZE, devInfoMfrNameUUID },			GATT_PERMIT_READ,	0,	(uint8 *) devInfoMfrName		},
+#if MANUFACTURE_NAME_STR_ENABLE
+// Manufacturer Name String
+#define DEVINFO_MANUFACTURER_NAME_ATTRS( CHAR ) \
+  CHAR( MANUFACTURER_NAME, MANUFACTURER_NAME_UUID, GATT_PROP_READ, GATT_PERMIT_READ, devInfoMfrName )
+#else
+#define DEVINFO_MANUFACTURER_NAME_ATTRS( CHAR )
 #endif
 
-#if	IEEE_DATA_ENABLE
-	// IEEE 11073-20601 Regulatory Certification Data List Declaration
-	{{ ATT_BT_UUID_SIZE, characterUUID },				GATT_PERMIT_READ,	0,	&devInfo11073CertProps		},
-	// IEEE 11073-20601 Regulatory Certification Data List Value
-	{{ ATT_BT_UUID_SIZE, devInfo11073CertUUID },		GATT_PERMIT_READ,	0,	(uint8 *) devInfo11073Cert		},
+#if IEEE_DATA_ENABLE
+// IEEE 11073-20601 Regulatory Certification Data List
+#define DEVINFO_11073_CERT_DATA_ATTRS( CHAR ) \
+  CHAR( IEEE_11073_CERT_DATA, IEEE_11073_CERT_DATA_UUID, GATT_PROP_READ, GATT_PERMIT_READ, devInfo11073Cert )
+#else
+#define DEVINFO_11073_CERT_DATA_ATTRS( CHAR )
 #endif
 
-#if	PNP_ID_ENABLE
-	// PnP ID Declaration
-	{{ ATT_BT_UUID_SIZE, characterUUID },				GATT_PERMIT_READ,	0,	&devInfoPnpIdProps				},
-	// PnP ID Value
-	{{ ATT_BT_UUID_SIZE, devInfoPnpIdUUID },			GATT_PERMIT_READ,	0,	(uint8 *) devInfoPnpId			},
+#if PNP_ID_ENABLE
+// PnP ID
+#define DEVINFO_PNP_ID_ATTRS( CHAR ) \
+  CHAR( PNP_ID, PNP_ID_UUID, GATT_PROP_READ, GATT_PERMIT_READ, devInfoPnpId )
+#else
+#define DEVINFO_PNP_ID_ATTRS( CHAR )
 #endif
+
+#define DEVINFO_ATTRS( CHAR, CFG, DESC ) \
+  DEVINFO_SYSTEM_ID_ATTRS( CHAR ) \
+  DEVINFO_MODEL_NUMBER_ATTRS( CHAR ) \
+  DEVINFO_SERIAL_NUMBER_ATTRS( CHAR ) \
+  DEVINFO_FIRMWARE_REV_ATTRS( CHAR ) \
+  DEVINFO_HARDWARE_REV_ATTRS( CHAR ) \
+  DEVINFO_SOFTWARE_REV_ATTRS( CHAR ) \
+  DEVINFO_MANUFACTURER_NAME_ATTRS( CHAR ) \
+  DEVINFO_11073_CERT_DATA_ATTRS( CHAR ) \
+  DEVINFO_PNP_ID_ATTRS( CHAR )
+
+GATT_SERVICE_DEFS( DEVINFO_ATTRS )
+
+// Position of each attribute in the attribute array
+enum
+{
+  DEVINFO_SERVICE_IDX,
+  GATT_SERVICE_IDXS( DEVINFO_ATTRS )
+  DEVINFO_NUM_ATTRS
+};
+
+static gattAttribute_t devInfoAttrTbl[DEVINFO_NUM_ATTRS] =
+{
+  // Device Information Service
+  GATT_PRIMARY_SERVICE( &devInfoService )
+
+  GATT_SERVICE_ATTRS( DEVINFO_ATTRS )
 };
 
 
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
-static uint8 devInfo_ReadAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
-                            uint8 *pValue, uint8 *pLen, uint16 offset, uint8 maxLen );
+static bStatus_t devInfo_GetAttrValueCB( uint16 connHandle, gattAttribute_t *pAttr,
+                                         uint8 **ppValue, uint16 *pLen );
 
 /*********************************************************************
  * PROFILE CALLBACKS
@@ -287,9 +256,11 @@ static uint8 devInfo_ReadAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
 // Device Info Service Callbacks
 CONST gattServiceCBs_t devInfoCBs =
 {
-  devInfo_ReadAttrCB, // Read callback function pointer
-  NULL,               // Write callback function pointer
-  NULL                // Authorization callback function pointer
+  NULL,                  // Read callback function pointer
+  NULL,                  // Write callback function pointer
+  NULL,                  // Authorization callback function pointer
+  NULL,                  // Long write callback function pointer
+  devInfo_GetAttrValueCB // Get value callback function pointer
 };
 
 /*********************************************************************
@@ -432,21 +403,20 @@ bStatus_t DevInfo_GetParameter( uint8 param, void *value )
 }
 
 /*********************************************************************
- * @fn          devInfo_ReadAttrCB
+ * @fn          devInfo_GetAttrValueCB
  *
- * @brief       Read an attribute.
+ * @brief       Get where an attribute value is stored. GATT Server App
+ *              copies it from there and handles the offset.
  *
  * @param       connHandle - connection message was received on
  * @param       pAttr - pointer to attribute
- * @param       pValue - pointer to data to be read
- * @param       pLen - length of data to be read
- * @param       offset - offset of the first octet to be read
- * @param       maxLen - maximum length of data to be read
+ * @param       ppValue - pointer to the stored value (to be returned)
+ * @param       pLen - length of the stored value (to be returned)
  *
  * @return      Success or Failure
  */
-static uint8 devInfo_ReadAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
-                            uint8 *pValue, uint8 *pLen, uint16 offset, uint8 maxLen )
+static bStatus_t devInfo_GetAttrValueCB( uint16 connHandle, gattAttribute_t *pAttr,
+                                         uint8 **ppValue, uint16 *pLen )
 {
 	bStatus_t status = SUCCESS;
 	uint16 uuid = BUILD_UINT16( pAttr->type.uuid[0], pAttr->type.uuid[1]);
@@ -455,132 +425,74 @@ static uint8 devInfo_ReadAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
 	{
 	#if	SYSTEM_ID_ENABLE
 		case SYSTEM_ID_UUID:
-		// verify offset
-		if (offset >= sizeof(devInfoSystemId)){
-			status = ATT_ERR_INVALID_OFFSET;
-		}else{
-			// determine read length
-			*pLen = MIN(maxLen, (sizeof(devInfoSystemId) - offset));
-			// copy data
-			osal_memcpy(pValue, &devInfoSystemId[offset], *pLen);
-		}
+		*ppValue = (uint8 *)devInfoSystemId;
+		*pLen = sizeof(devInfoSystemId);
 		break;
 	#endif
 
 	#if	MODEL_NUMBER_STR_ENABLE
 		case MODEL_NUMBER_UUID:
-		// verify offset
-		if (offset >= (sizeof(devInfoModelNumber) - 1)){
-			status = ATT_ERR_INVALID_OFFSET;
-		}else{
-			// determine read length (exclude null terminating character)
-			*pLen = MIN(maxLen, ((sizeof(devInfoModelNumber) - 1) - offset));
-			// copy data
-			osal_memcpy(pValue, &devInfoModelNumber[offset], *pLen);
-		}
+		// exclude null terminating character
+		*ppValue = (uint8 *)devInfoModelNumber;
+		*pLen = sizeof(devInfoModelNumber) - 1;
 		break;
 	#endif
 
 	#if	SERIAL_NUMBER_STR_ENABLE
 		case SERIAL_NUMBER_UUID:
-		// verify offset
-		if (offset >= (sizeof(devInfoSerialNumber) - 1)){
-			status = ATT_ERR_INVALID_OFFSET;
-		}else{
-			// determine read length (exclude null terminating character)
-			*pLen = MIN(maxLen, ((sizeof(devInfoSerialNumber) - 1) - offset));
-			// copy data
-			osal_memcpy(pValue, &devInfoSerialNumber[offset], *pLen);
-		}
+		// exclude null terminating character
+		*ppValue = (uint8 *)devInfoSerialNumber;
+		*pLen = sizeof(devInfoSerialNumber) - 1;
 		break;
 	#endif
 
 	#if	FIRMWARE_REVISION_ENABLE
 		case FIRMWARE_REV_UUID:
-		// verify offset
-		if (offset >= (sizeof(devInfoFirmwareRev) - 1)){
-			status = ATT_ERR_INVALID_OFFSET;
-		}else{
-			// determine read length (exclude null terminating character)
-			*pLen = MIN(maxLen, ((sizeof(devInfoFirmwareRev) - 1) - offset));
-			// copy data
-			osal_memcpy(pValue, &devInfoFirmwareRev[offset], *pLen);
-		}
+		// exclude null terminating character
+		*ppValue = (uint8 *)devInfoFirmwareRev;
+		*pLen = sizeof(devInfoFirmwareRev) - 1;
 		break;
 	#endif
 
 	#if	HARDWARE_REVISION_ENABLE
 		case HARDWARE_REV_UUID:
-		// verify offset
-		if (offset >= (sizeof(devInfoHardwareRev) - 1)){
-			status = ATT_ERR_INVALID_OFFSET;
-		}else{
-			// determine read length (exclude null terminating character)
-			*pLen = MIN(maxLen, ((sizeof(devInfoHardwareRev) - 1) - offset));
-			// copy data
-			osal_memcpy(pValue, &devInfoHardwareRev[offset], *pLen);
-		}
+		// exclude null terminating character
+		*ppValue = (uint8 *)devInfoHardwareRev;
+		*pLen = sizeof(devInfoHardwareRev) - 1;
 		break;
 	#endif
 
 	#if	SOFTWARE_REVISION_ENABLE
 		case SOFTWARE_REV_UUID:
-		// verify offset
-		if (offset >= (sizeof(devInfoSoftwareRev) - 1)){
-			status = ATT_ERR_INVALID_OFFSET;
-		}else{
-			// determine read length (exclude null terminating character)
-			*pLen = MIN(maxLen, ((sizeof(devInfoSoftwareRev) - 1) - offset));
-			// copy data
-			osal_memcpy(pValue, &devInfoSoftwareRev[offset], *pLen);
-		}
+		// exclude null terminating character
+		*ppValue = (uint8 *)devInfoSoftwareRev;
+		*pLen = sizeof(devInfoSoftwareRev) - 1;
 		break;
 	#endif
 
 	#if	MANUFACTURE_NAME_STR_ENABLE
 		case MANUFACTURER_NAME_UUID:
-		// verify offset
-		if (offset >= (sizeof(devInfoMfrName) - 1)){
-			status = ATT_ERR_INVALID_OFFSET;
-		}else{
-			// determine read length (exclude null terminating character)
-			*pLen = MIN(maxLen, ((sizeof(devInfoMfrName) - 1) - offset));
-			// copy data
-			osal_memcpy(pValue, &devInfoMfrName[offset], *pLen);
-		}
+		// exclude null terminating character
+		*ppValue = (uint8 *)devInfoMfrName;
+		*pLen = sizeof(devInfoMfrName) - 1;
 		break;
 	#endif
 
 	#if	IEEE_DATA_ENABLE
 		case IEEE_11073_CERT_DATA_UUID:
-		// verify offset
-		if (offset >= sizeof(devInfo11073Cert)){
-			status = ATT_ERR_INVALID_OFFSET;
-		}else{
-			// determine read length
-			*pLen = MIN(maxLen, (sizeof(devInfo11073Cert) - offset));
-			// copy data
-			osal_memcpy(pValue, &devInfo11073Cert[offset], *pLen);
-		}
+		*ppValue = (uint8 *)devInfo11073Cert;
+		*pLen = sizeof(devInfo11073Cert);
 		break;
 	#endif
 
 	#if	PNP_ID_ENABLE
 		case PNP_ID_UUID:
-		// verify offset
-		if (offset >= sizeof(devInfoPnpId)){
-			status = ATT_ERR_INVALID_OFFSET;
-		}else{
-			// determine read length
-			*pLen = MIN(maxLen, (sizeof(devInfoPnpId) - offset));
-			// copy data
-			osal_memcpy(pValue, &devInfoPnpId[offset], *pLen);
-		}
+		*ppValue = (uint8 *)devInfoPnpId;
+		*pLen = sizeof(devInfoPnpId);
 		break;
 	#endif
-	
+
 		default:
-			*pLen = 0;
 			status = ATT_ERR_ATTR_NOT_FOUND;
 		break;
 	}
@@ -25,6 +25,11 @@
 #include "gatt.h"
 #include "gatt_uuid.h"
 #include "gattservapp.h"
+#include "hci.h"
+#include "l2cap.h"
+#include "ll.h"
+#include "osal_bufmgr.h"
+#include "jump_function.h"
 
 
 /*********************************************************************
@@ -35,35 +40,92 @@
  * CONSTANTS
  */
 
+// Number of entries the service callbacks table grows by
+#define GATT_SERVICE_CBS_TBL_INC      4
+
+// UUID index key of a 128-bit UUID not based on the Bluetooth Base UUID
+#define GATT_UUID_KEY_128             0x0000
+
+// Robust Caching state of a client
+#define GATT_CLIENT_CHANGE_UNAWARE    0x01  // Database changed since the client last saw it
+#define GATT_CLIENT_OUT_OF_SYNC_SENT  0x02  // Database Out Of Sync error was sent
+#define GATT_CLIENT_SVC_CHG_PENDING   0x04  // Service Changed Indication awaits its confirmation
+
+// AES-CMAC block size
+#define GATT_CMAC_BLOCK_SIZE          16
+
+// An ATT command no server supports, ATT ignores it (Core Vol 3, Part F, 3.3)
+#define GATT_IGNORED_CMD              0x7F
+
+// GATT Server Application Task Events
+#define GATT_SERV_NOTI_EVT            0x0001  // Connection event done, send queued notifications and pass it on
+
 /*********************************************************************
  * TYPEDEFS
  */
 
-// Structure to keep Prepare Write Requests for each Client
+// Structure to keep a Prepare Write Request until Execute Write
+typedef struct
+{
+  uint16 connHandle;                    // connection message was received on
+  attPrepareWriteReq_t req;             // Prepare Write Request
+} prepareWrite_t;
+
+// Structure to keep an attribute written in place by its service
 typedef struct
 {
   uint16 connHandle;                    // connection message was received on
-  attPrepareWriteReq_t *pPrepareWriteQ; // Prepare Write Request queue
-} prepareWrites_t;
+  uint16 handle;                        // attribute handle
+} longWrite_t;
 
 // GATT Structure to keep CBs information for each service being registered
 typedef struct
 {
   uint16 handle;                // Service handle - assigned internally by GATT Server
+  uint16 numAttrs;              // Number of attributes, handles are consecutive
+  gattAttribute_t *pAttrs;      // Service attribute list
   CONST gattServiceCBs_t *pCBs; // Service callback function pointers
 } gattServiceCBsInfo_t;
 
-// Service callbacks list item
-typedef struct _serviceCBsList
+// UUID index entry, sorted by UUID key then handle
+typedef struct
+{
+  uint16 uuid;                  // 16-bit UUID or GATT_UUID_KEY_128
+  uint16 handle;                // Attribute handle
+} gattUUIDIdx_t;
+
+// Notification waiting to be sent, the value follows the structure
+typedef struct gattNoti
+{
+  struct gattNoti *pNext;       // Next notification of the client
+  uint16 handle;                // Attribute handle
+  uint8 flags;                  // GATT_NOTI_FLAG_*
+  uint8 len;                    // Length of value
+} gattNoti_t;
+
+// Queued notifications of a client, the urgent ones first
+typedef struct
+{
+  gattNoti_t *pHead;            // First notification to be sent
+  uint8 num;                    // Number of notifications
+} gattNotiQueue_t;
+
+// AES-CMAC calculation, the message is fed in pieces
+typedef struct
 {
-  struct _serviceCBsList *next;     // pointer to next service callbacks record
-  gattServiceCBsInfo_t serviceInfo; // service handle/callbacks
-} serviceCBsList_t;
+  uint8 x[GATT_CMAC_BLOCK_SIZE];    // Chaining value
+  uint8 buf[GATT_CMAC_BLOCK_SIZE];  // Block not processed yet
+  uint8 len;                        // Octets in buf
+} gattCmac_t;
 
 /*********************************************************************
  * GLOBAL VARIABLES
  */
 
+// Attribute values of the CCCDs in the CCCD store, an attribute is in the
+// store if its value points into this table
+CONST uint8 gattServApp_CCCDTag[GATT_MAX_NUM_CCCD] = { 0 };
+
 /*********************************************************************
  * EXTERNAL VARIABLES
  */
@@ -80,16 +142,52 @@ uint8 GATTServApp_TaskID;   // Task ID for internal task/event processing
 uint8 appTaskID = INVALID_TASK_ID; // The task ID of an app/profile that
                                    // wants GATT Server event messages
 
-// Server Prepare Write table (one entry per each physical link)
-static prepareWrites_t prepareWritesTbl[MAX_NUM_LL_CONN];
+// Server Prepare Write queue, shared by all Clients. The requests are kept
+// in the order they arrived.
+static prepareWrite_t *prepareWritesTbl = NULL;
+static uint8 numPrepareWritesQ = 0;
 
-// Maximum number of attributes that Server can prepare for writing per Client
+// Maximum number of prepared values that Server can queue for all Clients
 static uint8 maxNumPrepareWrites = 0;
 #ifdef PREPARE_QUEUE_STATIC
-static attPrepareWriteReq_t prepareQueue[MAX_NUM_LL_CONN*GATT_MAX_NUM_PREPARE_WRITES];
+static prepareWrite_t prepareQueue[GATT_MAX_NUM_PREPARE_WRITES];
 #endif
-// Callbacks for services
-static serviceCBsList_t *serviceCBsList = NULL;
+
+// Attributes with prepared values written in place by their service
+static longWrite_t longWritesTbl[GATT_MAX_NUM_LONG_WRITES];
+// Callbacks for services, sorted by service handle for a binary search
+static gattServiceCBsInfo_t *serviceCBsTbl = NULL;
+static uint16 numServiceCBs = 0;
+static uint16 maxServiceCBs = 0;
+
+// Attributes of all services by type, for the discovery requests. NULL if it
+// could not be built, the GATT Server is searched instead.
+static gattUUIDIdx_t *uuidIdxTbl = NULL;
+static uint16 numUUIDIdx = 0;
+
+// Notification queues of each client
+static gattNotiQueue_t notiQueueTbl[GATT_MAX_NUM_CONN];
+
+// Whether the connection event done notice is taken, for the queues or
+// for the application
+static uint8 connEvtNoticeOn = FALSE;
+
+// Task and event the application wants the notice passed on to, see
+// GATTServApp_ConnEventDoneNoticeCmd(). An event of 0 means none.
+static uint8 appConnEvtTaskID = 0;
+static uint16 appConnEvtEvent = 0;
+
+// Client Supported Features and Robust Caching state of each client
+static uint8 clientFeatures[GATT_MAX_NUM_CONN];
+static uint8 clientState[GATT_MAX_NUM_CONN];
+
+// CCCD store, the configuration of each CCCD for each client in 2 bits
+static uint8 cccdTbl[GATT_MAX_NUM_CONN][GATT_CCCD_STORE_SIZE];
+
+// Database Hash, least significant octet first. Computed on the first read
+// after a service was registered or deregistered.
+static uint8 dbHash[GATT_DB_HASH_SIZE];
+static uint8 dbHashValid = FALSE;
 
 // Globals to be used for processing an incoming request
 static uint8 attrLen;
@@ -111,10 +209,22 @@ static uint8 serviceChangedCharProps = GATT_PROP_INDICATE;
 // of Attribute Handles on the server.
 
 // Client Characteristic configuration. Each client has its own instantiation
-// of the Client Characteristic Configuration. Reads of the Client Characteristic
-// Configuration only shows the configuration for that client and writes only
-// affect the configuration of that client.
-static gattCharCfg_t indCharCfg[GATT_MAX_NUM_CONN];
+// of the Client Characteristic Configuration, it's kept in the CCCD store
+// as GATT_CCCD_SERVICE_CHANGED.
+
+// Client Supported Features Characteristic
+static CONST uint8 clientSuppFeatUUID[ATT_BT_UUID_SIZE] =
+{
+  LO_UINT16( CLIENT_SUPPORTED_FEATURES_UUID ), HI_UINT16( CLIENT_SUPPORTED_FEATURES_UUID )
+};
+static uint8 clientSuppFeatCharProps = GATT_PROP_READ | GATT_PROP_WRITE;
+
+// Database Hash Characteristic
+static CONST uint8 dbHashUUID[ATT_BT_UUID_SIZE] =
+{
+  LO_UINT16( DATABASE_HASH_UUID ), HI_UINT16( DATABASE_HASH_UUID )
+};
+static uint8 dbHashCharProps = GATT_PROP_READ;
 
 #if defined ( TESTMODES )
   static uint16 paramValue = 0;
@@ -155,9 +265,41 @@ static gattAttribute_t gattAttrTbl[] = {
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_WRITE,
         0,
-        (uint8 *)indCharCfg
-      }
+        GATT_CCCD( GATT_CCCD_SERVICE_CHANGED )
+      },
 #endif
+
+    // Client Supported Features Declaration
+    {
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ,
+      0,
+      &clientSuppFeatCharProps
+    },
+
+      // Client Supported Features Value, one per client
+      {
+        { ATT_BT_UUID_SIZE, clientSuppFeatUUID },
+        GATT_PERMIT_READ | GATT_PERMIT_WRITE,
+        0,
+        clientFeatures
+      },
+
+    // Database Hash Declaration
+    {
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ,
+      0,
+      &dbHashCharProps
+    },
+
+      // Database Hash Value
+      {
+        { ATT_BT_UUID_SIZE, dbHashUUID },
+        GATT_PERMIT_READ,
+        0,
+        dbHash
+      }
 };
 
 /*********************************************************************
@@ -170,23 +312,66 @@ static bStatus_t gattServApp_ProcessReadByTypeReq( gattMsgEvent_t *pMsg, uint16
 static bStatus_t gattServApp_ProcessReadReq( gattMsgEvent_t *pMsg, uint16 *pErrHandle );
 static bStatus_t gattServApp_ProcessReadBlobReq( gattMsgEvent_t *pMsg, uint16 *pErrHandle );
 static bStatus_t gattServApp_ProcessReadMultiReq( gattMsgEvent_t *pMsg, uint16 *pErrHandle );
+static bStatus_t gattServApp_ProcessReadMultiVarReq( uint16 connHandle, uint8 *pParams, uint16 len );
 static bStatus_t gattServApp_ProcessReadByGrpTypeReq( gattMsgEvent_t *pMsg, uint16 *pErrHandle );
 static bStatus_t gattServApp_ProcessWriteReq( gattMsgEvent_t *pMsg, uint16 *pErrHandle );
 static bStatus_t gattServApp_ProcessPrepareWriteReq( gattMsgEvent_t *pMsg, uint16 *pErrHandle );
 static bStatus_t gattServApp_ProcessExecuteWriteReq( gattMsgEvent_t *pMsg, uint16 *pErrHandle );
 
-static bStatus_t gattServApp_RegisterServiceCBs( uint16 handle, CONST gattServiceCBs_t *pServiceCBs );
+static bStatus_t gattServApp_RegisterServiceCBs( gattAttribute_t *pAttrs, uint16 numAttrs,
+                                                 CONST gattServiceCBs_t *pServiceCBs );
 static bStatus_t gattServApp_DeregisterServiceCBs( uint16 handle );
 static bStatus_t gattServApp_SetNumPrepareWrites( uint8 numPrepareWrites );
 static uint8 gattServApp_PrepareWriteQInUse( void );
+static uint16 gattServApp_FindServiceCBsIdx( uint16 handle );
 static CONST gattServiceCBs_t *gattServApp_FindServiceCBs( uint16 service );
+static void gattServApp_BuildUUIDIdx( void );
+static uint16 gattServApp_UUIDKey( const uint8 *pUUID, uint8 len );
+static gattAttribute_t *gattServApp_FindHandle( uint16 handle, uint16 *pService );
+static gattAttribute_t *gattServApp_FindHandleUUID( uint16 startHandle, uint16 endHandle,
+                                                    const uint8 *pUUID, uint16 len, uint16 *pHandle );
+static gattAttribute_t *gattServApp_FindNextAttr( gattAttribute_t *pAttr, uint16 endHandle,
+                                                  uint16 *pService, uint16 *pLastHandle );
+static void gattServApp_DbChanged( void );
+static uint8 gattServApp_ClientChangeAware( gattMsgEvent_t *pMsg );
+static void gattServApp_SetChangeAware( uint16 connHandle );
+static void gattServApp_SendClientInfoEvent( uint16 connHandle );
+static void gattServApp_CmacBlock( gattCmac_t *pCmac, uint8 *pBlock );
+static void gattServApp_CmacUpdate( gattCmac_t *pCmac, uint8 *pData, uint8 len );
+static void gattServApp_CmacFinal( gattCmac_t *pCmac, uint8 *pMac );
+static void gattServApp_ComputeDbHash( void );
+static bStatus_t gattServApp_SendNoti( uint16 connHandle, gattNoti_t *pNoti );
+static bStatus_t gattServApp_SendMultiNoti( uint16 connHandle, uint8 *pNum );
+static void gattServApp_SendNotis( uint16 connHandle );
+static void gattServApp_SendQueuedNotis( void );
+static void gattServApp_FlushNotis( uint16 connHandle );
+static void gattServApp_UpdateConnEvtNotice( void );
 static bStatus_t gattServApp_EnqueuePrepareWriteReq( uint16 connHandle, attPrepareWriteReq_t *pReq );
-static prepareWrites_t *gattServApp_FindPrepareWriteQ( uint16 connHandle );
+static void gattServApp_DequeuePrepareWriteReqs( uint16 connHandle );
+static bStatus_t gattServApp_PrepareLongWrite( uint16 connHandle, gattAttribute_t *pAttr,
+                                               uint16 service, attPrepareWriteReq_t *pReq );
+static bStatus_t gattServApp_EndLongWrites( uint16 connHandle, uint8 op, uint16 *pErrHandle );
+static longWrite_t *gattServApp_FindLongWrite( uint16 connHandle, uint16 handle );
 static gattCharCfg_t *gattServApp_FindCharCfgItem( uint16 connHandle,
                                                    gattCharCfg_t *charCfgTbl );
+static uint8 gattServApp_CCCDIdx( gattAttribute_t *pAttr );
+static uint16 gattServApp_ReadCCC( uint16 connHandle, gattAttribute_t *pAttr );
+static bStatus_t gattServApp_WriteCCC( uint16 connHandle, gattAttribute_t *pAttr,
+                                       uint16 value );
 static pfnGATTReadAttrCB_t gattServApp_FindReadAttrCB( uint16 handle );
 static pfnGATTWriteAttrCB_t gattServApp_FindWriteAttrCB( uint16 handle );
 static pfnGATTAuthorizeAttrCB_t gattServApp_FindAuthorizeAttrCB( uint16 handle );
+static bStatus_t gattServApp_AuthorizeRead( uint16 connHandle, gattAttribute_t *pAttr,
+                                            uint16 service );
+static uint8 gattServApp_ServiceValue( gattAttribute_t *pAttr );
+static bStatus_t gattServApp_GetAttrValue( uint16 connHandle, gattAttribute_t *pAttr,
+                                           uint16 service, uint8 **ppValue, uint16 *pLen );
+static bStatus_t gattServApp_ReadAttrValue( uint16 connHandle, gattAttribute_t *pAttr,
+                                            uint16 service, uint8 *pValue, uint8 *pLen,
+                                            uint16 offset, uint8 maxLen );
+
+// Patch of the ROM, see GATTServApp_Init()
+uint8 gattServApp_ParsePacket( l2capPacket_t *pPkt, hciDataEvent_t *pHciMsg );
 
 /*
 need include cksys.lib
@@ -202,6 +387,8 @@ extern uint16 gattServApp_simple_handle;
 
 // GATT App Callback functions
 static void gattServApp_HandleConnStatusCB( uint16 connHandle, uint8 changeType );
+static bStatus_t gattServApp_ReadAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
+                                         uint8 *pValue, uint8 *pLen, uint16 offset, uint8 maxLen );
 static bStatus_t gattServApp_WriteAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
                                           uint8 *pValue, uint8 len, uint16 offset );
 
@@ -211,7 +398,7 @@ static bStatus_t gattServApp_WriteAttrCB( uint16 connHandle, gattAttribute_t *pA
 // GATT Service Callbacks
 CONST gattServiceCBs_t gattServiceCBs =
 {
-  NULL,                    // Read callback function pointer
+  gattServApp_ReadAttrCB,  // Read callback function pointer
   gattServApp_WriteAttrCB, // Write callback function pointer
   NULL                     // Authorization callback function pointer
 };
@@ -245,16 +432,13 @@ void GATTServApp_Init( uint8 taskId )
   GATTServApp_TaskID = taskId;
 
   // Initialize Client Characteristic Configuration attributes
-  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, indCharCfg );
+  GATTServApp_InitCCCD( INVALID_CONNHANDLE );
 
-  // Initialize Prepare Write Table
-  for ( uint8 i = 0; i < MAX_NUM_LL_CONN; i++ )
+  // Initialize Long Write Table
+  for ( uint8 i = 0; i < GATT_MAX_NUM_LONG_WRITES; i++ )
   {
-    // Initialize connection handle
-    prepareWritesTbl[i].connHandle = INVALID_CONNHANDLE;
-
-    // Initialize the prepare write queue
-    prepareWritesTbl[i].pPrepareWriteQ = NULL;
+    longWritesTbl[i].connHandle = INVALID_CONNHANDLE;
+    longWritesTbl[i].handle = GATT_INVALID_HANDLE;
   }
 
   // Set up the initial prepare write queues
@@ -265,6 +449,44 @@ void GATTServApp_Init( uint8 taskId )
 
   // Register with Link DB to receive link status change callback
   VOID linkDB_Register( gattServApp_HandleConnStatusCB );
+
+  // Requests the ATT parser of the host library doesn't know are taken
+  // from L2CAP before it
+  JUMP_FUNCTION( L2CAP_PARSE_PACKET ) = (uint32_t)&gattServApp_ParsePacket;
+}
+
+/*********************************************************************
+ * @fn      gattServApp_ParsePacket
+ *
+ * @brief   Parse an L2CAP packet, in place of l2capParsePacket() of the
+ *          host library. A Read Multiple Variable Length Request is
+ *          answered here, since the host library doesn't know it, and is
+ *          passed on as a command ATT ignores.
+ *
+ *          NOTE: Called by the ROM through the jump table.
+ *
+ * @param   pPkt - L2CAP packet (to be returned)
+ * @param   pHciMsg - HCI data message
+ *
+ * @return  What l2capParsePacket0() returns, TRUE for a whole packet.
+ */
+uint8 gattServApp_ParsePacket( l2capPacket_t *pPkt, hciDataEvent_t *pHciMsg )
+{
+  uint8 ret = l2capParsePacket0( pPkt, pHciMsg );
+
+  if ( ( ret == TRUE )                    &&
+       ( pPkt->CID == L2CAP_CID_ATT )     &&
+       ( pPkt->len > 0 )                  &&
+       ( pPkt->pPayload[0] == ATT_READ_MULTI_VAR_REQ ) )
+  {
+    VOID gattServApp_ProcessReadMultiVarReq( pHciMsg->connHandle, &(pPkt->pPayload[1]),
+                                             pPkt->len - 1 );
+
+    // The buffer stays with the host library
+    pPkt->pPayload[0] = GATT_IGNORED_CMD;
+  }
+
+  return ( ret );
 }
 
 /*********************************************************************
@@ -309,6 +531,19 @@ uint16 GATTServApp_ProcessEvent( uint8 task_id, uint16 events )
     return (events ^ SYS_EVENT_MSG);
   }
 
+  if ( events & GATT_SERV_NOTI_EVT )
+  {
+    gattServApp_SendQueuedNotis();
+
+    // Pass the notice on to the application
+    if ( appConnEvtEvent != 0 )
+    {
+      VOID osal_set_event( appConnEvtTaskID, appConnEvtEvent );
+    }
+
+    return ( events ^ GATT_SERV_NOTI_EVT );
+  }
+
   // Discard unknown events
   return 0;
 }
@@ -349,11 +584,10 @@ bStatus_t GATTServApp_RegisterService( gattAttribute_t *pAttrs, uint16 numAttrs,
 			GATTServApp_RegisterService_simple(pAttrs,numAttrs);
 		}
 
-    if ( ( status == SUCCESS ) && ( pServiceCBs != NULL ) )
+    if ( status == SUCCESS )
     {
-      // Register the service CBs with GATT Server Application
-      status = gattServApp_RegisterServiceCBs( GATT_SERVICE_HANDLE( pAttrs ),
-                                               pServiceCBs );
+      // Register the service and its CBs with GATT Server Application
+      status = gattServApp_RegisterServiceCBs( pAttrs, numAttrs, pServiceCBs );
     }
   }
   else
@@ -498,50 +732,39 @@ bStatus_t GATTServApp_GetParameter( uint8 param, void *pValue )
  */
 static bStatus_t gattServApp_SetNumPrepareWrites( uint8 numPrepareWrites )
 {
-  attPrepareWriteReq_t *pQueue;
-  uint16 queueSize = ( MAX_NUM_LL_CONN * numPrepareWrites * sizeof( attPrepareWriteReq_t ) );
+  prepareWrite_t *pQueue;
+
+#ifdef PREPARE_QUEUE_STATIC
+  // The static queue can't grow
+  if ( numPrepareWrites > GATT_MAX_NUM_PREPARE_WRITES )
+  {
+    return ( bleInvalidRange );
+  }
+#endif
 
-  // First make sure no one can get access to the Prepare Write Table
+  // First make sure no one can get access to the Prepare Write queue
   maxNumPrepareWrites = 0;
+  numPrepareWritesQ = 0;
 
-  // Free the existing prepare write queues
-  if ( prepareWritesTbl[0].pPrepareWriteQ != NULL )
+  // Free the existing prepare write queue
+  if ( prepareWritesTbl != NULL )
   {
   #ifndef PREPARE_QUEUE_STATIC
-    osal_mem_free( prepareWritesTbl[0].pPrepareWriteQ );
+    osal_mem_free( prepareWritesTbl );
   #endif
 
-    // Null out the prepare writes queues
-    for ( uint8 i = 0; i < MAX_NUM_LL_CONN; i++ )
-    {
-      prepareWritesTbl[i].pPrepareWriteQ = NULL;
-    }
+    prepareWritesTbl = NULL;
   }
 
-  // Allocate the prepare write queues
+  // Allocate the prepare write queue
   #ifdef PREPARE_QUEUE_STATIC
   pQueue = prepareQueue;
   #else
-  pQueue = osal_mem_alloc( queueSize );
+  pQueue = osal_mem_alloc( numPrepareWrites * sizeof( prepareWrite_t ) );
   #endif
   if ( pQueue != NULL )
   {
-    // Initialize the prepare write queues
-    VOID osal_memset( pQueue, 0, queueSize );
-
-    // Set up the prepare write queue for each client (i.e., connection)
-    for ( uint8 i = 0; i < MAX_NUM_LL_CONN; i++ )
-    {
-      uint8 nextQ = i * numPrepareWrites; // Index of next available queue
-
-      prepareWritesTbl[i].pPrepareWriteQ = &(pQueue[nextQ]);
-
-      // Mark the prepare write request items as empty
-      for ( uint8 j = 0; j < numPrepareWrites; j++ )
-      {
-        prepareWritesTbl[i].pPrepareWriteQ[j].handle = GATT_INVALID_HANDLE;
-      }
-    }
+    prepareWritesTbl = pQueue;
 
     // Set the new number of prepare writes
     maxNumPrepareWrites = numPrepareWrites;
@@ -632,19 +855,21 @@ bStatus_t GATTServApp_DelService( uint32 services )
 /******************************************************************************
  * @fn      gattServApp_RegisterServiceCBs
  *
- * @brief   Register callback functions for a service.
+ * @brief   Register a service and its callback functions.
  *
- * @param   handle - handle of service being registered
- * @param   pServiceCBs - pointer to service CBs to be registered
+ * @param   pAttrs - attribute list of service being registered
+ * @param   numAttrs - number of attributes in list
+ * @param   pServiceCBs - pointer to service CBs to be registered, or NULL
  *
  * @return  SUCCESS: Service CBs were registered successfully.
  *          INVALIDPARAMETER: Invalid service CB field.
  *          bleMemAllocError: Memory allocation error occurred.
  */
-static bStatus_t gattServApp_RegisterServiceCBs( uint16 handle,
+static bStatus_t gattServApp_RegisterServiceCBs( gattAttribute_t *pAttrs, uint16 numAttrs,
                                                  CONST gattServiceCBs_t *pServiceCBs )
 {
-  serviceCBsList_t *pNewItem;
+  uint16 handle = GATT_SERVICE_HANDLE( pAttrs );
+  uint16 idx;
 
   // Make sure the service handle is specified
   if ( handle == GATT_INVALID_HANDLE )
@@ -652,39 +877,48 @@ static bStatus_t gattServApp_RegisterServiceCBs( uint16 handle,
     return ( INVALIDPARAMETER );
   }
 
-  // Fill in the new service list
-  pNewItem = (serviceCBsList_t *)osal_mem_alloc( sizeof( serviceCBsList_t ) );
-  if ( pNewItem == NULL )
+  // Grow the table if it's full
+  if ( numServiceCBs == maxServiceCBs )
   {
-    // Not enough memory
-    return ( bleMemAllocError );
-  }
-
-  // Set up new service CBs item
-  pNewItem->next = NULL;
-  pNewItem->serviceInfo.handle = handle;
-  pNewItem->serviceInfo.pCBs = pServiceCBs;
+    gattServiceCBsInfo_t *pNewTbl;
 
-  // Find spot in list
-  if ( serviceCBsList == NULL )
-  {
-    // First item in list
-    serviceCBsList = pNewItem;
-  }
-  else
-  {
-    serviceCBsList_t *pLoop = serviceCBsList;
+    pNewTbl = (gattServiceCBsInfo_t *)osal_mem_alloc( (maxServiceCBs + GATT_SERVICE_CBS_TBL_INC) *
+                                                      sizeof( gattServiceCBsInfo_t ) );
+    if ( pNewTbl == NULL )
+    {
+      // Not enough memory
+      return ( bleMemAllocError );
+    }
 
-    // Look for end of list
-    while ( pLoop->next != NULL )
+    if ( serviceCBsTbl != NULL )
     {
-      pLoop = pLoop->next;
+      VOID osal_memcpy( pNewTbl, serviceCBsTbl, numServiceCBs * sizeof( gattServiceCBsInfo_t ) );
+      osal_mem_free( serviceCBsTbl );
     }
 
-    // Put new item at end of list
-    pLoop->next = pNewItem;
+    serviceCBsTbl = pNewTbl;
+    maxServiceCBs += GATT_SERVICE_CBS_TBL_INC;
+  }
+
+  // Find spot in table, services are normally registered in handle order
+  // so this is the end of the table
+  idx = numServiceCBs;
+  while ( ( idx > 0 ) && ( serviceCBsTbl[idx-1].handle > handle ) )
+  {
+    serviceCBsTbl[idx] = serviceCBsTbl[idx-1];
+    idx--;
   }
 
+  // Set up new service CBs item
+  serviceCBsTbl[idx].handle = handle;
+  serviceCBsTbl[idx].numAttrs = numAttrs;
+  serviceCBsTbl[idx].pAttrs = pAttrs;
+  serviceCBsTbl[idx].pCBs = pServiceCBs;
+  numServiceCBs++;
+
+  gattServApp_BuildUUIDIdx();
+  gattServApp_DbChanged();
+
   return ( SUCCESS );
 }
 
@@ -700,37 +934,69 @@ static bStatus_t gattServApp_RegisterServiceCBs( uint16 handle,
  */
 static bStatus_t gattServApp_DeregisterServiceCBs( uint16 handle )
 {
-  serviceCBsList_t *pLoop = serviceCBsList;
-  serviceCBsList_t *pPrev = NULL;
+  uint16 idx = gattServApp_FindServiceCBsIdx( handle );
 
-  // Look for service
-  while ( pLoop != NULL )
+  if ( idx == numServiceCBs )
   {
-    if ( pLoop->serviceInfo.handle == handle )
-    {
-      // Service CBs found; unlink it
-      if ( pPrev == NULL )
-      {
-        // First item in list
-        serviceCBsList = pLoop->next;
-      }
-      else
-      {
-        pPrev->next = pLoop->next;
-      }
+    // Service CBs not found
+    return ( FAILURE );
+  }
+
+  // Service CBs found; close the gap
+  numServiceCBs--;
+  for ( ; idx < numServiceCBs; idx++ )
+  {
+    serviceCBsTbl[idx] = serviceCBsTbl[idx+1];
+  }
+
+  if ( numServiceCBs == 0 )
+  {
+    // Free the table with the last service
+    osal_mem_free( serviceCBsTbl );
+    serviceCBsTbl = NULL;
+    maxServiceCBs = 0;
+  }
+
+  gattServApp_BuildUUIDIdx();
+  gattServApp_DbChanged();
+
+  return ( SUCCESS );
+}
 
-      // Free the service CB record
-      osal_mem_free( pLoop );
+/*********************************************************************
+ * @fn      gattServApp_FindServiceCBsIdx
+ *
+ * @brief   Find the index of a service in the callbacks table.
+ *
+ * @param   handle - owner of service
+ *
+ * @return  Index of service record. numServiceCBs, otherwise.
+ */
+static uint16 gattServApp_FindServiceCBsIdx( uint16 handle )
+{
+  uint16 lo = 0;
+  uint16 hi = numServiceCBs;
+
+  while ( lo < hi )
+  {
+    uint16 mid = ( lo + hi ) >> 1;
 
-      return ( SUCCESS );
+    if ( serviceCBsTbl[mid].handle == handle )
+    {
+      return ( mid );
     }
 
-    pPrev = pLoop;
-    pLoop = pLoop->next;
+    if ( serviceCBsTbl[mid].handle < handle )
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
   }
 
-  // Service CBs not found
-  return ( FAILURE );
+  return ( numServiceCBs );
 }
 
 /*********************************************************************
@@ -744,182 +1010,789 @@ static bStatus_t gattServApp_DeregisterServiceCBs( uint16 handle )
  */
 static CONST gattServiceCBs_t *gattServApp_FindServiceCBs( uint16 handle )
 {
-  serviceCBsList_t *pLoop = serviceCBsList;
+  uint16 idx = gattServApp_FindServiceCBsIdx( handle );
 
-  while ( pLoop != NULL )
+  if ( idx == numServiceCBs )
   {
-    if ( pLoop->serviceInfo.handle == handle )
-    {
-      return ( pLoop->serviceInfo.pCBs );
-    }
-
-    // Try next service
-    pLoop = pLoop->next;
+    return ( (gattServiceCBs_t *)NULL );
   }
 
-  return ( (gattServiceCBs_t *)NULL );
+  return ( serviceCBsTbl[idx].pCBs );
 }
 
 /*********************************************************************
- * @fn          gattServApp_ProcessMsg
+ * @fn      gattServApp_BuildUUIDIdx
  *
- * @brief       GATT Server App message processing function.
+ * @brief   Rebuild the UUID index of all registered attributes. The
+ *          index is dropped if a service doesn't have consecutive
+ *          handles or there's not enough memory.
  *
- * @param       pMsg - pointer to received message
+ * @param   none
  *
- * @return      Success or Failure
+ * @return  none
  */
-static void gattServApp_ProcessMsg( gattMsgEvent_t *pMsg )
+static void gattServApp_BuildUUIDIdx( void )
 {
-  uint16 errHandle = GATT_INVALID_HANDLE;
-  uint8 status;
+  uint16 num = 0;
+  uint16 i, j;
 
-#if defined ( TESTMODES )
-  if ( paramValue == GATT_TESTMODE_NO_RSP )
+  if ( uuidIdxTbl != NULL )
   {
-    // Notify GATT that a message has been processed
-    // Note: This call is optional if flow control is not used.
-    GATT_AppCompletedMsg( pMsg );
-  
-    // Just ignore the incoming request messages
-    return;
+    osal_mem_free( uuidIdxTbl );
+    uuidIdxTbl = NULL;
+    numUUIDIdx = 0;
   }
-#endif
 
-  // Process the GATT server message
-  switch ( pMsg->method )
+  for ( i = 0; i < numServiceCBs; i++ )
   {
-    case ATT_EXCHANGE_MTU_REQ:
-      status = gattServApp_ProcessExchangeMTUReq( pMsg );
-      break;
-
-    case ATT_FIND_BY_TYPE_VALUE_REQ:
-      status = gattServApp_ProcessFindByTypeValueReq( pMsg, &errHandle );
-      break;
-
-    case ATT_READ_BY_TYPE_REQ:
-      status = gattServApp_ProcessReadByTypeReq( pMsg, &errHandle );
-      break;
-
-    case ATT_READ_REQ:
-      status = gattServApp_ProcessReadReq( pMsg, &errHandle );
-      break;
-
-    case ATT_READ_BLOB_REQ:
-      status = gattServApp_ProcessReadBlobReq( pMsg, &errHandle );
-      break;
+    gattServiceCBsInfo_t *pInfo = &serviceCBsTbl[i];
 
-    case ATT_READ_MULTI_REQ:
-      status = gattServApp_ProcessReadMultiReq( pMsg, &errHandle );
-      break;
-
-    case ATT_READ_BY_GRP_TYPE_REQ:
-      status = gattServApp_ProcessReadByGrpTypeReq( pMsg, &errHandle );
-      break;
-
-    case ATT_WRITE_REQ:
-      status = gattServApp_ProcessWriteReq( pMsg, &errHandle );
-      break;
+    for ( j = 0; j < pInfo->numAttrs; j++ )
+    {
+      if ( pInfo->pAttrs[j].handle != pInfo->handle + j )
+      {
+        return;
+      }
+    }
 
-    case ATT_PREPARE_WRITE_REQ:
-      status = gattServApp_ProcessPrepareWriteReq( pMsg, &errHandle );
-      break;
+    num += pInfo->numAttrs;
+  }
 
-    case ATT_EXECUTE_WRITE_REQ:
-      status = gattServApp_ProcessExecuteWriteReq( pMsg, &errHandle );
-      break;
+  if ( num == 0 )
+  {
+    return;
+  }
 
-    default:
-      // Unknown request - ignore it!
-      status = SUCCESS;
-      break;
+  uuidIdxTbl = (gattUUIDIdx_t *)osal_mem_alloc( num * sizeof( gattUUIDIdx_t ) );
+  if ( uuidIdxTbl == NULL )
+  {
+    return;
   }
 
-  // See if we need to send an error response back
-  if ( status != SUCCESS )
+  // Insert in order, the services are walked in handle order so equal
+  // UUIDs never move
+  for ( i = 0; i < numServiceCBs; i++ )
   {
-    // Make sure the request was not sent locally
-    if ( pMsg->hdr.status != bleNotConnected )
+    gattServiceCBsInfo_t *pInfo = &serviceCBsTbl[i];
+
+    for ( j = 0; j < pInfo->numAttrs; j++ )
     {
-      attErrorRsp_t *pRsp = &rsp.errorRsp;
+      gattAttribute_t *pAttr = &pInfo->pAttrs[j];
+      uint16 uuid = gattServApp_UUIDKey( pAttr->type.uuid, pAttr->type.len );
+      uint16 k = numUUIDIdx++;
 
-      pRsp->reqOpcode = pMsg->method;
-      pRsp->handle = errHandle;
-      pRsp->errCode = status;
+      while ( ( k > 0 ) && ( uuidIdxTbl[k-1].uuid > uuid ) )
+      {
+        uuidIdxTbl[k] = uuidIdxTbl[k-1];
+        k--;
+      }
 
-      VOID ATT_ErrorRsp( pMsg->connHandle, pRsp );
+      uuidIdxTbl[k].uuid = uuid;
+      uuidIdxTbl[k].handle = pAttr->handle;
     }
   }
-  
-  // Notify GATT that a message has been processed
-  // Note: This call is optional if flow control is not used.
-  GATT_AppCompletedMsg( pMsg );
-
-  // if app task ask the gatt message, copy and send to app task
-  if(s_GATTServCB)
-    s_GATTServCB(pMsg);
 }
 
 /*********************************************************************
- * @fn          gattServApp_ProcessExchangeMTUReq
+ * @fn      gattServApp_UUIDKey
  *
- * @brief       Process Exchange MTU Request.
+ * @brief   Get the UUID index key of a UUID.
  *
- * @param       pMsg - pointer to received message
+ * @param   pUUID - pointer to UUID
+ * @param   len - length of UUID
  *
- * @return      Success
+ * @return  16-bit UUID, also for a 128-bit UUID based on the Bluetooth
+ *          Base UUID. GATT_UUID_KEY_128, otherwise.
  */
-static bStatus_t gattServApp_ProcessExchangeMTUReq( gattMsgEvent_t *pMsg )
+static uint16 gattServApp_UUIDKey( const uint8 *pUUID, uint8 len )
 {
-  attExchangeMTURsp_t *pRsp = &rsp.exchangeMTURsp;
-
-  // ATT_MTU shall be set to the minimum of the Client Rx MTU and Server Rx MTU values
-
-  // Set the Server Rx MTU parameter to the maximum MTU that this server can receive
-#if defined ( TESTMODES )
-  if ( paramValue == GATT_TESTMODE_MAX_MTU_SIZE )
+  if ( len == ATT_BT_UUID_SIZE )
   {
-    pRsp->serverRxMTU = ATT_MAX_MTU_SIZE;
+    return ( BUILD_UINT16( pUUID[0], pUUID[1] ) );
   }
-  else
-#endif
-  pRsp->serverRxMTU = g_ATT_MTU_SIZE_MAX;//ATT_MTU_SIZE;
 
-  // Send response back
-  VOID ATT_ExchangeMTURsp( pMsg->connHandle, pRsp );
+  if ( ( len == ATT_UUID_SIZE )                  &&
+       osal_memcmp( pUUID, btBaseUUID, 12 )      &&
+       ( pUUID[14] == 0 ) && ( pUUID[15] == 0 ) )
+  {
+    return ( BUILD_UINT16( pUUID[12], pUUID[13] ) );
+  }
 
-  return ( SUCCESS );
+  return ( GATT_UUID_KEY_128 );
 }
 
 /*********************************************************************
- * @fn          gattServApp_ProcessFindByTypeValueReq
+ * @fn      gattServApp_FindHandle
  *
- * @brief       Process Find By Type Value Request.
+ * @brief   Find the attribute record for a given handle.
  *
- * @param       pMsg - pointer to received message
- * @param       pErrHandle - attribute handle that generates an error
+ * @param   handle - handle to look for
+ * @param   pService - handle of owner of attribute (to be returned)
  *
- * @return      Success or Failure
+ * @return  Pointer to attribute record. NULL, otherwise.
  */
-static bStatus_t gattServApp_ProcessFindByTypeValueReq( gattMsgEvent_t *pMsg, uint16 *pErrHandle )
+static gattAttribute_t *gattServApp_FindHandle( uint16 handle, uint16 *pService )
 {
-  attFindByTypeValueReq_t *pReq = &pMsg->msg.findByTypeValueReq;
-  attFindByTypeValueRsp_t *pRsp = &rsp.findByTypeValueRsp;
-  gattAttribute_t *pAttr;
-  uint16 service;
-
-  // Initialize the response
-  VOID osal_memset( pRsp, 0, sizeof( attFindByTypeValueRsp_t ) );
+  uint16 lo = 0;
+  uint16 hi = numServiceCBs;
 
-  // Only attributes with attribute handles between and including the Starting
-  // Handle parameter and the Ending Handle parameter that match the requested
-  // attribute type and the attribute value will be returned.
+  // Find the last service starting at or before the handle
+  while ( lo < hi )
+  {
+    uint16 mid = ( lo + hi ) >> 1;
 
-  // All attribute types are effectively compared as 128-bit UUIDs,
-  // even if a 16-bit UUID is provided in this request or defined
+    if ( serviceCBsTbl[mid].handle <= handle )
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  if ( lo > 0 )
+  {
+    gattServiceCBsInfo_t *pInfo = &serviceCBsTbl[lo-1];
+
+    if ( handle - pInfo->handle < pInfo->numAttrs )
+    {
+      *pService = pInfo->handle;
+
+      return ( &pInfo->pAttrs[handle - pInfo->handle] );
+    }
+  }
+
+  return ( (gattAttribute_t *)NULL );
+}
+
+/*********************************************************************
+ * @fn      gattServApp_FindHandleUUID
+ *
+ * @brief   Find the attribute record for a given handle range and UUID,
+ *          using the UUID index. Same as GATT_FindHandleUUID().
+ *
+ * @param   startHandle - first handle to look for
+ * @param   endHandle - last handle to look for
+ * @param   pUUID - pointer to UUID to look for
+ * @param   len - length of UUID
+ * @param   pHandle - handle of owner of attribute (to be returned)
+ *
+ * @return  Pointer to attribute record. NULL, otherwise.
+ */
+static gattAttribute_t *gattServApp_FindHandleUUID( uint16 startHandle, uint16 endHandle,
+                                                    const uint8 *pUUID, uint16 len, uint16 *pHandle )
+{
+  uint16 uuid;
+  uint16 lo = 0;
+  uint16 hi = numUUIDIdx;
+
+  if ( uuidIdxTbl == NULL )
+  {
+    return ( GATT_FindHandleUUID( startHandle, endHandle, pUUID, len, pHandle ) );
+  }
+
+  uuid = gattServApp_UUIDKey( pUUID, (uint8)len );
+
+  // Find the first entry of this UUID at or after the start handle
+  while ( lo < hi )
+  {
+    uint16 mid = ( lo + hi ) >> 1;
+
+    if ( ( uuidIdxTbl[mid].uuid < uuid ) ||
+         ( ( uuidIdxTbl[mid].uuid == uuid ) && ( uuidIdxTbl[mid].handle < startHandle ) ) )
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  for ( ; ( lo < numUUIDIdx ) && ( uuidIdxTbl[lo].uuid == uuid ); lo++ )
+  {
+    gattAttribute_t *pAttr;
+
+    if ( uuidIdxTbl[lo].handle > endHandle )
+    {
+      break;
+    }
+
+    pAttr = gattServApp_FindHandle( uuidIdxTbl[lo].handle, pHandle );
+
+    // Other 128-bit UUIDs share one key
+    if ( ( uuid != GATT_UUID_KEY_128 ) ||
+         ( ( pAttr->type.len == len ) && osal_memcmp( pAttr->type.uuid, pUUID, len ) ) )
+    {
+      return ( pAttr );
+    }
+  }
+
+  return ( (gattAttribute_t *)NULL );
+}
+
+/*********************************************************************
+ * @fn      gattServApp_FindNextAttr
+ *
+ * @brief   Find the next attribute of the same type for a given attribute,
+ *          using the UUID index. Same as GATT_FindNextAttr(), except that
+ *          the owner of the next attribute is returned for the caller to
+ *          read it with.
+ *
+ * @param   pAttr - pointer to attribute to find a next for
+ * @param   endHandle - last handle to look for
+ * @param   pService - handle of owner service of the attribute, and of
+ *                     the next attribute (to be returned)
+ * @param   pLastHandle - handle of last attribute (to be returned)
+ *
+ * @return  Pointer to next attribute record. NULL, otherwise.
+ */
+static gattAttribute_t *gattServApp_FindNextAttr( gattAttribute_t *pAttr, uint16 endHandle,
+                                                  uint16 *pService, uint16 *pLastHandle )
+{
+  gattAttribute_t *pNext;
+  uint16 nextService;
+  uint16 idx;
+
+  if ( uuidIdxTbl == NULL )
+  {
+    pNext = GATT_FindNextAttr( pAttr, endHandle, *pService, pLastHandle );
+    if ( pNext != NULL )
+    {
+      VOID GATT_FindHandle( pNext->handle, pService );
+    }
+
+    return ( pNext );
+  }
+
+  if ( pAttr->handle >= endHandle )
+  {
+    return ( (gattAttribute_t *)NULL );
+  }
+
+  pNext = gattServApp_FindHandleUUID( pAttr->handle + 1, endHandle, pAttr->type.uuid,
+                                      pAttr->type.len, &nextService );
+  if ( pNext != NULL )
+  {
+    // The last attribute before the next one, the end of the attribute's
+    // own service if the next one starts a service. A service registered
+    // in between, like a secondary service, is not part of this group.
+    if ( pNext->handle != nextService )
+    {
+      *pLastHandle = pNext->handle - 1;
+    }
+    else
+    {
+      idx = gattServApp_FindServiceCBsIdx( *pService );
+      *pLastHandle = serviceCBsTbl[idx].handle + serviceCBsTbl[idx].numAttrs - 1;
+    }
+
+    *pService = nextService;
+  }
+
+  return ( pNext );
+}
+
+/*********************************************************************
+ * @fn      gattServApp_DbChanged
+ *
+ * @brief   Note a change of the attribute database. The Database Hash
+ *          is computed again on its next read, and connected clients
+ *          that support Robust Caching become change-unaware.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void gattServApp_DbChanged( void )
+{
+  dbHashValid = FALSE;
+
+  for ( uint8 i = 0; i < GATT_MAX_NUM_CONN; i++ )
+  {
+    if ( clientFeatures[i] & GATT_CLIENT_FEAT_ROBUST_CACHING )
+    {
+      clientState[i] = GATT_CLIENT_CHANGE_UNAWARE;
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      gattServApp_ClientChangeAware
+ *
+ * @brief   Check if a message may be processed for its client. A
+ *          change-unaware client becomes change-aware when it reads the
+ *          Database Hash, confirms a Service Changed Indication, or sends
+ *          another request after a Database Out Of Sync error.
+ *
+ * @param   pMsg - pointer to received message
+ *
+ * @return  TRUE to process the message. FALSE, otherwise.
+ */
+static uint8 gattServApp_ClientChangeAware( gattMsgEvent_t *pMsg )
+{
+  uint16 connHandle = pMsg->connHandle;
+
+  if ( ( connHandle >= GATT_MAX_NUM_CONN ) ||
+       ( ( clientState[connHandle] & GATT_CLIENT_CHANGE_UNAWARE ) == 0 ) )
+  {
+    return ( TRUE );
+  }
+
+  switch ( pMsg->method )
+  {
+    case ATT_EXCHANGE_MTU_REQ:
+      // Doesn't depend on the database
+      return ( TRUE );
+
+    case ATT_HANDLE_VALUE_CFM:
+      // Only one indication is outstanding per client, so while the
+      // Service Changed Indication is pending this confirms it. It's only
+      // seen here if it was sent with the GATT Server Application task.
+      if ( clientState[connHandle] & GATT_CLIENT_SVC_CHG_PENDING )
+      {
+        gattServApp_SetChangeAware( connHandle );
+      }
+      return ( TRUE );
+
+    case ATT_READ_BY_TYPE_REQ:
+      if ( gattServApp_UUIDKey( pMsg->msg.readByTypeReq.type.uuid,
+                                pMsg->msg.readByTypeReq.type.len ) == DATABASE_HASH_UUID )
+      {
+        gattServApp_SetChangeAware( connHandle );
+        return ( TRUE );
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  // Commands are dropped and don't count as the next request
+  if ( ( pMsg->method == ATT_WRITE_REQ ) && ( pMsg->msg.writeReq.cmd == TRUE ) )
+  {
+    return ( FALSE );
+  }
+
+  if ( clientState[connHandle] & GATT_CLIENT_OUT_OF_SYNC_SENT )
+  {
+    gattServApp_SetChangeAware( connHandle );
+    return ( TRUE );
+  }
+
+  clientState[connHandle] |= GATT_CLIENT_OUT_OF_SYNC_SENT;
+
+  return ( FALSE );
+}
+
+/*********************************************************************
+ * @fn      gattServApp_SetChangeAware
+ *
+ * @brief   Make a client change-aware. The Bond Manager is told so a
+ *          bonded Robust Caching client stays change-aware across
+ *          connections.
+ *
+ * @param   connHandle - connection handle
+ *
+ * @return  none
+ */
+static void gattServApp_SetChangeAware( uint16 connHandle )
+{
+  clientState[connHandle] = 0;
+
+  if ( clientFeatures[connHandle] & GATT_CLIENT_FEAT_ROBUST_CACHING )
+  {
+    gattServApp_SendClientInfoEvent( connHandle );
+  }
+}
+
+/*********************************************************************
+ * @fn      gattServApp_SendClientInfoEvent
+ *
+ * @brief   Build and send the GATT_CLIENT_INFO_UPDATED_EVENT to the app.
+ *
+ * @param   connHandle - connection handle
+ *
+ * @return  none
+ */
+static void gattServApp_SendClientInfoEvent( uint16 connHandle )
+{
+  if ( appTaskID != INVALID_TASK_ID )
+  {
+    gattClientInfoUpdatedEvent_t *pEvent =
+      (gattClientInfoUpdatedEvent_t *)osal_msg_allocate( (uint16)(sizeof ( gattClientInfoUpdatedEvent_t )) );
+    if ( pEvent )
+    {
+      pEvent->hdr.event = GATT_SERV_MSG_EVENT;
+      pEvent->hdr.status = SUCCESS;
+
+      pEvent->method = GATT_CLIENT_INFO_UPDATED_EVENT;
+      pEvent->connHandle = connHandle;
+
+      VOID osal_msg_send( appTaskID, (uint8 *)pEvent );
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      gattServApp_CmacBlock
+ *
+ * @brief   Add a block to an AES-CMAC calculation, with a zero key.
+ *
+ * @param   pCmac - AES-CMAC calculation
+ * @param   pBlock - block of GATT_CMAC_BLOCK_SIZE octets
+ *
+ * @return  none
+ */
+static void gattServApp_CmacBlock( gattCmac_t *pCmac, uint8 *pBlock )
+{
+  uint8 key[KEYLEN] = { 0 };
+  uint8 x[GATT_CMAC_BLOCK_SIZE];
+
+  for ( uint8 i = 0; i < GATT_CMAC_BLOCK_SIZE; i++ )
+  {
+    x[i] = pCmac->x[i] ^ pBlock[i];
+  }
+
+  // Octets are most significant first
+  VOID LL_Encrypt( key, x, pCmac->x );
+}
+
+/*********************************************************************
+ * @fn      gattServApp_CmacUpdate
+ *
+ * @brief   Add message octets to an AES-CMAC calculation.
+ *
+ * @param   pCmac - AES-CMAC calculation
+ * @param   pData - message octets
+ * @param   len - number of octets
+ *
+ * @return  none
+ */
+static void gattServApp_CmacUpdate( gattCmac_t *pCmac, uint8 *pData, uint8 len )
+{
+  while ( len-- )
+  {
+    // The last block is kept for gattServApp_CmacFinal()
+    if ( pCmac->len == GATT_CMAC_BLOCK_SIZE )
+    {
+      gattServApp_CmacBlock( pCmac, pCmac->buf );
+      pCmac->len = 0;
+    }
+
+    pCmac->buf[pCmac->len++] = *pData++;
+  }
+}
+
+/*********************************************************************
+ * @fn      gattServApp_CmacFinal
+ *
+ * @brief   Finish an AES-CMAC calculation (RFC 4493).
+ *
+ * @param   pCmac - AES-CMAC calculation
+ * @param   pMac - MAC, most significant octet first (to be returned)
+ *
+ * @return  none
+ */
+static void gattServApp_CmacFinal( gattCmac_t *pCmac, uint8 *pMac )
+{
+  uint8 key[KEYLEN] = { 0 };
+  uint8 k[GATT_CMAC_BLOCK_SIZE] = { 0 };
+  uint8 n = ( pCmac->len == GATT_CMAC_BLOCK_SIZE ) ? 1 : 2;
+  uint8 i;
+
+  // Subkey K1 for a complete last block, K2 for a padded one
+  VOID LL_Encrypt( key, k, k );
+  while ( n-- )
+  {
+    uint8 msb = k[0] & 0x80;
+
+    for ( i = 0; i < GATT_CMAC_BLOCK_SIZE - 1; i++ )
+    {
+      k[i] = ( k[i] << 1 ) | ( k[i+1] >> 7 );
+    }
+    k[i] <<= 1;
+
+    if ( msb )
+    {
+      k[i] ^= 0x87;
+    }
+  }
+
+  if ( pCmac->len < GATT_CMAC_BLOCK_SIZE )
+  {
+    pCmac->buf[pCmac->len] = 0x80;
+    VOID osal_memset( &pCmac->buf[pCmac->len+1], 0, GATT_CMAC_BLOCK_SIZE - pCmac->len - 1 );
+  }
+
+  for ( i = 0; i < GATT_CMAC_BLOCK_SIZE; i++ )
+  {
+    pCmac->buf[i] ^= k[i];
+  }
+
+  gattServApp_CmacBlock( pCmac, pCmac->buf );
+  VOID osal_memcpy( pMac, pCmac->x, GATT_CMAC_BLOCK_SIZE );
+}
+
+/*********************************************************************
+ * @fn      gattServApp_ComputeDbHash
+ *
+ * @brief   Compute the Database Hash over all registered services. The
+ *          message is the handle and type of each service, include and
+ *          characteristic declaration and descriptor, plus the value of
+ *          the declarations and the Characteristic Extended Properties,
+ *          all in handle order and least significant octet first.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void gattServApp_ComputeDbHash( void )
+{
+  gattCmac_t cmac;
+  uint8 buf[4 + 3 + ATT_UUID_SIZE];
+  uint8 mac[GATT_DB_HASH_SIZE];
+
+  VOID osal_memset( &cmac, 0, sizeof( gattCmac_t ) );
+
+  for ( uint16 i = 0; i < numServiceCBs; i++ )
+  {
+    gattServiceCBsInfo_t *pInfo = &serviceCBsTbl[i];
+
+    for ( uint16 j = 0; j < pInfo->numAttrs; j++ )
+    {
+      gattAttribute_t *pAttr = &pInfo->pAttrs[j];
+      uint16 uuid;
+      uint8 len = 0;
+
+      if ( pAttr->type.len != ATT_BT_UUID_SIZE )
+      {
+        continue;
+      }
+
+      uuid = BUILD_UINT16( pAttr->type.uuid[0], pAttr->type.uuid[1] );
+      switch ( uuid )
+      {
+        case GATT_PRIMARY_SERVICE_UUID:
+        case GATT_SECONDARY_SERVICE_UUID:
+        case GATT_INCLUDE_UUID:
+        case GATT_CHARACTER_UUID:
+        case GATT_CHAR_EXT_PROPS_UUID:
+          if ( GATTServApp_ReadAttr( 0, pAttr, pInfo->handle, &buf[4], &len,
+                                     0, sizeof( buf ) - 4 ) != SUCCESS )
+          {
+            len = 0;
+          }
+          break;
+
+        case GATT_CHAR_USER_DESC_UUID:
+        case GATT_CLIENT_CHAR_CFG_UUID:
+        case GATT_SERV_CHAR_CFG_UUID:
+        case GATT_CHAR_FORMAT_UUID:
+        case GATT_CHAR_AGG_FORMAT_UUID:
+          break;
+
+        default:
+          continue;
+      }
+
+      buf[0] = LO_UINT16( pAttr->handle );
+      buf[1] = HI_UINT16( pAttr->handle );
+      buf[2] = pAttr->type.uuid[0];
+      buf[3] = pAttr->type.uuid[1];
+
+      gattServApp_CmacUpdate( &cmac, buf, 4 + len );
+    }
+  }
+
+  gattServApp_CmacFinal( &cmac, mac );
+
+  // Sent least significant octet first like any other value
+  for ( uint8 i = 0; i < GATT_DB_HASH_SIZE; i++ )
+  {
+    dbHash[i] = mac[GATT_DB_HASH_SIZE - 1 - i];
+  }
+
+  dbHashValid = TRUE;
+}
+
+/*********************************************************************
+ * @fn          gattServApp_ProcessMsg
+ *
+ * @brief       GATT Server App message processing function.
+ *
+ * @param       pMsg - pointer to received message
+ *
+ * @return      Success or Failure
+ */
+static void gattServApp_ProcessMsg( gattMsgEvent_t *pMsg )
+{
+  uint16 errHandle = GATT_INVALID_HANDLE;
+  uint8 status;
+
+#if defined ( TESTMODES )
+  if ( paramValue == GATT_TESTMODE_NO_RSP )
+  {
+    // Notify GATT that a message has been processed
+    // Note: This call is optional if flow control is not used.
+    GATT_AppCompletedMsg( pMsg );
+  
+    // Just ignore the incoming request messages
+    return;
+  }
+#endif
+
+  // A change-unaware client has to learn about the change first
+  if ( gattServApp_ClientChangeAware( pMsg ) == FALSE )
+  {
+    // Commands are ignored
+    if ( ( pMsg->method == ATT_WRITE_REQ ) && ( pMsg->msg.writeReq.cmd == TRUE ) )
+    {
+      status = SUCCESS;
+    }
+    else
+    {
+      status = ATT_ERR_DATABASE_OUT_OF_SYNC;
+    }
+  }
+  else
+  {
+    // Process the GATT server message
+    switch ( pMsg->method )
+    {
+      case ATT_EXCHANGE_MTU_REQ:
+        status = gattServApp_ProcessExchangeMTUReq( pMsg );
+        break;
+
+      case ATT_FIND_BY_TYPE_VALUE_REQ:
+        status = gattServApp_ProcessFindByTypeValueReq( pMsg, &errHandle );
+        break;
+
+      case ATT_READ_BY_TYPE_REQ:
+        status = gattServApp_ProcessReadByTypeReq( pMsg, &errHandle );
+        break;
+
+      case ATT_READ_REQ:
+        status = gattServApp_ProcessReadReq( pMsg, &errHandle );
+        break;
+
+      case ATT_READ_BLOB_REQ:
+        status = gattServApp_ProcessReadBlobReq( pMsg, &errHandle );
+        break;
+
+      case ATT_READ_MULTI_REQ:
+        status = gattServApp_ProcessReadMultiReq( pMsg, &errHandle );
+        break;
+
+      case ATT_READ_BY_GRP_TYPE_REQ:
+        status = gattServApp_ProcessReadByGrpTypeReq( pMsg, &errHandle );
+        break;
+
+      case ATT_WRITE_REQ:
+        status = gattServApp_ProcessWriteReq( pMsg, &errHandle );
+        break;
+
+      case ATT_PREPARE_WRITE_REQ:
+        status = gattServApp_ProcessPrepareWriteReq( pMsg, &errHandle );
+        break;
+
+      case ATT_EXECUTE_WRITE_REQ:
+        status = gattServApp_ProcessExecuteWriteReq( pMsg, &errHandle );
+        break;
+
+      default:
+        // Unknown request - ignore it!
+        status = SUCCESS;
+        break;
+    }
+  }
+
+  // See if we need to send an error response back
+  if ( status != SUCCESS )
+  {
+    // Make sure the request was not sent locally
+    if ( pMsg->hdr.status != bleNotConnected )
+    {
+      attErrorRsp_t *pRsp = &rsp.errorRsp;
+
+      pRsp->reqOpcode = pMsg->method;
+      pRsp->handle = errHandle;
+      pRsp->errCode = status;
+
+      VOID ATT_ErrorRsp( pMsg->connHandle, pRsp );
+    }
+  }
+  
+  // Notify GATT that a message has been processed
+  // Note: This call is optional if flow control is not used.
+  GATT_AppCompletedMsg( pMsg );
+
+  // if app task ask the gatt message, copy and send to app task
+  if(s_GATTServCB)
+    s_GATTServCB(pMsg);
+}
+
+/*********************************************************************
+ * @fn          gattServApp_ProcessExchangeMTUReq
+ *
+ * @brief       Process Exchange MTU Request.
+ *
+ * @param       pMsg - pointer to received message
+ *
+ * @return      Success
+ */
+static bStatus_t gattServApp_ProcessExchangeMTUReq( gattMsgEvent_t *pMsg )
+{
+  attExchangeMTURsp_t *pRsp = &rsp.exchangeMTURsp;
+
+  // ATT_MTU shall be set to the minimum of the Client Rx MTU and Server Rx MTU values
+
+  // Set the Server Rx MTU parameter to the maximum MTU that this server can receive
+#if defined ( TESTMODES )
+  if ( paramValue == GATT_TESTMODE_MAX_MTU_SIZE )
+  {
+    pRsp->serverRxMTU = ATT_MAX_MTU_SIZE;
+  }
+  else
+#endif
+  pRsp->serverRxMTU = g_ATT_MTU_SIZE_MAX;//ATT_MTU_SIZE;
+
+  // Send response back
+  VOID ATT_ExchangeMTURsp( pMsg->connHandle, pRsp );
+
+  return ( SUCCESS );
+}
+
+/*********************************************************************
+ * @fn          gattServApp_ProcessFindByTypeValueReq
+ *
+ * @brief       Process Find By Type Value Request.
+ *
+ * @param       pMsg - pointer to received message
+ * @param       pErrHandle - attribute handle that generates an error
+ *
+ * @return      Success or Failure
+ */
+static bStatus_t gattServApp_ProcessFindByTypeValueReq( gattMsgEvent_t *pMsg, uint16 *pErrHandle )
+{
+  attFindByTypeValueReq_t *pReq = &pMsg->msg.findByTypeValueReq;
+  attFindByTypeValueRsp_t *pRsp = &rsp.findByTypeValueRsp;
+  gattAttribute_t *pAttr;
+  uint16 service;
+
+  // Initialize the response
+  VOID osal_memset( pRsp, 0, sizeof( attFindByTypeValueRsp_t ) );
+
+  // Only attributes with attribute handles between and including the Starting
+  // Handle parameter and the Ending Handle parameter that match the requested
+  // attribute type and the attribute value will be returned.
+
+  // All attribute types are effectively compared as 128-bit UUIDs,
+  // even if a 16-bit UUID is provided in this request or defined
   // for an attribute.
-  pAttr = GATT_FindHandleUUID( pReq->startHandle, pReq->endHandle,
-                               pReq->type.uuid, pReq->type.len, &service );
+  pAttr = gattServApp_FindHandleUUID( pReq->startHandle, pReq->endHandle,
+                                      pReq->type.uuid, pReq->type.len, &service );
 
   while ( ( pAttr != NULL ) && ( pRsp->numInfo < g_ATT_MAX_NUM_HANDLES_INFO ) )
   {
@@ -942,7 +1815,7 @@ static bStatus_t gattServApp_ProcessFindByTypeValueReq( gattMsgEvent_t *pMsg, ui
     }
 
     // Try to find the next attribute
-    pAttr = GATT_FindNextAttr( pAttr, pReq->endHandle, service, &grpEndHandle );
+    pAttr = gattServApp_FindNextAttr( pAttr, pReq->endHandle, &service, &grpEndHandle );
 
     // Set Group End Handle
     if ( pRsp->handlesInfo[pRsp->numInfo].handle != 0 )
@@ -993,6 +1866,8 @@ static bStatus_t gattServApp_ProcessReadByTypeReq( gattMsgEvent_t *pMsg, uint16
   attReadByTypeRsp_t *pRsp = &rsp.readByTypeRsp;
   uint16 startHandle = pReq->startHandle;
   uint8 dataLen = 0;
+  uint8 *pValue;
+  uint16 len;
   uint8 status = SUCCESS;
 
   // Only the attributes with attribute handles between and including the
@@ -1007,8 +1882,8 @@ static bStatus_t gattServApp_ProcessReadByTypeReq( gattMsgEvent_t *pMsg, uint16
 
     // All attribute types are effectively compared as 128-bit UUIDs, even if
     // a 16-bit UUID is provided in this request or defined for an attribute.
-    pAttr = GATT_FindHandleUUID( startHandle, pReq->endHandle, pReq->type.uuid,
-                                 pReq->type.len, &service );
+    pAttr = gattServApp_FindHandleUUID( startHandle, pReq->endHandle, pReq->type.uuid,
+                                        pReq->type.len, &service );
     if ( pAttr == NULL )
     {
       break; // No more attribute found
@@ -1024,11 +1899,34 @@ static bStatus_t gattServApp_ProcessReadByTypeReq( gattMsgEvent_t *pMsg, uint16
       break;
     }
 
+    status = gattServApp_AuthorizeRead( pMsg->connHandle, pAttr, service );
+    if ( status != SUCCESS )
+    {
+      break;
+    }
+
     // Read the attribute value. If the attribute value is longer than
     // (ATT_MTU - 4) or 253 octets, whichever is smaller, then the first
     // (ATT_MTU - 4) or 253 octets shall be included in this response.
-    status = GATTServApp_ReadAttr( pMsg->connHandle, pAttr, service, attrValue,
-                                   &attrLen, 0, (((gAttMtuSize[pMsg->connHandle]))-4) );
+    // A value stored as it is sent is copied from there, once the response
+    // is known to have room for it.
+    status = FAILURE;
+    if ( gattServApp_ServiceValue( pAttr ) )
+    {
+      status = gattServApp_GetAttrValue( pMsg->connHandle, pAttr, service, &pValue, &len );
+      if ( status == SUCCESS )
+      {
+        attrLen = ( len > (((gAttMtuSize[pMsg->connHandle]))-4) ) ? (((gAttMtuSize[pMsg->connHandle]))-4) : len;
+      }
+    }
+
+    if ( status == FAILURE )
+    {
+      pValue = attrValue;
+      status = gattServApp_ReadAttrValue( pMsg->connHandle, pAttr, service, attrValue,
+                                          &attrLen, 0, (((gAttMtuSize[pMsg->connHandle]))-4) );
+    }
+
     if ( status != SUCCESS )
     { 
       break; // Cannot read the attribute value
@@ -1060,7 +1958,7 @@ static bStatus_t gattServApp_ProcessReadByTypeReq( gattMsgEvent_t *pMsg, uint16
     pRsp->dataList[dataLen++] = LO_UINT16( pAttr->handle );
     pRsp->dataList[dataLen++] = HI_UINT16( pAttr->handle );
 
-    VOID osal_memcpy( &(pRsp->dataList[dataLen]), attrValue, attrLen );
+    VOID osal_memcpy( &(pRsp->dataList[dataLen]), pValue, attrLen );
     dataLen += attrLen;
 
     if ( startHandle == GATT_MAX_HANDLE )
@@ -1244,12 +2142,151 @@ static bStatus_t gattServApp_ProcessReadMultiReq( gattMsgEvent_t *pMsg, uint16 *
     pRsp->len += attrLen;
   }
 
-  if ( status == SUCCESS )
+  if ( status == SUCCESS )
+  {
+    // Send a response back
+    VOID ATT_ReadMultiRsp( pMsg->connHandle, pRsp );
+  }
+
+  return ( status );
+}
+
+/*********************************************************************
+ * @fn          gattServApp_ProcessReadMultiVarReq
+ *
+ * @brief       Process Read Multiple Variable Length Request. Each value
+ *              goes in the response with its length, values that don't
+ *              fit in the ATT_MTU are truncated.
+ *
+ * @param       connHandle - connection message was received on
+ * @param       pParams - set of handles, two octets each
+ * @param       len - length of pParams
+ *
+ * @return      SUCCESS: Response sent.
+ *              ATT error code: Error Response sent.
+ */
+static bStatus_t gattServApp_ProcessReadMultiVarReq( uint16 connHandle, uint8 *pParams, uint16 len )
+{
+  attErrorRsp_t *pRsp = &rsp.errorRsp;
+  l2capPacket_t pkt;
+  uint16 errHandle = 0;
+  uint16 rspLen = 1;
+  uint16 mtu;
+  uint8 *pBuf = NULL;
+  uint8 status = SUCCESS;
+
+  if ( connHandle >= GATT_MAX_NUM_CONN )
+  {
+    return ( INVALIDPARAMETER );
+  }
+
+  mtu = gAttMtuSize[connHandle];
+
+  if ( ( len < 4 ) || ( len & 1 ) )
+  {
+    // The Set Of Handles holds two handles or more
+    status = ATT_ERR_INVALID_PDU;
+  }
+  else if ( clientState[connHandle] & GATT_CLIENT_CHANGE_UNAWARE )
+  {
+    // As gattServApp_ClientChangeAware() does for other requests
+    if ( clientState[connHandle] & GATT_CLIENT_OUT_OF_SYNC_SENT )
+    {
+      gattServApp_SetChangeAware( connHandle );
+    }
+    else
+    {
+      clientState[connHandle] |= GATT_CLIENT_OUT_OF_SYNC_SENT;
+      status = ATT_ERR_DATABASE_OUT_OF_SYNC;
+    }
+  }
+
+  if ( status == SUCCESS )
+  {
+    pkt.pPayload = (uint8 *)L2CAP_bm_alloc( mtu );
+    if ( pkt.pPayload == NULL )
+    {
+      status = ATT_ERR_INSUFFICIENT_RESOURCES;
+    }
+    else
+    {
+      pBuf = pkt.pPayload;
+      *pBuf++ = ATT_READ_MULTI_VAR_RSP;
+    }
+  }
+
+  for ( uint16 i = 0; ( status == SUCCESS ) && ( i < len ); i += 2 )
+  {
+    gattAttribute_t *pAttr;
+    uint16 service;
+
+    errHandle = BUILD_UINT16( pParams[i], pParams[i+1] );
+
+    pAttr = GATT_FindHandle( errHandle, &service );
+    if ( pAttr == NULL )
+    {
+      status = ATT_ERR_INVALID_HANDLE;
+      break;
+    }
+
+    // Not checked by GATT for this request. All handles are checked, even
+    // the ones past the end of a full response.
+    status = GATT_VerifyReadPermissions( connHandle, pAttr->permissions );
+    if ( ( status != SUCCESS ) || ( rspLen + 2 > mtu ) )
+    {
+      continue;
+    }
+
+    status = GATTServApp_ReadAttr( connHandle, pAttr, service, attrValue,
+                                   &attrLen, 0, mtu-1 );
+    if ( status != SUCCESS )
+    {
+      break;
+    }
+
+    // The length is the one of the value as read (up to ATT_MTU - 1 octets),
+    // the value itself is truncated if the Length Value Tuple List gets
+    // longer than (ATT_MTU - 1)
+    *pBuf++ = LO_UINT16( attrLen );
+    *pBuf++ = HI_UINT16( attrLen );
+    rspLen += 2;
+
+    if ( rspLen + attrLen > mtu )
+    {
+      attrLen = mtu - rspLen;
+    }
+
+    VOID osal_memcpy( pBuf, attrValue, attrLen );
+    pBuf += attrLen;
+    rspLen += attrLen;
+  }
+
+  if ( status == SUCCESS )
+  {
+    pkt.CID = L2CAP_CID_ATT;
+    pkt.len = rspLen;
+
+    status = L2CAP_SendData( connHandle, &pkt );
+    if ( status != SUCCESS )
+    {
+      // Not taken by L2CAP
+      osal_bm_free( pkt.pPayload );
+    }
+
+    return ( status );
+  }
+
+  if ( pBuf != NULL )
   {
-    // Send a response back
-    VOID ATT_ReadMultiRsp( pMsg->connHandle, pRsp );
+    osal_bm_free( pkt.pPayload );
   }
 
+  pRsp->reqOpcode = ATT_READ_MULTI_VAR_REQ;
+  pRsp->handle = errHandle;
+  pRsp->errCode = status;
+
+  VOID ATT_ErrorRsp( connHandle, pRsp );
+
   return ( status );
 }
 
@@ -1279,8 +2316,8 @@ static bStatus_t gattServApp_ProcessReadByGrpTypeReq( gattMsgEvent_t *pMsg, uint
   // All attribute types are effectively compared as 128-bit UUIDs,
   // even if a 16-bit UUID is provided in this request or defined
   // for an attribute.
-  pAttr = GATT_FindHandleUUID( pReq->startHandle, pReq->endHandle,
-                               pReq->type.uuid, pReq->type.len, &service );
+  pAttr = gattServApp_FindHandleUUID( pReq->startHandle, pReq->endHandle,
+                                      pReq->type.uuid, pReq->type.len, &service );
   while ( pAttr != NULL )
   {
     uint16 endGrpHandle;
@@ -1336,7 +2373,7 @@ static bStatus_t gattServApp_ProcessReadByGrpTypeReq( gattMsgEvent_t *pMsg, uint
     pRsp->dataList[dataLen++] = HI_UINT16( pAttr->handle );
 
     // Try to find the next attribute
-    pAttr = GATT_FindNextAttr( pAttr, pReq->endHandle, service, &endGrpHandle );
+    pAttr = gattServApp_FindNextAttr( pAttr, pReq->endHandle, &service, &endGrpHandle );
 
     // Add End Group Handle to the response
     if ( pAttr != NULL )
@@ -1494,8 +2531,14 @@ static bStatus_t gattServApp_ProcessPrepareWriteReq( gattMsgEvent_t *pMsg, uint1
         pReq->value[0] = ~(pReq->value[0]);
       }
 #endif
-      // Enqueue the request for now
-      status = gattServApp_EnqueuePrepareWriteReq( pMsg->connHandle, pReq );
+      // Hand the value to the service if it writes the attribute in place,
+      // enqueue the request for now otherwise
+      status = gattServApp_PrepareLongWrite( pMsg->connHandle, pAttr, service, pReq );
+      if ( status == GATT_LONG_WRITE_QUEUE )
+      {
+        status = gattServApp_EnqueuePrepareWriteReq( pMsg->connHandle, pReq );
+      }
+
       if ( status == SUCCESS )
       {
        //LOG("pre off[%d] len[%d]\n", pReq->offset, pReq->len);
@@ -1530,58 +2573,56 @@ static bStatus_t gattServApp_ProcessPrepareWriteReq( gattMsgEvent_t *pMsg, uint1
 static bStatus_t gattServApp_ProcessExecuteWriteReq( gattMsgEvent_t *pMsg, uint16 *pErrHandle )
 {
   attExecuteWriteReq_t *pReq = &pMsg->msg.executeWriteReq;
-  prepareWrites_t *pQueue;
   uint8 status = SUCCESS;
 
-  // See if this client has a prepare write queue
-  pQueue = gattServApp_FindPrepareWriteQ( pMsg->connHandle );
-  if ( pQueue != NULL )
+  for ( uint8 i = 0; i < numPrepareWritesQ; i++ )
   {
-    for ( uint8 i = 0; i < maxNumPrepareWrites; i++ )
-    {
-      attPrepareWriteReq_t *pWriteReq = &(pQueue->pPrepareWriteQ[i]);
+    attPrepareWriteReq_t *pWriteReq = &(prepareWritesTbl[i].req);
 
-      // See if there're any prepared write requests in the queue
-      if ( pWriteReq->handle == GATT_INVALID_HANDLE )
-      {
-        break; // We're done
-      }
+    // See if it's one of this client's prepared write requests
+    if ( prepareWritesTbl[i].connHandle != pMsg->connHandle )
+    {
+      continue;
+    }
 
-      // Execute the request
-      if ( pReq->flags == ATT_WRITE_PREPARED_VALUES )
+    // Execute the request
+    if ( pReq->flags == ATT_WRITE_PREPARED_VALUES )
+    {
+      status = GATTServApp_WriteAttr( pMsg->connHandle, pWriteReq->handle,
+                                      pWriteReq->value, pWriteReq->len,
+                                      pWriteReq->offset );
+      //LOG("exe off[%d]len[%d]", pWriteReq->offset, pWriteReq->len);
+      // If the prepare write requests can not be written, the queue shall
+      // be cleared and then an Error Response shall be sent with a high
+      // layer defined error code.
+      if ( status != SUCCESS )
       {
-        status = GATTServApp_WriteAttr( pMsg->connHandle, pWriteReq->handle,
-                                        pWriteReq->value, pWriteReq->len,
-                                        pWriteReq->offset );
-        //LOG("exe off[%d]len[%d]", pWriteReq->offset, pWriteReq->len);
-        // If the prepare write requests can not be written, the queue shall
-        // be cleared and then an Error Response shall be sent with a high
-        // layer defined error code.
-        if ( status != SUCCESS )
-        {
-          // Cancel the remaining prepared writes
-          pReq->flags = ATT_CANCEL_PREPARED_WRITES;
+        // Cancel the remaining prepared writes
+        pReq->flags = ATT_CANCEL_PREPARED_WRITES;
 
-          // The Attribute Handle in Error shall be set to the attribute handle
-          // of the attribute from the prepare write queue that caused this
-          // application error
-          *pErrHandle = pWriteReq->handle;
-        }
-      }
-      else // ATT_CANCEL_PREPARED_WRITES
-      {
-        // Cancel all prepared writes - just ignore the request
+        // The Attribute Handle in Error shall be set to the attribute handle
+        // of the attribute from the prepare write queue that caused this
+        // application error
+        *pErrHandle = pWriteReq->handle;
       }
+    }
+    else // ATT_CANCEL_PREPARED_WRITES
+    {
+      // Cancel all prepared writes - just ignore the request
+    }
+  } // for loop
 
-      // Clear the queue item
-      VOID osal_memset( pWriteReq, 0, sizeof( attPrepareWriteRsp_t ) );
-
-      // Mark this item as empty
-      pWriteReq->handle = GATT_INVALID_HANDLE;
-    } // for loop
+  // Clear this client's queue items
+  gattServApp_DequeuePrepareWriteReqs( pMsg->connHandle );
 
-    // Mark this queue as empty
-    pQueue->connHandle = INVALID_CONNHANDLE;
+  // Have the values written in place committed or dropped
+  if ( pReq->flags == ATT_WRITE_PREPARED_VALUES )
+  {
+    status = gattServApp_EndLongWrites( pMsg->connHandle, GATT_LONG_WRITE_EXECUTE, pErrHandle );
+  }
+  else
+  {
+    VOID gattServApp_EndLongWrites( pMsg->connHandle, GATT_LONG_WRITE_CANCEL, NULL );
   }
 
   // Send a response back
@@ -1605,60 +2646,187 @@ static bStatus_t gattServApp_ProcessExecuteWriteReq( gattMsgEvent_t *pMsg, uint1
  */
 static bStatus_t gattServApp_EnqueuePrepareWriteReq( uint16 connHandle, attPrepareWriteReq_t *pReq )
 {
-  prepareWrites_t *pQueue;
+  // If there's room in the queue then enqueue the request
+  if ( numPrepareWritesQ < maxNumPrepareWrites )
+  {
+    prepareWrite_t *pItem = &(prepareWritesTbl[numPrepareWritesQ]);
+
+    // Store the request here, the value only as far as it's used
+    pItem->connHandle = connHandle;
+    VOID osal_memcpy( &(pItem->req), pReq,
+                      sizeof ( attPrepareWriteReq_t ) - sizeof ( pReq->value ) + pReq->len );
+    numPrepareWritesQ++;
+    //LOG("enq off[%d]len[%d]\n", pReq->offset, pReq->len);
+    return ( SUCCESS );
+  }
+
+  return ( ATT_ERR_PREPARE_QUEUE_FULL );
+}
+
+/*********************************************************************
+ * @fn          gattServApp_DequeuePrepareWriteReqs
+ *
+ * @brief       Remove a client's Prepare Write Requests from the queue.
+ *
+ * @param       connHandle - connection used by client
+ *
+ * @return      none
+ */
+static void gattServApp_DequeuePrepareWriteReqs( uint16 connHandle )
+{
+  uint8 num = 0;
 
-  // First see if there's queue already assocaited with this client
-  pQueue = gattServApp_FindPrepareWriteQ( connHandle );
-  if ( pQueue == NULL )
+  for ( uint8 i = 0; i < numPrepareWritesQ; i++ )
   {
-    // Find a queue for this client
-    pQueue = gattServApp_FindPrepareWriteQ( INVALID_CONNHANDLE );
-    if ( pQueue != NULL )
+    if ( prepareWritesTbl[i].connHandle != connHandle )
     {
-      pQueue->connHandle = connHandle;
+      // Move the other clients' requests down, they stay in order
+      if ( num != i )
+      {
+        VOID osal_memcpy( &(prepareWritesTbl[num]), &(prepareWritesTbl[i]), sizeof ( prepareWrite_t ) );
+      }
+
+      num++;
     }
   }
 
-  // If a queue is found for this client then enqueue the request
-  if ( pQueue != NULL )
+  numPrepareWritesQ = num;
+}
+
+/*********************************************************************
+ * @fn          gattServApp_PrepareLongWrite
+ *
+ * @brief       Hand a prepared value to the service's long write callback
+ *              to be written in place.
+ *
+ * @param       connHandle - connection request was received on
+ * @param       pAttr - pointer to attribute
+ * @param       service - handle of owner service
+ * @param       pReq - pointer to request
+ *
+ * @return      SUCCESS, GATT_LONG_WRITE_QUEUE if the value is to be queued,
+ *              Failure otherwise
+ */
+static bStatus_t gattServApp_PrepareLongWrite( uint16 connHandle, gattAttribute_t *pAttr,
+                                               uint16 service, attPrepareWriteReq_t *pReq )
+{
+  CONST gattServiceCBs_t *pCBs = gattServApp_FindServiceCBs( service );
+  longWrite_t *pItem;
+  uint8 status;
+
+  if ( ( pCBs == NULL ) || ( pCBs->pfnLongWriteAttrCB == NULL ) )
   {
-    for ( uint8 i = 0; i < maxNumPrepareWrites; i++ )
+    return ( GATT_LONG_WRITE_QUEUE );
+  }
+
+  // The attribute keeps its entry until Execute Write
+  pItem = gattServApp_FindLongWrite( connHandle, pAttr->handle );
+  if ( pItem == NULL )
+  {
+    pItem = gattServApp_FindLongWrite( INVALID_CONNHANDLE, GATT_INVALID_HANDLE );
+  }
+
+  status = (*pCBs->pfnLongWriteAttrCB)( connHandle, pAttr, pReq->value, pReq->len,
+                                        pReq->offset, GATT_LONG_WRITE_PREPARE );
+  if ( status == SUCCESS )
+  {
+    if ( pItem != NULL )
+    {
+      pItem->connHandle = connHandle;
+      pItem->handle = pAttr->handle;
+    }
+    else
+    {
+      // No room to remember the attribute, drop what it staged
+      VOID (*pCBs->pfnLongWriteAttrCB)( connHandle, pAttr, NULL, 0, 0, GATT_LONG_WRITE_CANCEL );
+
+      status = ATT_ERR_PREPARE_QUEUE_FULL;
+    }
+  }
+
+  return ( status );
+}
+
+/*********************************************************************
+ * @fn          gattServApp_EndLongWrites
+ *
+ * @brief       Commit or drop the values a client's attributes have
+ *              written in place.
+ *
+ * @param       connHandle - connection used by client
+ * @param       op - GATT_LONG_WRITE_EXECUTE or GATT_LONG_WRITE_CANCEL
+ * @param       pErrHandle - attribute handle that generates an error
+ *                           (GATT_LONG_WRITE_EXECUTE only)
+ *
+ * @return      Success or Failure
+ */
+static bStatus_t gattServApp_EndLongWrites( uint16 connHandle, uint8 op, uint16 *pErrHandle )
+{
+  uint8 status = SUCCESS;
+
+  for ( uint8 i = 0; i < GATT_MAX_NUM_LONG_WRITES; i++ )
+  {
+    longWrite_t *pItem = &(longWritesTbl[i]);
+
+    if ( pItem->connHandle == connHandle )
     {
-      if ( pQueue->pPrepareWriteQ[i].handle == GATT_INVALID_HANDLE )
+      uint16 service;
+      gattAttribute_t *pAttr = GATT_FindHandle( pItem->handle, &service );
+      CONST gattServiceCBs_t *pCBs = gattServApp_FindServiceCBs( service );
+
+      // The service may be gone since the value was prepared
+      if ( ( pAttr != NULL ) && ( pCBs != NULL ) && ( pCBs->pfnLongWriteAttrCB != NULL ) )
       {
-        // Store the request here
-        VOID osal_memcpy( &(pQueue->pPrepareWriteQ[i]), pReq, sizeof ( attPrepareWriteReq_t ) );
-        //LOG("enq off[%d]len[%d]\n", pReq->offset, pReq->len);
-        return ( SUCCESS );
+        if ( op == GATT_LONG_WRITE_EXECUTE )
+        {
+          status = (*pCBs->pfnLongWriteAttrCB)( connHandle, pAttr, NULL, 0, 0, op );
+          if ( status != SUCCESS )
+          {
+            // Drop the remaining values
+            op = GATT_LONG_WRITE_CANCEL;
+
+            *pErrHandle = pItem->handle;
+          }
+        }
+        else
+        {
+          VOID (*pCBs->pfnLongWriteAttrCB)( connHandle, pAttr, NULL, 0, 0, op );
+        }
       }
+
+      // Mark this item as empty
+      pItem->connHandle = INVALID_CONNHANDLE;
+      pItem->handle = GATT_INVALID_HANDLE;
     }
   }
 
-  return ( ATT_ERR_PREPARE_QUEUE_FULL );
+  return ( status );
 }
 
 /*********************************************************************
- * @fn          gattServApp_FindPrepareWriteQ
+ * @fn          gattServApp_FindLongWrite
  *
- * @brief       Find client's queue.
+ * @brief       Find the entry of an attribute written in place.
  *
- * @param       connHandle - connection used by client
+ * @param       connHandle - connection used by client (INVALID_CONNHANDLE
+ *                           for empty entry)
+ * @param       handle - attribute handle
  *
- * @return      Pointer to queue. NULL, otherwise.
+ * @return      Pointer to entry. NULL, otherwise.
  */
-static prepareWrites_t *gattServApp_FindPrepareWriteQ( uint16 connHandle )
+static longWrite_t *gattServApp_FindLongWrite( uint16 connHandle, uint16 handle )
 {
-  // First see if this client has already a queue
-  for ( uint8 i = 0; i < MAX_NUM_LL_CONN; i++ )
+  for ( uint8 i = 0; i < GATT_MAX_NUM_LONG_WRITES; i++ )
   {
-    if ( prepareWritesTbl[i].connHandle == connHandle )
+    if ( ( longWritesTbl[i].connHandle == connHandle ) &&
+         ( longWritesTbl[i].handle == handle ) )
     {
-      // Queue found
-      return ( &(prepareWritesTbl[i]) );
+      // Entry found
+      return ( &(longWritesTbl[i]) );
     }
   }
 
-  return ( (prepareWrites_t *)NULL );
+  return ( (longWrite_t *)NULL );
 }
 
 /*********************************************************************
@@ -1672,23 +2840,8 @@ static prepareWrites_t *gattServApp_FindPrepareWriteQ( uint16 connHandle )
  */
 static uint8 gattServApp_PrepareWriteQInUse( void )
 {
-  // See if any prepare write queue is in use
-  for ( uint8 i = 0; i < MAX_NUM_LL_CONN; i++ )
-  {
-    if ( prepareWritesTbl[i].connHandle != INVALID_CONNHANDLE )
-    {
-      for ( uint8 j = 0; j < maxNumPrepareWrites; j++ )
-      {
-        if ( prepareWritesTbl[i].pPrepareWriteQ[j].handle != GATT_INVALID_HANDLE )
-        {
-          // Queue item is in use
-          return ( TRUE );
-        }
-      } // for
-    }
-  } // for
-
-  return ( FALSE );
+  // See if any queue item is in use
+  return ( numPrepareWritesQ > 0 );
 }
 
 /*********************************************************************
@@ -1766,6 +2919,74 @@ static pfnGATTAuthorizeAttrCB_t gattServApp_FindAuthorizeAttrCB( uint16 handle )
   return ( ( pCBs == NULL ) ? NULL : pCBs->pfnAuthorizeAttrCB );
 }
 
+/*********************************************************************
+ * @fn      gattServApp_ReadAttrCB
+ *
+ * @brief   Read an attribute of the GATT Service.
+ *
+ * @param   connHandle - connection message was received on
+ * @param   pAttr - pointer to attribute
+ * @param   pValue - pointer to data to be read
+ * @param   pLen - length of data to be read
+ * @param   offset - offset of the first octet to be read
+ * @param   maxLen - maximum length of data to be read
+ *
+ * @return  Success or Failure
+ */
+static bStatus_t gattServApp_ReadAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
+                                         uint8 *pValue, uint8 *pLen, uint16 offset, uint8 maxLen )
+{
+  bStatus_t status = SUCCESS;
+
+  if ( pAttr->type.len == ATT_BT_UUID_SIZE )
+  {
+    // 16-bit UUID
+    uint16 uuid = BUILD_UINT16( pAttr->type.uuid[0], pAttr->type.uuid[1]);
+    switch ( uuid )
+    {
+      case CLIENT_SUPPORTED_FEATURES_UUID:
+        if ( offset == 0 )
+        {
+          *pLen = 1;
+          pValue[0] = ( connHandle < GATT_MAX_NUM_CONN ) ? clientFeatures[connHandle] : 0;
+        }
+        else
+        {
+          status = ATT_ERR_ATTR_NOT_LONG;
+        }
+        break;
+
+      case DATABASE_HASH_UUID:
+        if ( offset == 0 )
+        {
+          if ( dbHashValid == FALSE )
+          {
+            gattServApp_ComputeDbHash();
+          }
+
+          *pLen = ( maxLen < GATT_DB_HASH_SIZE ) ? maxLen : GATT_DB_HASH_SIZE;
+          VOID osal_memcpy( pValue, dbHash, *pLen );
+        }
+        else
+        {
+          status = ATT_ERR_ATTR_NOT_LONG;
+        }
+        break;
+
+      default:
+        // Should never get here!
+        status = ATT_ERR_INVALID_HANDLE;
+    }
+  }
+  else
+  {
+    // 128-bit UUID
+    status = ATT_ERR_INVALID_HANDLE;
+  }
+
+  return ( status );
+}
+
 /*********************************************************************
  * @fn      gattServApp_ValidateWriteAttrCB
  *
@@ -1796,6 +3017,34 @@ static bStatus_t gattServApp_WriteAttrCB( uint16 connHandle, gattAttribute_t *pA
 			  
         break;
 
+      case CLIENT_SUPPORTED_FEATURES_UUID:
+        if ( offset != 0 )
+        {
+          status = ATT_ERR_ATTR_NOT_LONG;
+        }
+        else if ( len == 0 )
+        {
+          status = ATT_ERR_INVALID_VALUE_SIZE;
+        }
+        else if ( connHandle >= GATT_MAX_NUM_CONN )
+        {
+          status = ATT_ERR_UNLIKELY;
+        }
+        else if ( clientFeatures[connHandle] & ~pValue[0] )
+        {
+          // A client shall not clear a feature it has enabled
+          status = ATT_ERR_VALUE_NOT_ALLOWED;
+        }
+        else
+        {
+          // Further octets are for features not defined yet
+          clientFeatures[connHandle] = pValue[0] & GATT_CLIENT_FEAT_SUPPORTED;
+
+          // Kept in the bond record of a bonded client
+          gattServApp_SendClientInfoEvent( connHandle );
+        }
+        break;
+
       default:
 				
         // Should never get here!
@@ -1832,7 +3081,34 @@ uint8 GATTServApp_ReadAttr( uint16 connHandle, gattAttribute_t *pAttr,
                             uint16 service, uint8 *pValue, uint8 *pLen,
                             uint16 offset, uint8 maxLen )
 {
-  uint8 useCB = FALSE;
+  bStatus_t status;
+
+  status = gattServApp_AuthorizeRead( connHandle, pAttr, service );
+  if ( status != SUCCESS )
+  {
+    // Read operation failed!
+    return ( status );
+  }
+
+  return ( gattServApp_ReadAttrValue( connHandle, pAttr, service, pValue, pLen,
+                                      offset, maxLen ) );
+}
+
+/*********************************************************************
+ * @fn          gattServApp_AuthorizeRead
+ *
+ * @brief       Authorize the read of an attribute, if its permissions
+ *              require it.
+ *
+ * @param       connHandle - connection message was received on
+ * @param       pAttr - pointer to attribute
+ * @param       service - handle of owner service
+ *
+ * @return      Success or Failure
+ */
+static bStatus_t gattServApp_AuthorizeRead( uint16 connHandle, gattAttribute_t *pAttr,
+                                            uint16 service )
+{
   bStatus_t status = SUCCESS;
 
   // Authorization is handled by the application/profile
@@ -1848,14 +3124,99 @@ uint8 GATTServApp_ReadAttr( uint16 connHandle, gattAttribute_t *pAttr,
     {
       status = ATT_ERR_UNLIKELY;
     }
+  }
 
-    if ( status != SUCCESS )
+  return ( status );
+}
+
+/*********************************************************************
+ * @fn          gattServApp_ServiceValue
+ *
+ * @brief       Check if the value of an attribute comes from its service,
+ *              i.e. it's not one GATT Server App formats itself.
+ *
+ * @param       pAttr - pointer to attribute
+ *
+ * @return      TRUE if the value comes from the service. FALSE, otherwise.
+ */
+static uint8 gattServApp_ServiceValue( gattAttribute_t *pAttr )
+{
+  if ( pAttr->type.len == ATT_BT_UUID_SIZE )
+  {
+    switch ( BUILD_UINT16( pAttr->type.uuid[0], pAttr->type.uuid[1] ) )
     {
-      // Read operation failed!
-      return ( status );
+      case GATT_PRIMARY_SERVICE_UUID:
+      case GATT_SECONDARY_SERVICE_UUID:
+      case GATT_CHARACTER_UUID:
+      case GATT_INCLUDE_UUID:
+      case GATT_CLIENT_CHAR_CFG_UUID:
+      case GATT_CHAR_EXT_PROPS_UUID:
+      case GATT_SERV_CHAR_CFG_UUID:
+      case GATT_CHAR_USER_DESC_UUID:
+      case GATT_CHAR_FORMAT_UUID:
+        return ( FALSE );
+
+      default:
+        break;
     }
   }
 
+  return ( TRUE );
+}
+
+/*********************************************************************
+ * @fn          gattServApp_GetAttrValue
+ *
+ * @brief       Get where the service stores the value of an attribute.
+ *
+ * @param       connHandle - connection message was received on
+ * @param       pAttr - pointer to attribute
+ * @param       service - handle of owner service
+ * @param       ppValue - pointer to the stored value (to be returned)
+ * @param       pLen - length of the stored value (to be returned)
+ *
+ * @return      SUCCESS: Value returned.
+ *              FAILURE: Value must be read with the Read callback.
+ *              Error, otherwise.
+ */
+static bStatus_t gattServApp_GetAttrValue( uint16 connHandle, gattAttribute_t *pAttr,
+                                           uint16 service, uint8 **ppValue, uint16 *pLen )
+{
+  CONST gattServiceCBs_t *pCBs = gattServApp_FindServiceCBs( service );
+
+  if ( ( pCBs == NULL ) || ( pCBs->pfnGetAttrValueCB == NULL ) )
+  {
+    return ( FAILURE );
+  }
+
+  return ( (*pCBs->pfnGetAttrValueCB)( connHandle, pAttr, ppValue, pLen ) );
+}
+
+/*********************************************************************
+ * @fn          gattServApp_ReadAttrValue
+ *
+ * @brief       Read an attribute value, once authorized. If the format of
+ *              the attribute value is unknown to GATT Server, copy it
+ *              from where the Service stores it or use the callback
+ *              function provided by the Service.
+ *
+ * @param       connHandle - connection message was received on
+ * @param       pAttr - pointer to attribute
+ * @param       service - handle of owner service
+ * @param       pValue - pointer to data to be read
+ * @param       pLen - length of data to be read
+ * @param       offset - offset of the first octet to be read
+ * @param       maxLen - maximum length of data to be read
+ *
+ * @return      Success or Failure
+ */
+static bStatus_t gattServApp_ReadAttrValue( uint16 connHandle, gattAttribute_t *pAttr,
+                                            uint16 service, uint8 *pValue, uint8 *pLen,
+                                            uint16 offset, uint8 maxLen )
+{
+  uint8 useCB = FALSE;
+  bStatus_t status = SUCCESS;
+
   // Check the UUID length
   if ( pAttr->type.len == ATT_BT_UUID_SIZE )
   {
@@ -1980,8 +3341,7 @@ uint8 GATTServApp_ReadAttr( uint16 connHandle, gattAttribute_t *pAttr,
         // Make sure it's not a blob operation
         if ( offset == 0 )
         {
-          uint16 value = GATTServApp_ReadCharCfg( connHandle,
-                                                  (gattCharCfg_t *)(pAttr->pValue) );
+          uint16 value = gattServApp_ReadCCC( connHandle, pAttr );
           *pLen = 2;
           pValue[0] = LO_UINT16( value );
           pValue[1] = HI_UINT16( value );
@@ -2082,16 +3442,39 @@ uint8 GATTServApp_ReadAttr( uint16 connHandle, gattAttribute_t *pAttr,
 
   if ( useCB == TRUE )
   {
-    // Use Service's read callback to process the request
-    pfnGATTReadAttrCB_t pfnCB = gattServApp_FindReadAttrCB( service );
-    if ( pfnCB != NULL )
+    uint8 *pStored;
+    uint16 len;
+
+    status = gattServApp_GetAttrValue( connHandle, pAttr, service, &pStored, &len );
+    if ( status == SUCCESS )
     {
-      // Read the attribute value
-      status = (*pfnCB)( connHandle, pAttr, pValue, pLen, offset, maxLen );
+      // If the value offset is greater than the length of the attribute
+      // value, an Error Response shall be sent with the error code Invalid
+      // Offset. If it's equal, the part attribute value is empty.
+      if ( offset <= len )
+      {
+        len -= offset;
+        *pLen = ( len > maxLen ) ? maxLen : len;
+        VOID osal_memcpy( pValue, &(pStored[offset]), *pLen );
+      }
+      else
+      {
+        status = ATT_ERR_INVALID_OFFSET;
+      }
     }
-    else
+    else if ( status == FAILURE )
     {
-      status = ATT_ERR_UNLIKELY;
+      // Use Service's read callback to process the request
+      pfnGATTReadAttrCB_t pfnCB = gattServApp_FindReadAttrCB( service );
+      if ( pfnCB != NULL )
+      {
+        // Read the attribute value
+        status = (*pfnCB)( connHandle, pAttr, pValue, pLen, offset, maxLen );
+      }
+      else
+      {
+        status = ATT_ERR_UNLIKELY;
+      }
     }
   }
 
@@ -2221,14 +3604,25 @@ bStatus_t GATTServApp_UpdateCharCfg( uint16 connHandle, uint16 attrHandle, uint1
  */
 bStatus_t GATTServApp_SendServiceChangedInd( uint16 connHandle, uint8 taskId )
 {
-  uint16 value = GATTServApp_ReadCharCfg( connHandle, indCharCfg );
+  uint16 value = GATTServApp_ReadCCCD( connHandle, GATT_CCCD_SERVICE_CHANGED );
+  bStatus_t status;
+
+  if ( ( value & GATT_CLIENT_CFG_INDICATE ) == 0 )
+  {
+    return ( FAILURE );
+  }
 
-  if ( value & GATT_CLIENT_CFG_INDICATE )
+  status = GATT_ServiceChangedInd( connHandle, taskId );
+
+  // The confirmation makes a change-unaware client change-aware
+  if ( ( status == SUCCESS ) && ( taskId == GATTServApp_TaskID ) &&
+       ( connHandle < GATT_MAX_NUM_CONN )                           &&
+       ( clientState[connHandle] & GATT_CLIENT_CHANGE_UNAWARE ) )
   {
-     return ( GATT_ServiceChangedInd( connHandle, taskId ) );
+    clientState[connHandle] |= GATT_CLIENT_SVC_CHG_PENDING;
   }
 
-  return ( FAILURE );
+  return ( status );
 }
 
 /*********************************************************************
@@ -2259,82 +3653,369 @@ void GATTServApp_InitCharCfg( uint16 connHandle, gattCharCfg_t *charCfgTbl )
   }
   else
   {
-    gattCharCfg_t *pItem = gattServApp_FindCharCfgItem( connHandle, charCfgTbl );
-    if ( pItem != NULL )
-    {
-      pItem->connHandle = INVALID_CONNHANDLE;
-      pItem->value = GATT_CFG_NO_OPERATION;
-    }
+    gattCharCfg_t *pItem = gattServApp_FindCharCfgItem( connHandle, charCfgTbl );
+    if ( pItem != NULL )
+    {
+      pItem->connHandle = INVALID_CONNHANDLE;
+      pItem->value = GATT_CFG_NO_OPERATION;
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      GATTServApp_ReadCharCfg
+ *
+ * @brief   Read the client characteristic configuration for a given
+ *          client.
+ *
+ *          Note: Each client has its own instantiation of the Client
+ *                Characteristic Configuration. Reads of the Client
+ *                Characteristic Configuration only shows the configuration
+ *                for that client.
+ *
+ * @param   connHandle - connection handle.
+ * @param   charCfgTbl - client characteristic configuration table.
+ *
+ * @return  attribute value
+ */
+uint16 GATTServApp_ReadCharCfg( uint16 connHandle, gattCharCfg_t *charCfgTbl )
+{
+  gattCharCfg_t *pItem;
+
+  pItem = gattServApp_FindCharCfgItem( connHandle, charCfgTbl );
+  if ( pItem != NULL )
+  {
+    return ( (uint16)(pItem->value) );
+  }
+
+  return ( (uint16)GATT_CFG_NO_OPERATION );
+}
+
+/*********************************************************************
+ * @fn      GATTServApp_WriteCharCfg
+ *
+ * @brief   Write the client characteristic configuration for a given
+ *          client.
+ *
+ *          Note: Each client has its own instantiation of the Client
+ *                Characteristic Configuration. Writes of the Client
+ *                Characteristic Configuration only only affect the
+ *                configuration of that client.
+ *
+ * @param   connHandle - connection handle.
+ * @param   charCfgTbl - client characteristic configuration table.
+ * @param   value - attribute new value.
+ *
+ * @return  Success or Failure
+ */
+uint8 GATTServApp_WriteCharCfg( uint16 connHandle, gattCharCfg_t *charCfgTbl,
+                                uint16 value )
+{
+  gattCharCfg_t *pItem;
+
+  pItem = gattServApp_FindCharCfgItem( connHandle, charCfgTbl );
+  if ( pItem == NULL )
+  {
+    pItem = gattServApp_FindCharCfgItem( INVALID_CONNHANDLE, charCfgTbl );
+    if ( pItem == NULL )
+    {
+      return ( ATT_ERR_INSUFFICIENT_RESOURCES );
+    }
+
+    pItem->connHandle = connHandle;
+  }
+
+  // Write the new value for this client
+  pItem->value = value;
+
+  return ( SUCCESS );
+}
+
+/*********************************************************************
+ * @fn      GATTServApp_ReadCCCD
+ *
+ * @brief   Read the configuration of a CCCD in the CCCD store for a
+ *          given client.
+ *
+ * @param   connHandle - connection handle.
+ * @param   cccdIdx - CCCD store index.
+ *
+ * @return  attribute value
+ */
+uint16 GATTServApp_ReadCCCD( uint16 connHandle, uint8 cccdIdx )
+{
+  if ( ( connHandle >= GATT_MAX_NUM_CONN ) || ( cccdIdx >= GATT_MAX_NUM_CCCD ) )
+  {
+    return ( GATT_CFG_NO_OPERATION );
+  }
+
+  return ( ( cccdTbl[connHandle][cccdIdx >> 2] >> ( ( cccdIdx & 0x03 ) << 1 ) ) & 0x03 );
+}
+
+/*********************************************************************
+ * @fn      GATTServApp_WriteCCCD
+ *
+ * @brief   Write the configuration of a CCCD in the CCCD store for a
+ *          given client.
+ *
+ * @param   connHandle - connection handle.
+ * @param   cccdIdx - CCCD store index.
+ * @param   value - attribute new value.
+ *
+ * @return  SUCCESS or INVALIDPARAMETER
+ */
+bStatus_t GATTServApp_WriteCCCD( uint16 connHandle, uint8 cccdIdx, uint16 value )
+{
+  uint8 shift;
+
+  // Only notify and indicate can be configured
+  if ( ( connHandle >= GATT_MAX_NUM_CONN ) || ( cccdIdx >= GATT_MAX_NUM_CCCD ) ||
+       ( value & ~( GATT_CLIENT_CFG_NOTIFY | GATT_CLIENT_CFG_INDICATE ) ) )
+  {
+    return ( INVALIDPARAMETER );
+  }
+
+  shift = ( cccdIdx & 0x03 ) << 1;
+  cccdTbl[connHandle][cccdIdx >> 2] &= ~( 0x03 << shift );
+  cccdTbl[connHandle][cccdIdx >> 2] |= (uint8)( value << shift );
+
+  return ( SUCCESS );
+}
+
+/*********************************************************************
+ * @fn      GATTServApp_InitCCCD
+ *
+ * @brief   Clear the configurations of the CCCD store for a given client.
+ *
+ * @param   connHandle - connection handle (0xFFFF for all connections).
+ *
+ * @return  none
+ */
+void GATTServApp_InitCCCD( uint16 connHandle )
+{
+  if ( connHandle == INVALID_CONNHANDLE )
+  {
+    VOID osal_memset( cccdTbl, 0, sizeof ( cccdTbl ) );
+  }
+  else if ( connHandle < GATT_MAX_NUM_CONN )
+  {
+    VOID osal_memset( cccdTbl[connHandle], 0, GATT_CCCD_STORE_SIZE );
+  }
+}
+
+/*********************************************************************
+ * @fn      GATTServApp_GetCCCDIdx
+ *
+ * @brief   Get the CCCD store index of an attribute.
+ *
+ * @param   attrHandle - attribute handle.
+ *
+ * @return  CCCD store index. GATT_CCCD_IDX_INVALID if the attribute isn't
+ *          a CCCD kept in the CCCD store.
+ */
+uint8 GATTServApp_GetCCCDIdx( uint16 attrHandle )
+{
+  uint16 service;
+  gattAttribute_t *pAttr = GATT_FindHandle( attrHandle, &service );
+
+  if ( pAttr == NULL )
+  {
+    return ( GATT_CCCD_IDX_INVALID );
+  }
+
+  return ( gattServApp_CCCDIdx( pAttr ) );
+}
+
+/*********************************************************************
+ * @fn      GATTServApp_SaveCCCD
+ *
+ * @brief   Copy all the configurations of the CCCD store for a given
+ *          client.
+ *
+ * @param   connHandle - connection handle.
+ * @param   pBuf - GATT_CCCD_STORE_SIZE bytes to copy the configurations to.
+ *
+ * @return  SUCCESS or INVALIDPARAMETER
+ */
+bStatus_t GATTServApp_SaveCCCD( uint16 connHandle, uint8 *pBuf )
+{
+  if ( connHandle >= GATT_MAX_NUM_CONN )
+  {
+    return ( INVALIDPARAMETER );
+  }
+
+  VOID osal_memcpy( pBuf, cccdTbl[connHandle], GATT_CCCD_STORE_SIZE );
+
+  return ( SUCCESS );
+}
+
+/*********************************************************************
+ * @fn      GATTServApp_RestoreCCCD
+ *
+ * @brief   Set all the configurations of the CCCD store for a given client.
+ *
+ * @param   connHandle - connection handle.
+ * @param   pBuf - GATT_CCCD_STORE_SIZE bytes of saved configurations.
+ *
+ * @return  SUCCESS or INVALIDPARAMETER
+ */
+bStatus_t GATTServApp_RestoreCCCD( uint16 connHandle, uint8 *pBuf )
+{
+  if ( connHandle >= GATT_MAX_NUM_CONN )
+  {
+    return ( INVALIDPARAMETER );
+  }
+
+  VOID osal_memcpy( cccdTbl[connHandle], pBuf, GATT_CCCD_STORE_SIZE );
+
+  return ( SUCCESS );
+}
+
+/*********************************************************************
+ * @fn      GATTServApp_SaveClientInfo
+ *
+ * @brief   Copy the Client Supported Features of a given client and the
+ *          part of the Database Hash it is change-aware of. The hash part
+ *          is zero while the client is change-unaware.
+ *
+ * @param   connHandle - connection handle.
+ * @param   pBuf - GATT_CLIENT_INFO_SIZE bytes to copy them to.
+ *
+ * @return  SUCCESS or INVALIDPARAMETER
+ */
+bStatus_t GATTServApp_SaveClientInfo( uint16 connHandle, uint8 *pBuf )
+{
+  if ( connHandle >= GATT_MAX_NUM_CONN )
+  {
+    return ( INVALIDPARAMETER );
+  }
+
+  pBuf[0] = clientFeatures[connHandle];
+
+  if ( clientState[connHandle] & GATT_CLIENT_CHANGE_UNAWARE )
+  {
+    VOID osal_memset( &pBuf[1], 0, GATT_CLIENT_HASH_LEN );
+  }
+  else
+  {
+    if ( dbHashValid == FALSE )
+    {
+      gattServApp_ComputeDbHash();
+    }
+
+    VOID osal_memcpy( &pBuf[1], dbHash, GATT_CLIENT_HASH_LEN );
+  }
+
+  return ( SUCCESS );
+}
+
+/*********************************************************************
+ * @fn      GATTServApp_RestoreClientInfo
+ *
+ * @brief   Set the Client Supported Features of a given bonded client.
+ *          A Robust Caching client is change-unaware if the database
+ *          changed since it was last change-aware, also across resets.
+ *
+ * @param   connHandle - connection handle.
+ * @param   pBuf - GATT_CLIENT_INFO_SIZE bytes of saved information.
+ *
+ * @return  SUCCESS or INVALIDPARAMETER
+ */
+bStatus_t GATTServApp_RestoreClientInfo( uint16 connHandle, uint8 *pBuf )
+{
+  if ( connHandle >= GATT_MAX_NUM_CONN )
+  {
+    return ( INVALIDPARAMETER );
+  }
+
+  clientFeatures[connHandle] = pBuf[0] & GATT_CLIENT_FEAT_SUPPORTED;
+  clientState[connHandle] = 0;
+
+  if ( clientFeatures[connHandle] & GATT_CLIENT_FEAT_ROBUST_CACHING )
+  {
+    if ( dbHashValid == FALSE )
+    {
+      gattServApp_ComputeDbHash();
+    }
+
+    if ( osal_memcmp( &pBuf[1], dbHash, GATT_CLIENT_HASH_LEN ) == FALSE )
+    {
+      clientState[connHandle] = GATT_CLIENT_CHANGE_UNAWARE;
+    }
+  }
+
+  return ( SUCCESS );
+}
+
+/*********************************************************************
+ * @fn      gattServApp_CCCDIdx
+ *
+ * @brief   Get the CCCD store index of a Client Characteristic
+ *          Configuration attribute.
+ *
+ * @param   pAttr - pointer to attribute
+ *
+ * @return  CCCD store index. GATT_CCCD_IDX_INVALID if the attribute value
+ *          is a gattCharCfg_t table.
+ */
+static uint8 gattServApp_CCCDIdx( gattAttribute_t *pAttr )
+{
+  if ( ( pAttr->pValue >= GATT_CCCD( 0 ) ) &&
+       ( pAttr->pValue < GATT_CCCD( GATT_MAX_NUM_CCCD ) ) )
+  {
+    return ( (uint8)( pAttr->pValue - GATT_CCCD( 0 ) ) );
   }
+
+  return ( GATT_CCCD_IDX_INVALID );
 }
 
 /*********************************************************************
- * @fn      GATTServApp_ReadCharCfg
- *
- * @brief   Read the client characteristic configuration for a given
- *          client.
+ * @fn      gattServApp_ReadCCC
  *
- *          Note: Each client has its own instantiation of the Client
- *                Characteristic Configuration. Reads of the Client
- *                Characteristic Configuration only shows the configuration
- *                for that client.
+ * @brief   Read a Client Characteristic Configuration for a given client,
+ *          from the CCCD store or from the table of the attribute.
  *
- * @param   connHandle - connection handle.
- * @param   charCfgTbl - client characteristic configuration table.
+ * @param   connHandle - connection handle
+ * @param   pAttr - pointer to attribute
  *
  * @return  attribute value
  */
-uint16 GATTServApp_ReadCharCfg( uint16 connHandle, gattCharCfg_t *charCfgTbl )
+static uint16 gattServApp_ReadCCC( uint16 connHandle, gattAttribute_t *pAttr )
 {
-  gattCharCfg_t *pItem;
+  uint8 cccdIdx = gattServApp_CCCDIdx( pAttr );
 
-  pItem = gattServApp_FindCharCfgItem( connHandle, charCfgTbl );
-  if ( pItem != NULL )
+  if ( cccdIdx != GATT_CCCD_IDX_INVALID )
   {
-    return ( (uint16)(pItem->value) );
+    return ( GATTServApp_ReadCCCD( connHandle, cccdIdx ) );
   }
 
-  return ( (uint16)GATT_CFG_NO_OPERATION );
+  return ( GATTServApp_ReadCharCfg( connHandle, (gattCharCfg_t *)(pAttr->pValue) ) );
 }
 
 /*********************************************************************
- * @fn      GATTServApp_WriteCharCfg
- *
- * @brief   Write the client characteristic configuration for a given
- *          client.
+ * @fn      gattServApp_WriteCCC
  *
- *          Note: Each client has its own instantiation of the Client
- *                Characteristic Configuration. Writes of the Client
- *                Characteristic Configuration only only affect the
- *                configuration of that client.
+ * @brief   Write a Client Characteristic Configuration for a given client,
+ *          to the CCCD store or to the table of the attribute.
  *
- * @param   connHandle - connection handle.
- * @param   charCfgTbl - client characteristic configuration table.
- * @param   value - attribute new value.
+ * @param   connHandle - connection handle
+ * @param   pAttr - pointer to attribute
+ * @param   value - attribute new value
  *
  * @return  Success or Failure
  */
-uint8 GATTServApp_WriteCharCfg( uint16 connHandle, gattCharCfg_t *charCfgTbl,
-                                uint16 value )
+static bStatus_t gattServApp_WriteCCC( uint16 connHandle, gattAttribute_t *pAttr,
+                                       uint16 value )
 {
-  gattCharCfg_t *pItem;
+  uint8 cccdIdx = gattServApp_CCCDIdx( pAttr );
 
-  pItem = gattServApp_FindCharCfgItem( connHandle, charCfgTbl );
-  if ( pItem == NULL )
+  if ( cccdIdx != GATT_CCCD_IDX_INVALID )
   {
-    pItem = gattServApp_FindCharCfgItem( INVALID_CONNHANDLE, charCfgTbl );
-    if ( pItem == NULL )
-    {
-      return ( ATT_ERR_INSUFFICIENT_RESOURCES );
-    }
-
-    pItem->connHandle = connHandle;
+    return ( ( GATTServApp_WriteCCCD( connHandle, cccdIdx, value ) == SUCCESS ) ?
+             SUCCESS : ATT_ERR_UNLIKELY );
   }
 
-  // Write the new value for this client
-  pItem->value = value;
-
-  return ( SUCCESS );
+  return ( GATTServApp_WriteCharCfg( connHandle, (gattCharCfg_t *)(pAttr->pValue), value ) );
 }
 
 /*********************************************************************
@@ -2369,12 +4050,9 @@ bStatus_t GATTServApp_ProcessCCCWriteReq( uint16 connHandle, gattAttribute_t *pA
       if ( ( value & ~validCfg ) == 0 ) // indicate and/or notify
       {
         // Write the value if it's changed
-        if ( GATTServApp_ReadCharCfg( connHandle,
-                                      (gattCharCfg_t *)(pAttr->pValue) ) != value )
+        if ( gattServApp_ReadCCC( connHandle, pAttr ) != value )
         {
-          status = GATTServApp_WriteCharCfg( connHandle,
-                                             (gattCharCfg_t *)(pAttr->pValue),
-                                             value );
+          status = gattServApp_WriteCCC( connHandle, pAttr, value );
           if ( status == SUCCESS )
           {
             // Notify the application
@@ -2462,6 +4140,366 @@ bStatus_t GATTServApp_ProcessCharCfg( gattCharCfg_t *charCfgTbl, uint8 *pValue,
   return ( status );
 }
 
+/*********************************************************************
+ * @fn      GATTServApp_QueueNotification
+ *
+ * @brief   Queue a notification for a client. What the controller takes is
+ *          sent right away, the rest at the end of the following connection
+ *          events.
+ *
+ * @param   connHandle - connection to use
+ * @param   pNoti - pointer to notification to be sent
+ * @param   flags - GATT_NOTI_FLAG_URGENT, GATT_NOTI_FLAG_COALESCE
+ *
+ * @return  SUCCESS: Notification sent or queued.
+ *          INVALIDPARAMETER: Invalid connection handle or length.
+ *          bleNotConnected: Connection is down.
+ *          bleNoResources: Client's queue is full.
+ *          bleMemAllocError: Memory allocation error occurred.
+ */
+bStatus_t GATTServApp_QueueNotification( uint16 connHandle, attHandleValueNoti_t *pNoti,
+                                         uint8 flags )
+{
+  gattNotiQueue_t *pQueue;
+  gattNoti_t **ppNoti;
+  gattNoti_t *pNew;
+
+  // Only (ATT_MTU - 3) octets fit in a notification on this connection
+  if ( ( connHandle >= GATT_MAX_NUM_CONN ) || ( pNoti->len > gAttMtuSize[connHandle]-3 ) )
+  {
+    return ( INVALIDPARAMETER );
+  }
+
+  if ( !linkDB_Up( connHandle ) )
+  {
+    return ( bleNotConnected );
+  }
+
+  pNew = (gattNoti_t *)osal_mem_alloc( sizeof( gattNoti_t ) + pNoti->len );
+  if ( pNew == NULL )
+  {
+    return ( bleMemAllocError );
+  }
+
+  pNew->handle = pNoti->handle;
+  pNew->flags = flags;
+  pNew->len = pNoti->len;
+  VOID osal_memcpy( (uint8 *)(pNew + 1), pNoti->value, pNoti->len );
+
+  pQueue = &(notiQueueTbl[connHandle]);
+
+  // A newer value of a state takes the place of the queued one. If it is
+  // more or less urgent than that one, it is queued again in its order.
+  if ( flags & GATT_NOTI_FLAG_COALESCE )
+  {
+    for ( ppNoti = &(pQueue->pHead); *ppNoti != NULL; ppNoti = &((*ppNoti)->pNext) )
+    {
+      if ( ( (*ppNoti)->handle == pNoti->handle ) &&
+           ( (*ppNoti)->flags & GATT_NOTI_FLAG_COALESCE ) )
+      {
+        gattNoti_t *pOld = *ppNoti;
+
+        if ( ( ( pOld->flags ^ flags ) & GATT_NOTI_FLAG_URGENT ) == 0 )
+        {
+          pNew->pNext = pOld->pNext;
+          *ppNoti = pNew;
+          osal_mem_free( pOld );
+
+          return ( SUCCESS );
+        }
+
+        *ppNoti = pOld->pNext;
+        osal_mem_free( pOld );
+        pQueue->num--;
+        break;
+      }
+    }
+  }
+
+  if ( pQueue->num >= GATT_MAX_NUM_QUEUED_NOTIS )
+  {
+    osal_mem_free( pNew );
+
+    return ( bleNoResources );
+  }
+
+  // Urgent notifications go after the urgent ones already queued, the
+  // others to the end
+  for ( ppNoti = &(pQueue->pHead); *ppNoti != NULL; ppNoti = &((*ppNoti)->pNext) )
+  {
+    if ( ( flags & GATT_NOTI_FLAG_URGENT ) &&
+         ( ( (*ppNoti)->flags & GATT_NOTI_FLAG_URGENT ) == 0 ) )
+    {
+      break;
+    }
+  }
+
+  pNew->pNext = *ppNoti;
+  *ppNoti = pNew;
+  pQueue->num++;
+
+  gattServApp_SendNotis( connHandle );
+
+  // Send the rest when the controller has room again
+  if ( pQueue->pHead != NULL )
+  {
+    gattServApp_UpdateConnEvtNotice();
+  }
+
+  return ( SUCCESS );
+}
+
+/*********************************************************************
+ * @fn      gattServApp_SendNoti
+ *
+ * @brief   Send one queued notification.
+ *
+ * @param   connHandle - connection to use
+ * @param   pNoti - queued notification
+ *
+ * @return  Status of GATT_Notification()
+ */
+static bStatus_t gattServApp_SendNoti( uint16 connHandle, gattNoti_t *pNoti )
+{
+  attHandleValueNoti_t noti;
+
+  noti.handle = pNoti->handle;
+  noti.len = pNoti->len;
+  VOID osal_memcpy( noti.value, (uint8 *)(pNoti + 1), pNoti->len );
+
+  return ( GATT_Notification( connHandle, &noti, FALSE ) );
+}
+
+/*********************************************************************
+ * @fn      gattServApp_SendMultiNoti
+ *
+ * @brief   Send the first queued notifications of a client in one
+ *          Multiple Handle Value Notification, as many as fit in the
+ *          ATT_MTU.
+ *
+ * @param   connHandle - connection to use
+ * @param   pNum - number of notifications sent (to be returned)
+ *
+ * @return  Success or Failure
+ */
+static bStatus_t gattServApp_SendMultiNoti( uint16 connHandle, uint8 *pNum )
+{
+  gattNoti_t *pNoti = notiQueueTbl[connHandle].pHead;
+  uint16 mtu = gAttMtuSize[connHandle];
+  l2capPacket_t pkt;
+  uint16 len = 1;
+  uint8 num = 0;
+  uint8 *pBuf;
+  uint8 status;
+
+  // Each value goes with its handle and length
+  for ( ; ( pNoti != NULL ) && ( len + 4 + pNoti->len <= mtu ); pNoti = pNoti->pNext )
+  {
+    len += 4 + pNoti->len;
+    num++;
+  }
+
+  if ( num < 2 )
+  {
+    *pNum = 1;
+
+    return ( gattServApp_SendNoti( connHandle, notiQueueTbl[connHandle].pHead ) );
+  }
+
+  pkt.pPayload = (uint8 *)L2CAP_bm_alloc( len );
+  if ( pkt.pPayload == NULL )
+  {
+    return ( bleMemAllocError );
+  }
+
+  pkt.CID = L2CAP_CID_ATT;
+  pkt.len = len;
+
+  pBuf = pkt.pPayload;
+  *pBuf++ = ATT_MULTI_HANDLE_VALUE_NOTI;
+
+  pNoti = notiQueueTbl[connHandle].pHead;
+  for ( uint8 i = 0; i < num; i++, pNoti = pNoti->pNext )
+  {
+    *pBuf++ = LO_UINT16( pNoti->handle );
+    *pBuf++ = HI_UINT16( pNoti->handle );
+    *pBuf++ = pNoti->len;
+    *pBuf++ = 0;
+    VOID osal_memcpy( pBuf, (uint8 *)(pNoti + 1), pNoti->len );
+    pBuf += pNoti->len;
+  }
+
+  status = L2CAP_SendData( connHandle, &pkt );
+  if ( status != SUCCESS )
+  {
+    // Not taken by L2CAP
+    osal_bm_free( pkt.pPayload );
+  }
+
+  *pNum = num;
+
+  return ( status );
+}
+
+/*********************************************************************
+ * @fn      gattServApp_SendNotis
+ *
+ * @brief   Send a client's queued notifications until the controller
+ *          runs out of buffers.
+ *
+ * @param   connHandle - connection to use
+ *
+ * @return  none
+ */
+static void gattServApp_SendNotis( uint16 connHandle )
+{
+  gattNotiQueue_t *pQueue = &(notiQueueTbl[connHandle]);
+
+  while ( pQueue->pHead != NULL )
+  {
+    uint8 num = 1;
+    uint8 status;
+
+    if ( ( pQueue->pHead->pNext != NULL ) &&
+         ( clientFeatures[connHandle] & GATT_CLIENT_FEAT_MULTI_NOTI ) )
+    {
+      status = gattServApp_SendMultiNoti( connHandle, &num );
+    }
+    else
+    {
+      status = gattServApp_SendNoti( connHandle, pQueue->pHead );
+    }
+
+    // Try again at the end of the next connection event
+    if ( ( status == MSG_BUFFER_NOT_AVAIL ) ||
+         ( status == bleNoResources )       ||
+         ( status == bleMemAllocError ) )
+    {
+      break;
+    }
+
+    // Sent, or it never will be
+    while ( num-- )
+    {
+      gattNoti_t *pNoti = pQueue->pHead;
+
+      pQueue->pHead = pNoti->pNext;
+      pQueue->num--;
+      osal_mem_free( pNoti );
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      gattServApp_SendQueuedNotis
+ *
+ * @brief   Send the queued notifications of all clients, at the end of
+ *          a connection event.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void gattServApp_SendQueuedNotis( void )
+{
+  for ( uint8 i = 0; i < GATT_MAX_NUM_CONN; i++ )
+  {
+    if ( notiQueueTbl[i].pHead != NULL )
+    {
+      gattServApp_SendNotis( i );
+    }
+  }
+
+  // Give the notice back if nothing is left to send
+  gattServApp_UpdateConnEvtNotice();
+}
+
+/*********************************************************************
+ * @fn      gattServApp_FlushNotis
+ *
+ * @brief   Drop a client's queued notifications.
+ *
+ * @param   connHandle - connection used by client
+ *
+ * @return  none
+ */
+static void gattServApp_FlushNotis( uint16 connHandle )
+{
+  gattNotiQueue_t *pQueue;
+
+  if ( connHandle >= GATT_MAX_NUM_CONN )
+  {
+    return;
+  }
+
+  pQueue = &(notiQueueTbl[connHandle]);
+  while ( pQueue->pHead != NULL )
+  {
+    gattNoti_t *pNoti = pQueue->pHead;
+
+    pQueue->pHead = pNoti->pNext;
+    osal_mem_free( pNoti );
+  }
+
+  pQueue->num = 0;
+
+  gattServApp_UpdateConnEvtNotice();
+}
+
+/*********************************************************************
+ * @fn      gattServApp_UpdateConnEvtNotice
+ *
+ * @brief   Take the connection event done notice while notifications are
+ *          queued or the application wants it, give it back otherwise.
+ *          The controller has one notice for all tasks, so the
+ *          application's goes through GATT_SERV_NOTI_EVT as well.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void gattServApp_UpdateConnEvtNotice( void )
+{
+  uint8 on = ( appConnEvtEvent != 0 );
+
+  for ( uint8 i = 0; ( i < GATT_MAX_NUM_CONN ) && ( on == FALSE ); i++ )
+  {
+    if ( notiQueueTbl[i].pHead != NULL )
+    {
+      on = TRUE;
+    }
+  }
+
+  if ( on != connEvtNoticeOn )
+  {
+    VOID HCI_PPLUS_ConnEventDoneNoticeCmd( GATTServApp_TaskID, on ? GATT_SERV_NOTI_EVT : 0 );
+    connEvtNoticeOn = on;
+  }
+}
+
+/*********************************************************************
+ * @fn      GATTServApp_ConnEventDoneNoticeCmd
+ *
+ * @brief   Enable or disable the connection event done notice of the
+ *          application. Use this instead of HCI_PPLUS_ConnEventDoneNoticeCmd(),
+ *          which would take the notice from the notification queues.
+ *
+ * @param   taskID - application's task ID
+ * @param   taskEvent - event to set at the end of each connection
+ *                      event, 0 to disable
+ *
+ * @return  SUCCESS
+ */
+bStatus_t GATTServApp_ConnEventDoneNoticeCmd( uint8 taskID, uint16 taskEvent )
+{
+  appConnEvtTaskID = taskID;
+  appConnEvtEvent = taskEvent;
+
+  gattServApp_UpdateConnEvtNotice();
+
+  return ( SUCCESS );
+}
+
 /*********************************************************************
  * @fn          gattServApp_HandleConnStatusCB
  *
@@ -2479,31 +4517,23 @@ static void gattServApp_HandleConnStatusCB( uint16 connHandle, uint8 changeType
        ( ( changeType == LINKDB_STATUS_UPDATE_STATEFLAGS ) &&
          ( !linkDB_Up( connHandle ) ) ) )
   {
-    prepareWrites_t *pQueue = gattServApp_FindPrepareWriteQ( connHandle );
+    // Clear this client's prepared writes
+    gattServApp_DequeuePrepareWriteReqs( connHandle );
+    VOID gattServApp_EndLongWrites( connHandle, GATT_LONG_WRITE_CANCEL, NULL );
 
-    // See if this client has a prepare write queue
-    if ( pQueue != NULL )
-    {
-      for ( uint8 i = 0; i < maxNumPrepareWrites; i++ )
-      {
-        attPrepareWriteReq_t *pWriteReq = &(pQueue->pPrepareWriteQ[i]);
-
-        // See if there're any prepared write requests in the queue
-        if ( pWriteReq->handle == GATT_INVALID_HANDLE )
-        {
-          break;
-        }
+    // Drop the notifications not sent yet
+    gattServApp_FlushNotis( connHandle );
 
-        // Clear the queue item
-        VOID osal_memset( pWriteReq, 0, sizeof( attPrepareWriteRsp_t ) );
-      } // for loop
+    // Reset Client Char Config of the CCCD store when connection drops
+    GATTServApp_InitCCCD( connHandle );
 
-      // Mark this queue as empty
-      pQueue->connHandle = INVALID_CONNHANDLE;
+    // Forget the client features, the next client starts change-aware.
+    // A bonded client gets them back from its bond record.
+    if ( connHandle < GATT_MAX_NUM_CONN )
+    {
+      clientFeatures[connHandle] = 0;
+      clientState[connHandle] = 0;
     }
-
-    // Reset Client Char Config when connection drops
-    GATTServApp_InitCharCfg( connHandle, indCharCfg );
   }
 }
 
@@ -31,6 +31,17 @@
  * CONSTANTS
  */
 
+// CCCD store indexes of the input reports
+#define HID_REPORT_KEY_IN_CCCD          ( GATT_CCCD_APP )
+#define HID_BOOT_KEY_IN_CCCD            ( GATT_CCCD_APP + 1 )
+#define HID_BOOT_MOUSE_IN_CCCD          ( GATT_CCCD_APP + 2 )
+#define HID_REPORT_MOUSE_IN_CCCD        ( GATT_CCCD_APP + 3 )
+#define HID_REPORT_CC_IN_CCCD           ( GATT_CCCD_APP + 4 )
+
+#if ( HID_REPORT_CC_IN_CCCD >= GATT_MAX_NUM_CCCD )
+  #error "GATT_MAX_NUM_CCCD too small for the HID Service"
+#endif
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -298,7 +309,6 @@ uint8 hidProtocolMode = HID_PROTOCOL_MODE_REPORT;
 // HID Report characteristic, key input
 static uint8 hidReportKeyInProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportKeyIn;
-static gattCharCfg_t hidReportKeyInClientCharCfg[GATT_MAX_NUM_CONN];
 
 // HID Report Reference characteristic descriptor, key input
 static uint8 hidReportRefKeyIn[HID_REPORT_REF_LEN] =
@@ -315,7 +325,6 @@ static uint8 hidReportRefLedOut[HID_REPORT_REF_LEN] =
 // HID Boot Keyboard Input Report
 static uint8 hidReportBootKeyInProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportBootKeyIn;
-static gattCharCfg_t hidReportBootKeyInClientCharCfg[GATT_MAX_NUM_CONN];
 
 // HID Boot Keyboard Output Report
 static uint8 hidReportBootKeyOutProps = GATT_PROP_READ | GATT_PROP_WRITE | GATT_PROP_WRITE_NO_RSP;
@@ -324,7 +333,6 @@ static uint8 hidReportBootKeyOut;
 // HID Boot Mouse Input Report
 static uint8 hidReportBootMouseInProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportBootMouseIn;
-static gattCharCfg_t hidReportBootMouseInClientCharCfg[GATT_MAX_NUM_CONN];
 
 // Feature Report
 static uint8 hidReportFeatureProps = GATT_PROP_READ | GATT_PROP_WRITE;
@@ -342,7 +350,6 @@ static uint8 hidReportRefMouseIn[HID_REPORT_REF_LEN] =
 
 static uint8 hidReportMouseInProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportMouseIn;
-static gattCharCfg_t hidReportMouseInClientCharCfg[GATT_MAX_NUM_CONN];
 
 #endif
 #if EN_CONSUMER_MODE
@@ -353,7 +360,6 @@ static uint8 hidReportRefCCIn[HID_REPORT_REF_LEN] =
  // HID Report characteristic, consumer control input
  static uint8 hidReportCCInProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
  static uint8 hidReportCCIn;
- static gattCharCfg_t hidReportCCInClientCharCfg[GATT_MAX_NUM_CONN];
 
 #endif
 
@@ -477,7 +483,7 @@ static gattAttribute_t hidAttrTbl[] =
 	   { ATT_BT_UUID_SIZE, clientCharCfgUUID },
 	   GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
 	   0,
-	   (uint8 *) &hidReportMouseInClientCharCfg
+	   GATT_CCCD( HID_REPORT_MOUSE_IN_CCCD )
 	 },
 
 	 // HID Report Reference characteristic descriptor, mouse input
@@ -513,7 +519,7 @@ static gattAttribute_t hidAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &hidReportKeyInClientCharCfg
+        GATT_CCCD( HID_REPORT_KEY_IN_CCCD )
       },
 
       // HID Report Reference characteristic descriptor, key input
@@ -569,7 +575,7 @@ static gattAttribute_t hidAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &hidReportBootKeyInClientCharCfg
+        GATT_CCCD( HID_BOOT_KEY_IN_CCCD )
       },
 
     // HID Boot Keyboard Output Report declaration
@@ -610,7 +616,7 @@ static gattAttribute_t hidAttrTbl[] =
 		   { ATT_BT_UUID_SIZE, clientCharCfgUUID },
 		   GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
 		   0,
-		   (uint8 *) &hidReportCCInClientCharCfg
+		   GATT_CCCD( HID_REPORT_CC_IN_CCCD )
 		 },
 	
 		// HID Report Reference characteristic descriptor, consumer control
@@ -644,7 +650,7 @@ static gattAttribute_t hidAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &hidReportBootMouseInClientCharCfg
+        GATT_CCCD( HID_BOOT_MOUSE_IN_CCCD )
       },
 
     // Feature Report declaration
@@ -724,11 +730,6 @@ bStatus_t HidKbd_AddService( void )
 {
   uint8 status = SUCCESS;
 
-  // Initialize Client Characteristic Configuration attributes
-  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, hidReportKeyInClientCharCfg );
-  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, hidReportBootKeyInClientCharCfg );
-  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, hidReportBootMouseInClientCharCfg );
-
   // Register GATT attribute list and CBs with GATT Server App
   status = GATTServApp_RegisterService( hidAttrTbl, GATT_NUM_ATTRS( hidAttrTbl ), &hidKbdCBs );
 
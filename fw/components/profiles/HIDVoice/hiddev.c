@@ -825,7 +825,9 @@ static void hidDevHandleConnStatusCB( uint16 connHandle, uint8 changeType )
     {
       for ( i = hidDevRptTblLen; i > 0; i--, p++ )
       {
-        if ( p->cccdHandle != 0 )
+        // GATT Server App resets the configurations of the CCCD store
+        if ( ( p->cccdHandle != 0 ) &&
+             ( GATTServApp_GetCCCDIdx( p->cccdHandle ) == GATT_CCCD_IDX_INVALID ) )
         {
           if ( (pAttr = GATT_FindHandle(p->cccdHandle, &retHandle)) != NULL )
           {
@@ -1170,8 +1172,16 @@ static void hidDevSendReport( uint8 id, uint8 type, uint8 len, uint8 *pData )
     if ( (pAttr = GATT_FindHandle(pRpt->cccdHandle, &retHandle)) != NULL )
     {
       uint16 value;
+      uint8  cccdIdx = GATTServApp_GetCCCDIdx( pRpt->cccdHandle );
 
-      value  = GATTServApp_ReadCharCfg( gapConnHandle, (gattCharCfg_t *) pAttr->pValue );
+      if ( cccdIdx != GATT_CCCD_IDX_INVALID )
+      {
+        value = GATTServApp_ReadCCCD( gapConnHandle, cccdIdx );
+      }
+      else
+      {
+        value = GATTServApp_ReadCharCfg( gapConnHandle, (gattCharCfg_t *) pAttr->pValue );
+      }
       if ( value & GATT_CLIENT_CFG_NOTIFY )
       {
         // After service discovery and encryption, the HID Device should request to
@@ -31,6 +31,19 @@
  * CONSTANTS
  */
 
+// CCCD store indexes of the input reports
+#define HID_REPORT_KEY_IN_CCCD          ( GATT_CCCD_APP )
+#define HID_BOOT_KEY_IN_CCCD            ( GATT_CCCD_APP + 1 )
+#define HID_BOOT_MOUSE_IN_CCCD          ( GATT_CCCD_APP + 2 )
+#define HID_REPORT_MOUSE_IN_CCCD        ( GATT_CCCD_APP + 3 )
+#define HID_REPORT_CC_IN_CCCD           ( GATT_CCCD_APP + 4 )
+#define HID_VOICE_START_IN_CCCD         ( GATT_CCCD_APP + 5 )
+#define HID_VOICE_DATA_IN_CCCD          ( GATT_CCCD_APP + 6 )
+
+#if ( HID_VOICE_DATA_IN_CCCD >= GATT_MAX_NUM_CCCD )
+  #error "GATT_MAX_NUM_CCCD too small for the HID Service"
+#endif
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -420,7 +433,6 @@ static uint8 hidExtReportRefDesc[ATT_BT_UUID_SIZE] =
 // HID Report characteristic, key input
 static uint8 hidReportKeyInProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportKeyIn;
-static gattCharCfg_t hidReportKeyInClientCharCfg[GATT_MAX_NUM_CONN];
 
 // HID Report Reference characteristic descriptor, key input
 static uint8 hidReportRefKeyIn[HID_REPORT_REF_LEN] =
@@ -439,7 +451,6 @@ static uint8 hidReportRefLedOut[HID_REPORT_REF_LEN] =
 // HID Boot Keyboard Input Report
 static uint8 hidReportBootKeyInProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportBootKeyIn;
-static gattCharCfg_t hidReportBootKeyInClientCharCfg[GATT_MAX_NUM_CONN];
 
 // HID Boot Keyboard Output Report
 static uint8 hidReportBootKeyOutProps = GATT_PROP_READ  |
@@ -450,7 +461,6 @@ static uint8 hidReportBootKeyOut;
 // HID Report characteristic, consumer control input
 static uint8 hidReportCCInProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportCCIn;
-static gattCharCfg_t hidReportCCInClientCharCfg[GATT_MAX_NUM_CONN];
 
 // HID Report Reference characteristic descriptor, consumer control input
 static uint8 hidReportRefCCIn[HID_REPORT_REF_LEN] =
@@ -460,14 +470,12 @@ static uint8 hidReportRefCCIn[HID_REPORT_REF_LEN] =
 // HID Report characteristic, Voice Start
 static uint8 hidReportVoiceStartProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportVoiceStart;
-static gattCharCfg_t hidReportVoiceStartInClientCharCfg[GATT_MAX_NUM_CONN];
 static uint8 hidReportRefVoiceStart[HID_REPORT_REF_LEN] =
              { HID_RPT_ID_VOICE_START_IN, HID_REPORT_TYPE_INPUT };
 
 // HID Report characteristic, Voice Data
 static uint8 hidReportVoiceDataProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportVoiceData;
-static gattCharCfg_t hidReportVoiceDataInClientCharCfg[GATT_MAX_NUM_CONN];
 static uint8 hidReportRefVoiceData[HID_REPORT_REF_LEN] =
              { HID_RPT_ID_VOICE_DATA_IN, HID_REPORT_TYPE_INPUT };
 
@@ -502,7 +510,6 @@ uint8 hidProtocolMode = HID_PROTOCOL_MODE_REPORT;
 // HID Report characteristic, key input
 static uint8 hidReportKeyInProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportKeyIn;
-static gattCharCfg_t hidReportKeyInClientCharCfg[GATT_MAX_NUM_CONN];
 
 // HID Report Reference characteristic descriptor, key input
 static uint8 hidReportRefKeyIn[HID_REPORT_REF_LEN] =
@@ -519,7 +526,6 @@ static uint8 hidReportRefLedOut[HID_REPORT_REF_LEN] =
 // HID Boot Keyboard Input Report
 static uint8 hidReportBootKeyInProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportBootKeyIn;
-static gattCharCfg_t hidReportBootKeyInClientCharCfg[GATT_MAX_NUM_CONN];
 
 // HID Boot Keyboard Output Report
 static uint8 hidReportBootKeyOutProps = GATT_PROP_READ | GATT_PROP_WRITE | GATT_PROP_WRITE_NO_RSP;
@@ -528,7 +534,6 @@ static uint8 hidReportBootKeyOut;
 // HID Boot Mouse Input Report
 static uint8 hidReportBootMouseInProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportBootMouseIn;
-static gattCharCfg_t hidReportBootMouseInClientCharCfg[GATT_MAX_NUM_CONN];
 
 // Feature Report
 static uint8 hidReportFeatureProps = GATT_PROP_READ | GATT_PROP_WRITE;
@@ -544,14 +549,12 @@ static uint8 hidReportRefFeature[HID_REPORT_REF_LEN] =
 // HID Report characteristic, Voice Start
 static uint8 hidReportVoiceStartProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportVoiceStart;
-static gattCharCfg_t *hidReportVoiceStartInClientCharCfg;
 static uint8 hidReportRefVoiceStart[HID_REPORT_REF_LEN] =
 { HID_RPT_ID_VOICE_START_IN, HID_REPORT_TYPE_INPUT };
 
 // HID Report characteristic, Voice Data
 static uint8 hidReportVoiceDataProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportVoiceData;
-static gattCharCfg_t *hidReportVoiceDataInClientCharCfg;
 static uint8 hidReportRefVoiceData[HID_REPORT_REF_LEN] =
 { HID_RPT_ID_VOICE_DATA_IN, HID_REPORT_TYPE_INPUT };
 
@@ -566,7 +569,6 @@ static uint8 hidReportRefMouseIn[HID_REPORT_REF_LEN] =
 
 static uint8 hidReportMouseInProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
 static uint8 hidReportMouseIn;
-static gattCharCfg_t hidReportMouseInClientCharCfg[GATT_MAX_NUM_CONN];
 
 #endif
 
@@ -578,7 +580,6 @@ static uint8 hidReportRefCCIn[HID_REPORT_REF_LEN] =
  // HID Report characteristic, consumer control input
  static uint8 hidReportCCInProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
  static uint8 hidReportCCIn;
- static gattCharCfg_t hidReportCCInClientCharCfg[GATT_MAX_NUM_CONN];
 
 #endif
 
@@ -701,7 +702,7 @@ static gattAttribute_t hidAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &hidReportKeyInClientCharCfg
+        GATT_CCCD( HID_REPORT_KEY_IN_CCCD )
       },
 
       // HID Report Reference characteristic descriptor, key input
@@ -757,7 +758,7 @@ static gattAttribute_t hidAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &hidReportBootKeyInClientCharCfg
+        GATT_CCCD( HID_BOOT_KEY_IN_CCCD )
       },
 
     // HID Boot Keyboard Output Report declaration
@@ -797,7 +798,7 @@ static gattAttribute_t hidAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &hidReportCCInClientCharCfg
+        GATT_CCCD( HID_REPORT_CC_IN_CCCD )
       },
 
      // HID Report Reference characteristic descriptor, consumer control
@@ -831,7 +832,7 @@ static gattAttribute_t hidAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &hidReportVoiceStartInClientCharCfg
+        GATT_CCCD( HID_VOICE_START_IN_CCCD )
       },
 
       // HID Report Reference characteristic descriptor, Voice Start
@@ -863,7 +864,7 @@ static gattAttribute_t hidAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &hidReportVoiceDataInClientCharCfg
+        GATT_CCCD( HID_VOICE_DATA_IN_CCCD )
       },
 
       // HID Report Reference characteristic descriptor, Voice Data
@@ -990,7 +991,7 @@ static gattAttribute_t hidAttrTbl[] =
 	   { ATT_BT_UUID_SIZE, clientCharCfgUUID },
 	   GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
 	   0,
-	   (uint8 *) &hidReportMouseInClientCharCfg
+	   GATT_CCCD( HID_REPORT_MOUSE_IN_CCCD )
 	 },
 
 	 // HID Report Reference characteristic descriptor, mouse input
@@ -1026,7 +1027,7 @@ static gattAttribute_t hidAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &hidReportKeyInClientCharCfg
+        GATT_CCCD( HID_REPORT_KEY_IN_CCCD )
     },
 
     // HID Report Reference characteristic descriptor, key input
@@ -1082,7 +1083,7 @@ static gattAttribute_t hidAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &hidReportBootKeyInClientCharCfg
+        GATT_CCCD( HID_BOOT_KEY_IN_CCCD )
     },
 
     // HID Boot Keyboard Output Report declaration
@@ -1123,7 +1124,7 @@ static gattAttribute_t hidAttrTbl[] =
 		   { ATT_BT_UUID_SIZE, clientCharCfgUUID },
 		   GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
 		   0,
-		   (uint8 *) &hidReportCCInClientCharCfg
+		   GATT_CCCD( HID_REPORT_CC_IN_CCCD )
 		 },
 	
 		// HID Report Reference characteristic descriptor, consumer control
@@ -1157,7 +1158,7 @@ static gattAttribute_t hidAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &hidReportBootMouseInClientCharCfg
+        GATT_CCCD( HID_BOOT_MOUSE_IN_CCCD )
       },
 
     // Feature Report declaration
@@ -1205,7 +1206,7 @@ static gattAttribute_t hidAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &hidReportVoiceStartInClientCharCfg
+        GATT_CCCD( HID_VOICE_START_IN_CCCD )
       },
 
       // HID Report Reference characteristic descriptor, Voice Start
@@ -1237,7 +1238,7 @@ static gattAttribute_t hidAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &hidReportVoiceDataInClientCharCfg
+        GATT_CCCD( HID_VOICE_DATA_IN_CCCD )
       },
 
       // HID Report Reference characteristic descriptor, Voice Data
@@ -1287,15 +1288,6 @@ bStatus_t HidKbd_AddService( void )
 {
     uint8 status = SUCCESS;
 
-    // Initialize Client Characteristic Configuration attributes
-			GATTServApp_InitCharCfg( INVALID_CONNHANDLE, hidReportKeyInClientCharCfg );
-			GATTServApp_InitCharCfg( INVALID_CONNHANDLE, hidReportBootKeyInClientCharCfg );
-			GATTServApp_InitCharCfg(INVALID_CONNHANDLE, hidReportCCInClientCharCfg);
-	#if 0
-			GATTServApp_InitCharCfg(INVALID_CONNHANDLE, hidReportVoiceStartInClientCharCfg);
-			GATTServApp_InitCharCfg(INVALID_CONNHANDLE, hidReportVoiceDataInClientCharCfg);
-	#endif
-
     // Register GATT attribute list and CBs with GATT Server App
     status = GATTServApp_RegisterService( hidAttrTbl, GATT_NUM_ATTRS( hidAttrTbl ), &hidKbdCBs );
 
@@ -1378,11 +1370,6 @@ bStatus_t HidKbd_AddService( void )
 {
     uint8 status = SUCCESS;
 
-    // Initialize Client Characteristic Configuration attributes
-    GATTServApp_InitCharCfg( INVALID_CONNHANDLE, hidReportKeyInClientCharCfg );
-    GATTServApp_InitCharCfg( INVALID_CONNHANDLE, hidReportBootKeyInClientCharCfg );
-    GATTServApp_InitCharCfg( INVALID_CONNHANDLE, hidReportBootMouseInClientCharCfg );
-
   // Register GATT attribute list and CBs with GATT Server App
   status = GATTServApp_RegisterService( hidAttrTbl, GATT_NUM_ATTRS( hidAttrTbl ), &hidKbdCBs );
 
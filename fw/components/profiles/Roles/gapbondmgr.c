@@ -58,46 +58,81 @@
  * GAP Bond Manager NV layout
  *
  * The NV definitions:
- *     BLE_NVID_GAP_BOND_START - starting NV ID
- *     GAP_BONDINGS_MAX - Maximum number of bonding allowed (10 is max for number of NV IDs allocated in bcomdef.h).
- *
- * A single bonding entry consists of 6 components (NV items):
- *     Bond Record - defined as gapBondRec_t and uses GAP_BOND_REC_ID_OFFSET for an NV ID
- *     local LTK Info - defined as gapBondLTK_t and uses GAP_BOND_LOCAL_LTK_OFFSET for an NV ID
- *     device LTK Info - defined as gapBondLTK_t and uses GAP_BOND_DEV_LTK_OFFSET for an NV ID
- *     device IRK - defined as "uint8 devIRK[KEYLEN]" and uses GAP_BOND_DEV_IRK_OFFSET for an NV ID
- *     device CSRK - defined as "uint8 devCSRK[KEYLEN]" and uses GAP_BOND_DEV_CSRK_OFFSET for an NV ID
- *     device Sign Counter - defined as a uint32 and uses GAP_BOND_DEV_SIGN_COUNTER_OFFSET for an NV ID
- *
- * When the device is initialized for the first time, all (GAP_BONDINGS_MAX) NV items are created and
- * initialized to all 0xFF's. A bonding record of all 0xFF's indicates that the bonding record is empty
- * and free to use.
+ *     BLE_NVID_GAP_BOND_START - starting NV ID of the bond records
+ *     BLE_NVID_GAP_BOND_CFG_START - starting NV ID of the bond configuration records
+ *     BLE_NVID_GAP_BOND_TABLE - NV ID of the bond table
+ *     GAP_BONDINGS_MAX - Maximum number of bonding allowed (48 is max for number of NV IDs allocated in bcomdef.h).
+ *
+ * A single bonding entry consists of 2 components (NV items):
+ *     Bond Record - defined as gapBondNvRec_t, the address information, LTKs, IRK and CSRK
+ *                   of the bonding. Written when the bonding is saved.
+ *     Bond Configuration - defined as gapBondCfg_t, the sign counter, the characteristic
+ *                   configurations, the Client Supported Features and the part of the
+ *                   Database Hash the client is change-aware of. Only written when one
+ *                   of them changes.
+ *
+ * The Bond Table holds a last used stamp for every bonding entry, 0 for an empty entry.
+ * Only the records of the used entries are read at initialization. The stamp counts
+ * the connections of bonded devices, the entry with the oldest stamp is replaced when
+ * a new bonding doesn't fit (GAPBOND_LRU_REPLACE). New stamps are kept in RAM and saved
+ * when a link terminates or the bonds change, a reset only loses the latest order.
+ *
+ * An FS item holds 12 bytes, so a bonding takes 9 items for its Bond Record and 3 for
+ * its Bond Configuration. hal_fs_init(0x1103c000,2) in main.c leaves 255 items for all
+ * of the application, GAP_BONDINGS_MAX must fit in there with room for the rewrites.
+ * That is 21 bondings with nothing else stored, so dozens of bondings need a larger FS:
+ * a Bond Record can't take fewer items while it holds both LTKs, the IRK and the CSRK.
+ *
+ * Without the FS (USE_FS 0) osal_snv.c keeps every item in a flash sector of its own,
+ * for OSAL_SNV_SECTOR_BONDS bondings.
+ *
+ * Bonds of the old layout (8 NV items each, in BLE_NVID 0x20-0x5F, 0x70-0x83) are not
+ * converted. Their items are deleted once, when no Bond Table is found.
  *
  * The calculation for each bonding records NV IDs:
- *    mainRecordNvID = ((bondIdx * GAP_BOND_REC_IDS) + BLE_NVID_GAP_BOND_START)
- *    localLTKNvID = (((bondIdx * GAP_BOND_REC_IDS) + GAP_BOND_LOCAL_LTK_OFFSET) + BLE_NVID_GAP_BOND_START)
+ *    bondRecNvID = (bondIdx + BLE_NVID_GAP_BOND_START)
+ *    bondCfgNvID = (bondIdx + BLE_NVID_GAP_BOND_CFG_START)
  *
  */
-#define GAP_BOND_REC_ID_OFFSET              0 //!< NV ID for the main bonding record
-#define GAP_BOND_LOCAL_LTK_OFFSET           1 //!< NV ID for the bonding record's local LTK information
-#define GAP_BOND_DEV_LTK_OFFSET             2 //!< NV ID for the bonding records' device LTK information
-#define GAP_BOND_DEV_IRK_OFFSET             3 //!< NV ID for the bonding records' device IRK
-#define GAP_BOND_DEV_CSRK_OFFSET            4 //!< NV ID for the bonding records' device CSRK
-#define GAP_BOND_DEV_SIGN_COUNTER_OFFSET    5 //!< NV ID for the bonding records' device Sign Counter
+#define bondRecNvID(bondIdx)                ((bondIdx) + BLE_NVID_GAP_BOND_START)
+#define bondCfgNvID(bondIdx)                ((bondIdx) + BLE_NVID_GAP_BOND_CFG_START)
+
+#if ( GAP_BONDINGS_MAX > ( BLE_NVID_GAP_BOND_END - BLE_NVID_GAP_BOND_START + 1 ) )
+  #error "GAP_BONDINGS_MAX exceeds the NV IDs allocated for bonds in bcomdef.h"
+#endif
+
+#if defined ( USE_FS ) && ( USE_FS == 0 ) && ( GAP_BONDINGS_MAX > OSAL_SNV_SECTOR_BONDS )
+  #error "GAP_BONDINGS_MAX exceeds the bonds osal_snv.c keeps without the FS"
+#endif
+
+// NV IDs of the old layout, bond records then GATT configurations and CCCD stores
+#define GAP_BOND_OLD_REC_START              0x20
+#define GAP_BOND_OLD_REC_END                0x5f
+#define GAP_BOND_OLD_CFG_START              0x70
+#define GAP_BOND_OLD_CFG_END                0x83
+
+// Public address to bond index lookup, a power of 2 with room for
+// twice the bonds so probing stays short
+#if ( GAP_BONDINGS_MAX <= 32 )
+  #define GAP_BOND_INDEX_SIZE               64
+#else
+  #define GAP_BOND_INDEX_SIZE               128
+#endif
 
-#define GAP_BOND_REC_IDS                    6
+#define GAP_BOND_INDEX_FREE                 0xFF //!< Unused address index entry
 
-// Macros to calculate the index/offset in to NV space
-#define calcNvID(Idx, offset)               (((((Idx) * GAP_BOND_REC_IDS) + (offset))) + BLE_NVID_GAP_BOND_START)
-#define mainRecordNvID(bondIdx)             (calcNvID((bondIdx), GAP_BOND_REC_ID_OFFSET))
-#define localLTKNvID(bondIdx)               (calcNvID((bondIdx), GAP_BOND_LOCAL_LTK_OFFSET))
-#define devLTKNvID(bondIdx)                 (calcNvID((bondIdx), GAP_BOND_DEV_LTK_OFFSET))
-#define devIRKNvID(bondIdx)                 (calcNvID((bondIdx), GAP_BOND_DEV_IRK_OFFSET))
-#define devCSRKNvID(bondIdx)                (calcNvID((bondIdx), GAP_BOND_DEV_CSRK_OFFSET))
-#define devSignCounterNvID(bondIdx)         (calcNvID((bondIdx), GAP_BOND_DEV_SIGN_COUNTER_OFFSET))
+// Resolvable private addresses remembered by gapBondMgrResolvePrivateAddr,
+// a cached address is resolved again once it is older than the RPA timeout
+// (TGAP_PRIVATE_ADDR_INT, 15 minutes by default) in ms.
+#if !defined ( GAP_BOND_RPA_CACHE_SIZE )
+  #define GAP_BOND_RPA_CACHE_SIZE           4
+#endif
+
+#if !defined ( GAP_BOND_RPA_CACHE_TIMEOUT )
+  #define GAP_BOND_RPA_CACHE_TIMEOUT        900000
+#endif
 
-// Macros to calculate the GATT index/offset in to NV space
-#define gattCfgNvID(Idx)                    ((Idx) + BLE_NVID_GATT_CFG_START)
+#define GAP_BOND_RPA_CACHE_FREE             0xFF //!< Unused RPA cache entry
 
 // Key Size Limits
 #define MIN_ENC_KEYSIZE                     7  //!< Minimum number of bytes for the encryption key
@@ -124,6 +159,14 @@ typedef struct
   uint16  stateFlags;                 // State flags: SM_AUTH_STATE_AUTHENTICATED & SM_AUTH_STATE_BONDING
 } gapBondRec_t;
 
+// Resolved private address, idx is GAP_BONDINGS_MAX if no bond resolves it
+typedef struct
+{
+  uint8   addr[B_ADDR_LEN];   // Resolvable private address
+  uint8   idx;                // Bond index or GAP_BOND_RPA_CACHE_FREE
+  uint32  timestamp;          // osal_GetSystemClock() when it was resolved
+} gapBondRpaCache_t;
+
 // Structure of NV data for the connected device's characteristic configuration
 typedef struct
 {
@@ -131,6 +174,25 @@ typedef struct
   uint8  value;       // attribute value for this device
 } gapBondCharCfg_t;
 
+// Structure of the NV bond record
+typedef struct
+{
+  gapBondRec_t  rec;              // Address information and state flags
+  gapBondLTK_t  localLTK;         // LTK used by this device
+  gapBondLTK_t  devLTK;           // LTK used by the connected device
+  uint8         devIRK[KEYLEN];   // Connected device's IRK
+  uint8         devCSRK[KEYLEN];  // Connected device's CSRK
+} gapBondNvRec_t;
+
+// Structure of the NV bond configuration record
+typedef struct
+{
+  uint32            signCounter;                  // Connected device's sign counter
+  gapBondCharCfg_t  charCfg[GAP_CHAR_CFG_MAX];    // Configurations with a gattCharCfg_t table, inverted
+  uint8             cccd[GATT_CCCD_STORE_SIZE];   // Configurations of the GATT CCCD store, inverted
+  uint8             client[GATT_CLIENT_INFO_SIZE]; // Client Supported Features and Database Hash part, inverted
+} gapBondCfg_t;
+
 /*********************************************************************
  * GLOBAL VARIABLES
  */
@@ -179,8 +241,27 @@ static const gapBondCBs_t *pGapBondCB = NULL;
 // Local RAM shadowed bond records
 static gapBondRec_t bonds[GAP_BONDINGS_MAX] = {0};
 
+// IRKs of the bonds, all 0xFF if the device didn't distribute one (IRK RAM Shadow)
+static uint8 bondIRK[GAP_BONDINGS_MAX][KEYLEN];
+
+// Last used stamp of each bond, 0 if the entry is empty (Bond Table in NV)
+static uint16 bondUse[GAP_BONDINGS_MAX] = {0};
+static uint16 bondUseClock = 0;
+static uint8 bondUseDirty = FALSE;  // bondUse differs from the Bond Table in NV
+
+// Public address to bond index, open addressing with linear probing
+static uint8 bondIndex[GAP_BOND_INDEX_SIZE];
+
+static uint8 lruReplace = TRUE;
+
 static uint8 autoSyncWhiteList = FALSE;
 
+static uint8 autoSyncResolvingList = FALSE;
+static uint8 resolvingListDirty = FALSE;  // Bonds changed while connected, synced when the last link terminates
+
+// Recently resolved private addresses, most recently used first
+static gapBondRpaCache_t rpaCache[GAP_BOND_RPA_CACHE_SIZE];
+
 static uint8 eraseAllBonds = FALSE;
 
 static uint8 bondsToDelete[GAP_BONDINGS_MAX] = {FALSE};
@@ -197,13 +278,31 @@ static uint8 gapBondMgrUpdateCharCfg( uint8 idx, uint16 attrHandle, uint16 value
 static gapBondCharCfg_t *gapBondMgrFindCharCfgItem( uint16 attrHandle,
                                                     gapBondCharCfg_t *charCfgTbl );
 static void gapBondMgrInvertCharCfgItem( gapBondCharCfg_t *charCfgTbl );
+static uint8 gapBondMgrSaveCCCD( uint16 connHandle );
+static uint8 gapBondMgrSaveClientInfo( uint16 connHandle );
+static void gapBondMgrInvertBytes( uint8 *pBuf, uint8 len );
 static uint8 gapBondMgrAddBond( gapBondRec_t *pBondRec, gapAuthCompleteEvent_t *pPkt );
 static uint8 gapBondMgrGetStateFlags( uint8 idx );
 static bStatus_t gapBondMgrGetPublicAddr( uint8 idx, uint8 *pAddr );
 static uint8 gapBondMgrFindReconnectAddr( uint8 *pReconnectAddr );
 static uint8 gapBondMgrFindAddr( uint8 *pDevAddr );
+static uint8 gapBondMgrHashAddr( uint8 *pAddr );
+static void gapBondMgrIndexBonds( void );
+static void gapBondMgrUseBond( uint8 idx );
+static void gapBondMgrFreeBond( uint8 idx );
+static uint8 gapBondMgrSaveTable( void );
+static uint8 gapBondMgrReadRec( uint8 idx, gapBondNvRec_t *pRec );
+static uint8 gapBondMgrReadCfg( uint8 idx, gapBondCfg_t *pCfg );
+static uint8 gapBondMgrWriteRec( uint8 idx, gapBondNvRec_t *pRec );
+static uint8 gapBondMgrWriteCfg( uint8 idx, gapBondCfg_t *pCfg );
+static void gapBondMgrMigrate( void );
 static uint8 gapBondMgrResolvePrivateAddr( uint8 *pAddr );
+static uint8 gapBondMgrRpaCacheFind( uint8 *pAddr );
+static void gapBondMgrRpaCacheAdd( uint8 *pAddr, uint8 idx );
+static void gapBondMgrRpaCacheUse( uint8 i );
+static void gapBondMgrRpaCacheFlush( void );
 static void gapBondMgrReadBonds( void );
+static void gapBondMgrBondsChanged( void );
 static uint8 gapBondMgrFindEmpty( void );
 static uint8 gapBondMgrBondTotal( void );
 static bStatus_t gapBondMgrEraseAllBondings( void );
@@ -218,6 +317,7 @@ static void gapBondMgrBondReq( uint16 connHandle, uint8 idx, uint8 stateFlags,
 static void gapBondMgrAuthenticate( uint16 connHandle, uint8 addrType,
                                     gapPairingReq_t *pPairReq );
 static void gapBondMgr_SyncWhiteList( void );
+static void gapBondMgr_SyncResolvingList( void );
 static uint8 gapBondMgr_SyncCharCfg( uint16 connHandle );
 static void gapBondFreeAuthEvt( void );
 
@@ -467,6 +567,37 @@ bStatus_t GAPBondMgr_SetParameter( uint16 param, uint8 len, void *pValue )
       }
       break;
 
+    case GAPBOND_LRU_REPLACE:
+      if ( (len == sizeof ( uint8 )) && (*((uint8*)pValue) <= TRUE) )
+      {
+        lruReplace = *((uint8*)pValue);
+      }
+      else
+      {
+        ret = bleInvalidRange;
+      }
+      break;
+
+    case GAPBOND_AUTO_SYNC_RL:
+      if ( len == sizeof( uint8 ) )
+      {
+        uint8 oldVal = autoSyncResolvingList;
+
+        autoSyncResolvingList = *((uint8 *)pValue);
+
+        // only call if parameter changes from FALSE to TRUE
+        if ( ( oldVal == FALSE ) && ( autoSyncResolvingList == TRUE ) )
+        {
+          // make sure bond is updated from NV
+          gapBondMgrReadBonds();
+        }
+      }
+      else
+      {
+        ret = bleInvalidRange;
+      }
+      break;
+
 #if ( HOST_CONFIG & CENTRAL_CFG )
     case GAPBOND_BOND_FAIL_ACTION:
       if ( (len == sizeof ( uint8 )) && (*((uint8*)pValue) <= GAPBOND_FAIL_TERMINATE_ERASE_BONDS) )
@@ -559,6 +690,14 @@ bStatus_t GAPBondMgr_GetParameter( uint16 param, void *pValue )
       *((uint8*)pValue) = autoSyncWhiteList;
       break;
 
+    case GAPBOND_AUTO_SYNC_RL:
+      *((uint8*)pValue) = autoSyncResolvingList;
+      break;
+
+    case GAPBOND_LRU_REPLACE:
+      *((uint8*)pValue) = lruReplace;
+      break;
+
     case GAPBOND_BOND_COUNT:
       *((uint8*)pValue) = gapBondMgrBondTotal();
       break;
@@ -595,7 +734,17 @@ bStatus_t GAPBondMgr_LinkEst( uint8 addrType, uint8 *pDevAddr, uint16 connHandle
   {
     uint8 stateFlags = gapBondMgrGetStateFlags( idx );
     smSigningInfo_t signingInfo;
-    gapBondCharCfg_t charCfg[GAP_CHAR_CFG_MAX]; // Space to read a char cfg record from NV
+    gapBondNvRec_t bondRec;   // Space to read a bond record from NV
+    gapBondCfg_t cfg;         // Space to read a bond configuration record from NV
+
+    // Most recently used now, keeps the bond from being replaced
+    gapBondMgrUseBond( idx );
+
+    // Read the sign counter and the characteristic configurations
+    if ( gapBondMgrReadCfg( idx, &cfg ) != SUCCESS )
+    {
+      VOID osal_memset( &cfg, 0xFF, sizeof ( gapBondCfg_t ) );
+    }
 
     // On peripheral, load the key information for the bonding
     // On central and initiaiting security, load key to initiate encyption
@@ -604,12 +753,13 @@ bStatus_t GAPBondMgr_LinkEst( uint8 addrType, uint8 *pDevAddr, uint16 connHandle
 
     // Load the Signing Key
     VOID osal_memset( &signingInfo, 0, sizeof ( smSigningInfo_t ) );
-    if ( osal_snv_read( devCSRKNvID(idx), KEYLEN, signingInfo.srk ) == SUCCESS )
+    if ( gapBondMgrReadRec( idx, &bondRec ) == SUCCESS )
     {
-      if ( osal_isbufset( signingInfo.srk, 0xFF, KEYLEN ) == FALSE )
+      if ( osal_isbufset( bondRec.devCSRK, 0xFF, KEYLEN ) == FALSE )
       {
         // Load the signing information for this connection
-        VOID osal_snv_read( devSignCounterNvID(idx), sizeof ( uint32 ), &(signingInfo.signCounter) );
+        VOID osal_memcpy( signingInfo.srk, bondRec.devCSRK, KEYLEN );
+        signingInfo.signCounter = cfg.signCounter;
         VOID GAP_Signable( connHandle,
                           ((stateFlags & GAP_BONDED_STATE_AUTHENTICATED) ? TRUE : FALSE),
                           &signingInfo );
@@ -617,23 +767,29 @@ bStatus_t GAPBondMgr_LinkEst( uint8 addrType, uint8 *pDevAddr, uint16 connHandle
     }
 
     // Load the characteristic configuration
-    if ( osal_snv_read( gattCfgNvID(idx), sizeof ( charCfg ), charCfg ) == SUCCESS )
+    gapBondMgrInvertCharCfgItem( cfg.charCfg );
+
+    for ( uint8 i = 0; i < GAP_CHAR_CFG_MAX; i++ )
     {
-      gapBondMgrInvertCharCfgItem( charCfg );
+      gapBondCharCfg_t *pItem = &(cfg.charCfg[i]);
 
-      for ( uint8 i = 0; i < GAP_CHAR_CFG_MAX; i++ )
+      // Apply the characteristic configuration for this connection
+      if ( pItem->attrHandle != GATT_INVALID_HANDLE )
       {
-        gapBondCharCfg_t *pItem = &(charCfg[i]);
-
-        // Apply the characteristic configuration for this connection
-        if ( pItem->attrHandle != GATT_INVALID_HANDLE )
-        {
-          VOID GATTServApp_UpdateCharCfg( connHandle, pItem->attrHandle,
-                                          (uint16)(pItem->value) );
-        }
+        VOID GATTServApp_UpdateCharCfg( connHandle, pItem->attrHandle,
+                                        (uint16)(pItem->value) );
       }
     }
 
+    // Load the configurations of the CCCD store, all at once
+    gapBondMgrInvertBytes( cfg.cccd, sizeof ( cfg.cccd ) );
+    VOID GATTServApp_RestoreCCCD( connHandle, cfg.cccd );
+
+    // Load the client features, the client is change-unaware if the
+    // database changed since it was last change-aware
+    gapBondMgrInvertBytes( cfg.client, sizeof ( cfg.client ) );
+    VOID GATTServApp_RestoreClientInfo( connHandle, cfg.client );
+
     // Has there been a service change?
     if ( stateFlags & GAP_BONDED_STATE_SERVICE_CHANGED )
     {
@@ -750,10 +906,10 @@ bStatus_t GAPBondMgr_ServiceChangeInd( uint16 connectionHandle, uint8 setParam )
     {
       uint8 idx; // loop counter
       idx = GAPBondMgr_ResolveAddr( pLinkItem->addrType, pLinkItem->addr, NULL );
-      if ( idx < GAP_BONDINGS_MAX )
+      // Bond found, update it.
+      if ( ( idx < GAP_BONDINGS_MAX ) &&
+           gapBondMgrChangeState( idx, GAP_BONDED_STATE_SERVICE_CHANGED, setParam ) )
       {
-        // Bond found, update it.
-        VOID gapBondMgrChangeState( idx, GAP_BONDED_STATE_SERVICE_CHANGED, setParam );
         ret = SUCCESS;
       }
 
@@ -794,6 +950,14 @@ bStatus_t GAPBondMgr_UpdateCharCfg( uint16 connectionHandle, uint16 attrHandle,
       }
     }
   }
+  else if ( GATTServApp_GetCCCDIdx( attrHandle ) != GATT_CCCD_IDX_INVALID )
+  {
+    // The configurations of the CCCD store are saved all at once
+    if ( gapBondMgrSaveCCCD( connectionHandle ) )
+    {
+      ret = SUCCESS;
+    }
+  }
   else
   {
     // Find connection information
@@ -801,10 +965,10 @@ bStatus_t GAPBondMgr_UpdateCharCfg( uint16 connectionHandle, uint16 attrHandle,
     if ( pLinkItem )
     {
       uint8 idx = GAPBondMgr_ResolveAddr( pLinkItem->addrType, pLinkItem->addr, NULL );
-      if ( idx < GAP_BONDINGS_MAX )
+      // Bond found, update it.
+      if ( ( idx < GAP_BONDINGS_MAX ) &&
+           gapBondMgrUpdateCharCfg( idx, attrHandle, value ) )
       {
-        // Bond found, update it.
-        VOID gapBondMgrUpdateCharCfg( idx, attrHandle, value );
         ret = SUCCESS;
       }
     }
@@ -1003,8 +1167,17 @@ uint8 GAPBondMgr_ProcessGAPMsg( gapEventHdr_t *pMsg )
         idx = GAPBondMgr_ResolveAddr( pPkt->addrType, pPkt->devAddr, NULL );
         if ( idx < GAP_BONDINGS_MAX )
         {
+          gapBondCfg_t cfg;
+
           // Save the sign counter
-          VOID osal_snv_write( devSignCounterNvID(idx), sizeof ( uint32 ), &(pPkt->signCounter) );
+          if ( ( gapBondMgrReadCfg( idx, &cfg ) == SUCCESS ) &&
+               ( cfg.signCounter != pPkt->signCounter ) )
+          {
+            // The counter isn't kept in RAM, a failed write is
+            // tried again with the next update
+            cfg.signCounter = pPkt->signCounter;
+            VOID gapBondMgrWriteCfg( idx, &cfg );
+          }
         }
       }
       break;
@@ -1102,13 +1275,19 @@ uint8 GAPBondMgr_ProcessGAPMsg( gapEventHdr_t *pMsg )
 #endif
 
     case GAP_LINK_TERMINATED_EVENT:
+      // Save the stamps of the bonds used since, kept dirty if it fails
+      VOID gapBondMgrSaveTable();
+
       if ( GAP_NumActiveConnections() == 0 )
       {
+        uint8 erased = FALSE;
+
         // See if we're asked to erase all bonding records
         if ( eraseAllBonds == TRUE )
         {
           VOID gapBondMgrEraseAllBondings();
           eraseAllBonds = FALSE;
+          erased = TRUE;
           
           // Reset bonds to delete table
           osal_memset( bondsToDelete, FALSE, sizeof( bondsToDelete ) );
@@ -1122,6 +1301,7 @@ uint8 GAPBondMgr_ProcessGAPMsg( gapEventHdr_t *pMsg )
             {
               VOID gapBondMgrEraseBonding( idx );
               bondsToDelete[idx] = FALSE;
+              erased = TRUE;
             }
           }
         }
@@ -1129,8 +1309,17 @@ uint8 GAPBondMgr_ProcessGAPMsg( gapEventHdr_t *pMsg )
         // See if NV needs a compaction
         VOID osal_snv_compact( NV_COMPACT_THRESHOLD );
 
-        // Make sure Bond RAM Shadow is up-to-date
-        gapBondMgrReadBonds();
+        // The erase keeps the Bond RAM Shadow up-to-date, no need to read NV
+        if ( erased )
+        {
+          gapBondMgrBondsChanged();
+        }
+
+        // Bonds saved or replaced during the connections
+        if ( resolvingListDirty && autoSyncResolvingList )
+        {
+          gapBondMgr_SyncResolvingList();
+        }
       }
       break;
 
@@ -1154,18 +1343,16 @@ uint8 GAPBondMgr_ProcessGAPMsg( gapEventHdr_t *pMsg )
  * @param   state - state flage to set or clear
  * @param   set - TRUE to set the flag, FALSE to clear the flag
  *
- * @return  TRUE if NV Record exists, FALSE if NV Record is empty
+ * @return  TRUE if NV Record exists and holds the state, FALSE if
+ *          NV Record is empty or couldn't be written
  */
 static uint8 gapBondMgrChangeState( uint8 idx, uint16 state, uint8 set )
 {
-  gapBondRec_t bondRec;   // Space to read a Bond record from NV
-
-  // Look for public address that is used (not all 0xFF's)
-  if ( (osal_snv_read( mainRecordNvID(idx), sizeof ( gapBondRec_t ), &bondRec ) == SUCCESS)
-      && (osal_isbufset( bondRec.publicAddr, 0xFF, B_ADDR_LEN ) == FALSE) )
+  // Look for a used bond entry
+  if ( bondUse[idx] != 0 )
   {
     // Update the state of the bonded device.
-    uint8 stateFlags = bondRec.stateFlags;
+    uint8 stateFlags = bonds[idx].stateFlags;
     if ( set )
     {
       stateFlags |= state;
@@ -1175,10 +1362,23 @@ static uint8 gapBondMgrChangeState( uint8 idx, uint16 state, uint8 set )
       stateFlags &= ~(state);
     }
 
-    if ( stateFlags != bondRec.stateFlags )
+    if ( stateFlags != bonds[idx].stateFlags )
     {
-      bondRec.stateFlags = stateFlags;
-      VOID osal_snv_write( mainRecordNvID(idx), sizeof ( gapBondRec_t ), &bondRec );
+      gapBondNvRec_t bondRec;   // Space to read a Bond record from NV
+
+      // The Bond RAM Shadow follows NV only
+      if ( gapBondMgrReadRec( idx, &bondRec ) != SUCCESS )
+      {
+        return ( FALSE );
+      }
+
+      bondRec.rec.stateFlags = stateFlags;
+      if ( gapBondMgrWriteRec( idx, &bondRec ) != SUCCESS )
+      {
+        return ( FALSE );
+      }
+
+      bonds[idx].stateFlags = stateFlags;
     }
     return ( TRUE );
   }
@@ -1194,41 +1394,46 @@ static uint8 gapBondMgrChangeState( uint8 idx, uint16 state, uint8 set )
  * @param   attrHandle - attribute handle (0 means all handles)
  * @param   value - characteristic configuration value
  *
- * @return  TRUE if NV Record exists, FALSE if NV Record is empty
+ * @return  TRUE if NV Record exists and holds the configuration, FALSE if
+ *          NV Record is empty, full or couldn't be written
  */
 static uint8 gapBondMgrUpdateCharCfg( uint8 idx, uint16 attrHandle, uint16 value )
 {
-  gapBondRec_t bondRec;   // Space to read a Bond record from NV
-
-  // Look for public address that is used (not all 0xFF's)
-  if ( ( osal_snv_read( mainRecordNvID(idx), sizeof ( gapBondRec_t ), &bondRec ) == SUCCESS )
-       && ( osal_isbufset( bondRec.publicAddr, 0xFF, B_ADDR_LEN ) == FALSE ) )
+  // Look for a used bond entry
+  if ( bondUse[idx] != 0 )
   {
-    gapBondCharCfg_t charCfg[GAP_CHAR_CFG_MAX]; // Space to read a char cfg record from NV
+    gapBondCfg_t cfg; // Space to read a bond configuration record from NV
 
-    if ( osal_snv_read( gattCfgNvID(idx), sizeof ( charCfg ), charCfg ) == SUCCESS )
+    if ( gapBondMgrReadCfg( idx, &cfg ) == SUCCESS )
     {
       uint8 update = FALSE;
 
-      gapBondMgrInvertCharCfgItem( charCfg );
+      gapBondMgrInvertCharCfgItem( cfg.charCfg );
 
       if ( attrHandle == GATT_INVALID_HANDLE )
       {
-        if ( osal_isbufset( (uint8 *)charCfg, 0x00, sizeof ( charCfg ) ) == FALSE )
+        if ( osal_isbufset( (uint8 *)cfg.charCfg, 0x00, sizeof ( cfg.charCfg ) ) == FALSE )
         {
           // Clear all characteristic configuration for this device
-          VOID osal_memset( (void *)charCfg, 0x00, sizeof ( charCfg ) );
+          VOID osal_memset( (void *)cfg.charCfg, 0x00, sizeof ( cfg.charCfg ) );
+          update = TRUE;
+        }
+
+        // Clear the configurations of the CCCD store too
+        if ( osal_isbufset( cfg.cccd, 0xFF, sizeof ( cfg.cccd ) ) == FALSE )
+        {
+          VOID osal_memset( cfg.cccd, 0xFF, sizeof ( cfg.cccd ) );
           update = TRUE;
         }
       }
       else
       {
-        gapBondCharCfg_t *pItem = gapBondMgrFindCharCfgItem( attrHandle, charCfg );
+        gapBondCharCfg_t *pItem = gapBondMgrFindCharCfgItem( attrHandle, cfg.charCfg );
         if ( pItem == NULL )
         {
           // Must be a new item; ignore if the value is no operation (default)
           if ( ( value == GATT_CFG_NO_OPERATION ) ||
-               ( ( pItem = gapBondMgrFindCharCfgItem( GATT_INVALID_HANDLE, charCfg ) ) == NULL ) )
+               ( ( pItem = gapBondMgrFindCharCfgItem( GATT_INVALID_HANDLE, cfg.charCfg ) ) == NULL ) )
           {
             return ( FALSE ); // No empty entry found
           }
@@ -1253,8 +1458,11 @@ static uint8 gapBondMgrUpdateCharCfg( uint8 idx, uint16 attrHandle, uint16 value
       // Update the characteristic configuration of the bonded device.
       if ( update )
       {
-        gapBondMgrInvertCharCfgItem( charCfg );
-        VOID osal_snv_write( gattCfgNvID(idx), sizeof( charCfg ), charCfg );
+        gapBondMgrInvertCharCfgItem( cfg.charCfg );
+        if ( gapBondMgrWriteCfg( idx, &cfg ) != SUCCESS )
+        {
+          return ( FALSE );
+        }
       }
     }
 
@@ -1308,6 +1516,118 @@ static void gapBondMgrInvertCharCfgItem( gapBondCharCfg_t *charCfgTbl )
   }
 }
 
+/*********************************************************************
+ * @fn      gapBondMgrSaveCCCD
+ *
+ * @brief   Save all the configurations of the CCCD store of a connection
+ *          in the bond record of the connected device.
+ *
+ * @param   connHandle - connection handle
+ *
+ * @return  TRUE if the device is bonded and its configurations are saved,
+ *          FALSE otherwise
+ */
+static uint8 gapBondMgrSaveCCCD( uint16 connHandle )
+{
+  linkDBItem_t *pLinkItem = linkDB_Find( connHandle );
+  uint8 cccd[GATT_CCCD_STORE_SIZE];
+  gapBondCfg_t cfg;
+  uint8 idx;
+
+  if ( pLinkItem == NULL )
+  {
+    return ( FALSE );
+  }
+
+  idx = GAPBondMgr_ResolveAddr( pLinkItem->addrType, pLinkItem->addr, NULL );
+  if ( ( idx >= GAP_BONDINGS_MAX ) ||
+       ( GATTServApp_SaveCCCD( connHandle, cccd ) != SUCCESS ) )
+  {
+    return ( FALSE );
+  }
+
+  gapBondMgrInvertBytes( cccd, sizeof ( cccd ) );
+
+  // Only write NV if the configurations changed
+  if ( ( gapBondMgrReadCfg( idx, &cfg ) == SUCCESS ) &&
+       ( osal_memcmp( cccd, cfg.cccd, sizeof ( cccd ) ) == FALSE ) )
+  {
+    VOID osal_memcpy( cfg.cccd, cccd, sizeof ( cccd ) );
+    if ( gapBondMgrWriteCfg( idx, &cfg ) != SUCCESS )
+    {
+      return ( FALSE );
+    }
+  }
+
+  return ( TRUE );
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrSaveClientInfo
+ *
+ * @brief   Save the Client Supported Features of a connection and the
+ *          part of the Database Hash it is change-aware of in the bond
+ *          record of the connected device.
+ *
+ * @param   connHandle - connection handle
+ *
+ * @return  TRUE if the device is bonded and its information is saved,
+ *          FALSE otherwise
+ */
+static uint8 gapBondMgrSaveClientInfo( uint16 connHandle )
+{
+  linkDBItem_t *pLinkItem = linkDB_Find( connHandle );
+  uint8 client[GATT_CLIENT_INFO_SIZE];
+  gapBondCfg_t cfg;
+  uint8 idx;
+
+  if ( pLinkItem == NULL )
+  {
+    return ( FALSE );
+  }
+
+  idx = GAPBondMgr_ResolveAddr( pLinkItem->addrType, pLinkItem->addr, NULL );
+  if ( ( idx >= GAP_BONDINGS_MAX ) ||
+       ( GATTServApp_SaveClientInfo( connHandle, client ) != SUCCESS ) )
+  {
+    return ( FALSE );
+  }
+
+  gapBondMgrInvertBytes( client, sizeof ( client ) );
+
+  // Only write NV if the information changed
+  if ( ( gapBondMgrReadCfg( idx, &cfg ) == SUCCESS ) &&
+       ( osal_memcmp( client, cfg.client, sizeof ( client ) ) == FALSE ) )
+  {
+    VOID osal_memcpy( cfg.client, client, sizeof ( client ) );
+    if ( gapBondMgrWriteCfg( idx, &cfg ) != SUCCESS )
+    {
+      return ( FALSE );
+    }
+  }
+
+  return ( TRUE );
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrInvertBytes
+ *
+ * @brief   Invert a part of the bond configuration record, an erased
+ *          record (all 0xFF's) is then all zero.
+ *
+ * @param   pBuf - part of the record
+ * @param   len - length of the part
+ *
+ * @return  none
+ */
+static void gapBondMgrInvertBytes( uint8 *pBuf, uint8 len )
+{
+  for ( uint8 i = 0; i < len; i++ )
+  {
+    pBuf[i] = ~(pBuf[i]);
+  }
+}
+
 /*********************************************************************
  * @fn      gapBondMgrAddBond
  *
@@ -1338,6 +1658,12 @@ static uint8 gapBondMgrAddBond( gapBondRec_t *pBondRec, gapAuthCompleteEvent_t *
     if ( bondIdx >= GAP_BONDINGS_MAX )
     {
       bondIdx = gapBondMgrFindEmpty();
+
+      // A pending erase was meant for the bond being replaced
+      if ( bondIdx < GAP_BONDINGS_MAX )
+      {
+        bondsToDelete[bondIdx] = FALSE;
+      }
     }
   }
 
@@ -1346,62 +1672,76 @@ static uint8 gapBondMgrAddBond( gapBondRec_t *pBondRec, gapAuthCompleteEvent_t *
     // See if this is a new bond record
     if ( pAuthEvt == NULL )
     {
-      gapBondCharCfg_t charCfg[GAP_CHAR_CFG_MAX];
-      
-      // Save the main information
-      VOID osal_snv_write( mainRecordNvID(bondIdx), sizeof ( gapBondRec_t ), pBondRec );
-    
-      // Write out FF's over the charactersitic configuration entry, to overwrite
-      // any previous bond data that may have been stored
-      VOID osal_memset( charCfg, 0xFF, sizeof ( charCfg ) );
+      gapBondNvRec_t bondRec;
+      gapBondCfg_t cfg;
 
-      VOID osal_snv_write( gattCfgNvID(bondIdx), sizeof ( charCfg ), charCfg );
+      // Keys that weren't distributed are left all 0xFF's
+      VOID osal_memset( &bondRec, 0xFF, sizeof ( gapBondNvRec_t ) );
+      VOID osal_memcpy( &(bondRec.rec), pBondRec, sizeof ( gapBondRec_t ) );
 
-      // Update Bond RAM Shadow just with the newly added bond entry
-      VOID osal_memcpy( &(bonds[bondIdx]), pBondRec, sizeof ( gapBondRec_t ) );
-      
-      // Keep the OSAL message to store the security keys later - will be freed then
-      pAuthEvt = pPkt;
-    }
-    else
-    {
-      // If available, save the LTK information
-      if ( pAuthEvt->pSecurityInfo )
+      // If available, the LTK information
+      if ( pPkt->pSecurityInfo )
       {
-        VOID osal_snv_write( localLTKNvID(bondIdx), sizeof ( gapBondLTK_t ), pAuthEvt->pSecurityInfo );
-        pAuthEvt->pSecurityInfo = NULL;
+        VOID osal_memcpy( &(bondRec.localLTK), pPkt->pSecurityInfo, sizeof ( gapBondLTK_t ) );
       }
-      // If availabe, save the connected device's LTK information
-      else if ( pAuthEvt->pDevSecInfo )
+
+      // If available, the connected device's LTK information
+      if ( pPkt->pDevSecInfo )
       {
-        VOID osal_snv_write( devLTKNvID(bondIdx), sizeof ( gapBondLTK_t ), pAuthEvt->pDevSecInfo );
-        pAuthEvt->pDevSecInfo = NULL;
+        VOID osal_memcpy( &(bondRec.devLTK), pPkt->pDevSecInfo, sizeof ( gapBondLTK_t ) );
       }
-      // If available, save the connected device's IRK
-      else if ( pAuthEvt->pIdentityInfo )
+
+      // If available, the connected device's IRK
+      if ( pPkt->pIdentityInfo )
       {
-        VOID osal_snv_write( devIRKNvID(bondIdx), KEYLEN, pAuthEvt->pIdentityInfo->irk );
-        pAuthEvt->pIdentityInfo = NULL;
+        VOID osal_memcpy( bondRec.devIRK, pPkt->pIdentityInfo->irk, KEYLEN );
       }
-      // If available, save the connected device's Signature information
-      else if ( pAuthEvt->pSigningInfo )
+
+      // Write out FF's over the charactersitic configurations, to overwrite
+      // any previous bond data that may have been stored
+      VOID osal_memset( &cfg, 0xFF, sizeof ( gapBondCfg_t ) );
+
+      // If available, the connected device's Signature information
+      if ( pPkt->pSigningInfo )
       {
-        VOID osal_snv_write( devCSRKNvID(bondIdx), KEYLEN, pAuthEvt->pSigningInfo->srk );    
-        VOID osal_snv_write( devSignCounterNvID(bondIdx), sizeof ( uint32 ), &(pAuthEvt->pSigningInfo->signCounter) );
-        pAuthEvt->pSigningInfo = NULL;
+        VOID osal_memcpy( bondRec.devCSRK, pPkt->pSigningInfo->srk, KEYLEN );
+        cfg.signCounter = pPkt->pSigningInfo->signCounter;
       }
-      else
+
+      // Update Bond RAM Shadow just with the newly added bond entry
+      VOID osal_memcpy( &(bonds[bondIdx]), pBondRec, sizeof ( gapBondRec_t ) );
+      VOID osal_memcpy( bondIRK[bondIdx], bondRec.devIRK, KEYLEN );
+      gapBondMgrUseBond( bondIdx );
+
+      // Save the bond, then mark its entry used in the Bond Table
+      if ( ( gapBondMgrWriteRec( bondIdx, &bondRec ) != SUCCESS ) ||
+           ( gapBondMgrWriteCfg( bondIdx, &cfg ) != SUCCESS )     ||
+           ( gapBondMgrSaveTable() != SUCCESS ) )
       {
-        if ( autoSyncWhiteList )
-        {
-          gapBondMgr_SyncWhiteList();
-        }
+        // NV may hold part of this bond or of the one it replaced, drop
+        // both. The Bond Table is saved again when the link terminates
+        gapBondMgrFreeBond( bondIdx );
+        VOID gapBondMgrSaveTable();
+        gapBondMgrBondsChanged();
+
+        bondIdx = GAP_BONDINGS_MAX;
 
-        // Update the GAP Privacy Flag Properties
-        gapBondSetupPrivFlag();
-        
         return ( TRUE );
       }
+
+      gapBondMgrIndexBonds();
+
+      // The entry may have held another bond
+      gapBondMgrRpaCacheFlush();
+      
+      // Keep the OSAL message until the bond is complete - will be freed then
+      pAuthEvt = pPkt;
+    }
+    else
+    {
+      gapBondMgrBondsChanged();
+
+      return ( TRUE );
     }
     
     // We have more info to store
@@ -1414,7 +1754,7 @@ static uint8 gapBondMgrAddBond( gapBondRec_t *pBondRec, gapAuthCompleteEvent_t *
 /*********************************************************************
  * @fn      gapBondMgrGetStateFlags
  *
- * @brief   Gets the state flags field of a bond record in NV
+ * @brief   Gets the state flags field of a bond record
  *
  * @param   idx
  *
@@ -1422,11 +1762,9 @@ static uint8 gapBondMgrAddBond( gapBondRec_t *pBondRec, gapAuthCompleteEvent_t *
  */
 static uint8 gapBondMgrGetStateFlags( uint8 idx )
 {
-  gapBondRec_t bondRec;
-
-  if ( osal_snv_read( mainRecordNvID(idx), sizeof ( gapBondRec_t ), &bondRec ) == SUCCESS )
+  if ( bondUse[idx] != 0 )
   {
-    return ( bondRec.stateFlags );
+    return ( bonds[idx].stateFlags );
   }
 
   return ( 0 );
@@ -1438,30 +1776,27 @@ static uint8 gapBondMgrGetStateFlags( uint8 idx )
  * @brief   Copy the public Address from a bonding record
  *
  * @param   idx - Bond record index
- * @param   pAddr - a place to put the public address from NV
+ * @param   pAddr - a place to put the public address
  *
  * @return  SUCCESS if successful.
  *          Otherwise failure.
  */
 static bStatus_t gapBondMgrGetPublicAddr( uint8 idx, uint8 *pAddr )
 {
-  bStatus_t stat;         // return value
-  gapBondRec_t bondRec;   // Work space for main bond record
-
   // Check parameters
   if ( (idx >= GAP_BONDINGS_MAX) || (pAddr == NULL) )
   {
     return ( INVALIDPARAMETER );
   }
 
-  stat = osal_snv_read( mainRecordNvID(idx), sizeof ( gapBondRec_t ), &bondRec );
-
-  if ( stat == SUCCESS )
+  if ( bondUse[idx] == 0 )
   {
-    VOID osal_memcpy( pAddr, bondRec.publicAddr, B_ADDR_LEN );
+    return ( NV_OPER_FAILED );
   }
 
-  return ( stat );
+  VOID osal_memcpy( pAddr, bonds[idx].publicAddr, B_ADDR_LEN );
+
+  return ( SUCCESS );
 }
 
 /*********************************************************************
@@ -1481,7 +1816,8 @@ static uint8 gapBondMgrFindReconnectAddr( uint8 *pReconnectAddr )
   for ( uint8 idx = 0; idx < GAP_BONDINGS_MAX; idx++ )
   {
     // compare reconnection address
-    if ( osal_memcmp( bonds[idx].reconnectAddr, pReconnectAddr, B_ADDR_LEN ) )
+    if ( ( bondUse[idx] != 0 ) &&
+         ( osal_memcmp( bonds[idx].reconnectAddr, pReconnectAddr, B_ADDR_LEN ) ) )
     {
       return ( idx ); // Found it
     }
@@ -1493,122 +1829,558 @@ static uint8 gapBondMgrFindReconnectAddr( uint8 *pReconnectAddr )
 /*********************************************************************
  * @fn      gapBondMgrFindAddr
  *
- * @brief   Look through the bonding entries to find an address.
+ * @brief   Look up an address in the address index of the bonds.
  *
  * @param   pDevAddr - device address to look for
  *
- * @return  index to empty bonding (0 - (GAP_BONDINGS_MAX-1),
- *          GAP_BONDINGS_MAX if no empty entries
+ * @return  index to found bonding (0 - (GAP_BONDINGS_MAX-1),
+ *          GAP_BONDINGS_MAX if no entry found
  */
 static uint8 gapBondMgrFindAddr( uint8 *pDevAddr )
 {
-  // Item doesn't exist, so create all the items
-  for ( uint8 idx = 0; idx < GAP_BONDINGS_MAX; idx++ )
+  uint8 i = gapBondMgrHashAddr( pDevAddr );
+
+  // The index is never full, probing ends at an unused entry
+  while ( bondIndex[i] != GAP_BOND_INDEX_FREE )
   {
-    // Read in NV Main Bond Record and compare public address
-    if ( osal_memcmp( bonds[idx].publicAddr, pDevAddr, B_ADDR_LEN ) )
+    if ( osal_memcmp( bonds[bondIndex[i]].publicAddr, pDevAddr, B_ADDR_LEN ) )
     {
-      return ( idx ); // Found it
+      return ( bondIndex[i] ); // Found it
     }
+
+    i = ( i + 1 ) & ( GAP_BOND_INDEX_SIZE - 1 );
   }
 
   return ( GAP_BONDINGS_MAX );
 }
 
 /*********************************************************************
- * @fn      gapBondMgrResolvePrivateAddr
+ * @fn      gapBondMgrHashAddr
  *
- * @brief   Look through the NV bonding entries to resolve a private
- *          address.
+ * @brief   Hash an address into the address index.
  *
- * @param   pDevAddr - device address to look for
+ * @param   pAddr - device address
  *
- * @return  index to found bonding (0 - (GAP_BONDINGS_MAX-1),
- *          GAP_BONDINGS_MAX if no entry found
+ * @return  first address index entry to probe
  */
-static uint8 gapBondMgrResolvePrivateAddr( uint8 *pDevAddr )
+static uint8 gapBondMgrHashAddr( uint8 *pAddr )
 {
-  for ( uint8 idx = 0; idx < GAP_BONDINGS_MAX; idx++ )
-  {
-    uint8 IRK[KEYLEN];
+  uint8 hash = 0;
 
-    // Read in NV IRK Record and compare resovable address
-    if ( osal_snv_read( devIRKNvID(idx), KEYLEN, IRK ) == SUCCESS )
-    {
-      if ( ( osal_isbufset( IRK, 0xFF, KEYLEN ) == FALSE ) &&
-           ( GAP_ResolvePrivateAddr( IRK, pDevAddr ) == SUCCESS ) )
-      {
-        return ( idx ); // Found it
-      }
-    }
+  for ( uint8 i = 0; i < B_ADDR_LEN; i++ )
+  {
+    hash = (uint8)( ( hash * 31 ) + pAddr[i] );
   }
 
-  return ( GAP_BONDINGS_MAX );
+  return ( hash & ( GAP_BOND_INDEX_SIZE - 1 ) );
 }
 
 /*********************************************************************
- * @fn      gapBondMgrReadBonds
+ * @fn      gapBondMgrIndexBonds
  *
- * @brief   Read through NV and store them in RAM.
+ * @brief   Rebuild the address index from the Bond RAM Shadow.
  *
  * @param   none
  *
  * @return  none
  */
-static void gapBondMgrReadBonds( void )
+static void gapBondMgrIndexBonds( void )
 {
+  VOID osal_memset( bondIndex, GAP_BOND_INDEX_FREE, sizeof ( bondIndex ) );
+
   for ( uint8 idx = 0; idx < GAP_BONDINGS_MAX; idx++ )
   {
-    // See if the entry exists in NV
-    if ( osal_snv_read( mainRecordNvID(idx), sizeof( gapBondRec_t ), &(bonds[idx]) ) != SUCCESS )
+    if ( bondUse[idx] != 0 )
     {
-      // Can't read the entry, assume that it doesn't exist
-      VOID osal_memset( bonds[idx].publicAddr, 0xFF, B_ADDR_LEN );
-      VOID osal_memset( bonds[idx].reconnectAddr, 0xFF, B_ADDR_LEN );
-      bonds[idx].stateFlags = 0;
-    }
-  }
+      uint8 i = gapBondMgrHashAddr( bonds[idx].publicAddr );
 
-  if ( autoSyncWhiteList )
-  {
-    gapBondMgr_SyncWhiteList();
-  }
+      while ( bondIndex[i] != GAP_BOND_INDEX_FREE )
+      {
+        i = ( i + 1 ) & ( GAP_BOND_INDEX_SIZE - 1 );
+      }
 
-  // Update the GAP Privacy Flag Properties
-  gapBondSetupPrivFlag();
+      bondIndex[i] = idx;
+    }
+  }
 }
 
 /*********************************************************************
- * @fn      gapBondMgrFindEmpty
+ * @fn      gapBondMgrUseBond
  *
- * @brief   Look through the bonding NV entries to find an empty.
+ * @brief   Stamp a bond as the most recently used one, unless it
+ *          already is. The Bond Table is saved later, see
+ *          gapBondMgrSaveTable.
  *
- * @param   none
+ * @param   idx - bond index
  *
- * @return  index to empty bonding (0 - (GAP_BONDINGS_MAX-1),
- *          GAP_BONDINGS_MAX if no empty entries
+ * @return  none
  */
-static uint8 gapBondMgrFindEmpty( void )
+static void gapBondMgrUseBond( uint8 idx )
 {
-  // Item doesn't exist, so create all the items
-  for ( uint8 idx = 0; idx < GAP_BONDINGS_MAX; idx++ )
+  if ( ( bondUse[idx] != 0 ) && ( bondUse[idx] == bondUseClock ) )
   {
-    // Look for public address of all 0xFF's
-    if ( osal_isbufset( bonds[idx].publicAddr, 0xFF, B_ADDR_LEN ) )
-    {
-      return ( idx ); // Found one
-    }
+    return;
   }
 
-  return ( GAP_BONDINGS_MAX );
-}
+  if ( bondUseClock == 0xFFFF )
+  {
+    uint8 rank[GAP_BONDINGS_MAX];
 
-/*********************************************************************
- * @fn      gapBondMgrBondTotal
- *
- * @brief   Look through the bonding NV entries calculate the number
- *          entries.
- *
+    // Out of stamps, renumber the used bonds from 1 keeping their order
+    for ( uint8 i = 0; i < GAP_BONDINGS_MAX; i++ )
+    {
+      rank[i] = 0;
+
+      for ( uint8 j = 0; ( bondUse[i] != 0 ) && ( j < GAP_BONDINGS_MAX ); j++ )
+      {
+        if ( ( bondUse[j] != 0 ) && ( bondUse[j] <= bondUse[i] ) )
+        {
+          rank[i]++;
+        }
+      }
+    }
+
+    bondUseClock = 0;
+
+    for ( uint8 i = 0; i < GAP_BONDINGS_MAX; i++ )
+    {
+      bondUse[i] = rank[i];
+
+      if ( bondUse[i] > bondUseClock )
+      {
+        bondUseClock = bondUse[i];
+      }
+    }
+  }
+
+  bondUse[idx] = ++bondUseClock;
+  bondUseDirty = TRUE;
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrFreeBond
+ *
+ * @brief   Free the entry of a bond in the Bond Table and the Bond
+ *          RAM Shadow. Its NV records are left as they are.
+ *
+ * @param   idx - bond index
+ *
+ * @return  none
+ */
+static void gapBondMgrFreeBond( uint8 idx )
+{
+  bondUse[idx] = 0;
+  bondUseDirty = TRUE;
+
+  VOID osal_memset( bonds[idx].publicAddr, 0xFF, B_ADDR_LEN );
+  VOID osal_memset( bonds[idx].reconnectAddr, 0xFF, B_ADDR_LEN );
+  bonds[idx].stateFlags = 0;
+  VOID osal_memset( bondIRK[idx], 0xFF, KEYLEN );
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrSaveTable
+ *
+ * @brief   Save the Bond Table if it changed. Connections only change
+ *          the stamps in RAM, so they don't rewrite it every time.
+ *
+ * @param   none
+ *
+ * @return  SUCCESS or NV_OPER_FAILED
+ */
+static uint8 gapBondMgrSaveTable( void )
+{
+  if ( bondUseDirty )
+  {
+    if ( osal_snv_write( BLE_NVID_GAP_BOND_TABLE, sizeof ( bondUse ), bondUse ) != SUCCESS )
+    {
+      return ( NV_OPER_FAILED );
+    }
+
+    bondUseDirty = FALSE;
+  }
+
+  return ( SUCCESS );
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrReadRec
+ *
+ * @brief   Read the NV bond record of a bond.
+ *
+ * @param   idx - bond index
+ * @param   pRec - a place to put the record
+ *
+ * @return  SUCCESS or NV_OPER_FAILED
+ */
+static uint8 gapBondMgrReadRec( uint8 idx, gapBondNvRec_t *pRec )
+{
+  return ( osal_snv_read( bondRecNvID(idx), sizeof ( gapBondNvRec_t ), pRec ) );
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrReadCfg
+ *
+ * @brief   Read the NV bond configuration record of a bond.
+ *
+ * @param   idx - bond index
+ * @param   pCfg - a place to put the record
+ *
+ * @return  SUCCESS or NV_OPER_FAILED
+ */
+static uint8 gapBondMgrReadCfg( uint8 idx, gapBondCfg_t *pCfg )
+{
+  return ( osal_snv_read( bondCfgNvID(idx), sizeof ( gapBondCfg_t ), pCfg ) );
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrWriteRec
+ *
+ * @brief   Write the NV bond record of a bond.
+ *
+ * @param   idx - bond index
+ * @param   pRec - the record
+ *
+ * @return  SUCCESS or NV_OPER_FAILED
+ */
+static uint8 gapBondMgrWriteRec( uint8 idx, gapBondNvRec_t *pRec )
+{
+  return ( osal_snv_write( bondRecNvID(idx), sizeof ( gapBondNvRec_t ), pRec ) );
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrWriteCfg
+ *
+ * @brief   Write the NV bond configuration record of a bond.
+ *
+ * @param   idx - bond index
+ * @param   pCfg - the record
+ *
+ * @return  SUCCESS or NV_OPER_FAILED
+ */
+static uint8 gapBondMgrWriteCfg( uint8 idx, gapBondCfg_t *pCfg )
+{
+  return ( osal_snv_write( bondCfgNvID(idx), sizeof ( gapBondCfg_t ), pCfg ) );
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrResolvePrivateAddr
+ *
+ * @brief   Look through the IRK RAM Shadow to resolve a private
+ *          address. The result, found or not, is kept in the RPA cache
+ *          so the IRKs are not checked again for the same address.
+ *
+ * @param   pDevAddr - device address to look for
+ *
+ * @return  index to found bonding (0 - (GAP_BONDINGS_MAX-1),
+ *          GAP_BONDINGS_MAX if no entry found
+ */
+static uint8 gapBondMgrResolvePrivateAddr( uint8 *pDevAddr )
+{
+  uint8 idx = gapBondMgrRpaCacheFind( pDevAddr );
+
+  if ( idx != GAP_BOND_RPA_CACHE_FREE )
+  {
+    return ( idx );
+  }
+
+  for ( idx = 0; idx < GAP_BONDINGS_MAX; idx++ )
+  {
+    // Compare resolvable address with the IRK of each used bond
+    if ( ( bondUse[idx] != 0 ) &&
+         ( osal_isbufset( bondIRK[idx], 0xFF, KEYLEN ) == FALSE ) &&
+         ( GAP_ResolvePrivateAddr( bondIRK[idx], pDevAddr ) == SUCCESS ) )
+    {
+      break; // Found it
+    }
+  }
+
+  gapBondMgrRpaCacheAdd( pDevAddr, idx );
+
+  return ( idx );
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrRpaCacheFind
+ *
+ * @brief   Look for a private address in the RPA cache, expired
+ *          entries are dropped on the way.
+ *
+ * @param   pAddr - device address to look for
+ *
+ * @return  cached bond index (GAP_BONDINGS_MAX if it resolved to none),
+ *          GAP_BOND_RPA_CACHE_FREE if the address isn't cached
+ */
+static uint8 gapBondMgrRpaCacheFind( uint8 *pAddr )
+{
+  uint32 now = osal_GetSystemClock();
+
+  for ( uint8 i = 0; i < GAP_BOND_RPA_CACHE_SIZE; i++ )
+  {
+    if ( rpaCache[i].idx == GAP_BOND_RPA_CACHE_FREE )
+    {
+      continue;
+    }
+
+    if ( ( now - rpaCache[i].timestamp ) >= GAP_BOND_RPA_CACHE_TIMEOUT )
+    {
+      rpaCache[i].idx = GAP_BOND_RPA_CACHE_FREE;
+    }
+    else if ( osal_memcmp( rpaCache[i].addr, pAddr, B_ADDR_LEN ) )
+    {
+      gapBondMgrRpaCacheUse( i );
+
+      return ( rpaCache[0].idx );
+    }
+  }
+
+  return ( GAP_BOND_RPA_CACHE_FREE );
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrRpaCacheAdd
+ *
+ * @brief   Remember a resolved private address, replacing a free or
+ *          else the least recently used entry.
+ *
+ * @param   pAddr - resolvable private address
+ * @param   idx - bond index, GAP_BONDINGS_MAX if not resolved
+ *
+ * @return  none
+ */
+static void gapBondMgrRpaCacheAdd( uint8 *pAddr, uint8 idx )
+{
+  uint8 i;
+
+  for ( i = 0; i < ( GAP_BOND_RPA_CACHE_SIZE - 1 ); i++ )
+  {
+    if ( rpaCache[i].idx == GAP_BOND_RPA_CACHE_FREE )
+    {
+      break;
+    }
+  }
+
+  VOID osal_memcpy( rpaCache[i].addr, pAddr, B_ADDR_LEN );
+  rpaCache[i].idx = idx;
+  rpaCache[i].timestamp = osal_GetSystemClock();
+
+  gapBondMgrRpaCacheUse( i );
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrRpaCacheUse
+ *
+ * @brief   Move an RPA cache entry to the front, the most recently
+ *          used position.
+ *
+ * @param   i - entry to move
+ *
+ * @return  none
+ */
+static void gapBondMgrRpaCacheUse( uint8 i )
+{
+  gapBondRpaCache_t entry = rpaCache[i];
+
+  for ( ; i > 0; i-- )
+  {
+    rpaCache[i] = rpaCache[i-1];
+  }
+
+  rpaCache[0] = entry;
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrRpaCacheFlush
+ *
+ * @brief   Forget all resolved private addresses, called whenever
+ *          the bonds change.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void gapBondMgrRpaCacheFlush( void )
+{
+  for ( uint8 i = 0; i < GAP_BOND_RPA_CACHE_SIZE; i++ )
+  {
+    rpaCache[i].idx = GAP_BOND_RPA_CACHE_FREE;
+  }
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrReadBonds
+ *
+ * @brief   Read through NV and store them in RAM. Only the bonds
+ *          marked used in the Bond Table are read.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void gapBondMgrReadBonds( void )
+{
+  // Stamps not saved yet would be lost
+  VOID gapBondMgrSaveTable();
+
+  // A shorter table leaves the remaining entries empty. A missing one
+  // (or one of a larger GAP_BONDINGS_MAX) is the first start with it
+  VOID osal_memset( bondUse, 0, sizeof ( bondUse ) );
+  if ( osal_snv_read( BLE_NVID_GAP_BOND_TABLE, sizeof ( bondUse ), bondUse ) != SUCCESS )
+  {
+    gapBondMgrMigrate();
+  }
+
+  bondUseClock = 0;
+
+  for ( uint8 idx = 0; idx < GAP_BONDINGS_MAX; idx++ )
+  {
+    gapBondNvRec_t bondRec;
+
+    // See if the entry exists in NV
+    if ( ( bondUse[idx] != 0 ) &&
+         ( gapBondMgrReadRec( idx, &bondRec ) == SUCCESS ) &&
+         ( osal_isbufset( bondRec.rec.publicAddr, 0xFF, B_ADDR_LEN ) == FALSE ) )
+    {
+      VOID osal_memcpy( &(bonds[idx]), &(bondRec.rec), sizeof ( gapBondRec_t ) );
+      VOID osal_memcpy( bondIRK[idx], bondRec.devIRK, KEYLEN );
+
+      if ( bondUse[idx] > bondUseClock )
+      {
+        bondUseClock = bondUse[idx];
+      }
+    }
+    else
+    {
+      // Can't read the entry, assume that it doesn't exist and
+      // drop it from the Bond Table too
+      if ( bondUse[idx] != 0 )
+      {
+        bondUseDirty = TRUE;
+      }
+
+      bondUse[idx] = 0;
+      VOID osal_memset( bonds[idx].publicAddr, 0xFF, B_ADDR_LEN );
+      VOID osal_memset( bonds[idx].reconnectAddr, 0xFF, B_ADDR_LEN );
+      bonds[idx].stateFlags = 0;
+      VOID osal_memset( bondIRK[idx], 0xFF, KEYLEN );
+    }
+  }
+
+  gapBondMgrBondsChanged();
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrMigrate
+ *
+ * @brief   Delete the NV items of the bonds saved in the old layout,
+ *          then save an empty Bond Table so it's only done once.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void gapBondMgrMigrate( void )
+{
+  uint8 ret = SUCCESS;
+  osalSnvId_t id;
+
+  for ( id = GAP_BOND_OLD_REC_START; id <= GAP_BOND_OLD_REC_END; id++ )
+  {
+    ret |= osal_snv_delete( id );
+  }
+
+  for ( id = GAP_BOND_OLD_CFG_START; id <= GAP_BOND_OLD_CFG_END; id++ )
+  {
+    ret |= osal_snv_delete( id );
+  }
+
+  // Try again at the next start if any item is left
+  if ( ret == SUCCESS )
+  {
+    bondUseDirty = TRUE;
+    VOID gapBondMgrSaveTable();
+  }
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrBondsChanged
+ *
+ * @brief   Update everything that follows the Bond RAM Shadow after
+ *          bonds were read, added or erased.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void gapBondMgrBondsChanged( void )
+{
+  gapBondMgrIndexBonds();
+
+  gapBondMgrRpaCacheFlush();
+
+  if ( autoSyncWhiteList )
+  {
+    gapBondMgr_SyncWhiteList();
+  }
+
+  if ( autoSyncResolvingList )
+  {
+    // Address resolution is off while the list is rewritten, so it's
+    // left for the links up until the last one terminates
+    if ( GAP_NumActiveConnections() == 0 )
+    {
+      gapBondMgr_SyncResolvingList();
+    }
+    else
+    {
+      resolvingListDirty = TRUE;
+    }
+  }
+
+  // Update the GAP Privacy Flag Properties
+  gapBondSetupPrivFlag();
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrFindEmpty
+ *
+ * @brief   Look through the bonding entries to find an empty one,
+ *          or else the least recently used one if it may be replaced.
+ *          A connected bond was stamped when its link was established,
+ *          so it isn't the oldest while there are more bonds than links.
+ *
+ * @param   none
+ *
+ * @return  index to empty bonding (0 - (GAP_BONDINGS_MAX-1),
+ *          GAP_BONDINGS_MAX if no empty entries
+ */
+static uint8 gapBondMgrFindEmpty( void )
+{
+  uint8 lru = 0;
+
+  for ( uint8 idx = 0; idx < GAP_BONDINGS_MAX; idx++ )
+  {
+    // Look for an unused entry
+    if ( bondUse[idx] == 0 )
+    {
+      return ( idx ); // Found one
+    }
+
+    if ( bondUse[idx] < bondUse[lru] )
+    {
+      lru = idx;
+    }
+  }
+
+  return ( lruReplace ? lru : GAP_BONDINGS_MAX );
+}
+
+/*********************************************************************
+ * @fn      gapBondMgrBondTotal
+ *
+ * @brief   Look through the bonding entries calculate the number
+ *          entries.
+ *
  * @param   none
  *
  * @return  total number of bonds found
@@ -1617,11 +2389,10 @@ static uint8 gapBondMgrBondTotal( void )
 {
   uint8 numBonds = 0;
 
-  // Item doesn't exist, so create all the items
   for ( uint8 idx = 0; idx < GAP_BONDINGS_MAX; idx++ )
   {
-    // Look for public address that are not 0xFF's
-    if ( osal_isbufset( bonds[idx].publicAddr, 0xFF, B_ADDR_LEN ) == FALSE )
+    // Look for used entries
+    if ( bondUse[idx] != 0 )
     {
       numBonds++; // Found one
     }
@@ -1667,7 +2438,6 @@ static bStatus_t gapBondMgrEraseAllBondings( void )
 static bStatus_t gapBondMgrEraseBonding( uint8 idx )
 {
   bStatus_t ret;
-  gapBondRec_t bondRec;
 
   if ( idx == bondIdx )
   {
@@ -1678,28 +2448,22 @@ static bStatus_t gapBondMgrEraseBonding( uint8 idx )
     gapBondFreeAuthEvt();
   }
   
-  // First see if bonding record exists in NV, then write all 0xFF's to it
-  if ( ( osal_snv_read( mainRecordNvID(idx), sizeof ( gapBondRec_t ), &bondRec ) == SUCCESS )
-       && (osal_isbufset( bondRec.publicAddr, 0xFF, B_ADDR_LEN ) == FALSE) )
+  // First see if the bonding entry is used, then write all 0xFF's to it
+  if ( bondUse[idx] != 0 )
   {
-    gapBondLTK_t ltk;
-    gapBondCharCfg_t charCfg[GAP_CHAR_CFG_MAX];
+    gapBondNvRec_t bondRec;
+    gapBondCfg_t cfg;
 
-    VOID osal_memset( &bondRec, 0xFF, sizeof ( gapBondRec_t ) );
-    VOID osal_memset( &ltk, 0xFF, sizeof ( gapBondLTK_t ) );
-
-    VOID osal_memset( charCfg, 0xFF, sizeof ( charCfg ) );
+    VOID osal_memset( &bondRec, 0xFF, sizeof ( gapBondNvRec_t ) );
+    VOID osal_memset( &cfg, 0xFF, sizeof ( gapBondCfg_t ) );
 
     // Write out FF's over the entire bond entry.
-    ret = osal_snv_write( mainRecordNvID(idx), sizeof ( gapBondRec_t ), &bondRec );
-    ret |= osal_snv_write( localLTKNvID(idx), sizeof ( gapBondLTK_t ), &ltk );
-    ret |= osal_snv_write( devLTKNvID(idx), sizeof ( gapBondLTK_t ), &ltk );
-    ret |= osal_snv_write( devIRKNvID(idx), KEYLEN, ltk.LTK );
-    ret |= osal_snv_write( devCSRKNvID(idx), KEYLEN, ltk.LTK );
-    ret |= osal_snv_write( devSignCounterNvID(idx), sizeof ( uint32 ), ltk.LTK );
+    ret = gapBondMgrWriteRec( idx, &bondRec );
+    ret |= gapBondMgrWriteCfg( idx, &cfg );
 
-    // Write out FF's over the charactersitic configuration entry.
-    ret |= osal_snv_write( gattCfgNvID(idx), sizeof ( charCfg ), charCfg );
+    // Free the entry in the Bond Table and the Bond RAM Shadow
+    gapBondMgrFreeBond( idx );
+    ret |= gapBondMgrSaveTable();
   }
   else
   {
@@ -1835,41 +2599,26 @@ uint8 GAPBondMgr_CheckNVLen( uint8 id, uint8 len )
 {
   uint8 stat = FAILURE;
 
-  // Convert to index
-  switch ( (id - BLE_NVID_GAP_BOND_START) % GAP_BOND_REC_IDS )
+  if ( ( id >= BLE_NVID_GAP_BOND_START ) && ( id <= BLE_NVID_GAP_BOND_END ) )
   {
-    case GAP_BOND_REC_ID_OFFSET:
-      if ( len == sizeof ( gapBondRec_t ) )
-      {
-        stat = SUCCESS;
-      }
-      break;
-
-    case GAP_BOND_LOCAL_LTK_OFFSET:
-    case GAP_BOND_DEV_LTK_OFFSET:
-      if ( len == sizeof ( gapBondLTK_t ) )
-      {
-        stat = SUCCESS;
-      }
-      break;
-
-    case GAP_BOND_DEV_IRK_OFFSET:
-    case GAP_BOND_DEV_CSRK_OFFSET:
-      if ( len == KEYLEN )
-      {
-        stat = SUCCESS;
-      }
-      break;
-
-    case GAP_BOND_DEV_SIGN_COUNTER_OFFSET:
-      if ( len == sizeof ( uint32 ) )
-      {
-        stat = SUCCESS;
-      }
-      break;
-
-    default:
-      break;
+    if ( len == sizeof ( gapBondNvRec_t ) )
+    {
+      stat = SUCCESS;
+    }
+  }
+  else if ( ( id >= BLE_NVID_GAP_BOND_CFG_START ) && ( id <= BLE_NVID_GAP_BOND_CFG_END ) )
+  {
+    if ( len == sizeof ( gapBondCfg_t ) )
+    {
+      stat = SUCCESS;
+    }
+  }
+  else if ( id == BLE_NVID_GAP_BOND_TABLE )
+  {
+    if ( len == sizeof ( bondUse ) )
+    {
+      stat = SUCCESS;
+    }
   }
 
   return ( stat );
@@ -1922,6 +2671,10 @@ static void gapBondMgr_ProcessGATTServMsg( gattEventHdr_t *pMsg )
       }
       break;
 
+    case GATT_CLIENT_INFO_UPDATED_EVENT:
+      VOID gapBondMgrSaveClientInfo( ((gattClientInfoUpdatedEvent_t *)pMsg)->connHandle );
+      break;
+
     default:
       // Unknown message
       break;
@@ -2057,22 +2810,19 @@ static void gapBondMgrBondReq( uint16 connHandle, uint8 idx, uint8 stateFlags,
                                uint8 role, uint8 startEncryption )
 {
   smSecurityInfo_t ltk;
-  osalSnvId_t      nvId;
+  gapBondNvRec_t   bondRec;
 
-  if ( role == GAP_PROFILE_CENTRAL )
+  if ( gapBondMgrReadRec( idx, &bondRec ) == SUCCESS )
   {
-    nvId = devLTKNvID( idx );
-  }
-  else
-  {
-    nvId = localLTKNvID( idx );
-  }
-
-  // Initialize the NV structures
-  VOID osal_memset( &ltk, 0, sizeof ( smSecurityInfo_t ) );
+    if ( role == GAP_PROFILE_CENTRAL )
+    {
+      VOID osal_memcpy( &ltk, &(bondRec.devLTK), sizeof ( smSecurityInfo_t ) );
+    }
+    else
+    {
+      VOID osal_memcpy( &ltk, &(bondRec.localLTK), sizeof ( smSecurityInfo_t ) );
+    }
 
-  if ( osal_snv_read( nvId, sizeof ( smSecurityInfo_t ), &ltk ) == SUCCESS )
-  {
     if ( (ltk.keySize >= MIN_ENC_KEYSIZE) && (ltk.keySize <= MAX_ENC_KEYSIZE) )
     {
       VOID GAP_Bond( connHandle,
@@ -2107,6 +2857,53 @@ static void gapBondMgr_SyncWhiteList( void )
   }
 }
 
+/*********************************************************************
+ * @fn      gapBondMgr_SyncResolvingList
+ *
+ * @brief   syncronize the controller's Resolving List with the IRKs
+ *          of the bonds, so private addresses of bonded devices are
+ *          resolved by the controller. Bonds beyond the size of the
+ *          Resolving List are still resolved by the host.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void gapBondMgr_SyncResolvingList( void )
+{
+  uint8 localIRK[KEYLEN];
+  uint8 added = FALSE;
+
+  resolvingListDirty = FALSE;
+
+  // The list can't be changed while address resolution is enabled
+  VOID HCI_LE_SetAddressResolutionEnableCmd( FALSE );
+  VOID HCI_LE_ClearResolvingListCmd();
+
+  // No local IRK, the local address is not resolvable
+  VOID osal_memset( localIRK, 0, KEYLEN );
+
+  // Write bond identities into the Resolving List
+  for( uint8 i = 0; i < GAP_BONDINGS_MAX; i++)
+  {
+    // Only bonds that distributed an IRK use resolvable addresses
+    if ( ( bondUse[i] != 0 ) &&
+         ( osal_isbufset( bondIRK[i], 0xFF, KEYLEN ) == FALSE ) )
+    {
+      if ( HCI_LE_AddDevToResolvingListCmd( HCI_PUBLIC_DEVICE_ADDRESS, bonds[i].publicAddr,
+                                            bondIRK[i], localIRK ) == SUCCESS )
+      {
+        added = TRUE;
+      }
+    }
+  }
+
+  if ( added )
+  {
+    VOID HCI_LE_SetAddressResolutionEnableCmd( TRUE );
+  }
+}
+
 /*********************************************************************
  * @fn          gapBondMgr_SyncCharCfg
  *
@@ -2131,6 +2928,11 @@ static uint8 gapBondMgr_SyncCharCfg( uint16 connHandle )
   // for an attribute.
   if ( pAttr == NULL )
   {
+    // The configurations of the CCCD store are saved all at once, so are
+    // the features the client wrote before it bonded
+    VOID gapBondMgrSaveCCCD( connHandle );
+    VOID gapBondMgrSaveClientInfo( connHandle );
+
     pAttr = GATT_FindHandleUUID( GATT_MIN_HANDLE, GATT_MAX_HANDLE,
                                  clientCharCfgUUID, ATT_BT_UUID_SIZE, &service );
   }
@@ -2142,8 +2944,9 @@ static uint8 gapBondMgr_SyncCharCfg( uint16 connHandle )
 
     // It is not possible to use this request on an attribute that has a value
     // that is longer than 2.
-    if ( GATTServApp_ReadAttr( connHandle, pAttr, service, attrVal,
-                               &len, 0, ATT_BT_UUID_SIZE ) == SUCCESS )
+    if ( ( GATTServApp_GetCCCDIdx( pAttr->handle ) == GATT_CCCD_IDX_INVALID ) &&
+         ( GATTServApp_ReadAttr( connHandle, pAttr, service, attrVal,
+                                 &len, 0, ATT_BT_UUID_SIZE ) == SUCCESS ) )
     {
       uint16 value = BUILD_UINT16(attrVal[0], attrVal[1]);
 
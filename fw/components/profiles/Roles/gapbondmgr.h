@@ -33,7 +33,7 @@ extern "C"
  */
 
 #if !defined ( GAP_BONDINGS_MAX )
-  #define GAP_BONDINGS_MAX    10    //!< Maximum number of bonds that can be saved in NV.
+  #define GAP_BONDINGS_MAX    10    //!< Maximum number of bonds that can be saved in NV. A bond takes 12 FS items, see the NV layout in gapbondmgr.c.
 #endif
 
 #if !defined ( GAP_CHAR_CFG_MAX )
@@ -65,6 +65,8 @@ extern "C"
 #define GAPBOND_BOND_COUNT         0x40E  //!< Gets the total number of bonds stored in NV. Read Only. Size is uint8. Default is 0 (no bonds).
 #define GAPBOND_BOND_FAIL_ACTION   0x40F  //!< Possible actions Central may take upon an unsuccessful bonding. Write Only. Size is uint8. Default is 0x02 (Terminate link upon unsuccessful bonding).
 #define GAPBOND_ERASE_SINGLEBOND   0x410  //!< Erase a single bonded device. Write only. Must provide address type followed by device address.
+#define GAPBOND_AUTO_SYNC_RL       0x411  //!< Clears the controller's Resolving List and adds to it the identity address and IRK of each bond in NV. Read/Write. Size is uint8. Default is FALSE.
+#define GAPBOND_LRU_REPLACE        0x412  //!< Replace the least recently used bond when a new bond is saved and all of the bonds are used. Read/Write. Size is uint8. Default is TRUE.
 /** @} End GAPBOND_PROFILE_PARAMETERS */
 
 /** @defgroup GAPBOND_PAIRING_MODE_DEFINES GAP Bond Manager Pairing Modes
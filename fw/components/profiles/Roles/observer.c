@@ -13,6 +13,7 @@
 #include "gap.h"
 
 #include "observer.h"
+#include "observer_gw.h"
 
 /*********************************************************************
  * MACROS
@@ -21,6 +22,12 @@
 /*********************************************************************
  * CONSTANTS
  */
+// Profile Events
+#define GW_FLUSH_EVT                  0x0001  // Output a gateway frame
+
+#define DEFAULT_GW_PERIOD             100     // ms
+#define DEFAULT_GW_RSSI_DELTA         4       // dB
+#define DEFAULT_GW_TIMEOUT            10000   // ms
 
 /*********************************************************************
  * TYPEDEFS
@@ -55,12 +62,19 @@ static gapObserverRoleCB_t *pGapObserverRoleCB;
 
 static uint8  gapObserverRoleBdAddr[B_ADDR_LEN];
 static uint8  gapObserverRoleMaxScanRes = 0;
+static uint8  gapObserverRoleGateway = FALSE;
+static uint16 gapObserverRoleGwPeriod = DEFAULT_GW_PERIOD;
+static uint8  gapObserverRoleGwRssiDelta = DEFAULT_GW_RSSI_DELTA;
+static uint16 gapObserverRoleGwTimeout = DEFAULT_GW_TIMEOUT;
+static uint8  gapObserverRoleScanning = FALSE;  // Between a discovery request and its end
 
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
 static void gapObserverRole_ProcessOSALMsg( osal_event_hdr_t *pMsg );
 static void gapObserverRole_ProcessGAPMsg( gapEventHdr_t *pMsg );
+static void gapObserverRole_GwSetup( void );
+static void gapObserverRole_GwOutput( uint8 *pFrame, uint16 len );
 
 /*********************************************************************
  * PUBLIC FUNCTIONS
@@ -105,11 +119,61 @@ bStatus_t GAPObserverRole_SetParameter( uint16 param, uint8 len, void *pValue )
       }
       break;
 
+    case GAPOBSERVERROLE_GATEWAY:
+      if ( (len == sizeof ( uint8 )) && (*((uint8*)pValue) <= TRUE) )
+      {
+        gapObserverRoleGateway = *((uint8*)pValue);
+      }
+      else
+      {
+        ret = bleInvalidRange;
+      }
+      break;
+
+    case GAPOBSERVERROLE_GW_PERIOD:
+      if ( (len == sizeof ( uint16 )) && (*((uint16*)pValue) > 0) )
+      {
+        gapObserverRoleGwPeriod = *((uint16*)pValue);
+      }
+      else
+      {
+        ret = bleInvalidRange;
+      }
+      break;
+
+    case GAPOBSERVERROLE_GW_RSSI_DELTA:
+      if ( len == sizeof ( uint8 ) )
+      {
+        gapObserverRoleGwRssiDelta = *((uint8*)pValue);
+      }
+      else
+      {
+        ret = bleInvalidRange;
+      }
+      break;
+
+    case GAPOBSERVERROLE_GW_TIMEOUT:
+      if ( (len == sizeof ( uint16 )) && (*((uint16*)pValue) > 0) )
+      {
+        gapObserverRoleGwTimeout = *((uint16*)pValue);
+      }
+      else
+      {
+        ret = bleInvalidRange;
+      }
+      break;
+
     default:
       ret = INVALIDPARAMETER;
       break;
   }
 
+  // Gateway settings apply from a clean start
+  if ( (ret == SUCCESS) && (param != GAPOBSERVERROLE_MAX_SCAN_RES) )
+  {
+    gapObserverRole_GwSetup();
+  }
+
   return ret;
 }
 
@@ -132,6 +196,22 @@ bStatus_t GAPObserverRole_GetParameter( uint16 param, void *pValue )
       *((uint8*)pValue) = gapObserverRoleMaxScanRes;
       break;
 
+    case GAPOBSERVERROLE_GATEWAY:
+      *((uint8*)pValue) = gapObserverRoleGateway;
+      break;
+
+    case GAPOBSERVERROLE_GW_PERIOD:
+      *((uint16*)pValue) = gapObserverRoleGwPeriod;
+      break;
+
+    case GAPOBSERVERROLE_GW_RSSI_DELTA:
+      *((uint8*)pValue) = gapObserverRoleGwRssiDelta;
+      break;
+
+    case GAPOBSERVERROLE_GW_TIMEOUT:
+      *((uint16*)pValue) = gapObserverRoleGwTimeout;
+      break;
+
     default:
       ret = INVALIDPARAMETER;
       break;
@@ -148,13 +228,27 @@ bStatus_t GAPObserverRole_GetParameter( uint16 param, void *pValue )
 bStatus_t GAPObserverRole_StartDiscovery( uint8 mode, uint8 activeScan, uint8 whiteList )
 {
   gapDevDiscReq_t params;
+  bStatus_t ret;
 
   params.taskID = gapObserverRoleTaskId;
   params.mode = mode;
   params.activeScan = activeScan;
   params.whiteList = whiteList;
 
-  return GAP_DeviceDiscoveryRequest( &params );
+  ret = GAP_DeviceDiscoveryRequest( &params );
+
+  // The gateway frames are flushed every period while scanning
+  if ( ret == SUCCESS )
+  {
+    gapObserverRoleScanning = TRUE;
+
+    if ( gapObserverRoleGateway )
+    {
+      VOID osal_start_reload_timer( gapObserverRoleTaskId, GW_FLUSH_EVT, gapObserverRoleGwPeriod );
+    }
+  }
+
+  return ret;
 }
 
 /**
@@ -208,6 +302,16 @@ uint16 GAPObserverRole_ProcessEvent( uint8 taskId, uint16 events )
     return (events ^ SYS_EVENT_MSG);
   }
 
+  if ( events & GW_FLUSH_EVT )
+  {
+    if ( gapObserverRoleGateway )
+    {
+      ObserverGw_Flush( osal_GetSystemClock() );
+    }
+
+    return ( events ^ GW_FLUSH_EVT );
+  }
+
   // Discard unknown events
   return 0;
 }
@@ -266,6 +370,31 @@ static void gapObserverRole_ProcessGAPMsg( gapEventHdr_t *pMsg )
       }
       break;
 
+    case GAP_DEVICE_INFO_EVENT:
+      if ( gapObserverRoleGateway )
+      {
+        gapDeviceInfoEvent_t *pPkt = (gapDeviceInfoEvent_t *) pMsg;
+
+        // The gateway passes on only what changed, in frames
+        ObserverGw_Report( (pPkt->eventType == GAP_ADRPT_SCAN_RSP), pPkt->addrType,
+                           pPkt->addr, pPkt->rssi, pPkt->dataLen, pPkt->pEvtData,
+                           osal_GetSystemClock() );
+        return;
+      }
+      break;
+
+    case GAP_DEVICE_DISCOVERY_EVENT:
+      if ( gapObserverRoleGateway )
+      {
+        // Don't hold back the end of the scan until the next period
+        ObserverGw_Flush( osal_GetSystemClock() );
+      }
+
+      // Nothing more to flush until the next scan
+      gapObserverRoleScanning = FALSE;
+      VOID osal_stop_timerEx( gapObserverRoleTaskId, GW_FLUSH_EVT );
+      break;
+
     default:
       break;
   }
@@ -277,5 +406,51 @@ static void gapObserverRole_ProcessGAPMsg( gapEventHdr_t *pMsg )
   }
 }
 
+/*********************************************************************
+ * @fn      gapObserverRole_GwSetup
+ *
+ * @brief   Start the gateway over with the current settings, or stop it.
+ *          Its frames are flushed every period while a scan runs.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void gapObserverRole_GwSetup( void )
+{
+  if ( gapObserverRoleGateway )
+  {
+    ObserverGw_Reset( gapObserverRole_GwOutput, gapObserverRoleGwRssiDelta,
+                      gapObserverRoleGwTimeout );
+  }
+
+  if ( gapObserverRoleGateway && gapObserverRoleScanning )
+  {
+    VOID osal_start_reload_timer( gapObserverRoleTaskId, GW_FLUSH_EVT, gapObserverRoleGwPeriod );
+  }
+  else
+  {
+    VOID osal_stop_timerEx( gapObserverRoleTaskId, GW_FLUSH_EVT );
+  }
+}
+
+/*********************************************************************
+ * @fn      gapObserverRole_GwOutput
+ *
+ * @brief   Pass a gateway frame to the app.
+ *
+ * @param   pFrame - frame
+ * @param   len - length of the frame
+ *
+ * @return  none
+ */
+static void gapObserverRole_GwOutput( uint8 *pFrame, uint16 len )
+{
+  if ( pGapObserverRoleCB && pGapObserverRoleCB->gatewayCB )
+  {
+    pGapObserverRoleCB->gatewayCB( pFrame, len );
+  }
+}
+
 /*********************************************************************
 *********************************************************************/
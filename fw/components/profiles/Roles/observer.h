@@ -26,6 +26,10 @@ extern "C"
  */
 #define GAPOBSERVERROLE_BD_ADDR        0x400  //!< Device's Address. Read Only. Size is uint8[B_ADDR_LEN]. This item is read from the controller.
 #define GAPOBSERVERROLE_MAX_SCAN_RES   0x401  //!< Maximum number of discover scan results to receive. Default is 0 = unlimited.
+#define GAPOBSERVERROLE_GATEWAY        0x402  //!< Fold device information events into gateway frames instead of passing each one to the app. Read/Write. Size is uint8. Default is FALSE.
+#define GAPOBSERVERROLE_GW_PERIOD      0x403  //!< Gateway frame output period in ms. Read/Write. Size is uint16. Default is 100.
+#define GAPOBSERVERROLE_GW_RSSI_DELTA  0x404  //!< Change of the average RSSI in dB that the gateway reports. Read/Write. Size is uint8. Default is 4.
+#define GAPOBSERVERROLE_GW_TIMEOUT     0x405  //!< Time in ms after which the gateway reports a device that isn't seen as lost. Read/Write. Size is uint16. Default is 10000.
 /** @} End GAPOBSERVERROLE_PROFILE_PARAMETERS */
 
 /*********************************************************************
@@ -68,6 +72,16 @@ typedef void (*pfnGapObserverRoleEventCB_t)
   gapObserverRoleEvent_t *pEvent         //!< Pointer to event structure.
 );
 
+/**
+ * Gateway Frame Callback Function, see observer_gw.h for the frame.
+ * Typically sends the frame on the UART.
+ */
+typedef void (*pfnGapObserverRoleGwCB_t)
+(
+  uint8 *pFrame,                        //!< Frame, valid until the next frame.
+  uint16 len                            //!< Length of the frame.
+);
+
 /**
  * Observer Callback Structure
  */
@@ -75,6 +89,7 @@ typedef struct
 {
   pfnGapObserverRoleRssiCB_t   rssiCB;   //!< RSSI callback.
   pfnGapObserverRoleEventCB_t  eventCB;  //!< Event callback.
+  pfnGapObserverRoleGwCB_t     gatewayCB; //!< Gateway frame callback.
 } gapObserverRoleCB_t;
 
 /*********************************************************************
@@ -0,0 +1,486 @@
+/**************************************************************************************************
+*******
+**************************************************************************************************/
+
+/*
+Gateway pipeline of the Observer Profile, see observer_gw.h.
+
+Advertising reports are folded into a table of devices, open addressing
+with linear probing keyed by address and address type. Each entry keeps a
+hash of the last advertising and scan response data, the running RSSI
+average and the time the device was last seen. Only new devices and
+changed data are added to the output frame as they arrive; RSSI changes
+and lost devices are added when the frame is flushed.
+*/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "OSAL.h"
+#include "crc16.h"
+
+#include "observer_gw.h"
+
+/*********************************************************************
+ * MACROS
+ */
+
+#define OBSGW_TABLE_MASK            ( OBSGW_TABLE_SIZE - 1 )
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+#if ( OBSGW_TABLE_SIZE > 256 ) || ( OBSGW_TABLE_SIZE & OBSGW_TABLE_MASK )
+  #error "OBSGW_TABLE_SIZE must be a power of 2, at most 256"
+#endif
+
+#if ( OBSGW_FRAME_SIZE < OBSGW_FRAME_HDR_SIZE + OBSGW_REC_HDR_SIZE + OBSGW_DATA_MAX + OBSGW_CRC_SIZE )
+  #error "OBSGW_FRAME_SIZE doesn't fit a record with data"
+#endif
+
+// Probing ends at a free entry, so the table is never filled up
+#define OBSGW_DEVICES_MAX           ( OBSGW_TABLE_SIZE - OBSGW_TABLE_SIZE / 4 )
+
+// Device entry state
+#define OBSGW_ST_FREE               0x00
+#define OBSGW_ST_USED               0x01
+#define OBSGW_ST_ADV                0x02  // advHash is valid
+#define OBSGW_ST_RSP                0x04  // rspHash is valid
+#define OBSGW_ST_LOST               0x08  // To be removed
+
+// 32-bit FNV-1a
+#define OBSGW_FNV_BASIS             0x811C9DC5
+#define OBSGW_FNV_PRIME             0x01000193
+
+#define OBSGW_AGE_UNIT              10    // ms
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint8  state;                 // OBSGW_ST_xxx
+  uint8  addrType;
+  uint8  addr[OBSGW_ADDR_LEN];
+  int16  rssiAvg;               // dBm, 4 fractional bits
+  int8   rssiSent;              // Last RSSI output
+  uint32 lastSeen;
+  uint32 advHash;
+  uint32 rspHash;
+} obsGwDev_t;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static obsGwDev_t obsGwDevs[OBSGW_TABLE_SIZE];
+
+static pfnObserverGwOutput_t obsGwOutputCB = NULL;
+static uint8  obsGwRssiDelta;
+static uint16 obsGwTimeout;
+
+// Output frames, one is filled while the other one may still be sent
+static uint8  obsGwFrame[2][OBSGW_FRAME_SIZE];
+static uint8  obsGwFrameIdx;
+static uint16 obsGwFrameLen;
+static uint8  obsGwFrameRecs;
+static uint8  obsGwFrameSeq;
+static uint8  obsGwFrameDropped;
+
+static obsGwStats_t obsGwStats;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static uint32 obsGwHash( uint32 hash, uint8 *pBuf, uint8 len );
+static uint8 obsGwHome( uint8 addrType, uint8 *pAddr );
+static uint8 obsGwFind( uint8 addrType, uint8 *pAddr );
+static void obsGwRemove( uint8 idx );
+static int8 obsGwRssi( obsGwDev_t *pDev );
+static void obsGwAddRecord( obsGwDev_t *pDev, uint8 flags, uint8 dataLen, uint8 *pData, uint32 now );
+static void obsGwOutput( uint32 now );
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/**
+ * @brief   Forget all devices and start over.
+ *
+ * Public function defined in observer_gw.h.
+ */
+void ObserverGw_Reset( pfnObserverGwOutput_t pfnOutput, uint8 rssiDelta, uint16 timeout )
+{
+  VOID osal_memset( obsGwDevs, 0, sizeof ( obsGwDevs ) );
+  VOID osal_memset( &obsGwStats, 0, sizeof ( obsGwStats ) );
+
+  obsGwOutputCB = pfnOutput;
+  obsGwRssiDelta = rssiDelta;
+  obsGwTimeout = timeout;
+
+  obsGwFrameLen = OBSGW_FRAME_HDR_SIZE;
+  obsGwFrameRecs = 0;
+  obsGwFrameDropped = 0;
+}
+
+/**
+ * @brief   Take one advertising report.
+ *
+ * Public function defined in observer_gw.h.
+ */
+void ObserverGw_Report( uint8 scanRsp, uint8 addrType, uint8 *pAddr, int8 rssi,
+                        uint8 dataLen, uint8 *pData, uint32 now )
+{
+  obsGwDev_t *pDev;
+  uint32 *pHash;
+  uint32 hash;
+  uint8 flags = 0;
+
+  obsGwStats.reports++;
+
+  pDev = &obsGwDevs[obsGwFind( addrType, pAddr )];
+
+  if ( pDev->state == OBSGW_ST_FREE )
+  {
+    if ( obsGwStats.devices >= OBSGW_DEVICES_MAX )
+    {
+      obsGwStats.dropped++;
+
+      if ( obsGwFrameDropped < 0xFF )
+      {
+        obsGwFrameDropped++;
+      }
+
+      return;
+    }
+
+    obsGwStats.devices++;
+
+    pDev->state = OBSGW_ST_USED;
+    pDev->addrType = addrType;
+    VOID osal_memcpy( pDev->addr, pAddr, OBSGW_ADDR_LEN );
+    pDev->rssiAvg = (int16)rssi << 4;
+
+    flags = OBSGW_REC_NEW;
+  }
+  else
+  {
+    // Arithmetic shift, the average moves by a fraction of the difference
+    pDev->rssiAvg += ( ( (int16)rssi << 4 ) - pDev->rssiAvg ) >> OBSGW_RSSI_SHIFT;
+  }
+
+  pDev->lastSeen = now;
+
+  // Advertising and scan response data of a device alternate in an active
+  // scan, each is compared against its own last value
+  if ( dataLen > OBSGW_DATA_MAX )
+  {
+    dataLen = OBSGW_DATA_MAX;
+  }
+
+  hash = obsGwHash( OBSGW_FNV_BASIS, pData, dataLen );
+  pHash = scanRsp ? &(pDev->rspHash) : &(pDev->advHash);
+
+  if ( !( pDev->state & ( scanRsp ? OBSGW_ST_RSP : OBSGW_ST_ADV ) ) || ( *pHash != hash ) )
+  {
+    pDev->state |= scanRsp ? OBSGW_ST_RSP : OBSGW_ST_ADV;
+    *pHash = hash;
+
+    flags |= scanRsp ? ( OBSGW_REC_DATA | OBSGW_REC_SCAN_RSP ) : OBSGW_REC_DATA;
+  }
+
+  if ( flags )
+  {
+    obsGwAddRecord( pDev, flags, dataLen, pData, now );
+  }
+}
+
+/**
+ * @brief   Add the RSSI changes and lost devices and output the frame.
+ *
+ * Public function defined in observer_gw.h.
+ */
+void ObserverGw_Flush( uint32 now )
+{
+  uint16 idx;
+
+  for ( idx = 0; idx < OBSGW_TABLE_SIZE; idx++ )
+  {
+    obsGwDev_t *pDev = &obsGwDevs[idx];
+
+    if ( pDev->state == OBSGW_ST_FREE )
+    {
+      continue;
+    }
+
+    if ( ( now - pDev->lastSeen ) >= obsGwTimeout )
+    {
+      obsGwAddRecord( pDev, OBSGW_REC_LOST, 0, NULL, now );
+      pDev->state |= OBSGW_ST_LOST;
+    }
+    else
+    {
+      int16 diff = obsGwRssi( pDev ) - pDev->rssiSent;
+
+      if ( diff < 0 )
+      {
+        diff = -diff;
+      }
+
+      if ( ( diff != 0 ) && ( diff >= obsGwRssiDelta ) )
+      {
+        obsGwAddRecord( pDev, OBSGW_REC_RSSI, 0, NULL, now );
+      }
+    }
+  }
+
+  // Removing shifts later entries back, so the same index is checked again
+  for ( idx = 0; idx < OBSGW_TABLE_SIZE; )
+  {
+    if ( obsGwDevs[idx].state & OBSGW_ST_LOST )
+    {
+      obsGwRemove( (uint8)idx );
+    }
+    else
+    {
+      idx++;
+    }
+  }
+
+  obsGwOutput( now );
+}
+
+/**
+ * @brief   Get the gateway counters.
+ *
+ * Public function defined in observer_gw.h.
+ */
+void ObserverGw_GetStats( obsGwStats_t *pStats )
+{
+  VOID osal_memcpy( pStats, &obsGwStats, sizeof ( obsGwStats_t ) );
+}
+
+/*********************************************************************
+ * @fn      obsGwHash
+ *
+ * @brief   Continue a 32-bit FNV-1a hash over a buffer.
+ *
+ * @param   hash - hash so far, OBSGW_FNV_BASIS to start
+ * @param   pBuf - data
+ * @param   len - length of data
+ *
+ * @return  hash
+ */
+static uint32 obsGwHash( uint32 hash, uint8 *pBuf, uint8 len )
+{
+  while ( len-- )
+  {
+    hash = ( hash ^ *pBuf++ ) * OBSGW_FNV_PRIME;
+  }
+
+  return ( hash );
+}
+
+/*********************************************************************
+ * @fn      obsGwHome
+ *
+ * @brief   First table entry to probe for a device.
+ *
+ * @param   addrType - address type
+ * @param   pAddr - device address
+ *
+ * @return  table index
+ */
+static uint8 obsGwHome( uint8 addrType, uint8 *pAddr )
+{
+  uint32 hash = obsGwHash( OBSGW_FNV_BASIS ^ addrType, pAddr, OBSGW_ADDR_LEN );
+
+  return ( (uint8)( ( hash ^ ( hash >> 16 ) ) & OBSGW_TABLE_MASK ) );
+}
+
+/*********************************************************************
+ * @fn      obsGwFind
+ *
+ * @brief   Look up a device in the table.
+ *
+ * @param   addrType - address type
+ * @param   pAddr - device address
+ *
+ * @return  index of the device, or of the free entry to add it in
+ */
+static uint8 obsGwFind( uint8 addrType, uint8 *pAddr )
+{
+  uint8 idx = obsGwHome( addrType, pAddr );
+
+  while ( obsGwDevs[idx].state != OBSGW_ST_FREE )
+  {
+    if ( ( obsGwDevs[idx].addrType == addrType ) &&
+         ( osal_memcmp( obsGwDevs[idx].addr, pAddr, OBSGW_ADDR_LEN ) ) )
+    {
+      return ( idx ); // Found it
+    }
+
+    idx = ( idx + 1 ) & OBSGW_TABLE_MASK;
+  }
+
+  return ( idx );
+}
+
+/*********************************************************************
+ * @fn      obsGwRemove
+ *
+ * @brief   Remove a device from the table. The following entries of the
+ *          probe sequence are shifted back over it, so that no probe
+ *          ends early.
+ *
+ * @param   idx - index of the device
+ *
+ * @return  none
+ */
+static void obsGwRemove( uint8 idx )
+{
+  uint8 next = idx;
+
+  for ( ;; )
+  {
+    uint8 home;
+
+    next = ( next + 1 ) & OBSGW_TABLE_MASK;
+
+    if ( obsGwDevs[next].state == OBSGW_ST_FREE )
+    {
+      break;
+    }
+
+    // The entry may move back if the hole is between its home and itself
+    home = obsGwHome( obsGwDevs[next].addrType, obsGwDevs[next].addr );
+
+    if ( ( ( next - home ) & OBSGW_TABLE_MASK ) >= ( ( next - idx ) & OBSGW_TABLE_MASK ) )
+    {
+      obsGwDevs[idx] = obsGwDevs[next];
+      idx = next;
+    }
+  }
+
+  obsGwDevs[idx].state = OBSGW_ST_FREE;
+  obsGwStats.devices--;
+}
+
+/*********************************************************************
+ * @fn      obsGwRssi
+ *
+ * @brief   Average RSSI of a device, rounded to dBm.
+ *
+ * @param   pDev - device
+ *
+ * @return  RSSI
+ */
+static int8 obsGwRssi( obsGwDev_t *pDev )
+{
+  return ( (int8)( ( pDev->rssiAvg + 8 ) >> 4 ) );
+}
+
+/*********************************************************************
+ * @fn      obsGwAddRecord
+ *
+ * @brief   Add a record to the frame, the frame is output first if it
+ *          is too full.
+ *
+ * @param   pDev - device
+ * @param   flags - OBSGW_REC_xxx
+ * @param   dataLen - length of pData
+ * @param   pData - data for OBSGW_REC_DATA
+ * @param   now - system clock, ms
+ *
+ * @return  none
+ */
+static void obsGwAddRecord( obsGwDev_t *pDev, uint8 flags, uint8 dataLen, uint8 *pData, uint32 now )
+{
+  uint8 *pRec;
+  uint32 age;
+
+  if ( ( obsGwFrameLen + OBSGW_REC_HDR_SIZE + dataLen + OBSGW_CRC_SIZE > OBSGW_FRAME_SIZE ) ||
+       ( obsGwFrameRecs == 0xFF ) )
+  {
+    obsGwOutput( now );
+  }
+
+  age = ( now - pDev->lastSeen ) / OBSGW_AGE_UNIT;
+
+  pDev->rssiSent = obsGwRssi( pDev );
+
+  pRec = &obsGwFrame[obsGwFrameIdx][obsGwFrameLen];
+  pRec[0] = flags;
+  pRec[1] = pDev->addrType;
+  VOID osal_memcpy( &pRec[2], pDev->addr, OBSGW_ADDR_LEN );
+  pRec[8] = (uint8)pDev->rssiSent;
+  pRec[9] = ( age > 0xFF ) ? 0xFF : (uint8)age;
+  pRec[10] = dataLen;
+
+  if ( dataLen )
+  {
+    VOID osal_memcpy( &pRec[OBSGW_REC_HDR_SIZE], pData, dataLen );
+  }
+
+  obsGwFrameLen += OBSGW_REC_HDR_SIZE + dataLen;
+  obsGwFrameRecs++;
+  obsGwStats.records++;
+}
+
+/*********************************************************************
+ * @fn      obsGwOutput
+ *
+ * @brief   Complete the frame and output it, then start the next one in
+ *          the other frame buffer. Nothing is output if there is nothing
+ *          to tell.
+ *
+ * @param   now - system clock, ms
+ *
+ * @return  none
+ */
+static void obsGwOutput( uint32 now )
+{
+  uint8 *pFrame = obsGwFrame[obsGwFrameIdx];
+  uint16 len = obsGwFrameLen - OBSGW_FRAME_HDR_SIZE;
+  uint16 crc;
+
+  if ( ( obsGwFrameRecs == 0 ) && ( obsGwFrameDropped == 0 ) )
+  {
+    return;
+  }
+
+  pFrame[0] = OBSGW_SYNC;
+  pFrame[1] = obsGwFrameSeq++;
+  pFrame[2] = obsGwFrameRecs;
+  pFrame[3] = obsGwFrameDropped;
+  pFrame[4] = BREAK_UINT32( now, 0 );
+  pFrame[5] = BREAK_UINT32( now, 1 );
+  pFrame[6] = BREAK_UINT32( now, 2 );
+  pFrame[7] = BREAK_UINT32( now, 3 );
+  pFrame[8] = LO_UINT16( len );
+  pFrame[9] = HI_UINT16( len );
+
+  crc = crc16( 0, pFrame, obsGwFrameLen );
+  pFrame[obsGwFrameLen] = LO_UINT16( crc );
+  pFrame[obsGwFrameLen + 1] = HI_UINT16( crc );
+
+  len = obsGwFrameLen + OBSGW_CRC_SIZE;
+
+  obsGwFrameIdx ^= 1;
+  obsGwFrameLen = OBSGW_FRAME_HDR_SIZE;
+  obsGwFrameRecs = 0;
+  obsGwFrameDropped = 0;
+
+  obsGwStats.frames++;
+  obsGwStats.bytes += len;
+
+  if ( obsGwOutputCB )
+  {
+    obsGwOutputCB( pFrame, len );
+  }
+}
+
+/*********************************************************************
+*********************************************************************/
@@ -0,0 +1,159 @@
+/**************************************************************************************************
+*******
+**************************************************************************************************/
+
+#ifndef OBSERVER_GW_H
+#define OBSERVER_GW_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "comdef.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Number of entries of the device table, must be a power of 2.
+// At most 3/4 of them are used, reports of further devices are dropped.
+#ifndef OBSGW_TABLE_SIZE
+  #define OBSGW_TABLE_SIZE          64
+#endif
+
+// Size of one output frame, two frames are kept
+#ifndef OBSGW_FRAME_SIZE
+  #define OBSGW_FRAME_SIZE          256
+#endif
+
+// Weight of a new RSSI sample in the average, 1/2^OBSGW_RSSI_SHIFT
+#define OBSGW_RSSI_SHIFT            3
+
+#define OBSGW_ADDR_LEN              6     // B_ADDR_LEN
+#define OBSGW_DATA_MAX              31    // Advertising or scan response data
+
+/*
+Output frame, all fields little endian:
+
+header, 10 bytes:
+  sync      1   OBSGW_SYNC
+  seq       1   frame sequence number
+  count     1   number of records
+  dropped   1   reports dropped since the previous frame, saturates at 255
+  time      4   system clock at the frame, ms
+  len       2   length of the records
+
+records, OBSGW_REC_HDR_SIZE bytes each plus their data:
+  flags     1   OBSGW_REC_xxx
+  addrType  1   address type of the device
+  addr      6   address of the device
+  rssi      1   average RSSI, dBm
+  age       1   time since the device was last seen, 10 ms units, saturates
+  dataLen   1   length of data, 0 unless OBSGW_REC_DATA
+  data      dataLen
+
+crc16 of header and records, 2 bytes
+*/
+#define OBSGW_SYNC                  0xA7
+#define OBSGW_FRAME_HDR_SIZE        10
+#define OBSGW_REC_HDR_SIZE          11
+#define OBSGW_CRC_SIZE              2
+
+// Record flags
+#define OBSGW_REC_NEW               0x01  // First report of the device
+#define OBSGW_REC_DATA              0x02  // Changed advertising or scan response data
+#define OBSGW_REC_SCAN_RSP          0x04  // data is scan response data
+#define OBSGW_REC_RSSI              0x08  // Average RSSI moved by at least the RSSI delta
+#define OBSGW_REC_LOST              0x10  // Not seen for the timeout, the device is forgotten
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+/**
+ * Frame output function, the frame stays valid until the next frame
+ * has been output.
+ */
+typedef void (*pfnObserverGwOutput_t)
+(
+  uint8 *pFrame,                        //!< Frame, see above.
+  uint16 len                            //!< Length of the frame.
+);
+
+/**
+ * Gateway counters, since ObserverGw_Reset
+ */
+typedef struct
+{
+  uint32 reports;                       //!< Reports received.
+  uint32 records;                       //!< Records output.
+  uint32 dropped;                       //!< Reports dropped, table full.
+  uint32 frames;                        //!< Frames output.
+  uint32 bytes;                         //!< Bytes output.
+  uint8  devices;                       //!< Devices in the table.
+} obsGwStats_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/**
+ * @brief   Forget all devices and start over.
+ *
+ * @param   pfnOutput - frame output function
+ * @param   rssiDelta - RSSI change in dB that is reported, 0 to report
+ *                      every change
+ * @param   timeout - ms after which a device that isn't seen is lost
+ *
+ * @return  none
+ */
+extern void ObserverGw_Reset( pfnObserverGwOutput_t pfnOutput, uint8 rssiDelta, uint16 timeout );
+
+/**
+ * @brief   Take one advertising report. A record is only added to the
+ *          frame if the device is new or its data changed.
+ *
+ * @param   scanRsp - TRUE for a scan response
+ * @param   addrType - address type
+ * @param   pAddr - device address
+ * @param   rssi - RSSI of the report
+ * @param   dataLen - length of pData
+ * @param   pData - advertising or scan response data
+ * @param   now - system clock, ms
+ *
+ * @return  none
+ */
+extern void ObserverGw_Report( uint8 scanRsp, uint8 addrType, uint8 *pAddr, int8 rssi,
+                               uint8 dataLen, uint8 *pData, uint32 now );
+
+/**
+ * @brief   Add the RSSI changes and lost devices to the frame and output
+ *          it, called at the output cadence.
+ *
+ * @param   now - system clock, ms
+ *
+ * @return  none
+ */
+extern void ObserverGw_Flush( uint32 now );
+
+/**
+ * @brief   Get the gateway counters.
+ *
+ * @param   pStats - a place to put them
+ *
+ * @return  none
+ */
+extern void ObserverGw_GetStats( obsGwStats_t *pStats );
+
+/*********************************************************************
+*********************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OBSERVER_GW_H */
@@ -80,7 +80,6 @@ static uint8 scanIntervalWindow[SCAN_INTERVAL_WINDOW_CHAR_LEN];
 // Scan Parameter Refresh characteristic
 static uint8 scanParamRefreshProps = GATT_PROP_NOTIFY;
 static uint8 scanParamRefresh[SCAN_PARAM_REFRESH_LEN];
-static gattCharCfg_t scanParamRefreshClientCharCfg[GATT_MAX_NUM_CONN];
 
 /*********************************************************************
  * Profile Attributes - Table
@@ -133,7 +132,7 @@ static gattAttribute_t scanParamAttrTbl[] =
         { ATT_BT_UUID_SIZE, clientCharCfgUUID },
         GATT_PERMIT_READ | GATT_PERMIT_ENCRYPT_WRITE,
         0,
-        (uint8 *) &scanParamRefreshClientCharCfg
+        GATT_CCCD( GATT_CCCD_SCAN_REFRESH )
       }
 };
 
@@ -185,9 +184,6 @@ bStatus_t ScanParam_AddService( void )
 {
   uint8 status = SUCCESS;
 
-  // Initialize Client Characteristic Configuration attributes
-  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, scanParamRefreshClientCharCfg );
-
   // Register GATT attribute list and CBs with GATT Server App
   status = GATTServApp_RegisterService( scanParamAttrTbl, GATT_NUM_ATTRS( scanParamAttrTbl ),
                                         &scanParamCBs );
@@ -287,7 +283,7 @@ void ScanParam_RefreshNotify( uint16 connHandle )
   attHandleValueNoti_t  noti;
   uint16 value;
 
-  value  = GATTServApp_ReadCharCfg( connHandle, scanParamRefreshClientCharCfg );
+  value  = GATTServApp_ReadCCCD( connHandle, GATT_CCCD_SCAN_REFRESH );
 
   if ( value & GATT_CLIENT_CFG_NOTIFY )
   {
@@ -405,7 +401,7 @@ void ScanParam_HandleConnStatusCB( uint16 connHandle, uint8 changeType )
          ( ( changeType == LINKDB_STATUS_UPDATE_STATEFLAGS ) &&
            ( !linkDB_Up( connHandle ) ) ) )
     {
-      GATTServApp_InitCharCfg( connHandle, scanParamRefreshClientCharCfg );
+      VOID GATTServApp_WriteCCCD( connHandle, GATT_CCCD_SCAN_REFRESH, GATT_CFG_NO_OPERATION );
     }
   }
 }
@@ -339,8 +339,8 @@ bStatus_t HeartRate_MeasNotify( uint16 connHandle, attHandleValueNoti_t *pNoti )
     // Set the handle
     pNoti->handle = heartRateAttrTbl[HEARTRATE_MEAS_VALUE_POS].handle;
   
-    // Send the notification
-    return GATT_Notification( connHandle, pNoti, FALSE );
+    // Queue the notification, every measurement is sent
+    return GATTServApp_QueueNotification( connHandle, pNoti, 0 );
   }
 
   return bleIncorrectMode;
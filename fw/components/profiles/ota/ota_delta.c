@@ -0,0 +1,226 @@
+/**************************************************************************************************
+*******
+**************************************************************************************************/
+
+
+/*
+Delta partition applier: rebuilds a partition into the erased target bank from
+the base bank plus a patch made by tools/ota_delta.py. The patch can be fed in
+pieces of any size, RAM use is the ota_delta_t context only.
+*/
+
+#include "OSAL.h"
+#include "ota_flash.h"
+#include "ota_delta.h"
+#include "crc16.h"
+#include "error.h"
+
+enum{
+  OTAD_ST_HDR = 0,
+  OTAD_ST_OP,
+  OTAD_ST_ARG,
+  OTAD_ST_INSERT,
+  OTAD_ST_END,
+};
+
+#define OTAD_U16(b) ((uint16_t)(b)[0] | ((uint16_t)(b)[1] << 8))
+#define OTAD_U32(b) ((uint32_t)(b)[0] | ((uint32_t)(b)[1] << 8) | ((uint32_t)(b)[2] << 16) | ((uint32_t)(b)[3] << 24))
+
+static int delta_output(ota_delta_t* pdt, const uint8_t* data, uint32_t size)
+{
+  if(size > pdt->out_size - pdt->wr.offset)
+    return PPlus_ERR_OTA_DATA_SIZE;
+
+  pdt->block_crc = crc16(pdt->block_crc, data, size);
+  return ota_flash_writer_put(&pdt->wr, data, size);
+}
+
+static int delta_header(ota_delta_t* pdt)
+{
+  uint32_t base_size;
+  uint16_t crc = 0;
+
+  if(OTAD_U32(pdt->arg) != OTA_DELTA_MAGIC)
+    return PPlus_ERR_OTA_BAD_DATA;
+
+  pdt->out_size = OTAD_U32(pdt->arg + 4);
+  base_size     = OTAD_U32(pdt->arg + 8);
+  pdt->new_crc  = OTAD_U16(pdt->arg + 14);
+
+  if(base_size > pdt->base_limit || pdt->out_size == 0)
+    return PPlus_ERR_OTA_BAD_DATA;
+  if(pdt->out_size > pdt->wr.limit)
+    return PPlus_ERR_OTA_DATA_SIZE;
+
+  //refuse a patch made against another image before anything is written
+  if(ota_flash_crc16(&crc, pdt->base_addr, base_size) != PPlus_SUCCESS)
+    return PPlus_ERR_OTA_BAD_DATA;
+  if(crc != OTAD_U16(pdt->arg + 12))
+    return PPlus_ERR_OTA_BAD_DATA;
+
+  pdt->state = OTAD_ST_OP;
+  return PPlus_SUCCESS;
+}
+
+static int delta_op(ota_delta_t* pdt)
+{
+  uint32_t src, len;
+
+  pdt->state = OTAD_ST_OP;
+
+  switch(pdt->op){
+  case OTA_DELTA_OP_COPY:
+    src = OTAD_U32(pdt->arg);
+    len = OTAD_U16(pdt->arg + 4);
+    if(src > pdt->base_limit || len > pdt->base_limit - src)
+      return PPlus_ERR_OTA_BAD_DATA;
+    return delta_output(pdt, (const uint8_t*)(pdt->base_addr + src), len);
+
+  case OTA_DELTA_OP_INSERT:
+    pdt->insert_left = OTAD_U16(pdt->arg);
+    if(pdt->insert_left)
+      pdt->state = OTAD_ST_INSERT;
+    return PPlus_SUCCESS;
+
+  case OTA_DELTA_OP_CRC:
+    if(OTAD_U16(pdt->arg) != pdt->block_crc)
+      return PPlus_ERR_OTA_CRC;
+    pdt->block_crc = 0;
+    return PPlus_SUCCESS;
+
+  default:
+    return PPlus_ERR_OTA_BAD_DATA;
+  }
+}
+
+/*********************************************************************
+ * @fn      ota_delta_init
+ *
+ * @brief   Start applying a delta partition.
+ *
+ * @param   pdt        - applier context
+ *          base_addr  - flash address of the bank holding the base image
+ *          base_limit - size of the base bank
+ *          out_addr   - flash address of the partition to rebuild, erased
+ *          out_limit  - room at out_addr
+ *
+ * @return  PPlus_SUCCESS
+ */
+int ota_delta_init(ota_delta_t* pdt, uint32_t base_addr, uint32_t base_limit, uint32_t out_addr, uint32_t out_limit)
+{
+  osal_memset(pdt, 0, sizeof(ota_delta_t));
+  pdt->base_addr  = base_addr;
+  pdt->base_limit = base_limit;
+  pdt->state      = OTAD_ST_HDR;
+  pdt->arg_need   = OTA_DELTA_HDR_SIZE;
+  ota_flash_writer_init(&pdt->wr, out_addr, out_limit);
+  return PPlus_SUCCESS;
+}
+
+/*********************************************************************
+ * @fn      ota_delta_feed
+ *
+ * @brief   Apply the next piece of the patch. Output is programmed as
+ *          soon as OTAF_WRITER_BUF_SIZE bytes are rebuilt.
+ *
+ * @param   pdt  - applier context
+ *          data - patch bytes
+ *          size - number of bytes
+ *
+ * @return  PPlus_SUCCESS, PPlus_ERR_OTA_BAD_DATA on a malformed patch or
+ *          wrong base image, PPlus_ERR_OTA_CRC on a block crc mismatch
+ */
+int ota_delta_feed(ota_delta_t* pdt, const uint8_t* data, uint32_t size)
+{
+  uint32_t n;
+  int ret;
+
+  while(size){
+    switch(pdt->state){
+    case OTAD_ST_HDR:
+    case OTAD_ST_ARG:
+      n = pdt->arg_need - pdt->arg_len;
+      if(n > size)
+        n = size;
+      osal_memcpy(pdt->arg + pdt->arg_len, data, n);
+      pdt->arg_len += n;
+      data += n;
+      size -= n;
+      if(pdt->arg_len < pdt->arg_need)
+        break;
+      ret = (pdt->state == OTAD_ST_HDR) ? delta_header(pdt) : delta_op(pdt);
+      if(ret != PPlus_SUCCESS)
+        return ret;
+      break;
+
+    case OTAD_ST_OP:
+      pdt->op = *data++;
+      size--;
+      pdt->arg_len = 0;
+      pdt->state = OTAD_ST_ARG;
+      if(pdt->op == OTA_DELTA_OP_END)
+        pdt->state = OTAD_ST_END;
+      else if(pdt->op == OTA_DELTA_OP_COPY)
+        pdt->arg_need = 6;
+      else if(pdt->op == OTA_DELTA_OP_INSERT || pdt->op == OTA_DELTA_OP_CRC)
+        pdt->arg_need = 2;
+      else
+        return PPlus_ERR_OTA_BAD_DATA;
+      break;
+
+    case OTAD_ST_INSERT:
+      n = (pdt->insert_left < size) ? pdt->insert_left : size;
+      ret = delta_output(pdt, data, n);
+      if(ret != PPlus_SUCCESS)
+        return ret;
+      pdt->insert_left -= n;
+      data += n;
+      size -= n;
+      if(pdt->insert_left == 0)
+        pdt->state = OTAD_ST_OP;
+      break;
+
+    default:
+      //data after OP_END
+      return PPlus_ERR_OTA_DATA_SIZE;
+    }
+  }
+  return PPlus_SUCCESS;
+}
+
+/*********************************************************************
+ * @fn      ota_delta_finish
+ *
+ * @brief   Program the last bytes and check the rebuilt partition in
+ *          flash against the full image crc of the patch header.
+ *
+ * @param   pdt  - applier context
+ *          size - size of the rebuilt partition
+ *          crc  - crc16 of the rebuilt partition
+ *
+ * @return  PPlus_SUCCESS, PPlus_ERR_OTA_DATA_SIZE if the patch is cut
+ *          short, PPlus_ERR_OTA_CRC if the result does not match
+ */
+int ota_delta_finish(ota_delta_t* pdt, uint32_t* size, uint16_t* crc)
+{
+  uint16_t chk = 0;
+  int ret;
+
+  if(pdt->state != OTAD_ST_END || pdt->wr.offset != pdt->out_size)
+    return PPlus_ERR_OTA_DATA_SIZE;
+
+  ret = ota_flash_writer_flush(&pdt->wr);
+  if(ret != PPlus_SUCCESS)
+    return ret;
+
+  ret = ota_flash_crc16(&chk, pdt->wr.addr, pdt->out_size);
+  if(ret != PPlus_SUCCESS)
+    return ret;
+  if(chk != pdt->new_crc)
+    return PPlus_ERR_OTA_CRC;
+
+  *size = pdt->out_size;
+  *crc = pdt->new_crc;
+  return PPlus_SUCCESS;
+}
+
@@ -0,0 +1,58 @@
+/**************************************************************************************************
+*******
+**************************************************************************************************/
+
+
+#ifndef _OTA_DELTA_H
+#define _OTA_DELTA_H
+
+#include "types.h"
+#include "ota_flash.h"
+
+/*
+Delta partition, generated by tools/ota_delta.py. All fields little endian.
+
+header, 16 bytes:
+  magic     4   OTA_DELTA_MAGIC
+  new_size  4   size of the rebuilt partition
+  base_size 4   length of the base bank covered by base_crc
+  base_crc  2   crc16 of base bank [0, base_size), the image the patch was made from
+  new_crc   2   crc16 of the rebuilt partition
+
+ops, 1 byte opcode and arguments:
+  OTA_DELTA_OP_END                          end of patch
+  OTA_DELTA_OP_COPY   src(4) len(2)         copy len bytes from base bank offset src
+  OTA_DELTA_OP_INSERT len(2) data(len)      literal bytes
+  OTA_DELTA_OP_CRC    crc(2)                crc16 of the output since the previous OP_CRC
+*/
+#define OTA_DELTA_MAGIC         0x544c444f  //"ODLT"
+#define OTA_DELTA_HDR_SIZE      16
+
+#define OTA_DELTA_OP_END        0
+#define OTA_DELTA_OP_COPY       1
+#define OTA_DELTA_OP_INSERT     2
+#define OTA_DELTA_OP_CRC        3
+
+typedef struct{
+  uint32_t  base_addr;    //bank the patch copies from
+  uint32_t  base_limit;   //bank size, copies must stay inside
+  uint32_t  out_size;
+  uint16_t  new_crc;
+  uint16_t  block_crc;    //crc16 of the output since the last OP_CRC
+
+  uint8_t   state;
+  uint8_t   op;
+  uint8_t   arg_len;      //bytes in arg[]
+  uint8_t   arg_need;     //bytes arg[] must hold before the op runs
+  uint8_t   arg[OTA_DELTA_HDR_SIZE];
+  uint32_t  insert_left;  //literal bytes still to come for OP_INSERT
+
+  ota_flash_writer_t wr;  //rebuilt partition
+}ota_delta_t;
+
+int ota_delta_init(ota_delta_t* pdt, uint32_t base_addr, uint32_t base_limit, uint32_t out_addr, uint32_t out_limit);
+int ota_delta_feed(ota_delta_t* pdt, const uint8_t* data, uint32_t size);
+int ota_delta_finish(ota_delta_t* pdt, uint32_t* size, uint16_t* crc);
+
+#endif
+
@@ -3,6 +3,7 @@
 **************************************************************************************************/
 
 
+#include "OSAL.h"
 #include "flash.h"
 #include "ota_flash.h"
 #include "ota_app_service.h"
@@ -11,16 +12,24 @@
 #include "log.h"
 #include "bus_dev.h"
 #include "crc16.h"
+#include "crc_table.h"
 
 bool is_crypto_app(void);
 void flash_load_parition(unsigned char* pflash, int size, unsigned char* run_addr);
 //extern uint16_t $Supper$$crc16(uint16_t seed, const volatile void * p_data, uint32_t size);
 
-uint16_t crc16_table[16] __attribute__((section("ota_app_loader_area"))) =
-{
-		0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
-		0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
-};
+//crc16() runs from the loader area while the application is copied, so it
+//keeps its own table there. The byte table costs 512 bytes of loader RAM,
+//define OTA_LOADER_CRC16_VARIANT as CRC_NIBBLE if that does not fit.
+#ifndef OTA_LOADER_CRC16_VARIANT
+#define OTA_LOADER_CRC16_VARIANT   CRC_TABLE
+#endif
+
+#if (OTA_LOADER_CRC16_VARIANT == CRC_NIBBLE)
+uint16_t ota_crc16_table[16] __attribute__((section("ota_app_loader_area"))) = CRC16_NIBBLE_TABLE;
+#else
+uint16_t ota_crc16_table[256] __attribute__((section("ota_app_loader_area"))) = CRC16_SLICE_T0;
+#endif
 
 uint32_t __attribute__((section("ota_app_loader_area")))  ota_load_flash_addr;
 uint32_t __attribute__((section("ota_app_loader_area")))  ota_load_run_addr;
@@ -30,44 +39,18 @@ uint32_t __attribute__((section("ota_app_loader_area")))  ota_load_crc;
 
 static uint16_t __attribute__((section("ota_app_loader_area"))) crc16_byte(uint16_t crc, uint8_t byte)
 {
-//    static const uint16_t crc16_table[16] =
-//    {
-//        0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
-//        0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
-//    };
-
-    uint16_t temp;
-
-    // Compute checksum of lower four bits of a byte.
-    temp         = crc16_table[crc & 0xF];
-    crc  = (crc >> 4u) & 0x0FFFu;
-    crc  = crc ^ temp ^ crc16_table[byte & 0xF];
-
-    // Now compute checksum of upper four bits of a byte.
-    temp         = crc16_table[crc & 0xF];
-    crc  = (crc >> 4u) & 0x0FFFu;
-    crc  = crc ^ temp ^ crc16_table[(byte >> 4u) & 0xF];
-
+#if (OTA_LOADER_CRC16_VARIANT == CRC_NIBBLE)
+    crc  = (crc >> 4u) ^ ota_crc16_table[(crc ^ byte) & 0xF];
+    crc  = (crc >> 4u) ^ ota_crc16_table[(crc ^ (byte >> 4u)) & 0xF];
     return crc;
+#else
+    return (crc >> 8u) ^ ota_crc16_table[(crc ^ byte) & 0xFF];
+#endif
 }
 
-// uint16_t __attribute__((section("ota_app_loader_area"))) OTA_crc16(uint16_t seed, const volatile void * p_data, uint32_t size)
-//{
-//    uint8_t * p_block = (uint8_t *)p_data;
-
-//    while (size != 0)
-//    { 
-//        seed = crc16_byte(seed, *p_block);
-//        p_block++;
-//        size--;
-//    }
-
-//   return seed;
-//}
- uint16_t __attribute__((section("ota_app_loader_area"))) $Sub$$crc16(uint16_t seed, const volatile void * p_data, uint32_t size)
+uint16_t __attribute__((section("ota_app_loader_area"))) $Sub$$crc16(uint16_t seed, const volatile void * p_data, uint32_t size)
 {
-//	OTA_crc16(seed,p_data,size);
-	uint8_t * p_block = (uint8_t *)p_data;
+    uint8_t * p_block = (uint8_t *)p_data;
 
     while (size != 0)
     { 
@@ -106,13 +89,125 @@ int __attribute__((section("ota_app_loader_area"))) ota_flash_read(uint32_t* des
 
 
 
+/*
+read entry idx of the partition table into ota_load_*, returns PPlus_SUCCESS
+if the partition is copied to RAM, PPlus_ERR_NOT_FOUND if it is skipped
+*/
+static int __attribute__((section("ota_app_loader_area"))) ota_flash_load_entry(int idx)
+{
+  ota_flash_read(&ota_load_flash_addr, OTAF_2nd_BOOTINFO_ADDR + idx*4*4, 4);
+  ota_flash_read(&ota_load_run_addr,   OTAF_2nd_BOOTINFO_ADDR + idx*4*4 + 4,  4);
+  ota_flash_read(&ota_load_size,       OTAF_2nd_BOOTINFO_ADDR + idx*4*4 + 8,  4);
+  ota_flash_read(&ota_load_checksum,   OTAF_2nd_BOOTINFO_ADDR + idx*4*4 + 12, 4);
+
+  //case XIP mode, shoud be in single bank and no fct
+  if(ota_load_run_addr == ota_load_flash_addr)
+  {
+    if(USE_FCT==0 && CFG_OTA_BANK_MODE==OTA_SINGLE_BANK)
+      return PPlus_ERR_NOT_FOUND;
+    else
+      return PPlus_ERR_INVALID_DATA;
+  }
+  if((ota_load_run_addr&0xffff0000) == 0xffff0000)
+    return PPlus_ERR_NOT_FOUND;
+
+  return PPlus_SUCCESS;
+}
+
+#if(CFG_OTA_VERIFY_CADENCE)
+/*
+The verify marker and its count are programmed before the application is
+copied, so these may use the flash driver and live outside the loader area.
+*/
+
+//crc16 of the partition table, which holds the checksum of every partition
+static uint32_t ota_verify_digest(uint32_t partition_num)
+{
+  uint32_t entry[4];
+  uint16_t crc = 0;
+  int i;
+
+  for(i = 0; i < partition_num+1; i++){
+    ota_flash_read(entry, OTAF_2nd_BOOTINFO_ADDR + i*4*4, 16);
+    crc = crc16(crc, entry, 16);
+  }
+  return (uint32_t)crc | ((uint32_t)(uint16_t)~crc << 16);
+}
+
+//first slot never programmed, OTAF_VERIFY_SLOT_NUM if there is none left
+static uint32_t ota_verify_free_slot(void)
+{
+  uint32_t magic;
+  uint32_t slot;
+
+  for(slot = 0; slot < OTAF_VERIFY_SLOT_NUM; slot++){
+    ota_flash_read(&magic, OTAF_VERIFY_SLOT_ADDR(slot), 4);
+    if(magic == 0xffffffff)
+      break;
+  }
+  return slot;
+}
+
+//TRUE if the slot before the free one was written for this partition table
+static bool ota_verify_slot_valid(uint32_t slot, uint32_t digest)
+{
+  uint32_t word;
+
+  if(slot == 0)
+    return FALSE;
+
+  ota_flash_read(&word, OTAF_VERIFY_SLOT_ADDR(slot - 1), 4);
+  if(word != OTAF_VERIFY_MAGIC)
+    return FALSE;
+  ota_flash_read(&word, OTAF_VERIFY_SLOT_ADDR(slot - 1) + 4, 4);
+  return (word == digest);
+}
+
+//take one boot off the count of the current slot, FALSE if it is used up
+static bool ota_verify_take_boot(uint32_t slot)
+{
+  uint32_t addr = OTAF_VERIFY_SLOT_ADDR(slot - 1) + 8;
+  uint32_t word;
+  int i;
+
+  for(i = 0; i < CFG_OTA_VERIFY_CADENCE/32; i++, addr += 4){
+    ota_flash_read(&word, addr, 4);
+    if(word == 0)
+      continue;
+    word &= word - 1;   //clear the lowest bit still set
+    return (ota_flash_write_boot_sector(&word, 4, addr - OTAF_2nd_BOOTINFO_ADDR) == PPlus_SUCCESS);
+  }
+  return FALSE;
+}
+
+static void ota_verify_mark(uint32_t slot, uint32_t digest)
+{
+  uint32_t hdr[2];
+
+  if(slot == OTAF_VERIFY_SLOT_NUM)
+    return;   //no room left, every boot is a full check until the next OTA
+
+  hdr[0] = OTAF_VERIFY_MAGIC;
+  hdr[1] = digest;
+  ota_flash_write_boot_sector(hdr, 8, OTAF_VERIFY_SLOT_ADDR(slot) - OTAF_2nd_BOOTINFO_ADDR);
+}
+#endif
+
 int __attribute__((section("ota_app_loader_area"))) ota_flash_load_app(void)
 {
   int i;
+  int ret;
   uint32_t partition_num = 0;
   uint32_t bank_info = 0;
   uint32_t bank_addr = 0;
   bool is_encrypt = FALSE;
+  bool fast_boot = FALSE;
+#if(CFG_OTA_VERIFY_CADENCE)
+  uint32_t slot = 0;
+  uint32_t digest = 0;
+  bool valid = FALSE;
+  bool abnormal = FALSE;
+#endif
   
   ota_flash_read(&partition_num, OTAF_2nd_BOOTINFO_ADDR, 4);
   if(partition_num == 0xffffffff)
@@ -133,56 +228,64 @@ int __attribute__((section("ota_app_loader_area"))) ota_flash_load_app(void)
   }
   
   is_encrypt = is_crypto_app();
-  
-  for(i = 1; i< partition_num+1; i++){
 
-//    uint32_t flash_addr;
-//    uint32_t run_addr;
-//    uint32_t size;
-//    uint32_t checksum;
-//    uint16_t crc;
-    ota_flash_read(&ota_load_flash_addr, OTAF_2nd_BOOTINFO_ADDR + i*4*4, 4);
-    ota_flash_read(&ota_load_run_addr,   OTAF_2nd_BOOTINFO_ADDR + i*4*4 + 4,  4);
-    ota_flash_read(&ota_load_size,       OTAF_2nd_BOOTINFO_ADDR + i*4*4 + 8,  4);
-    ota_flash_read(&ota_load_checksum,   OTAF_2nd_BOOTINFO_ADDR + i*4*4 + 12, 4);
-
-    //case XIP mode, shoud be in single bank and no fct
-    if(ota_load_run_addr == ota_load_flash_addr)
-    {
-      if(USE_FCT==0 && CFG_OTA_BANK_MODE==OTA_SINGLE_BANK)
-        continue;
-			else
-				return PPlus_ERR_INVALID_DATA;
-    }
-    if((ota_load_run_addr&0xffff0000) == 0xffff0000)
-    {
+#if(CFG_OTA_VERIFY_CADENCE)
+  //an application that did not hand over through the OTA mode register
+  //before this reset crashed or was reset by the watchdog, check it fully
+  abnormal = ((read_reg(OTA_MODE_SELECT_REG) & OTAF_BOOT_FLAG_RUN) != 0);
+  digest = ota_verify_digest(partition_num);
+  slot = ota_verify_free_slot();
+  valid = ota_verify_slot_valid(slot, digest);
+  if(valid && !abnormal)
+    fast_boot = ota_verify_take_boot(slot);
+#endif
+
+  //full check, the partitions are verified in flash before anything is copied
+  for(i = 1; i< partition_num+1 && !fast_boot; i++){
+    ret = ota_flash_load_entry(i);
+    if(ret == PPlus_ERR_NOT_FOUND)
       continue;
+    if(ret != PPlus_SUCCESS)
+      return ret;
+
+    ota_load_crc = crc16(0, (const volatile void * )(ota_load_flash_addr + bank_addr), ota_load_size);
+    if(ota_load_crc != (uint16)ota_load_checksum){
+      //if crc incorrect, reboot to OTA mode
+      write_reg(OTA_MODE_SELECT_REG, OTA_MODE_OTA);
+      hal_system_soft_reset();
     }
+  }
 
-    //load binary
-	if(is_encrypt){
-      ota_load_crc = crc16(0, (const volatile void * )(ota_load_flash_addr + bank_addr), ota_load_size);
-      if(ota_load_crc != (uint16)ota_load_checksum){
-        //if crc incorrect, reboot to OTA mode
-        write_reg(OTA_MODE_SELECT_REG, OTA_MODE_OTA);
-        hal_system_soft_reset();
-      }
+#if(CFG_OTA_VERIFY_CADENCE)
+  //the check after an abnormal reset keeps the count, so a reset loop
+  //does not use up the slots
+  if(!fast_boot && !(valid && abnormal))
+    ota_verify_mark(slot, digest);
+#endif
 
+  for(i = 1; i< partition_num+1; i++){
+    ret = ota_flash_load_entry(i);
+    if(ret == PPlus_ERR_NOT_FOUND)
+      continue;
+    if(ret != PPlus_SUCCESS)
+      return ret;
+
+    //load binary
+    if(is_encrypt){
       flash_load_parition((uint8_t*)(ota_load_flash_addr + bank_addr), (int)ota_load_size, (uint8_t*)ota_load_run_addr);
       //aes_ccm_phyplus_dec((const unsigned char*)0x200127e0, (uint8_t*)(flash_addr + bank_addr), (int)size, NULL, (uint8_t*)run_addr);
     }
     else
     {
       ota_flash_read((uint32_t*)ota_load_run_addr, ota_load_flash_addr + bank_addr, ota_load_size);
-      ota_load_crc = crc16(0, (const volatile void * )ota_load_run_addr, ota_load_size);
-      if(ota_load_crc != (uint16)ota_load_checksum){
-        //if crc incorrect, reboot to OTA mode
-        write_reg(OTA_MODE_SELECT_REG, OTA_MODE_OTA);
-        hal_system_soft_reset();
-      }
     }
   }
 
+#if(CFG_OTA_VERIFY_CADENCE)
+  //cleared again by the application when it selects the next OTA mode
+  write_reg(OTA_MODE_SELECT_REG, read_reg(OTA_MODE_SELECT_REG) | OTAF_BOOT_FLAG_RUN);
+#endif
+
   return PPlus_SUCCESS;
   
 }
@@ -311,6 +414,116 @@ int ota_flash_erase(uint32_t bank_addr)
 }
 
 
+/*
+erase one sector of the OTA area, used by the streaming mode to erase the
+application bank sector by sector, just ahead of the data
+*/
+int ota_flash_erase_sector(uint32_t flash_addr)
+{
+  flash_addr = flash_addr | OTAF_BASE_ADDR;
+
+  if(flash_addr & (OTAF_SECTOR_SIZE - 1))
+    return PPlus_ERR_DATA_ALIGN;
+
+  if(flash_addr < OTAF_2nd_BOOTINFO_ADDR + OTAF_SECTOR_SIZE || flash_addr > OTAF_END_ADDR)
+    return PPlus_ERR_INVALID_ADDR;
+
+  hal_flash_erase_sector(flash_addr);
+  return PPlus_SUCCESS;
+}
+
+/*
+crc16 of flash content, read with the cache bypassed so that data programmed
+during this boot is seen, not a stale cache line. *crc is the seed and gets
+the result, so a range can be checked in several pieces.
+*/
+int ota_flash_crc16(uint16_t* crc, uint32_t addr, uint32_t size)
+{
+  uint32_t cb = AP_PCR->CACHE_BYPASS;
+  uint32_t word, i, n;
+
+  if(addr < OTAF_START_ADDR || addr + size > OTAF_END_ADDR + 1)
+    return PPlus_ERR_INVALID_ADDR;
+
+  if(cb == 0)
+    AP_PCR->CACHE_BYPASS = 1;
+
+  while(size){
+    word = read_reg(addr & 0xfffffffc);
+    i = addr & 3;
+    n = (size < 4 - i) ? size : (4 - i);
+    *crc = crc16(*crc, (uint8_t*)&word + i, n);
+    addr += n;
+    size -= n;
+  }
+
+  if(cb == 0)
+    AP_PCR->CACHE_BYPASS = 0;
+
+  return PPlus_SUCCESS;
+}
+
+
+void ota_flash_writer_init(ota_flash_writer_t* pwr, uint32_t addr, uint32_t limit)
+{
+  pwr->addr = addr;
+  pwr->limit = limit;
+  pwr->offset = 0;
+  pwr->prog_offset = 0;
+}
+
+/*
+program what is collected, a partial last word is padded with 0xff
+*/
+int ota_flash_writer_flush(ota_flash_writer_t* pwr)
+{
+  uint8_t* buf = (uint8_t*)pwr->buf;
+  uint32_t len = pwr->offset - pwr->prog_offset;
+  int ret;
+
+  if(len == 0)
+    return PPlus_SUCCESS;
+
+  while(len & 3)
+    buf[len++] = 0xff;
+
+  ret = ota_flash_write_partition(pwr->addr + pwr->prog_offset, pwr->buf, len);
+  if(ret != PPlus_SUCCESS)
+    return ret;
+
+  pwr->prog_offset += len;
+  return PPlus_SUCCESS;
+}
+
+int ota_flash_writer_put(ota_flash_writer_t* pwr, const uint8_t* data, uint32_t size)
+{
+  uint8_t* buf = (uint8_t*)pwr->buf;
+  uint32_t fill, n;
+  int ret;
+
+  if(size > pwr->limit - pwr->offset)
+    return PPlus_ERR_OTA_DATA_SIZE;
+
+  while(size){
+    fill = pwr->offset - pwr->prog_offset;
+    n = OTAF_WRITER_BUF_SIZE - fill;
+    if(n > size)
+      n = size;
+    osal_memcpy(buf + fill, data, n);
+    pwr->offset += n;
+    data += n;
+    size -= n;
+
+    if(pwr->offset - pwr->prog_offset == OTAF_WRITER_BUF_SIZE){
+      ret = ota_flash_writer_flush(pwr);
+      if(ret != PPlus_SUCCESS)
+        return ret;
+    }
+  }
+  return PPlus_SUCCESS;
+}
+
+
 int ota_flash_erase_area(uint32_t flash_addr, uint32_t size)
 {
     int ret = PPlus_ERR_INVALID_ADDR;
@@ -150,6 +150,42 @@ enum{
 
 #define MAX_SECT_SUPPORT  32//16
 
+/*
+verified image marker, in the second half of the boot sector behind the
+partition table. Once all partitions passed the crc check, the loader writes
+a slot bound to the partition table, and the next CFG_OTA_VERIFY_CADENCE
+boots start without the check, each clearing one bit of the slot count. The
+slot is never erased by the loader, a used up count or an abnormal reset
+starts a new one, write_app_boot_sector() drops them all with the sector.
+
+slot, OTAF_VERIFY_SLOT_SIZE bytes:
+  magic   4   OTAF_VERIFY_MAGIC, 0xffffffff for a free slot
+  digest  4   crc16 of the partition table, complement in the upper half
+  count   CFG_OTA_VERIFY_CADENCE/8, one bit per fast boot
+
+CFG_OTA_VERIFY_CADENCE is a multiple of 32, 0 checks every boot.
+*/
+#ifndef CFG_OTA_VERIFY_CADENCE
+#define CFG_OTA_VERIFY_CADENCE  64
+#endif
+
+#if(CFG_OTA_VERIFY_CADENCE % 32)
+  #error "CFG_OTA_VERIFY_CADENCE must be a multiple of 32"
+#endif
+
+#define OTAF_VERIFY_MAGIC       0x59524556  //"VERY"
+#define OTAF_VERIFY_OFFSET      0x800
+#define OTAF_VERIFY_SLOT_SIZE   (8 + CFG_OTA_VERIFY_CADENCE/8)
+#define OTAF_VERIFY_SLOT_NUM    ((OTAF_SECTOR_SIZE - OTAF_VERIFY_OFFSET)/OTAF_VERIFY_SLOT_SIZE)
+#define OTAF_VERIFY_SLOT_ADDR(n)  (OTAF_2nd_BOOTINFO_ADDR + OTAF_VERIFY_OFFSET + (n)*OTAF_VERIFY_SLOT_SIZE)
+
+//in OTA_MODE_SELECT_REG, set by the loader when it starts the application.
+//Only a reset through the OTA app service clears it, set_ota_mode() or
+//ota_vendor_module_Reset(). After any other reset, a plain
+//hal_system_soft_reset() from the application included, the next boot
+//takes the full crc pass.
+#define OTAF_BOOT_FLAG_RUN      0x01000000
+
 
 typedef struct{
   uint32_t  flash_addr;
@@ -168,6 +204,20 @@ typedef struct{
 }ota_fw_t;
 
 
+#define OTAF_WRITER_BUF_SIZE  256 //program unit, multiple of 4
+
+/*
+sequential writer into erased flash, data is programmed each time
+OTAF_WRITER_BUF_SIZE bytes are collected
+*/
+typedef struct{
+  uint32_t  addr;         //flash address of offset 0, erased
+  uint32_t  limit;        //room at addr
+  uint32_t  offset;       //bytes written
+  uint32_t  prog_offset;  //offset of buf[0], everything below is programmed
+  uint32_t  buf[OTAF_WRITER_BUF_SIZE/4];
+}ota_flash_writer_t;
+
 #if(CFG_FLASH >= 512)
 int ota_flash_load_fct(void);
 #endif
@@ -176,6 +226,11 @@ int ota_flash_write_partition(uint32 addr, uint32_t* p_sect, uint32_t size);
 int ota_flash_write_boot_sector(uint32_t* p_sect, uint32_t size, uint32_t offset);
 int ota_flash_erase(uint32_t addr);
 int ota_flash_erase_area(uint32_t flash_addr, uint32_t size);
+int ota_flash_erase_sector(uint32_t flash_addr);
+int ota_flash_crc16(uint16_t* crc, uint32_t addr, uint32_t size);
+void ota_flash_writer_init(ota_flash_writer_t* pwr, uint32_t addr, uint32_t limit);
+int ota_flash_writer_put(ota_flash_writer_t* pwr, const uint8_t* data, uint32_t size);
+int ota_flash_writer_flush(ota_flash_writer_t* pwr);
 int ota_flash_read_bootsector(uint32_t* bank_addr);
 
 #endif
@@ -0,0 +1,275 @@
+/**************************************************************************************************
+*******
+**************************************************************************************************/
+
+
+/*
+Streaming LZ4 block decoder for compressed OTA partitions, see ota_lz.h.
+Input can be fed in pieces of any size, output goes straight into erased
+flash through an ota_flash_writer_t.
+*/
+
+#include "OSAL.h"
+#include "bus_dev.h"
+#include "ota_flash.h"
+#include "ota_lz.h"
+#include "crc16.h"
+#include "error.h"
+
+enum{
+  OTALZ_ST_HDR = 0,
+  OTALZ_ST_TOKEN,
+  OTALZ_ST_LIT_EXT,
+  OTALZ_ST_LITERALS,
+  OTALZ_ST_OFF_LO,
+  OTALZ_ST_OFF_HI,
+  OTALZ_ST_MATCH_EXT,
+  OTALZ_ST_DONE,
+};
+
+#define OTALZ_MIN_MATCH     4
+#define OTALZ_COPY_CHUNK    16
+
+#define OTALZ_U16(b) ((uint16_t)(b)[0] | ((uint16_t)(b)[1] << 8))
+#define OTALZ_U32(b) ((uint32_t)(b)[0] | ((uint32_t)(b)[1] << 8) | ((uint32_t)(b)[2] << 16) | ((uint32_t)(b)[3] << 24))
+
+static int lz_header(ota_lz_t* plz)
+{
+  if(OTALZ_U32(plz->hdr) != OTA_LZ_MAGIC)
+    return PPlus_ERR_OTA_BAD_DATA;
+
+  plz->raw_size = OTALZ_U32(plz->hdr + 4);
+  plz->raw_crc  = OTALZ_U16(plz->hdr + 8);
+
+  if(plz->raw_size == 0)
+    return PPlus_ERR_OTA_BAD_DATA;
+  if(plz->raw_size > plz->wr.limit)
+    return PPlus_ERR_OTA_DATA_SIZE;
+
+  plz->state = OTALZ_ST_TOKEN;
+  return PPlus_SUCCESS;
+}
+
+static void lz_next(ota_lz_t* plz, uint8_t state)
+{
+  plz->state = (plz->wr.offset == plz->raw_size) ? OTALZ_ST_DONE : state;
+}
+
+static void lz_literal_len_done(ota_lz_t* plz)
+{
+  if(plz->count)
+    plz->state = OTALZ_ST_LITERALS;
+  else
+    lz_next(plz, OTALZ_ST_OFF_LO);
+}
+
+/*
+copy a match, the source is still in the writer buffer or already in flash,
+which is read with the cache bypassed as it was programmed during this boot
+*/
+static int lz_match(ota_lz_t* plz)
+{
+  ota_flash_writer_t* pwr = &plz->wr;
+  uint8_t* buf = (uint8_t*)pwr->buf;
+  uint8_t tmp[OTALZ_COPY_CHUNK];
+  uint32_t cb = AP_PCR->CACHE_BYPASS;
+  uint32_t len = plz->count;
+  uint32_t src, addr, n, i;
+  int ret = PPlus_SUCCESS;
+
+  if(plz->offset == 0 || plz->offset > pwr->offset || len > plz->raw_size - pwr->offset)
+    return PPlus_ERR_OTA_BAD_DATA;
+
+  AP_PCR->CACHE_BYPASS = 1;
+  while(len){
+    //an overlapping match can only copy what is already decoded
+    n = (len < OTALZ_COPY_CHUNK) ? len : OTALZ_COPY_CHUNK;
+    if(n > plz->offset)
+      n = plz->offset;
+
+    src = pwr->offset - plz->offset;
+    for(i = 0; i < n; i++, src++){
+      if(src >= pwr->prog_offset){
+        tmp[i] = buf[src - pwr->prog_offset];
+      }
+      else{
+        addr = pwr->addr + src;
+        tmp[i] = (uint8_t)(read_reg(addr & 0xfffffffc) >> ((addr & 3) << 3));
+      }
+    }
+
+    //may program and reuse the buffer, so the chunk is gathered first
+    ret = ota_flash_writer_put(pwr, tmp, n);
+    if(ret != PPlus_SUCCESS)
+      break;
+    len -= n;
+  }
+  AP_PCR->CACHE_BYPASS = cb;
+
+  return ret;
+}
+
+/*********************************************************************
+ * @fn      ota_lz_init
+ *
+ * @brief   Start decompressing a partition.
+ *
+ * @param   plz       - decoder context
+ *          out_addr  - flash address of the partition, erased
+ *          out_limit - room at out_addr
+ *
+ * @return  PPlus_SUCCESS
+ */
+int ota_lz_init(ota_lz_t* plz, uint32_t out_addr, uint32_t out_limit)
+{
+  osal_memset(plz, 0, sizeof(ota_lz_t));
+  plz->state = OTALZ_ST_HDR;
+  ota_flash_writer_init(&plz->wr, out_addr, out_limit);
+  return PPlus_SUCCESS;
+}
+
+/*********************************************************************
+ * @fn      ota_lz_feed
+ *
+ * @brief   Decompress the next piece of the partition.
+ *
+ * @param   plz  - decoder context
+ *          data - compressed bytes
+ *          size - number of bytes
+ *
+ * @return  PPlus_SUCCESS, PPlus_ERR_OTA_BAD_DATA on a malformed stream,
+ *          PPlus_ERR_OTA_DATA_SIZE on data past the end of the block
+ */
+int ota_lz_feed(ota_lz_t* plz, const uint8_t* data, uint32_t size)
+{
+  uint32_t n;
+  uint8_t c;
+  int ret;
+
+  while(size){
+    switch(plz->state){
+    case OTALZ_ST_HDR:
+      n = OTA_LZ_HDR_SIZE - plz->hdr_len;
+      if(n > size)
+        n = size;
+      osal_memcpy(plz->hdr + plz->hdr_len, data, n);
+      plz->hdr_len += n;
+      data += n;
+      size -= n;
+      if(plz->hdr_len == OTA_LZ_HDR_SIZE){
+        ret = lz_header(plz);
+        if(ret != PPlus_SUCCESS)
+          return ret;
+      }
+      break;
+
+    case OTALZ_ST_LITERALS:
+      n = (plz->count < size) ? plz->count : size;
+      if(n > plz->raw_size - plz->wr.offset)
+        return PPlus_ERR_OTA_BAD_DATA;
+      ret = ota_flash_writer_put(&plz->wr, data, n);
+      if(ret != PPlus_SUCCESS)
+        return ret;
+      plz->count -= n;
+      data += n;
+      size -= n;
+      if(plz->count == 0)
+        lz_next(plz, OTALZ_ST_OFF_LO);
+      break;
+
+    case OTALZ_ST_DONE:
+      return PPlus_ERR_OTA_DATA_SIZE;
+
+    default:
+      c = *data++;
+      size--;
+
+      switch(plz->state){
+      case OTALZ_ST_TOKEN:
+        plz->token = c;
+        plz->count = c >> 4;
+        if(plz->count == 15)
+          plz->state = OTALZ_ST_LIT_EXT;
+        else
+          lz_literal_len_done(plz);
+        break;
+
+      case OTALZ_ST_LIT_EXT:
+        plz->count += c;
+        if(c != 255)
+          lz_literal_len_done(plz);
+        break;
+
+      case OTALZ_ST_OFF_LO:
+        plz->offset = c;
+        plz->state = OTALZ_ST_OFF_HI;
+        break;
+
+      case OTALZ_ST_OFF_HI:
+        plz->offset |= (uint16_t)c << 8;
+        plz->count = (plz->token & 0x0f) + OTALZ_MIN_MATCH;
+        if((plz->token & 0x0f) == 15){
+          plz->state = OTALZ_ST_MATCH_EXT;
+          break;
+        }
+        ret = lz_match(plz);
+        if(ret != PPlus_SUCCESS)
+          return ret;
+        lz_next(plz, OTALZ_ST_TOKEN);
+        break;
+
+      case OTALZ_ST_MATCH_EXT:
+        plz->count += c;
+        if(c == 255)
+          break;
+        ret = lz_match(plz);
+        if(ret != PPlus_SUCCESS)
+          return ret;
+        lz_next(plz, OTALZ_ST_TOKEN);
+        break;
+
+      default:
+        return PPlus_ERR_OTA_BAD_DATA;
+      }
+      break;
+    }
+  }
+  return PPlus_SUCCESS;
+}
+
+/*********************************************************************
+ * @fn      ota_lz_finish
+ *
+ * @brief   Program the last bytes and check the decompressed partition
+ *          in flash against the crc of the header.
+ *
+ * @param   plz  - decoder context
+ *          size - size of the decompressed partition
+ *          crc  - crc16 of the decompressed partition
+ *
+ * @return  PPlus_SUCCESS, PPlus_ERR_OTA_DATA_SIZE if the stream is cut
+ *          short, PPlus_ERR_OTA_CRC if the result does not match
+ */
+int ota_lz_finish(ota_lz_t* plz, uint32_t* size, uint16_t* crc)
+{
+  uint16_t chk = 0;
+  int ret;
+
+  if(plz->state != OTALZ_ST_DONE)
+    return PPlus_ERR_OTA_DATA_SIZE;
+
+  ret = ota_flash_writer_flush(&plz->wr);
+  if(ret != PPlus_SUCCESS)
+    return ret;
+
+  ret = ota_flash_crc16(&chk, plz->wr.addr, plz->raw_size);
+  if(ret != PPlus_SUCCESS)
+    return ret;
+  if(chk != plz->raw_crc)
+    return PPlus_ERR_OTA_CRC;
+
+  *size = plz->raw_size;
+  *crc = plz->raw_crc;
+  return PPlus_SUCCESS;
+}
+
@@ -0,0 +1,49 @@
+/**************************************************************************************************
+*******
+**************************************************************************************************/
+
+
+#ifndef _OTA_LZ_H
+#define _OTA_LZ_H
+
+#include "types.h"
+#include "ota_flash.h"
+
+/*
+Compressed partition, generated by tools/ota_lz.py and sent with
+OTA_PART_FLAG_LZ in OTA_CMD_PARTITION_INFO. All fields little endian.
+
+header, 12 bytes:
+  magic     4   OTA_LZ_MAGIC
+  raw_size  4   size of the decompressed partition
+  raw_crc   2   crc16 of the decompressed partition
+  reserved  2
+
+followed by one LZ4 block (lz4 block format, no frame). Matches may reach
+back up to 64K: the window is the decompressed data itself, read back from
+flash once it has been programmed, so the decoder only needs the program
+buffer of the flash writer.
+*/
+#define OTA_LZ_MAGIC          0x345a4c4f  //"OLZ4"
+#define OTA_LZ_HDR_SIZE       12
+
+typedef struct{
+  uint32_t  raw_size;
+  uint16_t  raw_crc;
+  uint16_t  offset;       //match distance
+
+  uint8_t   state;
+  uint8_t   token;
+  uint8_t   hdr_len;
+  uint8_t   hdr[OTA_LZ_HDR_SIZE];
+  uint32_t  count;        //literal or match length being decoded
+
+  ota_flash_writer_t wr;  //decompressed partition
+}ota_lz_t;
+
+int ota_lz_init(ota_lz_t* plz, uint32_t out_addr, uint32_t out_limit);
+int ota_lz_feed(ota_lz_t* plz, const uint8_t* data, uint32_t size);
+int ota_lz_finish(ota_lz_t* plz, uint32_t* size, uint16_t* crc);
+
+#endif
+
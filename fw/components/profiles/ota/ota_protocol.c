@@ -17,6 +17,8 @@
 #include "ota_service.h"
 #include "ota_protocol.h"
 #include "ota_flash.h"
+#include "ota_delta.h"
+#include "ota_lz.h"
 #include "flash.h"
 #include "crc16.h"
 #include "version.h"
@@ -36,6 +38,30 @@
 
 #define OTA_BLOCK_REQ_TIMEOUT    4000
 #define OTA_BLOCK_BURST_TIMEOUT   1000
+#define OTA_WINDOW_TIMEOUT        100   //no packet for this long ends a window round
+#define OTA_WINDOW_STEP           2     //growth per round below OTA_WINDOW_LOSS_LO
+#define OTA_WINDOW_LOSS_HI        64    //loss average above 1/4 halves the window
+#define OTA_WINDOW_LOSS_LO        32    //below 1/8 grows it
+
+#define OTA_MIC_SIZE              4     //appended to encrypted partitions
+
+#if(CFG_OTA_STREAM && defined(CFG_OTA_MESH))
+#error "CFG_OTA_STREAM is not supported with CFG_OTA_MESH"
+#endif
+
+//delta and compressed partitions are rebuilt from the partition buffer
+#if(defined(CFG_OTA_MESH) || CFG_OTA_STREAM)
+#define OTA_REBUILD_SUPPORT       0
+#else
+#define OTA_REBUILD_SUPPORT       1
+#endif
+
+//windowed transfer places packets anywhere in the partition buffer
+#if(CFG_OTA_STREAM)
+#define OTA_WINDOW_SUPPORT        0
+#else
+#define OTA_WINDOW_SUPPORT        1
+#endif
 
 
 #define Bytes2U32(u32val, b) {u32val = ((uint32_t)(b[0]&0xff)) | (((uint32_t)(b[1]&0xff))<<8)| (((uint32_t)(b[2]&0xff))<<16)| (((uint32_t)(b[3]&0xff))<<24);}
@@ -59,6 +85,7 @@ typedef struct{
   uint32_t  run_addr;
   uint32_t  size;
   uint16_t  checksum;
+  uint8_t   flags;        //OTA_PART_FLAG_xxx
 }ota_part_t;
 
 typedef struct{
@@ -77,6 +104,8 @@ typedef struct{
   uint32_t  bank_addr;
 
   bool      reboot_flag;
+  bool      delta;        //partitions are delta patches
+  bool      window;       //windowed transfer, OTA_START_FLAG_WINDOW
   //uint8_t   param_size;
   //uint8_t   param_offset;
   //uint32_t  param_buf[MAX_OTA_PARAM_SIZE/4];
@@ -87,12 +116,39 @@ typedef struct{
   
   uint32_t  block_offset_retry;
   
+  uint16_t  crc;        //crc16 of the partition body received so far
+  uint16_t  crc_retry;  //crc at block_offset_retry
   
+#if(OTA_WINDOW_SUPPORT)
+  uint8_t   win_size;     //packets per window
+  uint8_t   win_max;      //bound from the payload size
+  uint8_t   win_pkt;      //payload bytes per packet
+  uint16_t  win_num;      //packets in the partition
+  uint16_t  win_base;     //first missing packet, everything below is received
+  uint16_t  win_last;     //last packet asked for by the latest ack
+  uint16_t  win_hi;       //highest packet received this round + 1
+  uint16_t  win_rx;       //new packets received this round
+  uint8_t   win_loss;     //running average of the round loss, 1/256 units
+  uint32_t  win_map[OTA_WINDOW_MAX/32]; //bit i: packet win_base+i received
+#endif
+
+#if(CFG_OTA_STREAM)
+  uint32_t  prog_offset;  //partition offset of partition_buf[0], data below is in flash, <= block_offset_retry
+  uint32_t  erase_base;   //[erase_base, erase_addr) is erased during this OTA
+  uint32_t  erase_addr;
+#endif
+
   uint8_t*  partition_buf;
 }ota_context_t;
 
+#if(CFG_OTA_STREAM)
+//one unacked burst on top of the acked data short of a program unit
+#define OTA_PBUF_SIZE (OTA_STREAM_BURST_MAX + OTA_STREAM_BUF_SIZE)
+__align(4) uint8_t ota_patition_buffer[OTA_PBUF_SIZE];
+#else
 #define OTA_PBUF_SIZE (16*1024+16)
 uint8_t ota_patition_buffer[OTA_PBUF_SIZE] __attribute__((section("ota_partition_buffer_area")));
+#endif
 
 static uint16_t s_ota_burst_size = 16;
 
@@ -101,6 +157,14 @@ static bool s_ota_address_plus = TRUE;
 
 static ota_context_t s_ota_ctx;
 
+#if(OTA_REBUILD_SUPPORT)
+//partitions rebuilt from partition_buf at the end, one at a time
+static union{
+  ota_delta_t delta;
+  ota_lz_t    lz;
+}s_ota_rebuild;
+#endif
+
 
 extern void bx_to_application(uint32_t run_addr);
 extern bool verify_mic(unsigned char* buf, int size);
@@ -135,13 +199,161 @@ static void reset_ctx(void){
   s_ota_ctx.tm_evt = tm_evt;
 }
 
+#if(CFG_OTA_STREAM)
+/*
+Streaming mode: partition_buf holds the data from prog_offset on. Data is
+programmed once its burst is acked, in OTA_STREAM_BUF_SIZE units, as a burst
+that times out may have lost a packet and had the rest land at the wrong
+offset; it is received again from block_offset_retry and must not be in
+flash yet. The flash is kept erased one sector ahead of the programmed data,
+so erasing and programming are spread over the reception instead of the
+whole bank being erased up front and the partition programmed at the end.
+Partitions are expected in ascending flash order, as the image tool emits
+them.
+*/
+static uint32_t partition_flash_addr(ota_part_t* ppart)
+{
+  if(s_ota_ctx.ota_resource || ppart->flash_addr == ppart->run_addr)
+    return ppart->run_addr;
+  return ppart->flash_addr + s_ota_ctx.bank_addr;
+}
+
+static int stream_erase_ahead(uint32_t flash_end)
+{
+  ota_part_t* ppart = &s_ota_ctx.part[s_ota_ctx.current_part];
+  uint32_t part_end = partition_flash_addr(ppart) + ppart->size;
+  int ret;
+
+  if(flash_end > part_end)
+    flash_end = part_end;
+
+  while(s_ota_ctx.erase_addr < flash_end){
+    ret = ota_flash_erase_sector(s_ota_ctx.erase_addr);
+    if(ret != PPlus_SUCCESS)
+      return ret;
+    s_ota_ctx.erase_addr += OTAF_SECTOR_SIZE;
+  }
+  return PPlus_SUCCESS;
+}
+
+static int stream_start(void)
+{
+  s_ota_ctx.erase_base = 0;
+  s_ota_ctx.erase_addr = 0;
+
+  if(s_ota_ctx.ota_resource){
+    //resource area is erased by OTA_CMD_ERASE
+    s_ota_ctx.erase_addr = 0xffffffff;
+    return PPlus_SUCCESS;
+  }
+  if(CFG_OTA_BANK_MODE == OTA_SINGLE_BANK){
+    //application is overwritten in place, invalidate it first
+    hal_flash_erase_sector(OTAF_2nd_BOOTINFO_ADDR);
+  }
+  return PPlus_SUCCESS;
+}
+
+static int stream_partition_start(void)
+{
+  uint32_t start = partition_flash_addr(&s_ota_ctx.part[s_ota_ctx.current_part]);
+
+  s_ota_ctx.prog_offset = 0;
+  if(start < s_ota_ctx.erase_base || start >= s_ota_ctx.erase_addr){
+    s_ota_ctx.erase_base = start & ~(OTAF_SECTOR_SIZE - 1);
+    s_ota_ctx.erase_addr = s_ota_ctx.erase_base;
+  }
+  return stream_erase_ahead(start + OTAF_SECTOR_SIZE);
+}
+
+//program the acked data up to block_offset, the whole of it at the end of the partition
+static int stream_program(void)
+{
+  ota_part_t* ppart = &s_ota_ctx.part[s_ota_ctx.current_part];
+  uint32_t flash_addr = partition_flash_addr(ppart) + s_ota_ctx.prog_offset;
+  uint32_t fill = s_ota_ctx.block_offset - s_ota_ctx.prog_offset;
+  uint32_t len = fill;
+  int ret;
+
+  if(s_ota_ctx.block_offset < ppart->size)
+    len &= ~(OTA_STREAM_BUF_SIZE - 1);
+  if(len == 0)
+    return PPlus_SUCCESS;
+
+  //pad the last word of the partition
+  while(len & 3)
+    s_ota_ctx.partition_buf[len++] = 0xff;
+
+  //a burst and the rest before it may reach past the sector erased ahead
+  ret = stream_erase_ahead(flash_addr + len + OTAF_SECTOR_SIZE);
+  if(ret != PPlus_SUCCESS)
+    return ret;
+  ret = ota_flash_write_partition(flash_addr, (uint32_t*)s_ota_ctx.partition_buf, len);
+  if(ret != PPlus_SUCCESS)
+    return ret;
+
+  //less than a unit is left, it doesn't overlap what was programmed
+  if(len < fill)
+    osal_memcpy(s_ota_ctx.partition_buf, s_ota_ctx.partition_buf + len, fill - len);
+  s_ota_ctx.prog_offset += len;
+  return PPlus_SUCCESS;
+}
+
+static int stream_write(uint32_t offset, uint8_t* data, uint32_t size)
+{
+  uint32_t fill = offset - s_ota_ctx.prog_offset;
+
+  //a burst grown past the buffer by an MTU exchange in the middle of the partition
+  if(fill + size > OTA_PBUF_SIZE)
+    return PPlus_ERR_OTA_DATA_SIZE;
+
+  osal_memcpy(s_ota_ctx.partition_buf + fill, data, size);
+  return PPlus_SUCCESS;
+}
+#endif
+
+/*
+The partition crc is accumulated as data arrives, over the body only, that is
+everything but the trailing OTA_MIC_SIZE bytes. The body crc is the checksum
+to store once the MIC is stripped, and the full crc only needs the last few
+bytes on top of it.
+*/
+static uint32_t sector_body_size(ota_part_t* ppart)
+{
+  return (ppart->size > OTA_MIC_SIZE) ? (ppart->size - OTA_MIC_SIZE) : 0;
+}
+
+#if(CFG_OTA_STREAM == 0)
+static void sector_crc_update(uint32_t offset, uint32_t size)
+{
+  uint32_t body = sector_body_size(&s_ota_ctx.part[s_ota_ctx.current_part]);
+
+  if(offset >= body)
+    return;
+  if(size > body - offset)
+    size = body - offset;
+  s_ota_ctx.crc = crc16(s_ota_ctx.crc, (void*)(s_ota_ctx.partition_buf + offset), size);
+}
+#endif
+
 static int sector_crc(void)
 {
   uint16 crc = 0;
+  uint32_t body;
   ota_part_t* ppart = NULL;
 
   ppart = &s_ota_ctx.part[s_ota_ctx.current_part]; 
-  crc = crc16(0, (void*)s_ota_ctx.partition_buf, ppart->size);
+  body = sector_body_size(ppart);
+#if(CFG_OTA_STREAM)
+  //verify what has been programmed, the body crc is kept for sector_crypto()
+  s_ota_ctx.crc = 0;
+  if(ota_flash_crc16(&s_ota_ctx.crc, partition_flash_addr(ppart), body) != PPlus_SUCCESS)
+    return PPlus_ERR_OTA_CRC;
+  crc = s_ota_ctx.crc;
+  if(ota_flash_crc16(&crc, partition_flash_addr(ppart) + body, ppart->size - body) != PPlus_SUCCESS)
+    return PPlus_ERR_OTA_CRC;
+#else
+  crc = crc16(s_ota_ctx.crc, (void*)(s_ota_ctx.partition_buf + body), ppart->size - body);
+#endif
   if(crc != ppart->checksum)
   {
 #if 0
@@ -175,12 +387,22 @@ static int sector_crypto(void)
     return PPlus_SUCCESS;
 
   ppart = &s_ota_ctx.part[s_ota_ctx.current_part];
+#if(CFG_OTA_STREAM)
+  {
+    //the partition is only in flash, read it uncached
+    uint32_t cb = AP_PCR->CACHE_BYPASS;
+    AP_PCR->CACHE_BYPASS = 1;
+    chk = verify_mic((unsigned char*)partition_flash_addr(ppart), ppart->size);
+    AP_PCR->CACHE_BYPASS = cb;
+  }
+#else
   chk = verify_mic(s_ota_ctx.partition_buf,ppart->size);
+#endif
   if(chk == FALSE)
     return PPlus_ERR_OTA_CRYPTO;
 
-  ppart->size -= 4; //remove MIC when store to flash
-  ppart->checksum = crc16(0, (void*)s_ota_ctx.partition_buf, ppart->size); //figure out new checksum because the data length changed
+  ppart->size -= OTA_MIC_SIZE; //remove MIC when store to flash
+  ppart->checksum = s_ota_ctx.crc; //body crc, already accumulated while receiving
   
   return PPlus_SUCCESS;
 }
@@ -213,6 +435,115 @@ static void response_err(int error)
 
 }
 
+#if(OTA_WINDOW_SUPPORT)
+/*
+Windowed transfer, see ota_protocol.h. The received bitmap slides with
+win_base, the first missing packet, and the partition crc is accumulated as
+win_base moves so it still sees the data in order. A round ends when the last
+packet asked for arrives or after OTA_WINDOW_TIMEOUT without data; the ack
+then reports what is missing. The window is halved while the average round
+loss is above OTA_WINDOW_LOSS_HI and grows while it is below OTA_WINDOW_LOSS_LO,
+up to what OTA_WINDOW_BYTES allows at the negotiated MTU.
+*/
+static bool window_received(uint16_t bit)
+{
+  return (s_ota_ctx.win_map[bit >> 5] >> (bit & 31)) & 1;
+}
+
+static void window_start(void)
+{
+  ota_part_t* ppart = &s_ota_ctx.part[s_ota_ctx.current_part];
+  uint32_t max;
+
+  //one byte of each packet is the sequence number
+  s_ota_ctx.win_pkt = (s_ota_ctx.mtu_a > 0x100) ? 0xff : (uint8_t)(s_ota_ctx.mtu_a - 1);
+
+  max = OTA_WINDOW_BYTES / s_ota_ctx.win_pkt;
+  if(max > OTA_WINDOW_MAX)
+    max = OTA_WINDOW_MAX;
+  if(max < OTA_WINDOW_MIN)
+    max = OTA_WINDOW_MIN;
+  s_ota_ctx.win_max = (uint8_t)max;
+  if(s_ota_ctx.win_size > s_ota_ctx.win_max)
+    s_ota_ctx.win_size = s_ota_ctx.win_max;
+
+  s_ota_ctx.win_num = (uint16_t)((ppart->size + s_ota_ctx.win_pkt - 1) / s_ota_ctx.win_pkt);
+  s_ota_ctx.win_base = 0;
+  s_ota_ctx.win_hi = 0;
+  s_ota_ctx.win_rx = 0;
+  s_ota_ctx.win_last = ((s_ota_ctx.win_size < s_ota_ctx.win_num) ? s_ota_ctx.win_size : s_ota_ctx.win_num) - 1;
+  osal_memset(s_ota_ctx.win_map, 0, sizeof(s_ota_ctx.win_map));
+}
+
+static void window_ack(void)
+{
+  attHandleValueNoti_t notif;
+  uint32_t loss = 0xff;
+  uint16_t lost = 0;
+  uint16_t bit, end;
+
+  //packets skipped below the highest one received are taken as lost,
+  //a round that got nothing at all as fully lost
+  for(bit = 0; s_ota_ctx.win_base + bit < s_ota_ctx.win_hi; bit++){
+    if(!window_received(bit))
+      lost++;
+  }
+  if(s_ota_ctx.win_rx)
+    loss = ((uint32_t)lost << 8) / (s_ota_ctx.win_rx + lost);
+
+  //retransmit rounds are short, so one round says little on its own
+  s_ota_ctx.win_loss = (uint8_t)((3 * (uint32_t)s_ota_ctx.win_loss + loss) >> 2);
+  if(s_ota_ctx.win_loss > OTA_WINDOW_LOSS_HI){
+    s_ota_ctx.win_size >>= 1;
+    if(s_ota_ctx.win_size < OTA_WINDOW_MIN)
+      s_ota_ctx.win_size = OTA_WINDOW_MIN;
+  }
+  else if(s_ota_ctx.win_loss < OTA_WINDOW_LOSS_LO){
+    s_ota_ctx.win_size += OTA_WINDOW_STEP;
+    if(s_ota_ctx.win_size > s_ota_ctx.win_max)
+      s_ota_ctx.win_size = s_ota_ctx.win_max;
+  }
+
+  end = s_ota_ctx.win_num - s_ota_ctx.win_base;
+  if(end > s_ota_ctx.win_size)
+    end = s_ota_ctx.win_size;
+
+  osal_memset(&notif, 0, sizeof(notif));
+  notif.len = 5 + ((s_ota_ctx.win_size + 7) >> 3);
+  notif.value[0] = PPlus_SUCCESS;
+  notif.value[1] = OTA_RSP_BLOCK_ACK;
+  notif.value[2] = (uint8_t)(s_ota_ctx.win_base & 0xff);
+  notif.value[3] = (uint8_t)(s_ota_ctx.win_base >> 8);
+  notif.value[4] = s_ota_ctx.win_size;
+  for(bit = 0; bit < end; bit++){
+    if(!window_received(bit)){
+      notif.value[5 + (bit >> 3)] |= 1 << (bit & 7);
+      s_ota_ctx.win_last = s_ota_ctx.win_base + bit;
+    }
+  }
+
+  s_ota_ctx.win_hi = s_ota_ctx.win_base;
+  s_ota_ctx.win_rx = 0;
+  ota_Notify(&notif);
+  start_timer(OTA_BLOCK_REQ_TIMEOUT);
+}
+
+static void response_window_param(void)
+{
+  attHandleValueNoti_t notif;
+
+  osal_memset(&notif, 0, sizeof(notif));
+
+  notif.len = 4;
+  notif.value[0] = PPlus_SUCCESS;
+  notif.value[1] = OTA_RSP_PARTITION_INFO;
+  notif.value[2] = s_ota_ctx.win_size;
+  notif.value[3] = s_ota_ctx.win_pkt;
+
+  ota_Notify(&notif);
+}
+#endif
+
 static void handle_error_fatal(int error)
 {
   response_err(error);
@@ -291,6 +622,7 @@ void process_ctrl_cmd(uint8_t* cmdbuf, uint8_t size){
   if(size > sizeof(cmd)){
     return;
   }
+  osal_memset(&cmd, 0, sizeof(cmd));
   osal_memcpy(&cmd, cmdbuf, size);
   switch(cmd.cmd){
 #ifdef CFG_OTA_MESH
@@ -343,6 +675,19 @@ void process_ctrl_cmd(uint8_t* cmdbuf, uint8_t size){
       break;
     }
     
+    //delta patches need the running bank intact and the patch buffered
+    s_ota_ctx.delta = (cmd.p.start.flags & OTA_START_FLAG_DELTA) ? TRUE : FALSE;
+    if(s_ota_ctx.delta && (CFG_OTA_BANK_MODE != OTA_DUAL_BANK || !OTA_REBUILD_SUPPORT || s_ota_resource)){
+      handle_error_fatal(PPlus_ERR_NOT_SUPPORTED);
+      break;
+    }
+
+    s_ota_ctx.window = (cmd.p.start.flags & OTA_START_FLAG_WINDOW) ? TRUE : FALSE;
+    if(s_ota_ctx.window && !OTA_WINDOW_SUPPORT){
+      handle_error_fatal(PPlus_ERR_NOT_SUPPORTED);
+      break;
+    }
+
     s_ota_ctx.bank_mode = CFG_OTA_BANK_MODE;
     s_ota_ctx.ota_resource = s_ota_resource;
     ota_flash_read_bootsector(&s_ota_ctx.bank_addr);
@@ -361,11 +706,21 @@ void process_ctrl_cmd(uint8_t* cmdbuf, uint8_t size){
       s_ota_burst_size = 0xffff;
 
     AT_LOG("s_ota_burst_size is %x\n", s_ota_burst_size);
+#if(OTA_WINDOW_SUPPORT)
+    //burst size is the initial window, bounded per partition by window_start()
+    s_ota_ctx.win_size = (s_ota_burst_size > OTA_WINDOW_MAX) ? OTA_WINDOW_MAX : (uint8_t)s_ota_burst_size;
+    if(s_ota_ctx.win_size < OTA_WINDOW_MIN)
+      s_ota_ctx.win_size = OTA_WINDOW_MIN;
+#endif
+#if(CFG_OTA_STREAM)
+    ret = stream_start();
+#else
     if(!s_ota_ctx.ota_resource){
       //if(cmd.p.start.param_size >0)
       //  s_ota_ctx.ota_state = OTA_ST_PARAM;
       ret = ota_flash_erase(s_ota_ctx.bank_addr);
     }
+#endif
     
     response(OTA_RSP_START_OTA, ret);
     break;
@@ -384,6 +739,13 @@ void process_ctrl_cmd(uint8_t* cmdbuf, uint8_t size){
     Bytes2U32(ppart->run_addr,cmd.p.part.run_addr);
     Bytes2U32(ppart->size,cmd.p.part.size);
     Bytes2U16(ppart->checksum,cmd.p.part.checksum);
+    ppart->flags = cmd.p.part.flags;
+
+    //compressed partitions are decompressed from the partition buffer
+    if((ppart->flags & OTA_PART_FLAG_LZ) && (!OTA_REBUILD_SUPPORT || s_ota_ctx.delta)){
+      handle_error(PPlus_ERR_NOT_SUPPORTED);
+      break;
+    }
 
     //check parameter
     if(!s_ota_ctx.ota_resource){
@@ -395,15 +757,46 @@ void process_ctrl_cmd(uint8_t* cmdbuf, uint8_t size){
       handle_error(PPlus_ERR_INVALID_PARAM);
       break;
     }
+#if(CFG_OTA_STREAM)
+    //a burst is held in partition_buf until it is acked
+    if(OTA_DATA_BURST_SIZE > OTA_STREAM_BURST_MAX){
+      handle_error(PPlus_ERR_DATA_SIZE);
+      break;
+    }
+#else
+    //the whole partition is staged in partition_buf, window packets land anywhere in it
+    if(ppart->size > OTA_PBUF_SIZE){
+      handle_error(PPlus_ERR_DATA_SIZE);
+      break;
+    }
+#endif
 
     s_ota_ctx.ota_state = OTA_ST_DATA;
     
     s_ota_ctx.current_part = idx;
     s_ota_ctx.block_offset = 0;
     s_ota_ctx.block_offset_retry = 0;
+    s_ota_ctx.crc = 0;
+    s_ota_ctx.crc_retry = 0;
     
     s_ota_ctx.partition_buf = ota_patition_buffer;
     osal_memset(ota_patition_buffer, 0xff, OTA_PBUF_SIZE);
+
+#if(CFG_OTA_STREAM)
+    ret = stream_partition_start();
+    if(ret != PPlus_SUCCESS){
+      handle_error(ret);
+      break;
+    }
+#endif
+#if(OTA_WINDOW_SUPPORT)
+    if(s_ota_ctx.window){
+      window_start();
+      response_window_param();
+      start_timer(OTA_BLOCK_REQ_TIMEOUT);
+      break;
+    }
+#endif
     
     response(OTA_RSP_PARTITION_INFO, PPlus_SUCCESS);
     break;
@@ -583,15 +976,81 @@ static int write_app_boot_sector(void)
   return PPlus_SUCCESS;
 }
 
+#if(OTA_REBUILD_SUPPORT)
+/*
+rebuild a partition in the target bank from the running bank and the patch in
+partition_buf, ppart then describes the rebuilt partition for the boot sector
+*/
+static int partition_delta_apply(ota_part_t* ppart)
+{
+  uint32_t base_bank;
+  int ret;
+
+  if(ppart->flash_addr == ppart->run_addr || ppart->flash_addr >= OTAF_APP_BANK_SIZE)
+    return PPlus_ERR_NOT_SUPPORTED;
+
+  //target is the bank that does not run, see ota_flash_read_bootsector()
+  base_bank = (s_ota_ctx.bank_addr == OTAF_APP_BANK_0_ADDR) ? OTAF_APP_BANK_1_ADDR : OTAF_APP_BANK_0_ADDR;
+
+  ota_delta_init(&s_ota_rebuild.delta, base_bank, OTAF_APP_BANK_SIZE,
+                 s_ota_ctx.bank_addr + ppart->flash_addr, OTAF_APP_BANK_SIZE - ppart->flash_addr);
+  ret = ota_delta_feed(&s_ota_rebuild.delta, s_ota_ctx.partition_buf, ppart->size);
+  if(ret != PPlus_SUCCESS)
+    return ret;
+
+  return ota_delta_finish(&s_ota_rebuild.delta, &ppart->size, &ppart->checksum);
+}
+
+/*
+decompress partition_buf straight into flash, ppart then describes the
+decompressed partition for the boot sector
+*/
+static int partition_lz_apply(ota_part_t* ppart)
+{
+  uint32_t flash_addr, limit;
+  int ret;
+
+  if(s_ota_ctx.ota_resource){
+    //resource area is erased by OTA_CMD_ERASE
+    flash_addr = ppart->run_addr;
+    limit = OTAF_END_ADDR + 1 - flash_addr;
+  }
+  else if(ppart->flash_addr == ppart->run_addr || ppart->flash_addr >= OTAF_APP_BANK_SIZE){
+    return PPlus_ERR_NOT_SUPPORTED;
+  }
+  else{
+    flash_addr = ppart->flash_addr + s_ota_ctx.bank_addr;
+    limit = OTAF_APP_BANK_SIZE - ppart->flash_addr;
+  }
+
+  ota_lz_init(&s_ota_rebuild.lz, flash_addr, limit);
+  ret = ota_lz_feed(&s_ota_rebuild.lz, s_ota_ctx.partition_buf, ppart->size);
+  if(ret != PPlus_SUCCESS)
+    return ret;
+
+  return ota_lz_finish(&s_ota_rebuild.lz, &ppart->size, &ppart->checksum);
+}
+#endif
+
 static void partition_program(void)
 {
   int ret;
+#if(CFG_OTA_STREAM == 0)
   ota_part_t* ppart = NULL;
   uint32_t flash_addr = 0;
 
   ppart = &s_ota_ctx.part[s_ota_ctx.current_part];
   //write partition data
-  if(s_ota_ctx.ota_resource)
+  if(s_ota_ctx.delta || (ppart->flags & OTA_PART_FLAG_LZ))
+  {
+    //rebuilt and programmed straight from partition_buf
+    ret = s_ota_ctx.delta ? partition_delta_apply(ppart) : partition_lz_apply(ppart);
+    if(ret != PPlus_SUCCESS){
+      handle_error(ret);
+      return;
+    }
+  }
+  else if(s_ota_ctx.ota_resource)
   {
     flash_addr = ppart->run_addr;
   }
@@ -612,12 +1071,14 @@ static void partition_program(void)
   {
     flash_addr = ppart->flash_addr + s_ota_ctx.bank_addr;
   }
-  ret = ota_flash_write_partition(flash_addr, (uint32_t*)s_ota_ctx.partition_buf, ppart->size);
+  if(!s_ota_ctx.delta && !(ppart->flags & OTA_PART_FLAG_LZ))
+    ret = ota_flash_write_partition(flash_addr, (uint32_t*)s_ota_ctx.partition_buf, ppart->size);
 
   if(ret != PPlus_SUCCESS){
     handle_error(ret);
     return;
   }
+#endif
       
   //case all partition data finished
   if(s_ota_ctx.current_part+1 == s_ota_ctx.part_num){
@@ -633,13 +1094,28 @@ static void partition_program(void)
   
 }
 #endif
+static void partition_done(void)
+{
+  stop_timer();
+  //cec check
+  if(sector_crc() != PPlus_SUCCESS){
+    handle_error(PPlus_ERR_OTA_CRC);
+    return;
+  }
+  if(sector_crypto()!=PPlus_SUCCESS){
+    handle_error(PPlus_ERR_OTA_CRYPTO);
+    return;
+  }
+
+  partition_program();
+}
+
 static void process_ota_partition_data(uint8_t* data, uint8_t size)
 {
   uint32_t block_offset = s_ota_ctx.block_offset;
   ota_part_t* ppart = NULL;
 
   ppart = &s_ota_ctx.part[s_ota_ctx.current_part];
-  osal_memcpy(s_ota_ctx.partition_buf + block_offset, data, size);
   
   block_offset += size;
   AT_LOG("boff[%d], rty[%d]\n", block_offset,s_ota_ctx.block_offset_retry);
@@ -648,11 +1124,27 @@ static void process_ota_partition_data(uint8_t* data, uint8_t size)
     return;
   }
 
+#if(CFG_OTA_STREAM)
+  if(stream_write(s_ota_ctx.block_offset, data, size) != PPlus_SUCCESS){
+    handle_error(PPlus_ERR_OTA_DATA_SIZE);
+    return;
+  }
+#else
+  osal_memcpy(s_ota_ctx.partition_buf + s_ota_ctx.block_offset, data, size);
+  sector_crc_update(s_ota_ctx.block_offset, size);
+#endif
   s_ota_ctx.block_offset = block_offset;
 
   if(s_ota_ctx.block_offset - s_ota_ctx.block_offset_retry == OTA_DATA_BURST_SIZE){
+#if(CFG_OTA_STREAM)
+      if(stream_program() != PPlus_SUCCESS){
+        handle_error(PPlus_ERR_SPI_FLASH);
+        return;
+      }
+#endif
       response(OTA_RSP_BLOCK_BURST, PPlus_SUCCESS);
       s_ota_ctx.block_offset_retry = s_ota_ctx.block_offset;
+      s_ota_ctx.crc_retry = s_ota_ctx.crc;
       start_timer(OTA_BLOCK_REQ_TIMEOUT);
   }
   else{
@@ -660,23 +1152,83 @@ static void process_ota_partition_data(uint8_t* data, uint8_t size)
   }
   
   if(block_offset == ppart->size){
-    stop_timer();
-    //cec check
-    if(sector_crc() != PPlus_SUCCESS){
-      handle_error(PPlus_ERR_OTA_CRC);
+#if(CFG_OTA_STREAM)
+    //the last burst may be short, it is checked by the crc from flash
+    if(stream_program() != PPlus_SUCCESS){
+      handle_error(PPlus_ERR_SPI_FLASH);
       return;
     }
-    if(sector_crypto()!=PPlus_SUCCESS){
-      handle_error(PPlus_ERR_OTA_CRYPTO);
-      return;
-    }
-
-    partition_program();
+#endif
+    partition_done();
     return;
   }
   
 }
 
+#if(OTA_WINDOW_SUPPORT)
+static void process_ota_window_data(uint8_t* data, uint8_t size)
+{
+  ota_part_t* ppart = &s_ota_ctx.part[s_ota_ctx.current_part];
+  uint32_t offset, len;
+  uint16_t bit, idx, base;
+  int i;
+
+  if(size < 2)
+    return;
+
+  //packets older than win_base or beyond the bitmap are stale, dropped
+  bit = (uint8_t)(data[0] - (uint8_t)s_ota_ctx.win_base);
+  idx = s_ota_ctx.win_base + bit;
+  if(bit >= OTA_WINDOW_MAX || idx >= s_ota_ctx.win_num || window_received(bit)){
+    start_timer(OTA_WINDOW_TIMEOUT);
+    return;
+  }
+
+  //a packet of the wrong size is handled as lost
+  offset = (uint32_t)idx * s_ota_ctx.win_pkt;
+  len = ppart->size - offset;
+  if(len > s_ota_ctx.win_pkt)
+    len = s_ota_ctx.win_pkt;
+  if(size - 1 != len){
+    start_timer(OTA_WINDOW_TIMEOUT);
+    return;
+  }
+
+  osal_memcpy(s_ota_ctx.partition_buf + offset, data + 1, len);
+  s_ota_ctx.win_map[bit >> 5] |= 1u << (bit & 31);
+  s_ota_ctx.win_rx++;
+  if(idx >= s_ota_ctx.win_hi)
+    s_ota_ctx.win_hi = idx + 1;
+
+  //slide over the packets now received in order
+  base = s_ota_ctx.win_base;
+  while(window_received(0)){
+    for(i = 0; i < OTA_WINDOW_MAX/32 - 1; i++)
+      s_ota_ctx.win_map[i] = (s_ota_ctx.win_map[i] >> 1) | (s_ota_ctx.win_map[i + 1] << 31);
+    s_ota_ctx.win_map[i] >>= 1;
+    s_ota_ctx.win_base++;
+  }
+  if(s_ota_ctx.win_base != base){
+    offset = (uint32_t)base * s_ota_ctx.win_pkt;
+    sector_crc_update(offset, (uint32_t)(s_ota_ctx.win_base - base) * s_ota_ctx.win_pkt);
+    s_ota_ctx.block_offset = (uint32_t)s_ota_ctx.win_base * s_ota_ctx.win_pkt;
+    if(s_ota_ctx.block_offset > ppart->size)
+      s_ota_ctx.block_offset = ppart->size;
+  }
+  AT_LOG("win[%d], idx[%d]\n", s_ota_ctx.win_base, idx);
+
+  if(s_ota_ctx.win_base == s_ota_ctx.win_num){
+    partition_done();
+    return;
+  }
+
+  if(idx == s_ota_ctx.win_last)
+    window_ack();
+  else
+    start_timer(OTA_WINDOW_TIMEOUT);
+}
+#endif
+
 /*
 static void process_ota_param_data(uint8_t* data, uint8_t size)
 {
@@ -704,6 +1256,12 @@ static void process_ota_param_data(uint8_t* data, uint8_t size)
 void process_ota_data(uint8_t* data, uint8_t size){
   switch(s_ota_ctx.ota_state){
   case OTA_ST_DATA:
+#if(OTA_WINDOW_SUPPORT)
+    if(s_ota_ctx.window){
+      process_ota_window_data(data, size);
+      break;
+    }
+#endif
     process_ota_partition_data(data, size);
     break;
   //case OTA_ST_PARAM:
@@ -750,6 +1308,7 @@ void process_service_evt(ota_Evt_t* pev)
   }
 }
 #define __APP_RUN_ADDR__ (0x1FFF1838)
+#if defined ( __CC_ARM )
 __asm void __attribute__((section("ota_app_loader_area"))) otaProtocol_RunApp(void)
 {
     LDR R0, = __APP_RUN_ADDR__
@@ -757,6 +1316,15 @@ __asm void __attribute__((section("ota_app_loader_area"))) otaProtocol_RunApp(vo
     BX R1
     ALIGN
 }
+#else
+//other compilers, and the host build of tools/ota_test.c
+void __attribute__((section("ota_app_loader_area"))) otaProtocol_RunApp(void)
+{
+  uint32_t entry = *(volatile uint32_t*)(uintptr_t)(__APP_RUN_ADDR__ + 4);
+
+  ((void (*)(void))(uintptr_t)entry)();
+}
+#endif
 
 int __attribute__((section("ota_app_loader_area"))) run_application(void)
 {
@@ -794,7 +1362,15 @@ void otaProtocol_mtu(uint16_t mtu)
 
 void otaProtocol_TimerEvt(void)
 {
+#if(OTA_WINDOW_SUPPORT)
+  if(s_ota_ctx.window && s_ota_ctx.ota_state == OTA_ST_DATA){
+    //round ended short, ask again for what is missing
+    window_ack();
+    return;
+  }
+#endif
   s_ota_ctx.block_offset = s_ota_ctx.block_offset_retry;
+  s_ota_ctx.crc = s_ota_ctx.crc_retry;
   response(OTA_RSP_BLOCK_BURST, PPlus_ERR_OTA_BAD_DATA);
 
     LOG("ll_to_hci_pkt_cnt = %d\r\n", conn_param[0].pmCounter.ll_to_hci_pkt_cnt);
@@ -804,11 +1380,14 @@ void otaProtocol_TimerEvt(void)
 
 void otaProtocol_BootMode(void)
 {
-  uint32_t ota_mode = read_reg(OTA_MODE_SELECT_REG) & 0xf;
+  uint32_t boot_reg = read_reg(OTA_MODE_SELECT_REG);
+  uint32_t ota_mode = boot_reg & 0xf;
   uint32_t reg = ((SDK_VER_MAJOR &0xf) << 4) | ((SDK_VER_MINOR &0xf)<< 8) | ((SDK_VER_REVISION &0xff)<<12);
   #ifdef SDK_VER_TEST_BUILD
     reg |= (((SDK_VER_TEST_BUILD - 'a' + 1)&0xf) << 20);
   #endif
+  //left set by an application that never handed over, see ota_flash_load_app()
+  reg |= boot_reg & OTAF_BOOT_FLAG_RUN;
 
   write_reg(OTA_MODE_SELECT_REG,reg);
   
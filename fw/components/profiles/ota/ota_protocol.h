@@ -11,6 +11,38 @@
 
 #define OTA_DATA_BURST_SIZE (((uint32_t)s_ota_ctx.mtu_a) * ((uint32_t)s_ota_burst_size))
 
+//1: streaming mode, data is programmed to flash as its bursts are acked instead
+//of being staged in the 16K partition buffer, partitions are verified from flash
+#ifndef CFG_OTA_STREAM
+#define CFG_OTA_STREAM      0
+#endif
+#define OTA_STREAM_BUF_SIZE 256 //flash program unit in streaming mode, power of 2 from 4 up
+#define OTA_STREAM_BURST_MAX 4096 //largest burst in streaming mode, (mtu - 3) * burst size
+
+#define OTA_START_FLAG_DELTA  0x01  //partitions are patches against the running bank, see ota_delta.h
+#define OTA_START_FLAG_WINDOW 0x02  //windowed data transfer with selective retransmit, see below
+#define OTA_PART_FLAG_LZ      0x01  //partition is compressed, see ota_lz.h
+
+/*
+Windowed data transfer, not available with CFG_OTA_STREAM.
+OTA_RSP_PARTITION_INFO carries two more bytes: window size in packets and
+payload bytes per packet (negotiated MTU - 4). Every data packet is
+  seq       1   low byte of the packet index in the partition
+  payload   n   payload bytes per packet, the last packet may be shorter
+and is placed at index * payload whatever order it arrives in. The device
+answers each window with OTA_RSP_BLOCK_ACK:
+  err       1   PPlus_SUCCESS
+  cmd       1   OTA_RSP_BLOCK_ACK
+  base      2   first packet still missing
+  window    1   packets the sender may have outstanding from base
+  missing   (window+7)/8  bit i set: packet base+i is still needed
+The sender sends the packets flagged in missing, in ascending order, then
+waits for the next ack. The window adapts to the loss seen by the device.
+*/
+#define OTA_WINDOW_MIN        4
+#define OTA_WINDOW_MAX        64    //bits in the missing bitmap
+#define OTA_WINDOW_BYTES      4096  //payload the window may cover, bounds it at large MTU
+
 enum
 {
     OTA_CMD_START_OTA = 1,
@@ -29,6 +61,7 @@ enum
     OTA_RSP_BLOCK_COMPLETE,     //88
     OTA_RSP_ERASE,              //89
     OTA_RSP_REBOOT,             //8a
+    OTA_RSP_BLOCK_ACK,          //8b
     OTA_RSP_ERROR = 0xff,
 
 };
@@ -43,6 +76,7 @@ typedef struct
         {
             uint8_t sector_num;
             uint8_t burst_size;
+            uint8_t flags;  //OTA_START_FLAG_xxx, optional
         } start;
         struct
         {
@@ -51,6 +85,7 @@ typedef struct
             uint8_t run_addr[4];
             uint8_t size[4];
             uint8_t checksum[2];
+            uint8_t flags;  //OTA_PART_FLAG_xxx, optional
         } part;
 
         struct
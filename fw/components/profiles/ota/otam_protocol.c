@@ -8,6 +8,7 @@
 #include "OSAL_PwrMgr.h"
 #include "OSAL_bufmgr.h"
 #include "gatt.h"
+#include "linkdb.h"
 #include "ll.h"
 #include "ll_common.h"
 #include "hci.h"
@@ -63,23 +64,38 @@ typedef struct{
   uint32_t          cache_size;
   uint32_t          cache_offset;
   uint8_t           cache_retry;
-  uint8_t*          cache;
+  uint32_t          cache;        //flash address of the block, read through s_otam_cache
 }otam_fw_t;
 
 
 typedef struct{
+  uint16_t            conn_handle;  //INVALID_CONNHANDLE: context free
   uint8_t             state;
   uint8_t             run_mode;
   bool                reset_mode;
+  bool                busy;         //out of tx buffers, waits OTAP_EVT_DATA_WR_DELAY
   uint16_t            mtu_a;
   uint16_t            burst_size;
   uint8_t             opcode;
   otam_fw_t           fw;
-  otam_proto_meth_t   method;
 }otam_proto_ctx_t;
 
+typedef struct{
+  uint32_t  addr;       //flash address of data[0], 0: empty
+  uint32_t  stamp;      //last use, the oldest line is replaced
+  uint8_t   data[OTAM_CACHE_LINE_SIZE];
+}otam_cache_line_t;
+
+
+static otam_proto_ctx_t s_otap_ctx_t[OTAM_LINK_MAX];
+static otam_proto_meth_t s_otap_method;
+static uint8_t s_otap_rr;   //link served first by the next send_data()
 
-static otam_proto_ctx_t s_otap_ctx_t;
+static otam_cache_line_t s_otam_cache[OTAM_CACHE_LINE_NUM];
+static uint32_t s_otam_cache_stamp;
+
+static otam_proto_stat_t s_otam_stat;
+static uint32_t s_otam_stat_start;
 
 static void print_hex (const uint8 *data, uint16 len)
 {
@@ -102,26 +118,68 @@ static void print_hex (const uint8 *data, uint16 len)
 
 
 
-static int otam_proto_ctx_reset(uint8_t st)
+static otam_proto_ctx_t* otam_proto_ctx(uint16_t conn_handle)
+{
+  for(int i = 0; i < OTAM_LINK_MAX; i++){
+    if(s_otap_ctx_t[i].conn_handle == conn_handle)
+      return &s_otap_ctx_t[i];
+  }
+  return NULL;
+}
+
+static bool otam_proto_transferring(otam_proto_ctx_t *pctx)
+{
+  return (pctx->state >= OTAM_ST_WAIT_STARTED && pctx->state <= OTAM_ST_DATA);
+}
+
+static uint8_t otam_stat_links(void)
+{
+  uint8_t links = 0;
+  for(int i = 0; i < OTAM_LINK_MAX; i++){
+    if(otam_proto_transferring(&s_otap_ctx_t[i]))
+      links++;
+  }
+  return links;
+}
+
+static void otam_stat_log(void)
+{
+  otam_proto_stat_t stat;
+  otamProtocol_stat(&stat);
+  LOG("OTAM links %d, %d bytes in %dms, %d B/s, flash reads %d\n", stat.links, stat.bytes, stat.elapsed,
+      stat.elapsed ? (uint32_t)((uint64_t)stat.bytes * 1000 / stat.elapsed) : 0, stat.flash_reads);
+}
+
+static int otam_proto_ctx_reset(otam_proto_ctx_t *pctx, uint8_t st)
 {
-  otam_proto_ctx_t *pctx = &s_otap_ctx_t;
-  otam_proto_meth_t *method = &(pctx->method);
+  otam_proto_meth_t *method = &s_otap_method;
   pctx->state = st;
   pctx->opcode = 0;
+  pctx->busy = FALSE;
   memset(&(pctx->fw), 0, sizeof(otam_fw_t));
-  method->clear();
+  method->clear(pctx->conn_handle);
   return PPlus_SUCCESS;
 }
 
-static void otam_proto_disconnect(void* param)
+static void otam_proto_disconnect(otam_proto_ctx_t *pctx, void* param)
 {
-  otam_proto_ctx_reset(OTAM_ST_DISCONNECT);
+  otam_proto_ctx_reset(pctx, OTAM_ST_DISCONNECT);
+  pctx->conn_handle = INVALID_CONNHANDLE;
 }
-static void otam_proto_connect(void* param)
+static void otam_proto_connect(uint16_t conn_handle, void* param)
 {
-  otam_proto_ctx_t *pctx = &s_otap_ctx_t;
+  otam_proto_ctx_t *pctx = otam_proto_ctx(conn_handle);
   otam_proto_conn_param_t* pconn =  (otam_proto_conn_param_t*)param;
+
+  //reconnecting target keeps its reset_mode
+  if(pctx == NULL)
+    pctx = otam_proto_ctx(INVALID_CONNHANDLE);
+  if(pctx == NULL){
+    LOG("OTAM no free link for %x\n", conn_handle);
+    return;
+  }
   
+  pctx->conn_handle = conn_handle;
   pctx->state = OTAM_ST_CONNECTED;
   pctx->mtu_a = pconn->mtu -3;
   pctx->opcode = 0xff;
@@ -142,11 +200,10 @@ static void otam_proto_connect(void* param)
   }
 }
 
-static int send_patition_info(void)
+static int send_patition_info(otam_proto_ctx_t *pctx)
 {
-  otam_proto_ctx_t *pctx = &s_otap_ctx_t;
   otam_fw_t *pfw = &(pctx->fw);
-  otam_proto_meth_t *method = &(pctx->method);
+  otam_proto_meth_t *method = &s_otap_method;
 
   uint8_t data[20];
 
@@ -209,14 +266,50 @@ static int send_patition_info(void)
   pfw->fw.offset = 0;
 
 
-  return method->write_cmd(data, offset, 1000);
+  return method->write_cmd(pctx->conn_handle, data, offset, 1000);
     
 }
 
+static uint8_t* otam_cache_line(uint32_t addr)
+{
+  otam_cache_line_t* pline = &s_otam_cache[0];
+
+  s_otam_cache_stamp++;
+  for(int i = 0; i < OTAM_CACHE_LINE_NUM; i++){
+    if(s_otam_cache[i].addr == addr){
+      s_otam_cache[i].stamp = s_otam_cache_stamp;
+      return s_otam_cache[i].data;
+    }
+    if(s_otam_cache[i].stamp < pline->stamp)
+      pline = &s_otam_cache[i];
+  }
+
+  hal_flash_read(addr, pline->data, OTAM_CACHE_LINE_SIZE);
+  pline->addr = addr;
+  pline->stamp = s_otam_cache_stamp;
+  s_otam_stat.flash_reads++;
+  return pline->data;
+}
+
+static void otam_cache_read(uint32_t addr, uint8_t* buf, uint16_t size)
+{
+  uint32_t line, n;
+
+  while(size){
+    line = addr & ~(OTAM_CACHE_LINE_SIZE - 1);
+    n = line + OTAM_CACHE_LINE_SIZE - addr;
+    if(n > size)
+      n = size;
+    memcpy(buf, otam_cache_line(line) + (addr - line), n);
+    addr += n;
+    buf += n;
+    size -= n;
+  }
+}
+
 
-static int load_data_cache(void)
+static int load_data_cache(otam_proto_ctx_t *pctx)
 {
-  otam_proto_ctx_t *pctx = &s_otap_ctx_t;
   otam_fw_t *pfw = &(pctx->fw);
   ota_fw_part_t* ppart = &(pfw->fw.part[pfw->fw.part_current]);
   uint16_t mtu_a = pctx->mtu_a;
@@ -228,7 +321,7 @@ static int load_data_cache(void)
   }
 
   //memset(pfw->cache, 0, (ATT_MTU_SIZE-3));
-  pfw->cache = (uint8_t*)(ppart->flash_addr + pfw->fw.offset+OTAFM_FW_OTA_DATA_ADDR);
+  pfw->cache = ppart->flash_addr + pfw->fw.offset+OTAFM_FW_OTA_DATA_ADDR;
   pfw->cache_size = size;
   pfw->cache_offset = 0;
   pfw->cache_retry = 0;
@@ -239,32 +332,60 @@ static int load_data_cache(void)
   
 }
 
-static int send_data(void)
+//send one packet of the current block of a link
+static int send_link_data(otam_proto_ctx_t *pctx)
 {
-  otam_proto_ctx_t *pctx = &s_otap_ctx_t;
   otam_fw_t *pfw = &(pctx->fw);
-  otam_proto_meth_t *method = &(pctx->method);
+  otam_proto_meth_t *method = &s_otap_method;
+  uint8_t data[ATT_MTU_SIZE];
+
+  if(pctx->state != OTAM_ST_DATA || pfw->cache_size == pfw->cache_offset)
+    return PPlus_ERR_INVALID_STATE;
+  if(pctx->busy)
+    return PPlus_ERR_BUSY;
+
+  uint16_t size = pctx->mtu_a;
+  if((pfw->cache_size - pfw->cache_offset) < size)
+    size = pfw->cache_size - pfw->cache_offset;
+  if(size > sizeof(data))
+    size = sizeof(data);
+  otam_cache_read(pfw->cache + pfw->cache_offset, data, size);
+  if(method->write_data(pctx->conn_handle, data, size) != PPlus_SUCCESS){
+    pctx->busy = TRUE;
+    return PPlus_ERR_BUSY;
+  }
+  pfw->cache_offset += size;
+  return PPlus_SUCCESS;
+}
+
+/*
+serve the links round robin, one packet per link and turn, so the targets
+move through the image together and share the cache lines. A link out of tx
+buffers is skipped until OTAP_EVT_DATA_WR_DELAY without holding up the others.
+*/
+static int send_data(void)
+{
+  otam_proto_meth_t *method = &s_otap_method;
+  bool sent, busy = FALSE;
+  int ret;
 
   if(!(method->write_data))
     return PPlus_ERR_NOT_REGISTED;
-  
-  if(pctx->state != OTAM_ST_DATA)
-    return PPlus_ERR_INVALID_STATE;
 
-  int ret = PPlus_SUCCESS;
-  uint16_t size = 0;
-  uint16_t mtu_a = pctx->mtu_a;
-  while(pfw->cache_size - pfw->cache_offset){
-    size = mtu_a;
-    if((pfw->cache_size - pfw->cache_offset) < mtu_a)
-      size = pfw->cache_size - pfw->cache_offset;
-    ret = method->write_data(pfw->cache + pfw->cache_offset, size);
-    if(ret != PPlus_SUCCESS){
-      method->write_data_delay(2);
-      return PPlus_SUCCESS;
+  do{
+    sent = FALSE;
+    for(int i = 0; i < OTAM_LINK_MAX; i++){
+      ret = send_link_data(&s_otap_ctx_t[(s_otap_rr + i) % OTAM_LINK_MAX]);
+      if(ret == PPlus_SUCCESS)
+        sent = TRUE;
+      else if(ret == PPlus_ERR_BUSY)
+        busy = TRUE;
     }
-    pfw->cache_offset += size;
-  }
+    s_otap_rr = (s_otap_rr + 1) % OTAM_LINK_MAX;
+  }while(sent);
+
+  if(busy)
+    method->write_data_delay(2);
   return PPlus_SUCCESS;
 }
 
@@ -273,9 +394,8 @@ void print_version(uint8_t* vinfo)
   
 }
 
-static void handle_app_notify_event(void* param, uint8_t len)
+static void handle_app_notify_event(otam_proto_ctx_t *pctx, void* param, uint8_t len)
 {
-  otam_proto_ctx_t *pctx = &s_otap_ctx_t;
   switch(pctx->opcode)
   {
   case OTAAPP_CMD_START_OTA:
@@ -290,15 +410,14 @@ static void handle_app_notify_event(void* param, uint8_t len)
 
 }
 
-static void handle_ota_notify_event(void* param, uint8_t len)
+static void handle_ota_notify_event(otam_proto_ctx_t *pctx, void* param, uint8_t len)
 {
-  otam_proto_ctx_t *pctx = &s_otap_ctx_t;
   otam_fw_t* pfw = &(pctx->fw);
   uint8_t* pnotify = (uint8_t*)param;
-  otam_proto_meth_t* method = &(pctx->method);
+  otam_proto_meth_t* method = &s_otap_method;
   int retval = pnotify[0];
   if(len == 1){ //fatal error
-    otam_proto_ctx_reset(OTAM_ST_CONNECTED);
+    otam_proto_ctx_reset(pctx, OTAM_ST_CONNECTED);
     return;
   }
   LOG("OTA Notif %x, %x\n",pnotify[0],pnotify[1]);
@@ -308,7 +427,7 @@ static void handle_ota_notify_event(void* param, uint8_t len)
   case OTA_RSP_START_OTA:
   {
     if(retval == PPlus_SUCCESS && pctx->state == OTAM_ST_WAIT_STARTED){
-      send_patition_info();
+      send_patition_info(pctx);
     }
     else
     {
@@ -329,10 +448,12 @@ static void handle_ota_notify_event(void* param, uint8_t len)
     if(method->write_cmd){
       data[0] = OTA_CMD_REBOOT;
       data[1] = 1;
+      s_otam_stat.bytes += pfw->cache_size;
+      otam_stat_log();
       pctx->state = OTAM_ST_COMPLETE;
       LOG("OTA completed!!\n");
 
-      method->write_cmd(data, 2, 1000);
+      method->write_cmd(pctx->conn_handle, data, 2, 1000);
     }
     
     break;
@@ -345,16 +466,17 @@ static void handle_ota_notify_event(void* param, uint8_t len)
 			LOG(" ");
 		}
 
-    load_data_cache();
+    load_data_cache(pctx);
     send_data();
     break;
   }
   case OTA_RSP_PARTITION_COMPLETE:
   {
     pfw->fw.total_offset += pfw->cache_size;
+    s_otam_stat.bytes += pfw->cache_size;
 
     pfw->fw.part_current ++;
-    send_patition_info();
+    send_patition_info(pctx);
     break;
   }
   case OTA_RSP_BLOCK_BURST:
@@ -367,7 +489,8 @@ static void handle_ota_notify_event(void* param, uint8_t len)
     
     if(retval == PPlus_SUCCESS)
     {
-      load_data_cache();
+      s_otam_stat.bytes += pfw->cache_size;
+      load_data_cache(pctx);
       send_data();
     }
     else if(retval == PPlus_ERR_OTA_BAD_DATA){
@@ -389,7 +512,7 @@ static void handle_ota_notify_event(void* param, uint8_t len)
   case OTA_RSP_REBOOT:
   {
     LOG("[OTA_RSP_REBOOT]GAPCentralRole_TerminateLink\n");
-    GAPCentralRole_TerminateLink(0);
+    GAPCentralRole_TerminateLink(pctx->conn_handle);
   }
   case OTA_RSP_ERASE:
   case OTA_RSP_ERROR:
@@ -405,24 +528,30 @@ static void handle_ota_notify_event(void* param, uint8_t len)
 
 void otamProtocol_event(otap_evt_t* pev)
 {
-  otam_proto_ctx_t *pctx = &s_otap_ctx_t;
+  otam_proto_ctx_t *pctx = otam_proto_ctx(pev->conn_handle);
   switch(pev->ev){
   case OTAP_EVT_DISCONNECTED:
-    otam_proto_disconnect(pev->data);
+    if(pctx)
+      otam_proto_disconnect(pctx, pev->data);
     break;
   case OTAP_EVT_CONNECTED:
-    otam_proto_connect(pev->data);
+    otam_proto_connect(pev->conn_handle, pev->data);
     break;
   case OTAP_EVT_NOTIFY:
   {
+    if(pctx == NULL)
+      break;
     if(pctx->run_mode == OTAC_RUNMODE_APP)
-      handle_app_notify_event(pev->data, pev->len);
+      handle_app_notify_event(pctx, pev->data, pev->len);
     else
-      handle_ota_notify_event(pev->data, pev->len);
+      handle_ota_notify_event(pctx, pev->data, pev->len);
     break;
   }
   case OTAP_EVT_DATA_WR_DELAY:
   {
+    //not tied to a link, retry every link that ran out of buffers
+    for(int i = 0; i < OTAM_LINK_MAX; i++)
+      s_otap_ctx_t[i].busy = FALSE;
     send_data();
     break;
   }
@@ -447,10 +576,10 @@ N*2 +2    | data area
 
 */
 
-int load_fw(uint8_t fw_id)
+int load_fw(uint8_t fw_id, ota_fw_t* pffw)
 {
-  otam_proto_ctx_t *pctx = &s_otap_ctx_t;
-  otam_fw_t *pfw = &(pctx->fw);
+  otam_fw_t fw;
+  otam_fw_t *pfw = &fw;
   uint32_t faddr = fw_id == 0 ? OTAM_FW_DATA_ADDR : OTAM_FW_DATA_ADDR1; 
   uint8_t* pdata = (uint8_t*) (faddr);
   uint32_t* pdata32 = (uint32_t*) pdata;
@@ -475,6 +604,7 @@ int load_fw(uint8_t fw_id)
     pfw->fw.total_size += pfw->fw.part[i].size;
   }
   pfw->fw.total_size += 0;
+  memcpy(pffw, &(pfw->fw), sizeof(ota_fw_t));
   
   return PPlus_SUCCESS;
 }
@@ -486,28 +616,42 @@ int load_res(void)
 }
 
 
-int otamProtocol_start_ota(ota_fw_t* pffw)
+int otamProtocol_start_ota(uint16_t conn_handle, ota_fw_t* pffw)
 {
-  otam_proto_ctx_t *pctx = &s_otap_ctx_t;
-  otam_fw_t *pfw = &(pctx->fw);
-  otam_proto_meth_t *method = &(pctx->method);
+  otam_proto_ctx_t *pctx = otam_proto_ctx(conn_handle);
+  otam_fw_t *pfw;
+  otam_proto_meth_t *method = &s_otap_method;
 
   uint8_t data[20];
 
-  memcpy(&(pfw->fw), pffw, sizeof(ota_fw_t));
+  if(pctx == NULL || conn_handle == INVALID_CONNHANDLE)
+    return PPlus_ERR_BLE_NOT_READY;
+  pfw = &(pctx->fw);
 
-  pfw->fw.offset = 0;
-  pfw->fw.part_current = 0;
-  pfw->fw.total_offset = 0;
-  
+  //a refused start must leave a running transfer untouched
   if(pctx->state < OTAM_ST_CONNECTED)
     return PPlus_ERR_BLE_NOT_READY;
   
-  if(pctx->run_mode != OTAC_RUNMODE_OTA){
+  if(pctx->run_mode != OTAC_RUNMODE_OTA || otam_proto_transferring(pctx)){
     return PPlus_ERR_INVALID_STATE;
   }
+
+  memcpy(&(pfw->fw), pffw, sizeof(ota_fw_t));
+
+  pfw->fw.offset = 0;
+  pfw->fw.part_current = 0;
+  pfw->fw.total_offset = 0;
     
   if(method->write_cmd){
+    //aggregate throughput restarts with the first target of a round, and
+    //is reported each time another target joins
+    if(otam_stat_links() == 0){
+      s_otam_stat.bytes = 0;
+      s_otam_stat_start = osal_GetSystemClock();
+    }
+    else{
+      otam_stat_log();
+    }
     pctx->state = OTAM_ST_WAIT_STARTED;
     pfw->fw.part_current = 0;
 
@@ -525,35 +669,39 @@ int otamProtocol_start_ota(ota_fw_t* pffw)
       data[2] = OTA_BURST_SIZE_HISPEED;
     }
     
-    return method->write_cmd(data, 3, 1000);
+    return method->write_cmd(pctx->conn_handle, data, 3, 1000);
   }
   return PPlus_ERR_NOT_REGISTED;
 }
 
 
-int otamProtocol_stop_ota(void)
+int otamProtocol_stop_ota(uint16_t conn_handle)
 {
-  otam_proto_ctx_t *pctx = &s_otap_ctx_t;
-  otam_proto_meth_t *method = &(pctx->method);
+  otam_proto_ctx_t *pctx = otam_proto_ctx(conn_handle);
+  otam_proto_meth_t *method = &s_otap_method;
   uint8_t data[20];
+  if(pctx == NULL || conn_handle == INVALID_CONNHANDLE)
+    return PPlus_ERR_BLE_NOT_READY;
   if(method->write_cmd){
     data[0] = OTA_CMD_START_OTA;
     data[1] = 0xff;
     data[2] = 0;
     pctx->state = OTAM_ST_CANCELING;
 
-    return method->write_cmd(data, 3, 1000);
+    return method->write_cmd(pctx->conn_handle, data, 3, 1000);
   }
 	return PPlus_ERR_NOT_REGISTED;
 }
 
-int otamProtocol_app_start_ota(uint8_t mode)
+int otamProtocol_app_start_ota(uint16_t conn_handle, uint8_t mode)
 {
-  otam_proto_ctx_t *pctx = &s_otap_ctx_t;
-  otam_proto_meth_t *method = &(pctx->method);
+  otam_proto_ctx_t *pctx = otam_proto_ctx(conn_handle);
+  otam_proto_meth_t *method = &s_otap_method;
 
   uint8_t data[20];
 
+  if(pctx == NULL || conn_handle == INVALID_CONNHANDLE)
+    return PPlus_ERR_BLE_NOT_READY;
   if(pctx->run_mode != OTAC_RUNMODE_APP)
     return PPlus_ERR_INVALID_STATE;
 
@@ -568,15 +716,29 @@ int otamProtocol_app_start_ota(uint8_t mode)
     data[2] = 1;
 
     
-    return method->write_cmd(data, 3, 0);
+    return method->write_cmd(pctx->conn_handle, data, 3, 0);
   }
   return PPlus_ERR_NOT_REGISTED;
 }
 
+int otamProtocol_stat(otam_proto_stat_t* pstat)
+{
+  *pstat = s_otam_stat;
+  pstat->links = otam_stat_links();
+  pstat->elapsed = osal_GetSystemClock() - s_otam_stat_start;
+  return PPlus_SUCCESS;
+}
+
 int otamProtocol_init(otam_proto_meth_t* method)
 {
   memset(&s_otap_ctx_t, 0, sizeof(s_otap_ctx_t));
-  s_otap_ctx_t.method = *method;
+  for(int i = 0; i < OTAM_LINK_MAX; i++)
+    s_otap_ctx_t[i].conn_handle = INVALID_CONNHANDLE;
+  s_otap_method = *method;
+  s_otap_rr = 0;
+  memset(s_otam_cache, 0, sizeof(s_otam_cache));
+  s_otam_cache_stamp = 0;
+  memset(&s_otam_stat, 0, sizeof(s_otam_stat));
 	
 	return PPlus_SUCCESS;
   
@@ -12,6 +12,16 @@
 #define OTA_BURST_SIZE_DEFAULT    16
 #define OTA_BURST_SIZE_HISPEED    0xff
 
+//targets updated at the same time, one context per connection
+#ifndef OTAM_LINK_MAX
+#define OTAM_LINK_MAX             MAX_NUM_LL_CONN
+#endif
+
+//source image is read through a cache shared by all links, so flash is read
+//once for all targets as long as they stay within OTAM_CACHE_LINE_NUM lines
+#define OTAM_CACHE_LINE_SIZE      256
+#define OTAM_CACHE_LINE_NUM       4
+
 
 enum{
   OTAP_EVT_DISCONNECTED =1,
@@ -29,13 +39,22 @@ typedef struct{
 
 typedef struct{
   uint8_t   ev;
+  uint16_t  conn_handle;
   uint16_t  len;
   void*     data;
 }otap_evt_t;
 
-typedef int (*otam_clear_t)(void);
-typedef int (*otam_wcmd_op_t)(uint8_t* data, uint16_t len, uint32_t timeout);
-typedef int (*otam_wdata_op_t)(uint8_t* data, uint16_t len);
+typedef struct{
+  uint8_t   links;        //links transferring data
+  uint32_t  bytes;        //acknowledged by the targets
+  uint32_t  elapsed;      //ms since the first of them started
+  uint32_t  flash_reads;  //cache lines read from flash
+}otam_proto_stat_t;
+
+typedef int (*otam_clear_t)(uint16_t conn_handle);
+typedef int (*otam_wcmd_op_t)(uint16_t conn_handle, uint8_t* data, uint16_t len, uint32_t timeout);
+typedef int (*otam_wdata_op_t)(uint16_t conn_handle, uint8_t* data, uint16_t len);
+//OTAP_EVT_DATA_WR_DELAY after msec_delay, shared by all links
 typedef int (*otam_wdata_delay_t)(uint32_t msec_delay);
 
 typedef struct{
@@ -48,9 +67,10 @@ typedef struct{
 
 
 void otamProtocol_event(otap_evt_t* pev);
-int otamProtocol_start_ota(ota_fw_t* pffw);
-int otamProtocol_stop_ota(void);
-int otamProtocol_app_start_ota(uint8_t mode);
+int otamProtocol_start_ota(uint16_t conn_handle, ota_fw_t* pffw);
+int otamProtocol_stop_ota(uint16_t conn_handle);
+int otamProtocol_app_start_ota(uint16_t conn_handle, uint8_t mode);
+int otamProtocol_stat(otam_proto_stat_t* pstat);
 int otamProtocol_init(otam_proto_meth_t* method);
 
 #endif
@@ -39,7 +39,6 @@ static uint8 ota_CommandValue = 0;
 // OTA response Characteristic
 static uint8 ota_ResponseProps = GATT_PROP_NOTIFY;
 static uint8 ota_ResponseValue = 0;
-static gattCharCfg_t ota_ResponseCCCD[GATT_MAX_NUM_CONN];
 
 #define OTA_COMMAND_HANDLE 2
 #define OTA_RSP_HANDLE 4
@@ -87,7 +86,7 @@ static gattAttribute_t ota_AttrTbl[] =
             {ATT_BT_UUID_SIZE, clientCharCfgUUID},
             GATT_PERMIT_READ | GATT_PERMIT_WRITE,
             0,
-            (uint8 *)ota_ResponseCCCD},
+            GATT_CCCD(GATT_CCCD_OTA_RSP)},
 
 };
 
@@ -142,6 +141,7 @@ static int set_ota_mode(uint8_t mode)
 {
     if (mode > OTA_MODE_RESOURCE && mode != OTA_MODE_OTA_NADDR)
         return PPlus_ERR_INVALID_PARAM;
+    //also clears the loader run flag, this reset is not taken as a crash
     write_reg(OTA_MODE_SELECT_REG, mode);
     return PPlus_SUCCESS;
 }
@@ -247,12 +247,11 @@ static void handleConnStatusCB(uint16 connHandle, uint8 changeType)
     LOG("handleConnStatusCB %x, %d\n", connHandle, changeType);
     if (connHandle != LOOPBACK_CONNHANDLE)
     {
-        // Reset Client Char Config if connection has dropped
+        // Connection has dropped, GATT Server App resets the Client Char Config
         if ((changeType == LINKDB_STATUS_UPDATE_REMOVED) ||
             ((changeType == LINKDB_STATUS_UPDATE_STATEFLAGS) &&
              (!linkDB_Up(connHandle))))
         {
-            GATTServApp_InitCharCfg(connHandle, ota_ResponseCCCD);
             if (s_reboot_flg)
             {
                 hal_system_soft_reset();
@@ -271,7 +270,7 @@ static bStatus_t sendNotify(attHandleValueNoti_t *pNoti)
     uint16 value;
 
     GAPRole_GetParameter(GAPROLE_CONNHANDLE, &connHandle);
-    value = GATTServApp_ReadCharCfg(connHandle, ota_ResponseCCCD);
+    value = GATTServApp_ReadCCCD(connHandle, GATT_CCCD_OTA_RSP);
 
     if (connHandle == INVALID_CONNHANDLE)
         return bleIncorrectMode;
@@ -353,8 +352,6 @@ bStatus_t ota_app_AddService(void)
 
     load_ota_version();
 
-    GATTServApp_InitCharCfg(INVALID_CONNHANDLE, ota_ResponseCCCD);
-
     // Register GATT attribute list and CBs with GATT Server App
     status = GATTServApp_RegisterService(ota_AttrTbl,
                                          GATT_NUM_ATTRS(ota_AttrTbl),
@@ -380,6 +377,17 @@ int ota_vendor_module_StartOTA(uint8_t mode)
     return ret;
 }
 
+/*
+orderly reset back into the application. A plain hal_system_soft_reset()
+leaves the loader run flag set, and the loader then checks every partition
+as after a crash, see ota_flash_load_app()
+*/
+void ota_vendor_module_Reset(void)
+{
+    write_reg(OTA_MODE_SELECT_REG, read_reg(OTA_MODE_SELECT_REG) & ~OTA_BOOT_FLAG_RUN);
+    hal_system_soft_reset();
+}
+
 int ota_vendor_module_Version(uint8_t *major, uint8_t *minor, uint8_t *revision, uint8_t *test_build)
 {
     uint32_t reg = read_reg(OTA_MODE_SELECT_REG);
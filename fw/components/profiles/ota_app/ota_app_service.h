@@ -17,6 +17,7 @@ enum{
 };
 
 #define OTA_MODE_SELECT_REG 0x4000f034
+#define OTA_BOOT_FLAG_RUN   0x01000000  //OTAF_BOOT_FLAG_RUN of the loader
 
 
 #define OTA_APP_SERVICE_VERSION "V2.0.1"
@@ -44,6 +45,7 @@ typedef struct{
 bStatus_t ota_app_AddService(void);
 
 int ota_vendor_module_StartOTA(uint8_t mode);
+void ota_vendor_module_Reset(void);
 int ota_vendor_module_Version(  uint8_t* major, uint8_t* minor, uint8_t* revision, uint8_t *test_build);
 
 
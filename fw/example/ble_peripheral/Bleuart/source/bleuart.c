@@ -19,6 +19,7 @@
 #include "OSAL_PwrMgr.h"
 #include "gatt.h"
 #include "hci.h"
+#include "ll_common.h"
 
 #include "gapgattserver.h"
 #include "gattservapp.h"
@@ -32,6 +33,7 @@
 #include "bleuart_service.h"
 #include "bleuart_protocol.h"
 #include "log.h"
+#include "error.h"
 #include "osal_snv.h"
 #include "flash.h"
 
@@ -71,6 +73,11 @@
 #define DEFAULT_CONN_PAUSE_PERIPHERAL         6
 
 
+// Bridge frames: one 244 byte notification per LL PDU once DLE is negotiated
+#define BUP_ATT_MTU                           247
+#define BUP_DLE_TX_OCTETS                     251
+#define BUP_DLE_TX_TIME                       ((BUP_DLE_TX_OCTETS+10+4)<<3)
+
 // Length of bd addr as a string
 #define B_ADDR_STR_LEN                        15
 
@@ -282,7 +289,9 @@ void on_bleuartServiceEvt(bleuart_Evt_t* pev)
     osal_set_event(bleuart_TaskID,BUP_OSAL_EVT_NOTIFY_DATA);
     break;
   case bleuart_EVT_BLE_DATA_RECIEVED:
-    BUP_data_BLE_to_uart( (uint8_t*)pev->data, (uint8_t)pev->param);
+    //tell the service how much was taken, a write request is rejected otherwise
+    if(BUP_data_BLE_to_uart( (uint8_t*)pev->data, pev->param) != PPlus_SUCCESS)
+      pev->param = 0;
 	  LOG("%s,%d\n",pev->data,pev->param);
     break;
   default:
@@ -474,12 +483,16 @@ void bleuart_Init( uint8 task_id )
     GAP_SetParamValue( TGAP_GEN_DISC_ADV_INT_MAX, advInt[advint] );
   }
       
+  llInitFeatureSetDLE(TRUE);
+  ATT_SetMTUSizeMax(BUP_ATT_MTU);
+
   // Initialize GATT attributes
   GGS_AddService( GATT_ALL_SERVICES );            // GAP
   GATTServApp_AddService( GATT_ALL_SERVICES );    // GATT attributes
   DevInfo_AddService();                           // Device Information Service
   bleuart_AddService(on_bleuartServiceEvt);
   BUP_init(on_BUP_Evt);
+  AT_init();
 	
   // Setup a delayed profile startup
   osal_set_event( bleuart_TaskID, BUP_OSAL_EVT_START_DEVICE );
@@ -558,6 +571,21 @@ uint16 bleuart_ProcessEvent( uint8 task_id, uint16 events )
     BUP_data_uart_to_BLE();
     return ( events ^ BUP_OSAL_EVT_UART_TO_TIMER);
   }
+
+  // connection event closed, controller tx buffers are free again
+  if( events & BUP_OSAL_EVT_CONN_EVT_DONE)
+  {
+    BUP_conn_event_done();
+    return ( events ^ BUP_OSAL_EVT_CONN_EVT_DONE);
+  }
+
+#if(BUP_BENCHMARK)
+  if( events & BUP_OSAL_EVT_BENCH_TIMER)
+  {
+    BUP_bench_report();
+    return ( events ^ BUP_OSAL_EVT_BENCH_TIMER);
+  }
+#endif
 	
 	if( events & BUP_OSAL_EVT_RF433_KEY)
   {
@@ -569,20 +597,15 @@ uint16 bleuart_ProcessEvent( uint8 task_id, uint16 events )
   
    if( events & BUP_OSAL_EVT_AT)
   {
-	uint8 ret=2;
+	uint8 ret;
 	AT_BLEUART_RX_t* at_rx = & at_bleuart_rx;
 	  
-	//»ù´¡Ö¸ÁîºÍ²éÑ¯Ö¸Áî
-	ret=AT_query(at_rx);
-	//ÉèÖÃÖ¸Áî
-	if(ret==2){
-	ret=AT_setdata(at_rx);
-	}
+	ret=AT_process(at_rx);
 	
-	if(ret==0){
+	if(ret==AT_RET_OK){
 		at_rx->len=0;
 	}
-	else if(ret==3){
+	else if(ret==AT_RET_READV){
 		GAPRole_TerminateConnection();
 		WaitMs(100);
 		uint8 initial_advertisin_enable = FALSE;		
@@ -597,7 +620,7 @@ uint16 bleuart_ProcessEvent( uint8 task_id, uint16 events )
 		at_rx->len=0;
 		osal_start_timerEx(bleuart_TaskID, BUP_OSAL_EVT_RESET_ADV,1000);	
 	}
-	else if(ret==1){
+	else if(ret==AT_RET_FLASH){
 	Modify_BLEDevice_Data = 1;
 	osal_snv_write(0x80,1,&Modify_BLEDevice_Data);
 	at_rx->len=0;
@@ -671,6 +694,7 @@ static void bleuart_StateNotificationCB( gaprole_States_t newState )
         
         case GAPROLE_ADVERTISING:
          // FLOW_CTRL_BLE_DISCONN();
+          GATTServApp_ConnEventDoneNoticeCmd(bleuart_TaskID, NULL);
           BUP_disconnect_handler();
 				  hal_gpio_write(UART_INDICATE_LED,0);
          // FLOW_CTRL_UART_TX_UNLOCK();
@@ -684,6 +708,8 @@ static void bleuart_StateNotificationCB( gaprole_States_t newState )
         
         case GAPROLE_CONNECTED:
           GAPRole_GetParameter( GAPROLE_CONNHANDLE, &gapConnHandle );
+          HCI_LE_SetDataLengthCmd(gapConnHandle, BUP_DLE_TX_OCTETS, BUP_DLE_TX_TIME);
+          GATTServApp_ConnEventDoneNoticeCmd(bleuart_TaskID, BUP_OSAL_EVT_CONN_EVT_DONE);
 				  hal_gpio_write(UART_INDICATE_LED,1);
          // FLOW_CTRL_BLE_CONN();
 			if(AT_bleuart_auto==0x59){
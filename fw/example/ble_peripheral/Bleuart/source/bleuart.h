@@ -43,6 +43,8 @@
 #define BUP_OSAL_EVT_UART_TO_TIMER                        0x0200
 #define BUP_OSAL_EVT_RF433_KEY                            0x0400// chendy add just for
 #define BUP_OSAL_EVT_AT                            		  0x0800// JFM add for AT
+#define BUP_OSAL_EVT_CONN_EVT_DONE                        0x1000
+#define BUP_OSAL_EVT_BENCH_TIMER                          0x2000
 
 
 //#define FLOW_CTRL_IO_UART_TX          P18 //mobile --> ble --> uart --> host
@@ -12,10 +12,20 @@
 #include "bleuart_protocol.h"
 //#include "bleuart.h"
 #include "bleuart_service.h"
+#include "cliface.h"
+#include <stddef.h>
 
 #define UART_RX_BUF_SIZE  1024 //512
 #define UART_TX_BUF_SIZE  512
 
+#define BUP_RX_BANK_SIZE  (UART_RX_BUF_SIZE/2)
+#define BUP_RX_HOLD_LEVEL (BUP_RX_BANK_SIZE - BUP_RX_BANK_SIZE/4)  //hold the host off at 3/4 of a bank
+
+//notifications queued per connection event, BLE_MAX_ALLOW_PKT_PER_EVENT_TX in main.c
+#ifndef BUP_TX_CREDITS
+#define BUP_TX_CREDITS    4
+#endif
+
 uint8 AT_BLEUART_EVT=0;
 
 uint32 UART_Baudrate = 115200;
@@ -42,28 +52,47 @@ enum{
   BUP_TX_ST_SENDING
 };
 
+//uart -> ble: the uart isr fills one bank while the other one is notified
+typedef struct{
+  uint16_t size;
+  uint16_t offset;
+  uint8_t  buf[BUP_RX_BANK_SIZE];
+}BUP_bank_t;
+
 typedef struct{
   bool    conn_state;
-  //uart_rx
+  //uart rx
   uint8_t rx_state;
-  uint8_t rx_size;
-  uint8_t rx_offset;
-  uint8_t rx_buf[UART_RX_BUF_SIZE];
+  uint8_t rx_fill;          //bank written by uart isr, rx_fill^1 is drained to ble
+  bool    rx_hold;          //host held off by FLOW_CTRL_BLE_TX_LOCK
+  uint8_t credits;          //notifications left for the current connection event
+  uint16_t rx_frame;        //notification payload, ATT_MTU - 3
+  BUP_bank_t rx_bank[2];
 
-  //uart tx
+  //uart tx, filled from ble while hal_uart_tx_buf is being sent
   uint8_t tx_state;
-  uint8_t tx_size;
+  uint16_t tx_size;
   uint8_t tx_buf[UART_TX_BUF_SIZE];
 
-
-  uint8_t hal_uart_rx_size;
-  uint8_t hal_uart_rx_buf[UART_RX_BUF_SIZE];
   uint8_t hal_uart_tx_buf[UART_TX_BUF_SIZE];
-  
+
+#if(BUP_BENCHMARK)
+  uint32_t bench_u2b;       //bytes notified
+  uint32_t bench_b2u;       //bytes handed to uart
+  uint32_t bench_drop;      //bytes lost on either side
+  uint32_t bench_stall;     //controller full before credits ran out
+  uint32_t bench_time;
+#endif
 }BUP_ctx_t;
 
 BUP_ctx_t mBUP_Ctx;
 
+#if(BUP_BENCHMARK)
+#define BUP_BENCH_ADD(x, n)   (mBUP_Ctx.x += (n))
+#else
+#define BUP_BENCH_ADD(x, n)
+#endif
+
 int BUP_disconnect_handler(void);
 
 
@@ -93,94 +122,82 @@ static void tx_start_timer(uint16_t timeout)
 
 //}
 
-//timer for uart send delay slot
-static void rx_start_timer(uint16_t timeout)
+//called from uart isr
+static void uart_rx_to_bank(uint8_t* pdata, uint16_t len)
 {
-  LOG("uart start Timer\n");
-  osal_start_timerEx(bleuart_TaskID, BUP_OSAL_EVT_UARTRX_TIMER, timeout);
+  BUP_ctx_t* pctx = & mBUP_Ctx;
+  BUP_bank_t* bank = &pctx->rx_bank[pctx->rx_fill];
+
+  if(pctx->conn_state == FALSE){
+    BUP_BENCH_ADD(bench_drop, len);
+    return;
+  }
+
+  if(bank->size + len > BUP_RX_BANK_SIZE){
+    //ble side still busy with the other bank
+    BUP_BENCH_ADD(bench_drop, bank->size + len - BUP_RX_BANK_SIZE);
+    len = BUP_RX_BANK_SIZE - bank->size;
+  }
+  memcpy(bank->buf + bank->size, pdata, len);
+  bank->size += len;
+
+  if(bank->size >= BUP_RX_HOLD_LEVEL && pctx->rx_hold == FALSE){
+    pctx->rx_hold = TRUE;
+    FLOW_CTRL_BLE_TX_LOCK();
+  }
+
+  //a full frame is waiting, no need to wait for the idle timeout
+  if(bank->size >= pctx->rx_frame)
+    osal_set_event(bleuart_TaskID, BUP_OSAL_EVT_UARTRX_TIMER);
+  uartrx_timeout_timer_stop();
+  uartrx_timeout_timer_start();
 }
 
-//static void rx_stop_timer(void)
-//{
-//  osal_stop_timerEx(bleuart_TaskID, BUP_OSAL_EVT_UARTRX_TIMER);
+//drain bank is empty, hand it back to the uart isr and take the filled one
+static bool uart_rx_bank_swap(void)
+{
+  BUP_ctx_t* pctx = & mBUP_Ctx;
+  BUP_bank_t* bank = &pctx->rx_bank[pctx->rx_fill ^ 1];
+  bool swapped = FALSE;
+
+  HAL_ENTER_CRITICAL_SECTION();
+  bank->size = 0;
+  bank->offset = 0;
+  if(pctx->rx_bank[pctx->rx_fill].size){
+    pctx->rx_fill ^= 1;
+    swapped = TRUE;
+  }
+  if(pctx->rx_hold){
+    pctx->rx_hold = FALSE;
+    FLOW_CTRL_BLE_TX_UNLOCK();
+  }
+  HAL_EXIT_CRITICAL_SECTION();
 
-//}
-//int s_cnt = 0;
+  return swapped;
+}
 
 void uart_evt_hdl(uart_Evt_t* pev)
 {
-  BUP_ctx_t* pctx = & mBUP_Ctx;
   AT_BLEUART_RX_t* at_rx = & at_bleuart_rx;
-//  uint16_t conn_hdl;
-//  GAPRole_GetParameter( GAPROLE_CONNHANDLE, &conn_hdl);
-//  if(conn_hdl == INVALID_CONNHANDLE){
-//    BUP_disconnect_handler();
-//    return;
-//  }
+
   switch(pev->type){
     case  UART_EVT_TYPE_RX_DATA:
-			if((pctx->hal_uart_rx_size + pev->len)>=UART_RX_BUF_SIZE)
-				break;
-
-/***************************************************************************************************************************/
-//ڽATָ
-	if(Bleuart_C_D==0)
-	{	
-		osal_stop_timerEx(bleuart_TaskID, BUP_OSAL_EVT_AT);
-		osal_start_timerEx(bleuart_TaskID, BUP_OSAL_EVT_AT, 10);
-		
-		memcpy(at_rx->data + at_rx->len, pev->data, pev->len);
-		at_rx->len += pev->len;
-//		LOG("LEN:%d\n",pev->len);
-//		LOG("RXLEN:%d\n",at_rx->len);
-		return ;
-	}		
-/***************************************************************************************************************************/
-	else
-	{
-			
-	  uartrx_timeout_timer_stop();
-      uartrx_timeout_timer_start();
-      memcpy(pctx->hal_uart_rx_buf + pctx->hal_uart_rx_size, pev->data, pev->len);
-      pctx->hal_uart_rx_size += pev->len;
-
-//			LOG("LEN1:%d\n",pev->len);
-//			LOG("RXLEN1:%d\n",pctx->hal_uart_rx_size);
-	}
-//			uartrx_timeout_timer_stop();
-//      uartrx_timeout_timer_start();
-//      memcpy(pctx->hal_uart_rx_buf + pctx->hal_uart_rx_size, pev->data, pev->len);
-//      pctx->hal_uart_rx_size += pev->len;
-      break;
     case  UART_EVT_TYPE_RX_DATA_TO:
-			if((pctx->hal_uart_rx_size + pev->len)>=UART_RX_BUF_SIZE)
-				break;
-			
 /***************************************************************************************************************************/
 //ڽATָ
 	if(Bleuart_C_D==0)
 	{	
+		if((at_rx->len + pev->len) > sizeof(at_rx->data))
+			break;
 		osal_stop_timerEx(bleuart_TaskID, BUP_OSAL_EVT_AT);
 		osal_start_timerEx(bleuart_TaskID, BUP_OSAL_EVT_AT, 10);
 		
 		memcpy(at_rx->data + at_rx->len, pev->data, pev->len);
 		at_rx->len += pev->len;
-//		LOG("LEN:%d\n",pev->len);
-//		LOG("RXLEN:%d\n",at_rx->len);
 		return ;
 	}		
 /***************************************************************************************************************************/
-	else
-	{
-			
-			uartrx_timeout_timer_stop();
-      uartrx_timeout_timer_start();
-      memcpy(pctx->hal_uart_rx_buf + pctx->hal_uart_rx_size, pev->data, pev->len);
-      pctx->hal_uart_rx_size += pev->len;
-      //BUP_data_uart_to_BLE();
-    } 
-      //pctx->hal_uart_rx_size = 0;
-      //LOG("uart_evt_hdl: %d\n", pev->type);
+      uart_rx_to_bank(pev->data, pev->len);
       break;
   case  UART_EVT_TYPE_TX_COMPLETED:
     osal_set_event(bleuart_TaskID, BUP_OSAL_EVT_UART_TX_COMPLETE);
@@ -233,22 +250,20 @@ int BUP_data_BLE_to_uart_completed(void)
     return PPlus_SUCCESS;
   }
   //case no data in buffer
- // FLOW_CTRL_UART_TX_UNLOCK();
+  FLOW_CTRL_UART_TX_UNLOCK();
   pctx->tx_state = BUP_TX_ST_IDLE;
   return PPlus_SUCCESS;
 }
 
-//uint16_t s_buf[32];
-
 int BUP_data_BLE_to_uart_send(void)
 {
   BUP_ctx_t* pctx = &mBUP_Ctx;
 
   if(pctx->tx_state != BUP_TX_ST_IDLE && pctx->tx_size)
   {
-    //s_buf[s_cnt%32] = pctx->tx_size;
-    //s_cnt++;
+    //hal_uart_send_buff copies into hal_uart_tx_buf, tx_buf is free again for ble
     hal_uart_send_buff(UART1,pctx->tx_buf, pctx->tx_size);
+    BUP_BENCH_ADD(bench_b2u, pctx->tx_size);
     pctx->tx_size = 0;
     pctx->tx_state = BUP_TX_ST_SENDING;
     return PPlus_SUCCESS;
@@ -258,9 +273,19 @@ int BUP_data_BLE_to_uart_send(void)
   return PPlus_ERR_INVALID_STATE;
 }
 
-int BUP_data_BLE_to_uart(uint8_t* pdata, uint8_t size)
+/*
+ * Returns PPlus_ERR_NO_MEM if tx_buf can't take the data yet, the write
+ * callback then rejects a write request so the client retries it.
+ */
+int BUP_data_BLE_to_uart(uint8_t* pdata, uint16_t size)
 {
   BUP_ctx_t* pctx = &mBUP_Ctx;
+
+  if(pctx->tx_size + size > UART_TX_BUF_SIZE){
+    BUP_BENCH_ADD(bench_drop, size);
+    return PPlus_ERR_NO_MEM;
+  }
+
   switch(pctx->tx_state){
   case BUP_TX_ST_IDLE:
     memcpy(pctx->tx_buf + pctx->tx_size, pdata, size);
@@ -284,138 +309,113 @@ int BUP_data_BLE_to_uart(uint8_t* pdata, uint8_t size)
 }
 
 
+/*
+ * Notify the drain bank while credits for this connection event are left.
+ * Runs on every full frame from uart, on the uart idle timeout and on each
+ * connection event done notice, which also refills the credits.
+ */
 int BUP_data_uart_to_BLE_send(void)
 {
   BUP_ctx_t* pctx = &mBUP_Ctx;
-  bool start_flg = FALSE;
-  uint16 mtu_size=0;
-	
-	 bStatus_t ret = 0;
-	
-	mtu_size=gAttMtuSize[gapConnHandle];
-  LOG("mtu=%d,%d,%d\n",gAttMtuSize[gapConnHandle],pctx->rx_state,pctx->rx_size);
-//	if(mtu_size>200)
-//	{
-//		mtu_size=200;
-//	}	
-//	else
-	{
-		mtu_size -=3;
-	}	
-	
-//  hal_pwrmgr_unlock(MOD_USR1);
-  if(pctx->rx_state != BUP_RX_ST_IDLE && pctx->rx_size)
-  {
-    //LOG1("cnt:%d",s_cnt);
-    if(bleuart_NotifyIsReady() == FALSE)
-      return PPlus_ERR_BLE_NOT_READY;
-
-    if(pctx->rx_state == BUP_RX_ST_DELAY_SLOT){
-      start_flg = TRUE;
-      FLOW_CTRL_BLE_TX_LOCK();
-      pctx->rx_state = BUP_RX_ST_SENDING;
-    }
-    
-    while(1){
-      uint8_t size =0;
-     
-      attHandleValueNoti_t notify_data={0};
-      size = ((pctx->rx_size - pctx->rx_offset) > mtu_size) ? mtu_size : pctx->rx_size - pctx->rx_offset;
-
-      memcpy(notify_data.value,pctx->rx_buf + pctx->rx_offset, size);
-      notify_data.len = size;
-      
-      ret = bleuart_Notify(gapConnHandle, &notify_data, bleuart_TaskID);
-			LOG("bleuart_Notify: %d, %d, %d\n", ret,pctx->rx_offset, pctx->rx_size);
-      if(ret == SUCCESS){
-        pctx->rx_offset += size;
-      }
-      else
-      {
-				LOG("TX R=%x\n",ret);
-        if(ret == MSG_BUFFER_NOT_AVAIL){
-          if(start_flg){
-            rx_start_timer(1);
-          }
-          else
-          {
-            rx_start_timer(bleuart_conn_interval()-1);
-          }
-          return PPlus_SUCCESS;
-        }
-        else
-        {
-          return PPlus_ERR_BUSY;
-        }
-      }
-      
-      if(pctx->rx_offset == pctx->rx_size){
-        LOG("Success\n");
+  BUP_bank_t* bank;
+  attHandleValueNoti_t notify_data;
+  uint16_t size;
+  bStatus_t ret;
+
+  if(pctx->conn_state == FALSE)
+    return PPlus_ERR_INVALID_STATE;
+  if(bleuart_NotifyIsReady() == FALSE)
+    return PPlus_ERR_BLE_NOT_READY;
+
+  pctx->rx_frame = gAttMtuSize[gapConnHandle] - 3;
+  if(pctx->rx_frame > sizeof(notify_data.value))
+    pctx->rx_frame = sizeof(notify_data.value);
+
+  while(pctx->credits){
+    bank = &pctx->rx_bank[pctx->rx_fill ^ 1];
+    if(bank->offset == bank->size){
+      if(uart_rx_bank_swap() == FALSE){
         pctx->rx_state = BUP_RX_ST_IDLE;
-        pctx->rx_offset = 0;
-        pctx->rx_size = 0;
-        FLOW_CTRL_BLE_TX_UNLOCK();
         return PPlus_SUCCESS;
       }
+      continue;
+    }
+
+    pctx->rx_state = BUP_RX_ST_SENDING;
+    size = bank->size - bank->offset;
+    if(size > pctx->rx_frame)
+      size = pctx->rx_frame;
 
+    memcpy(notify_data.value, bank->buf + bank->offset, size);
+    notify_data.len = (uint8)size;
+
+    ret = bleuart_Notify(gapConnHandle, &notify_data, bleuart_TaskID);
+    if(ret != SUCCESS){
+      //controller queue is full, resume at the next connection event
+      pctx->credits = 0;
+      BUP_BENCH_ADD(bench_stall, 1);
+      if(ret == MSG_BUFFER_NOT_AVAIL)
+        return PPlus_SUCCESS;
+      LOG("TX R=%x\n",ret);
+      return PPlus_ERR_BUSY;
     }
-  
+    bank->offset += size;
+    pctx->credits--;
+    BUP_BENCH_ADD(bench_u2b, size);
   }
-	else
-	{
-		LOG("U2B s=:%x,%x",pctx->rx_state,pctx->rx_size);
-		  pctx->rx_state = BUP_RX_ST_IDLE;
-        pctx->rx_offset = 0;
-        pctx->rx_size = 0;
-		 FLOW_CTRL_BLE_TX_UNLOCK();
-	}	
-
-  LOG("U2B ret : %x\n",ret);
-  return PPlus_ERR_INVALID_STATE;
+  return PPlus_SUCCESS;
 }
 
+//uart idle timeout, push out what is left in the banks
 int BUP_data_uart_to_BLE(void)
 {
   BUP_ctx_t* pctx = &mBUP_Ctx;
-//  LOG("BUP_data_uart_to_BLE\n");
+
   if(pctx->conn_state == FALSE){
 		LOG("no cnt\n");
-    pctx->rx_size = 0;
-    pctx->rx_offset = 0;
-    pctx->hal_uart_rx_size = 0;
     return PPlus_ERR_INVALID_STATE;
   }
-  memcpy(pctx->rx_buf + pctx->rx_size, pctx->hal_uart_rx_buf, pctx->hal_uart_rx_size);
-  if(pctx->rx_offset != 0){
-    return PPlus_ERR_BUSY;
+  return BUP_data_uart_to_BLE_send();
+}
 
-  }
-	//s_cnt++;
-  //if(pctx->hal_uart_rx_size != 80){
-  //  s_cnt++;
-  //}
-  pctx->rx_size += pctx->hal_uart_rx_size;
-  
-	pctx->hal_uart_rx_size = 0;
-  switch(pctx->rx_state){
-  case BUP_RX_ST_IDLE:
-    pctx->rx_state = BUP_RX_ST_DELAY_SLOT;
-    rx_start_timer(1);  //1ms delay slot
-    break;
-  case BUP_RX_ST_DELAY_SLOT:
-  case BUP_RX_ST_SENDING:
-  default:
-    //drop data
-	LOG("U2B err:%d\n",pctx->rx_state);
-    return PPlus_ERR_INVALID_STATE;
-  }
-  return PPlus_SUCCESS;
+int BUP_conn_event_done(void)
+{
+  mBUP_Ctx.credits = BUP_TX_CREDITS;
+  return BUP_data_uart_to_BLE_send();
+}
 
+#if(BUP_BENCHMARK)
+void BUP_bench_report(void)
+{
+  BUP_ctx_t* pctx = &mBUP_Ctx;
+  uint32_t now = osal_GetSystemClock();
+  uint32_t ms = now - pctx->bench_time;
+
+  if(ms == 0)
+    return;
+  //bytes*8/ms is kbit/s, one decimal
+  LOG("[BUP] u2b %d.%d kbps, b2u %d.%d kbps, drop %d, stall %d\n",
+      (pctx->bench_u2b*80/ms)/10, (pctx->bench_u2b*80/ms)%10,
+      (pctx->bench_b2u*80/ms)/10, (pctx->bench_b2u*80/ms)%10,
+      pctx->bench_drop, pctx->bench_stall);
+  HAL_ENTER_CRITICAL_SECTION();
+  pctx->bench_u2b = 0;
+  pctx->bench_b2u = 0;
+  pctx->bench_drop = 0;
+  pctx->bench_stall = 0;
+  HAL_EXIT_CRITICAL_SECTION();
+  pctx->bench_time = now;
 }
+#endif
 
 int BUP_disconnect_handler(void)
 {
+#if(BUP_BENCHMARK)
+  osal_stop_timerEx(bleuart_TaskID, BUP_OSAL_EVT_BENCH_TIMER);
+#endif
+  HAL_ENTER_CRITICAL_SECTION();
   memset(&mBUP_Ctx, 0, sizeof(mBUP_Ctx));
+  HAL_EXIT_CRITICAL_SECTION();
 //  hal_gpio_write(FLOW_CTRL_IO_UART_TX, 0);
 //  hal_gpio_write(FLOW_CTRL_IO_BLE_TX, 0);
 //  hal_gpio_write(FLOW_CTRL_IO_BLE_CONNECTION, 0);
@@ -426,8 +426,16 @@ int BUP_disconnect_handler(void)
 int BUP_connect_handler(void)
 {
   if(mBUP_Ctx.conn_state == FALSE){
+    HAL_ENTER_CRITICAL_SECTION();
     memset(&mBUP_Ctx, 0, sizeof(mBUP_Ctx));
+    mBUP_Ctx.rx_frame = ATT_MTU_SIZE_MIN - 3;
+    mBUP_Ctx.credits = BUP_TX_CREDITS;
     mBUP_Ctx.conn_state = TRUE;
+    HAL_EXIT_CRITICAL_SECTION();
+#if(BUP_BENCHMARK)
+    mBUP_Ctx.bench_time = osal_GetSystemClock();
+    osal_start_reload_timer(bleuart_TaskID, BUP_OSAL_EVT_BENCH_TIMER, BUP_BENCH_PERIOD);
+#endif
 //    hal_gpio_write(FLOW_CTRL_IO_UART_TX, 0);
 //    hal_gpio_write(FLOW_CTRL_IO_BLE_TX, 0);
 //    hal_gpio_write(FLOW_CTRL_IO_BLE_CONNECTION, 0);
@@ -499,264 +507,6 @@ void AT_Response(UART_INDEX_e uart_index,AT_BLEUART_RX_t* pev,uint8_t *buff,uint
 
 
 
-uint8 AT_query(AT_BLEUART_RX_t* pev)
-{
-	if(((pev->data[0])==0x41)&&((pev->data[1])==0x54)&&((pev->data[2])==0x2B)&&((pev->data[(pev->len)-2])==0x0D)&&((pev->data[(pev->len)-1])==0x0A))
-	{
-		//ָ52 45 53 45 54
-		if(((pev->len)==10)&&((pev->data[3])==0x52)&&((pev->data[4])==0x45)&&((pev->data[5])==0x53)&&((pev->data[6])==0x45)&&((pev->data[7])==0x54))
-		{
-			uint8 response[pev->len+4];
-			
-			Modify_BLEDevice_Data = 3;
-			osal_snv_write(0x80,1,&Modify_BLEDevice_Data);
-			
-			memcpy(response, pev->data, pev->len);
-			response[pev->len]=0x4f;
-			response[pev->len+1]=0x4b;
-			response[pev->len+2]=0x0d;
-			response[pev->len+3]=0x0a;
-			hal_uart_send_buff(UART1,response, pev->len+4);
-			NVIC_SystemReset();
-			return 0;
-		}
-		//Ͽǰ44 49 53 43 4F 4E 4E
-		if(((pev->len)==12)&&((pev->data[3])==0x44)&&((pev->data[4])==0x49)&&((pev->data[5])==0x53)&&((pev->data[6])==0x43)&&((pev->data[7])==0x4F)&&((pev->data[8])==0x4E)&&((pev->data[9])==0x4E))
-		{
-			uint8 response[pev->len+4];
-			GAPRole_TerminateConnection();
-			memcpy(response, pev->data, pev->len);
-			response[pev->len]=0x4f;
-			response[pev->len+1]=0x4b;
-			response[pev->len+2]=0x0d;
-			response[pev->len+3]=0x0a;
-			hal_uart_send_buff(UART1,response, pev->len+4);
-			return 0;
-		}
-		//5A
-		if(((pev->len)==6)&&((pev->data[3])==0x5A))
-		{
-			uint8 response[pev->len+4];
-			memcpy(response, pev->data, pev->len);
-			response[pev->len]=0x4f;
-			response[pev->len+1]=0x4b;
-			response[pev->len+2]=0x0d;
-			response[pev->len+3]=0x0a;
-			hal_uart_send_buff(UART1,response, pev->len+4);
-			NVIC_SystemReset();
-			return 0;
-		}
-		//ý͸ģʽ2B 2B 2B
-		if(((pev->len)==8)&&((pev->data[3])==0x2B)&&((pev->data[4])==0x2B)&&((pev->data[5])==0x2B))
-		{
-			uint8 response[pev->len+4];
-			Bleuart_C_D=1;
-			memcpy(response, pev->data, pev->len);
-			response[pev->len]=0x4f;
-			response[pev->len+1]=0x4b;
-			response[pev->len+2]=0x0d;
-			response[pev->len+3]=0x0a;
-			hal_uart_send_buff(UART1,response, pev->len+4);
-			return 0;
-		}
-		//FLASH46 4C 41 53 48
-		if(((pev->len)==10)&&((pev->data[3])==0x46)&&((pev->data[4])==0x4C)&&((pev->data[5])==0x41)&&((pev->data[6])==0x53)&&((pev->data[7])==0x48))
-		{
-			uint8 response[pev->len+4];
-			uint8 at_mac_addr[6];
-			
-			uint8 uart_baudrate[4]={BREAK_UINT32(UART_Baudrate,3),BREAK_UINT32(UART_Baudrate,2),BREAK_UINT32(UART_Baudrate,1),BREAK_UINT32(UART_Baudrate,0)};
-			osal_snv_read(0x89,6,at_mac_addr);
-			
-			osal_snv_write(0x81,20,&(scanR[2]));				// 20 Bytes Device Name
-			osal_snv_write(0x82,6,at_mac_addr);					// 6 Bytes MAC address
-			osal_snv_write(0x83,4,uart_baudrate);				// 4 Bytes uart_baudrate
-			osal_snv_write(0x84,1,&advint);						// 1 Byte Advert interval
-			osal_snv_write(0x85,1,&AT_bleuart_auto);			// 1 Byte BLE_UART AUTO
-			osal_snv_write(0x86,1,&AT_bleuart_sleep);			// 1 Byte SLEEP MODE
-			osal_snv_write(0x87,1,&AT_bleuart_txpower);			// 1 Byte TX power
-			osal_snv_write(0x88,8,&(advertdata[23]));			// 8 Bytes reserved data
-			
-			memcpy(response, pev->data, pev->len);
-			response[pev->len]=0x4f;
-			response[pev->len+1]=0x4b;
-			response[pev->len+2]=0x0d;
-			response[pev->len+3]=0x0a;
-			hal_uart_send_buff(UART1,response, pev->len+4);
-			return 1;
-		}
-		
-		//ѯ豸4E 41 4D 45 3F
-		if(((pev->len)==10)&&((pev->data[3])==0x4E)&&((pev->data[4])==0x41)&&((pev->data[5])==0x4D)&&((pev->data[6])==0x45)&&((pev->data[7])==0x3F))
-		{
-			uint8 device_name[20];
-			memcpy(device_name, &(scanR[2]), 20);
-			AT_Response(UART1,pev,device_name,20);
-			return 0;
-		}
-//		//ѯ豸ģʽ4D 4F 44 45 3F
-//		if(((pev->len)==10)&&((pev->data[3])==0x4D)&&((pev->data[4])==0x4F)&&((pev->data[5])==0x44)&&((pev->data[6])==0x45)&&((pev->data[7])==0x3F))
-//		{
-//			
-//			return 0;
-//		}
-		//ѯMACַ4D 41 43 3F
-		if(((pev->len)==9)&&((pev->data[3])==0x4D)&&((pev->data[4])==0x41)&&((pev->data[5])==0x43)&&((pev->data[6])==0x3F))
-		{
-			uint8 at_mac_address[6];
-			uint8 mac_addr[12];
-			uint8 i,j;
-			hal_flash_read(0x4004,at_mac_address,2);   //ȡmacַ
-			hal_flash_read(0x4000,at_mac_address+2,4);
-			
-			for(i=0,j=0;i<6;i++,j++)
-			{
-				if((((at_mac_address[i])>>4)<=9)&&(((at_mac_address[i])>>4)>=0))
-				{
-					mac_addr[j]=((at_mac_address[i])>>4)+0x30;
-				}
-				else
-				{
-					mac_addr[j]=((at_mac_address[i])>>4)+0x37;
-				}
-				
-				j=j+1;
-				
-				if(((at_mac_address[i]&0x0f)<=9)&&((at_mac_address[i]&0x0f)>=0))
-				{
-					mac_addr[j]=(at_mac_address[i]&0x0f)+0x30;
-				}
-				else
-				{
-					mac_addr[j]=(at_mac_address[i]&0x0f)+0x37;
-				}
-			}
-			
-			AT_Response(UART1,pev,mac_addr,12);
-			return 0;
-		}
-		//ѯ汾43 49 56 45 52 3F
-		if(((pev->len)==11)&&((pev->data[3])==0x43)&&((pev->data[4])==0x49)&&((pev->data[5])==0x56)&&((pev->data[6])==0x45)&&((pev->data[7])==0x52)&&((pev->data[8])==0x3F))
-		{
-			AT_Response(UART1,pev,AT_FW_version,sizeof (AT_FW_version));
-			return 0;
-		}
-		//ѯڲ55 41 52 54 3F
-		if(((pev->len)==10)&&((pev->data[3])==0x55)&&((pev->data[4])==0x41)&&((pev->data[5])==0x52)&&((pev->data[6])==0x54)&&((pev->data[7])==0x3F))
-		{
-			uint8 uart_baudrate[4]={BREAK_UINT32(UART_Baudrate,3),BREAK_UINT32(UART_Baudrate,2),BREAK_UINT32(UART_Baudrate,1),BREAK_UINT32(UART_Baudrate,0)};
-			AT_Response(UART1,pev,uart_baudrate,4);
-			return 0;
-		}
-		//ѯϺǷԶ͸ģʽ41 55 54 4F 2B 2B 2B 3F
-		if(((pev->len)==13)&&((pev->data[3])==0x41)&&((pev->data[4])==0x55)&&((pev->data[5])==0x54)&&((pev->data[6])==0x4F)&&((pev->data[7])==0x2B)&&((pev->data[8])==0x2B)&&((pev->data[9])==0x2B)&&((pev->data[10])==0x3F))
-		{
-			uint8 at_bleuart_auto;
-			osal_snv_read(0x85,1,&at_bleuart_auto);
-			AT_Response(UART1,pev,&at_bleuart_auto,1);
-			return 0;
-		}
-		//ѯ״̬4C 49 4E 4B 3F
-		if(((pev->len)==10)&&((pev->data[3])==0x4C)&&((pev->data[4])==0x49)&&((pev->data[5])==0x4E)&&((pev->data[6])==0x4B)&&((pev->data[7])==0x3F))
-		{
-			uint16_t conn_hdl;
-			uint8 conn_online[6]={0x4f,0x6e,0x4c,0x69,0x6e,0x65};
-			uint8 conn_offline[7]={0x4f,0x66,0x66,0x4c,0x69,0x6e,0x65};
-			GAPRole_GetParameter( GAPROLE_CONNHANDLE, &conn_hdl);
-			if(conn_hdl == INVALID_CONNHANDLE)
-			{
-				AT_Response(UART1,pev,conn_offline,7);
-			}
-			else
-			{
-				AT_Response(UART1,pev,conn_online, 6);
-			}
-			return 0;
-		}
-		//ѯ㲥41 44 56 49 4E 54 3F
-		if(((pev->len)==12)&&((pev->data[3])==0x41)&&((pev->data[4])==0x44)&&((pev->data[5])==0x56)&&((pev->data[6])==0x49)&&((pev->data[7])==0x4E)&&((pev->data[8])==0x54)&&((pev->data[9])==0x3F))
-		{
-			AT_Response(UART1,pev,&advint, 1);
-			return 0;
-		}
-		//ѯ书50 4F 57 45 52 3F
-		if(((pev->len)==11)&&((pev->data[3])==0x50)&&((pev->data[4])==0x4F)&&((pev->data[5])==0x57)&&((pev->data[6])==0x45)&&((pev->data[7])==0x52)&&((pev->data[8])==0x3F))
-		{
-			uint8 at_power;
-			if(g_rfPhyTxPower==RF_PHY_TX_POWER_MAX)
-			{
-				at_power=0x00;
-			}
-			else if(g_rfPhyTxPower==RF_PHY_TX_POWER_5DBM)
-			{
-				at_power=0x01;
-			}
-			else if(g_rfPhyTxPower==RF_PHY_TX_POWER_4DBM)
-			{
-				at_power=0x02;
-			}
-			else if(g_rfPhyTxPower==RF_PHY_TX_POWER_3DBM)
-			{
-				at_power=0x03;
-			}
-			else if(g_rfPhyTxPower==RF_PHY_TX_POWER_0DBM)
-			{
-				at_power=0x04;
-			}
-			else if(g_rfPhyTxPower==RF_PHY_TX_POWER_N2DBM)
-			{
-				at_power=0x05;
-			}
-			else if(g_rfPhyTxPower==RF_PHY_TX_POWER_N5DBM)
-			{
-				at_power=0x06;
-			}
-			else if(g_rfPhyTxPower==RF_PHY_TX_POWER_N10DBM)
-			{
-				at_power=0x07;
-			}
-			AT_Response(UART1,pev,&at_power, 1);
-			return 0;
-		}
-		//ѯUUID 55 55 49 44 3F
-		if(((pev->len)==10)&&((pev->data[3])==0x55)&&((pev->data[4])==0x55)&&((pev->data[5])==0x49)&&((pev->data[6])==0x44)&&((pev->data[7])==0x3F))
-		{
-			uint8 service_uuid[41]={0x41,0x54,0x2B,0x62,0x6c,0x65,0x55,0x61,0x72,0x74,0x5f,0x53,0x65,0x72,0x76,0x65,0x72,0x5f,0x55,0x75,0x69,0x64,0x3a};
-			uint8 service_tx_uuid[44]={0x41,0x54,0x2B,0x62,0x6c,0x65,0x55,0x61,0x72,0x74,0x5f,0x53,0x65,0x72,0x76,0x65,0x72,0x5f,0x54,0x78,0x5f,0x55,0x75,0x69,0x64,0x3a};
-			uint8 service_rx_uuid[44]={0x41,0x54,0x2B,0x62,0x6c,0x65,0x55,0x61,0x72,0x74,0x5f,0x53,0x65,0x72,0x76,0x65,0x72,0x5f,0x52,0x78,0x5f,0x55,0x75,0x69,0x64,0x3a};
-				
-			memcpy(&service_uuid[23], bleuart_ServiceUUID, 16);
-			service_uuid[39]=0x0d;
-			service_uuid[40]=0x0a;
-			memcpy(&service_tx_uuid[26], bleuart_TxCharUUID, 16);
-			service_tx_uuid[42]=0x0d;
-			service_tx_uuid[43]=0x0a;
-			memcpy(&service_rx_uuid[26], bleuart_RxCharUUID, 16);
-			service_rx_uuid[42]=0x0d;
-			service_rx_uuid[43]=0x0a;
-
-			hal_uart_send_buff(UART1,service_uuid, 41);
-			WaitMs(50);
-			hal_uart_send_buff(UART1,service_tx_uuid, 44);
-			WaitMs(50);
-			hal_uart_send_buff(UART1,service_rx_uuid, 44);
-			return 0;
-		}
-		//ѯԶ㲥52 45 53 45 3F
-		if(((pev->len)==10)&&((pev->data[3])==0x52)&&((pev->data[4])==0x45)&&((pev->data[5])==0x53)&&((pev->data[6])==0x45)&&((pev->data[7])==0x3F))
-		{
-			uint8 reserved_data[8];
-			memcpy(reserved_data, &(advertdata[23]), 8);
-			AT_Response(UART1,pev,reserved_data,8);
-			return 0;
-		}
-	}
-	return 2;
-}
-
-
-
-
 //void AT_Response(UART_INDEX_e uart_index,AT_BLEUART_RX_t* pev,uint8_t *buff,uint8 len)
 //{
 //	uint8 at_response[30]={0};
@@ -800,96 +550,360 @@ void AT_Response2(UART_INDEX_e uart_index,AT_BLEUART_RX_t* pev,uint8_t *buff,uin
 
 
 
-uint8 AT_setdata(AT_BLEUART_RX_t* pev)
+//echo the command followed by OK\r\n
+static void AT_Ack(AT_BLEUART_RX_t* pev)
+{
+	uint8 response[sizeof(pev->data)+4];
+
+	memcpy(response, pev->data, pev->len);
+	response[pev->len]=0x4f;
+	response[pev->len+1]=0x4b;
+	response[pev->len+2]=0x0d;
+	response[pev->len+3]=0x0a;
+	hal_uart_send_buff(UART1,response, pev->len+4);
+}
+
+//ָ52 45 53 45 54
+static uint8 AT_cmd_reset(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	Modify_BLEDevice_Data = 3;
+	osal_snv_write(0x80,1,&Modify_BLEDevice_Data);
+	AT_Ack(pev);
+	NVIC_SystemReset();
+	return AT_RET_OK;
+}
+
+//Ͽǰ44 49 53 43 4F 4E 4E
+static uint8 AT_cmd_disconn(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	GAPRole_TerminateConnection();
+	AT_Ack(pev);
+	return AT_RET_OK;
+}
+
+//5A
+static uint8 AT_cmd_reboot(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	AT_Ack(pev);
+	NVIC_SystemReset();
+	return AT_RET_OK;
+}
+
+//ý͸ģʽ2B 2B 2B
+static uint8 AT_cmd_passthrough(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
 {
-	if(((pev->data[0])==0x41)&&((pev->data[1])==0x54)&&((pev->data[2])==0x2B)&&((pev->data[(pev->len)-2])==0x0D)&&((pev->data[(pev->len)-1])==0x0A))
+	Bleuart_C_D=1;
+	AT_Ack(pev);
+	return AT_RET_OK;
+}
+
+//FLASH46 4C 41 53 48
+static uint8 AT_cmd_flash(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	uint8 at_mac_addr[6];
+	uint8 uart_baudrate[4]={BREAK_UINT32(UART_Baudrate,3),BREAK_UINT32(UART_Baudrate,2),BREAK_UINT32(UART_Baudrate,1),BREAK_UINT32(UART_Baudrate,0)};
+
+	osal_snv_read(0x89,6,at_mac_addr);
+	
+	osal_snv_write(0x81,20,&(scanR[2]));				// 20 Bytes Device Name
+	osal_snv_write(0x82,6,at_mac_addr);					// 6 Bytes MAC address
+	osal_snv_write(0x83,4,uart_baudrate);				// 4 Bytes uart_baudrate
+	osal_snv_write(0x84,1,&advint);						// 1 Byte Advert interval
+	osal_snv_write(0x85,1,&AT_bleuart_auto);			// 1 Byte BLE_UART AUTO
+	osal_snv_write(0x86,1,&AT_bleuart_sleep);			// 1 Byte SLEEP MODE
+	osal_snv_write(0x87,1,&AT_bleuart_txpower);			// 1 Byte TX power
+	osal_snv_write(0x88,8,&(advertdata[23]));			// 8 Bytes reserved data
+	
+	AT_Ack(pev);
+	return AT_RET_FLASH;
+}
+
+//ѯ豸4E 41 4D 45 3F
+static uint8 AT_cmd_name_get(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	AT_Response(UART1,pev,&(scanR[2]),20);
+	return AT_RET_OK;
+}
+
+//ѯMACַ4D 41 43 3F
+static uint8 AT_cmd_mac_get(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	static const uint8 hex[16] = "0123456789ABCDEF";
+	uint8 at_mac_address[6];
+	uint8 mac_addr[12];
+	uint8 i;
+
+	hal_flash_read(0x4004,at_mac_address,2);   //read mac address
+	hal_flash_read(0x4000,at_mac_address+2,4);
+	
+	for(i=0;i<6;i++)
 	{
-		//豸4E 41 4D 45 3D
-		if(((pev->len)<=30)&&((pev->data[3])==0x4E)&&((pev->data[4])==0x41)&&((pev->data[5])==0x4D)&&((pev->data[6])==0x45)&&((pev->data[7])==0x3D))
-		{
-			uint8 i;
-			for(i=0;i<(pev->len-10);i++)
-			{
-				scanR[i+2]=pev->data[i+8] ;
-			}
-			for(;i<20;i++)
-			{
-				scanR[i+2]=0x20;
-			}
-			AT_Response2(UART1,pev,&scanR[2], 20, 7);
-			return 3;
-		}
-//		//豸ģʽ4D 4F 44 45 3D
-//		if(((pev->data[3])==0x4D)&&((pev->data[4])==0x4F)&&((pev->data[5])==0x44)&&((pev->data[6])==0x45)&&((pev->data[7])==0x3D))
-//		{
-//			return 0;
-//		}
-		//MACַ4D 41 43 3D
-		if(((pev->len)==15)&&((pev->data[3])==0x4D)&&((pev->data[4])==0x41)&&((pev->data[5])==0x43)&&((pev->data[6])==0x3D))
-		{
-			uint8 at_mac_address[6];
-			memcpy(at_mac_address, &pev->data[7], 6);
-			osal_snv_write(0x89,6,at_mac_address);
-			AT_Response2(UART1,pev,at_mac_address, 6, 6);
-			return 0;
-		}
-		//ôڲ55 41 52 54 3D
-		if(((pev->len)==14)&&((pev->data[3])==0x55)&&((pev->data[4])==0x41)&&((pev->data[5])==0x52)&&((pev->data[6])==0x54)&&((pev->data[7])==0x3D))
-		{
-			uint8 uart_baudrate[4];
-			memcpy(uart_baudrate, &pev->data[8], 4);
-			UART_Baudrate=BUILD_UINT32(uart_baudrate[3],uart_baudrate[2],uart_baudrate[1],uart_baudrate[0]);
-			AT_Response2(UART1,pev,uart_baudrate, 4, 7);
-			WaitMs(70);
-			hal_uart_deinit(UART1);
-			BUP_init(on_BUP_Evt);
-			return 0;
-		}
-//		//ÿ/ֹͣ˯ģʽ53 4C 45 45 50 3D
-//		if(((pev->len)==12)&&((pev->data[3])==0x53)&&((pev->data[4])==0x4C)&&((pev->data[5])==0x45)&&((pev->data[6])==0x45)&&((pev->data[7])==0x50)&&((pev->data[8])==0x3D))
-//		{
-//			return 0;
-//		}
-		//÷书50 4F 57 45 52 3D
-		if(((pev->len)==12)&&((pev->data[3])==0x50)&&((pev->data[4])==0x4F)&&((pev->data[5])==0x57)&&((pev->data[6])==0x45)&&((pev->data[7])==0x52)&&((pev->data[8])==0x3D))
-		{
-			AT_bleuart_txpower=pev->data[9];
-			AT_Response2(UART1,pev,&AT_bleuart_txpower, 1, 8);
-			return 3;
-		}
-		//ù㲥41 44 56 49 4E 54 3D
-		if(((pev->len)==13)&&((pev->data[3])==0x41)&&((pev->data[4])==0x44)&&((pev->data[5])==0x56)&&((pev->data[6])==0x49)&&((pev->data[7])==0x4E)&&((pev->data[8])==0x54)&&((pev->data[9])==0x3D))
-		{
-			advint=pev->data[10];
-			AT_Response2(UART1,pev,&advint, 1, 9);
-			return 3;
-		}
-		//ϺԶ͸ģʽ41 55 54 4F 2B 2B 2B 3D
-		if(((pev->len)==14)&&((pev->data[3])==0x41)&&((pev->data[4])==0x55)&&((pev->data[5])==0x54)&&((pev->data[6])==0x4F)&&((pev->data[7])==0x2B)&&((pev->data[8])==0x2B)&&((pev->data[9])==0x2B)&&((pev->data[10])==0x3D))
-		{
-			AT_bleuart_auto=pev->data[11];
-			AT_Response2(UART1,pev,&AT_bleuart_auto, 1, 10);
-			return 0;
-		}
-		//Զ㲥52 45 53 45 3D
-		if(((pev->len)==18)&&((pev->data[3])==0x52)&&((pev->data[4])==0x45)&&((pev->data[5])==0x53)&&((pev->data[6])==0x45)&&((pev->data[7])==0x3D))
-		{
-			memcpy(&(advertdata[23]), &(pev->data[8]), 8);
-			AT_Response2(UART1,pev,&(advertdata[23]), 8, 7);
-			return 3;
-		}
+		mac_addr[2*i]=hex[at_mac_address[i]>>4];
+		mac_addr[2*i+1]=hex[at_mac_address[i]&0x0f];
 	}
-	return 4;
+	
+	AT_Response(UART1,pev,mac_addr,12);
+	return AT_RET_OK;
 }
 
+//ѯ汾43 49 56 45 52 3F
+static uint8 AT_cmd_ver_get(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	AT_Response(UART1,pev,AT_FW_version,sizeof (AT_FW_version));
+	return AT_RET_OK;
+}
 
+//ѯڲ55 41 52 54 3F
+static uint8 AT_cmd_uart_get(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	uint8 uart_baudrate[4]={BREAK_UINT32(UART_Baudrate,3),BREAK_UINT32(UART_Baudrate,2),BREAK_UINT32(UART_Baudrate,1),BREAK_UINT32(UART_Baudrate,0)};
+	AT_Response(UART1,pev,uart_baudrate,4);
+	return AT_RET_OK;
+}
 
+//ѯϺǷԶ͸ģʽ41 55 54 4F 2B 2B 2B 3F
+static uint8 AT_cmd_auto_get(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	uint8 at_bleuart_auto;
+	osal_snv_read(0x85,1,&at_bleuart_auto);
+	AT_Response(UART1,pev,&at_bleuart_auto,1);
+	return AT_RET_OK;
+}
 
+//ѯ״̬4C 49 4E 4B 3F
+static uint8 AT_cmd_link_get(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	uint16_t conn_hdl;
+	uint8 conn_online[6]={0x4f,0x6e,0x4c,0x69,0x6e,0x65};
+	uint8 conn_offline[7]={0x4f,0x66,0x66,0x4c,0x69,0x6e,0x65};
+	GAPRole_GetParameter( GAPROLE_CONNHANDLE, &conn_hdl);
+	if(conn_hdl == INVALID_CONNHANDLE)
+	{
+		AT_Response(UART1,pev,conn_offline,7);
+	}
+	else
+	{
+		AT_Response(UART1,pev,conn_online, 6);
+	}
+	return AT_RET_OK;
+}
 
+//ѯ㲥41 44 56 49 4E 54 3F
+static uint8 AT_cmd_advint_get(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	AT_Response(UART1,pev,&advint, 1);
+	return AT_RET_OK;
+}
 
+//ѯ书50 4F 57 45 52 3F
+static uint8 AT_cmd_power_get(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	uint8 at_power=0x00;
+	if(g_rfPhyTxPower==RF_PHY_TX_POWER_MAX)
+	{
+		at_power=0x00;
+	}
+	else if(g_rfPhyTxPower==RF_PHY_TX_POWER_5DBM)
+	{
+		at_power=0x01;
+	}
+	else if(g_rfPhyTxPower==RF_PHY_TX_POWER_4DBM)
+	{
+		at_power=0x02;
+	}
+	else if(g_rfPhyTxPower==RF_PHY_TX_POWER_3DBM)
+	{
+		at_power=0x03;
+	}
+	else if(g_rfPhyTxPower==RF_PHY_TX_POWER_0DBM)
+	{
+		at_power=0x04;
+	}
+	else if(g_rfPhyTxPower==RF_PHY_TX_POWER_N2DBM)
+	{
+		at_power=0x05;
+	}
+	else if(g_rfPhyTxPower==RF_PHY_TX_POWER_N5DBM)
+	{
+		at_power=0x06;
+	}
+	else if(g_rfPhyTxPower==RF_PHY_TX_POWER_N10DBM)
+	{
+		at_power=0x07;
+	}
+	AT_Response(UART1,pev,&at_power, 1);
+	return AT_RET_OK;
+}
 
+//ѯUUID 55 55 49 44 3F
+static uint8 AT_cmd_uuid_get(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	uint8 service_uuid[41]={0x41,0x54,0x2B,0x62,0x6c,0x65,0x55,0x61,0x72,0x74,0x5f,0x53,0x65,0x72,0x76,0x65,0x72,0x5f,0x55,0x75,0x69,0x64,0x3a};
+	uint8 service_tx_uuid[44]={0x41,0x54,0x2B,0x62,0x6c,0x65,0x55,0x61,0x72,0x74,0x5f,0x53,0x65,0x72,0x76,0x65,0x72,0x5f,0x54,0x78,0x5f,0x55,0x75,0x69,0x64,0x3a};
+	uint8 service_rx_uuid[44]={0x41,0x54,0x2B,0x62,0x6c,0x65,0x55,0x61,0x72,0x74,0x5f,0x53,0x65,0x72,0x76,0x65,0x72,0x5f,0x52,0x78,0x5f,0x55,0x75,0x69,0x64,0x3a};
+		
+	memcpy(&service_uuid[23], bleuart_ServiceUUID, 16);
+	service_uuid[39]=0x0d;
+	service_uuid[40]=0x0a;
+	memcpy(&service_tx_uuid[26], bleuart_TxCharUUID, 16);
+	service_tx_uuid[42]=0x0d;
+	service_tx_uuid[43]=0x0a;
+	memcpy(&service_rx_uuid[26], bleuart_RxCharUUID, 16);
+	service_rx_uuid[42]=0x0d;
+	service_rx_uuid[43]=0x0a;
+
+	hal_uart_send_buff(UART1,service_uuid, 41);
+	WaitMs(50);
+	hal_uart_send_buff(UART1,service_tx_uuid, 44);
+	WaitMs(50);
+	hal_uart_send_buff(UART1,service_rx_uuid, 44);
+	return AT_RET_OK;
+}
 
+//ѯԶ㲥52 45 53 45 3F
+static uint8 AT_cmd_rese_get(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	AT_Response(UART1,pev,&(advertdata[23]),8);
+	return AT_RET_OK;
+}
 
+//豸4E 41 4D 45 3D
+static uint8 AT_cmd_name_set(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	memcpy(&scanR[2], arg, arg_len);
+	memset(&scanR[2+arg_len], 0x20, 20-arg_len);
+	AT_Response2(UART1,pev,&scanR[2], 20, 7);
+	return AT_RET_READV;
+}
 
+//MACַ4D 41 43 3D
+static uint8 AT_cmd_mac_set(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	osal_snv_write(0x89,6,arg);
+	AT_Response2(UART1,pev,arg, 6, 6);
+	return AT_RET_OK;
+}
 
+//ôڲ55 41 52 54 3D
+static uint8 AT_cmd_uart_set(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	UART_Baudrate=BUILD_UINT32(arg[3],arg[2],arg[1],arg[0]);
+	AT_Response2(UART1,pev,arg, 4, 7);
+	WaitMs(70);
+	hal_uart_deinit(UART1);
+	BUP_init(on_BUP_Evt);
+	return AT_RET_OK;
+}
+
+//÷书50 4F 57 45 52 3D
+static uint8 AT_cmd_power_set(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	if(arg[0] >= sizeof(AT_Tx_Power))
+		return AT_RET_ERROR;
+	AT_bleuart_txpower=arg[0];
+	AT_Response2(UART1,pev,&AT_bleuart_txpower, 1, 8);
+	return AT_RET_READV;
+}
 
+//ù㲥41 44 56 49 4E 54 3D
+static uint8 AT_cmd_advint_set(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	advint=arg[0];
+	AT_Response2(UART1,pev,&advint, 1, 9);
+	return AT_RET_READV;
+}
+
+//ϺԶ͸ģʽ41 55 54 4F 2B 2B 2B 3D
+static uint8 AT_cmd_auto_set(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	AT_bleuart_auto=arg[0];
+	AT_Response2(UART1,pev,&AT_bleuart_auto, 1, 10);
+	return AT_RET_OK;
+}
+
+//Զ㲥52 45 53 45 3D
+static uint8 AT_cmd_rese_set(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len)
+{
+	memcpy(&(advertdata[23]), arg, 8);
+	AT_Response2(UART1,pev,&(advertdata[23]), 8, 7);
+	return AT_RET_READV;
+}
+
+typedef uint8 (*AT_cmd_hdl_t)(AT_BLEUART_RX_t* pev, uint8* arg, uint8 arg_len);
+
+typedef struct{
+	const char*   name;			//after "AT+", up to and including '?' or '='
+	uint8         arg_min;		//raw bytes between name and \r\n
+	uint8         arg_max;
+	AT_cmd_hdl_t  hdl;
+}AT_cmd_t;
+
+//sorted by name (strcmp order), searched with CLI_find()
+static const AT_cmd_t s_at_cmd_list[] = {
+	{"+++",       0,  0, AT_cmd_passthrough},
+	{"ADVINT=",   1,  1, AT_cmd_advint_set},
+	{"ADVINT?",   0,  0, AT_cmd_advint_get},
+	{"AUTO+++=",  1,  1, AT_cmd_auto_set},
+	{"AUTO+++?",  0,  0, AT_cmd_auto_get},
+	{"CIVER?",    0,  0, AT_cmd_ver_get},
+	{"DISCONN",   0,  0, AT_cmd_disconn},
+	{"FLASH",     0,  0, AT_cmd_flash},
+	{"LINK?",     0,  0, AT_cmd_link_get},
+	{"MAC=",      6,  6, AT_cmd_mac_set},
+	{"MAC?",      0,  0, AT_cmd_mac_get},
+	{"NAME=",     0, 20, AT_cmd_name_set},
+	{"NAME?",     0,  0, AT_cmd_name_get},
+	{"POWER=",    1,  1, AT_cmd_power_set},
+	{"POWER?",    0,  0, AT_cmd_power_get},
+	{"RESE=",     8,  8, AT_cmd_rese_set},
+	{"RESE?",     0,  0, AT_cmd_rese_get},
+	{"RESET",     0,  0, AT_cmd_reset},
+	{"UART=",     4,  4, AT_cmd_uart_set},
+	{"UART?",     0,  0, AT_cmd_uart_get},
+	{"UUID?",     0,  0, AT_cmd_uuid_get},
+	{"Z",         0,  0, AT_cmd_reboot},
+};
+
+#define AT_CMD_NUM  (sizeof(s_at_cmd_list)/sizeof(AT_cmd_t))
+
+/*
+ * "AT+" name [ '?' | '=' raw args ] "\r\n". Arguments are binary, so the
+ * frame comes from the 10ms uart idle timeout and not from a line end.
+ */
+uint8 AT_process(AT_BLEUART_RX_t* pev)
+{
+	const AT_cmd_t* pcmd;
+	uint8 i, end;
+
+	if((pev->len < 6) || (pev->data[0]!=0x41) || (pev->data[1]!=0x54) || (pev->data[2]!=0x2B) ||
+	   (pev->data[(pev->len)-2]!=0x0D) || (pev->data[(pev->len)-1]!=0x0A))
+		return AT_RET_ERROR;
+
+	//the name ends after the first '?' or '=', names themselves hold neither
+	end = pev->len-2;
+	for(i=3; i<end; i++)
+	{
+		if((pev->data[i]==0x3F) || (pev->data[i]==0x3D))
+		{
+			i++;
+			break;
+		}
+	}
+
+	pcmd = (const AT_cmd_t*)CLI_find(&pev->data[3], i-3, s_at_cmd_list, AT_CMD_NUM,
+	                                 sizeof(AT_cmd_t), offsetof(AT_cmd_t, name));
+	if((pcmd == NULL) || (end-i < pcmd->arg_min) || (end-i > pcmd->arg_max))
+		return AT_RET_ERROR;
+
+	return pcmd->hdl(pev, &pev->data[i], end-i);
+}
+
+int AT_init(void)
+{
+	if(CLI_check_list(s_at_cmd_list, AT_CMD_NUM, sizeof(AT_cmd_t), offsetof(AT_cmd_t, name)))
+	{
+		LOG("AT command list not sorted\n");
+		return PPlus_ERR_INVALID_DATA;
+	}
+	return PPlus_SUCCESS;
+}
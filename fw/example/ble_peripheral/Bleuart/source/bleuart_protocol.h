@@ -8,6 +8,12 @@
 #include "osal_snv.h"
 #include "flash.h"
 
+//1: LOG the sustained uart<->ble throughput every BUP_BENCH_PERIOD ms while connected
+#ifndef BUP_BENCHMARK
+#define BUP_BENCHMARK     0
+#endif
+#define BUP_BENCH_PERIOD  2000
+
 typedef struct {
   uint8_t ev;
 
@@ -25,9 +31,13 @@ int BUP_disconnect_handler(void);
 int BUP_connect_handler(void);
 int BUP_data_BLE_to_uart_completed(void);
 int BUP_data_BLE_to_uart_send(void);
-int BUP_data_BLE_to_uart(uint8_t* pdata, uint8_t size);
+int BUP_data_BLE_to_uart(uint8_t* pdata, uint16_t size);
 int BUP_data_uart_to_BLE_send(void);
 int BUP_data_uart_to_BLE(void);
+int BUP_conn_event_done(void);
+#if(BUP_BENCHMARK)
+void BUP_bench_report(void);
+#endif
 int BUP_init(BUP_CB_t cb);
 
 extern uint32 UART_Baudrate;
@@ -35,8 +45,14 @@ extern uint8 AT_BLEUART_EVT;
 extern uint8 Bleuart_C_D;
 extern AT_BLEUART_RX_t at_bleuart_rx;
 
-extern uint8 AT_query(AT_BLEUART_RX_t* pev);
-extern uint8 AT_setdata(AT_BLEUART_RX_t* pev);
+//AT_process() results
+#define AT_RET_OK         0
+#define AT_RET_FLASH      1   //parameters saved, device data modified
+#define AT_RET_READV      3   //advertising parameters changed, restart advertising
+#define AT_RET_ERROR      4
+
+extern int AT_init(void);
+extern uint8 AT_process(AT_BLEUART_RX_t* pev);
 
 //void AT_Response(UART_INDEX_e uart_index,AT_BLEUART_RX_t* pev,uint8_t *buff,uint8 len);
 
@@ -326,6 +326,9 @@ static bStatus_t bleuart_WriteAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
             evt.param = (uint16_t)len;
             evt.data = pValue;
             bleuart_AppCBs(&evt);
+            //app had no room, only a write request can report it back
+            if(evt.param != len)
+              status = ATT_ERR_INSUFFICIENT_RESOURCES;
           }
         }
     }
@@ -552,7 +552,7 @@ static void peripheralStateNotificationCB( gaprole_States_t newState )
             break;
         
         case GAPROLE_CONNECTED:
-			HCI_PPLUS_ConnEventDoneNoticeCmd(simpleBLEPeripheral_TaskID, NULL);
+			GATTServApp_ConnEventDoneNoticeCmd(simpleBLEPeripheral_TaskID, NULL);
 			GAPRole_GetParameter( GAPROLE_CONNHANDLE, &gapConnHandle );
 			osal_set_event(simpleBLEPeripheral_TaskID,SBP_CONNECTED_EVT);
             break;
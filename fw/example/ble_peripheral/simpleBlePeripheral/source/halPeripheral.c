@@ -33,13 +33,14 @@
 uint8 Hal_TaskID;
 
 uint8_t cmdstr[64];
-uint8_t cmdlen;
+CLI_LINE cmdline;
 
 extern key_contex_t key_state;
 
 uint16_t cli_demo_help(uint32_t argc, uint8_t *argv[]);
 uint16_t cli_demo_light_ctrl(uint32_t argc, uint8_t *argv[]);
 
+/* Sorted by name, searched with CLI_find() */
 const CLI_COMMAND cli_cmd_list[] =
 {
     /* Help */
@@ -51,12 +52,14 @@ const CLI_COMMAND cli_cmd_list[] =
 
 static void ProcessUartData(uart_Evt_t *evt)
 {
+    /* Bytes after a complete line are dropped until the task consumed it */
     if(evt->len)
     {
-        osal_memcpy((cmdstr + cmdlen), evt->data, evt->len);
-        cmdlen += evt->len;
-
-        osal_set_event( Hal_TaskID, KEY_DEMO_UART_RX_EVT );
+        CLI_line_feed(&cmdline, evt->data, evt->len);
+        if(CLI_line_done(&cmdline))
+        {
+            osal_set_event( Hal_TaskID, KEY_DEMO_UART_RX_EVT );
+        }
     }     
 }
 
@@ -111,6 +114,7 @@ void HalPeripheral_Init(uint8 task_id)
 {
     uint8_t i;
 	Hal_TaskID = task_id;
+    CLI_line_init(&cmdline, cmdstr, sizeof(cmdstr));
     hal_uart_deinit(UART0);
     peripheral_uart_init();
     light_init();
@@ -132,20 +136,19 @@ uint16 HalPeripheral_ProcessEvent( uint8 task_id, uint16 events )
 		return 0;
 	}
     if( events & KEY_DEMO_UART_RX_EVT){		
-        if ('\r' == cmdstr[cmdlen - 1])
+        if (CLI_line_done(&cmdline))
         {
-            cmdstr[cmdlen - 1] = '\0';
             LOG("%s", cmdstr);
 
             CLI_process_line
             (
-                cmdstr,
-                cmdlen,
+                cmdline.buf,
+                cmdline.len,
                 (CLI_COMMAND *) cli_cmd_list,
                 (sizeof (cli_cmd_list)/sizeof(CLI_COMMAND))
             );
 
-            cmdlen = 0;
+            CLI_line_reset(&cmdline);
         }
 		return (events ^ KEY_DEMO_UART_RX_EVT);
 	}
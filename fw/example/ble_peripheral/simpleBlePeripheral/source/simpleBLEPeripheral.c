@@ -839,7 +839,7 @@ static void peripheralStateNotificationCB( gaprole_States_t newState )
             break;
         
         case GAPROLE_CONNECTED:
-            HCI_PPLUS_ConnEventDoneNoticeCmd(simpleBLEPeripheral_TaskID, NULL);
+            GATTServApp_ConnEventDoneNoticeCmd(simpleBLEPeripheral_TaskID, NULL);
             
             break;
         
@@ -950,11 +950,11 @@ static void simpleProfileChangeCB( uint8 paramID )
 
             if(connEvtEndNotify>0)
             {
-                HCI_PPLUS_ConnEventDoneNoticeCmd(simpleBLEPeripheral_TaskID, SBP_PERIODIC_EVT);
+                GATTServApp_ConnEventDoneNoticeCmd(simpleBLEPeripheral_TaskID, SBP_PERIODIC_EVT);
             }
             else
             {
-                HCI_PPLUS_ConnEventDoneNoticeCmd(simpleBLEPeripheral_TaskID, NULL);
+                GATTServApp_ConnEventDoneNoticeCmd(simpleBLEPeripheral_TaskID, NULL);
                 osal_start_timerEx( simpleBLEPeripheral_TaskID, SBP_PERIODIC_EVT, notifyInterval );
             }
         }
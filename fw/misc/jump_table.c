@@ -38,6 +38,9 @@ static void hard_fault(void)
 	for(int i = 0; i< 0x10; i++){
         LOG("0x%x,", ((uint32_t*)cur_sp)[i]);
 	}
+#if (DEBUG_INFO == 4)
+    log_bin_flush();
+#endif
 	while (*(volatile uint32_t *)0x1fff07f0 != 0x12345678) ;
 }
 
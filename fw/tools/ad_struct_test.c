@@ -0,0 +1,273 @@
+/*
+Host fuzz and throughput test of the AD structure library, see
+components/libraries/adstruct/ad_struct.c.
+
+- layout: the dispenser advert built with the builder matches the hand
+  assembled bytes it replaced
+- fuzz: random and mutated buffers go through the iterator and all lookups,
+  each buffer in its own exact sized allocation so the sanitizer catches any
+  read past the end; the iterator is compared against a plain index parser
+- builder fuzz: random field sequences never write past the buffer and
+  parse back to the same fields
+- throughput: typical reports through the lookups a scanner filter uses
+
+    cc -O1 -g -fsanitize=address,undefined -o ad_struct_test tools/ad_struct_test.c \
+        components/libraries/adstruct/ad_struct.c -Icomponents/libraries/adstruct
+    ./ad_struct_test [fuzz iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ad_struct.h"
+
+#define CANARY          0xA5
+
+static uint32_t s_rng = 1;
+static int s_fail;
+
+#define CHECK(c)    do{ if(!(c)){ printf("%s:%d: %s\n", __FILE__, __LINE__, #c); s_fail++; } }while(0)
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static void test_layout(void)
+{
+    static const uint8_t old_adv[] = {
+        0x02, 0x01, 0x06,
+        0x1A, 0xFF, 0x4c, 0x00, 0x02, 0x15,
+        0x7d, 0xb8, 0x60, 0xed, 0xb6, 0x4d, 0x4b, 0xb1,
+        0x98, 0x75, 0x8f, 0x16, 0x35, 0x5a, 0x97, 0xd2,
+        0x00, 0x07, 0x02, 0x55, 0xc5};
+    static const uint8_t old_rsp[] = {0x09, 0x09, 'D', 'I', 'S', 'P', 'E', 'N', ' ', ' '};
+    uint8_t buf[AD_DATA_MAX];
+    ad_builder_t b;
+    ad_field_t f;
+    uint8_t flags;
+    uint8_t* p;
+
+    ad_build_init(&b, buf, sizeof(buf));
+    ad_build_flags(&b, 0x06);
+    p = ad_build_manuf(&b, 0x004C, old_adv + 7, 23);
+    CHECK(p == buf + 7 && !b.err);
+    CHECK(ad_build_len(&b) == sizeof(old_adv) && memcmp(buf, old_adv, sizeof(old_adv)) == 0);
+
+    CHECK(ad_find_flags(buf, ad_build_len(&b), &flags) && flags == 0x06);
+    CHECK(ad_find_manuf(buf, ad_build_len(&b), 0x004C, &f) && f.data == buf + 7 && f.len == 23);
+    CHECK(!ad_find_manuf(buf, ad_build_len(&b), 0x0059, &f));
+
+    ad_build_init(&b, buf, sizeof(buf));
+    p = ad_build_name(&b, "DISPEN  ", 8);
+    CHECK(p == buf + 2 && ad_build_len(&b) == sizeof(old_rsp) && memcmp(buf, old_rsp, sizeof(old_rsp)) == 0);
+    CHECK(ad_find_name(buf, ad_build_len(&b), &f) && f.type == AD_TYPE_NAME_COMPLETE && f.len == 8);
+
+    //a name that doesn't fit is shortened, then the builder is full
+    ad_build_init(&b, buf, 12);
+    ad_build_flags(&b, 0x06);
+    p = ad_build_name(&b, "Dispenser-0001", 14);
+    CHECK(p && buf[4] == AD_TYPE_NAME_SHORT && ad_build_len(&b) == 12 && !b.err);
+    CHECK(ad_build_field(&b, AD_TYPE_TX_POWER, NULL, 0) == NULL && b.err);
+}
+
+//plain index parser, the reference for the iterator
+static int ref_parse(const uint8_t* d, int len, ad_field_t* out)
+{
+    int i = 0, n = 0;
+
+    while(i < len){
+        int l = d[i];
+        if(l == 0 || i + 1 + l > len)
+            break;
+        out[n].type = d[i + 1];
+        out[n].len = (uint8_t)(l - 1);
+        out[n].data = d + i + 2;
+        n++;
+        i += 1 + l;
+    }
+    return n;
+}
+
+static void fuzz_one(const uint8_t* src, uint8_t len)
+{
+    uint8_t* d = malloc(len ? len : 1);
+    ad_field_t ref[AD_DATA_MAX + 1];
+    ad_field_t f;
+    ad_iter_t it;
+    uint8_t uuid[AD_UUID128_SIZE] = {0};
+    uint8_t flags;
+    int n, i = 0;
+
+    memcpy(d, src, len);
+    n = ref_parse(d, len, ref);
+
+    ad_iter_init(&it, d, len);
+    while(ad_iter_next(&it, &f)){
+        CHECK(i < n && f.type == ref[i].type && f.len == ref[i].len && f.data == ref[i].data);
+        CHECK(f.data + f.len <= d + len);
+        i++;
+    }
+    CHECK(i == n);
+
+    ad_find_flags(d, len, &flags);
+    if(ad_find_manuf(d, len, (uint16_t)rnd(), &f))
+        CHECK(f.data + f.len <= d + len);
+    if(ad_find_svc_data16(d, len, (uint16_t)rnd(), &f))
+        CHECK(f.data + f.len <= d + len);
+    if(ad_find_svc_data128(d, len, uuid, &f))
+        CHECK(f.data + f.len <= d + len);
+    if(ad_find_name(d, len, &f))
+        CHECK(f.data + f.len <= d + len);
+    ad_has_uuid16(d, len, (uint16_t)rnd());
+
+    free(d);
+}
+
+static void fuzz_parser(uint32_t iters)
+{
+    static const uint8_t types[] = {AD_TYPE_FLAGS, AD_TYPE_UUID16_ALL, AD_TYPE_NAME_SHORT,
+                                    AD_TYPE_NAME_COMPLETE, AD_TYPE_SVC_DATA16, AD_TYPE_SVC_DATA128,
+                                    AD_TYPE_MANUFACTURER};
+    uint8_t buf[255];
+    uint32_t n;
+
+    for(n = 0; n < iters; n++){
+        uint8_t len = (uint8_t)(rnd() % (n & 1 ? AD_DATA_MAX + 1 : sizeof(buf)));
+        uint8_t i;
+
+        if(n & 2){
+            //random bytes
+            for(i = 0; i < len; i++)
+                buf[i] = (uint8_t)rnd();
+        }
+        else{
+            //well formed fields of known types, then a few bytes flipped
+            uint8_t off = 0;
+            while(off + 2 <= len){
+                uint8_t l = (uint8_t)(1 + rnd() % (len - off - 1));
+                buf[off] = l;
+                buf[off + 1] = types[rnd() % sizeof(types)];
+                for(i = 2; i <= l; i++)
+                    buf[off + i] = (uint8_t)rnd();
+                off += 1 + l;
+            }
+            for(; off < len; off++)
+                buf[off] = 0;
+            for(i = rnd() % 3; len && i; i--)
+                buf[rnd() % len] = (uint8_t)rnd();
+        }
+        fuzz_one(buf, len);
+    }
+}
+
+static void fuzz_builder(uint32_t iters)
+{
+    uint8_t buf[AD_DATA_MAX + 8];
+    uint8_t data[AD_DATA_MAX];
+    uint32_t n;
+
+    for(n = 0; n < iters; n++){
+        uint8_t size = (uint8_t)(rnd() % (AD_DATA_MAX + 1));
+        ad_field_t fields[AD_DATA_MAX];
+        uint8_t nf = 0;
+        ad_builder_t b;
+        ad_iter_t it;
+        ad_field_t f;
+        uint8_t i, k;
+
+        memset(buf, CANARY, sizeof(buf));
+        ad_build_init(&b, buf, size);
+
+        for(k = rnd() % 6; k; k--){
+            uint8_t len = (uint8_t)(rnd() % (AD_DATA_MAX + 4));
+            uint8_t* p;
+
+            for(i = 0; i < sizeof(data); i++)
+                data[i] = (uint8_t)rnd();
+            switch(rnd() % 4){
+            case 0:     p = ad_build_field(&b, (uint8_t)rnd() | 1, data, len % AD_DATA_MAX); len %= AD_DATA_MAX; break;
+            case 1:     p = ad_build_manuf(&b, (uint16_t)rnd(), data, len % 20); len = len % 20 + 2; p = p ? p - 2 : p; break;
+            case 2:     p = ad_build_flags(&b, data[0]); len = 1; break;
+            default:    p = ad_build_name(&b, (const char*)data, len % 20); len = p ? p[-2] - 1 : 0; break;
+            }
+            if(p){
+                fields[nf].type = p[-1];
+                fields[nf].len = len;
+                fields[nf].data = p;
+                nf++;
+            }
+        }
+
+        CHECK(ad_build_len(&b) <= size);
+        for(i = size; i < sizeof(buf); i++)
+            CHECK(buf[i] == CANARY);
+
+        ad_iter_init(&it, buf, ad_build_len(&b));
+        for(i = 0; ad_iter_next(&it, &f); i++)
+            CHECK(i < nf && f.type == fields[i].type && f.len == fields[i].len && f.data == fields[i].data);
+        CHECK(i == nf);
+    }
+}
+
+static void throughput(void)
+{
+    enum{ REPORTS = 64, ROUNDS = 100000 };
+    static uint8_t reports[REPORTS][AD_DATA_MAX];
+    static uint8_t lens[REPORTS];
+    struct timespec t0, t1;
+    volatile uint32_t hits = 0;
+    uint32_t r, i;
+    double ns;
+
+    //a mix of beacons, named devices and phones with service data
+    for(i = 0; i < REPORTS; i++){
+        ad_builder_t b;
+        uint8_t data[23];
+        uint8_t k;
+
+        for(k = 0; k < sizeof(data); k++)
+            data[k] = (uint8_t)rnd();
+        ad_build_init(&b, reports[i], AD_DATA_MAX);
+        ad_build_flags(&b, 0x06);
+        switch(i % 3){
+        case 0:     ad_build_manuf(&b, (i & 4) ? 0x004C : 0x0006, data, 23); break;
+        case 1:     ad_build_svc_data16(&b, 0xFEAA, data, 12); ad_build_name(&b, "Sensor", 6); break;
+        default:    ad_build_name(&b, "DISPEN  ", 8); ad_build_manuf(&b, 0x0059, data, 8); break;
+        }
+        lens[i] = ad_build_len(&b);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(r = 0; r < ROUNDS; r++){
+        for(i = 0; i < REPORTS; i++){
+            ad_field_t f;
+            if(ad_find_manuf(reports[i], lens[i], 0x004C, &f) && f.len == 23 && f.data[0] == 0x02)
+                hits++;
+            else if(ad_find_name(reports[i], lens[i], &f) && f.len == 8)
+                hits++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    printf("throughput   %.1f ns/report, %.1f M reports/s (manufacturer, then name filter, %u hits)\n",
+           ns / (REPORTS * ROUNDS), REPORTS * ROUNDS * 1e3 / ns, (unsigned)hits);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t iters = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 1000000;
+
+    test_layout();
+    fuzz_parser(iters);
+    fuzz_builder(iters / 4);
+    printf("fuzz         %u buffers, %u builds, %d failures\n", (unsigned)iters, (unsigned)(iters / 4), s_fail);
+    throughput();
+    return s_fail ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""
+Table generator for components/libraries/crc16 (crc16.c / crc32.c).
+
+Writes crc_table.h: nibble, byte and slice-by-4 tables of the reflected
+CRC-16/ARC (0xA001) and CRC-32/IEEE (0xEDB88320) polynomials, as initializer
+macros so the OTA loader can place its own copy in ota_app_loader_area.
+
+Every table is checked against the bitwise definition, and the nibble, byte
+and slice-by-4 algorithms as written in crc16.c / crc32.c are modelled here
+and checked bit-exact against each other on random data before anything is
+written.
+
+    crc_gen.py ../components/libraries/crc16/crc_table.h
+    crc_gen.py --check
+"""
+
+import argparse
+import os
+import random
+import sys
+
+CRC16_POLY = 0xA001
+CRC32_POLY = 0xEDB88320
+CHECK_STR = b"123456789"
+CRC16_CHECK = 0xBB3D
+CRC32_CHECK = 0xCBF43926
+
+
+def crc_bitwise(poly, crc, data):
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ poly if crc & 1 else crc >> 1
+    return crc
+
+
+def nibble_table(poly, mask):
+    t = []
+    for n in range(16):
+        c = n
+        for _ in range(4):
+            c = (c >> 1) ^ poly if c & 1 else c >> 1
+        t.append(c & mask)
+    return t
+
+
+def slice_tables(poly, mask):
+    t0 = [crc_bitwise(poly, 0, bytes([n])) & mask for n in range(256)]
+    tabs = [t0]
+    for _ in range(3):
+        prev = tabs[-1]
+        tabs.append([(prev[n] >> 8) ^ t0[prev[n] & 0xFF] for n in range(256)])
+    return tabs
+
+
+def run_nibble(t, crc, data):
+    for b in data:
+        crc = (crc >> 4) ^ t[(crc ^ b) & 0xF]
+        crc = (crc >> 4) ^ t[(crc ^ (b >> 4)) & 0xF]
+    return crc
+
+
+def run_table(t, crc, data):
+    for b in data:
+        crc = (crc >> 8) ^ t[(crc ^ b) & 0xFF]
+    return crc
+
+
+def run_slice4(tabs, crc, data, addr):
+    # head bytes up to the next word boundary, aligned words, tail bytes
+    i = 0
+    while i < len(data) and (addr + i) & 3:
+        crc = (crc >> 8) ^ tabs[0][(crc ^ data[i]) & 0xFF]
+        i += 1
+    while len(data) - i >= 4:
+        c = crc ^ (data[i] | data[i + 1] << 8 | data[i + 2] << 16 | data[i + 3] << 24)
+        crc = tabs[3][c & 0xFF] ^ tabs[2][(c >> 8) & 0xFF] ^ tabs[1][(c >> 16) & 0xFF] ^ tabs[0][c >> 24]
+        i += 4
+    while i < len(data):
+        crc = (crc >> 8) ^ tabs[0][(crc ^ data[i]) & 0xFF]
+        i += 1
+    return crc
+
+
+def check():
+    n16 = nibble_table(CRC16_POLY, 0xFFFF)
+    n32 = nibble_table(CRC32_POLY, 0xFFFFFFFF)
+    s16 = slice_tables(CRC16_POLY, 0xFFFF)
+    s32 = slice_tables(CRC32_POLY, 0xFFFFFFFF)
+
+    # the nibble table of crc16.c before the byte/slice variants existed
+    assert n16 == [0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+                   0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400]
+    assert crc_bitwise(CRC16_POLY, 0, CHECK_STR) == CRC16_CHECK
+    assert crc_bitwise(CRC32_POLY, 0xFFFFFFFF, CHECK_STR) ^ 0xFFFFFFFF == CRC32_CHECK
+
+    rnd = random.Random(0x5EED)
+    for _ in range(500):
+        data = bytes(rnd.getrandbits(8) for _ in range(rnd.randrange(0, 80)))
+        addr = rnd.randrange(0, 4)
+        seed16 = rnd.getrandbits(16)
+        seed32 = rnd.getrandbits(32)
+        ref16 = crc_bitwise(CRC16_POLY, seed16, data)
+        ref32 = crc_bitwise(CRC32_POLY, seed32, data)
+        assert run_nibble(n16, seed16, data) == ref16
+        assert run_table(s16[0], seed16, data) == ref16
+        assert run_slice4(s16, seed16, data, addr) == ref16
+        assert run_nibble(n32, seed32, data) == ref32
+        assert run_table(s32[0], seed32, data) == ref32
+        assert run_slice4(s32, seed32, data, addr) == ref32
+    return n16, n32, s16, s32
+
+
+def emit(out, name, table, digits, per_line):
+    out.append("#define %s \\" % name)
+    out.append("{ \\")
+    for i in range(0, len(table), per_line):
+        row = ", ".join("0x%0*X" % (digits, v) for v in table[i:i + per_line])
+        out.append("    %s%s \\" % (row, "," if i + per_line < len(table) else ""))
+    out.append("}")
+    out.append("")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("output", nargs="?", help="crc_table.h to write")
+    ap.add_argument("--check", action="store_true", help="only run the bit-exactness checks")
+    opt = ap.parse_args()
+
+    n16, n32, s16, s32 = check()
+    print("crc16/crc32 nibble, table and slice4 models match the bitwise reference")
+    if opt.check or not opt.output:
+        return
+
+    out = [
+        "/**************************************************************************************************",
+        "*******",
+        "**************************************************************************************************/",
+        "",
+        "",
+        "/*",
+        "crc tables, generated by tools/%s, do not edit" % os.path.basename(sys.argv[0]),
+        "",
+        "CRC16: CRC-16/ARC, reflected polynomial 0x%04X" % CRC16_POLY,
+        "CRC32: CRC-32/IEEE 802.3, reflected polynomial 0x%08X" % CRC32_POLY,
+        "CRCxx_SLICE_Tk[n] is the crc of byte n followed by k zero bytes, Tk of slice 0",
+        "is the byte table.",
+        "*/",
+        "",
+        "#ifndef _CRC_TABLE_H__",
+        "#define _CRC_TABLE_H__",
+        "",
+    ]
+    emit(out, "CRC16_NIBBLE_TABLE", n16, 4, 8)
+    for k in range(4):
+        emit(out, "CRC16_SLICE_T%d" % k, s16[k], 4, 8)
+    emit(out, "CRC32_NIBBLE_TABLE", n32, 8, 4)
+    for k in range(4):
+        emit(out, "CRC32_SLICE_T%d" % k, s32[k], 8, 4)
+    out.append("#endif // _CRC_TABLE_H__")
+
+    with open(opt.output, "w", newline="\n") as f:
+        f.write("\n".join(out) + "\n")
+
+
+if __name__ == "__main__":
+    main()
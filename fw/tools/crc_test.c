@@ -0,0 +1,275 @@
+/*
+Host check and benchmark of the crc variants, see
+components/libraries/crc16/crc16.h.
+
+crc16.c and crc32.c are built here once per variant, under renamed
+symbols. Every variant is compared bit for bit against the nibble crc16
+the library had before the table variants, and crc32 against a bitwise
+reference:
+
+- check values of "123456789"
+- edge cases: empty, single bytes, all 0x00 and all 0xFF, lengths around
+  the word boundary at every alignment
+- random buffers at random offsets, seeds and lengths, also continued
+  block by block through the seed
+
+then the throughput of each variant on aligned and unaligned blocks, crc16
+against the old code and crc32 against its nibble variant. Host figures
+only give the ratios, the M0 has no data cache and a slower flash.
+
+    cc -O2 -o crc_test tools/crc_test.c -Icomponents/libraries/crc16
+    ./crc_test [random iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CRC16_VARIANT   CRC_NIBBLE
+#define CRC32_VARIANT   CRC_NIBBLE
+#define crc16           crc16_nibble
+#define crc16_table     crc16_nibble_table
+#define crc16_byte      crc16_nibble_byte
+#define crc32           crc32_nibble
+#define crc32_table     crc32_nibble_table
+#define crc32_byte      crc32_nibble_byte
+#include "crc16.c"
+#include "crc32.c"
+#undef CRC16_VARIANT
+#undef CRC32_VARIANT
+#undef crc16
+#undef crc16_table
+#undef crc16_byte
+#undef crc32
+#undef crc32_table
+#undef crc32_byte
+
+#define CRC16_VARIANT   CRC_TABLE
+#define CRC32_VARIANT   CRC_TABLE
+#define crc16           crc16_tab
+#define crc16_table     crc16_tab_table
+#define crc16_byte      crc16_tab_byte
+#define crc32           crc32_tab
+#define crc32_table     crc32_tab_table
+#define crc32_byte      crc32_tab_byte
+#include "crc16.c"
+#include "crc32.c"
+#undef CRC16_VARIANT
+#undef CRC32_VARIANT
+#undef CRC16_T0
+#undef CRC32_T0
+#undef crc16
+#undef crc16_table
+#undef crc16_byte
+#undef crc32
+#undef crc32_table
+#undef crc32_byte
+
+#define CRC16_VARIANT   CRC_SLICE4
+#define CRC32_VARIANT   CRC_SLICE4
+#define crc16           crc16_slice4
+#define crc16_table     crc16_slice4_table
+#define crc16_byte      crc16_slice4_byte
+#define crc32           crc32_slice4
+#define crc32_table     crc32_slice4_table
+#define crc32_byte      crc32_slice4_byte
+#include "crc16.c"
+#include "crc32.c"
+#undef crc16
+#undef crc32
+
+#define BUF_SIZE        4096
+#define BENCH_BYTES     (64u << 20)
+
+typedef uint16_t (*crc16_fn)(uint16_t, const volatile void*, uint32_t);
+typedef uint32_t (*crc32_fn)(uint32_t, const volatile void*, uint32_t);
+
+static const struct{ const char* name; crc16_fn f16; crc32_fn f32; }variants[] = {
+    {"nibble", crc16_nibble, crc32_nibble},
+    {"table",  crc16_tab,    crc32_tab},
+    {"slice4", crc16_slice4, crc32_slice4},
+};
+#define VARIANTS    (sizeof(variants) / sizeof(variants[0]))
+
+static uint32_t s_rng = 1;
+static int s_fail;
+static uint32_t s_checks;
+
+#define CHECK(c)    do{ s_checks++; if(!(c)){ printf("%s:%d: %s\n", __FILE__, __LINE__, #c); s_fail++; } }while(0)
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+//crc16() as it was before the table variants, the reference
+static uint16_t old_crc16_byte(uint16_t crc, uint8_t byte)
+{
+    static const uint16_t crc16_table[16] =
+    {
+        0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+        0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+    };
+
+    uint16_t temp;
+
+    // Compute checksum of lower four bits of a byte.
+    temp         = crc16_table[crc & 0xF];
+    crc  = (crc >> 4u) & 0x0FFFu;
+    crc  = crc ^ temp ^ crc16_table[byte & 0xF];
+
+    // Now compute checksum of upper four bits of a byte.
+    temp         = crc16_table[crc & 0xF];
+    crc  = (crc >> 4u) & 0x0FFFu;
+    crc  = crc ^ temp ^ crc16_table[(byte >> 4u) & 0xF];
+
+    return crc;
+}
+
+static uint16_t old_crc16(uint16_t seed, const volatile void * p_data, uint32_t size)
+{
+    uint8_t * p_block = (uint8_t *)p_data;
+
+    while (size != 0)
+    {
+        seed = old_crc16_byte(seed, *p_block);
+        p_block++;
+        size--;
+    }
+
+   return seed;
+}
+
+//bitwise crc32, the reference
+static uint32_t ref_crc32(uint32_t crc, const uint8_t* p, uint32_t size)
+{
+    int k;
+
+    crc = ~crc;
+    while(size--){
+        crc ^= *p++;
+        for(k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static void check_one(uint16_t seed16, uint32_t seed32, const uint8_t* p, uint32_t len)
+{
+    uint16_t r16 = old_crc16(seed16, p, len);
+    uint32_t r32 = ref_crc32(seed32, p, len);
+    unsigned i;
+
+    for(i = 0; i < VARIANTS; i++){
+        CHECK(variants[i].f16(seed16, p, len) == r16);
+        CHECK(variants[i].f32(seed32, p, len) == r32);
+    }
+}
+
+static void test_edges(uint8_t* buf)
+{
+    static const char check[] = "123456789";
+    uint32_t off, len, v;
+    unsigned i;
+
+    for(i = 0; i < VARIANTS; i++){
+        CHECK(variants[i].f16(0, check, 9) == 0xBB3D);
+        CHECK(variants[i].f32(0, check, 9) == 0xCBF43926);
+        CHECK(variants[i].f16(0x1234, check, 0) == 0x1234);
+        CHECK(variants[i].f32(0x12345678, check, 0) == 0x12345678);
+    }
+    CHECK(old_crc16(0, check, 9) == 0xBB3D);
+
+    for(v = 0; v < 256; v++){
+        buf[0] = (uint8_t)v;
+        check_one(0, 0, buf, 1);
+        check_one(0xFFFF, 0xFFFFFFFF, buf, 1);
+    }
+
+    for(v = 0; v <= 0xFF; v += 0xFF){
+        memset(buf, (int)v, BUF_SIZE);
+        for(len = 0; len < 64; len++)
+            check_one(0, 0, buf, len);
+        check_one(0, 0, buf, BUF_SIZE);
+    }
+
+    //the slice4 head and tail loops at every alignment
+    for(len = 0; len < BUF_SIZE; len++)
+        buf[len] = (uint8_t)rnd();
+    for(off = 0; off < 8; off++){
+        for(len = 0; len < 24; len++)
+            check_one((uint16_t)rnd(), rnd(), buf + off, len);
+    }
+}
+
+static void test_random(uint8_t* buf, uint32_t iters)
+{
+    uint32_t n;
+
+    for(n = 0; n < iters; n++){
+        uint32_t off = rnd() % 64;
+        uint32_t len = rnd() % (n & 7 ? 256 : BUF_SIZE - 64);
+        uint32_t cut, i;
+        uint16_t c16;
+        uint32_t c32;
+
+        for(i = 0; i < len; i++)
+            buf[off + i] = (uint8_t)rnd();
+        check_one((uint16_t)rnd(), rnd(), buf + off, len);
+
+        //continued through the seed, as the ota flash check does per block
+        cut = len ? rnd() % len : 0;
+        for(i = 0; i < VARIANTS; i++){
+            c16 = variants[i].f16(0, buf + off, cut);
+            c16 = variants[i].f16(c16, buf + off + cut, len - cut);
+            CHECK(c16 == old_crc16(0, buf + off, len));
+            c32 = variants[i].f32(0, buf + off, cut);
+            c32 = variants[i].f32(c32, buf + off + cut, len - cut);
+            CHECK(c32 == ref_crc32(0, buf + off, len));
+        }
+    }
+}
+
+static double bench(crc16_fn f16, crc32_fn f32, const uint8_t* p, uint32_t len)
+{
+    struct timespec t0, t1;
+    volatile uint32_t sink = 0;
+    uint32_t n;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(n = 0; n < BENCH_BYTES / len; n++)
+        sink += f16 ? f16((uint16_t)sink, p, len) : f32(sink, p, len);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    //MB/s
+    return (double)BENCH_BYTES / ((t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t iters = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 100000;
+    static uint32_t words[BUF_SIZE / 4 + 2];
+    uint8_t* buf = (uint8_t*)words;
+    double base16, base32;
+    unsigned i;
+
+    test_edges(buf);
+    test_random(buf, iters);
+    printf("compare      %u buffers, %u checks, %d failures\n", (unsigned)iters, (unsigned)s_checks, s_fail);
+
+    base16 = bench(old_crc16, NULL, buf, BUF_SIZE);
+    base32 = bench(NULL, crc32_nibble, buf, BUF_SIZE);
+    printf("old crc16    %7.1f MB/s\n", base16);
+    for(i = 0; i < VARIANTS; i++){
+        double a16 = bench(variants[i].f16, NULL, buf, BUF_SIZE);
+        double u16 = bench(variants[i].f16, NULL, buf + 1, BUF_SIZE - 4);
+        double a32 = bench(NULL, variants[i].f32, buf, BUF_SIZE);
+        printf("%-12s crc16 %7.1f MB/s (x%.1f), unaligned %7.1f, crc32 %7.1f MB/s (x%.1f)\n",
+               variants[i].name, a16, a16 / base16, u16, a32, a32 / base32);
+    }
+    return s_fail ? 1 : 0;
+}
@@ -0,0 +1,1797 @@
+/*
+Host test of the GATT Server Application, see
+components/profiles/GATT/gattservapp.c.
+
+The real gattservapp.c is built here against stubs of the parts of the
+stack library it calls: the attribute server, ATT, L2CAP, linkDB and OSAL.
+The ATT stubs record what would go on air. Requests go in as
+GATT_MSG_EVENT messages through GATTServApp_ProcessEvent, the way the stack
+delivers them, and link changes through the callback registered with
+linkDB. tools/host holds the CMSIS and header stand-ins the host build
+needs.
+
+- long writes: a value the service writes in place through
+  pfnLongWriteAttrCB and a value queued for its write callback, from one
+  and from two clients, through Execute Write, a cancel, an error at
+  execute, a full prepare write queue, a full long write table and a
+  dropped link
+- service changed: a Robust Caching client becomes change-aware on the
+  confirmation of the Service Changed Indication, not on that of any other
+  indication
+- CCCD store: the 2 bits of every index and client on their own, values,
+  indexes and clients out of range, a client's configurations saved and
+  restored into the same or another client, cleared when the link drops;
+  store and gattCharCfg_t CCCDs side by side through ATT
+- client info: the Client Supported Features and the change-aware state a
+  bonded client gets back on the next connection, change-unaware if the
+  database changed in between; the Bond Manager is told when to save them
+- Database Hash: the example database of the Core Specification gives the
+  hash listed there, with AES-128 for LL_Encrypt
+- connection event done notice: taken while notifications are queued or
+  the application wants it, passed on to the application, given back when
+  neither needs it
+- notification queue: a coalesced value queued again in the order of its
+  urgency, a value longer than the connection's ATT_MTU - 3
+- UUID index: Read By Type, Read By Group Type and Find By Type Value on
+  random databases of 16-bit, Bluetooth Base and other 128-bit UUIDs,
+  checked against a search through every attribute; the group end of a
+  primary service with a secondary service registered after it
+- values from pfnGetAttrValueCB: Read and Read By Type cut at the MTU,
+  Read Blob at offsets inside, at and past the end of the value, and a
+  declaration that is not long
+- Read Multiple Variable Length: taken from L2CAP through the hook in the
+  ROM jump table and left to ATT as a command it ignores, the list cut at
+  the MTU, an invalid handle, a short Set Of Handles, a change-unaware
+  client; other PDUs passed on as they are
+
+    cc -g -fsanitize=address,undefined -o gatt_serv_test tools/gatt_serv_test.c \
+        components/profiles/GATT/gattservapp.c \
+        -DADV_NCONN_CFG=0x01 -DADV_CONN_CFG=0x02 -DSCAN_CFG=0x04 -DINIT_CFG=0x08 \
+        -DBROADCASTER_CFG=0x01 -DOBSERVER_CFG=0x02 -DPERIPHERAL_CFG=0x04 -DCENTRAL_CFG=0x08 \
+        -DHOST_CONFIG=4 -DDEBUG_INFO=0 -DPHY_MCU_TYPE=MCU_BUMBEE_M0 \
+        -Itools/host -Icomponents/inc -Icomponents/osal/include -Icomponents/ble/include \
+        -Icomponents/ble/host -Icomponents/ble/controller -Icomponents/arch/cm0 -Imisc \
+        -Icomponents/driver/log -Icomponents/driver/uart -Icomponents/driver/gpio \
+        -Icomponents/driver/timer -Wno-pointer-to-int-cast
+    ./gatt_serv_test
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bcomdef.h"
+#include "OSAL.h"
+#include "osal_bufmgr.h"
+#include "linkdb.h"
+#include "att.h"
+#include "gatt.h"
+#include "gatt_uuid.h"
+#include "gattservapp.h"
+#include "hci.h"
+#include "l2cap.h"
+#include "ll.h"
+#include "jump_function.h"
+
+#define TEST_TASK_ID        3
+#define APP_TASK_ID         7
+#define APP_EVT             0x0040
+#define LONG_VALUE_MAX      100
+#define QUEUED_VALUE_MAX    40
+//a Prepare Write Request at the default MTU
+#define PART_LEN            (ATT_MTU_SIZE_MIN - 5)
+
+static int s_fail;
+
+#define CHECK(c)    do{ if(!(c)){ printf("%s:%d: %s\n", __FILE__, __LINE__, #c); s_fail++; } }while(0)
+
+/*
+stack stubs
+*/
+CONST uint8 btBaseUUID[ATT_UUID_SIZE] = {
+    0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+CONST uint8 gattServiceUUID[ATT_BT_UUID_SIZE] = {LO_UINT16(GATT_SERVICE_UUID), HI_UINT16(GATT_SERVICE_UUID)};
+CONST uint8 primaryServiceUUID[ATT_BT_UUID_SIZE] = {LO_UINT16(GATT_PRIMARY_SERVICE_UUID), HI_UINT16(GATT_PRIMARY_SERVICE_UUID)};
+CONST uint8 secondaryServiceUUID[ATT_BT_UUID_SIZE] = {LO_UINT16(GATT_SECONDARY_SERVICE_UUID), HI_UINT16(GATT_SECONDARY_SERVICE_UUID)};
+CONST uint8 characterUUID[ATT_BT_UUID_SIZE] = {LO_UINT16(GATT_CHARACTER_UUID), HI_UINT16(GATT_CHARACTER_UUID)};
+CONST uint8 clientCharCfgUUID[ATT_BT_UUID_SIZE] = {LO_UINT16(GATT_CLIENT_CHAR_CFG_UUID), HI_UINT16(GATT_CLIENT_CHAR_CFG_UUID)};
+CONST uint8 serviceChangedUUID[ATT_BT_UUID_SIZE] = {LO_UINT16(SERVICE_CHANGED_UUID), HI_UINT16(SERVICE_CHANGED_UUID)};
+
+uint16 g_ATT_MTU_SIZE_MAX = ATT_MTU_SIZE_MIN;
+uint16 g_ATT_MAX_NUM_HANDLES_INFO = 4;
+uint16 gAttMtuSize[GATT_MAX_NUM_CONN];
+//no simple profile registered, every write goes to the service callbacks
+uint8 gattServApp_simple_flag = 1;
+
+static gattService_t s_services[32];
+static uint8 s_numServices;
+static uint16 s_nextHandle = 1;
+static pfnLinkDBCB_t s_linkCB;
+static uint8 s_connected[GATT_MAX_NUM_CONN];
+static gattMsgEvent_t s_msg;
+static uint8* s_pendingMsg;
+//GATT_CLIENT_INFO_UPDATED_EVENT messages sent to the application
+static uint8 s_infoEvents;
+
+//the controller's one connection event done notice
+static struct{
+    uint8 task;
+    uint16 event;
+}s_notice;
+static uint16 s_appEvents;
+//notifications the controller takes before it runs out of buffers
+static uint8 s_notiRoom = 0xFF;
+static uint16 s_notiSent;
+//handles of the last notifications sent, in order
+static uint16 s_notiHandles[8];
+
+//what went on air for the last request
+static struct{
+    uint8 opcode;
+    attErrorRsp_t err;
+    union{
+        attReadRsp_t read;
+        attReadBlobRsp_t readBlob;
+        attReadByTypeRsp_t readByType;
+        attReadByGrpTypeRsp_t readByGrpType;
+        attFindByTypeValueRsp_t findByTypeValue;
+    }u;
+    //a PDU built by the GATT Server Application itself
+    uint8 pdu[ATT_MTU_SIZE];
+    uint16 pduLen;
+}s_rsp;
+
+uint32 jump_table_host[256];
+
+static uint32 s_rng = 0x2545F491;
+
+static uint32 rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+void* osal_mem_alloc(uint16 size)                   { return malloc(size); }
+void osal_mem_free(void* ptr)                       { free(ptr); }
+void* osal_memcpy(void* dst, const void* src, unsigned int len) { return memcpy(dst, src, len); }
+uint8 osal_memcmp(const void* src1, const void* src2, unsigned int len) { return memcmp(src1, src2, len) == 0; }
+void* osal_memset(void* dest, uint8 value, int len) { return memset(dest, value, len); }
+int osal_strlen(char* pString)                      { return (int)strlen(pString); }
+uint8* osal_msg_allocate(uint16 len)                { return malloc(len); }
+
+uint8 osal_msg_send(uint8 destination_task, uint8* msg_ptr)
+{
+    gattClientInfoUpdatedEvent_t* pEvent = (gattClientInfoUpdatedEvent_t*)msg_ptr;
+
+    if(destination_task == APP_TASK_ID && pEvent->hdr.event == GATT_SERV_MSG_EVENT &&
+       pEvent->method == GATT_CLIENT_INFO_UPDATED_EVENT)
+        s_infoEvents++;
+    free(msg_ptr);
+    return SUCCESS;
+}
+void osal_bm_free(void* payload_ptr)                { free(payload_ptr); }
+void* L2CAP_bm_alloc(uint16 size)                   { return malloc(size); }
+
+uint8* osal_msg_receive(uint8 task_id)
+{
+    uint8* pMsg = s_pendingMsg;
+
+    s_pendingMsg = NULL;
+    return pMsg;
+}
+
+uint8 osal_msg_deallocate(uint8* msg_ptr)
+{
+    //requests come from a static message
+    if(msg_ptr != (uint8*)&s_msg)
+        free(msg_ptr);
+    return SUCCESS;
+}
+
+bStatus_t L2CAP_SendData(uint16 connHandle, l2capPacket_t* pPkt)
+{
+    s_rsp.opcode = pPkt->pPayload[0];
+    memcpy(s_rsp.pdu, pPkt->pPayload, pPkt->len);
+    s_rsp.pduLen = pPkt->len;
+    free(pPkt->pPayload);
+    return SUCCESS;
+}
+
+//AES-128, octets most significant first
+static const uint8 s_sbox[256] = {
+    0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+    0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+    0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+    0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+    0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+    0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+    0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+    0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+    0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+    0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+    0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+    0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+    0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+    0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+    0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+    0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+static uint8 xtime(uint8 x)
+{
+    return (uint8)((x << 1) ^ ((x & 0x80) ? 0x1B : 0));
+}
+
+llStatus_t LL_Encrypt(uint8* key, uint8* plaintextData, uint8* encryptedData)
+{
+    uint8 rk[16], s[16], t[16];
+    uint8 rcon = 1;
+    int round, i, c;
+
+    memcpy(rk, key, 16);
+    for(i = 0; i < 16; i++)
+        s[i] = plaintextData[i] ^ rk[i];
+
+    for(round = 1; round <= 10; round++){
+        //next round key
+        rk[0] ^= s_sbox[rk[13]] ^ rcon;
+        rk[1] ^= s_sbox[rk[14]];
+        rk[2] ^= s_sbox[rk[15]];
+        rk[3] ^= s_sbox[rk[12]];
+        for(i = 4; i < 16; i++)
+            rk[i] ^= rk[i - 4];
+        rcon = xtime(rcon);
+
+        //SubBytes and ShiftRows, the state is kept column by column
+        for(i = 0; i < 16; i++)
+            t[i] = s_sbox[s[(i + 4 * (i % 4)) % 16]];
+
+        //MixColumns, not in the last round
+        if(round < 10){
+            for(c = 0; c < 4; c++){
+                uint8* p = &t[4 * c];
+                uint8 a0 = p[0], a1 = p[1], a2 = p[2], a3 = p[3];
+                uint8 all = a0 ^ a1 ^ a2 ^ a3;
+
+                p[0] ^= all ^ xtime(a0 ^ a1);
+                p[1] ^= all ^ xtime(a1 ^ a2);
+                p[2] ^= all ^ xtime(a2 ^ a3);
+                p[3] ^= all ^ xtime(a3 ^ a0);
+            }
+        }
+
+        for(i = 0; i < 16; i++)
+            s[i] = t[i] ^ rk[i];
+    }
+
+    memcpy(encryptedData, s, 16);
+    return SUCCESS;
+}
+
+hciStatus_t HCI_PPLUS_ConnEventDoneNoticeCmd(uint8 taskID, uint16 taskEvent)
+{
+    s_notice.task = taskID;
+    s_notice.event = taskEvent;
+    return SUCCESS;
+}
+
+uint8 osal_set_event(uint8 task_id, uint16 event_flag)
+{
+    if(task_id == APP_TASK_ID && event_flag == APP_EVT)
+        s_appEvents++;
+    return SUCCESS;
+}
+
+uint8 linkDB_Register(pfnLinkDBCB_t pFunc)
+{
+    s_linkCB = pFunc;
+    return SUCCESS;
+}
+
+uint8 linkDB_State(uint16 connectionHandle, uint8 state)
+{
+    return connectionHandle < GATT_MAX_NUM_CONN && s_connected[connectionHandle];
+}
+
+void GATT_RegisterForReq(uint8 taskId)              {}
+void GATT_AppCompletedMsg(gattMsgEvent_t* pMsg)     {}
+
+//handles are given out in registration order
+bStatus_t GATT_RegisterService(gattService_t* pService)
+{
+    uint16 i;
+
+    for(i = 0; i < pService->numAttrs; i++)
+        pService->attrs[i].handle = s_nextHandle++;
+    s_services[s_numServices++] = *pService;
+    return SUCCESS;
+}
+
+bStatus_t GATT_DeregisterService(uint16 handle, gattService_t* pService)
+{
+    uint8 i;
+
+    for(i = 0; i < s_numServices; i++){
+        if(s_services[i].attrs[0].handle == handle){
+            *pService = s_services[i];
+            s_services[i] = s_services[--s_numServices];
+            return SUCCESS;
+        }
+    }
+    return FAILURE;
+}
+
+gattAttribute_t* GATT_FindHandle(uint16 handle, uint16* pHandle)
+{
+    uint8 i;
+
+    for(i = 0; i < s_numServices; i++){
+        gattAttribute_t* pAttrs = s_services[i].attrs;
+
+        if(handle >= pAttrs[0].handle && handle < pAttrs[0].handle + s_services[i].numAttrs){
+            //the declaration of a characteristic looks up its value without
+            if(pHandle != NULL)
+                *pHandle = pAttrs[0].handle;
+            return &pAttrs[handle - pAttrs[0].handle];
+        }
+    }
+    return NULL;
+}
+
+gattAttribute_t* GATT_FindHandleUUID(uint16 startHandle, uint16 endHandle, const uint8* pUUID,
+                                     uint16 len, uint16* pHandle)
+{
+    return NULL;
+}
+
+//the handle before the next one of the type, or the end of the table if
+//there is none; the Include Declaration takes a group end from it
+gattAttribute_t* GATT_FindNextAttr(gattAttribute_t* pAttr, uint16 endHandle,
+                                   uint16 service, uint16* pLastHandle)
+{
+    gattAttribute_t* pNext = NULL;
+    uint16 owner, h, last = pAttr->handle;
+    uint8 i;
+
+    for(i = 0; i < s_numServices; i++){
+        gattAttribute_t* pAttrs = s_services[i].attrs;
+
+        if(pAttr->handle >= pAttrs[0].handle && pAttr->handle < pAttrs[0].handle + s_services[i].numAttrs)
+            last = pAttrs[0].handle + s_services[i].numAttrs - 1;
+    }
+
+    for(h = pAttr->handle + 1; h != 0 && h <= endHandle && pNext == NULL; h++){
+        gattAttribute_t* p = GATT_FindHandle(h, &owner);
+
+        if(p != NULL && ATT_CompareUUID(p->type.uuid, p->type.len, pAttr->type.uuid, pAttr->type.len))
+            pNext = p;
+    }
+
+    if(pLastHandle != NULL)
+        *pLastHandle = pNext ? pNext->handle - 1 : last;
+    return pNext;
+}
+
+bStatus_t GATT_VerifyReadPermissions(uint16 connHandle, uint8 permissions)
+{
+    return (permissions & GATT_PERMIT_READ) ? SUCCESS : ATT_ERR_READ_NOT_PERMITTED;
+}
+
+bStatus_t GATT_Notification(uint16 connHandle, attHandleValueNoti_t* pNoti, uint8 authenticated)
+{
+    if(s_notiRoom == 0)
+        return MSG_BUFFER_NOT_AVAIL;
+    s_notiRoom--;
+    s_notiHandles[s_notiSent++ % 8] = pNoti->handle;
+    return SUCCESS;
+}
+
+bStatus_t GATT_Indication(uint16 connHandle, attHandleValueInd_t* pInd, uint8 authenticated, uint8 taskId)
+{
+    return SUCCESS;
+}
+
+uint8 GATT_ServiceChangedInd(uint16 connHandle, uint8 taskId)
+{
+    return SUCCESS;
+}
+
+uint8 ATT_CompareUUID(const uint8* pUUID1, uint16 len1, const uint8* pUUID2, uint16 len2)
+{
+    return len1 == len2 && memcmp(pUUID1, pUUID2, len1) == 0;
+}
+
+//the host library's reassembly, a whole PDU after the basic L2CAP header
+uint8 l2capParsePacket0(l2capPacket_t* pPkt, hciDataEvent_t* pHciMsg)
+{
+    pPkt->len = BUILD_UINT16(pHciMsg->pData[0], pHciMsg->pData[1]);
+    pPkt->CID = BUILD_UINT16(pHciMsg->pData[2], pHciMsg->pData[3]);
+    pPkt->pPayload = &pHciMsg->pData[4];
+    return TRUE;
+}
+
+bStatus_t ATT_ErrorRsp(uint16 connHandle, attErrorRsp_t* pRsp)
+{
+    s_rsp.opcode = ATT_ERROR_RSP;
+    s_rsp.err = *pRsp;
+    return SUCCESS;
+}
+
+#define ATT_RSP_STUB(name, type, op) \
+    bStatus_t name(uint16 connHandle, type* pRsp) { s_rsp.opcode = op; return SUCCESS; }
+
+//the response is kept for the checks
+#define ATT_RSP_COPY(name, type, op, field) \
+    bStatus_t name(uint16 connHandle, type* pRsp) { s_rsp.opcode = op; s_rsp.u.field = *pRsp; return SUCCESS; }
+
+ATT_RSP_STUB(ATT_ExchangeMTURsp, attExchangeMTURsp_t, ATT_EXCHANGE_MTU_RSP)
+ATT_RSP_COPY(ATT_FindByTypeValueRsp, attFindByTypeValueRsp_t, ATT_FIND_BY_TYPE_VALUE_RSP, findByTypeValue)
+ATT_RSP_COPY(ATT_ReadByTypeRsp, attReadByTypeRsp_t, ATT_READ_BY_TYPE_RSP, readByType)
+ATT_RSP_COPY(ATT_ReadRsp, attReadRsp_t, ATT_READ_RSP, read)
+ATT_RSP_COPY(ATT_ReadBlobRsp, attReadBlobRsp_t, ATT_READ_BLOB_RSP, readBlob)
+ATT_RSP_STUB(ATT_ReadMultiRsp, attReadMultiRsp_t, ATT_READ_MULTI_RSP)
+ATT_RSP_COPY(ATT_ReadByGrpTypeRsp, attReadByGrpTypeRsp_t, ATT_READ_BY_GRP_TYPE_RSP, readByGrpType)
+ATT_RSP_STUB(ATT_PrepareWriteRsp, attPrepareWriteRsp_t, ATT_PREPARE_WRITE_RSP)
+
+bStatus_t ATT_WriteRsp(uint16 connHandle)
+{
+    s_rsp.opcode = ATT_WRITE_RSP;
+    return SUCCESS;
+}
+
+bStatus_t ATT_ExecuteWriteRsp(uint16 connHandle)
+{
+    s_rsp.opcode = ATT_EXECUTE_WRITE_RSP;
+    return SUCCESS;
+}
+
+bStatus_t GATTServApp_RegisterService_simple(gattAttribute_t* pAttrs, uint16 numAttrs)
+{
+    return SUCCESS;
+}
+
+bStatus_t GATTServApp_simple_WriteAttrCB(uint16 connHandle, gattAttribute_t* pAttr,
+                                         uint8* pValue, uint8 len, uint16 offset)
+{
+    return SUCCESS;
+}
+
+/*
+test service: a long value the service stages per client and writes in
+place at Execute Write, and a value written from the prepare write queue
+*/
+static CONST uint8 testServUUID[ATT_BT_UUID_SIZE] = {0xF0, 0xFF};
+static CONST uint8 testLongUUID[ATT_BT_UUID_SIZE] = {0xF1, 0xFF};
+static CONST uint8 testQueuedUUID[ATT_BT_UUID_SIZE] = {0xF2, 0xFF};
+static CONST gattAttrType_t testService = {ATT_BT_UUID_SIZE, testServUUID};
+static uint8 testProps = GATT_PROP_READ | GATT_PROP_WRITE;
+
+static uint8 longValue[LONG_VALUE_MAX];
+static uint16 longLen;
+static uint8 queuedValue[QUEUED_VALUE_MAX];
+static uint16 queuedLen;
+
+static gattAttribute_t testAttrTbl[] = {
+    {{ATT_BT_UUID_SIZE, primaryServiceUUID}, GATT_PERMIT_READ, 0, (uint8*)&testService},
+    {{ATT_BT_UUID_SIZE, characterUUID}, GATT_PERMIT_READ, 0, &testProps},
+    {{ATT_BT_UUID_SIZE, testLongUUID}, GATT_PERMIT_READ | GATT_PERMIT_WRITE, 0, longValue},
+    {{ATT_BT_UUID_SIZE, characterUUID}, GATT_PERMIT_READ, 0, &testProps},
+    {{ATT_BT_UUID_SIZE, testQueuedUUID}, GATT_PERMIT_READ | GATT_PERMIT_WRITE, 0, queuedValue},
+};
+
+#define LONG_HANDLE         (testAttrTbl[2].handle)
+#define QUEUED_HANDLE       (testAttrTbl[4].handle)
+
+//the GATT service is registered first, see gattAttrTbl
+#define GATT_SVC_HANDLE     1
+#define SVC_CHG_CCCD_HANDLE 4
+#define CLIENT_FEAT_HANDLE  6
+
+//registered and deregistered again to change the database
+static CONST uint8 extraServUUID[ATT_BT_UUID_SIZE] = {0xE0, 0xFF};
+static CONST gattAttrType_t extraService = {ATT_BT_UUID_SIZE, extraServUUID};
+static gattAttribute_t extraAttrTbl[] = {
+    {{ATT_BT_UUID_SIZE, primaryServiceUUID}, GATT_PERMIT_READ, 0, (uint8*)&extraService},
+};
+
+static struct{
+    uint8 value[LONG_VALUE_MAX];
+    uint16 len;
+    uint8 active;
+    uint8 tooLong;
+}s_staged[GATT_MAX_NUM_CONN];
+
+//pfnLongWriteAttrCB calls per connection and op
+static uint8 s_ops[GATT_MAX_NUM_CONN][4];
+static uint8 s_writeCalls;
+
+static bStatus_t test_WriteAttrCB(uint16 connHandle, gattAttribute_t* pAttr,
+                                  uint8* pValue, uint8 len, uint16 offset)
+{
+    s_writeCalls++;
+
+    if(pAttr->handle == QUEUED_HANDLE){
+        if(offset + len > QUEUED_VALUE_MAX)
+            return ATT_ERR_INVALID_OFFSET;
+        memcpy(&queuedValue[offset], pValue, len);
+        queuedLen = offset + len;
+        return SUCCESS;
+    }
+
+    if(pAttr->handle == LONG_HANDLE && offset == 0){
+        memcpy(longValue, pValue, len);
+        longLen = len;
+        return SUCCESS;
+    }
+    return ATT_ERR_ATTR_NOT_LONG;
+}
+
+static bStatus_t test_LongWriteAttrCB(uint16 connHandle, gattAttribute_t* pAttr,
+                                      uint8* pValue, uint8 len, uint16 offset, uint8 op)
+{
+    if(pAttr->handle != LONG_HANDLE)
+        return GATT_LONG_WRITE_QUEUE;
+
+    s_ops[connHandle][op]++;
+
+    switch(op){
+    case GATT_LONG_WRITE_PREPARE:
+        if(!s_staged[connHandle].active){
+            s_staged[connHandle].active = TRUE;
+            s_staged[connHandle].len = 0;
+            s_staged[connHandle].tooLong = FALSE;
+        }
+        //reported at Execute Write
+        if(offset + len > LONG_VALUE_MAX){
+            s_staged[connHandle].tooLong = TRUE;
+            return SUCCESS;
+        }
+        memcpy(&s_staged[connHandle].value[offset], pValue, len);
+        if(offset + len > s_staged[connHandle].len)
+            s_staged[connHandle].len = offset + len;
+        return SUCCESS;
+
+    case GATT_LONG_WRITE_EXECUTE:
+        s_staged[connHandle].active = FALSE;
+        if(s_staged[connHandle].tooLong)
+            return ATT_ERR_INVALID_OFFSET;
+        memcpy(longValue, s_staged[connHandle].value, s_staged[connHandle].len);
+        longLen = s_staged[connHandle].len;
+        return SUCCESS;
+
+    default:
+        s_staged[connHandle].active = FALSE;
+        return SUCCESS;
+    }
+}
+
+static CONST gattServiceCBs_t testCBs = {
+    NULL,
+    test_WriteAttrCB,
+    NULL,
+    test_LongWriteAttrCB,
+    NULL
+};
+
+static CONST gattServiceCBs_t extraCBs = {NULL, NULL, NULL, NULL, NULL};
+
+/*
+random databases for the UUID index: one service per table, a primary or
+secondary service declaration first, then characteristic declarations and
+values the service hands out through pfnGetAttrValueCB
+*/
+#define POOL_ATTRS          128
+#define DB_SERVICES_MAX     12
+#define DB_ATTRS_MAX        8
+#define DB_ROUNDS           20
+#define DB_QUERIES          1000
+#define DB_CONN             0
+
+static CONST uint8 uuidA1[ATT_BT_UUID_SIZE] = {0x01, 0xA0};
+static CONST uint8 uuidA2[ATT_BT_UUID_SIZE] = {0x02, 0xA0};
+static CONST uint8 uuidB1[ATT_BT_UUID_SIZE] = {0x01, 0xB0};
+static CONST uint8 uuidB2[ATT_BT_UUID_SIZE] = {0x02, 0xB0};
+//the same UUIDs on the Bluetooth Base UUID
+static CONST uint8 uuidA1Base[ATT_UUID_SIZE] = {
+    0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x01, 0xA0, 0x00, 0x00};
+static CONST uint8 uuidA2Base[ATT_UUID_SIZE] = {
+    0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x02, 0xA0, 0x00, 0x00};
+static CONST uint8 primaryBase[ATT_UUID_SIZE] = {
+    0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00};
+//others share one index key
+static CONST uint8 uuidX[ATT_UUID_SIZE] = {
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0, 0x93, 0xF3, 0xA3, 0xB5, 0x01, 0x00, 0x40, 0x6E};
+static CONST uint8 uuidY[ATT_UUID_SIZE] = {
+    0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0, 0x93, 0xF3, 0xA3, 0xB5, 0x02, 0x00, 0x40, 0x6E};
+
+static CONST gattAttrType_t primaryType = {ATT_BT_UUID_SIZE, primaryServiceUUID};
+static CONST gattAttrType_t secondaryType = {ATT_BT_UUID_SIZE, secondaryServiceUUID};
+static CONST gattAttrType_t charType = {ATT_BT_UUID_SIZE, characterUUID};
+static CONST gattAttrType_t serviceTypes[] = {
+    {ATT_BT_UUID_SIZE, uuidB1}, {ATT_BT_UUID_SIZE, uuidB2}, {ATT_UUID_SIZE, uuidX}};
+static CONST gattAttrType_t valueTypes[] = {
+    {ATT_BT_UUID_SIZE, uuidA1}, {ATT_BT_UUID_SIZE, uuidA2}, {ATT_UUID_SIZE, uuidA1Base},
+    {ATT_UUID_SIZE, uuidA2Base}, {ATT_UUID_SIZE, uuidX}, {ATT_UUID_SIZE, uuidY}};
+static CONST gattAttrType_t groupTypes[] = {
+    {ATT_BT_UUID_SIZE, primaryServiceUUID}, {ATT_BT_UUID_SIZE, secondaryServiceUUID},
+    {ATT_UUID_SIZE, primaryBase}};
+
+#define NUM_TYPES(t)        (sizeof(t) / sizeof((t)[0]))
+
+static gattAttribute_t s_pool[POOL_ATTRS];
+static uint8 s_poolValue[POOL_ATTRS][2];
+static uint16 s_poolUsed;
+static uint8 dbProps = GATT_PROP_READ;
+static uint16 s_dbServices[DB_SERVICES_MAX];
+static uint8 s_dbNum;
+
+static bStatus_t db_GetAttrValueCB(uint16 connHandle, gattAttribute_t* pAttr, uint8** ppValue, uint16* pLen)
+{
+    *ppValue = s_poolValue[pAttr - s_pool];
+    *pLen = 2;
+    return SUCCESS;
+}
+
+static CONST gattServiceCBs_t dbCBs = {NULL, NULL, NULL, NULL, db_GetAttrValueCB};
+
+//a value attribute if pValue is NULL
+static void db_attr(CONST gattAttrType_t* pType, uint8* pValue)
+{
+    uint16 i = s_poolUsed++;
+    gattAttribute_t attr = {*pType, GATT_PERMIT_READ, 0, pValue ? pValue : s_poolValue[i]};
+
+    memcpy(&s_pool[i], &attr, sizeof(attr));
+    s_poolValue[i][0] = (uint8)(rnd() % 3);
+    s_poolValue[i][1] = 0;
+}
+
+static void db_register(uint16 first)
+{
+    CHECK(GATTServApp_RegisterService(&s_pool[first], s_poolUsed - first, &dbCBs) == SUCCESS);
+    s_dbServices[s_dbNum++] = s_pool[first].handle;
+}
+
+static void db_add_random(void)
+{
+    uint16 first = s_poolUsed;
+    uint8 num = 1 + rnd() % DB_ATTRS_MAX;
+    uint8 i;
+
+    db_attr((rnd() % 4) ? &primaryType : &secondaryType,
+            (uint8*)&serviceTypes[rnd() % NUM_TYPES(serviceTypes)]);
+    for(i = 1; i < num; i++){
+        //a declaration is always followed by its value
+        if(i < num - 1 && (rnd() & 1)){
+            db_attr(&charType, &dbProps);
+            i++;
+        }
+        db_attr(&valueTypes[rnd() % NUM_TYPES(valueTypes)], NULL);
+    }
+    db_register(first);
+}
+
+//a value longer than the MTU, read through pfnGetAttrValueCB
+#define BLOB_LEN            60
+
+static CONST uint8 blobUUID[ATT_BT_UUID_SIZE] = {0x03, 0xA0};
+static uint8 blobValue[BLOB_LEN];
+
+static gattAttribute_t blobAttrTbl[] = {
+    {{ATT_BT_UUID_SIZE, primaryServiceUUID}, GATT_PERMIT_READ, 0, (uint8*)&serviceTypes[1]},
+    {{ATT_BT_UUID_SIZE, characterUUID}, GATT_PERMIT_READ, 0, &dbProps},
+    {{ATT_BT_UUID_SIZE, blobUUID}, GATT_PERMIT_READ, 0, blobValue},
+};
+
+#define BLOB_HANDLE         (blobAttrTbl[2].handle)
+
+static bStatus_t blob_GetAttrValueCB(uint16 connHandle, gattAttribute_t* pAttr, uint8** ppValue, uint16* pLen)
+{
+    *ppValue = blobValue;
+    *pLen = BLOB_LEN;
+    return SUCCESS;
+}
+
+static CONST gattServiceCBs_t blobCBs = {NULL, NULL, NULL, NULL, blob_GetAttrValueCB};
+
+static void db_clear(void)
+{
+    gattAttribute_t* pAttrs;
+
+    while(s_dbNum > 0)
+        CHECK(GATTServApp_DeregisterService(s_dbServices[--s_dbNum], &pAttrs) == SUCCESS);
+    s_poolUsed = 0;
+}
+
+/*
+requests, each returns the opcode that went on air
+*/
+static void deliver(uint16 connHandle, uint8 method)
+{
+    s_msg.hdr.event = GATT_MSG_EVENT;
+    s_msg.hdr.status = SUCCESS;
+    s_msg.connHandle = connHandle;
+    s_msg.method = method;
+    s_pendingMsg = (uint8*)&s_msg;
+    memset(&s_rsp, 0, sizeof(s_rsp));
+
+    GATTServApp_ProcessEvent(TEST_TASK_ID, SYS_EVENT_MSG);
+}
+
+static uint8 prepare(uint16 connHandle, uint16 handle, uint16 offset, const uint8* pValue, uint8 len)
+{
+    memset(&s_msg.msg, 0, sizeof(s_msg.msg));
+    s_msg.msg.prepareWriteReq.handle = handle;
+    s_msg.msg.prepareWriteReq.offset = offset;
+    s_msg.msg.prepareWriteReq.len = len;
+    memcpy(s_msg.msg.prepareWriteReq.value, pValue, len);
+    deliver(connHandle, ATT_PREPARE_WRITE_REQ);
+    return s_rsp.opcode;
+}
+
+static uint8 read(uint16 connHandle, uint16 handle)
+{
+    memset(&s_msg.msg, 0, sizeof(s_msg.msg));
+    s_msg.msg.readReq.handle = handle;
+    deliver(connHandle, ATT_READ_REQ);
+    return s_rsp.opcode;
+}
+
+static uint8 read_blob(uint16 connHandle, uint16 handle, uint16 offset)
+{
+    memset(&s_msg.msg, 0, sizeof(s_msg.msg));
+    s_msg.msg.readBlobReq.handle = handle;
+    s_msg.msg.readBlobReq.offset = offset;
+    deliver(connHandle, ATT_READ_BLOB_REQ);
+    return s_rsp.opcode;
+}
+
+static uint8 write(uint16 connHandle, uint16 handle, const uint8* pValue, uint8 len)
+{
+    memset(&s_msg.msg, 0, sizeof(s_msg.msg));
+    s_msg.msg.writeReq.handle = handle;
+    s_msg.msg.writeReq.len = len;
+    memcpy(s_msg.msg.writeReq.value, pValue, len);
+    deliver(connHandle, ATT_WRITE_REQ);
+    return s_rsp.opcode;
+}
+
+static uint8 confirm(uint16 connHandle)
+{
+    memset(&s_msg.msg, 0, sizeof(s_msg.msg));
+    deliver(connHandle, ATT_HANDLE_VALUE_CFM);
+    return s_rsp.opcode;
+}
+
+static uint8 execute(uint16 connHandle, uint8 flags)
+{
+    memset(&s_msg.msg, 0, sizeof(s_msg.msg));
+    s_msg.msg.executeWriteReq.flags = flags;
+    deliver(connHandle, ATT_EXECUTE_WRITE_REQ);
+    return s_rsp.opcode;
+}
+
+//a whole value in PART_LEN parts, the way a client writes a long value
+static uint8 prepare_value(uint16 connHandle, uint16 handle, const uint8* pValue, uint16 len)
+{
+    uint16 offset;
+
+    for(offset = 0; offset < len; offset += PART_LEN){
+        uint8 n = (len - offset < PART_LEN) ? (uint8)(len - offset) : PART_LEN;
+
+        if(prepare(connHandle, handle, offset, pValue + offset, n) != ATT_PREPARE_WRITE_RSP)
+            return s_rsp.opcode;
+    }
+    return ATT_PREPARE_WRITE_RSP;
+}
+
+static void link_up(uint16 connHandle)
+{
+    s_connected[connHandle] = TRUE;
+    gAttMtuSize[connHandle] = ATT_MTU_SIZE_MIN;
+    s_linkCB(connHandle, LINKDB_STATUS_UPDATE_NEW);
+}
+
+static void link_down(uint16 connHandle)
+{
+    s_connected[connHandle] = FALSE;
+    s_linkCB(connHandle, LINKDB_STATUS_UPDATE_REMOVED);
+}
+
+static void db_changed(void)
+{
+    gattAttribute_t* pAttrs;
+
+    CHECK(GATTServApp_RegisterService(extraAttrTbl, GATT_NUM_ATTRS(extraAttrTbl), &extraCBs) == SUCCESS);
+    CHECK(GATTServApp_DeregisterService(extraAttrTbl[0].handle, &pAttrs) == SUCCESS);
+}
+
+//the end of a connection event, as the controller reports it
+static void conn_event(void)
+{
+    if(s_notice.event)
+        GATTServApp_ProcessEvent(s_notice.task, s_notice.event);
+}
+
+static void fill(uint8* p, uint16 len, uint8 seed)
+{
+    uint16 i;
+
+    for(i = 0; i < len; i++)
+        p[i] = (uint8)(seed + i * 7);
+}
+
+/*
+reference search: every attribute of every table, UUIDs compared as 128-bit
+*/
+static void ref_uuid128(const uint8* pUUID, uint8 len, uint8* pOut)
+{
+    memcpy(pOut, btBaseUUID, ATT_UUID_SIZE);
+    if(len == ATT_BT_UUID_SIZE){
+        pOut[12] = pUUID[0];
+        pOut[13] = pUUID[1];
+    }else{
+        memcpy(pOut, pUUID, ATT_UUID_SIZE);
+    }
+}
+
+static int ref_match(gattAttribute_t* pAttr, CONST gattAttrType_t* pType)
+{
+    uint8 a[ATT_UUID_SIZE], b[ATT_UUID_SIZE];
+
+    ref_uuid128(pAttr->type.uuid, pAttr->type.len, a);
+    ref_uuid128(pType->uuid, pType->len, b);
+    return memcmp(a, b, ATT_UUID_SIZE) == 0;
+}
+
+static gattService_t* ref_service(uint16 handle)
+{
+    uint8 i;
+
+    for(i = 0; i < s_numServices; i++){
+        if(handle >= s_services[i].attrs[0].handle &&
+           handle < s_services[i].attrs[0].handle + s_services[i].numAttrs)
+            return &s_services[i];
+    }
+    return NULL;
+}
+
+static gattAttribute_t* ref_attr(uint16 handle)
+{
+    gattService_t* pService = ref_service(handle);
+
+    return pService ? &pService->attrs[handle - pService->attrs[0].handle] : NULL;
+}
+
+//handles of the attributes of a type in a range
+static uint16 ref_find(uint16 start, uint16 end, CONST gattAttrType_t* pType, uint16* pFound)
+{
+    uint32 h;
+    uint16 n = 0;
+
+    for(h = start; h <= end && h < s_nextHandle; h++){
+        gattAttribute_t* pAttr = ref_attr((uint16)h);
+
+        if(pAttr != NULL && ref_match(pAttr, pType))
+            pFound[n++] = (uint16)h;
+    }
+    return n;
+}
+
+//the last handle before the next of the same type, or the end of the
+//attribute's own table if the next one starts another table
+static uint16 ref_group_end(uint16 handle, uint16 next)
+{
+    gattService_t* pService;
+
+    if(next == 0)
+        return GATT_MAX_HANDLE;
+    if(ref_service(next)->attrs[0].handle != next)
+        return next - 1;
+    pService = ref_service(handle);
+    return pService->attrs[0].handle + pService->numAttrs - 1;
+}
+
+static uint8 ref_value(gattAttribute_t* pAttr, uint8* pOut)
+{
+    if(ref_match(pAttr, &primaryType) || ref_match(pAttr, &secondaryType)){
+        CONST gattAttrType_t* pService = (CONST gattAttrType_t*)pAttr->pValue;
+
+        memcpy(pOut, pService->uuid, pService->len);
+        return pService->len;
+    }
+
+    if(ref_match(pAttr, &charType)){
+        gattAttribute_t* pValue = ref_attr(pAttr->handle + 1);
+
+        pOut[0] = *pAttr->pValue;
+        pOut[1] = LO_UINT16(pValue->handle);
+        pOut[2] = HI_UINT16(pValue->handle);
+        memcpy(&pOut[3], pValue->type.uuid, pValue->type.len);
+        return 3 + pValue->type.len;
+    }
+
+    memcpy(pOut, s_poolValue[pAttr - s_pool], 2);
+    return 2;
+}
+
+static void set_type(attAttrType_t* pReqType, CONST gattAttrType_t* pType)
+{
+    pReqType->len = pType->len;
+    memcpy(pReqType->uuid, pType->uuid, pType->len);
+}
+
+//as many pairs as have the length of the first and fit in the MTU
+static void check_read_by_type(uint16 start, uint16 end, CONST gattAttrType_t* pType)
+{
+    attReadByTypeRsp_t* pRsp = &s_rsp.u.readByType;
+    uint16 found[POOL_ATTRS + 16];
+    uint16 n = ref_find(start, end, pType, found);
+    uint16 mtu = gAttMtuSize[DB_CONN];
+    uint8 list[ATT_MTU_SIZE];
+    uint16 i, dataLen = 0;
+    uint8 setLen = 0, num = 0;
+
+    memset(&s_msg.msg, 0, sizeof(s_msg.msg));
+    s_msg.msg.readByTypeReq.startHandle = start;
+    s_msg.msg.readByTypeReq.endHandle = end;
+    set_type(&s_msg.msg.readByTypeReq.type, pType);
+    deliver(DB_CONN, ATT_READ_BY_TYPE_REQ);
+
+    if(n == 0){
+        CHECK(s_rsp.opcode == ATT_ERROR_RSP && s_rsp.err.errCode == ATT_ERR_ATTR_NOT_FOUND &&
+              s_rsp.err.handle == start);
+        return;
+    }
+
+    for(i = 0; i < n; i++){
+        uint8 value[3 + ATT_UUID_SIZE];
+        uint8 len = ref_value(ref_attr(found[i]), value);
+
+        if(len > mtu - 4)
+            len = mtu - 4;
+        if(i == 0)
+            setLen = 2 + len;
+        else if(2 + len != setLen || dataLen + setLen > mtu - 2)
+            break;
+        list[dataLen++] = LO_UINT16(found[i]);
+        list[dataLen++] = HI_UINT16(found[i]);
+        memcpy(&list[dataLen], value, len);
+        dataLen += len;
+        num++;
+    }
+
+    CHECK(s_rsp.opcode == ATT_READ_BY_TYPE_RSP);
+    CHECK(pRsp->numPairs == num && pRsp->len == setLen && memcmp(pRsp->dataList, list, dataLen) == 0);
+}
+
+static void check_read_by_grp_type(uint16 start, uint16 end, CONST gattAttrType_t* pType)
+{
+    attReadByGrpTypeRsp_t* pRsp = &s_rsp.u.readByGrpType;
+    uint16 found[POOL_ATTRS + 16];
+    uint16 n = ref_find(start, end, pType, found);
+    uint16 mtu = gAttMtuSize[DB_CONN];
+    uint8 list[ATT_MTU_SIZE];
+    uint16 i, dataLen = 0;
+    uint8 setLen = 0, num = 0;
+
+    memset(&s_msg.msg, 0, sizeof(s_msg.msg));
+    s_msg.msg.readByGrpTypeReq.startHandle = start;
+    s_msg.msg.readByGrpTypeReq.endHandle = end;
+    set_type(&s_msg.msg.readByGrpTypeReq.type, pType);
+    deliver(DB_CONN, ATT_READ_BY_GRP_TYPE_REQ);
+
+    if(n == 0){
+        CHECK(s_rsp.opcode == ATT_ERROR_RSP && s_rsp.err.errCode == ATT_ERR_ATTR_NOT_FOUND &&
+              s_rsp.err.handle == start);
+        return;
+    }
+
+    for(i = 0; i < n; i++){
+        uint8 value[ATT_UUID_SIZE];
+        uint8 len = ref_value(ref_attr(found[i]), value);
+        uint16 grpEnd = ref_group_end(found[i], (i + 1 < n) ? found[i + 1] : 0);
+
+        if(i == 0)
+            setLen = 4 + len;
+        else if(4 + len != setLen || dataLen + setLen > mtu - 2)
+            break;
+        list[dataLen++] = LO_UINT16(found[i]);
+        list[dataLen++] = HI_UINT16(found[i]);
+        list[dataLen++] = LO_UINT16(grpEnd);
+        list[dataLen++] = HI_UINT16(grpEnd);
+        memcpy(&list[dataLen], value, len);
+        dataLen += len;
+        num++;
+    }
+
+    CHECK(s_rsp.opcode == ATT_READ_BY_GRP_TYPE_RSP);
+    CHECK(pRsp->numGrps == num && pRsp->len == setLen && memcmp(pRsp->dataList, list, dataLen) == 0);
+}
+
+static void check_find_by_type_value(uint16 start, uint16 end, CONST gattAttrType_t* pType,
+                                     const uint8* pValue, uint8 valueLen)
+{
+    attFindByTypeValueRsp_t* pRsp = &s_rsp.u.findByTypeValue;
+    uint16 found[POOL_ATTRS + 16];
+    uint16 n = ref_find(start, end, pType, found);
+    uint16 mtu = gAttMtuSize[DB_CONN];
+    attHandlesInfo_t info[4];
+    uint16 i;
+    uint8 num = 0;
+
+    memset(&s_msg.msg, 0, sizeof(s_msg.msg));
+    s_msg.msg.findByTypeValueReq.startHandle = start;
+    s_msg.msg.findByTypeValueReq.endHandle = end;
+    s_msg.msg.findByTypeValueReq.type.len = ATT_BT_UUID_SIZE;
+    memcpy(s_msg.msg.findByTypeValueReq.type.uuid, pType->uuid, ATT_BT_UUID_SIZE);
+    s_msg.msg.findByTypeValueReq.len = valueLen;
+    memcpy(s_msg.msg.findByTypeValueReq.value, pValue, valueLen);
+    deliver(DB_CONN, ATT_FIND_BY_TYPE_VALUE_REQ);
+
+    CHECK(g_ATT_MAX_NUM_HANDLES_INFO == 4);
+    for(i = 0; i < n && num < 4; i++){
+        uint8 value[3 + ATT_UUID_SIZE];
+        uint8 len = ref_value(ref_attr(found[i]), value);
+
+        if(len > mtu - 7)
+            len = mtu - 7;
+        if(len != valueLen || memcmp(value, pValue, len) != 0)
+            continue;
+        info[num].handle = found[i];
+        info[num++].grpEndHandle = ref_group_end(found[i], (i + 1 < n) ? found[i + 1] : 0);
+    }
+
+    if(num == 0){
+        CHECK(s_rsp.opcode == ATT_ERROR_RSP && s_rsp.err.errCode == ATT_ERR_ATTR_NOT_FOUND &&
+              s_rsp.err.handle == start);
+        return;
+    }
+
+    CHECK(s_rsp.opcode == ATT_FIND_BY_TYPE_VALUE_RSP && pRsp->numInfo == num);
+    for(i = 0; i < num && i < pRsp->numInfo; i++)
+        CHECK(pRsp->handlesInfo[i].handle == info[i].handle &&
+              pRsp->handlesInfo[i].grpEndHandle == info[i].grpEndHandle);
+}
+
+/*
+tests
+*/
+static void test_long_write(void)
+{
+    uint8 a[LONG_VALUE_MAX], b[LONG_VALUE_MAX], q[QUEUED_VALUE_MAX];
+
+    fill(a, sizeof(a), 1);
+    fill(b, sizeof(b), 100);
+    fill(q, sizeof(q), 50);
+    memset(s_ops, 0, sizeof(s_ops));
+    link_up(0);
+    link_up(1);
+
+    //staged by the service, written at Execute Write
+    s_writeCalls = 0;
+    CHECK(prepare_value(0, LONG_HANDLE, a, 90) == ATT_PREPARE_WRITE_RSP);
+    CHECK(s_ops[0][GATT_LONG_WRITE_PREPARE] == 5);
+    CHECK(longLen == 0 && s_writeCalls == 0);
+    CHECK(execute(0, ATT_WRITE_PREPARED_VALUES) == ATT_EXECUTE_WRITE_RSP);
+    CHECK(s_ops[0][GATT_LONG_WRITE_EXECUTE] == 1);
+    CHECK(longLen == 90 && memcmp(longValue, a, 90) == 0);
+
+    //nothing left to execute
+    CHECK(execute(0, ATT_WRITE_PREPARED_VALUES) == ATT_EXECUTE_WRITE_RSP);
+    CHECK(s_ops[0][GATT_LONG_WRITE_EXECUTE] == 1);
+
+    //cancelled, the value stays
+    CHECK(prepare_value(0, LONG_HANDLE, b, 40) == ATT_PREPARE_WRITE_RSP);
+    CHECK(execute(0, ATT_CANCEL_PREPARED_WRITES) == ATT_EXECUTE_WRITE_RSP);
+    CHECK(s_ops[0][GATT_LONG_WRITE_CANCEL] == 1 && !s_staged[0].active);
+    CHECK(longLen == 90 && memcmp(longValue, a, 90) == 0);
+
+    //two clients at once, each gets its own value in
+    CHECK(prepare_value(0, LONG_HANDLE, a, 60) == ATT_PREPARE_WRITE_RSP);
+    CHECK(prepare_value(1, LONG_HANDLE, b, LONG_VALUE_MAX) == ATT_PREPARE_WRITE_RSP);
+    CHECK(execute(1, ATT_WRITE_PREPARED_VALUES) == ATT_EXECUTE_WRITE_RSP);
+    CHECK(longLen == LONG_VALUE_MAX && memcmp(longValue, b, LONG_VALUE_MAX) == 0);
+    CHECK(s_staged[0].active);
+    CHECK(execute(0, ATT_WRITE_PREPARED_VALUES) == ATT_EXECUTE_WRITE_RSP);
+    CHECK(longLen == 60 && memcmp(longValue, a, 60) == 0);
+
+    //a value written in place next to one from the queue
+    s_writeCalls = 0;
+    CHECK(prepare_value(0, LONG_HANDLE, b, 30) == ATT_PREPARE_WRITE_RSP);
+    CHECK(prepare(0, QUEUED_HANDLE, 0, q, PART_LEN) == ATT_PREPARE_WRITE_RSP);
+    CHECK(s_writeCalls == 0);
+    CHECK(execute(0, ATT_WRITE_PREPARED_VALUES) == ATT_EXECUTE_WRITE_RSP);
+    CHECK(s_writeCalls == 1 && queuedLen == PART_LEN && memcmp(queuedValue, q, PART_LEN) == 0);
+    CHECK(longLen == 30 && memcmp(longValue, b, 30) == 0);
+
+    //the queue holds GATT_MAX_NUM_PREPARE_WRITES values for all clients
+    CHECK(GATT_MAX_NUM_PREPARE_WRITES == 1);
+    CHECK(prepare(1, QUEUED_HANDLE, 0, q, 10) == ATT_PREPARE_WRITE_RSP);
+    CHECK(prepare(0, QUEUED_HANDLE, 10, q, 10) == ATT_ERROR_RSP);
+    CHECK(s_rsp.err.reqOpcode == ATT_PREPARE_WRITE_REQ && s_rsp.err.errCode == ATT_ERR_PREPARE_QUEUE_FULL &&
+          s_rsp.err.handle == QUEUED_HANDLE);
+    CHECK(execute(1, ATT_CANCEL_PREPARED_WRITES) == ATT_EXECUTE_WRITE_RSP);
+    CHECK(prepare(0, QUEUED_HANDLE, 10, q, 10) == ATT_PREPARE_WRITE_RSP);
+    CHECK(execute(0, ATT_CANCEL_PREPARED_WRITES) == ATT_EXECUTE_WRITE_RSP);
+
+    //errors of the prepared values come at Execute Write, with the handle
+    s_ops[0][GATT_LONG_WRITE_EXECUTE] = 0;
+    CHECK(prepare(0, LONG_HANDLE, 0, a, 10) == ATT_PREPARE_WRITE_RSP);
+    CHECK(prepare(0, LONG_HANDLE, LONG_VALUE_MAX - 5, a, 10) == ATT_PREPARE_WRITE_RSP);
+    CHECK(execute(0, ATT_WRITE_PREPARED_VALUES) == ATT_ERROR_RSP);
+    CHECK(s_rsp.err.reqOpcode == ATT_EXECUTE_WRITE_REQ && s_rsp.err.errCode == ATT_ERR_INVALID_OFFSET &&
+          s_rsp.err.handle == LONG_HANDLE);
+    CHECK(s_ops[0][GATT_LONG_WRITE_EXECUTE] == 1);
+    CHECK(longLen == 30 && memcmp(longValue, b, 30) == 0);
+
+    //a dropped link cancels what the client staged
+    CHECK(prepare_value(1, LONG_HANDLE, a, 50) == ATT_PREPARE_WRITE_RSP);
+    link_down(1);
+    CHECK(s_ops[1][GATT_LONG_WRITE_CANCEL] == 1 && !s_staged[1].active);
+    link_up(1);
+    CHECK(execute(1, ATT_WRITE_PREPARED_VALUES) == ATT_EXECUTE_WRITE_RSP);
+    CHECK(longLen == 30 && memcmp(longValue, b, 30) == 0);
+
+    link_down(0);
+    link_down(1);
+}
+
+static void test_long_write_full(void)
+{
+    uint8 a[PART_LEN];
+    uint16 conn;
+
+    fill(a, sizeof(a), 9);
+    memset(s_ops, 0, sizeof(s_ops));
+
+    //one attribute per entry of the long write table, then no more
+    for(conn = 0; conn < GATT_MAX_NUM_LONG_WRITES; conn++){
+        link_up(conn);
+        CHECK(prepare(conn, LONG_HANDLE, 0, a, sizeof(a)) == ATT_PREPARE_WRITE_RSP);
+    }
+    link_up(conn);
+    CHECK(prepare(conn, LONG_HANDLE, 0, a, sizeof(a)) == ATT_ERROR_RSP);
+    CHECK(s_rsp.err.errCode == ATT_ERR_PREPARE_QUEUE_FULL);
+    CHECK(s_ops[conn][GATT_LONG_WRITE_CANCEL] == 1 && !s_staged[conn].active);
+
+    for(conn = 0; conn <= GATT_MAX_NUM_LONG_WRITES; conn++){
+        CHECK(execute(conn, ATT_CANCEL_PREPARED_WRITES) == ATT_EXECUTE_WRITE_RSP);
+        link_down(conn);
+    }
+}
+
+static void test_service_changed(void)
+{
+    static const uint8 ind[2] = {LO_UINT16(GATT_CLIENT_CFG_INDICATE), HI_UINT16(GATT_CLIENT_CFG_INDICATE)};
+    static const uint8 feat = GATT_CLIENT_FEAT_ROBUST_CACHING;
+
+    link_up(0);
+    CHECK(write(0, SVC_CHG_CCCD_HANDLE, ind, sizeof(ind)) == ATT_WRITE_RSP);
+    CHECK(write(0, CLIENT_FEAT_HANDLE, &feat, 1) == ATT_WRITE_RSP);
+    CHECK(read(0, GATT_SVC_HANDLE) == ATT_READ_RSP);
+
+    //the confirmation of some other indication leaves it change-unaware
+    db_changed();
+    CHECK(confirm(0) == 0);
+    CHECK(read(0, GATT_SVC_HANDLE) == ATT_ERROR_RSP && s_rsp.err.errCode == ATT_ERR_DATABASE_OUT_OF_SYNC);
+    //the next request after the error is served
+    CHECK(read(0, GATT_SVC_HANDLE) == ATT_READ_RSP);
+
+    //that of the Service Changed Indication makes it change-aware
+    db_changed();
+    CHECK(GATTServApp_SendServiceChangedInd(0, TEST_TASK_ID) == SUCCESS);
+    CHECK(confirm(0) == 0);
+    CHECK(read(0, GATT_SVC_HANDLE) == ATT_READ_RSP);
+
+    //sent for another task, the confirmation goes to that task
+    db_changed();
+    CHECK(GATTServApp_SendServiceChangedInd(0, TEST_TASK_ID + 1) == SUCCESS);
+    CHECK(confirm(0) == 0);
+    CHECK(read(0, GATT_SVC_HANDLE) == ATT_ERROR_RSP && s_rsp.err.errCode == ATT_ERR_DATABASE_OUT_OF_SYNC);
+
+    //a dropped link forgets it was pending
+    db_changed();
+    CHECK(GATTServApp_SendServiceChangedInd(0, TEST_TASK_ID) == SUCCESS);
+    link_down(0);
+    link_up(0);
+    CHECK(write(0, CLIENT_FEAT_HANDLE, &feat, 1) == ATT_WRITE_RSP);
+    db_changed();
+    CHECK(confirm(0) == 0);
+    CHECK(read(0, GATT_SVC_HANDLE) == ATT_ERROR_RSP && s_rsp.err.errCode == ATT_ERR_DATABASE_OUT_OF_SYNC);
+
+    link_down(0);
+}
+
+//one CCCD at each end of the CCCD store and one with a gattCharCfg_t table
+static CONST uint8 cccdServUUID[ATT_BT_UUID_SIZE] = {0xE1, 0xFF};
+static CONST gattAttrType_t cccdService = {ATT_BT_UUID_SIZE, cccdServUUID};
+static gattCharCfg_t legacyCharCfg[GATT_MAX_NUM_CONN];
+
+static gattAttribute_t cccdAttrTbl[] = {
+    {{ATT_BT_UUID_SIZE, primaryServiceUUID}, GATT_PERMIT_READ, 0, (uint8*)&cccdService},
+    {{ATT_BT_UUID_SIZE, clientCharCfgUUID}, GATT_PERMIT_READ | GATT_PERMIT_WRITE, 0, GATT_CCCD(GATT_CCCD_APP)},
+    {{ATT_BT_UUID_SIZE, clientCharCfgUUID}, GATT_PERMIT_READ | GATT_PERMIT_WRITE, 0, GATT_CCCD(GATT_MAX_NUM_CCCD - 1)},
+    {{ATT_BT_UUID_SIZE, clientCharCfgUUID}, GATT_PERMIT_READ | GATT_PERMIT_WRITE, 0, (uint8*)legacyCharCfg},
+};
+
+static bStatus_t cccd_WriteAttrCB(uint16 connHandle, gattAttribute_t* pAttr,
+                                  uint8* pValue, uint8 len, uint16 offset)
+{
+    return GATTServApp_ProcessCCCWriteReq(connHandle, pAttr, pValue, len, offset, GATT_CLIENT_CFG_NOTIFY);
+}
+
+static CONST gattServiceCBs_t cccdCBs = {NULL, cccd_WriteAttrCB, NULL, NULL, NULL};
+
+static void test_cccd_store(void)
+{
+    static const uint8 noti[2] = {LO_UINT16(GATT_CLIENT_CFG_NOTIFY), HI_UINT16(GATT_CLIENT_CFG_NOTIFY)};
+    static const uint8 ind[2] = {LO_UINT16(GATT_CLIENT_CFG_INDICATE), HI_UINT16(GATT_CLIENT_CFG_INDICATE)};
+    uint8 saved[GATT_CCCD_STORE_SIZE], other[GATT_CCCD_STORE_SIZE];
+    gattAttribute_t* pAttrs;
+    uint16 conn;
+    uint8 i;
+
+    //every 2 bits on their own, whatever their neighbours in the byte hold
+    for(conn = 0; conn < GATT_MAX_NUM_CONN; conn++)
+        for(i = 0; i < GATT_MAX_NUM_CCCD; i++)
+            CHECK(GATTServApp_WriteCCCD(conn, i, (i + conn) % 4) == SUCCESS);
+    for(conn = 0; conn < GATT_MAX_NUM_CONN; conn++)
+        for(i = 0; i < GATT_MAX_NUM_CCCD; i++)
+            CHECK(GATTServApp_ReadCCCD(conn, i) == (i + conn) % 4);
+    CHECK(GATTServApp_WriteCCCD(0, 1, GATT_CFG_NO_OPERATION) == SUCCESS);
+    CHECK(GATTServApp_ReadCCCD(0, 0) == 0 && GATTServApp_ReadCCCD(0, 1) == 0 && GATTServApp_ReadCCCD(0, 2) == 2);
+
+    //only notify and indicate, only for a client and an index of the store
+    CHECK(GATTServApp_WriteCCCD(0, 2, 0x0004) == INVALIDPARAMETER);
+    CHECK(GATTServApp_WriteCCCD(0, GATT_MAX_NUM_CCCD, GATT_CLIENT_CFG_NOTIFY) == INVALIDPARAMETER);
+    CHECK(GATTServApp_WriteCCCD(GATT_MAX_NUM_CONN, 0, GATT_CLIENT_CFG_NOTIFY) == INVALIDPARAMETER);
+    CHECK(GATTServApp_ReadCCCD(0, 2) == 2);
+    CHECK(GATTServApp_ReadCCCD(0, GATT_MAX_NUM_CCCD) == GATT_CFG_NO_OPERATION);
+    CHECK(GATTServApp_ReadCCCD(GATT_MAX_NUM_CONN, 0) == GATT_CFG_NO_OPERATION);
+
+    //saved and restored as a whole, into the same or another client
+    CHECK(GATTServApp_SaveCCCD(0, saved) == SUCCESS);
+    CHECK(GATTServApp_SaveCCCD(GATT_MAX_NUM_CONN, other) == INVALIDPARAMETER);
+    GATTServApp_InitCCCD(INVALID_CONNHANDLE);
+    for(conn = 0; conn < GATT_MAX_NUM_CONN; conn++)
+        for(i = 0; i < GATT_MAX_NUM_CCCD; i++)
+            CHECK(GATTServApp_ReadCCCD(conn, i) == GATT_CFG_NO_OPERATION);
+    CHECK(GATTServApp_RestoreCCCD(GATT_MAX_NUM_CONN - 1, saved) == SUCCESS);
+    CHECK(GATTServApp_RestoreCCCD(GATT_MAX_NUM_CONN, saved) == INVALIDPARAMETER);
+    for(i = 0; i < GATT_MAX_NUM_CCCD; i++)
+        CHECK(GATTServApp_ReadCCCD(GATT_MAX_NUM_CONN - 1, i) == (i == 1 ? 0 : i % 4));
+    CHECK(GATTServApp_SaveCCCD(GATT_MAX_NUM_CONN - 1, other) == SUCCESS);
+    CHECK(memcmp(saved, other, GATT_CCCD_STORE_SIZE) == 0);
+    GATTServApp_InitCCCD(GATT_MAX_NUM_CONN - 1);
+
+    //through ATT, the store and the legacy table side by side
+    GATTServApp_InitCharCfg(INVALID_CONNHANDLE, legacyCharCfg);
+    CHECK(GATTServApp_RegisterService(cccdAttrTbl, GATT_NUM_ATTRS(cccdAttrTbl), &cccdCBs) == SUCCESS);
+    CHECK(GATTServApp_GetCCCDIdx(cccdAttrTbl[1].handle) == GATT_CCCD_APP);
+    CHECK(GATTServApp_GetCCCDIdx(cccdAttrTbl[2].handle) == GATT_MAX_NUM_CCCD - 1);
+    CHECK(GATTServApp_GetCCCDIdx(cccdAttrTbl[3].handle) == GATT_CCCD_IDX_INVALID);
+    CHECK(GATTServApp_GetCCCDIdx(cccdAttrTbl[0].handle) == GATT_CCCD_IDX_INVALID);
+    link_up(0);
+    CHECK(write(0, cccdAttrTbl[1].handle, noti, sizeof(noti)) == ATT_WRITE_RSP);
+    CHECK(write(0, cccdAttrTbl[3].handle, noti, sizeof(noti)) == ATT_WRITE_RSP);
+    CHECK(GATTServApp_ReadCCCD(0, GATT_CCCD_APP) == GATT_CLIENT_CFG_NOTIFY);
+    CHECK(GATTServApp_ReadCCCD(0, GATT_MAX_NUM_CCCD - 1) == GATT_CFG_NO_OPERATION);
+    CHECK(GATTServApp_ReadCharCfg(0, legacyCharCfg) == GATT_CLIENT_CFG_NOTIFY);
+    CHECK(read(0, cccdAttrTbl[1].handle) == ATT_READ_RSP && s_rsp.u.read.len == 2 &&
+          s_rsp.u.read.value[0] == GATT_CLIENT_CFG_NOTIFY && s_rsp.u.read.value[1] == 0);
+    CHECK(read(0, cccdAttrTbl[2].handle) == ATT_READ_RSP && s_rsp.u.read.value[0] == 0);
+    //a configuration the characteristic doesn't allow is left out
+    CHECK(write(0, cccdAttrTbl[2].handle, ind, sizeof(ind)) == ATT_ERROR_RSP &&
+          s_rsp.err.errCode == ATT_ERR_INVALID_VALUE);
+    CHECK(GATTServApp_ReadCCCD(0, GATT_MAX_NUM_CCCD - 1) == GATT_CFG_NO_OPERATION);
+
+    //cleared when the link drops, then restored the way the Bond Manager does
+    CHECK(GATTServApp_SaveCCCD(0, saved) == SUCCESS);
+    link_down(0);
+    CHECK(GATTServApp_ReadCCCD(0, GATT_CCCD_APP) == GATT_CFG_NO_OPERATION);
+    link_up(0);
+    CHECK(GATTServApp_RestoreCCCD(0, saved) == SUCCESS);
+    CHECK(read(0, cccdAttrTbl[1].handle) == ATT_READ_RSP && s_rsp.u.read.value[0] == GATT_CLIENT_CFG_NOTIFY);
+    link_down(0);
+
+    GATTServApp_InitCharCfg(INVALID_CONNHANDLE, legacyCharCfg);
+    CHECK(GATTServApp_DeregisterService(cccdAttrTbl[0].handle, &pAttrs) == SUCCESS);
+}
+
+static void test_conn_evt_notice(void)
+{
+    static attHandleValueNoti_t noti;
+
+    noti.handle = LONG_HANDLE;
+    noti.len = 4;
+    link_up(0);
+
+    //the application's notice comes from the GATT Server Application task
+    CHECK(GATTServApp_ConnEventDoneNoticeCmd(APP_TASK_ID, APP_EVT) == SUCCESS);
+    CHECK(s_notice.task == TEST_TASK_ID && s_notice.event != 0);
+    conn_event();
+    CHECK(s_appEvents == 1);
+
+    //queued notifications keep it after the application gives it up
+    s_notiRoom = 0;
+    s_notiSent = 0;
+    CHECK(GATTServApp_QueueNotification(0, &noti, 0) == SUCCESS);
+    CHECK(GATTServApp_ConnEventDoneNoticeCmd(APP_TASK_ID, 0) == SUCCESS);
+    CHECK(s_notice.event != 0);
+    s_notiRoom = 1;
+    conn_event();
+    CHECK(s_notiSent == 1 && s_appEvents == 1 && s_notice.event == 0);
+
+    //the application keeps it after the queue drains
+    CHECK(GATTServApp_ConnEventDoneNoticeCmd(APP_TASK_ID, APP_EVT) == SUCCESS);
+    s_notiRoom = 0;
+    CHECK(GATTServApp_QueueNotification(0, &noti, 0) == SUCCESS);
+    s_notiRoom = 1;
+    conn_event();
+    CHECK(s_notiSent == 2 && s_appEvents == 2 && s_notice.event != 0);
+    conn_event();
+    CHECK(s_appEvents == 3);
+
+    //given back once the dropped link's queue is flushed
+    s_notiRoom = 0;
+    CHECK(GATTServApp_QueueNotification(0, &noti, 0) == SUCCESS);
+    CHECK(GATTServApp_ConnEventDoneNoticeCmd(APP_TASK_ID, 0) == SUCCESS);
+    CHECK(s_notice.event != 0);
+    link_down(0);
+    CHECK(s_notice.event == 0 && s_notiSent == 2);
+
+    s_notiRoom = 0xFF;
+}
+
+static void test_noti_queue(void)
+{
+    static attHandleValueNoti_t noti;
+
+    link_up(0);
+    noti.len = 4;
+
+    //a value coalesced as urgent overtakes what was queued before it
+    s_notiRoom = 0;
+    s_notiSent = 0;
+    noti.handle = QUEUED_HANDLE;
+    CHECK(GATTServApp_QueueNotification(0, &noti, 0) == SUCCESS);
+    noti.handle = LONG_HANDLE;
+    CHECK(GATTServApp_QueueNotification(0, &noti, GATT_NOTI_FLAG_COALESCE) == SUCCESS);
+    CHECK(GATTServApp_QueueNotification(0, &noti, GATT_NOTI_FLAG_COALESCE | GATT_NOTI_FLAG_URGENT) == SUCCESS);
+    s_notiRoom = 0xFF;
+    conn_event();
+    CHECK(s_notiSent == 2 && s_notiHandles[0] == LONG_HANDLE && s_notiHandles[1] == QUEUED_HANDLE);
+
+    //and one coalesced as not urgent goes after the urgent ones
+    s_notiRoom = 0;
+    s_notiSent = 0;
+    CHECK(GATTServApp_QueueNotification(0, &noti, GATT_NOTI_FLAG_COALESCE | GATT_NOTI_FLAG_URGENT) == SUCCESS);
+    noti.handle = QUEUED_HANDLE;
+    CHECK(GATTServApp_QueueNotification(0, &noti, GATT_NOTI_FLAG_URGENT) == SUCCESS);
+    noti.handle = LONG_HANDLE;
+    CHECK(GATTServApp_QueueNotification(0, &noti, GATT_NOTI_FLAG_COALESCE) == SUCCESS);
+    s_notiRoom = 0xFF;
+    conn_event();
+    CHECK(s_notiSent == 2 && s_notiHandles[0] == QUEUED_HANDLE && s_notiHandles[1] == LONG_HANDLE);
+
+    //the value fits in the connection's ATT_MTU
+    noti.len = ATT_MTU_SIZE_MIN - 3;
+    CHECK(GATTServApp_QueueNotification(0, &noti, 0) == SUCCESS);
+    noti.len = ATT_MTU_SIZE_MIN - 2;
+    CHECK(GATTServApp_QueueNotification(0, &noti, 0) == INVALIDPARAMETER);
+    gAttMtuSize[0] = 100;
+    CHECK(GATTServApp_QueueNotification(0, &noti, 0) == SUCCESS);
+
+    link_down(0);
+}
+
+static void db_query(uint16 base)
+{
+    static CONST uint16 mtus[] = {ATT_MTU_SIZE_MIN, 48, 100};
+    static CONST gattAttrType_t* btTypes[] = {
+        &primaryType, &secondaryType, &charType, &valueTypes[0], &valueTypes[1]};
+    uint16 last = s_nextHandle - 1;
+    uint16 start = base + rnd() % (last - base + 2);
+    uint16 end = (rnd() % 4 == 0) ? GATT_MAX_HANDLE : start + rnd() % (last - start + 3);
+    CONST gattAttrType_t* pType;
+    uint8 value[ATT_UUID_SIZE];
+    uint8 len;
+
+    gAttMtuSize[DB_CONN] = mtus[rnd() % NUM_TYPES(mtus)];
+
+    switch(rnd() % 3){
+    case 0:
+        pType = (rnd() % 4) ? &valueTypes[rnd() % NUM_TYPES(valueTypes)] :
+                              &groupTypes[rnd() % NUM_TYPES(groupTypes)];
+        if(rnd() % 8 == 0)
+            pType = &charType;
+        check_read_by_type(start, end, pType);
+        break;
+
+    case 1:
+        check_read_by_grp_type(start, end, &groupTypes[rnd() % NUM_TYPES(groupTypes)]);
+        break;
+
+    default:
+        pType = btTypes[rnd() % NUM_TYPES(btTypes)];
+        if(pType == &primaryType || pType == &secondaryType){
+            CONST gattAttrType_t* pService = &serviceTypes[rnd() % NUM_TYPES(serviceTypes)];
+
+            len = pService->len;
+            memcpy(value, pService->uuid, len);
+        }else if(pType == &charType){
+            len = 5;
+            fill(value, len, (uint8)rnd());
+        }else{
+            len = 2;
+            value[0] = (uint8)(rnd() % 3);
+            value[1] = 0;
+        }
+        check_find_by_type_value(start, end, pType, value, len);
+        break;
+    }
+}
+
+static void test_uuid_index(void)
+{
+    uint16 round, i, base, first;
+    uint8 n;
+
+    link_up(DB_CONN);
+
+    //a secondary service between two primary services is in neither group
+    base = s_nextHandle;
+    first = s_poolUsed;
+    db_attr(&primaryType, (uint8*)&serviceTypes[0]);
+    db_attr(&charType, &dbProps);
+    db_attr(&valueTypes[0], NULL);
+    db_register(first);
+    first = s_poolUsed;
+    db_attr(&secondaryType, (uint8*)&serviceTypes[1]);
+    db_attr(&valueTypes[1], NULL);
+    db_register(first);
+    first = s_poolUsed;
+    db_attr(&primaryType, (uint8*)&serviceTypes[0]);
+    db_attr(&valueTypes[0], NULL);
+    db_register(first);
+    gAttMtuSize[DB_CONN] = ATT_MTU_SIZE_MIN;
+
+    memset(&s_msg.msg, 0, sizeof(s_msg.msg));
+    s_msg.msg.readByGrpTypeReq.startHandle = base;
+    s_msg.msg.readByGrpTypeReq.endHandle = GATT_MAX_HANDLE;
+    set_type(&s_msg.msg.readByGrpTypeReq.type, &primaryType);
+    deliver(DB_CONN, ATT_READ_BY_GRP_TYPE_REQ);
+    CHECK(s_rsp.opcode == ATT_READ_BY_GRP_TYPE_RSP && s_rsp.u.readByGrpType.numGrps == 2);
+    CHECK(BUILD_UINT16(s_rsp.u.readByGrpType.dataList[2], s_rsp.u.readByGrpType.dataList[3]) == base + 2);
+    CHECK(BUILD_UINT16(s_rsp.u.readByGrpType.dataList[8], s_rsp.u.readByGrpType.dataList[9]) == GATT_MAX_HANDLE);
+    check_find_by_type_value(base, GATT_MAX_HANDLE, &primaryType, uuidB1, ATT_BT_UUID_SIZE);
+    CHECK(s_rsp.u.findByTypeValue.numInfo == 2 && s_rsp.u.findByTypeValue.handlesInfo[0].grpEndHandle == base + 2);
+    db_clear();
+
+    for(round = 0; round < DB_ROUNDS; round++){
+        base = s_nextHandle;
+        n = 2 + rnd() % (DB_SERVICES_MAX - 1);
+        while(n--)
+            db_add_random();
+        for(i = 0; i < DB_QUERIES; i++)
+            db_query(base);
+        db_clear();
+    }
+
+    link_down(DB_CONN);
+}
+
+static void test_read_offset(void)
+{
+    attReadBlobRsp_t* pBlob = &s_rsp.u.readBlob;
+    gattAttribute_t* pAttrs;
+
+    fill(blobValue, BLOB_LEN, 3);
+    CHECK(GATTServApp_RegisterService(blobAttrTbl, GATT_NUM_ATTRS(blobAttrTbl), &blobCBs) == SUCCESS);
+    link_up(0);
+
+    //ATT_MTU - 1 octets of a longer value
+    CHECK(read(0, BLOB_HANDLE) == ATT_READ_RSP);
+    CHECK(s_rsp.u.read.len == ATT_MTU_SIZE_MIN - 1 && memcmp(s_rsp.u.read.value, blobValue, ATT_MTU_SIZE_MIN - 1) == 0);
+
+    //the rest from an offset, cut at ATT_MTU - 1
+    CHECK(read_blob(0, BLOB_HANDLE, 0) == ATT_READ_BLOB_RSP);
+    CHECK(pBlob->len == ATT_MTU_SIZE_MIN - 1 && memcmp(pBlob->value, blobValue, pBlob->len) == 0);
+    CHECK(read_blob(0, BLOB_HANDLE, 22) == ATT_READ_BLOB_RSP);
+    CHECK(pBlob->len == ATT_MTU_SIZE_MIN - 1 && memcmp(pBlob->value, &blobValue[22], pBlob->len) == 0);
+    CHECK(read_blob(0, BLOB_HANDLE, 50) == ATT_READ_BLOB_RSP);
+    CHECK(pBlob->len == 10 && memcmp(pBlob->value, &blobValue[50], 10) == 0);
+    CHECK(read_blob(0, BLOB_HANDLE, BLOB_LEN - 1) == ATT_READ_BLOB_RSP);
+    CHECK(pBlob->len == 1 && pBlob->value[0] == blobValue[BLOB_LEN - 1]);
+
+    //at the end the part is empty, past it the offset is invalid
+    CHECK(read_blob(0, BLOB_HANDLE, BLOB_LEN) == ATT_READ_BLOB_RSP && pBlob->len == 0);
+    CHECK(read_blob(0, BLOB_HANDLE, BLOB_LEN + 1) == ATT_ERROR_RSP);
+    CHECK(s_rsp.err.reqOpcode == ATT_READ_BLOB_REQ && s_rsp.err.errCode == ATT_ERR_INVALID_OFFSET &&
+          s_rsp.err.handle == BLOB_HANDLE);
+
+    //a declaration is not long
+    CHECK(read_blob(0, blobAttrTbl[0].handle, 1) == ATT_ERROR_RSP && s_rsp.err.errCode == ATT_ERR_ATTR_NOT_LONG);
+
+    //ATT_MTU - 4 octets in a Read By Type Response
+    memset(&s_msg.msg, 0, sizeof(s_msg.msg));
+    s_msg.msg.readByTypeReq.startHandle = 1;
+    s_msg.msg.readByTypeReq.endHandle = GATT_MAX_HANDLE;
+    s_msg.msg.readByTypeReq.type.len = ATT_BT_UUID_SIZE;
+    memcpy(s_msg.msg.readByTypeReq.type.uuid, blobUUID, ATT_BT_UUID_SIZE);
+    deliver(0, ATT_READ_BY_TYPE_REQ);
+    CHECK(s_rsp.opcode == ATT_READ_BY_TYPE_RSP && s_rsp.u.readByType.numPairs == 1);
+    CHECK(s_rsp.u.readByType.len == 2 + ATT_MTU_SIZE_MIN - 4);
+    CHECK(memcmp(&s_rsp.u.readByType.dataList[2], blobValue, ATT_MTU_SIZE_MIN - 4) == 0);
+
+    //a larger MTU takes the whole value
+    gAttMtuSize[0] = 100;
+    CHECK(read(0, BLOB_HANDLE) == ATT_READ_RSP);
+    CHECK(s_rsp.u.read.len == BLOB_LEN && memcmp(s_rsp.u.read.value, blobValue, BLOB_LEN) == 0);
+    CHECK(read_blob(0, BLOB_HANDLE, 30) == ATT_READ_BLOB_RSP);
+    CHECK(pBlob->len == BLOB_LEN - 30 && memcmp(pBlob->value, &blobValue[30], BLOB_LEN - 30) == 0);
+
+    link_down(0);
+    CHECK(GATTServApp_DeregisterService(blobAttrTbl[0].handle, &pAttrs) == SUCCESS);
+}
+
+//hooked into the ROM by GATTServApp_Init
+uint8 gattServApp_ParsePacket(l2capPacket_t* pPkt, hciDataEvent_t* pHciMsg);
+
+//a PDU as L2CAP passes it to the hook, returns the opcode left for ATT
+static uint8 parse(uint16 connHandle, const uint8* pPdu, uint8 len)
+{
+    static uint8 data[4 + ATT_MTU_SIZE];
+    hciDataEvent_t hciMsg;
+    l2capPacket_t pkt;
+
+    data[0] = len;
+    data[1] = 0;
+    data[2] = LO_UINT16(L2CAP_CID_ATT);
+    data[3] = HI_UINT16(L2CAP_CID_ATT);
+    memcpy(&data[4], pPdu, len);
+    hciMsg.connHandle = connHandle;
+    hciMsg.len = 4 + len;
+    hciMsg.pData = data;
+    memset(&s_rsp, 0, sizeof(s_rsp));
+
+    CHECK(gattServApp_ParsePacket(&pkt, &hciMsg) == TRUE);
+    CHECK(pkt.CID == L2CAP_CID_ATT && pkt.len == len && pkt.pPayload == &data[4]);
+    return data[4];
+}
+
+static uint8 read_multi_var(uint16 connHandle, uint16 handle1, uint16 handle2)
+{
+    uint8 pdu[5] = {ATT_READ_MULTI_VAR_REQ, LO_UINT16(handle1), HI_UINT16(handle1),
+                    LO_UINT16(handle2), HI_UINT16(handle2)};
+
+    //answered here, a command ATT ignores is left for the host library
+    CHECK(parse(connHandle, pdu, sizeof(pdu)) == 0x7F);
+    return s_rsp.opcode;
+}
+
+static void test_read_multi_var(void)
+{
+    static const uint8 feat = GATT_CLIENT_FEAT_ROBUST_CACHING;
+    static const uint8 readReq[3] = {ATT_READ_REQ, GATT_SVC_HANDLE, 0};
+    static const uint8 oneHandle[3] = {ATT_READ_MULTI_VAR_REQ, GATT_SVC_HANDLE, 0};
+    gattAttribute_t* pAttrs;
+
+    CHECK(jump_table_host[L2CAP_PARSE_PACKET] != 0);
+    fill(blobValue, BLOB_LEN, 5);
+    CHECK(GATTServApp_RegisterService(blobAttrTbl, GATT_NUM_ATTRS(blobAttrTbl), &blobCBs) == SUCCESS);
+    link_up(0);
+
+    //other PDUs are left to the host library as they are
+    CHECK(parse(0, readReq, sizeof(readReq)) == ATT_READ_REQ && s_rsp.opcode == 0);
+
+    //each value with its length, the list cut at ATT_MTU - 1
+    CHECK(write(0, CLIENT_FEAT_HANDLE, &feat, 1) == ATT_WRITE_RSP);
+    CHECK(read_multi_var(0, CLIENT_FEAT_HANDLE, BLOB_HANDLE) == ATT_READ_MULTI_VAR_RSP);
+    CHECK(s_rsp.pduLen == ATT_MTU_SIZE_MIN);
+    CHECK(s_rsp.pdu[1] == 1 && s_rsp.pdu[2] == 0 && s_rsp.pdu[3] == feat);
+    CHECK(s_rsp.pdu[4] == ATT_MTU_SIZE_MIN - 1 && s_rsp.pdu[5] == 0);
+    CHECK(memcmp(&s_rsp.pdu[6], blobValue, ATT_MTU_SIZE_MIN - 6) == 0);
+
+    //a value past a full list only has its handle checked
+    CHECK(read_multi_var(0, BLOB_HANDLE, CLIENT_FEAT_HANDLE) == ATT_READ_MULTI_VAR_RSP);
+    CHECK(s_rsp.pduLen == ATT_MTU_SIZE_MIN && s_rsp.pdu[1] == ATT_MTU_SIZE_MIN - 1);
+    CHECK(read_multi_var(0, BLOB_HANDLE, 0x7FF0) == ATT_ERROR_RSP);
+    CHECK(s_rsp.err.reqOpcode == ATT_READ_MULTI_VAR_REQ && s_rsp.err.errCode == ATT_ERR_INVALID_HANDLE &&
+          s_rsp.err.handle == 0x7FF0);
+
+    //a larger MTU takes the whole values
+    gAttMtuSize[0] = 100;
+    CHECK(read_multi_var(0, BLOB_HANDLE, CLIENT_FEAT_HANDLE) == ATT_READ_MULTI_VAR_RSP);
+    CHECK(s_rsp.pduLen == 1 + 2 + BLOB_LEN + 2 + 1);
+    CHECK(s_rsp.pdu[1] == BLOB_LEN && memcmp(&s_rsp.pdu[3], blobValue, BLOB_LEN) == 0);
+    CHECK(s_rsp.pdu[3 + BLOB_LEN] == 1 && s_rsp.pdu[5 + BLOB_LEN] == feat);
+
+    //the Set Of Handles holds two handles or more
+    CHECK(parse(0, oneHandle, sizeof(oneHandle)) == 0x7F);
+    CHECK(s_rsp.opcode == ATT_ERROR_RSP && s_rsp.err.errCode == ATT_ERR_INVALID_PDU);
+
+    //a change-unaware client gets Database Out Of Sync first
+    db_changed();
+    CHECK(read_multi_var(0, BLOB_HANDLE, CLIENT_FEAT_HANDLE) == ATT_ERROR_RSP);
+    CHECK(s_rsp.err.errCode == ATT_ERR_DATABASE_OUT_OF_SYNC);
+    CHECK(read_multi_var(0, BLOB_HANDLE, CLIENT_FEAT_HANDLE) == ATT_READ_MULTI_VAR_RSP);
+    CHECK(read(0, GATT_SVC_HANDLE) == ATT_READ_RSP);
+
+    link_down(0);
+    CHECK(GATTServApp_DeregisterService(blobAttrTbl[0].handle, &pAttrs) == SUCCESS);
+}
+
+//the Database Hash as a client reads it, least significant octet first
+static void read_hash(uint16 connHandle, uint8* pHash)
+{
+    memset(&s_msg.msg, 0, sizeof(s_msg.msg));
+    s_msg.msg.readByTypeReq.startHandle = 1;
+    s_msg.msg.readByTypeReq.endHandle = GATT_MAX_HANDLE;
+    s_msg.msg.readByTypeReq.type.len = ATT_BT_UUID_SIZE;
+    s_msg.msg.readByTypeReq.type.uuid[0] = LO_UINT16(DATABASE_HASH_UUID);
+    s_msg.msg.readByTypeReq.type.uuid[1] = HI_UINT16(DATABASE_HASH_UUID);
+    deliver(connHandle, ATT_READ_BY_TYPE_REQ);
+    CHECK(s_rsp.opcode == ATT_READ_BY_TYPE_RSP && s_rsp.u.readByType.len == 2 + GATT_DB_HASH_SIZE);
+    memcpy(pHash, &s_rsp.u.readByType.dataList[2], GATT_DB_HASH_SIZE);
+}
+
+static void test_client_info(void)
+{
+    static const uint8 feat = GATT_CLIENT_FEAT_ROBUST_CACHING;
+    static const uint8 zero[GATT_CLIENT_HASH_LEN];
+    uint8 info[GATT_CLIENT_INFO_SIZE];
+    uint8 hash[GATT_DB_HASH_SIZE];
+    gattAttribute_t* pAttrs;
+
+    GATTServApp_RegisterForMsg(APP_TASK_ID);
+    link_up(0);
+
+    //a features write is saved with the hash the client has seen
+    s_infoEvents = 0;
+    CHECK(write(0, CLIENT_FEAT_HANDLE, &feat, 1) == ATT_WRITE_RSP);
+    CHECK(s_infoEvents == 1);
+    read_hash(0, hash);
+    CHECK(GATTServApp_SaveClientInfo(0, info) == SUCCESS);
+    CHECK(info[0] == GATT_CLIENT_FEAT_ROBUST_CACHING && memcmp(&info[1], hash, GATT_CLIENT_HASH_LEN) == 0);
+    link_down(0);
+
+    //back on the same database, the client is change-aware
+    link_up(0);
+    CHECK(GATTServApp_RestoreClientInfo(0, info) == SUCCESS);
+    CHECK(read(0, CLIENT_FEAT_HANDLE) == ATT_READ_RSP && s_rsp.u.read.value[0] == GATT_CLIENT_FEAT_ROBUST_CACHING);
+    CHECK(read(0, GATT_SVC_HANDLE) == ATT_READ_RSP);
+    link_down(0);
+
+    //a service added while it was away makes it change-unaware
+    CHECK(GATTServApp_RegisterService(extraAttrTbl, GATT_NUM_ATTRS(extraAttrTbl), &extraCBs) == SUCCESS);
+    link_up(0);
+    s_infoEvents = 0;
+    CHECK(GATTServApp_RestoreClientInfo(0, info) == SUCCESS);
+    CHECK(read(0, GATT_SVC_HANDLE) == ATT_ERROR_RSP && s_rsp.err.errCode == ATT_ERR_DATABASE_OUT_OF_SYNC);
+    CHECK(GATTServApp_SaveClientInfo(0, info) == SUCCESS);
+    CHECK(memcmp(&info[1], zero, GATT_CLIENT_HASH_LEN) == 0);
+    //served after the error, change-aware again and saved as such
+    CHECK(read(0, GATT_SVC_HANDLE) == ATT_READ_RSP);
+    CHECK(s_infoEvents == 1);
+    read_hash(0, hash);
+    CHECK(GATTServApp_SaveClientInfo(0, info) == SUCCESS);
+    CHECK(memcmp(&info[1], hash, GATT_CLIENT_HASH_LEN) == 0);
+    link_down(0);
+    CHECK(GATTServApp_DeregisterService(extraAttrTbl[0].handle, &pAttrs) == SUCCESS);
+
+    //saved while change-unaware, it stays so whatever the database
+    link_up(0);
+    memset(&info[1], 0, GATT_CLIENT_HASH_LEN);
+    CHECK(GATTServApp_RestoreClientInfo(0, info) == SUCCESS);
+    CHECK(read(0, GATT_SVC_HANDLE) == ATT_ERROR_RSP && s_rsp.err.errCode == ATT_ERR_DATABASE_OUT_OF_SYNC);
+    link_down(0);
+
+    //without Robust Caching the hash is not looked at
+    link_up(0);
+    info[0] = 0;
+    CHECK(GATTServApp_RestoreClientInfo(0, info) == SUCCESS);
+    CHECK(read(0, GATT_SVC_HANDLE) == ATT_READ_RSP);
+    CHECK(read(0, CLIENT_FEAT_HANDLE) == ATT_READ_RSP && s_rsp.u.read.value[0] == 0);
+    link_down(0);
+
+    GATTServApp_RegisterForMsg(INVALID_TASK_ID);
+}
+
+/*
+the example database of the Core Specification, Vol 3, Part G, Appendix B:
+GAP, GATT, Glucose including Battery, and the hash it gives
+*/
+static CONST uint8 gapUUID[ATT_BT_UUID_SIZE] = {0x00, 0x18};
+static CONST uint8 glucoseUUID[ATT_BT_UUID_SIZE] = {0x08, 0x18};
+static CONST uint8 batteryUUID[ATT_BT_UUID_SIZE] = {0x0F, 0x18};
+static CONST uint8 devNameUUID[ATT_BT_UUID_SIZE] = {0x00, 0x2A};
+static CONST uint8 appearUUID[ATT_BT_UUID_SIZE] = {0x01, 0x2A};
+static CONST uint8 measUUID[ATT_BT_UUID_SIZE] = {0x18, 0x2A};
+static CONST uint8 levelUUID[ATT_BT_UUID_SIZE] = {0x19, 0x2A};
+static CONST uint8 inclUUID[ATT_BT_UUID_SIZE] = {0x02, 0x28};
+static CONST uint8 extPropsUUID[ATT_BT_UUID_SIZE] = {0x00, 0x29};
+static CONST gattAttrType_t gapService = {ATT_BT_UUID_SIZE, gapUUID};
+static CONST gattAttrType_t glucoseService = {ATT_BT_UUID_SIZE, glucoseUUID};
+static CONST gattAttrType_t batteryService = {ATT_BT_UUID_SIZE, batteryUUID};
+static uint8 nameProps = GATT_PROP_READ | GATT_PROP_WRITE;
+static uint8 readProps = GATT_PROP_READ;
+static uint8 measProps = GATT_PROP_READ | GATT_PROP_INDICATE | GATT_PROP_EXTENDED;
+static uint16 inclHandle = 0x0014;
+static uint16 extProps;
+static uint8 hashValue[2];
+
+static gattAttribute_t gapAttrTbl[] = {
+    {{ATT_BT_UUID_SIZE, primaryServiceUUID}, GATT_PERMIT_READ, 0, (uint8*)&gapService},
+    {{ATT_BT_UUID_SIZE, characterUUID}, GATT_PERMIT_READ, 0, &nameProps},
+    {{ATT_BT_UUID_SIZE, devNameUUID}, GATT_PERMIT_READ | GATT_PERMIT_WRITE, 0, hashValue},
+    {{ATT_BT_UUID_SIZE, characterUUID}, GATT_PERMIT_READ, 0, &readProps},
+    {{ATT_BT_UUID_SIZE, appearUUID}, GATT_PERMIT_READ, 0, hashValue},
+};
+
+static gattAttribute_t glucoseAttrTbl[] = {
+    {{ATT_BT_UUID_SIZE, primaryServiceUUID}, GATT_PERMIT_READ, 0, (uint8*)&glucoseService},
+    {{ATT_BT_UUID_SIZE, inclUUID}, GATT_PERMIT_READ, 0, (uint8*)&inclHandle},
+    {{ATT_BT_UUID_SIZE, characterUUID}, GATT_PERMIT_READ, 0, &measProps},
+    {{ATT_BT_UUID_SIZE, measUUID}, GATT_PERMIT_READ, 0, hashValue},
+    {{ATT_BT_UUID_SIZE, clientCharCfgUUID}, GATT_PERMIT_READ | GATT_PERMIT_WRITE, 0, hashValue},
+    {{ATT_BT_UUID_SIZE, extPropsUUID}, GATT_PERMIT_READ, 0, (uint8*)&extProps},
+};
+
+static gattAttribute_t batteryAttrTbl[] = {
+    {{ATT_BT_UUID_SIZE, secondaryServiceUUID}, GATT_PERMIT_READ, 0, (uint8*)&batteryService},
+    {{ATT_BT_UUID_SIZE, characterUUID}, GATT_PERMIT_READ, 0, &readProps},
+    {{ATT_BT_UUID_SIZE, levelUUID}, GATT_PERMIT_READ, 0, hashValue},
+};
+
+//F1CA2D48ECF58BAC8A8830BBB9FBA990, least significant octet first
+static const uint8 exampleHash[GATT_DB_HASH_SIZE] = {
+    0x90, 0xA9, 0xFB, 0xB9, 0xBB, 0x30, 0x88, 0x8A, 0xAC, 0x8B, 0xF5, 0xEC, 0x48, 0x2D, 0xCA, 0xF1
+};
+
+static void test_db_hash(void)
+{
+    static CONST gattServiceCBs_t noCBs = {NULL, NULL, NULL, NULL, NULL};
+    uint8 hash[GATT_DB_HASH_SIZE];
+    gattAttribute_t* pAttrs;
+
+    //the example database from handle 1, the GATT service at 6
+    CHECK(GATTServApp_DelService(GATT_ALL_SERVICES) == SUCCESS);
+    CHECK(GATTServApp_DeregisterService(testAttrTbl[0].handle, &pAttrs) == SUCCESS);
+    CHECK(s_numServices == 0);
+    s_nextHandle = 1;
+    CHECK(GATTServApp_RegisterService(gapAttrTbl, GATT_NUM_ATTRS(gapAttrTbl), &noCBs) == SUCCESS);
+    CHECK(GATTServApp_AddService(GATT_ALL_SERVICES) == SUCCESS);
+    CHECK(GATTServApp_RegisterService(glucoseAttrTbl, GATT_NUM_ATTRS(glucoseAttrTbl), &noCBs) == SUCCESS);
+    CHECK(GATTServApp_RegisterService(batteryAttrTbl, GATT_NUM_ATTRS(batteryAttrTbl), &noCBs) == SUCCESS);
+    CHECK(batteryAttrTbl[0].handle == inclHandle && s_nextHandle == 0x17);
+
+    link_up(0);
+    read_hash(0, hash);
+    CHECK(memcmp(hash, exampleHash, GATT_DB_HASH_SIZE) == 0);
+    link_down(0);
+}
+
+int main(void)
+{
+    GATTServApp_Init(TEST_TASK_ID);
+    CHECK(GATTServApp_AddService(GATT_ALL_SERVICES) == SUCCESS);
+    CHECK(GATTServApp_RegisterService(testAttrTbl, GATT_NUM_ATTRS(testAttrTbl), &testCBs) == SUCCESS);
+
+    test_long_write();
+    test_long_write_full();
+    test_service_changed();
+    test_cccd_store();
+    test_conn_evt_notice();
+    test_noti_queue();
+    test_read_offset();
+    test_uuid_index();
+    test_read_multi_var();
+    test_client_info();
+    test_db_hash();
+
+    printf("gatt_serv_test: %d failures\n", s_fail);
+    return s_fail ? 1 : 0;
+}
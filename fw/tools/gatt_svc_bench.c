@@ -0,0 +1,180 @@
+/*
+Host benchmark of the service callback lookup in
+components/profiles/GATT/gattservapp.c.
+
+gattservapp.c needs the BLE stack headers and library, so the two lookups
+are copied here as they are in the tree: the linked list walk it had
+before, with one osal_mem_alloc'd node per service appended in
+registration order, and the table sorted by service handle with its binary
+search (gattServApp_FindServiceCBsIdx). Keep them in step with the source.
+
+For 5 to 30 registered services, each lookup is timed and its probes of a
+service entry are counted, for two handle mixes:
+
+- uniform: every service equally often
+- app: the last registered service, where the application profiles sit
+  behind GAP, GATT and the standard services, gets 3 of 4 lookups
+
+Probes are what carries over to the M0, which has no data cache and no
+branch predictor; host ns mostly show cache and branch effects.
+
+    cc -O2 -o gatt_svc_bench tools/gatt_svc_bench.c
+    ./gatt_svc_bench [lookups per point]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#define SVC_MIN             5
+#define SVC_MAX             30
+#define SVC_STEP            5
+#define ATTRS_MAX           12
+#define LOOKUPS             4096
+
+typedef struct{
+    int     dummy;
+}gattServiceCBs_t;
+
+typedef struct{
+    uint16_t handle;
+    uint16_t numAttrs;
+    void*    pAttrs;
+    const gattServiceCBs_t* pCBs;
+}gattServiceCBsInfo_t;
+
+typedef struct _serviceCBsList{
+    struct _serviceCBsList* next;
+    gattServiceCBsInfo_t serviceInfo;
+}serviceCBsList_t;
+
+static serviceCBsList_t* serviceCBsList;
+static gattServiceCBsInfo_t serviceCBsTbl[SVC_MAX];
+static uint16_t numServiceCBs;
+static gattServiceCBs_t cbs[SVC_MAX];
+static uint32_t s_probes;
+static uint32_t s_rng = 1;
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+//before: walk the list
+static const gattServiceCBs_t* find_list(uint16_t handle)
+{
+    serviceCBsList_t* pLoop = serviceCBsList;
+
+    while(pLoop != NULL){
+        s_probes++;
+        if(pLoop->serviceInfo.handle == handle)
+            return pLoop->serviceInfo.pCBs;
+        pLoop = pLoop->next;
+    }
+    return NULL;
+}
+
+//now: binary search of the sorted table
+static const gattServiceCBs_t* find_table(uint16_t handle)
+{
+    uint16_t lo = 0;
+    uint16_t hi = numServiceCBs;
+
+    while(lo < hi){
+        uint16_t mid = (lo + hi) >> 1;
+
+        s_probes++;
+        if(serviceCBsTbl[mid].handle == handle)
+            return serviceCBsTbl[mid].pCBs;
+        if(serviceCBsTbl[mid].handle < handle)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+static void setup(uint16_t n)
+{
+    serviceCBsList_t** pp = &serviceCBsList;
+    uint16_t handle = 1;
+    uint16_t i;
+
+    while(serviceCBsList){
+        serviceCBsList_t* p = serviceCBsList;
+        serviceCBsList = p->next;
+        free(p);
+    }
+
+    for(i = 0; i < n; i++){
+        serviceCBsTbl[i].handle = handle;
+        serviceCBsTbl[i].numAttrs = (uint16_t)(3 + rnd() % (ATTRS_MAX - 2));
+        serviceCBsTbl[i].pCBs = &cbs[i];
+        handle += serviceCBsTbl[i].numAttrs;
+
+        //nodes come from the heap between other allocations
+        free(malloc(16 + rnd() % 64));
+        *pp = malloc(sizeof(serviceCBsList_t));
+        (*pp)->serviceInfo = serviceCBsTbl[i];
+        (*pp)->next = NULL;
+        pp = &(*pp)->next;
+    }
+    numServiceCBs = n;
+}
+
+static double run(const gattServiceCBs_t* (*find)(uint16_t), const uint16_t* handles,
+                  const uint16_t* expect, uint32_t rounds, double* probes, int* bad)
+{
+    struct timespec t0, t1;
+    uint32_t r, i;
+
+    s_probes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(r = 0; r < rounds; r++){
+        for(i = 0; i < LOOKUPS; i++){
+            if(find(handles[i]) != &cbs[expect[i]])
+                (*bad)++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    *probes = (double)s_probes / ((double)rounds * LOOKUPS);
+    return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / ((double)rounds * LOOKUPS);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t total = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 4000000;
+    uint32_t rounds = total / LOOKUPS ? total / LOOKUPS : 1;
+    static uint16_t handles[LOOKUPS], expect[LOOKUPS];
+    int bad = 0;
+    int mix;
+    uint16_t n;
+    uint32_t i;
+
+    for(mix = 0; mix < 2; mix++){
+        printf("%s mix\n  services   list probes  ns     table probes  ns\n", mix ? "app" : "uniform");
+        for(n = SVC_MIN; n <= SVC_MAX; n += SVC_STEP){
+            double lp, tp, lns, tns;
+
+            setup(n);
+            for(i = 0; i < LOOKUPS; i++){
+                expect[i] = (mix && (rnd() & 3)) ? n - 1 : (uint16_t)(rnd() % n);
+                handles[i] = serviceCBsTbl[expect[i]].handle;
+            }
+
+            lns = run(find_list, handles, expect, rounds, &lp, &bad);
+            tns = run(find_table, handles, expect, rounds, &tp, &bad);
+            printf("  %-10u %-12.1f %-6.1f %-13.1f %.1f\n", n, lp, lns, tp, tns);
+        }
+    }
+    setup(0);
+
+    if(bad)
+        printf("%d wrong lookups\n", bad);
+    return bad ? 1 : 0;
+}
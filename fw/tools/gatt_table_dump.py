@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""
+Dump the GATT attribute tables of services at two git revisions and compare
+them, see GATT_SERV_TABLE_MACROS in components/ble/host/gattservapp.h.
+
+Each service source is taken from the revision, built on the host with a
+driver that includes it and prints its table, and run. An attribute is
+printed as its index, its type, its permissions and its value:
+
+- a type from gatt_uuid.h by name, any other type by its UUID octets
+- the value of a characteristic declaration by its properties
+- any other value by the variable it points into, and the offset; ?+offset
+  for a variable defined outside the service source, like the CCCD store
+
+so a table expanded from the macros compares equal to the hand-written one
+it replaces, while a value pointer that moved to another variable does not.
+Every service is built with and without HID_VOICE_SPEC.
+
+    tools/gatt_table_dump.py c1bb5cc^ c1bb5cc
+    tools/gatt_table_dump.py HEAD -v
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+FW = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# source and attribute table of each service
+SERVICES = [
+    ("components/profiles/Batt/battservice.c", "battAttrTbl"),
+    ("components/profiles/DevInfo/devinfoservice.c", "devInfoAttrTbl"),
+    ("app/source/ble_misc_services.c", "mcs_atrr_tbl"),
+]
+
+CONFIGS = [[], ["-DHID_VOICE_SPEC"]]
+
+INCLUDES = [
+    "tools/host", "components/inc", "components/osal/include", "components/ble/include",
+    "components/ble/host", "components/ble/controller", "components/arch/cm0", "misc",
+    "components/driver/log", "components/driver/uart", "components/driver/gpio",
+    "components/driver/timer", "components/driver/pwrmgr", "components/driver/clock",
+    "components/profiles/Roles", "components/profiles/Batt", "components/profiles/DevInfo",
+    "components/profiles/HID", "components/profiles/ota_app", "components/profiles/ota",
+    "components/libraries/fs", "app/source",
+]
+
+DEFINES = [
+    "-DADV_NCONN_CFG=0x01", "-DADV_CONN_CFG=0x02", "-DSCAN_CFG=0x04", "-DINIT_CFG=0x08",
+    "-DBROADCASTER_CFG=0x01", "-DOBSERVER_CFG=0x02", "-DPERIPHERAL_CFG=0x04",
+    "-DCENTRAL_CFG=0x08", "-DHOST_CONFIG=4", "-DDEBUG_INFO=0", "-DPHY_MCU_TYPE=MCU_BUMBEE_M0",
+]
+
+DRIVER = """
+#include "%(src)s"
+#include <stdio.h>
+
+int main(void)
+{
+    unsigned i, j;
+
+    for(i = 0; i < sizeof(%(tbl)s) / sizeof(%(tbl)s[0]); i++){
+        gattAttribute_t* p = &%(tbl)s[i];
+
+        printf("%%u %%p %%u %%p %%02x", i, (void*)p->type.uuid, p->type.len, (void*)p->pValue,
+               p->permissions);
+        for(j = 0; j < p->type.len; j++)
+            printf(" %%02x", p->type.uuid[j]);
+        //only the properties are read, other values may be outside the build
+        printf(" %%02x\\n", p->type.uuid == characterUUID ? p->pValue[0] : 0);
+    }
+    return 0;
+}
+"""
+
+
+def git_show(rev, path):
+    return subprocess.run(["git", "-C", FW, "show", "%s:./%s" % (rev, path)],
+                          check=True, capture_output=True).stdout
+
+
+def uuid_names():
+    with open(os.path.join(FW, "components/ble/include/gatt_uuid.h")) as f:
+        return re.findall(r"extern CONST uint8 (\w+)\[\];", f.read())
+
+
+def symbols(exe):
+    out = subprocess.run(["nm", "-n", exe], check=True, capture_output=True, text=True).stdout
+    syms = []
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 3 and parts[1] in "bBdDrRgGsS":
+            syms.append((int(parts[0], 16), parts[2]))
+    return syms
+
+
+def owner(syms, addr):
+    best = None
+    for a, name in syms:
+        if a > addr:
+            break
+        best = (a, name)
+    if addr == 0 or best is None:
+        # an extern the service doesn't define is linked at 0
+        return "NULL" if addr == 0 else "?+%d" % addr
+    return best[1] if addr == best[0] else "%s+%d" % (best[1], addr - best[0])
+
+
+def dump(rev, path, tbl, config, work):
+    names = uuid_names()
+    src = os.path.join(work, os.path.basename(path))
+    with open(src, "wb") as f:
+        f.write(git_show(rev, path))
+    drv = os.path.join(work, "driver.c")
+    with open(drv, "w") as f:
+        f.write(DRIVER % {"src": src, "tbl": tbl})
+    # the types of gatt_uuid.h, told apart by name
+    stub = os.path.join(work, "uuids.c")
+    with open(stub, "w") as f:
+        for name in names:
+            f.write("const unsigned char %s[16];\n" % name)
+    exe = os.path.join(work, "dump")
+    cmd = ["cc", "-w", "-no-pie", "-o", exe, drv, stub, "-Wl,--unresolved-symbols=ignore-all",
+           "-iquote", os.path.dirname(os.path.join(FW, path))]
+    cmd += ["-I" + os.path.join(FW, d) for d in INCLUDES] + DEFINES + config
+    subprocess.run(cmd, check=True)
+    out = subprocess.run([exe], check=True, capture_output=True, text=True).stdout
+
+    syms = symbols(exe)
+    lines = []
+    for line in out.splitlines():
+        f = line.split()
+        idx, uuid, ulen, value, perms = f[0], int(f[1], 16), int(f[2]), int(f[3], 16), f[4]
+        octets, first = f[5:5 + ulen], f[5 + ulen]
+        tname = owner(syms, uuid)
+        if tname not in names:
+            tname = "uuid " + "".join(reversed(octets))
+        if tname == "characterUUID":
+            vname = "props %s" % first
+        else:
+            vname = owner(syms, value)
+        lines.append("%3s %-24s perm %s %s" % (idx, tname, perms, vname))
+    return lines
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("old", help="revision to dump, or to compare against")
+    ap.add_argument("new", nargs="?", help="revision to compare")
+    ap.add_argument("-v", action="store_true", help="print the tables")
+    args = ap.parse_args()
+
+    differ = 0
+    with tempfile.TemporaryDirectory() as work:
+        for path, tbl in SERVICES:
+            for config in CONFIGS:
+                title = "%s %s" % (tbl, " ".join(config) or "(default)")
+                old = dump(args.old, path, tbl, config, work)
+                if args.v or not args.new:
+                    print("== %s at %s" % (title, args.old))
+                    print("\n".join(old))
+                if not args.new:
+                    continue
+                new = dump(args.new, path, tbl, config, work)
+                if old == new:
+                    print("%s: %d attributes, same" % (title, len(old)))
+                    continue
+                differ = 1
+                print("%s: differs" % title)
+                for i in range(max(len(old), len(new))):
+                    a = old[i] if i < len(old) else ""
+                    b = new[i] if i < len(new) else ""
+                    if a != b:
+                        print("  - %s\n  + %s" % (a, b))
+    return differ
+
+
+if __name__ == "__main__":
+    sys.exit(main())
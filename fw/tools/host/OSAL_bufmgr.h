@@ -0,0 +1,5 @@
+/*
+The sources include OSAL_bufmgr.h, the file is osal_bufmgr.h, see
+osal_cbTimer.h.
+*/
+#include "osal_bufmgr.h"
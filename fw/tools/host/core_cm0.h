@@ -0,0 +1,66 @@
+/*
+Host stand-in for the CMSIS Cortex-M0 core header, which comes with the Keil
+device pack. Only what the firmware headers use, so that stack and profile
+sources build into the host harnesses under tools/. Nothing here touches
+hardware: the register blocks are never dereferenced by the code under test.
+*/
+
+#ifndef __CORE_CM0_H_HOST__
+#define __CORE_CM0_H_HOST__
+
+#include <stdint.h>
+
+#define __I     volatile const
+#define __O     volatile
+#define __IO    volatile
+#define __IM    volatile const
+#define __OM    volatile
+#define __IOM   volatile
+
+static inline void __disable_irq(void){}
+static inline void __enable_irq(void){}
+static inline uint32_t __get_PRIMASK(void){ return 0; }
+static inline void __set_PRIMASK(uint32_t x){ (void)x; }
+static inline void __WFI(void){}
+static inline void __NOP(void){}
+
+static inline void NVIC_EnableIRQ(int irqn){ (void)irqn; }
+static inline void NVIC_DisableIRQ(int irqn){ (void)irqn; }
+static inline void NVIC_SetPriority(int irqn, uint32_t prio){ (void)irqn; (void)prio; }
+static inline void NVIC_ClearPendingIRQ(int irqn){ (void)irqn; }
+static inline void NVIC_SetPendingIRQ(int irqn){ (void)irqn; }
+
+typedef struct{
+    __IOM uint32_t ISER[1];
+    uint32_t RESERVED0[31];
+    __IOM uint32_t ICER[1];
+    uint32_t RESERVED1[31];
+    __IOM uint32_t ISPR[1];
+    uint32_t RESERVED2[31];
+    __IOM uint32_t ICPR[1];
+    uint32_t RESERVED3[31];
+    uint32_t RESERVED4[64];
+    __IOM uint32_t IP[8];
+}NVIC_Type;
+
+typedef struct{
+    __IOM uint32_t CTRL;
+    __IOM uint32_t LOAD;
+    __IOM uint32_t VAL;
+    __IM  uint32_t CALIB;
+}SysTick_Type;
+
+typedef struct{
+    __IM  uint32_t CPUID;
+    __IOM uint32_t ICSR;
+    uint32_t RESERVED0;
+    __IOM uint32_t AIRCR;
+    __IOM uint32_t SCR;
+    __IM  uint32_t CCR;
+}SCB_Type;
+
+#define NVIC        ((NVIC_Type*)0xE000E100UL)
+#define SysTick     ((SysTick_Type*)0xE000E010UL)
+#define SCB         ((SCB_Type*)0xE000ED00UL)
+
+#endif
@@ -0,0 +1,22 @@
+/*
+The jump table of the ROM is at 0x1fff0000 on the chip, here it is an
+array the host tests define. Only the entries they need are listed. The
+firmware stores 32-bit addresses, so a test on a 64-bit host calls what
+was hooked by name and only checks that the entry was set.
+*/
+#ifndef _JUMP_FUNC_H_
+#define _JUMP_FUNC_H_
+#include <stdint.h>
+#include "types.h"
+
+#include "hci.h"
+#include "l2cap.h"
+
+extern uint32 jump_table_host[256];
+#define JUMP_FUNCTION(x)    (jump_table_host[x])
+
+#define     L2CAP_PARSE_PACKET                   82
+
+uint8 l2capParsePacket0( l2capPacket_t *pPkt, hciDataEvent_t *pHciMsg );
+
+#endif
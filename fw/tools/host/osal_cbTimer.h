@@ -0,0 +1,5 @@
+/*
+The sources include osal_cbTimer.h, the file is osal_cbtimer.h. Keil on
+Windows doesn't mind, a case sensitive host file system does.
+*/
+#include "osal_cbtimer.h"
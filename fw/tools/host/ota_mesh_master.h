@@ -0,0 +1,3 @@
+/*
+Not in this tree, see otam_cmd.h.
+*/
@@ -0,0 +1,14 @@
+/*
+otam_protocol.c includes otam_cmd.h, ota_mesh.h and ota_mesh_master.h, which
+are not in this tree. The run modes it uses are the only part it needs.
+*/
+#ifndef __OTAM_CMD_H
+#define __OTAM_CMD_H
+
+enum{
+    OTAC_RUNMODE_APP = 1,
+    OTAC_RUNMODE_OTA,
+    OTAC_RUNMODE_OTARES,
+};
+
+#endif
@@ -0,0 +1,4 @@
+/*
+Host stand-in for the CMSIS system header of the Keil device pack, see
+core_cm0.h. Nothing of it is used by the code the host harnesses build.
+*/
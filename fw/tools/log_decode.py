@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""
+Decoder for the deferred binary log (DEBUG_INFO == 4, components/driver/log/log_bin.c).
+
+Format strings are read from the ER_LOG_FMT region of the linked image (.axf),
+records are read from a capture file or straight from the serial port.
+
+    log_decode.py app/Objects/dispenser.axf capture.bin
+    log_decode.py app/Objects/dispenser.axf -p COM5 -b 115200
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+LOG_BIN_SYNC = 0xA5
+LOG_BIN_ID_DROPPED = 0xFFFF
+LOG_BIN_ARGS_MAX = 8
+LOG_BIN_STR_MAX = 32
+# every argument a %s cut at LOG_BIN_STR_MAX: length word and the bytes
+LOG_BIN_WORDS_MAX = LOG_BIN_ARGS_MAX * (1 + LOG_BIN_STR_MAX // 4)
+RTC_HZ = 32768.0
+
+FMT_SECTION = "ER_LOG_FMT"
+CONV_RE = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?([hlL]?)([diouxXcsp%])")
+
+
+class Image(object):
+    """Minimal ELF32 little endian reader: section name -> (addr, data)."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            elf = f.read()
+        if elf[:4] != b"\x7fELF":
+            raise ValueError("%s is not an ELF image" % path)
+        shoff, = struct.unpack_from("<I", elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x2E)
+        hdrs = []
+        for i in range(shnum):
+            hdrs.append(struct.unpack_from("<IIIIIIIIII", elf, shoff + i * shentsize))
+        strtab = hdrs[shstrndx]
+        names = elf[strtab[4]:strtab[4] + strtab[5]]
+        self.sections = {}
+        for h in hdrs:
+            name = names[h[0]:names.index(b"\0", h[0])].decode()
+            # SHT_PROGBITS only, NOBITS regions carry no strings
+            if h[1] == 1 and h[3]:
+                self.sections[name] = (h[3], elf[h[4]:h[4] + h[5]])
+
+
+def convert(fmt, words):
+    """words: the record's argument words, %s strings are inline (length word, bytes)."""
+    out = []
+    pos = 0
+    argi = 0
+    for m in CONV_RE.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, _, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        val = words[argi] if argi < len(words) else 0
+        argi += 1
+        spec = "%" + flags + width + ("." + prec if prec else "")
+        if conv in "di":
+            val = val - (1 << 32) if val & 0x80000000 else val
+            out.append((spec + "d") % val)
+        elif conv == "u":
+            out.append((spec + "d") % val)
+        elif conv == "c":
+            out.append((spec + "c") % chr(val & 0xFF))
+        elif conv == "s":
+            n = (min(val, LOG_BIN_STR_MAX) + 3) // 4
+            raw = b"".join(struct.pack("<I", w) for w in words[argi:argi + n])
+            argi += n
+            out.append((spec + "s") % raw[:val].decode("latin-1"))
+        elif conv == "p":
+            out.append("%08x" % val)
+        else:
+            out.append((spec + conv) % val)
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def decode(stream, image, out):
+    base, fmts = image.sections[FMT_SECTION]
+    buf = b""
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            break
+        buf += chunk
+        while len(buf) >= 8:
+            if buf[0] != LOG_BIN_SYNC:
+                buf = buf[1:]
+                continue
+            hdr, ts = struct.unpack_from("<II", buf, 0)
+            argc = (hdr >> 8) & 0xFF
+            rid = hdr >> 16
+            # reject false sync: bad size or an ID that is not a string start
+            if argc > LOG_BIN_WORDS_MAX or (rid != LOG_BIN_ID_DROPPED and
+                    (rid >= len(fmts) or (rid and fmts[rid - 1] != 0))):
+                buf = buf[1:]
+                continue
+            size = 8 + 4 * argc
+            if len(buf) < size:
+                break
+            args = struct.unpack_from("<%dI" % argc, buf, 8)
+            buf = buf[size:]
+            if rid == LOG_BIN_ID_DROPPED:
+                text = "<%d records dropped>\n" % args[0]
+            else:
+                end = fmts.index(b"\0", rid)
+                text = convert(fmts[rid:end].decode("latin-1"), args)
+            out.write("[%12.6f] %s" % (ts / RTC_HZ, text))
+            if not text.endswith("\n"):
+                out.write("\n")
+            out.flush()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("image", help="linked image (.axf) the target is running")
+    ap.add_argument("capture", nargs="?", help="raw UART capture, stdin if omitted")
+    ap.add_argument("-p", "--port", help="read from serial port (needs pyserial)")
+    ap.add_argument("-b", "--baud", type=int, default=115200)
+    opt = ap.parse_args()
+
+    image = Image(opt.image)
+    if FMT_SECTION not in image.sections:
+        sys.exit("%s has no %s region, was it linked with DEBUG_INFO=4?" % (opt.image, FMT_SECTION))
+
+    if opt.port:
+        import serial
+        port = serial.Serial(opt.port, opt.baud, timeout=None)
+
+        class SerialStream(object):
+            def read(self, size):
+                return port.read(max(1, min(size, port.in_waiting)))
+        stream = SerialStream()
+    elif opt.capture:
+        stream = open(opt.capture, "rb")
+    else:
+        stream = sys.stdin.buffer
+    decode(stream, image, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
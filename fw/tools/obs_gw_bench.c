@@ -0,0 +1,252 @@
+/*
+Host benchmark of the Observer gateway pipeline, see
+components/profiles/Roles/observer_gw.c.
+
+Replays a synthetic advertising stream through the real ObserverGw code:
+a fleet of dispensers that advertise a slowly changing status and answer
+scan requests, plus passers-by with resolvable private addresses that show
+up for a while and disappear. Every frame is checked (sync, length, crc)
+and the run reports CPU time per report on the host and the UART load of
+the frames against forwarding every report.
+
+    cc -O2 -o obs_gw_bench tools/obs_gw_bench.c \
+        components/profiles/Roles/observer_gw.c components/libraries/crc16/crc16.c \
+        -Icomponents/inc -Icomponents/osal/include -Icomponents/libraries/crc16 \
+        -Icomponents/profiles/Roles
+    ./obs_gw_bench --rate 5000 --fleet 32 --passers 8 --seconds 60
+
+Add -DOBSGW_TABLE_SIZE=128 for more devices than the default table takes.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "OSAL.h"
+#include "crc16.h"
+#include "observer_gw.h"
+
+#define UART_BYTE_BITS      10
+
+typedef struct{
+    uint8   addrType;
+    uint8   addr[OBSGW_ADDR_LEN];
+    int8    rssi;
+    uint8   status;
+    uint32  gone;               //ms, passers only
+}bench_dev_t;
+
+static struct{
+    uint32  rate;
+    uint32  fleet;
+    uint32  passers;
+    uint32  seconds;
+    uint16  period;
+    uint8   rssi_delta;
+    uint16  timeout;
+    uint32  baud;
+    uint32  seed;
+}opt = {5000, 32, 8, 60, 100, 4, 10000, 115200, 1};
+
+static uint32 s_rng;
+static uint32 s_frames, s_frame_bad, s_frame_recs, s_frame_bytes;
+static uint8 s_seq;
+
+//osal services used by the gateway
+void* osal_memcpy(void* dst, const void* src, unsigned int len)
+{
+    return memcpy(dst, src, len);
+}
+
+uint8 osal_memcmp(const void* src1, const void* src2, unsigned int len)
+{
+    return memcmp(src1, src2, len) == 0;
+}
+
+void* osal_memset(void* dest, uint8 value, int len)
+{
+    return memset(dest, value, len);
+}
+
+static uint32 rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static void frame_check(uint8* pFrame, uint16 len)
+{
+    uint16 rec_len = pFrame[8] | (pFrame[9] << 8);
+    uint16 crc = crc16(0, pFrame, len - OBSGW_CRC_SIZE);
+    uint16 off = OBSGW_FRAME_HDR_SIZE;
+    uint8 n = 0;
+
+    s_frames++;
+    s_frame_bytes += len;
+
+    if(pFrame[0] != OBSGW_SYNC || pFrame[1] != s_seq++ ||
+       len != OBSGW_FRAME_HDR_SIZE + rec_len + OBSGW_CRC_SIZE ||
+       (pFrame[len - 2] | (pFrame[len - 1] << 8)) != crc){
+        s_frame_bad++;
+        return;
+    }
+
+    while(off < OBSGW_FRAME_HDR_SIZE + rec_len){
+        off += OBSGW_REC_HDR_SIZE + pFrame[off + 10];
+        n++;
+    }
+    if(off != OBSGW_FRAME_HDR_SIZE + rec_len || n != pFrame[2])
+        s_frame_bad++;
+    s_frame_recs += n;
+}
+
+static void dev_new(bench_dev_t* pdev, uint8 passer, uint32 now)
+{
+    uint32 i;
+
+    pdev->addrType = passer ? 0x01 : 0x00;
+    for(i = 0; i < OBSGW_ADDR_LEN; i++)
+        pdev->addr[i] = (uint8)rnd();
+    if(passer)
+        pdev->addr[5] = (pdev->addr[5] & 0x3F) | 0x40;     //resolvable private
+    pdev->rssi = (int8)(-40 - (int)(rnd() % 50));
+    pdev->status = 0;
+    pdev->gone = now + 5000 + rnd() % 60000;
+}
+
+static uint8 dev_data(bench_dev_t* pdev, uint8 scan_rsp, uint8 passer, uint8* data)
+{
+    static const uint8 name[] = {0x0A, 0x09, 'D', 'i', 's', 'p', 'e', 'n', 's', 'e', 'r'};
+    uint8 len = 0;
+    uint8 i;
+
+    if(scan_rsp){
+        memcpy(data, name, sizeof(name));
+        return sizeof(name);
+    }
+
+    data[len++] = 0x02;
+    data[len++] = 0x01;
+    data[len++] = 0x06;
+    if(passer){
+        //a phone, manufacturer data that changes now and then
+        data[len++] = 0x0A;
+        data[len++] = 0xFF;
+        for(i = 0; i < 9; i++)
+            data[len++] = (uint8)(pdev->addr[i % OBSGW_ADDR_LEN] + pdev->status);
+    }
+    else{
+        data[len++] = 0x0B;
+        data[len++] = 0xFF;
+        data[len++] = 0x04;
+        data[len++] = 0x05;
+        memcpy(&data[len], pdev->addr, OBSGW_ADDR_LEN);
+        len += OBSGW_ADDR_LEN;
+        data[len++] = pdev->status;
+        data[len++] = 0x64;
+    }
+    return len;
+}
+
+static void usage(void)
+{
+    printf("obs_gw_bench [--rate reports/s] [--fleet n] [--passers n] [--seconds s]\n"
+           "             [--period ms] [--rssi-delta dB] [--timeout ms] [--baud b] [--seed n]\n");
+    exit(1);
+}
+
+static void parse(int argc, char** argv)
+{
+    int i;
+
+    for(i = 1; i + 1 < argc; i += 2){
+        uint32 v = (uint32)strtoul(argv[i + 1], NULL, 0);
+
+        if(!strcmp(argv[i], "--rate"))              opt.rate = v;
+        else if(!strcmp(argv[i], "--fleet"))        opt.fleet = v;
+        else if(!strcmp(argv[i], "--passers"))      opt.passers = v;
+        else if(!strcmp(argv[i], "--seconds"))      opt.seconds = v;
+        else if(!strcmp(argv[i], "--period"))       opt.period = (uint16)v;
+        else if(!strcmp(argv[i], "--rssi-delta"))   opt.rssi_delta = (uint8)v;
+        else if(!strcmp(argv[i], "--timeout"))      opt.timeout = (uint16)v;
+        else if(!strcmp(argv[i], "--baud"))         opt.baud = v;
+        else if(!strcmp(argv[i], "--seed"))         opt.seed = v;
+        else usage();
+    }
+    if(i != argc || opt.rate == 0 || opt.fleet + opt.passers == 0 || opt.period == 0)
+        usage();
+}
+
+int main(int argc, char** argv)
+{
+    bench_dev_t* devs;
+    obsGwStats_t st;
+    uint32 ndev, total, n, now, next_flush;
+    uint64_t raw_bytes = 0;
+    uint8 data[OBSGW_DATA_MAX];
+    struct timespec t0, t1;
+    double cpu_ns, secs;
+
+    parse(argc, argv);
+    s_rng = opt.seed ? opt.seed : 1;
+
+    ndev = opt.fleet + opt.passers;
+    devs = calloc(ndev, sizeof(bench_dev_t));
+    for(n = 0; n < ndev; n++)
+        dev_new(&devs[n], n >= opt.fleet, 0);
+
+    ObserverGw_Reset(frame_check, opt.rssi_delta, opt.timeout);
+
+    total = opt.rate * opt.seconds;
+    next_flush = opt.period;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(n = 0; n < total; n++){
+        uint32 i = rnd() % ndev;
+        bench_dev_t* pdev = &devs[i];
+        uint8 passer = i >= opt.fleet;
+        uint8 scan_rsp = !passer && (rnd() & 1);
+        int8 rssi;
+        uint8 len;
+
+        now = (uint32)((uint64_t)n * 1000 / opt.rate);
+        while(now >= next_flush){
+            ObserverGw_Flush(next_flush);
+            next_flush += opt.period;
+        }
+
+        if(passer && now >= pdev->gone)
+            dev_new(pdev, 1, now);
+        else if(rnd() % opt.rate < ndev / 2 + 1)
+            pdev->status++;     //changes about every other second of the device
+
+        rssi = (int8)(pdev->rssi + (int)(rnd() % 13) - 6);
+        len = dev_data(pdev, scan_rsp, passer, data);
+        raw_bytes += OBSGW_REC_HDR_SIZE + len;
+
+        ObserverGw_Report(scan_rsp, pdev->addrType, pdev->addr, rssi, len, data, now);
+    }
+    ObserverGw_Flush(opt.seconds * 1000);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    ObserverGw_GetStats(&st);
+    cpu_ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    secs = opt.seconds;
+
+    printf("reports      %u (%u/s), %u devices, %u in table at the end\n",
+           (unsigned)st.reports, (unsigned)opt.rate, (unsigned)ndev, st.devices);
+    printf("records      %u (%.1f%% of reports), dropped %u\n",
+           (unsigned)st.records, 100.0 * st.records / st.reports, (unsigned)st.dropped);
+    printf("frames       %u, %u bytes, %u bad\n",
+           (unsigned)s_frames, (unsigned)s_frame_bytes, (unsigned)s_frame_bad);
+    printf("host cpu     %.0f ns/report\n", cpu_ns / st.reports);
+    printf("uart load    frames %.1f%%, every report %.1f%% at %u baud\n",
+           100.0 * s_frame_bytes * UART_BYTE_BITS / secs / opt.baud,
+           100.0 * raw_bytes * UART_BYTE_BITS / secs / opt.baud, (unsigned)opt.baud);
+
+    free(devs);
+    return (s_frame_bad || s_frame_recs != st.records) ? 1 : 0;
+}
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""
+Delta OTA patch generator, see components/profiles/ota/ota_delta.h.
+
+base is the content of the bank the device runs from, starting at the bank
+address (partitions at their flash offsets, gaps 0xff). new is one partition
+of the new image. The patch is sent as that partition's data with the delta
+flag set in OTA_CMD_START_OTA; the device rebuilds the partition into the
+other bank and checks it against the crc16 in the patch header.
+
+    ota_delta.py bank0.bin app_part1.bin -o part1.delta
+"""
+
+import argparse
+import struct
+import sys
+
+OTA_DELTA_MAGIC = 0x544C444F
+OP_END, OP_COPY, OP_INSERT, OP_CRC = 0, 1, 2, 3
+
+OTA_PBUF_SIZE = 16 * 1024       # device partition buffer, the patch must fit
+MIN_COPY = 8                    # an OP_COPY costs 7 bytes
+MAX_LEN = 0xFFFF
+KEY = 4
+
+
+def _crc16_table():
+    t = []
+    for n in range(256):
+        c = n
+        for _ in range(8):
+            c = (c >> 1) ^ 0xA001 if c & 1 else c >> 1
+        t.append(c)
+    return t
+
+
+CRC16_TABLE = _crc16_table()
+
+
+def crc16(data, crc=0):
+    for b in data:
+        crc = (crc >> 8) ^ CRC16_TABLE[(crc ^ b) & 0xFF]
+    return crc
+
+
+def match_len(base, bi, new, ni, limit):
+    n = 0
+    limit = min(limit, len(base) - bi, len(new) - ni)
+    while n + 64 <= limit and base[bi + n:bi + n + 64] == new[ni + n:ni + n + 64]:
+        n += 64
+    while n < limit and base[bi + n] == new[ni + n]:
+        n += 1
+    return n
+
+
+def make_ops(base, new):
+    index = {}
+    for i in range(len(base) - KEY + 1):
+        index.setdefault(base[i:i + KEY], []).append(i)
+
+    ops = []
+    lit = bytearray()
+    cont = 0        # base offset following the last copy, tried first
+    i = 0
+    while i < len(new):
+        best_len, best_src = 0, 0
+        cands = index.get(bytes(new[i:i + KEY]), [])
+        for src in [cont] + cands[-32:]:
+            if src < len(base):
+                n = match_len(base, src, new, i, MAX_LEN)
+                if n > best_len:
+                    best_len, best_src = n, src
+        if best_len >= MIN_COPY:
+            if lit:
+                ops.append((OP_INSERT, bytes(lit)))
+                lit = bytearray()
+            ops.append((OP_COPY, best_src, best_len))
+            i += best_len
+            cont = best_src + best_len
+        else:
+            lit.append(new[i])
+            if len(lit) == MAX_LEN:
+                ops.append((OP_INSERT, bytes(lit)))
+                lit = bytearray()
+            i += 1
+            cont += 1
+    if lit:
+        ops.append((OP_INSERT, bytes(lit)))
+    return ops
+
+
+def encode(base, new, ops, block):
+    out = bytearray(struct.pack("<IIIHH", OTA_DELTA_MAGIC, len(new), len(base), crc16(base), crc16(new)))
+    pos = 0
+    mark = 0
+    for op in ops:
+        if op[0] == OP_COPY:
+            out += struct.pack("<BIH", OP_COPY, op[1], op[2])
+            pos += op[2]
+        else:
+            out += struct.pack("<BH", OP_INSERT, len(op[1])) + op[1]
+            pos += len(op[1])
+        if pos - mark >= block:
+            out += struct.pack("<BH", OP_CRC, crc16(new[mark:pos]))
+            mark = pos
+    if pos != mark:
+        out += struct.pack("<BH", OP_CRC, crc16(new[mark:pos]))
+    out.append(OP_END)
+    return bytes(out)
+
+
+def apply(base, patch):
+    """Reference applier, mirrors ota_delta.c."""
+    magic, size, base_size, base_crc, new_crc = struct.unpack_from("<IIIHH", patch, 0)
+    assert magic == OTA_DELTA_MAGIC and crc16(base[:base_size]) == base_crc
+    out = bytearray()
+    mark = 0
+    p = 16
+    while True:
+        op = patch[p]
+        p += 1
+        if op == OP_END:
+            break
+        if op == OP_COPY:
+            src, n = struct.unpack_from("<IH", patch, p)
+            p += 6
+            out += base[src:src + n]
+        elif op == OP_INSERT:
+            n, = struct.unpack_from("<H", patch, p)
+            out += patch[p + 2:p + 2 + n]
+            p += 2 + n
+        elif op == OP_CRC:
+            crc, = struct.unpack_from("<H", patch, p)
+            p += 2
+            assert crc16(out[mark:]) == crc
+            mark = len(out)
+        else:
+            raise ValueError("bad op %d" % op)
+    assert p == len(patch) and len(out) == size and crc16(out) == new_crc
+    return bytes(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("base", help="running bank content")
+    ap.add_argument("new", help="new partition data")
+    ap.add_argument("-o", "--output", required=True, help="patch file")
+    ap.add_argument("--block", type=int, default=4096, help="output bytes per block crc")
+    opt = ap.parse_args()
+
+    base = open(opt.base, "rb").read()
+    new = open(opt.new, "rb").read()
+
+    patch = encode(base, new, make_ops(base, new), opt.block)
+    if apply(base, patch) != new:
+        sys.exit("internal error: patch does not rebuild the new partition")
+
+    print("new %d bytes, patch %d bytes (%.1f%%)" % (len(new), len(patch), 100.0 * len(patch) / max(1, len(new))))
+    if len(patch) > OTA_PBUF_SIZE:
+        sys.exit("patch does not fit the %d byte OTA partition buffer, send the full image" % OTA_PBUF_SIZE)
+
+    with open(opt.output, "wb") as f:
+        f.write(patch)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""
+Compressed OTA partition packer, see components/profiles/ota/ota_lz.h.
+
+Compresses one partition into a 12 byte header and an LZ4 block. Send the
+result as the partition data with OTA_PART_FLAG_LZ in the flags byte of
+OTA_CMD_PARTITION_INFO; size and checksum there describe the compressed
+data as sent, the device stores the decompressed size and crc itself.
+
+    ota_lz.py app_part1.bin -o part1.lz
+"""
+
+import argparse
+import struct
+import sys
+
+OTA_LZ_MAGIC = 0x345A4C4F
+OTA_PART_FLAG_LZ = 0x01
+
+MIN_MATCH = 4
+MAX_DIST = 0xFFFF
+LAST_LITERALS = 5       # lz4 block rules, keeps the output readable by any lz4 decoder
+MF_LIMIT = 12
+CHAIN = 32
+
+
+def _crc16_table():
+    t = []
+    for n in range(256):
+        c = n
+        for _ in range(8):
+            c = (c >> 1) ^ 0xA001 if c & 1 else c >> 1
+        t.append(c)
+    return t
+
+
+CRC16_TABLE = _crc16_table()
+
+
+def crc16(data, crc=0):
+    for b in data:
+        crc = (crc >> 8) ^ CRC16_TABLE[(crc ^ b) & 0xFF]
+    return crc
+
+
+def _length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def _sequence(out, lit, mlen, dist):
+    ll = len(lit)
+    token = (min(ll, 15) << 4) | (min(mlen - MIN_MATCH, 15) if mlen else 0)
+    out.append(token)
+    if ll >= 15:
+        _length(out, ll - 15)
+    out += lit
+    if mlen:
+        out += struct.pack("<H", dist)
+        if mlen - MIN_MATCH >= 15:
+            _length(out, mlen - MIN_MATCH - 15)
+
+
+def compress(data):
+    n = len(data)
+    out = bytearray()
+    chains = {}
+    anchor = 0
+    i = 0
+    while i + MF_LIMIT <= n:
+        key = bytes(data[i:i + MIN_MATCH])
+        cands = chains.get(key, [])
+        best_len, best_src = 0, 0
+        limit = n - LAST_LITERALS - i
+        for src in reversed(cands[-CHAIN:]):
+            if i - src > MAX_DIST:
+                break
+            m = 0
+            while m < limit and data[src + m] == data[i + m]:
+                m += 1
+            if m > best_len:
+                best_len, best_src = m, src
+        chains.setdefault(key, []).append(i)
+        if best_len >= MIN_MATCH:
+            _sequence(out, data[anchor:i], best_len, i - best_src)
+            for j in range(i + 1, i + best_len):
+                if j + MIN_MATCH <= n:
+                    chains.setdefault(bytes(data[j:j + MIN_MATCH]), []).append(j)
+            i += best_len
+            anchor = i
+        else:
+            i += 1
+    _sequence(out, data[anchor:], 0, 0)
+    return bytes(out)
+
+
+def decompress(block, size):
+    """Reference decoder, mirrors ota_lz.c."""
+    out = bytearray()
+    p = 0
+    while len(out) < size:
+        token = block[p]
+        p += 1
+        ll = token >> 4
+        if ll == 15:
+            while True:
+                c = block[p]
+                p += 1
+                ll += c
+                if c != 255:
+                    break
+        out += block[p:p + ll]
+        p += ll
+        if len(out) >= size:
+            break
+        dist, = struct.unpack_from("<H", block, p)
+        p += 2
+        ml = (token & 15) + MIN_MATCH
+        if token & 15 == 15:
+            while True:
+                c = block[p]
+                p += 1
+                ml += c
+                if c != 255:
+                    break
+        assert 0 < dist <= len(out)
+        for _ in range(ml):
+            out.append(out[-dist])
+    assert p == len(block) and len(out) == size
+    return bytes(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("input", help="partition data")
+    ap.add_argument("-o", "--output", required=True, help="compressed partition")
+    opt = ap.parse_args()
+
+    raw = open(opt.input, "rb").read()
+    if not raw:
+        sys.exit("empty partition")
+    block = compress(raw)
+    if decompress(block, len(raw)) != raw:
+        sys.exit("internal error: block does not decompress to the input")
+
+    packed = struct.pack("<IIHH", OTA_LZ_MAGIC, len(raw), crc16(raw), 0) + block
+    with open(opt.output, "wb") as f:
+        f.write(packed)
+
+    print("raw %d bytes, packed %d bytes (%.1f%% less airtime)" %
+          (len(raw), len(packed), 100.0 - 100.0 * len(packed) / len(raw)))
+    print("PARTITION_INFO: size %d, checksum 0x%04x, flags 0x%02x" %
+          (len(packed), crc16(packed), OTA_PART_FLAG_LZ))
+
+
+if __name__ == "__main__":
+    main()
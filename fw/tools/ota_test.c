@@ -0,0 +1,609 @@
+/*
+Host test of the OTA protocol, see components/profiles/ota/ota_protocol.c.
+
+The real ota_protocol.c is built here against stubs of OSAL, the OTA
+service and the OTA flash layer. Flash is a RAM image of the OTA area that
+behaves like NOR flash: an erase sets 0xFF, programming can only clear bits,
+and programming a byte that is not erased is counted. Commands and data go
+in through the callback registered with ota_AddService, the way the service
+delivers them, responses come out of ota_Notify, and the OSAL timer fires
+otaProtocol_TimerEvt when the sender waits for a response that doesn't come.
+
+- oversize: a partition larger than the partition buffer is refused at
+  OTA_CMD_PARTITION_INFO, in burst and windowed transfer, and a burst packet
+  running past the end of the partition is an error
+- streaming mode, built with -DCFG_OTA_STREAM=1 instead: a burst larger
+  than the buffer is refused, and a burst that lost a packet is not
+  programmed before it has been received again
+- lossy link: one partition through a link that drops data packets at
+  random, burst and windowed transfer at 0-20% loss and MTU 23 and 247. The
+  partition in flash must match the image, nothing may be programmed twice,
+  and the goodput of both is reported, as with a 16K partition at a 15 ms
+  connection interval and 4 data packets per connection event. Streaming
+  mode has no windowed transfer
+
+    cc -g -fsanitize=address,undefined -o ota_test tools/ota_test.c \
+        components/profiles/ota/ota_protocol.c components/libraries/crc16/crc16.c \
+        -DADV_NCONN_CFG=0x01 -DADV_CONN_CFG=0x02 -DSCAN_CFG=0x04 -DINIT_CFG=0x08 \
+        -DBROADCASTER_CFG=0x01 -DOBSERVER_CFG=0x02 -DPERIPHERAL_CFG=0x04 -DCENTRAL_CFG=0x08 \
+        -DHOST_CONFIG=4 -DDEBUG_INFO=0 -DPHY_MCU_TYPE=MCU_BUMBEE_M0 \
+        -DCFG_FLASH=512 -DUSE_FCT=0 -DCFG_OTA_BANK_MODE=OTA_DUAL_BANK \
+        -Itools/host -Icomponents/inc -Icomponents/osal/include -Icomponents/ble/include \
+        -Icomponents/ble/host -Icomponents/ble/controller -Icomponents/arch/cm0 -Imisc \
+        -Icomponents/driver/log -Icomponents/driver/uart -Icomponents/driver/gpio \
+        -Icomponents/driver/timer -Icomponents/driver/flash -Icomponents/driver/clock \
+        -Icomponents/libraries/crc16 -Icomponents/profiles/ota
+    ./ota_test [transfers per point]
+
+    cc ... -DCFG_OTA_STREAM=1 '-D__align(x)=__attribute__((aligned(x)))' -o ota_test_stream ...
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "OSAL.h"
+#include "OSAL_Timers.h"
+#include "flash.h"
+#include "clock.h"
+#include "crc16.h"
+#include "error.h"
+#include "ota_service.h"
+#include "ota_protocol.h"
+#include "ota_flash.h"
+#include "ota_delta.h"
+#include "ota_lz.h"
+
+#define PBUF_SIZE           (16*1024+16)    //OTA_PBUF_SIZE of the buffered modes
+#define PART_SIZE           PBUF_SIZE
+#define FLASH_SIZE          (OTAF_END_ADDR + 1 - OTAF_BASE_ADDR)
+#define CONN_INTERVAL       15.0            //ms
+#define PER_EVENT           4               //data packets per connection event
+#define TIME_LIMIT          (24 * 3600.0 * 1000)   //a transfer that takes longer has stalled
+#define SENDER_TIMEOUT      5000.0          //ms the sender waits for a burst response
+#define RSP_MAX             8
+#define TASK_ID             1
+#define TM_EVT              0x0001
+#define MODES               (CFG_OTA_STREAM ? 1 : 2)   //burst, windowed
+
+typedef struct{
+    uint8_t len;
+    uint8_t v[16];
+}rsp_t;
+
+static uint8_t s_flash[FLASH_SIZE];
+static uint32_t s_reprog;               //bytes programmed that were not erased
+static uint32_t s_progEnd;              //highest address programmed + 1
+static ota_ProfileChangeCB_t s_cb;
+static rsp_t s_rsp[RSP_MAX];
+static int s_rspNum;
+static double s_now;                    //ms
+static double s_timer = -1;
+static uint32_t s_loss;                 //1/10000
+static uint32_t s_sent;
+static uint32_t s_rng = 1;
+static int s_fail;
+
+#define CHECK(c)    do{ if(!(c)){ printf("%s:%d: %s\n", __FILE__, __LINE__, #c); s_fail++; } }while(0)
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static uint8_t* flash(uint32_t addr, uint32_t size)
+{
+    if(addr < OTAF_BASE_ADDR || addr - OTAF_BASE_ADDR + size > FLASH_SIZE){
+        printf("flash access out of range %08x+%x\n", (unsigned)addr, (unsigned)size);
+        s_fail++;
+        return NULL;
+    }
+    return s_flash + addr - OTAF_BASE_ADDR;
+}
+
+static int flash_erase(uint32_t addr, uint32_t size)
+{
+    uint8_t* p = flash(addr, size);
+
+    if(p == NULL || (addr & (OTAF_SECTOR_SIZE - 1)))
+        return PPlus_ERR_INVALID_ADDR;
+    memset(p, 0xff, size);
+    return PPlus_SUCCESS;
+}
+
+//stubs of OSAL
+
+void* osal_memcpy(void* dst, const void GENERIC* src, unsigned int len)
+{
+    return memcpy(dst, (const void*)src, len);
+}
+
+void* osal_memset(void* dest, uint8 value, int len)
+{
+    return memset(dest, value, len);
+}
+
+uint8 osal_start_timerEx(uint8 task_id, uint16 event_id, uint32 timeout_value)
+{
+    s_timer = s_now + timeout_value;
+    return SUCCESS;
+}
+
+uint8 osal_stop_timerEx(uint8 task_id, uint16 event_id)
+{
+    s_timer = -1;
+    return SUCCESS;
+}
+
+uint8 osal_clear_event(uint8 task_id, uint16 event_flag)
+{
+    return SUCCESS;
+}
+
+int drv_disable_irq(void)
+{
+    return 0;
+}
+
+int drv_enable_irq(void)
+{
+    return 0;
+}
+
+void hal_system_soft_reset(void)
+{
+}
+
+//stubs of the OTA service
+
+bStatus_t ota_AddService(ota_ProfileChangeCB_t cb)
+{
+    s_cb = cb;
+    return SUCCESS;
+}
+
+bStatus_t ota_Notify(attHandleValueNoti_t* pNoti)
+{
+    rsp_t* r = &s_rsp[s_rspNum];
+
+    if(s_rspNum == RSP_MAX){
+        printf("response queue full\n");
+        s_fail++;
+        return FAILURE;
+    }
+    r->len = pNoti->len;
+    memcpy(r->v, pNoti->value, sizeof(r->v));
+    s_rspNum++;
+    return SUCCESS;
+}
+
+//stubs of the flash layer, the application bank 0 is the target
+
+int hal_flash_erase_sector(unsigned int addr)
+{
+    return flash_erase(addr, OTAF_SECTOR_SIZE);
+}
+
+int ota_flash_read_bootsector(uint32_t* bank_addr)
+{
+    *bank_addr = OTAF_APP_BANK_0_ADDR;
+    return PPlus_SUCCESS;
+}
+
+int ota_flash_erase(uint32_t addr)
+{
+    return flash_erase(addr, OTAF_APP_BANK_SIZE);
+}
+
+int ota_flash_erase_area(uint32_t flash_addr, uint32_t size)
+{
+    return flash_erase(flash_addr, size);
+}
+
+int ota_flash_erase_sector(uint32_t flash_addr)
+{
+    return flash_erase(flash_addr, OTAF_SECTOR_SIZE);
+}
+
+int ota_flash_write_partition(uint32 addr, uint32_t* p_sect, uint32_t size)
+{
+    const uint8_t* src = (const uint8_t*)p_sect;
+    uint8_t* p;
+    uint32_t i;
+
+    if(addr % 4)
+        return PPlus_ERR_DATA_ALIGN;
+    size = (size + 3) & 0xfffffffc;
+    p = flash(addr, size);
+    if(p == NULL)
+        return PPlus_ERR_SPI_FLASH;
+    for(i = 0; i < size; i++){
+        if(p[i] != 0xff)
+            s_reprog++;
+        p[i] &= src[i];
+    }
+    if(addr + size > s_progEnd)
+        s_progEnd = addr + size;
+    return PPlus_SUCCESS;
+}
+
+int ota_flash_write_boot_sector(uint32_t* p_sect, uint32_t size, uint32_t offset)
+{
+    return PPlus_SUCCESS;
+}
+
+int ota_flash_crc16(uint16_t* crc, uint32_t addr, uint32_t size)
+{
+    uint8_t* p = flash(addr, size);
+
+    if(p == NULL)
+        return PPlus_ERR_SPI_FLASH;
+    *crc = crc16(*crc, p, size);
+    return PPlus_SUCCESS;
+}
+
+int ota_flash_load_app(void)
+{
+    return PPlus_ERR_NOT_SUPPORTED;
+}
+
+int ota_flash_load_fct(void)
+{
+    return PPlus_ERR_NOT_SUPPORTED;
+}
+
+int ota_delta_init(ota_delta_t* pdt, uint32_t base_addr, uint32_t base_limit, uint32_t out_addr, uint32_t out_limit)
+{
+    return PPlus_ERR_NOT_SUPPORTED;
+}
+
+int ota_delta_feed(ota_delta_t* pdt, const uint8_t* data, uint32_t size)
+{
+    return PPlus_ERR_NOT_SUPPORTED;
+}
+
+int ota_delta_finish(ota_delta_t* pdt, uint32_t* size, uint16_t* crc)
+{
+    return PPlus_ERR_NOT_SUPPORTED;
+}
+
+int ota_lz_init(ota_lz_t* plz, uint32_t out_addr, uint32_t out_limit)
+{
+    return PPlus_ERR_NOT_SUPPORTED;
+}
+
+int ota_lz_feed(ota_lz_t* plz, const uint8_t* data, uint32_t size)
+{
+    return PPlus_ERR_NOT_SUPPORTED;
+}
+
+int ota_lz_finish(ota_lz_t* plz, uint32_t* size, uint16_t* crc)
+{
+    return PPlus_ERR_NOT_SUPPORTED;
+}
+
+//partitions are not encrypted
+bool finidv(unsigned char* iv)
+{
+    return FALSE;
+}
+
+bool verify_mic(unsigned char* buf, int size)
+{
+    return FALSE;
+}
+
+//link
+
+static void deliver(uint8_t ev, const uint8_t* data, uint8_t size)
+{
+    uint8_t buf[256];
+    ota_Evt_t e;
+
+    if(size)
+        memcpy(buf, data, size);
+    e.ev = ev;
+    e.size = size;
+    e.data = buf;
+    s_cb(&e);
+}
+
+static void ctrl(const uint8_t* cmd, uint8_t size)
+{
+    s_now += CONN_INTERVAL;
+    deliver(OTA_EVT_CONTROL, cmd, size);
+}
+
+static void data(const uint8_t* pkt, uint8_t size)
+{
+    s_now += CONN_INTERVAL / PER_EVENT;
+    s_sent++;
+    if(rnd() % 10000 >= s_loss)
+        deliver(OTA_EVT_DATA, pkt, size);
+}
+
+//next response, the device timer runs while there is none, 0 if the transfer stalled
+static int wait(rsp_t* r)
+{
+    while(s_rspNum == 0){
+        if(s_timer < 0 || s_timer > TIME_LIMIT)
+            return 0;
+        s_now = s_timer;
+        s_timer = -1;
+        otaProtocol_TimerEvt();
+    }
+    s_now += CONN_INTERVAL;
+    *r = s_rsp[0];
+    s_rspNum--;
+    memmove(s_rsp, s_rsp + 1, s_rspNum * sizeof(rsp_t));
+    return 1;
+}
+
+//new connection with notifications on, flash not erased
+static void session(uint16_t mtu)
+{
+    deliver(OTA_EVT_DISCONNECTED, NULL, 0);
+    deliver(OTA_EVT_NOTIF_ENABLE, NULL, 0);
+    otaProtocol_mtu(mtu);
+    memset(s_flash, 0x5a, sizeof(s_flash));
+    s_rspNum = 0;
+    s_timer = -1;
+    s_now = 0;
+    s_sent = 0;
+    s_reprog = 0;
+    s_progEnd = 0;
+}
+
+static int start(uint8_t burst, uint8_t flags)
+{
+    uint8_t cmd[4] = {OTA_CMD_START_OTA, 1, burst, flags};
+    rsp_t r;
+
+    ctrl(cmd, sizeof(cmd));
+    return wait(&r) && r.len == 2 && r.v[0] == PPlus_SUCCESS && r.v[1] == OTA_RSP_START_OTA;
+}
+
+static void partition_info(uint32_t size, uint16_t crc)
+{
+    uint8_t cmd[16];
+
+    memset(cmd, 0, sizeof(cmd));
+    cmd[0] = OTA_CMD_PARTITION_INFO;
+    cmd[1] = 0;
+    //flash_addr 0 in the bank, run from SRAM0
+    cmd[6] = (uint8_t)SRAM0_BASE_ADDRESS;
+    cmd[7] = (uint8_t)(SRAM0_BASE_ADDRESS >> 8);
+    cmd[8] = (uint8_t)(SRAM0_BASE_ADDRESS >> 16);
+    cmd[9] = (uint8_t)(SRAM0_BASE_ADDRESS >> 24);
+    cmd[10] = (uint8_t)size;
+    cmd[11] = (uint8_t)(size >> 8);
+    cmd[12] = (uint8_t)(size >> 16);
+    cmd[13] = (uint8_t)(size >> 24);
+    cmd[14] = (uint8_t)crc;
+    cmd[15] = (uint8_t)(crc >> 8);
+    ctrl(cmd, sizeof(cmd));
+}
+
+//from off on, which is where the device is
+static int send_burst(const uint8_t* img, uint32_t size, uint32_t off, uint8_t mtu_a, uint8_t burst)
+{
+    uint32_t acked = off;
+    rsp_t r;
+    int i;
+
+    for(;;){
+        for(i = 0; i < burst && off < size; i++){
+            uint8_t n = (size - off < mtu_a) ? (uint8_t)(size - off) : mtu_a;
+            data(img + off, n);
+            off += n;
+        }
+        if(!wait(&r)){
+            //the device has no timer running after a rewind, so a resend lost
+            //as a whole goes unanswered until the sender gives up waiting
+            if(s_now > TIME_LIMIT)
+                return 0;
+            s_now += SENDER_TIMEOUT;
+            off = acked;
+            continue;
+        }
+        if(r.len < 2)
+            return 0;
+        if(r.v[1] == OTA_RSP_OTA_COMPLETE)
+            return r.v[0] == PPlus_SUCCESS;
+        if(r.v[1] != OTA_RSP_BLOCK_BURST)
+            return 0;
+        if(r.v[0] == PPlus_SUCCESS)
+            acked = off;
+        else
+            off = acked;
+    }
+}
+
+static int send_window(const uint8_t* img, uint32_t size, uint8_t win, uint8_t pkt)
+{
+    uint16_t num = (uint16_t)((size + pkt - 1) / pkt);
+    uint16_t base = 0;
+    uint8_t missing[OTA_WINDOW_MAX / 8];
+    uint8_t buf[256];
+    rsp_t r;
+    int bit;
+
+    memset(missing, 0, sizeof(missing));
+    for(bit = 0; bit < win && bit < num; bit++)
+        missing[bit >> 3] |= 1 << (bit & 7);
+
+    for(;;){
+        for(bit = 0; bit < win; bit++){
+            uint16_t idx = base + bit;
+            uint32_t off = (uint32_t)idx * pkt;
+            uint8_t n;
+
+            if(!(missing[bit >> 3] & (1 << (bit & 7))))
+                continue;
+            n = (size - off < pkt) ? (uint8_t)(size - off) : pkt;
+            buf[0] = (uint8_t)idx;
+            memcpy(buf + 1, img + off, n);
+            data(buf, n + 1);
+        }
+        if(!wait(&r) || r.len < 2)
+            return 0;
+        if(r.v[1] == OTA_RSP_OTA_COMPLETE)
+            return r.v[0] == PPlus_SUCCESS;
+        if(r.v[1] != OTA_RSP_BLOCK_ACK || r.v[4] > OTA_WINDOW_MAX)
+            return 0;
+        base = r.v[2] | (r.v[3] << 8);
+        win = r.v[4];
+        memset(missing, 0, sizeof(missing));
+        memcpy(missing, r.v + 5, (win + 7) >> 3);
+    }
+}
+
+//one partition, returns the goodput in kbit/s, 0 on failure
+static double transfer(const uint8_t* img, uint32_t size, uint16_t mtu, int window, uint32_t loss)
+{
+    uint8_t burst = 16;
+    rsp_t r;
+    int ok;
+
+    session(mtu);
+    s_loss = loss;
+    if(!start(burst, window ? OTA_START_FLAG_WINDOW : 0))
+        return 0;
+    partition_info(size, crc16(0, img, size));
+    if(!wait(&r) || r.len < 2 || r.v[0] != PPlus_SUCCESS || r.v[1] != OTA_RSP_PARTITION_INFO)
+        return 0;
+
+    if(window)
+        ok = r.len == 4 && send_window(img, size, r.v[2], r.v[3]);
+    else
+        ok = send_burst(img, size, 0, (uint8_t)(mtu - 3), burst);
+
+    CHECK(ok);
+    CHECK(memcmp(flash(OTAF_APP_BANK_0_ADDR, size), img, size) == 0);
+    CHECK(s_reprog == 0);
+    return ok ? size * 8.0 / s_now : 0;
+}
+
+#if(CFG_OTA_STREAM == 0)
+static void test_oversize(void)
+{
+    uint8_t pkt[20];
+    rsp_t r;
+    int window;
+
+    memset(pkt, 0, sizeof(pkt));
+    for(window = 0; window < 2; window++){
+        session(23);
+        CHECK(start(16, window ? OTA_START_FLAG_WINDOW : 0));
+        partition_info(PBUF_SIZE + 1, 0);
+        CHECK(wait(&r) && r.len == 1 && r.v[0] == PPlus_ERR_DATA_SIZE);
+
+        //no partition to take data into
+        data(pkt, sizeof(pkt));
+        CHECK(wait(&r) && r.len == 1 && r.v[0] == PPlus_ERR_OTA_INVALID_STATE);
+        CHECK(s_rspNum == 0);
+    }
+
+    //a burst packet past the end of a partition that fills the buffer
+    session(247);
+    s_loss = 0;
+    CHECK(start(0xff, 0));
+    partition_info(PBUF_SIZE, 0);
+    CHECK(wait(&r) && r.v[0] == PPlus_SUCCESS && r.v[1] == OTA_RSP_PARTITION_INFO);
+    {
+        static uint8_t big[244];
+        uint32_t off;
+
+        for(off = 0; off + sizeof(big) <= PBUF_SIZE; off += sizeof(big))
+            data(big, sizeof(big));
+        data(big, sizeof(big));
+    }
+    CHECK(wait(&r) && r.len == 1 && r.v[0] == PPlus_ERR_OTA_DATA_SIZE);
+}
+#else
+static void test_stream(void)
+{
+    static uint8_t img[8 * 1024];
+    uint32_t i, off;
+    rsp_t r;
+
+    for(i = 0; i < sizeof(img); i++)
+        img[i] = (uint8_t)rnd();
+
+    //a burst of 0xffff packets
+    session(247);
+    CHECK(start(0xff, 0));
+    partition_info(sizeof(img), 0);
+    CHECK(wait(&r) && r.len == 1 && r.v[0] == PPlus_ERR_DATA_SIZE);
+
+    //the first burst is acked, the second loses its fifth packet
+    session(23);
+    s_loss = 0;
+    CHECK(start(16, 0));
+    partition_info(sizeof(img), crc16(0, img, sizeof(img)));
+    CHECK(wait(&r) && r.v[0] == PPlus_SUCCESS && r.v[1] == OTA_RSP_PARTITION_INFO);
+    for(i = 0, off = 0; i < 32; i++, off += 20){
+        if(i != 16 + 4)
+            deliver(OTA_EVT_DATA, img + off, 20);
+    }
+    CHECK(wait(&r) && r.v[0] == PPlus_SUCCESS && r.v[1] == OTA_RSP_BLOCK_BURST);
+    CHECK(wait(&r) && r.v[0] != PPlus_SUCCESS && r.v[1] == OTA_RSP_BLOCK_BURST);
+
+    //what the first burst completed of a program unit, not more
+    CHECK(s_progEnd == OTAF_APP_BANK_0_ADDR + OTA_STREAM_BUF_SIZE);
+
+    CHECK(send_burst(img, sizeof(img), 16 * 20, 20, 16));
+    CHECK(memcmp(flash(OTAF_APP_BANK_0_ADDR, sizeof(img)), img, sizeof(img)) == 0);
+    CHECK(s_reprog == 0);
+}
+#endif
+
+static void test_lossy(uint32_t runs)
+{
+    static const uint16_t mtus[] = {23, 247};
+    static const uint32_t losses[] = {0, 5, 10, 15, 20};
+    static uint8_t img[PART_SIZE];
+    unsigned m, l;
+    uint32_t i;
+
+    for(i = 0; i < sizeof(img); i++)
+        img[i] = (uint8_t)rnd();
+
+    for(m = 0; m < sizeof(mtus) / sizeof(mtus[0]); m++){
+        printf("MTU %u, goodput in kbit/s\n  loss     burst%s\n", mtus[m], (MODES > 1) ? "    window" : "");
+        for(l = 0; l < sizeof(losses) / sizeof(losses[0]); l++){
+            double rate[2] = {0, 0};
+            int window;
+
+            for(window = 0; window < MODES; window++){
+                for(i = 0; i < runs; i++)
+                    rate[window] += transfer(img, sizeof(img), mtus[m], window, losses[l] * 100) / runs;
+            }
+            if(MODES > 1)
+                printf("  %3u%%  %8.1f  %8.1f\n", (unsigned)losses[l], rate[0], rate[1]);
+            else
+                printf("  %3u%%  %8.1f\n", (unsigned)losses[l], rate[0]);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t runs = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 5;
+
+    otaProtocol_init(TASK_ID, TM_EVT);
+    CHECK(s_cb != NULL);
+
+#if(CFG_OTA_STREAM == 0)
+    test_oversize();
+#else
+    test_stream();
+#endif
+    test_lossy(runs ? runs : 1);
+
+    printf("ota_test: %d failures\n", s_fail);
+    return s_fail ? 1 : 0;
+}
@@ -0,0 +1,494 @@
+/*
+Host test of the OTA master, see components/profiles/ota/otam_protocol.c.
+
+The real otam_protocol.c is built against a model of the targets. Commands
+and data go out through the write methods given to otamProtocol_init, each
+target answers the way ota_protocol.c does: OTA_RSP_BLOCK_BURST after each
+burst, OTA_RSP_PARTITION_COMPLETE or OTA_RSP_OTA_COMPLETE at the end of a
+partition once its CRC matches, and OTA_RSP_BLOCK_BURST with
+PPlus_ERR_OTA_BAD_DATA when a packet of the burst was lost and its timer runs
+out. Responses are delivered from the main loop, never from inside a write.
+A target has a few tx buffers; when they are gone write_data fails and the
+master waits for OTAP_EVT_DATA_WR_DELAY. The source image is read through
+hal_flash_read, which counts the reads.
+
+- concurrent: four targets with different MTUs, tx buffers and lost packets
+  are updated at the same time with a two partition image, each must receive
+  both partitions intact and be told to reboot, and the aggregate byte count
+  must match
+- shared cache: targets moving together read each source line from flash
+  once
+- refused start: a start on a link that is transferring, in application
+  mode or not connected is refused, and the running transfer of that link
+  goes on with its own image
+- disconnect: a target dropping out mid transfer does not hold up the
+  others, nothing more is sent to it, and its context serves a new target
+
+    cc -g -fsanitize=address,undefined -o otam_test tools/otam_test.c \
+        components/profiles/ota/otam_protocol.c components/libraries/crc16/crc16.c \
+        -DADV_NCONN_CFG=0x01 -DADV_CONN_CFG=0x02 -DSCAN_CFG=0x04 -DINIT_CFG=0x08 \
+        -DBROADCASTER_CFG=0x01 -DOBSERVER_CFG=0x02 -DPERIPHERAL_CFG=0x04 -DCENTRAL_CFG=0x08 \
+        -DHOST_CONFIG=8 -DDEBUG_INFO=0 -DPHY_MCU_TYPE=MCU_BUMBEE_M0 -DOTAM_LINK_MAX=4 \
+        -DCFG_FLASH=512 -DUSE_FCT=0 -DCFG_OTA_BANK_MODE=OTA_DUAL_BANK -DCFG_OTA_MESH=1 \
+        -Itools/host -Icomponents/inc -Icomponents/osal/include -Icomponents/ble/include \
+        -Icomponents/ble/host -Icomponents/ble/controller -Icomponents/arch/cm0 -Imisc \
+        -Icomponents/driver/log -Icomponents/driver/uart -Icomponents/driver/gpio \
+        -Icomponents/driver/timer -Icomponents/driver/flash -Icomponents/driver/clock \
+        -Icomponents/libraries/crc16 -Icomponents/profiles/ota -Icomponents/profiles/ota_app \
+        -Icomponents/profiles/Roles -Icomponents/profiles/SimpleProfile -Icomponents/ble/hci -Ilib
+    ./otam_test
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bcomdef.h"
+#include "OSAL.h"
+#include "linkdb.h"
+#include "crc16.h"
+#include "error.h"
+#include "ota_protocol.h"
+#include "ota_flash.h"
+#include "ota_flash_mesh.h"
+#include "otam_protocol.h"
+#include "otam_cmd.h"
+
+#define SRC_BASE            0x11040000      //image as load_fw() describes it
+#define PART0_SIZE          5000
+#define PART1_SIZE          3001
+#define SRC_SIZE            (PART0_SIZE + PART1_SIZE)
+#define HANDLES             8
+#define RSP_MAX             8
+#define STEP_LIMIT          100000
+
+typedef struct{
+    //link
+    uint16_t mtu;
+    int credits_max;        //tx buffers, refilled by OTAP_EVT_DATA_WR_DELAY
+    uint32_t drop_at;       //data packet lost on air, 0: none
+    bool connected;
+    int credits;
+    uint32_t pkts;
+    //target protocol state
+    uint8_t part_num;
+    uint8_t part;
+    uint32_t part_size;
+    uint16_t part_crc;
+    uint32_t burst;         //bytes per burst, 0: the whole partition
+    uint32_t offset;        //received in the current partition
+    uint32_t retry;         //offset of the current burst
+    bool lost;
+    uint8_t rx[2][PART0_SIZE];
+    int parts_ok;
+    bool rebooted;
+    int errors;
+    uint8_t rsp[RSP_MAX][2];
+    int rsp_num;
+}target_t;
+
+static uint8_t s_src[SRC_SIZE + OTAM_CACHE_LINE_SIZE];
+static ota_fw_t s_fw;
+static target_t s_t[HANDLES];
+static bool s_delay;
+static uint32_t s_reads;
+static uint32_t s_clock;
+static uint32_t s_rng = 1;
+static int s_fail;
+
+#define CHECK(c)    do{ if(!(c)){ printf("%s:%d: %s\n", __FILE__, __LINE__, #c); s_fail++; } }while(0)
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+//stubs of the platform
+
+int hal_flash_read(uint32_t addr, uint8_t* data, uint32_t size)
+{
+    uint32_t off = addr - OTAFM_FW_OTA_DATA_ADDR - SRC_BASE;
+
+    if(off > sizeof(s_src) || size > sizeof(s_src) - off){
+        printf("flash read out of range %08x+%x\n", (unsigned)addr, (unsigned)size);
+        s_fail++;
+        return PPlus_ERR_INVALID_ADDR;
+    }
+    memcpy(data, s_src + off, size);
+    s_reads++;
+    return PPlus_SUCCESS;
+}
+
+uint32 osal_GetSystemClock(void)
+{
+    return s_clock;
+}
+
+bStatus_t GAPCentralRole_TerminateLink(uint16 connHandle)
+{
+    return SUCCESS;
+}
+
+//target model, answers like ota_protocol.c
+
+static void respond(target_t* t, uint8_t rsp, uint8_t status)
+{
+    if(t->rsp_num == RSP_MAX){
+        printf("response queue full\n");
+        s_fail++;
+        return;
+    }
+    t->rsp[t->rsp_num][0] = status;
+    t->rsp[t->rsp_num][1] = rsp;
+    t->rsp_num++;
+}
+
+static uint32_t rd32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int m_clear(uint16_t conn_handle)
+{
+    return PPlus_SUCCESS;
+}
+
+static int m_write_cmd(uint16_t conn_handle, uint8_t* data, uint16_t len, uint32_t timeout)
+{
+    target_t* t = &s_t[conn_handle];
+
+    CHECK(conn_handle < HANDLES && t->connected);
+    switch(data[0]){
+    case OTA_CMD_START_OTA:
+        if(data[1] == 0xff)
+            break;      //stop
+        t->part_num = data[1];
+        t->part = 0;
+        t->parts_ok = 0;
+        t->burst = (data[2] == 0) ? 16 : (data[2] == 0xff) ? 0 : data[2];
+        if(t->burst)
+            t->burst *= t->mtu - 3;
+        respond(t, OTA_RSP_START_OTA, PPlus_SUCCESS);
+        break;
+    case OTA_CMD_PARTITION_INFO:
+        CHECK(len == 16 && data[1] == t->part && t->part < 2);
+        t->part_size = rd32(data + 10);
+        t->part_crc = data[14] | (data[15] << 8);
+        CHECK(t->part_size <= PART0_SIZE);
+        t->offset = 0;
+        t->retry = 0;
+        t->lost = FALSE;
+        respond(t, OTA_RSP_PARTITION_INFO, PPlus_SUCCESS);
+        break;
+    case OTA_CMD_REBOOT:
+        t->rebooted = TRUE;
+        break;
+    default:
+        t->errors++;
+        break;
+    }
+    return PPlus_SUCCESS;
+}
+
+static int m_write_data(uint16_t conn_handle, uint8_t* data, uint16_t len)
+{
+    target_t* t = &s_t[conn_handle];
+
+    CHECK(conn_handle < HANDLES && t->connected);
+    CHECK(len <= t->mtu - 3);
+    if(t->credits == 0)
+        return PPlus_ERR_BUSY;
+    t->credits--;
+
+    //the rest of a burst with a lost packet is thrown away until the retry
+    if(++t->pkts == t->drop_at)
+        t->lost = TRUE;
+    if(t->lost)
+        return PPlus_SUCCESS;
+
+    if(t->offset + len > t->part_size){
+        t->errors++;
+        respond(t, OTA_RSP_ERROR, PPlus_ERR_OTA_DATA_SIZE);
+        return PPlus_SUCCESS;
+    }
+    memcpy(t->rx[t->part] + t->offset, data, len);
+    t->offset += len;
+
+    if(t->offset == t->part_size){
+        if(crc16(0, t->rx[t->part], t->part_size) != t->part_crc){
+            t->errors++;
+            respond(t, OTA_RSP_ERROR, PPlus_ERR_OTA_CRC);
+            return PPlus_SUCCESS;
+        }
+        t->parts_ok++;
+        if(++t->part == t->part_num)
+            respond(t, OTA_RSP_OTA_COMPLETE, PPlus_SUCCESS);
+        else
+            respond(t, OTA_RSP_PARTITION_COMPLETE, PPlus_SUCCESS);
+    }
+    else if(t->burst && t->offset - t->retry == t->burst){
+        t->retry = t->offset;
+        respond(t, OTA_RSP_BLOCK_BURST, PPlus_SUCCESS);
+    }
+    return PPlus_SUCCESS;
+}
+
+static int m_write_data_delay(uint32_t msec_delay)
+{
+    s_delay = TRUE;
+    return PPlus_SUCCESS;
+}
+
+static void event(uint8_t ev, uint16_t conn_handle, void* data, uint16_t len)
+{
+    otap_evt_t pev;
+
+    pev.ev = ev;
+    pev.conn_handle = conn_handle;
+    pev.data = data;
+    pev.len = len;
+    otamProtocol_event(&pev);
+}
+
+static void connect(uint16_t conn_handle, uint16_t mtu, int credits, uint32_t drop_at, uint8_t run_mode)
+{
+    target_t* t = &s_t[conn_handle];
+    otam_proto_conn_param_t param;
+
+    memset(t, 0, sizeof(*t));
+    t->mtu = mtu;
+    t->credits_max = credits;
+    t->credits = credits;
+    t->drop_at = drop_at;
+    t->connected = TRUE;
+    param.run_mode = run_mode;
+    param.mtu = mtu;
+    event(OTAP_EVT_CONNECTED, conn_handle, &param, sizeof(param));
+}
+
+static void disconnect(uint16_t conn_handle)
+{
+    s_t[conn_handle].connected = FALSE;
+    s_t[conn_handle].rsp_num = 0;
+    event(OTAP_EVT_DISCONNECTED, conn_handle, NULL, 0);
+}
+
+/*
+one step: deliver the queued responses, then the shared write delay. A step
+with neither is where the targets waiting for a lost packet time out. FALSE
+once nothing is left to do
+*/
+static bool step(void)
+{
+    bool active = FALSE;
+    uint8_t rsp[2];
+    int i;
+
+    s_clock += 2;
+    for(i = 0; i < HANDLES; i++){
+        while(s_t[i].rsp_num){
+            memcpy(rsp, s_t[i].rsp[0], 2);
+            memmove(s_t[i].rsp[0], s_t[i].rsp[1], sizeof(s_t[i].rsp[0]) * (RSP_MAX - 1));
+            s_t[i].rsp_num--;
+            event(OTAP_EVT_NOTIFY, i, rsp, 2);
+            active = TRUE;
+        }
+    }
+    if(s_delay){
+        s_delay = FALSE;
+        for(i = 0; i < HANDLES; i++)
+            s_t[i].credits = s_t[i].credits_max;
+        event(OTAP_EVT_DATA_WR_DELAY, INVALID_CONNHANDLE, NULL, 0);
+        active = TRUE;
+    }
+    if(active)
+        return TRUE;
+
+    for(i = 0; i < HANDLES; i++){
+        if(s_t[i].connected && s_t[i].lost){
+            s_t[i].lost = FALSE;
+            s_t[i].offset = s_t[i].retry;
+            respond(&s_t[i], OTA_RSP_BLOCK_BURST, PPlus_ERR_OTA_BAD_DATA);
+            active = TRUE;
+        }
+    }
+    return active;
+}
+
+static void run(void)
+{
+    int n = 0;
+
+    while(step()){
+        if(++n == STEP_LIMIT){
+            printf("transfer stalled\n");
+            s_fail++;
+            return;
+        }
+    }
+}
+
+static void check_done(uint16_t conn_handle)
+{
+    target_t* t = &s_t[conn_handle];
+
+    CHECK(t->errors == 0);
+    CHECK(t->parts_ok == 2);
+    CHECK(t->rebooted);
+    CHECK(memcmp(t->rx[0], s_src, PART0_SIZE) == 0);
+    CHECK(memcmp(t->rx[1], s_src + PART0_SIZE, PART1_SIZE) == 0);
+}
+
+static void reset(void)
+{
+    otam_proto_meth_t method = { m_clear, m_write_cmd, m_write_data, m_write_data_delay };
+
+    memset(s_t, 0, sizeof(s_t));
+    s_delay = FALSE;
+    s_reads = 0;
+    otamProtocol_init(&method);
+}
+
+static void test_concurrent(void)
+{
+    otam_proto_stat_t stat;
+    int i;
+
+    reset();
+    connect(0, 23, 4, 0, OTAC_RUNMODE_OTA);
+    connect(1, 247, 2, 30, OTAC_RUNMODE_OTA);
+    connect(2, 23, 1, 100, OTAC_RUNMODE_OTA);
+    connect(3, 185, 3, 0, OTAC_RUNMODE_OTA);
+    for(i = 0; i < 4; i++)
+        CHECK(otamProtocol_start_ota(i, &s_fw) == PPlus_SUCCESS);
+    otamProtocol_stat(&stat);
+    CHECK(stat.links == 4);
+
+    run();
+    for(i = 0; i < 4; i++)
+        check_done(i);
+    otamProtocol_stat(&stat);
+    CHECK(stat.links == 0);
+    CHECK(stat.bytes == 4 * SRC_SIZE);
+    printf("concurrent: 4 targets, %u bytes acknowledged, %u flash line reads\n",
+           (unsigned)stat.bytes, (unsigned)stat.flash_reads);
+}
+
+static void test_shared_cache(void)
+{
+    uint32_t lines = (SRC_SIZE + OTAM_CACHE_LINE_SIZE - 1) / OTAM_CACHE_LINE_SIZE;
+    int i;
+
+    reset();
+    for(i = 0; i < 3; i++){
+        connect(i, 23, 4, 0, OTAC_RUNMODE_OTA);
+        CHECK(otamProtocol_start_ota(i, &s_fw) == PPlus_SUCCESS);
+    }
+    run();
+    for(i = 0; i < 3; i++)
+        check_done(i);
+    CHECK(s_reads == lines);
+    printf("shared cache: 3 targets, %u flash line reads for %u lines\n", (unsigned)s_reads, (unsigned)lines);
+}
+
+static void test_refused_start(void)
+{
+    ota_fw_t other;
+    int i;
+
+    reset();
+    connect(0, 23, 4, 0, OTAC_RUNMODE_OTA);
+    connect(1, 247, 1, 0, OTAC_RUNMODE_OTA);
+    connect(2, 23, 4, 0, OTAC_RUNMODE_APP);
+    CHECK(otamProtocol_start_ota(0, &s_fw) == PPlus_SUCCESS);
+    CHECK(otamProtocol_start_ota(1, &s_fw) == PPlus_SUCCESS);
+
+    //a different image with one short partition
+    other = s_fw;
+    other.part_num = 1;
+    other.part[0].size = 100;
+    other.part[0].checksum = crc16(0, s_src + 1000, 100);
+    other.part[0].flash_addr = SRC_BASE + 1000;
+
+    //refused in the first partition and in the second
+    for(i = 0; i < 10; i++)
+        step();
+    CHECK(s_t[0].parts_ok == 0 && s_t[1].parts_ok == 0);
+    CHECK(otamProtocol_start_ota(0, &other) == PPlus_ERR_INVALID_STATE);
+    CHECK(otamProtocol_start_ota(1, &other) == PPlus_ERR_INVALID_STATE);
+    while(s_t[1].parts_ok == 0 && step())
+        ;
+    CHECK(s_t[0].parts_ok < 2 && s_t[1].parts_ok == 1);
+    CHECK(otamProtocol_start_ota(0, &other) == PPlus_ERR_INVALID_STATE);
+    CHECK(otamProtocol_start_ota(1, &other) == PPlus_ERR_INVALID_STATE);
+    CHECK(otamProtocol_start_ota(2, &other) == PPlus_ERR_INVALID_STATE);
+    CHECK(otamProtocol_start_ota(5, &other) == PPlus_ERR_BLE_NOT_READY);
+    CHECK(otamProtocol_start_ota(INVALID_CONNHANDLE, &other) == PPlus_ERR_BLE_NOT_READY);
+
+    run();
+    check_done(0);
+    check_done(1);
+    CHECK(s_t[2].part_num == 0);
+}
+
+static void test_disconnect(void)
+{
+    uint32_t pkts;
+    int i;
+
+    reset();
+    for(i = 0; i < 3; i++){
+        connect(i, 23, 2, 0, OTAC_RUNMODE_OTA);
+        CHECK(otamProtocol_start_ota(i, &s_fw) == PPlus_SUCCESS);
+    }
+    for(i = 0; i < 100; i++)
+        step();
+    CHECK(s_t[1].parts_ok == 0 && s_t[1].offset > 0);
+    pkts = s_t[1].pkts;
+    disconnect(1);
+
+    //the freed context takes the next target, all links are in use
+    connect(7, 247, 3, 0, OTAC_RUNMODE_OTA);
+    CHECK(otamProtocol_start_ota(7, &s_fw) == PPlus_SUCCESS);
+    connect(6, 23, 2, 0, OTAC_RUNMODE_OTA);
+    CHECK(otamProtocol_start_ota(6, &s_fw) == PPlus_SUCCESS);
+    connect(5, 23, 2, 0, OTAC_RUNMODE_OTA);
+    CHECK(otamProtocol_start_ota(5, &s_fw) == PPlus_ERR_BLE_NOT_READY);
+
+    run();
+    check_done(0);
+    check_done(2);
+    check_done(7);
+    check_done(6);
+    CHECK(s_t[1].pkts == pkts);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t i;
+
+    for(i = 0; i < sizeof(s_src); i++)
+        s_src[i] = (uint8_t)rnd();
+    memset(&s_fw, 0, sizeof(s_fw));
+    s_fw.part_num = 2;
+    s_fw.part[0].flash_addr = SRC_BASE;
+    s_fw.part[0].run_addr = 0x11020000;     //XIP, flashed in place
+    s_fw.part[0].size = PART0_SIZE;
+    s_fw.part[0].checksum = crc16(0, s_src, PART0_SIZE);
+    s_fw.part[1].flash_addr = SRC_BASE + PART0_SIZE;
+    s_fw.part[1].run_addr = 0x1fff4000;
+    s_fw.part[1].size = PART1_SIZE;
+    s_fw.part[1].checksum = crc16(0, s_src + PART0_SIZE, PART1_SIZE);
+    s_fw.total_size = SRC_SIZE;
+
+    test_concurrent();
+    test_shared_cache();
+    test_refused_start();
+    test_disconnect();
+
+    printf("otam_test: %d failures\n", s_fail);
+    return s_fail ? 1 : 0;
+}